@@ -0,0 +1,407 @@
+#include "AnimationCompression.h"
+#include "SkinnedData.h"
+
+using namespace DirectX;
+
+namespace
+{
+    const float QuatComponentRange = 0.70710678f; // 1/sqrt(2)
+
+    uint16_t QuantizeUnorm(float x, float maxValue)
+    {
+        x = MathHelper::Clamp(x, 0.0f, 1.0f);
+        return (uint16_t)(x * maxValue + 0.5f);
+    }
+
+    // Smallest-three encoding.  The largest component is made positive (q and -q are
+    // the same rotation) and dropped; the other three lie in [-1/sqrt(2), 1/sqrt(2)].
+    void EncodeQuaternion(FXMVECTOR quat, uint16_t packed[3])
+    {
+        XMFLOAT4 q;
+        XMStoreFloat4(&q, XMQuaternionNormalize(quat));
+        float c[4] = { q.x, q.y, q.z, q.w };
+
+        UINT largest = 0;
+        for(UINT i = 1; i < 4; ++i)
+        {
+            if(fabsf(c[i]) > fabsf(c[largest]))
+                largest = i;
+        }
+
+        const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+        UINT j = 0;
+        for(UINT i = 0; i < 4; ++i)
+        {
+            if(i == largest)
+                continue;
+
+            float unorm = (sign * c[i] / QuatComponentRange) * 0.5f + 0.5f;
+            packed[j++] = QuantizeUnorm(unorm, 32767.0f);
+        }
+
+        packed[0] |= (uint16_t)((largest & 1) << 15);
+        packed[1] |= (uint16_t)((largest >> 1) << 15);
+    }
+
+    XMVECTOR DecodeQuaternion(const uint16_t packed[3])
+    {
+        const UINT largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+
+        float small[3];
+        float sumSq = 0.0f;
+        for(UINT j = 0; j < 3; ++j)
+        {
+            float unorm = (packed[j] & 0x7fff) / 32767.0f;
+            small[j] = (unorm * 2.0f - 1.0f) * QuatComponentRange;
+            sumSq += small[j] * small[j];
+        }
+
+        float c[4];
+        UINT j = 0;
+        for(UINT i = 0; i < 4; ++i)
+            c[i] = i == largest ? sqrtf(MathHelper::Max(0.0f, 1.0f - sumSq)) : small[j++];
+
+        return XMVectorSet(c[0], c[1], c[2], c[3]);
+    }
+
+    using TrackType = CompressedAnimationClip::TrackType;
+
+    XMVECTOR KeyValue(const Keyframe& key, TrackType type)
+    {
+        switch(type)
+        {
+        case CompressedAnimationClip::TrackTranslation: return XMLoadFloat3(&key.Translation);
+        case CompressedAnimationClip::TrackScale: return XMLoadFloat3(&key.Scale);
+        default: return XMLoadFloat4(&key.RotationQuat);
+        }
+    }
+
+    float TrackError(FXMVECTOR a, FXMVECTOR b, TrackType type)
+    {
+        switch(type)
+        {
+        case CompressedAnimationClip::TrackTranslation:
+            return XMVectorGetX(XMVector3Length(XMVectorSubtract(a, b)));
+        case CompressedAnimationClip::TrackScale:
+        {
+            XMFLOAT3 d;
+            XMStoreFloat3(&d, XMVectorAbs(XMVectorSubtract(a, b)));
+            return MathHelper::Max(d.x, MathHelper::Max(d.y, d.z));
+        }
+        default:
+        {
+            // Angle of the rotation that takes a to b.  atan2 stays accurate for the tiny
+            // angles we care about, where acos of the dot product does not.
+            XMVECTOR r = XMQuaternionMultiply(XMQuaternionConjugate(XMQuaternionNormalize(a)), XMQuaternionNormalize(b));
+            float sinHalfAngle = XMVectorGetX(XMVector3Length(r));
+            return 2.0f * atan2f(sinHalfAngle, fabsf(XMVectorGetW(r)));
+        }
+        }
+    }
+
+    XMVECTOR InterpolateValue(FXMVECTOR a, FXMVECTOR b, float s, TrackType type)
+    {
+        return type == CompressedAnimationClip::TrackRotation ? XMQuaternionSlerp(a, b, s) : XMVectorLerp(a, b, s);
+    }
+}
+
+AnimationCompressionStats CompressedAnimationClip::Compress(const AnimationClip& clip, const AnimationCompressionSettings& settings)
+{
+    const float tolerances[TrackTypeCount] =
+    {
+        settings.TranslationTolerance, settings.ScaleTolerance, settings.RotationTolerance
+    };
+
+    mNumBones = (UINT)clip.BoneAnimations.size();
+    mStartTime = clip.GetClipStartTime();
+    mEndTime = clip.GetClipEndTime();
+    mTimeStep = (mEndTime - mStartTime) / 65535.0f;
+
+    mTracks.assign((size_t)mNumBones * TrackTypeCount, Track());
+    mKeyTimes.clear();
+    mKeys.clear();
+
+    mStats = AnimationCompressionStats();
+    mStats.SourceByteSize = GetSourceByteSize(clip);
+
+    std::vector<uint16_t> times;
+    std::vector<PackedKey> packed;
+    std::vector<XMFLOAT4> decoded;
+    std::vector<UINT> kept;
+
+    for(UINT bone = 0; bone < mNumBones; ++bone)
+    {
+        const std::vector<Keyframe>& keys = clip.BoneAnimations[bone].Keyframes;
+        const UINT numKeys = (UINT)keys.size();
+
+        // Quantize the key times, keeping them strictly increasing.
+        times.resize(numKeys);
+        for(UINT k = 0; k < numKeys; ++k)
+        {
+            float u = mTimeStep > 0.0f ? (keys[k].TimePos - mStartTime) / mTimeStep : 0.0f;
+            times[k] = (uint16_t)MathHelper::Clamp(u + 0.5f, 0.0f, 65535.0f);
+            if(k > 0 && times[k] <= times[k-1] && times[k-1] < 65535)
+                times[k] = times[k-1] + 1;
+        }
+
+        for(UINT t = 0; t < TrackTypeCount; ++t)
+        {
+            const TrackType type = (TrackType)t;
+            Track& track = mTracks[(size_t)bone * TrackTypeCount + type];
+            mStats.SourceKeyCount += numKeys;
+
+            // Quantize every key first so the key reduction below measures its error
+            // against the values that will actually be stored.
+            if(type != TrackRotation)
+            {
+                XMVECTOR minV = KeyValue(keys[0], type);
+                XMVECTOR maxV = minV;
+                for(UINT k = 1; k < numKeys; ++k)
+                {
+                    minV = XMVectorMin(minV, KeyValue(keys[k], type));
+                    maxV = XMVectorMax(maxV, KeyValue(keys[k], type));
+                }
+                XMStoreFloat3(&track.Min, minV);
+                XMStoreFloat3(&track.Extent, XMVectorSubtract(maxV, minV));
+            }
+
+            packed.resize(numKeys);
+            decoded.resize(numKeys);
+            for(UINT k = 0; k < numKeys; ++k)
+            {
+                XMVECTOR v = KeyValue(keys[k], type);
+                if(type == TrackRotation)
+                {
+                    EncodeQuaternion(v, packed[k].V);
+                }
+                else
+                {
+                    XMFLOAT3 value;
+                    XMStoreFloat3(&value, v);
+                    const float* c = &value.x;
+                    const float* minC = &track.Min.x;
+                    const float* extentC = &track.Extent.x;
+                    for(UINT i = 0; i < 3; ++i)
+                        packed[k].V[i] = extentC[i] > 0.0f ? QuantizeUnorm((c[i] - minC[i]) / extentC[i], 65535.0f) : 0;
+                }
+
+                XMStoreFloat4(&decoded[k], DecodeKey(track, type, packed[k]));
+            }
+
+            auto withinTolerance = [&](UINT a, UINT b)
+            {
+                // Do the stored keys a and b reproduce every source key between them?
+                XMVECTOR va = XMLoadFloat4(&decoded[a]);
+                XMVECTOR vb = XMLoadFloat4(&decoded[b]);
+                float span = (float)(times[b] - times[a]);
+                if(span <= 0.0f)
+                    return false;
+
+                for(UINT m = a + 1; m < b; ++m)
+                {
+                    float s = ((keys[m].TimePos - mStartTime) / mTimeStep - times[a]) / span;
+                    XMVECTOR v = InterpolateValue(va, vb, MathHelper::Clamp(s, 0.0f, 1.0f), type);
+                    if(TrackError(v, KeyValue(keys[m], type), type) > tolerances[type])
+                        return false;
+                }
+                return true;
+            };
+
+            kept.clear();
+            kept.push_back(0);
+
+            bool constant = true;
+            for(UINT k = 1; k < numKeys && constant; ++k)
+                constant = TrackError(XMLoadFloat4(&decoded[0]), KeyValue(keys[k], type), type) <= tolerances[type];
+
+            if(!constant && mTimeStep > 0.0f)
+            {
+                // Greedily stretch each segment as far as the tolerance allows.
+                UINT anchor = 0;
+                for(UINT k = anchor + 2; k < numKeys; ++k)
+                {
+                    if(!withinTolerance(anchor, k))
+                    {
+                        anchor = k - 1;
+                        kept.push_back(anchor);
+                    }
+                }
+                kept.push_back(numKeys - 1);
+            }
+
+            track.FirstKey = (UINT)mKeys.size();
+            track.KeyCount = (UINT)kept.size();
+            for(UINT k : kept)
+            {
+                mKeyTimes.push_back(times[k]);
+                mKeys.push_back(packed[k]);
+            }
+        }
+    }
+
+    mStats.CompressedKeyCount = (UINT)mKeys.size();
+    mStats.CompressedByteSize = GetMemoryByteSize();
+
+    // Measure the error at every source key and halfway between keys.
+    for(UINT bone = 0; bone < mNumBones; ++bone)
+    {
+        const BoneAnimation& boneAnim = clip.BoneAnimations[bone];
+        const std::vector<Keyframe>& keys = boneAnim.Keyframes;
+        for(size_t k = 0; k < keys.size(); ++k)
+        {
+            for(UINT half = 0; half < 2; ++half)
+            {
+                if(half == 1 && k + 1 == keys.size())
+                    break;
+
+                float t = half == 0 ? keys[k].TimePos : 0.5f * (keys[k].TimePos + keys[k+1].TimePos);
+
+                XMVECTOR S0, Q0, P0, S1, Q1, P1;
+                boneAnim.Interpolate(t, S0, Q0, P0);
+                InterpolateBone(bone, t, S1, Q1, P1);
+
+                mStats.MaxTranslationError = MathHelper::Max(mStats.MaxTranslationError, TrackError(P0, P1, TrackTranslation));
+                mStats.MaxScaleError = MathHelper::Max(mStats.MaxScaleError, TrackError(S0, S1, TrackScale));
+                mStats.MaxRotationError = MathHelper::Max(mStats.MaxRotationError, TrackError(Q0, Q1, TrackRotation));
+            }
+        }
+    }
+
+    return mStats;
+}
+
+void CompressedAnimationClip::Decompress(AnimationClip& clip)const
+{
+    clip.BoneAnimations.resize(mNumBones);
+
+    std::vector<uint16_t> times;
+    for(UINT bone = 0; bone < mNumBones; ++bone)
+    {
+        times.clear();
+        for(UINT type = 0; type < TrackTypeCount; ++type)
+        {
+            const Track& track = GetTrack(bone, (TrackType)type);
+            times.insert(times.end(), mKeyTimes.begin() + track.FirstKey,
+                mKeyTimes.begin() + track.FirstKey + track.KeyCount);
+        }
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end()), times.end());
+
+        std::vector<Keyframe>& keys = clip.BoneAnimations[bone].Keyframes;
+        keys.resize(times.size());
+        for(size_t k = 0; k < times.size(); ++k)
+        {
+            keys[k].TimePos = mStartTime + times[k] * mTimeStep;
+
+            XMVECTOR S, Q, P;
+            InterpolateBone(bone, keys[k].TimePos, S, Q, P);
+            XMStoreFloat3(&keys[k].Scale, S);
+            XMStoreFloat4(&keys[k].RotationQuat, Q);
+            XMStoreFloat3(&keys[k].Translation, P);
+        }
+    }
+}
+
+UINT CompressedAnimationClip::BoneCount()const
+{
+    return mNumBones;
+}
+
+float CompressedAnimationClip::GetClipStartTime()const
+{
+    return mStartTime;
+}
+
+float CompressedAnimationClip::GetClipEndTime()const
+{
+    return mEndTime;
+}
+
+size_t CompressedAnimationClip::GetMemoryByteSize()const
+{
+    return mTracks.size() * sizeof(Track) +
+        mKeyTimes.size() * sizeof(uint16_t) +
+        mKeys.size() * sizeof(PackedKey);
+}
+
+const AnimationCompressionStats& CompressedAnimationClip::GetStats()const
+{
+    return mStats;
+}
+
+size_t CompressedAnimationClip::GetSourceByteSize(const AnimationClip& clip)
+{
+    size_t bytes = clip.BoneAnimations.size() * sizeof(BoneAnimation);
+    for(const BoneAnimation& boneAnim : clip.BoneAnimations)
+        bytes += boneAnim.Keyframes.size() * sizeof(Keyframe);
+
+    return bytes;
+}
+
+XMVECTOR CompressedAnimationClip::DecodeKey(const Track& track, TrackType type, const PackedKey& key)
+{
+    if(type == TrackRotation)
+        return DecodeQuaternion(key.V);
+
+    XMVECTOR q = XMVectorSet(key.V[0], key.V[1], key.V[2], 0.0f);
+    XMVECTOR scale = XMVectorScale(XMLoadFloat3(&track.Extent), 1.0f / 65535.0f);
+    return XMVectorMultiplyAdd(q, scale, XMLoadFloat3(&track.Min));
+}
+
+XMVECTOR CompressedAnimationClip::SampleTrack(const Track& track, TrackType type, float t)const
+{
+    const UINT first = track.FirstKey;
+    const UINT last = track.FirstKey + track.KeyCount - 1;
+
+    // Work in quantized time steps.
+    float u = mTimeStep > 0.0f ? (t - mStartTime) / mTimeStep : 0.0f;
+
+    if(track.KeyCount == 1 || u <= mKeyTimes[first])
+        return DecodeKey(track, type, mKeys[first]);
+    if(u >= mKeyTimes[last])
+        return DecodeKey(track, type, mKeys[last]);
+
+    auto next = std::upper_bound(mKeyTimes.begin() + first, mKeyTimes.begin() + last + 1, u,
+        [](float time, uint16_t keyTime) { return time < keyTime; });
+    UINT i = (UINT)(next - mKeyTimes.begin()) - 1;
+
+    float lerpPercent = (u - mKeyTimes[i]) / (float)(mKeyTimes[i+1] - mKeyTimes[i]);
+
+    return InterpolateValue(DecodeKey(track, type, mKeys[i]), DecodeKey(track, type, mKeys[i+1]), lerpPercent, type);
+}
+
+void CompressedAnimationClip::InterpolateBone(UINT bone, float t, XMVECTOR& S, XMVECTOR& Q, XMVECTOR& P)const
+{
+    P = SampleTrack(GetTrack(bone, TrackTranslation), TrackTranslation, t);
+    S = SampleTrack(GetTrack(bone, TrackScale), TrackScale, t);
+    Q = SampleTrack(GetTrack(bone, TrackRotation), TrackRotation, t);
+}
+
+void CompressedAnimationClip::Interpolate(float t, XMFLOAT4X4* boneTransforms)const
+{
+    XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+    for(UINT bone = 0; bone < mNumBones; ++bone)
+    {
+        XMVECTOR S, Q, P;
+        InterpolateBone(bone, t, S, Q, P);
+        XMStoreFloat4x4(&boneTransforms[bone], XMMatrixAffineTransformation(S, zero, Q, P));
+    }
+}
+
+void CompressedAnimationClip::SamplePose(float t, LocalPose& pose)const
+{
+    pose.Resize(mNumBones);
+    for(UINT bone = 0; bone < mNumBones; ++bone)
+    {
+        XMVECTOR S, Q, P;
+        InterpolateBone(bone, t, S, Q, P);
+
+        XMFLOAT3 scale, translation;
+        XMFLOAT4 rotationQuat;
+        XMStoreFloat3(&scale, S);
+        XMStoreFloat4(&rotationQuat, Q);
+        XMStoreFloat3(&translation, P);
+        pose.SetBone(bone, scale, rotationQuat, translation);
+    }
+}
@@ -0,0 +1,142 @@
+//***************************************************************************************
+// AnimationCompression.h
+//
+// Compact storage for AnimationClips.  A Keyframe stores every channel of a bone in
+// full precision (44 bytes per key).  CompressedAnimationClip instead keeps three
+// independent tracks per bone (translation, scale, rotation) and
+//
+//   - drops keys that the neighbouring keys already reproduce within a tolerance,
+//     which collapses constant tracks to a single key and thins out linear motion,
+//   - stores rotations as the three smallest quaternion components at 15 bits each
+//     (the largest is rebuilt from the unit length),
+//   - stores translation and scale at 16 bits per component relative to the range
+//     of the track,
+//   - stores key times at 16 bits relative to the clip duration.
+//
+// Each surviving key takes 8 bytes.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct AnimationClip;
+class LocalPose;
+
+///<summary>
+/// Largest error the key reduction may introduce.  Quantization adds a little on
+/// top; AnimationCompressionStats reports the error that was actually measured.
+///</summary>
+struct AnimationCompressionSettings
+{
+    // Distance, in model units.
+    float TranslationTolerance = 0.001f;
+
+    // Per component.
+    float ScaleTolerance = 0.001f;
+
+    // Angle, in radians.
+    float RotationTolerance = 0.001f;
+};
+
+struct AnimationCompressionStats
+{
+    // Keys summed over the translation, scale and rotation tracks of every bone.
+    UINT SourceKeyCount = 0;
+    UINT CompressedKeyCount = 0;
+
+    size_t SourceByteSize = 0;
+    size_t CompressedByteSize = 0;
+
+    // Largest difference to the source clip, sampled at and between its keys.
+    float MaxTranslationError = 0.0f;
+    float MaxScaleError = 0.0f;
+    float MaxRotationError = 0.0f;
+};
+
+class CompressedAnimationClip
+{
+public:
+    enum TrackType
+    {
+        TrackTranslation = 0,
+        TrackScale,
+        TrackRotation,
+        TrackTypeCount
+    };
+
+    // Replaces the contents of this clip with a compressed copy of clip and returns
+    // the sizes and errors.
+    AnimationCompressionStats Compress(const AnimationClip& clip, const AnimationCompressionSettings& settings);
+
+    // Expands the compressed keys back into an AnimationClip.  Every bone gets a key
+    // wherever one of its three tracks has one.
+    void Decompress(AnimationClip& clip)const;
+
+    UINT BoneCount()const;
+
+    float GetClipStartTime()const;
+    float GetClipEndTime()const;
+
+    // Bytes used by the tracks, key times and key values.
+    size_t GetMemoryByteSize()const;
+
+    // Result of the last Compress call.
+    const AnimationCompressionStats& GetStats()const;
+
+    // Same as BoneAnimation::Interpolate for one bone.
+    void InterpolateBone(UINT bone, float t, DirectX::XMVECTOR& S, DirectX::XMVECTOR& Q, DirectX::XMVECTOR& P)const;
+
+    // Same as AnimationClip::Interpolate.  boneTransforms must hold BoneCount() matrices.
+    void Interpolate(float t, DirectX::XMFLOAT4X4* boneTransforms)const;
+
+    void SamplePose(float t, LocalPose& pose)const;
+
+    // Bytes used by clip's keyframes, for comparison with GetMemoryByteSize.
+    static size_t GetSourceByteSize(const AnimationClip& clip);
+
+private:
+    struct Track
+    {
+        UINT FirstKey = 0;
+        UINT KeyCount = 0;
+
+        // Translation and scale components are Min + Extent * q / 65535.  Unused for
+        // rotation tracks.
+        DirectX::XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 Extent = { 0.0f, 0.0f, 0.0f };
+    };
+
+    // One quantized key value: three 16 bit components, or for rotations three 15 bit
+    // components with the index of the dropped component in the top bits of V[0], V[1].
+    struct PackedKey
+    {
+        uint16_t V[3];
+    };
+
+    static DirectX::XMVECTOR DecodeKey(const Track& track, TrackType type, const PackedKey& key);
+    DirectX::XMVECTOR SampleTrack(const Track& track, TrackType type, float t)const;
+
+    const Track& GetTrack(UINT bone, TrackType type)const
+    {
+        return mTracks[(size_t)bone * TrackTypeCount + type];
+    }
+
+private:
+    UINT mNumBones = 0;
+
+    float mStartTime = 0.0f;
+    float mEndTime = 0.0f;
+
+    // Duration / 65535, the length of one quantized time step.
+    float mTimeStep = 0.0f;
+
+    // [bone][track type]
+    std::vector<Track> mTracks;
+
+    // Quantized key times and values of all tracks, indexed by Track::FirstKey.
+    std::vector<uint16_t> mKeyTimes;
+    std::vector<PackedKey> mKeys;
+
+    AnimationCompressionStats mStats;
+};
@@ -0,0 +1,596 @@
+#include "AnimationSampler.h"
+#include "SkinnedData.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // One channel per XMVECTOR for a group of four bones.
+    struct BoneGroup
+    {
+        XMVECTOR C[AnimationChannelCount];
+    };
+
+    void LoadGroup(const XMFLOAT4A* channels, UINT channelStride, UINT group, BoneGroup& bones)
+    {
+        for(UINT c = 0; c < AnimationChannelCount; ++c)
+            bones.C[c] = XMLoadFloat4A(&channels[c * channelStride + group]);
+    }
+
+    void StoreGroup(XMFLOAT4A* channels, UINT channelStride, UINT group, const BoneGroup& bones)
+    {
+        for(UINT c = 0; c < AnimationChannelCount; ++c)
+            XMStoreFloat4A(&channels[c * channelStride + group], bones.C[c]);
+    }
+
+    // Hamilton product a*b of four quaternions at once.
+    void QuaternionMultiply(const XMVECTOR* a, const XMVECTOR* b, XMVECTOR* result)
+    {
+        const XMVECTOR& ax = a[0]; const XMVECTOR& ay = a[1]; const XMVECTOR& az = a[2]; const XMVECTOR& aw = a[3];
+        const XMVECTOR& bx = b[0]; const XMVECTOR& by = b[1]; const XMVECTOR& bz = b[2]; const XMVECTOR& bw = b[3];
+
+        XMVECTOR x = XMVectorMultiply(aw, bx);
+        x = XMVectorMultiplyAdd(ax, bw, x);
+        x = XMVectorMultiplyAdd(ay, bz, x);
+        x = XMVectorNegativeMultiplySubtract(az, by, x);
+
+        XMVECTOR y = XMVectorMultiply(aw, by);
+        y = XMVectorNegativeMultiplySubtract(ax, bz, y);
+        y = XMVectorMultiplyAdd(ay, bw, y);
+        y = XMVectorMultiplyAdd(az, bx, y);
+
+        XMVECTOR z = XMVectorMultiply(aw, bz);
+        z = XMVectorMultiplyAdd(ax, by, z);
+        z = XMVectorNegativeMultiplySubtract(ay, bx, z);
+        z = XMVectorMultiplyAdd(az, bw, z);
+
+        XMVECTOR w = XMVectorMultiply(aw, bw);
+        w = XMVectorNegativeMultiplySubtract(ax, bx, w);
+        w = XMVectorNegativeMultiplySubtract(ay, by, w);
+        w = XMVectorNegativeMultiplySubtract(az, bz, w);
+
+        result[0] = x;
+        result[1] = y;
+        result[2] = z;
+        result[3] = w;
+    }
+
+    void QuaternionNormalize(XMVECTOR* q)
+    {
+        XMVECTOR lengthSq = XMVectorMultiply(q[0], q[0]);
+        lengthSq = XMVectorMultiplyAdd(q[1], q[1], lengthSq);
+        lengthSq = XMVectorMultiplyAdd(q[2], q[2], lengthSq);
+        lengthSq = XMVectorMultiplyAdd(q[3], q[3], lengthSq);
+
+        XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+        for(int i = 0; i < 4; ++i)
+            q[i] = XMVectorMultiply(q[i], invLength);
+    }
+
+    void BlendGroup(const BoneGroup& a, const BoneGroup& b, FXMVECTOR weight, BoneGroup& result)
+    {
+        for(UINT c = AnimationChannelTx; c <= AnimationChannelSz; ++c)
+            result.C[c] = XMVectorLerpV(a.C[c], b.C[c], weight);
+
+        // Flip b per bone when it is in the other hemisphere so we take the short way.
+        const XMVECTOR* qa = &a.C[AnimationChannelQx];
+        const XMVECTOR* qb = &b.C[AnimationChannelQx];
+
+        XMVECTOR dot = XMVectorMultiply(qa[0], qb[0]);
+        dot = XMVectorMultiplyAdd(qa[1], qb[1], dot);
+        dot = XMVectorMultiplyAdd(qa[2], qb[2], dot);
+        dot = XMVectorMultiplyAdd(qa[3], qb[3], dot);
+        XMVECTOR sign = XMVectorSelect(XMVectorSplatOne(), XMVectorReplicate(-1.0f), XMVectorLess(dot, XMVectorZero()));
+
+        XMVECTOR* q = &result.C[AnimationChannelQx];
+        for(int i = 0; i < 4; ++i)
+            q[i] = XMVectorLerpV(qa[i], XMVectorMultiply(qb[i], sign), weight);
+        QuaternionNormalize(q);
+    }
+
+    void AddGroup(const BoneGroup& base, const BoneGroup& additive, FXMVECTOR weight, BoneGroup& result)
+    {
+        const XMVECTOR one = XMVectorSplatOne();
+
+        for(UINT c = AnimationChannelTx; c <= AnimationChannelTz; ++c)
+            result.C[c] = XMVectorMultiplyAdd(additive.C[c], weight, base.C[c]);
+
+        for(UINT c = AnimationChannelSx; c <= AnimationChannelSz; ++c)
+            result.C[c] = XMVectorMultiply(base.C[c], XMVectorLerpV(one, additive.C[c], weight));
+
+        // Scale the rotation difference by weight: nlerp from the identity toward it.
+        const XMVECTOR* qd = &additive.C[AnimationChannelQx];
+        XMVECTOR sign = XMVectorSelect(one, XMVectorReplicate(-1.0f), XMVectorLess(qd[3], XMVectorZero()));
+
+        XMVECTOR delta[4];
+        delta[0] = XMVectorMultiply(XMVectorMultiply(qd[0], sign), weight);
+        delta[1] = XMVectorMultiply(XMVectorMultiply(qd[1], sign), weight);
+        delta[2] = XMVectorMultiply(XMVectorMultiply(qd[2], sign), weight);
+        delta[3] = XMVectorLerpV(one, XMVectorMultiply(qd[3], sign), weight);
+        QuaternionNormalize(delta);
+
+        XMVECTOR q[4];
+        QuaternionMultiply(&base.C[AnimationChannelQx], delta, q);
+        for(int i = 0; i < 4; ++i)
+            result.C[AnimationChannelQx + i] = q[i];
+    }
+
+    void DifferenceGroup(const BoneGroup& pose, const BoneGroup& reference, BoneGroup& result)
+    {
+        for(UINT c = AnimationChannelTx; c <= AnimationChannelTz; ++c)
+            result.C[c] = XMVectorSubtract(pose.C[c], reference.C[c]);
+
+        for(UINT c = AnimationChannelSx; c <= AnimationChannelSz; ++c)
+            result.C[c] = XMVectorDivide(pose.C[c], reference.C[c]);
+
+        // conjugate(reference) * pose
+        const XMVECTOR* qr = &reference.C[AnimationChannelQx];
+        XMVECTOR conjugate[4] = { XMVectorNegate(qr[0]), XMVectorNegate(qr[1]), XMVectorNegate(qr[2]), qr[3] };
+
+        XMVECTOR q[4];
+        QuaternionMultiply(conjugate, &pose.C[AnimationChannelQx], q);
+        for(int i = 0; i < 4; ++i)
+            result.C[AnimationChannelQx + i] = q[i];
+    }
+
+    // Composes S*R*T like XMMatrixAffineTransformation for the first count bones of the group.
+    void ComposeGroup(const BoneGroup& bones, UINT count, XMFLOAT4X4* boneTransforms)
+    {
+        const XMVECTOR one = XMVectorSplatOne();
+        const XMVECTOR two = XMVectorReplicate(2.0f);
+        const XMVECTOR zero = XMVectorZero();
+
+        const XMVECTOR& qx = bones.C[AnimationChannelQx];
+        const XMVECTOR& qy = bones.C[AnimationChannelQy];
+        const XMVECTOR& qz = bones.C[AnimationChannelQz];
+        const XMVECTOR& qw = bones.C[AnimationChannelQw];
+        const XMVECTOR& sx = bones.C[AnimationChannelSx];
+        const XMVECTOR& sy = bones.C[AnimationChannelSy];
+        const XMVECTOR& sz = bones.C[AnimationChannelSz];
+
+        XMVECTOR xx = XMVectorMultiply(qx, qx);
+        XMVECTOR yy = XMVectorMultiply(qy, qy);
+        XMVECTOR zz = XMVectorMultiply(qz, qz);
+        XMVECTOR xy = XMVectorMultiply(qx, qy);
+        XMVECTOR xz = XMVectorMultiply(qx, qz);
+        XMVECTOR yz = XMVectorMultiply(qy, qz);
+        XMVECTOR wx = XMVectorMultiply(qw, qx);
+        XMVECTOR wy = XMVectorMultiply(qw, qy);
+        XMVECTOR wz = XMVectorMultiply(qw, qz);
+
+        XMVECTOR r00 = XMVectorNegativeMultiplySubtract(two, XMVectorAdd(yy, zz), one);
+        XMVECTOR r01 = XMVectorMultiply(two, XMVectorAdd(xy, wz));
+        XMVECTOR r02 = XMVectorMultiply(two, XMVectorSubtract(xz, wy));
+        XMVECTOR r10 = XMVectorMultiply(two, XMVectorSubtract(xy, wz));
+        XMVECTOR r11 = XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, zz), one);
+        XMVECTOR r12 = XMVectorMultiply(two, XMVectorAdd(yz, wx));
+        XMVECTOR r20 = XMVectorMultiply(two, XMVectorAdd(xz, wy));
+        XMVECTOR r21 = XMVectorMultiply(two, XMVectorSubtract(yz, wx));
+        XMVECTOR r22 = XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, yy), one);
+
+        // Transposing turns "one channel of four bones" into "one row of each bone".
+        XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(
+            XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero));
+        XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(
+            XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero));
+        XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(
+            XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero));
+        XMMATRIX row3 = XMMatrixTranspose(XMMATRIX(
+            bones.C[AnimationChannelTx], bones.C[AnimationChannelTy], bones.C[AnimationChannelTz], one));
+
+        for(UINT i = 0; i < count; ++i)
+        {
+            XMStoreFloat4x4(&boneTransforms[i],
+                XMMATRIX(row0.r[i], row1.r[i], row2.r[i], row3.r[i]));
+        }
+    }
+
+    void SetIdentityChannels(XMFLOAT4A* channels, UINT numGroups)
+    {
+        for(UINT c = 0; c < AnimationChannelCount; ++c)
+        {
+            bool isOne = (c >= AnimationChannelSx && c <= AnimationChannelSz) || c == AnimationChannelQw;
+            float v = isOne ? 1.0f : 0.0f;
+            for(UINT g = 0; g < numGroups; ++g)
+                channels[c * numGroups + g] = XMFLOAT4A(v, v, v, v);
+        }
+    }
+}
+
+//
+// BoneMask
+//
+
+void BoneMask::Resize(UINT numBones, float weight)
+{
+    mNumBones = numBones;
+    mWeights.assign((numBones + 3) / 4, XMFLOAT4A(weight, weight, weight, weight));
+}
+
+UINT BoneMask::BoneCount()const
+{
+    return mNumBones;
+}
+
+float BoneMask::GetWeight(UINT bone)const
+{
+    return (&mWeights[bone / 4].x)[bone % 4];
+}
+
+void BoneMask::SetWeight(UINT bone, float weight)
+{
+    (&mWeights[bone / 4].x)[bone % 4] = weight;
+}
+
+void BoneMask::SetSubtreeWeight(const std::vector<int>& boneHierarchy, UINT rootBone, float weight)
+{
+    // Parents come before their children, so one forward pass finds the subtree.
+    std::vector<bool> inSubtree(boneHierarchy.size(), false);
+    inSubtree[rootBone] = true;
+    SetWeight(rootBone, weight);
+
+    for(UINT i = rootBone + 1; i < (UINT)boneHierarchy.size(); ++i)
+    {
+        int parent = boneHierarchy[i];
+        if(parent >= 0 && inSubtree[parent])
+        {
+            inSubtree[i] = true;
+            SetWeight(i, weight);
+        }
+    }
+}
+
+//
+// LocalPose
+//
+
+void LocalPose::Resize(UINT numBones)
+{
+    mNumBones = numBones;
+    mNumGroups = (numBones + 3) / 4;
+
+    if(mChannels.size() < (size_t)mNumGroups * AnimationChannelCount)
+        mChannels.resize((size_t)mNumGroups * AnimationChannelCount);
+
+    SetIdentity();
+}
+
+void LocalPose::SetIdentity()
+{
+    SetIdentityChannels(mChannels.data(), mNumGroups);
+}
+
+UINT LocalPose::BoneCount()const
+{
+    return mNumBones;
+}
+
+UINT LocalPose::GroupCount()const
+{
+    return mNumGroups;
+}
+
+void LocalPose::SetBone(UINT bone, const XMFLOAT3& scale, const XMFLOAT4& rotationQuat, const XMFLOAT3& translation)
+{
+    const float values[AnimationChannelCount] =
+    {
+        translation.x, translation.y, translation.z,
+        scale.x, scale.y, scale.z,
+        rotationQuat.x, rotationQuat.y, rotationQuat.z, rotationQuat.w
+    };
+
+    for(UINT c = 0; c < AnimationChannelCount; ++c)
+        (&mChannels[(size_t)c * mNumGroups + bone / 4].x)[bone % 4] = values[c];
+}
+
+void LocalPose::GetBone(UINT bone, XMFLOAT3& scale, XMFLOAT4& rotationQuat, XMFLOAT3& translation)const
+{
+    float values[AnimationChannelCount];
+    for(UINT c = 0; c < AnimationChannelCount; ++c)
+        values[c] = (&mChannels[(size_t)c * mNumGroups + bone / 4].x)[bone % 4];
+
+    translation = XMFLOAT3(values[AnimationChannelTx], values[AnimationChannelTy], values[AnimationChannelTz]);
+    scale = XMFLOAT3(values[AnimationChannelSx], values[AnimationChannelSy], values[AnimationChannelSz]);
+    rotationQuat = XMFLOAT4(values[AnimationChannelQx], values[AnimationChannelQy], values[AnimationChannelQz], values[AnimationChannelQw]);
+}
+
+void LocalPose::Blend(const LocalPose& a, const LocalPose& b, float weight, const BoneMask* mask)
+{
+    assert(a.mNumBones == b.mNumBones);
+    if(this != &a && this != &b)
+        Resize(a.mNumBones);
+
+    for(UINT g = 0; g < mNumGroups; ++g)
+    {
+        XMVECTOR w = XMVectorReplicate(weight);
+        if(mask != nullptr)
+            w = XMVectorMultiply(w, mask->LoadGroup(g));
+
+        BoneGroup bonesA, bonesB, result;
+        LoadGroup(a.mChannels.data(), mNumGroups, g, bonesA);
+        LoadGroup(b.mChannels.data(), mNumGroups, g, bonesB);
+        BlendGroup(bonesA, bonesB, w, result);
+        StoreGroup(mChannels.data(), mNumGroups, g, result);
+    }
+}
+
+void LocalPose::Add(const LocalPose& base, const LocalPose& additive, float weight, const BoneMask* mask)
+{
+    assert(base.mNumBones == additive.mNumBones);
+    if(this != &base && this != &additive)
+        Resize(base.mNumBones);
+
+    for(UINT g = 0; g < mNumGroups; ++g)
+    {
+        XMVECTOR w = XMVectorReplicate(weight);
+        if(mask != nullptr)
+            w = XMVectorMultiply(w, mask->LoadGroup(g));
+
+        BoneGroup bonesBase, bonesAdditive, result;
+        LoadGroup(base.mChannels.data(), mNumGroups, g, bonesBase);
+        LoadGroup(additive.mChannels.data(), mNumGroups, g, bonesAdditive);
+        AddGroup(bonesBase, bonesAdditive, w, result);
+        StoreGroup(mChannels.data(), mNumGroups, g, result);
+    }
+}
+
+void LocalPose::MakeAdditive(const LocalPose& pose, const LocalPose& reference)
+{
+    assert(pose.mNumBones == reference.mNumBones);
+    if(this != &pose && this != &reference)
+        Resize(pose.mNumBones);
+
+    for(UINT g = 0; g < mNumGroups; ++g)
+    {
+        BoneGroup bonesPose, bonesReference, result;
+        LoadGroup(pose.mChannels.data(), mNumGroups, g, bonesPose);
+        LoadGroup(reference.mChannels.data(), mNumGroups, g, bonesReference);
+        DifferenceGroup(bonesPose, bonesReference, result);
+        StoreGroup(mChannels.data(), mNumGroups, g, result);
+    }
+}
+
+void LocalPose::ToTransforms(XMFLOAT4X4* boneTransforms)const
+{
+    for(UINT g = 0; g < mNumGroups; ++g)
+    {
+        BoneGroup bones;
+        LoadGroup(mChannels.data(), mNumGroups, g, bones);
+        ComposeGroup(bones, std::min(4u, mNumBones - g * 4), boneTransforms + g * 4);
+    }
+}
+
+//
+// CompiledAnimationClip
+//
+
+void CompiledAnimationClip::Build(const AnimationClip& clip)
+{
+    mNumBones = (UINT)clip.BoneAnimations.size();
+    mNumGroups = (mNumBones + 3) / 4;
+
+    // The shared timeline is the union of every bone's key times.
+    mTimes.clear();
+    for(const BoneAnimation& boneAnim : clip.BoneAnimations)
+    {
+        for(const Keyframe& key : boneAnim.Keyframes)
+            mTimes.push_back(key.TimePos);
+    }
+
+    std::sort(mTimes.begin(), mTimes.end());
+    mTimes.erase(std::unique(mTimes.begin(), mTimes.end()), mTimes.end());
+
+    if(mTimes.empty())
+        mTimes.push_back(0.0f);
+
+    const UINT numKeys = (UINT)mTimes.size();
+
+    // Padding bones get the identity transform so the SIMD math never sees garbage.
+    mChannels.resize((size_t)numKeys * AnimationChannelCount * mNumGroups);
+    for(UINT k = 0; k < numKeys; ++k)
+        SetIdentityChannels(&mChannels[GroupIndex(k, 0, 0)], mNumGroups);
+
+    for(UINT b = 0; b < mNumBones; ++b)
+    {
+        const BoneAnimation& boneAnim = clip.BoneAnimations[b];
+        if(boneAnim.Keyframes.empty())
+            continue;
+
+        XMVECTOR prevQ = XMQuaternionIdentity();
+        for(UINT k = 0; k < numKeys; ++k)
+        {
+            XMVECTOR S, Q, P;
+            boneAnim.Interpolate(mTimes[k], S, Q, P);
+
+            // Keep consecutive keys in the same hemisphere.  q and -q are the same
+            // rotation, and it lets the sampler skip the shortest path test that
+            // XMQuaternionSlerp does per call.
+            if(k > 0 && XMVectorGetX(XMQuaternionDot(prevQ, Q)) < 0.0f)
+                Q = XMVectorNegate(Q);
+            prevQ = Q;
+
+            XMFLOAT3 s, p;
+            XMFLOAT4 q;
+            XMStoreFloat3(&s, S);
+            XMStoreFloat3(&p, P);
+            XMStoreFloat4(&q, Q);
+
+            ChannelValue(k, AnimationChannelTx, b) = p.x;
+            ChannelValue(k, AnimationChannelTy, b) = p.y;
+            ChannelValue(k, AnimationChannelTz, b) = p.z;
+            ChannelValue(k, AnimationChannelSx, b) = s.x;
+            ChannelValue(k, AnimationChannelSy, b) = s.y;
+            ChannelValue(k, AnimationChannelSz, b) = s.z;
+            ChannelValue(k, AnimationChannelQx, b) = q.x;
+            ChannelValue(k, AnimationChannelQy, b) = q.y;
+            ChannelValue(k, AnimationChannelQz, b) = q.z;
+            ChannelValue(k, AnimationChannelQw, b) = q.w;
+        }
+    }
+}
+
+void CompiledAnimationClip::MakeAdditive(const LocalPose& reference)
+{
+    assert(reference.BoneCount() == mNumBones);
+
+    for(UINT k = 0; k < (UINT)mTimes.size(); ++k)
+    {
+        XMFLOAT4A* key = &mChannels[GroupIndex(k, 0, 0)];
+        for(UINT g = 0; g < mNumGroups; ++g)
+        {
+            BoneGroup bonesKey, bonesReference, result;
+            LoadGroup(key, mNumGroups, g, bonesKey);
+            for(UINT c = 0; c < AnimationChannelCount; ++c)
+                bonesReference.C[c] = reference.Load(c, g);
+
+            // Multiplying every key by the same unit quaternion keeps consecutive
+            // keys in the same hemisphere, so the slerp in SampleGroups still holds.
+            DifferenceGroup(bonesKey, bonesReference, result);
+            StoreGroup(key, mNumGroups, g, result);
+        }
+    }
+}
+
+UINT CompiledAnimationClip::BoneCount()const
+{
+    return mNumBones;
+}
+
+UINT CompiledAnimationClip::KeyframeCount()const
+{
+    return (UINT)mTimes.size();
+}
+
+float CompiledAnimationClip::GetClipStartTime()const
+{
+    return mTimes.front();
+}
+
+float CompiledAnimationClip::GetClipEndTime()const
+{
+    return mTimes.back();
+}
+
+size_t CompiledAnimationClip::GetMemoryByteSize()const
+{
+    return mTimes.size() * sizeof(float) + mChannels.size() * sizeof(XMFLOAT4A);
+}
+
+UINT CompiledAnimationClip::FindKey(float t, AnimationCursor* cursor)const
+{
+    const UINT numKeys = (UINT)mTimes.size();
+    if(numKeys < 2)
+        return 0;
+
+    const UINT lastSegment = numKeys - 2;
+
+    if(cursor != nullptr)
+    {
+        UINT k = std::min(cursor->Key, lastSegment);
+
+        // Same segment as last time, or the one right after it.
+        if(t >= mTimes[k] && t < mTimes[k + 1])
+            return k;
+        if(k < lastSegment && t >= mTimes[k + 1] && t < mTimes[k + 2])
+        {
+            cursor->Key = k + 1;
+            return k + 1;
+        }
+    }
+
+    UINT k = 0;
+    if(t >= mTimes.back())
+        k = lastSegment;
+    else if(t > mTimes.front())
+        k = (UINT)(std::upper_bound(mTimes.begin(), mTimes.end(), t) - mTimes.begin()) - 1;
+
+    if(cursor != nullptr)
+        cursor->Key = k;
+
+    return k;
+}
+
+template<typename Fn>
+void CompiledAnimationClip::SampleGroups(float t, AnimationCursor* cursor, Fn&& fn)const
+{
+    const UINT k0 = FindKey(t, cursor);
+    const UINT k1 = std::min(k0 + 1, (UINT)mTimes.size() - 1);
+
+    float lerpPercent = 0.0f;
+    if(k1 != k0)
+        lerpPercent = MathHelper::Clamp((t - mTimes[k0]) / (mTimes[k1] - mTimes[k0]), 0.0f, 1.0f);
+
+    const XMFLOAT4A* key0 = &mChannels[GroupIndex(k0, 0, 0)];
+    const XMFLOAT4A* key1 = &mChannels[GroupIndex(k1, 0, 0)];
+
+    const XMVECTOR one = XMVectorSplatOne();
+    const XMVECTOR u = XMVectorReplicate(lerpPercent);
+    const XMVECTOR oneMinusU = XMVectorReplicate(1.0f - lerpPercent);
+
+    // Same threshold as XMQuaternionSlerp: fall back to lerp for nearly equal keys.
+    const XMVECTOR slerpThreshold = XMVectorReplicate(1.0f - 0.00001f);
+
+    for(UINT g = 0; g < mNumGroups; ++g)
+    {
+        BoneGroup bones0, bones1, bones;
+        LoadGroup(key0, mNumGroups, g, bones0);
+        LoadGroup(key1, mNumGroups, g, bones1);
+
+        for(UINT c = AnimationChannelTx; c <= AnimationChannelSz; ++c)
+            bones.C[c] = XMVectorLerpV(bones0.C[c], bones1.C[c], u);
+
+        //
+        // Slerp four quaternions at once.  Build() made every consecutive pair of
+        // keys have a non-negative dot product, so no sign flip is needed here.
+        //
+
+        const XMVECTOR* q0 = &bones0.C[AnimationChannelQx];
+        const XMVECTOR* q1 = &bones1.C[AnimationChannelQx];
+
+        XMVECTOR cosOmega = XMVectorMultiply(q0[0], q1[0]);
+        cosOmega = XMVectorMultiplyAdd(q0[1], q1[1], cosOmega);
+        cosOmega = XMVectorMultiplyAdd(q0[2], q1[2], cosOmega);
+        cosOmega = XMVectorMultiplyAdd(q0[3], q1[3], cosOmega);
+        cosOmega = XMVectorMin(cosOmega, one);
+
+        XMVECTOR omega = XMVectorACos(cosOmega);
+        XMVECTOR invSinOmega = XMVectorReciprocal(XMVectorSin(omega));
+        XMVECTOR s0 = XMVectorMultiply(XMVectorSin(XMVectorMultiply(oneMinusU, omega)), invSinOmega);
+        XMVECTOR s1 = XMVectorMultiply(XMVectorSin(XMVectorMultiply(u, omega)), invSinOmega);
+
+        XMVECTOR useLerp = XMVectorGreaterOrEqual(cosOmega, slerpThreshold);
+        s0 = XMVectorSelect(s0, oneMinusU, useLerp);
+        s1 = XMVectorSelect(s1, u, useLerp);
+
+        for(int i = 0; i < 4; ++i)
+            bones.C[AnimationChannelQx + i] = XMVectorMultiplyAdd(q0[i], s0, XMVectorMultiply(q1[i], s1));
+
+        fn(g, bones);
+    }
+}
+
+void CompiledAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, AnimationCursor* cursor)const
+{
+    assert(boneTransforms.size() >= mNumBones);
+    Interpolate(t, boneTransforms.data(), cursor);
+}
+
+void CompiledAnimationClip::Interpolate(float t, XMFLOAT4X4* boneTransforms, AnimationCursor* cursor)const
+{
+    SampleGroups(t, cursor, [&](UINT g, const BoneGroup& bones)
+    {
+        ComposeGroup(bones, std::min(4u, mNumBones - g * 4), boneTransforms + g * 4);
+    });
+}
+
+void CompiledAnimationClip::SamplePose(float t, LocalPose& pose, AnimationCursor* cursor)const
+{
+    if(pose.BoneCount() != mNumBones)
+        pose.Resize(mNumBones);
+
+    SampleGroups(t, cursor, [&](UINT g, const BoneGroup& bones)
+    {
+        for(UINT c = 0; c < AnimationChannelCount; ++c)
+            pose.Store(c, g, bones.C[c]);
+    });
+}
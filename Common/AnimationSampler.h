@@ -0,0 +1,184 @@
+//***************************************************************************************
+// AnimationSampler.h
+//
+// Compiled, structure-of-arrays form of an AnimationClip.  AnimationClip stores an
+// array of Keyframe structs per bone and BoneAnimation::Interpolate searches each
+// bone's keys separately.  CompiledAnimationClip resamples every bone onto one shared
+// key timeline so a single key lookup serves the whole skeleton, and it stores each
+// channel (translation x, y, z, scale x, y, z, quaternion x, y, z, w) of four bones
+// side by side so one XMVECTOR holds the same channel of four bones.  Interpolation
+// and matrix composition then run four bones per SIMD instruction.
+//
+// LocalPose uses the same layout for a single pose.  Clips are sampled into local
+// scale/rotation/translation poses, which are blended, masked and added together,
+// and only the final pose is turned into matrices (see SkinnedData::GetFinalTransforms).
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct AnimationClip;
+
+enum AnimationChannel
+{
+    AnimationChannelTx = 0, AnimationChannelTy, AnimationChannelTz,
+    AnimationChannelSx, AnimationChannelSy, AnimationChannelSz,
+    AnimationChannelQx, AnimationChannelQy, AnimationChannelQz, AnimationChannelQw,
+    AnimationChannelCount
+};
+
+///<summary>
+/// Remembers the key segment found by the last sample.  When a clip plays forward
+/// the next sample is almost always in the same or the next segment, so passing a
+/// cursor turns the key lookup into one or two comparisons.  Use one cursor per
+/// playing instance.
+///</summary>
+struct AnimationCursor
+{
+    UINT Key = 0;
+};
+
+///<summary>
+/// Per bone weights in [0, 1] that restrict a blend or additive layer to part of
+/// the skeleton, e.g. 1 for the spine and arms and 0 for the legs.
+///</summary>
+class BoneMask
+{
+public:
+    void Resize(UINT numBones, float weight = 0.0f);
+
+    UINT BoneCount()const;
+
+    float GetWeight(UINT bone)const;
+    void SetWeight(UINT bone, float weight);
+
+    // Sets the weight of rootBone and every bone below it.  boneHierarchy gives the
+    // parent of each bone (see SkinnedData::GetBoneHierarchy); parents come first.
+    void SetSubtreeWeight(const std::vector<int>& boneHierarchy, UINT rootBone, float weight);
+
+    // Weights of bones [4*group, 4*group+4).
+    DirectX::XMVECTOR LoadGroup(UINT group)const
+    {
+        return DirectX::XMLoadFloat4A(&mWeights[group]);
+    }
+
+private:
+    UINT mNumBones = 0;
+    std::vector<DirectX::XMFLOAT4A> mWeights;
+};
+
+///<summary>
+/// Local (to-parent) scale, rotation and translation of every bone, stored as
+/// [channel][four bone group] like one key of a CompiledAnimationClip.
+///</summary>
+class LocalPose
+{
+public:
+    // Resizes the pose and sets every bone to the identity.  Only allocates when the
+    // pose grows.
+    void Resize(UINT numBones);
+    void SetIdentity();
+
+    UINT BoneCount()const;
+    UINT GroupCount()const;
+
+    void SetBone(UINT bone, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotationQuat,
+        const DirectX::XMFLOAT3& translation);
+    void GetBone(UINT bone, DirectX::XMFLOAT3& scale, DirectX::XMFLOAT4& rotationQuat,
+        DirectX::XMFLOAT3& translation)const;
+
+    // this = a blended toward b by weight (times the mask weight per bone).  Scale and
+    // translation are lerped and rotations are normalized-lerped along the shortest
+    // path.  this may alias a or b.
+    void Blend(const LocalPose& a, const LocalPose& b, float weight, const BoneMask* mask = nullptr);
+
+    // this = additive applied on top of base with the given weight.  additive must
+    // be a difference pose made by MakeAdditive.  this may alias base or additive.
+    void Add(const LocalPose& base, const LocalPose& additive, float weight, const BoneMask* mask = nullptr);
+
+    // this = the difference that takes reference to pose, so that
+    // Add(reference, this, 1) gives pose back.
+    void MakeAdditive(const LocalPose& pose, const LocalPose& reference);
+
+    // Composes S*R*T for every bone, like XMMatrixAffineTransformation.
+    // boneTransforms must hold BoneCount() matrices.
+    void ToTransforms(DirectX::XMFLOAT4X4* boneTransforms)const;
+
+    DirectX::XMVECTOR Load(UINT channel, UINT group)const
+    {
+        return DirectX::XMLoadFloat4A(&mChannels[(size_t)channel * mNumGroups + group]);
+    }
+
+    void Store(UINT channel, UINT group, DirectX::FXMVECTOR v)
+    {
+        DirectX::XMStoreFloat4A(&mChannels[(size_t)channel * mNumGroups + group], v);
+    }
+
+private:
+    UINT mNumBones = 0;
+    UINT mNumGroups = 0;
+
+    // [channel][group]
+    std::vector<DirectX::XMFLOAT4A> mChannels;
+};
+
+class CompiledAnimationClip
+{
+public:
+    // Resamples every bone of clip onto the union of all bone key times.  Sampling
+    // the compiled clip gives the same result as AnimationClip::Interpolate because
+    // lerp and slerp between two keys pass exactly through the values at the
+    // inserted times.
+    void Build(const AnimationClip& clip);
+
+    // Turns every key into a difference pose relative to reference, so the clip can
+    // be layered with LocalPose::Add.
+    void MakeAdditive(const LocalPose& reference);
+
+    UINT BoneCount()const;
+    UINT KeyframeCount()const;
+
+    float GetClipStartTime()const;
+    float GetClipEndTime()const;
+
+    // Bytes used by the key times and channel arrays.
+    size_t GetMemoryByteSize()const;
+
+    // Same as AnimationClip::Interpolate: writes the to-parent transform of every
+    // bone at time t.  boneTransforms must hold BoneCount() matrices.
+    void Interpolate(float t, DirectX::XMFLOAT4X4* boneTransforms, AnimationCursor* cursor = nullptr)const;
+    void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, AnimationCursor* cursor = nullptr)const;
+
+    // Samples the clip at time t into a local pose without building any matrices.
+    void SamplePose(float t, LocalPose& pose, AnimationCursor* cursor = nullptr)const;
+
+private:
+    // Returns k such that mTimes[k] <= t < mTimes[k+1], clamped to a valid segment.
+    UINT FindKey(float t, AnimationCursor* cursor)const;
+
+    // Interpolates every channel at time t and calls fn(group, bones) per bone group.
+    template<typename Fn>
+    void SampleGroups(float t, AnimationCursor* cursor, Fn&& fn)const;
+
+    size_t GroupIndex(UINT key, UINT channel, UINT group)const
+    {
+        return ((size_t)key * AnimationChannelCount + channel) * mNumGroups + group;
+    }
+
+    float& ChannelValue(UINT key, UINT channel, UINT bone)
+    {
+        return (&mChannels[GroupIndex(key, channel, bone / 4)].x)[bone % 4];
+    }
+
+private:
+    UINT mNumBones = 0;
+
+    // Number of four bone groups; the last group is padded with identity bones.
+    UINT mNumGroups = 0;
+
+    std::vector<float> mTimes;
+
+    // [key][channel][group], each XMFLOAT4A holds one channel of four bones.
+    std::vector<DirectX::XMFLOAT4A> mChannels;
+};
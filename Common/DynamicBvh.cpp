@@ -0,0 +1,489 @@
+//***************************************************************************************
+// DynamicBvh.cpp
+//***************************************************************************************
+
+#include "DynamicBvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // Half the surface area of a box, which is all the insertion cost needs.
+    float HalfArea(const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        const float dx = max.x - min.x;
+        const float dy = max.y - min.y;
+        const float dz = max.z - min.z;
+        return dx*dy + dy*dz + dz*dx;
+    }
+
+    void Union(const XMFLOAT3& minA, const XMFLOAT3& maxA, const XMFLOAT3& minB, const XMFLOAT3& maxB,
+               XMFLOAT3& min, XMFLOAT3& max)
+    {
+        min = XMFLOAT3(std::min(minA.x, minB.x), std::min(minA.y, minB.y), std::min(minA.z, minB.z));
+        max = XMFLOAT3(std::max(maxA.x, maxB.x), std::max(maxA.y, maxB.y), std::max(maxA.z, maxB.z));
+    }
+
+    float UnionHalfArea(const XMFLOAT3& minA, const XMFLOAT3& maxA, const XMFLOAT3& minB, const XMFLOAT3& maxB)
+    {
+        XMFLOAT3 min, max;
+        Union(minA, maxA, minB, maxB, min, max);
+        return HalfArea(min, max);
+    }
+
+    bool Contains(const XMFLOAT3& outerMin, const XMFLOAT3& outerMax, const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        return outerMin.x <= min.x && outerMin.y <= min.y && outerMin.z <= min.z &&
+               max.x <= outerMax.x && max.y <= outerMax.y && max.z <= outerMax.z;
+    }
+
+    void ToMinMax(const BoundingBox& box, float margin, XMFLOAT3& min, XMFLOAT3& max)
+    {
+        const XMFLOAT3& c = box.Center;
+        const XMFLOAT3& e = box.Extents;
+        min = XMFLOAT3(c.x - e.x - margin, c.y - e.y - margin, c.z - e.z - margin);
+        max = XMFLOAT3(c.x + e.x + margin, c.y + e.y + margin, c.z + e.z + margin);
+    }
+
+    BoundingBox ToBox(const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        return BoundingBox(
+            XMFLOAT3(0.5f*(min.x + max.x), 0.5f*(min.y + max.y), 0.5f*(min.z + max.z)),
+            XMFLOAT3(0.5f*(max.x - min.x), 0.5f*(max.y - min.y), 0.5f*(max.z - min.z)));
+    }
+
+    enum class PlaneSide
+    {
+        Outside,
+        Straddling,
+        Inside
+    };
+
+    // Where a box lies relative to the frustum, by its center's distance to each plane
+    // against how far the box reaches along the plane normal.
+    PlaneSide ClassifyBox(const XMFLOAT4 planes[6], const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        const XMFLOAT3 c(0.5f*(min.x + max.x), 0.5f*(min.y + max.y), 0.5f*(min.z + max.z));
+        const XMFLOAT3 e(0.5f*(max.x - min.x), 0.5f*(max.y - min.y), 0.5f*(max.z - min.z));
+
+        PlaneSide side = PlaneSide::Inside;
+        for(int p = 0; p < 6; ++p)
+        {
+            const XMFLOAT4& n = planes[p];
+            const float s = n.x*c.x + n.y*c.y + n.z*c.z + n.w;
+            const float r = fabsf(n.x)*e.x + fabsf(n.y)*e.y + fabsf(n.z)*e.z;
+            if(s + r < 0.0f)
+                return PlaneSide::Outside;
+            if(s - r < 0.0f)
+                side = PlaneSide::Straddling;
+        }
+
+        return side;
+    }
+
+    bool OverlapsSphere(const BoundingSphere& sphere, const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        const XMFLOAT3& c = sphere.Center;
+        const float dx = std::max(std::max(min.x - c.x, c.x - max.x), 0.0f);
+        const float dy = std::max(std::max(min.y - c.y, c.y - max.y), 0.0f);
+        const float dz = std::max(std::max(min.z - c.z, c.z - max.z), 0.0f);
+        return dx*dx + dy*dy + dz*dz <= sphere.Radius*sphere.Radius;
+    }
+
+    // Slab test; the entry distance of the ray into the box, or a negative value if it
+    // misses it before maxT.
+    float RayEntry(FXMVECTOR origin, FXMVECTOR invDir, float maxT, const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        const XMVECTOR t0 = (XMLoadFloat3(&min) - origin) * invDir;
+        const XMVECTOR t1 = (XMLoadFloat3(&max) - origin) * invDir;
+        const XMVECTOR tNear = XMVectorMin(t0, t1);
+        const XMVECTOR tFar = XMVectorMax(t0, t1);
+
+        const float enter = std::max(std::max(XMVectorGetX(tNear), XMVectorGetY(tNear)), std::max(XMVectorGetZ(tNear), 0.0f));
+        const float exit = std::min(std::min(XMVectorGetX(tFar), XMVectorGetY(tFar)), std::min(XMVectorGetZ(tFar), maxT));
+        return enter <= exit ? enter : -1.0f;
+    }
+}
+
+DynamicBvh::DynamicBvh(const DynamicBvhSettings& settings) :
+    mSettings(settings)
+{
+}
+
+UINT DynamicBvh::Insert(const BoundingBox& bounds, void* userData)
+{
+    const UINT leaf = AllocateNode();
+    Node& node = mNodes[leaf];
+    ToMinMax(bounds, mSettings.Margin, node.Min, node.Max);
+    node.UserData = userData;
+    node.Height = 0;
+
+    InsertLeaf(leaf);
+    mProxyCount++;
+
+    return leaf;
+}
+
+void DynamicBvh::Remove(UINT proxy)
+{
+    assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf() && mNodes[proxy].Height == 0);
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    mProxyCount--;
+}
+
+bool DynamicBvh::Update(UINT proxy, const BoundingBox& bounds)
+{
+    assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf() && mNodes[proxy].Height == 0);
+
+    XMFLOAT3 min, max;
+    ToMinMax(bounds, 0.0f, min, max);
+    if(Contains(mNodes[proxy].Min, mNodes[proxy].Max, min, max))
+        return false;
+
+    RemoveLeaf(proxy);
+    ToMinMax(bounds, mSettings.Margin, mNodes[proxy].Min, mNodes[proxy].Max);
+    InsertLeaf(proxy);
+
+    return true;
+}
+
+void DynamicBvh::Clear()
+{
+    mNodes.clear();
+    mRoot = NullNode;
+    mFreeList = NullNode;
+    mProxyCount = 0;
+}
+
+void* DynamicBvh::GetUserData(UINT proxy)const
+{
+    return mNodes[proxy].UserData;
+}
+
+BoundingBox DynamicBvh::GetLooseBounds(UINT proxy)const
+{
+    return ToBox(mNodes[proxy].Min, mNodes[proxy].Max);
+}
+
+BoundingBox DynamicBvh::GetBounds()const
+{
+    if(mRoot == NullNode)
+        return BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+    return ToBox(mNodes[mRoot].Min, mNodes[mRoot].Max);
+}
+
+UINT DynamicBvh::ProxyCount()const
+{
+    return mProxyCount;
+}
+
+UINT DynamicBvh::Height()const
+{
+    return mRoot == NullNode ? 0 : (UINT)mNodes[mRoot].Height + 1;
+}
+
+UINT DynamicBvh::AllocateNode()
+{
+    if(mFreeList == NullNode)
+    {
+        mNodes.emplace_back();
+        return (UINT)mNodes.size() - 1;
+    }
+
+    const UINT node = mFreeList;
+    mFreeList = mNodes[node].Parent;
+    mNodes[node] = Node();
+    return node;
+}
+
+void DynamicBvh::FreeNode(UINT node)
+{
+    mNodes[node].Parent = mFreeList;
+    mNodes[node].Height = -1;
+    mNodes[node].UserData = nullptr;
+    mFreeList = node;
+}
+
+void DynamicBvh::InsertLeaf(UINT leaf)
+{
+    if(mRoot == NullNode)
+    {
+        mRoot = leaf;
+        mNodes[leaf].Parent = NullNode;
+        return;
+    }
+
+    // Go down to the sibling that makes the tree grow the least.  Pairing the leaf with
+    // a node costs the area of their union for the new parent, plus what every ancestor
+    // of the node grows by, which is paid whichever node below it is picked.
+    const XMFLOAT3 leafMin = mNodes[leaf].Min;
+    const XMFLOAT3 leafMax = mNodes[leaf].Max;
+
+    UINT index = mRoot;
+    while(!mNodes[index].IsLeaf())
+    {
+        const Node& node = mNodes[index];
+        const float area = HalfArea(node.Min, node.Max);
+        const float combinedArea = UnionHalfArea(node.Min, node.Max, leafMin, leafMax);
+
+        const float pairCost = 2.0f*combinedArea;
+        const float inheritedCost = 2.0f*(combinedArea - area);
+
+        float childCost[2];
+        for(int c = 0; c < 2; ++c)
+        {
+            const Node& child = mNodes[node.Child[c]];
+            const float unionArea = UnionHalfArea(child.Min, child.Max, leafMin, leafMax);
+            childCost[c] = (child.IsLeaf() ? unionArea : unionArea - HalfArea(child.Min, child.Max)) + inheritedCost;
+        }
+
+        if(pairCost < childCost[0] && pairCost < childCost[1])
+            break;
+
+        index = childCost[0] < childCost[1] ? node.Child[0] : node.Child[1];
+    }
+
+    const UINT sibling = index;
+    const UINT oldParent = mNodes[sibling].Parent;
+    const UINT newParent = AllocateNode();
+
+    Node& parent = mNodes[newParent];
+    parent.Parent = oldParent;
+    parent.Child[0] = sibling;
+    parent.Child[1] = leaf;
+    parent.Height = mNodes[sibling].Height + 1;
+    Union(mNodes[sibling].Min, mNodes[sibling].Max, leafMin, leafMax, parent.Min, parent.Max);
+
+    if(oldParent == NullNode)
+        mRoot = newParent;
+    else if(mNodes[oldParent].Child[0] == sibling)
+        mNodes[oldParent].Child[0] = newParent;
+    else
+        mNodes[oldParent].Child[1] = newParent;
+
+    mNodes[sibling].Parent = newParent;
+    mNodes[leaf].Parent = newParent;
+
+    RefitAncestors(oldParent);
+}
+
+void DynamicBvh::RemoveLeaf(UINT leaf)
+{
+    if(leaf == mRoot)
+    {
+        mRoot = NullNode;
+        return;
+    }
+
+    // The leaf's sibling takes the place of their parent.
+    const UINT parent = mNodes[leaf].Parent;
+    const UINT grandParent = mNodes[parent].Parent;
+    const UINT sibling = mNodes[parent].Child[0] == leaf ? mNodes[parent].Child[1] : mNodes[parent].Child[0];
+
+    mNodes[sibling].Parent = grandParent;
+    mNodes[leaf].Parent = NullNode;
+    FreeNode(parent);
+
+    if(grandParent == NullNode)
+    {
+        mRoot = sibling;
+        return;
+    }
+
+    if(mNodes[grandParent].Child[0] == parent)
+        mNodes[grandParent].Child[0] = sibling;
+    else
+        mNodes[grandParent].Child[1] = sibling;
+
+    RefitAncestors(grandParent);
+}
+
+void DynamicBvh::RefitAncestors(UINT node)
+{
+    while(node != NullNode)
+    {
+        node = Balance(node);
+
+        Node& n = mNodes[node];
+        const Node& a = mNodes[n.Child[0]];
+        const Node& b = mNodes[n.Child[1]];
+        n.Height = 1 + std::max(a.Height, b.Height);
+        Union(a.Min, a.Max, b.Min, b.Max, n.Min, n.Max);
+
+        node = n.Parent;
+    }
+}
+
+UINT DynamicBvh::Balance(UINT iA)
+{
+    Node& A = mNodes[iA];
+    if(A.IsLeaf() || A.Height < 2)
+        return iA;
+
+    const UINT iB = A.Child[0];
+    const UINT iC = A.Child[1];
+    const int balance = mNodes[iC].Height - mNodes[iB].Height;
+    if(balance >= -1 && balance <= 1)
+        return iA;
+
+    // Rotate the taller child U up into A's place.  A keeps the shorter child and takes
+    // the shorter of U's children; U keeps its taller child and takes A.
+    const int tall = balance > 1 ? 1 : 0;
+    const UINT iU = A.Child[tall];
+    const UINT iShort = A.Child[1 - tall];
+    Node& U = mNodes[iU];
+
+    const UINT iX = U.Child[0];
+    const UINT iY = U.Child[1];
+    const bool xTaller = mNodes[iX].Height > mNodes[iY].Height;
+    const UINT iKeep = xTaller ? iX : iY;
+    const UINT iGive = xTaller ? iY : iX;
+
+    U.Parent = A.Parent;
+    if(U.Parent == NullNode)
+        mRoot = iU;
+    else if(mNodes[U.Parent].Child[0] == iA)
+        mNodes[U.Parent].Child[0] = iU;
+    else
+        mNodes[U.Parent].Child[1] = iU;
+
+    U.Child[0] = iA;
+    U.Child[1] = iKeep;
+    A.Parent = iU;
+    A.Child[tall] = iGive;
+    A.Child[1 - tall] = iShort;
+    mNodes[iGive].Parent = iA;
+
+    const Node& shortNode = mNodes[iShort];
+    const Node& give = mNodes[iGive];
+    const Node& keep = mNodes[iKeep];
+    Union(shortNode.Min, shortNode.Max, give.Min, give.Max, A.Min, A.Max);
+    A.Height = 1 + std::max(shortNode.Height, give.Height);
+    Union(A.Min, A.Max, keep.Min, keep.Max, U.Min, U.Max);
+    U.Height = 1 + std::max(A.Height, keep.Height);
+
+    return iU;
+}
+
+void DynamicBvh::CollectLeaves(UINT node, std::vector<UINT>& proxies)const
+{
+    UINT stack[64];
+    UINT stackSize = 0;
+    stack[stackSize++] = node;
+
+    while(stackSize > 0)
+    {
+        const UINT index = stack[--stackSize];
+        const Node& n = mNodes[index];
+        if(n.IsLeaf())
+        {
+            proxies.push_back(index);
+            continue;
+        }
+
+        stack[stackSize++] = n.Child[0];
+        stack[stackSize++] = n.Child[1];
+    }
+}
+
+void DynamicBvh::QueryFrustum(const XMFLOAT4 planes[6], std::vector<UINT>& proxies)const
+{
+    if(mRoot == NullNode)
+        return;
+
+    // The tree is balanced, so its height stays far below the stack size; a node
+    // leaves at most one more entry on the stack than it takes off.
+    UINT stack[64];
+    UINT stackSize = 0;
+    stack[stackSize++] = mRoot;
+
+    while(stackSize > 0)
+    {
+        const UINT index = stack[--stackSize];
+        const Node& n = mNodes[index];
+
+        const PlaneSide side = ClassifyBox(planes, n.Min, n.Max);
+        if(side == PlaneSide::Outside)
+            continue;
+
+        if(n.IsLeaf())
+            proxies.push_back(index);
+        else if(side == PlaneSide::Inside)
+            CollectLeaves(index, proxies);
+        else
+        {
+            stack[stackSize++] = n.Child[0];
+            stack[stackSize++] = n.Child[1];
+        }
+    }
+}
+
+void DynamicBvh::QuerySphere(const BoundingSphere& sphere, std::vector<UINT>& proxies)const
+{
+    if(mRoot == NullNode)
+        return;
+
+    UINT stack[64];
+    UINT stackSize = 0;
+    stack[stackSize++] = mRoot;
+
+    while(stackSize > 0)
+    {
+        const UINT index = stack[--stackSize];
+        const Node& n = mNodes[index];
+        if(!OverlapsSphere(sphere, n.Min, n.Max))
+            continue;
+
+        if(n.IsLeaf())
+        {
+            proxies.push_back(index);
+            continue;
+        }
+
+        stack[stackSize++] = n.Child[0];
+        stack[stackSize++] = n.Child[1];
+    }
+}
+
+void DynamicBvh::QueryRay(FXMVECTOR origin, FXMVECTOR dir, float maxT, std::vector<DynamicBvhRayHit>& hits)const
+{
+    hits.clear();
+    if(mRoot == NullNode)
+        return;
+
+    const XMVECTOR invDir = XMVectorReciprocal(dir);
+
+    UINT stack[64];
+    UINT stackSize = 0;
+    stack[stackSize++] = mRoot;
+
+    while(stackSize > 0)
+    {
+        const UINT index = stack[--stackSize];
+        const Node& n = mNodes[index];
+
+        const float t = RayEntry(origin, invDir, maxT, n.Min, n.Max);
+        if(t < 0.0f)
+            continue;
+
+        if(n.IsLeaf())
+        {
+            DynamicBvhRayHit hit;
+            hit.Proxy = index;
+            hit.T = t;
+            hits.push_back(hit);
+            continue;
+        }
+
+        stack[stackSize++] = n.Child[0];
+        stack[stackSize++] = n.Child[1];
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const DynamicBvhRayHit& a, const DynamicBvhRayHit& b)
+    {
+        return a.T < b.T;
+    });
+}
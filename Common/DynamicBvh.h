@@ -0,0 +1,121 @@
+//***************************************************************************************
+// DynamicBvh.h
+//
+// Bounding volume hierarchy over the world space boxes of scene objects such as render
+// items, for culling and picking queries whose cost follows the number of objects
+// they find rather than the number in the scene.  Unlike MeshBvh and SceneBvh it is
+// never rebuilt: objects are inserted, removed and moved one at a time.
+//
+// Each object is a leaf whose box is its bounds grown by a margin (a loose box), so an
+// object that moves only a little stays inside its leaf and Update costs nothing.  An
+// object that leaves its loose box is taken out and inserted again.  Insertion goes
+// down to the sibling that grows the surface area of the tree the least, and the
+// nodes on the way back up are rotated to keep the tree balanced.
+//
+// Queries return the objects' proxies, the handles Insert hands out; GetUserData maps
+// a proxy back to the object.  They test the loose boxes, so they can return objects
+// a little outside the query, which the caller tests further if it needs to.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct DynamicBvhSettings
+{
+    // Loose boxes extend this far beyond their object's bounds on every side, in world
+    // units.  Larger margins mean fewer reinsertions of moving objects and looser
+    // queries.
+    float Margin = 0.1f;
+};
+
+// An object whose loose box a ray enters at T, in units of the ray direction.
+struct DynamicBvhRayHit
+{
+    UINT Proxy = 0;
+    float T = 0.0f;
+};
+
+class DynamicBvh
+{
+public:
+    static constexpr UINT NullProxy = UINT_MAX;
+
+    explicit DynamicBvh(const DynamicBvhSettings& settings = DynamicBvhSettings());
+
+    // Adds an object with world space bounds and returns its proxy, which stays valid
+    // until the object is removed.
+    UINT Insert(const DirectX::BoundingBox& bounds, void* userData);
+    void Remove(UINT proxy);
+
+    // Refits the object to new bounds.  Returns true if it had to be reinserted because
+    // the bounds left its loose box, and false if the tree did not change.
+    bool Update(UINT proxy, const DirectX::BoundingBox& bounds);
+
+    void Clear();
+
+    void* GetUserData(UINT proxy)const;
+    DirectX::BoundingBox GetLooseBounds(UINT proxy)const;
+
+    // Box around the loose boxes of all objects; empty with no objects.
+    DirectX::BoundingBox GetBounds()const;
+
+    UINT ProxyCount()const;
+
+    // Levels from the root to the deepest leaf; 0 with no objects.
+    UINT Height()const;
+
+    // Appends the proxies of the objects not wholly outside the frustum.  The planes
+    // point into the frustum, as from MathHelper::ExtractFrustumPlanes.  Subtrees wholly
+    // inside it are taken without testing their nodes.
+    void QueryFrustum(const DirectX::XMFLOAT4 planes[6], std::vector<UINT>& proxies)const;
+
+    // Appends the proxies of the objects that overlap the sphere.
+    void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<UINT>& proxies)const;
+
+    // The objects whose loose box the ray enters before maxT, in units of dir, nearest
+    // entry first.  A caller that wants the nearest hit tests them in order and stops
+    // once an entry is farther than the nearest hit so far.  Replaces hits.
+    void QueryRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT,
+                  std::vector<DynamicBvhRayHit>& hits)const;
+
+private:
+    static constexpr UINT NullNode = UINT_MAX;
+
+    // A leaf holds one object and Child[0] = NullNode.  Free nodes have Height -1 and
+    // are linked through Parent.
+    struct Node
+    {
+        DirectX::XMFLOAT3 Min;
+        DirectX::XMFLOAT3 Max;
+        UINT Parent = NullNode;
+        UINT Child[2] = { NullNode, NullNode };
+        int Height = 0;
+        void* UserData = nullptr;
+
+        bool IsLeaf()const { return Child[0] == NullNode; }
+    };
+
+    UINT AllocateNode();
+    void FreeNode(UINT node);
+
+    void InsertLeaf(UINT leaf);
+    void RemoveLeaf(UINT leaf);
+
+    // Refits the boxes and heights from node up to the root, rotating on the way.
+    void RefitAncestors(UINT node);
+
+    // Rotates a child up into node's place if one child is more than one level
+    // taller than the other.  Returns the node now in that place.
+    UINT Balance(UINT node);
+
+    // Appends every leaf below node.
+    void CollectLeaves(UINT node, std::vector<UINT>& proxies)const;
+
+    std::vector<Node> mNodes;
+    UINT mRoot = NullNode;
+    UINT mFreeList = NullNode;
+    UINT mProxyCount = 0;
+
+    DynamicBvhSettings mSettings;
+};
@@ -0,0 +1,204 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include "TaskPool.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // Radius of the padding objects.  Every plane test adds it to a finite distance, so
+    // they always end up behind the plane.
+    const float HiddenRadius = -FLT_MAX;
+
+    // One bit per lane of a comparison result, lane 0 in bit 0.
+    UINT LaneMask(FXMVECTOR v)
+    {
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+        return (UINT)_mm_movemask_ps(v);
+#else
+        uint32_t lanes[4];
+        XMStoreInt4(lanes, v);
+        return (lanes[0] >> 31) | ((lanes[1] >> 31) << 1) | ((lanes[2] >> 31) << 2) | ((lanes[3] >> 31) << 3);
+#endif
+    }
+
+    // Four consecutive objects' values of one component.
+    XMVECTOR LoadLanes(const std::vector<float>& v, UINT i)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v[i]));
+    }
+
+    // A plane with each component in all four lanes, and the absolute values of its
+    // normal for the effective radius of a box.
+    struct SplatPlane
+    {
+        XMVECTOR Nx, Ny, Nz, D;
+        XMVECTOR AbsNx, AbsNy, AbsNz;
+    };
+}
+
+void FrustumCuller::Resize(UINT count)
+{
+    const UINT keep = std::min(count, mCount);
+    const UINT paddedCount = (count + 7) & ~7u;
+
+    mCenterX.resize(paddedCount);
+    mCenterY.resize(paddedCount);
+    mCenterZ.resize(paddedCount);
+    mExtentX.resize(paddedCount);
+    mExtentY.resize(paddedCount);
+    mExtentZ.resize(paddedCount);
+    mRadius.resize(paddedCount);
+    mCount = count;
+
+    for(UINT i = keep; i < paddedCount; ++i)
+        Store(i, XMVectorZero(), XMVectorZero(), HiddenRadius);
+}
+
+UINT FrustumCuller::Count()const
+{
+    return mCount;
+}
+
+void FrustumCuller::SetBox(UINT i, const BoundingBox& box)
+{
+    const XMVECTOR extents = XMLoadFloat3(&box.Extents);
+    Store(i, XMLoadFloat3(&box.Center), extents, XMVectorGetX(XMVector3Length(extents)));
+}
+
+void FrustumCuller::SetSphere(UINT i, const BoundingSphere& sphere)
+{
+    Store(i, XMLoadFloat3(&sphere.Center), XMVectorReplicate(sphere.Radius), sphere.Radius);
+}
+
+void FrustumCuller::SetTransformed(UINT i, const BoundingBox& localBox, FXMMATRIX world)
+{
+    const XMVECTOR localExtents = XMLoadFloat3(&localBox.Extents);
+    const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&localBox.Center), world);
+
+    // The world space half size along each axis is the sum of the transformed local
+    // axes' reach along it (Arvo), which is exact for the box around the rotated box.
+    XMVECTOR extents = XMVectorAbs(world.r[0]) * XMVectorSplatX(localExtents);
+    extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[1]), XMVectorSplatY(localExtents), extents);
+    extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[2]), XMVectorSplatZ(localExtents), extents);
+
+    const XMVECTOR scaleSq = XMVectorMax(XMVector3LengthSq(world.r[0]),
+        XMVectorMax(XMVector3LengthSq(world.r[1]), XMVector3LengthSq(world.r[2])));
+    const float radius = XMVectorGetX(XMVector3Length(localExtents) * XMVectorSqrt(scaleSq));
+
+    Store(i, center, extents, radius);
+}
+
+void FrustumCuller::Store(UINT i, FXMVECTOR center, FXMVECTOR extents, float radius)
+{
+    mCenterX[i] = XMVectorGetX(center);
+    mCenterY[i] = XMVectorGetY(center);
+    mCenterZ[i] = XMVectorGetZ(center);
+    mExtentX[i] = XMVectorGetX(extents);
+    mExtentY[i] = XMVectorGetY(extents);
+    mExtentZ[i] = XMVectorGetZ(extents);
+    mRadius[i] = radius;
+}
+
+void FrustumCuller::Cull(const XMFLOAT4 planes[6], std::vector<UINT>& visible, TaskPool* pool)const
+{
+    const UINT paddedCount = (UINT)mRadius.size();
+    visible.resize(paddedCount);
+
+    if(paddedCount <= ChunkSize)
+    {
+        visible.resize(CullRange(planes, 0, paddedCount, visible.data()));
+        return;
+    }
+
+    if(pool == nullptr)
+        pool = &TaskPool::Default();
+
+    // Each chunk compacts into the start of its own range of visible...
+    const UINT chunkCount = (paddedCount + ChunkSize - 1) / ChunkSize;
+    std::vector<UINT> chunkVisible(chunkCount);
+    pool->ParallelFor(paddedCount, ChunkSize, [&](UINT begin, UINT end)
+    {
+        for(UINT chunk = begin; chunk < end; chunk += ChunkSize)
+        {
+            const UINT chunkEnd = std::min(chunk + ChunkSize, end);
+            chunkVisible[chunk / ChunkSize] = CullRange(planes, chunk, chunkEnd, visible.data() + chunk);
+        }
+    });
+
+    // ...and the ranges are moved down behind each other.  Each one moves to or below
+    // where it starts, so nothing is overwritten before it has been moved.
+    UINT visibleCount = chunkVisible[0];
+    for(UINT c = 1; c < chunkCount; ++c)
+    {
+        memmove(visible.data() + visibleCount, visible.data() + c*ChunkSize, chunkVisible[c] * sizeof(UINT));
+        visibleCount += chunkVisible[c];
+    }
+
+    visible.resize(visibleCount);
+}
+
+UINT FrustumCuller::CullRange(const XMFLOAT4 planes[6], UINT begin, UINT end, UINT* visible)const
+{
+    SplatPlane splat[6];
+    for(int p = 0; p < 6; ++p)
+    {
+        splat[p].Nx = XMVectorReplicate(planes[p].x);
+        splat[p].Ny = XMVectorReplicate(planes[p].y);
+        splat[p].Nz = XMVectorReplicate(planes[p].z);
+        splat[p].D = XMVectorReplicate(planes[p].w);
+        splat[p].AbsNx = XMVectorAbs(splat[p].Nx);
+        splat[p].AbsNy = XMVectorAbs(splat[p].Ny);
+        splat[p].AbsNz = XMVectorAbs(splat[p].Nz);
+    }
+
+    const XMVECTOR zero = XMVectorZero();
+
+    UINT visibleCount = 0;
+    for(UINT i = begin; i < end; i += 8)
+    {
+        // Objects i to i + 3 in the first vector of each pair, i + 4 to i + 7 in the second.
+        const XMVECTOR cx[2] = { LoadLanes(mCenterX, i), LoadLanes(mCenterX, i + 4) };
+        const XMVECTOR cy[2] = { LoadLanes(mCenterY, i), LoadLanes(mCenterY, i + 4) };
+        const XMVECTOR cz[2] = { LoadLanes(mCenterZ, i), LoadLanes(mCenterZ, i + 4) };
+        const XMVECTOR ex[2] = { LoadLanes(mExtentX, i), LoadLanes(mExtentX, i + 4) };
+        const XMVECTOR ey[2] = { LoadLanes(mExtentY, i), LoadLanes(mExtentY, i + 4) };
+        const XMVECTOR ez[2] = { LoadLanes(mExtentZ, i), LoadLanes(mExtentZ, i + 4) };
+        const XMVECTOR radius[2] = { LoadLanes(mRadius, i), LoadLanes(mRadius, i + 4) };
+
+        XMVECTOR inside[2] = { XMVectorTrueInt(), XMVectorTrueInt() };
+        for(int p = 0; p < 6; ++p)
+        {
+            const SplatPlane& plane = splat[p];
+            for(int h = 0; h < 2; ++h)
+            {
+                // Signed distance of the center, and how far the box or the sphere, whichever
+                // is tighter along the normal, reaches towards the plane from it.
+                XMVECTOR s = XMVectorMultiplyAdd(cx[h], plane.Nx, plane.D);
+                s = XMVectorMultiplyAdd(cy[h], plane.Ny, s);
+                s = XMVectorMultiplyAdd(cz[h], plane.Nz, s);
+
+                XMVECTOR r = ex[h] * plane.AbsNx;
+                r = XMVectorMultiplyAdd(ey[h], plane.AbsNy, r);
+                r = XMVectorMultiplyAdd(ez[h], plane.AbsNz, r);
+                r = XMVectorMin(r, radius[h]);
+
+                inside[h] = XMVectorAndInt(inside[h], XMVectorGreaterOrEqual(s + r, zero));
+            }
+        }
+
+        // Write every index and advance past the visible ones, so there is no branch on
+        // the outcome.
+        const UINT mask = LaneMask(inside[0]) | (LaneMask(inside[1]) << 4);
+        for(UINT k = 0; k < 8; ++k)
+        {
+            visible[visibleCount] = i + k;
+            visibleCount += (mask >> k) & 1;
+        }
+    }
+
+    return visibleCount;
+}
@@ -0,0 +1,68 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Culls many objects at once against the six world space planes from
+// MathHelper::ExtractFrustumPlanes.  The culler keeps a world space box and a bounding
+// sphere per object, with each component in an array of its own (structure of arrays),
+// so it loads eight objects as two XMVECTORs per component and tests them against a
+// plane with a few multiply-adds, instead of transforming a BoundingFrustum into the
+// local space of every object.  An object is culled if its box or its sphere lies
+// wholly behind one of the planes.
+//
+// Cull produces the indices of the visible objects in ascending order.  Large sets are
+// split into chunks on a TaskPool; every chunk compacts its visible indices into its
+// own part of the list, which are then moved together.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TaskPool;
+
+class FrustumCuller
+{
+public:
+    // Objects per chunk on the pool; a multiple of eight.  Sets of more than one chunk
+    // are split across the pool.
+    static constexpr UINT ChunkSize = 4096;
+
+    // Sets the number of objects.  Objects that are added have no bounds and are never
+    // visible until their bounds are set.
+    void Resize(UINT count);
+    UINT Count()const;
+
+    // World space bounds of object i.  A box also gets the sphere around it, and a
+    // sphere the box around it.
+    void SetBox(UINT i, const DirectX::BoundingBox& box);
+    void SetSphere(UINT i, const DirectX::BoundingSphere& sphere);
+
+    // The bounds of an object with local space bounds localBox and world matrix world:
+    // the world space box around the transformed box, and the sphere around localBox
+    // scaled by the largest scale of world.
+    void SetTransformed(UINT i, const DirectX::BoundingBox& localBox, DirectX::FXMMATRIX world);
+
+    // Indices of the objects that are not wholly outside the frustum, in ascending order.
+    // The planes point into the frustum, as from MathHelper::ExtractFrustumPlanes.  Sets
+    // of more than ChunkSize objects run on pool (TaskPool::Default() if null).
+    void Cull(const DirectX::XMFLOAT4 planes[6], std::vector<UINT>& visible, TaskPool* pool = nullptr)const;
+
+private:
+    void Store(UINT i, DirectX::FXMVECTOR center, DirectX::FXMVECTOR extents, float radius);
+
+    // Writes the indices of the visible objects in [begin, end), both multiples of
+    // eight, to visible and returns how many there are.  visible needs room for
+    // end - begin indices.
+    UINT CullRange(const DirectX::XMFLOAT4 planes[6], UINT begin, UINT end, UINT* visible)const;
+
+    // Padded to a multiple of eight with objects that are never visible.
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+    std::vector<float> mRadius;
+
+    UINT mCount = 0;
+};
@@ -0,0 +1,323 @@
+//***************************************************************************************
+// HeightPyramid.cpp
+//***************************************************************************************
+
+#include "HeightPyramid.h"
+#include "TaskPool.h"
+
+using namespace DirectX;
+
+void HeightPyramid::Build(const float* heights, UINT width, UINT height, TaskPool* pool)
+{
+    assert(width >= 2 && height >= 2);
+
+    if(pool == nullptr)
+        pool = &TaskPool::Default();
+
+    mWidth = width;
+    mHeight = height;
+    mLevels.clear();
+
+    const UINT numCellsX = width - 1;
+    const UINT numCellsZ = height - 1;
+
+    Level finest;
+    finest.Width = (numCellsX + BlockSize - 1) / BlockSize;
+    finest.Height = (numCellsZ + BlockSize - 1) / BlockSize;
+    finest.MinY.resize((size_t)finest.Width * finest.Height);
+    finest.MaxY.resize((size_t)finest.Width * finest.Height);
+
+    // A block of BlockSize cells spans BlockSize+1 samples per row: two SIMD loads and
+    // the shared edge sample.
+    static_assert(BlockSize == 8, "the block reduction loads two XMVECTORs per row");
+
+    pool->ParallelFor(finest.Height, 4, [&](UINT begin, UINT end)
+    {
+        for(UINT bz = begin; bz < end; ++bz)
+        {
+            const UINT z0 = bz*BlockSize;
+            const UINT z1 = std::min(z0 + BlockSize, numCellsZ);
+
+            for(UINT bx = 0; bx < finest.Width; ++bx)
+            {
+                const UINT x0 = bx*BlockSize;
+                const UINT x1 = std::min(x0 + BlockSize, numCellsX);
+
+                float minY, maxY;
+                if(x1 - x0 == BlockSize)
+                {
+                    XMVECTOR vMin = g_XMFltMax;
+                    XMVECTOR vMax = XMVectorNegate(g_XMFltMax);
+                    for(UINT z = z0; z <= z1; ++z)
+                    {
+                        const float* row = heights + (size_t)z*width + x0;
+                        XMVECTOR a = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row));
+                        XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + 4));
+                        XMVECTOR c = XMVectorReplicate(row[8]);
+
+                        vMin = XMVectorMin(vMin, XMVectorMin(XMVectorMin(a, b), c));
+                        vMax = XMVectorMax(vMax, XMVectorMax(XMVectorMax(a, b), c));
+                    }
+
+                    // Reduce the four lanes.
+                    vMin = XMVectorMin(vMin, XMVectorSwizzle<2, 3, 0, 1>(vMin));
+                    vMin = XMVectorMin(vMin, XMVectorSwizzle<1, 0, 3, 2>(vMin));
+                    vMax = XMVectorMax(vMax, XMVectorSwizzle<2, 3, 0, 1>(vMax));
+                    vMax = XMVectorMax(vMax, XMVectorSwizzle<1, 0, 3, 2>(vMax));
+                    minY = XMVectorGetX(vMin);
+                    maxY = XMVectorGetX(vMax);
+                }
+                else
+                {
+                    // Partial block at the right edge.
+                    minY = +MathHelper::Infinity;
+                    maxY = -MathHelper::Infinity;
+                    for(UINT z = z0; z <= z1; ++z)
+                    {
+                        for(UINT x = x0; x <= x1; ++x)
+                        {
+                            float h = heights[(size_t)z*width + x];
+                            minY = std::min(minY, h);
+                            maxY = std::max(maxY, h);
+                        }
+                    }
+                }
+
+                finest.MinY[(size_t)bz*finest.Width + bx] = minY;
+                finest.MaxY[(size_t)bz*finest.Width + bx] = maxY;
+            }
+        }
+    });
+
+    mLevels.push_back(std::move(finest));
+
+    // Coarser levels until a single node is left.  Each is a quarter of the one
+    // below, so together they cost less than a third of the finest level.
+    while(mLevels.back().Width > 1 || mLevels.back().Height > 1)
+    {
+        const Level& fine = mLevels.back();
+
+        Level coarse;
+        coarse.Width = (fine.Width + 1) / 2;
+        coarse.Height = (fine.Height + 1) / 2;
+        coarse.MinY.resize((size_t)coarse.Width * coarse.Height);
+        coarse.MaxY.resize((size_t)coarse.Width * coarse.Height);
+
+        for(UINT z = 0; z < coarse.Height; ++z)
+        {
+            const UINT fz0 = 2*z;
+            const UINT fz1 = std::min(2*z + 1, fine.Height - 1);
+
+            for(UINT x = 0; x < coarse.Width; ++x)
+            {
+                const UINT fx0 = 2*x;
+                const UINT fx1 = std::min(2*x + 1, fine.Width - 1);
+
+                const size_t k00 = (size_t)fz0*fine.Width + fx0;
+                const size_t k01 = (size_t)fz0*fine.Width + fx1;
+                const size_t k10 = (size_t)fz1*fine.Width + fx0;
+                const size_t k11 = (size_t)fz1*fine.Width + fx1;
+
+                coarse.MinY[(size_t)z*coarse.Width + x] = std::min(
+                    std::min(fine.MinY[k00], fine.MinY[k01]), std::min(fine.MinY[k10], fine.MinY[k11]));
+                coarse.MaxY[(size_t)z*coarse.Width + x] = std::max(
+                    std::max(fine.MaxY[k00], fine.MaxY[k01]), std::max(fine.MaxY[k10], fine.MaxY[k11]));
+            }
+        }
+
+        mLevels.push_back(std::move(coarse));
+    }
+}
+
+UINT HeightPyramid::GetWidth()const
+{
+    return mWidth;
+}
+
+UINT HeightPyramid::GetHeight()const
+{
+    return mHeight;
+}
+
+UINT HeightPyramid::GetLevelCount()const
+{
+    return (UINT)mLevels.size();
+}
+
+size_t HeightPyramid::GetMemoryByteSize()const
+{
+    size_t bytes = 0;
+    for(const Level& level : mLevels)
+        bytes += (level.MinY.size() + level.MaxY.size()) * sizeof(float);
+    return bytes;
+}
+
+size_t HeightPyramid::CalcMemoryByteSize(UINT width, UINT height)
+{
+    assert(width >= 2 && height >= 2);
+
+    // Same level sizes as Build.
+    UINT levelWidth = (width - 1 + BlockSize - 1) / BlockSize;
+    UINT levelHeight = (height - 1 + BlockSize - 1) / BlockSize;
+
+    size_t bytes = 2 * (size_t)levelWidth * levelHeight * sizeof(float);
+    while(levelWidth > 1 || levelHeight > 1)
+    {
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        bytes += 2 * (size_t)levelWidth * levelHeight * sizeof(float);
+    }
+    return bytes;
+}
+
+XMFLOAT2 HeightPyramid::GetRangeY()const
+{
+    assert(!mLevels.empty());
+    return XMFLOAT2(mLevels.back().MinY[0], mLevels.back().MaxY[0]);
+}
+
+XMFLOAT2 HeightPyramid::GetRangeY(UINT x0, UINT z0, UINT x1, UINT z1)const
+{
+    assert(!mLevels.empty());
+    assert(x0 <= x1 && z0 <= z1);
+
+    // Samples [x0, x1] are covered by cells [x0, x1-1]; a single column of samples
+    // still needs the cell next to it.
+    const UINT numCellsX = mWidth - 1;
+    const UINT numCellsZ = mHeight - 1;
+    const UINT cx0 = std::min(x0, numCellsX - 1);
+    const UINT cz0 = std::min(z0, numCellsZ - 1);
+    const UINT cx1 = std::clamp(x1, cx0 + 1, numCellsX) - 1;
+    const UINT cz1 = std::clamp(z1, cz0 + 1, numCellsZ) - 1;
+
+    // Finest level nodes to cover.
+    const UINT bx0 = cx0 / BlockSize;
+    const UINT bz0 = cz0 / BlockSize;
+    const UINT bx1 = cx1 / BlockSize;
+    const UINT bz1 = cz1 / BlockSize;
+
+    XMFLOAT2 range(+MathHelper::Infinity, -MathHelper::Infinity);
+
+    // Descend from the root and take every node that lies entirely inside the block
+    // rectangle, so only nodes along its border are split.
+    struct Node
+    {
+        UINT Level;
+        UINT X;
+        UINT Z;
+    };
+
+    Node stack[3*32 + 1];
+    int top = 0;
+    stack[top++] = { (UINT)mLevels.size() - 1, 0, 0 };
+
+    while(top > 0)
+    {
+        const Node node = stack[--top];
+        const Level& level = mLevels[node.Level];
+
+        // Finest level nodes under this node.
+        const UINT nx0 = node.X << node.Level;
+        const UINT nz0 = node.Z << node.Level;
+        const UINT nx1 = ((node.X + 1) << node.Level) - 1;
+        const UINT nz1 = ((node.Z + 1) << node.Level) - 1;
+
+        if(nx0 > bx1 || nx1 < bx0 || nz0 > bz1 || nz1 < bz0)
+            continue;
+
+        const bool inside = nx0 >= bx0 && nx1 <= bx1 && nz0 >= bz0 && nz1 <= bz1;
+        if(inside || node.Level == 0)
+        {
+            const size_t k = (size_t)node.Z*level.Width + node.X;
+            range.x = std::min(range.x, level.MinY[k]);
+            range.y = std::max(range.y, level.MaxY[k]);
+            continue;
+        }
+
+        const Level& children = mLevels[node.Level - 1];
+        for(UINT k = 0; k < 4; ++k)
+        {
+            UINT x = 2*node.X + (k & 1);
+            UINT z = 2*node.Z + (k >> 1);
+            if(x < children.Width && z < children.Height)
+                stack[top++] = { node.Level - 1, x, z };
+        }
+    }
+
+    return range;
+}
+
+void HeightPyramid::GetNodeCells(UINT level, UINT x, UINT z, UINT& x0, UINT& z0, UINT& x1, UINT& z1)const
+{
+    const UINT nodeCells = BlockSize << level;
+    x0 = x*nodeCells;
+    z0 = z*nodeCells;
+    x1 = std::min(x0 + nodeCells, mWidth - 1);
+    z1 = std::min(z0 + nodeCells, mHeight - 1);
+}
+
+bool HeightPyramid::ClipToNode(const Ray& ray, UINT level, UINT x, UINT z, float tMin, float tMax, float& t0, float& t1)const
+{
+    UINT cx0, cz0, cx1, cz1;
+    GetNodeCells(level, x, z, cx0, cz0, cx1, cz1);
+
+    const size_t k = (size_t)z*mLevels[level].Width + x;
+    const float lo[3] = { (float)cx0, mLevels[level].MinY[k], (float)cz0 };
+    const float hi[3] = { (float)cx1, mLevels[level].MaxY[k], (float)cz1 };
+
+    t0 = tMin;
+    t1 = tMax;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float tNear = (lo[axis] - ray.Origin[axis]) * ray.InvDir[axis];
+        float tFar = (hi[axis] - ray.Origin[axis]) * ray.InvDir[axis];
+        if(tNear > tFar)
+            std::swap(tNear, tFar);
+
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if(t0 > t1)
+            return false;
+    }
+
+    return true;
+}
+
+bool HeightPyramid::IntersectTriangle(const Ray& ray, const float a[3], const float b[3], const float c[3], float& t)
+{
+    // Moller-Trumbore, both sides.
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+    const float p[3] =
+    {
+        ray.Dir[1]*e2[2] - ray.Dir[2]*e2[1],
+        ray.Dir[2]*e2[0] - ray.Dir[0]*e2[2],
+        ray.Dir[0]*e2[1] - ray.Dir[1]*e2[0]
+    };
+
+    const float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if(fabsf(det) < 1e-12f)
+        return false;
+
+    const float invDet = 1.0f / det;
+    const float s[3] = { ray.Origin[0] - a[0], ray.Origin[1] - a[1], ray.Origin[2] - a[2] };
+
+    const float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * invDet;
+    if(u < 0.0f || u > 1.0f)
+        return false;
+
+    const float q[3] =
+    {
+        s[1]*e1[2] - s[2]*e1[1],
+        s[2]*e1[0] - s[0]*e1[2],
+        s[0]*e1[1] - s[1]*e1[0]
+    };
+
+    const float v = (ray.Dir[0]*q[0] + ray.Dir[1]*q[1] + ray.Dir[2]*q[2]) * invDet;
+    if(v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * invDet;
+    return t >= 0.0f;
+}
@@ -0,0 +1,246 @@
+//***************************************************************************************
+// HeightPyramid.h
+//
+// Min/max height pyramid over a heightmap.  The finest level stores the lowest and
+// highest height of each BlockSize x BlockSize block of cells, and every coarser level
+// the range of 2x2 nodes of the level below, up to a single root node.  Built once at
+// load time, it answers
+//
+//   - height ranges over rectangles (patch and culling bounds) by visiting only the
+//     nodes along the rectangle's edges instead of every sample inside it,
+//   - ray and segment queries by skipping every node the ray passes above or below,
+//     and only testing the triangles of the blocks it may actually touch.
+//
+// Coordinates are those of the heightmap grid: x is the sample column, z the sample
+// row and y the height.  Cell (x, z) spans samples x..x+1 and z..z+1 and is split
+// into the triangles ABC and DCB like Terrain::GetHeight:
+//
+//   A*--*B
+//    | /|
+//    |/ |
+//   C*--*D
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TaskPool;
+
+class HeightPyramid
+{
+public:
+    // Cells per edge of a finest level node.  Ray queries test the triangles of up
+    // to this many cells per block they enter.
+    static constexpr UINT BlockSize = 8;
+
+    // Builds the pyramid over width x height samples, row major.  The rows of blocks
+    // are reduced in parallel on pool (TaskPool::Default() if null).
+    void Build(const float* heights, UINT width, UINT height, TaskPool* pool = nullptr);
+
+    UINT GetWidth()const;
+    UINT GetHeight()const;
+    UINT GetLevelCount()const;
+
+    // Bytes used by all levels.
+    size_t GetMemoryByteSize()const;
+
+    // Bytes Build allocates for a pyramid over width x height samples.
+    static size_t CalcMemoryByteSize(UINT width, UINT height);
+
+    // Lowest (x) and highest (y) height of the samples [x0, x1] x [z0, z1], inclusive.
+    // Exact when the covered cells start and end on block boundaries; otherwise the
+    // range of the whole blocks touched, which contains the exact range.
+    DirectX::XMFLOAT2 GetRangeY(UINT x0, UINT z0, UINT x1, UINT z1)const;
+
+    // Range of the whole heightmap.
+    DirectX::XMFLOAT2 GetRangeY()const;
+
+    // Finds the first hit of origin + t*dir, t in [0, maxT], with the terrain surface.
+    // sample(x, z) must return the height of sample (x, z); it is only called for the
+    // corners of cells the ray may hit.  dir does not have to be normalized.
+    template<typename SampleFn>
+    bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT, const SampleFn& sample, float& t)const;
+
+private:
+    struct Level
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+
+        // One entry per node, row major.
+        std::vector<float> MinY;
+        std::vector<float> MaxY;
+    };
+
+    struct Ray
+    {
+        float Origin[3];
+        float Dir[3];
+        float InvDir[3];
+    };
+
+    // Cells of node (x, z) of level: [x0, x1) x [z0, z1).
+    void GetNodeCells(UINT level, UINT x, UINT z, UINT& x0, UINT& z0, UINT& x1, UINT& z1)const;
+
+    // Clips ray to the box of node (x, z) of level; false if it misses or the box is
+    // beyond [tMin, tMax].
+    bool ClipToNode(const Ray& ray, UINT level, UINT x, UINT z, float tMin, float tMax, float& t0, float& t1)const;
+
+    // Walks the cells of block (bx, bz) that the ray crosses over [t0, t1] and tests
+    // their triangles.
+    template<typename SampleFn>
+    bool RaycastBlock(const Ray& ray, UINT bx, UINT bz, float t0, float t1, const SampleFn& sample, float& t)const;
+
+    static bool IntersectTriangle(const Ray& ray, const float a[3], const float b[3], const float c[3], float& t);
+
+private:
+    UINT mWidth = 0;
+    UINT mHeight = 0;
+
+    // mLevels[0] is the finest (block) level and mLevels.back() has a single node.
+    std::vector<Level> mLevels;
+};
+
+template<typename SampleFn>
+bool HeightPyramid::Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT, const SampleFn& sample, float& t)const
+{
+    if(mLevels.empty())
+        return false;
+
+    Ray ray;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        ray.Origin[axis] = DirectX::XMVectorGetByIndex(origin, axis);
+        ray.Dir[axis] = DirectX::XMVectorGetByIndex(dir, axis);
+
+        // An axis the ray does not move along never bounds it; a huge reciprocal
+        // keeps the slab test free of 0*inf.
+        ray.InvDir[axis] = ray.Dir[axis] != 0.0f ? 1.0f / ray.Dir[axis] : 1e30f;
+    }
+
+    struct Node
+    {
+        UINT Level;
+        UINT X;
+        UINT Z;
+        float T0;
+        float T1;
+    };
+
+    // Depth first, nearest child first.  Sibling footprints do not overlap, so the
+    // first hit found is the nearest one.
+    Node stack[4*32];
+    int top = 0;
+
+    const UINT root = (UINT)mLevels.size() - 1;
+    float t0, t1;
+    if(!ClipToNode(ray, root, 0, 0, 0.0f, maxT, t0, t1))
+        return false;
+
+    stack[top++] = { root, 0, 0, t0, t1 };
+
+    while(top > 0)
+    {
+        const Node node = stack[--top];
+
+        if(node.Level == 0)
+        {
+            if(RaycastBlock(ray, node.X, node.Z, node.T0, node.T1, sample, t))
+                return true;
+            continue;
+        }
+
+        const Level& children = mLevels[node.Level - 1];
+
+        Node hits[4];
+        int numHits = 0;
+        for(UINT k = 0; k < 4; ++k)
+        {
+            UINT x = 2*node.X + (k & 1);
+            UINT z = 2*node.Z + (k >> 1);
+            if(x >= children.Width || z >= children.Height)
+                continue;
+
+            if(ClipToNode(ray, node.Level - 1, x, z, node.T0, node.T1, t0, t1))
+                hits[numHits++] = { node.Level - 1, x, z, t0, t1 };
+        }
+
+        // Push the farthest first so the nearest is popped next.
+        for(int k = 1; k < numHits; ++k)
+        {
+            for(int m = k; m > 0 && hits[m].T0 > hits[m - 1].T0; --m)
+                std::swap(hits[m], hits[m - 1]);
+        }
+
+        for(int k = 0; k < numHits; ++k)
+            stack[top++] = hits[k];
+    }
+
+    return false;
+}
+
+template<typename SampleFn>
+bool HeightPyramid::RaycastBlock(const Ray& ray, UINT bx, UINT bz, float t0, float t1, const SampleFn& sample, float& t)const
+{
+    UINT cx0, cz0, cx1, cz1;
+    GetNodeCells(0, bx, bz, cx0, cz0, cx1, cz1);
+
+    // Cell containing the entry point, then a 2D DDA over the cells of the block.
+    float px = ray.Origin[0] + t0*ray.Dir[0];
+    float pz = ray.Origin[2] + t0*ray.Dir[2];
+    int cx = std::clamp((int)floorf(px), (int)cx0, (int)cx1 - 1);
+    int cz = std::clamp((int)floorf(pz), (int)cz0, (int)cz1 - 1);
+
+    const int stepX = ray.Dir[0] > 0.0f ? 1 : -1;
+    const int stepZ = ray.Dir[2] > 0.0f ? 1 : -1;
+
+    float nextX = ray.Dir[0] != 0.0f ? ((float)(cx + (stepX > 0 ? 1 : 0)) - ray.Origin[0]) * ray.InvDir[0] : FLT_MAX;
+    float nextZ = ray.Dir[2] != 0.0f ? ((float)(cz + (stepZ > 0 ? 1 : 0)) - ray.Origin[2]) * ray.InvDir[2] : FLT_MAX;
+    const float deltaX = ray.Dir[0] != 0.0f ? fabsf(ray.InvDir[0]) : FLT_MAX;
+    const float deltaZ = ray.Dir[2] != 0.0f ? fabsf(ray.InvDir[2]) : FLT_MAX;
+
+    for(;;)
+    {
+        const float x = (float)cx;
+        const float z = (float)cz;
+        const float a[3] = { x,        sample(cx,     cz),     z };
+        const float b[3] = { x + 1.0f, sample(cx + 1, cz),     z };
+        const float c[3] = { x,        sample(cx,     cz + 1), z + 1.0f };
+        const float d[3] = { x + 1.0f, sample(cx + 1, cz + 1), z + 1.0f };
+
+        float hitT = FLT_MAX;
+        float triT = 0.0f;
+        if(IntersectTriangle(ray, a, b, c, triT) && triT < hitT)
+            hitT = triT;
+        if(IntersectTriangle(ray, d, c, b, triT) && triT < hitT)
+            hitT = triT;
+
+        // The block's box contains its triangles, so a hit is never before t0 other
+        // than by rounding.
+        if(hitT <= t1)
+        {
+            t = hitT;
+            return true;
+        }
+
+        // Step into the next cell along the ray.
+        const float cellExit = std::min(nextX, nextZ);
+        if(cellExit > t1)
+            return false;
+
+        if(nextX < nextZ)
+        {
+            cx += stepX;
+            nextX += deltaX;
+        }
+        else
+        {
+            cz += stepZ;
+            nextZ += deltaZ;
+        }
+
+        if(cx < (int)cx0 || cx >= (int)cx1 || cz < (int)cz0 || cz >= (int)cz1)
+            return false;
+    }
+}
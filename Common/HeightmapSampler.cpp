@@ -0,0 +1,220 @@
+//***************************************************************************************
+// HeightmapSampler.cpp
+//***************************************************************************************
+
+#include "HeightmapSampler.h"
+#include "TaskPool.h"
+
+using namespace DirectX;
+
+HeightmapSampler::HeightmapSampler(const float* heights, const Grid& grid) :
+    mHeights(heights),
+    mGrid(grid)
+{
+    assert(grid.Width >= 2 && grid.Height >= 2);
+}
+
+HeightmapSampler::HeightmapSampler(const uint16_t* samples, float heightScale, float heightOffset, const Grid& grid) :
+    mSamples(samples),
+    mHeightScale(heightScale),
+    mHeightOffset(heightOffset),
+    mGrid(grid)
+{
+    assert(grid.Width >= 2 && grid.Height >= 2);
+}
+
+float HeightmapSampler::SampleToHeight(uint16_t sample)const
+{
+    constexpr float MaxUShort = static_cast<float>(std::numeric_limits<uint16_t>::max());
+    return mHeightScale * (sample / MaxUShort) + mHeightOffset;
+}
+
+float HeightmapSampler::GetHeight(float x, float z, XMFLOAT3* normal)const
+{
+    // Transform to "cell" space and clamp to the grid.
+    const float maxCol = (float)(mGrid.Width - 1);
+    const float maxRow = (float)(mGrid.Height - 1);
+    float c = MathHelper::Clamp((x - mGrid.OriginX) / mGrid.CellSpacing, 0.0f, maxCol);
+    float d = MathHelper::Clamp((mGrid.OriginZ - z) / mGrid.CellSpacing, 0.0f, maxRow);
+
+    // The last row and column of samples belong to the cells before them.
+    UINT col = std::min((UINT)c, mGrid.Width - 2);
+    UINT row = std::min((UINT)d, mGrid.Height - 2);
+
+    const size_t k = (size_t)row*mGrid.Width + col;
+    float A, B, C, D;
+    if(mHeights != nullptr)
+    {
+        A = mHeights[k];
+        B = mHeights[k + 1];
+        C = mHeights[k + mGrid.Width];
+        D = mHeights[k + mGrid.Width + 1];
+    }
+    else
+    {
+        A = SampleToHeight(mSamples[k]);
+        B = SampleToHeight(mSamples[k + 1]);
+        C = SampleToHeight(mSamples[k + mGrid.Width]);
+        D = SampleToHeight(mSamples[k + mGrid.Width + 1]);
+    }
+
+    // Where we are relative to the cell.
+    float s = c - (float)col;
+    float t = d - (float)row;
+
+    // Normal = (-dh/dx, 1, -dh/dz); z runs against t.
+    float h, dhds, dhdt;
+    if(s + t <= 1.0f)
+    {
+        // Upper triangle ABC.
+        dhds = B - A;
+        dhdt = C - A;
+        h = A + s*dhds + t*dhdt;
+    }
+    else
+    {
+        // Lower triangle DCB.
+        dhds = D - C;
+        dhdt = D - B;
+        h = D + (1.0f-s)*(C - D) + (1.0f-t)*(B - D);
+    }
+
+    if(normal != nullptr)
+    {
+        XMVECTOR n = XMVectorSet(-dhds / mGrid.CellSpacing, 1.0f, dhdt / mGrid.CellSpacing, 0.0f);
+        XMStoreFloat3(normal, XMVector3Normalize(n));
+    }
+
+    return h;
+}
+
+void HeightmapSampler::GetHeights(const float* x, const float* z, UINT count, float* heights,
+                                  XMFLOAT3* normals, TaskPool* pool)const
+{
+    auto run = [&](const auto& fetch)
+    {
+        if(count < ParallelBatchSize)
+        {
+            GetHeightsRange(x, z, 0, count, heights, normals, fetch);
+            return;
+        }
+
+        if(pool == nullptr)
+            pool = &TaskPool::Default();
+
+        // Chunks start on multiples of the grain, so every chunk but the last is
+        // whole groups of four points.
+        pool->ParallelFor(count, 2048, [&](UINT begin, UINT end)
+        {
+            GetHeightsRange(x, z, begin, end, heights, normals, fetch);
+        });
+    };
+
+    if(mHeights != nullptr)
+    {
+        const float* samples = mHeights;
+        run([samples](size_t k) { return samples[k]; });
+    }
+    else
+    {
+        // Dequantized once per gathered vector below.
+        const uint16_t* samples = mSamples;
+        run([samples](size_t k) { return (float)samples[k]; });
+    }
+}
+
+template<typename FetchFn>
+void HeightmapSampler::GetHeightsRange(const float* x, const float* z, UINT begin, UINT end, float* heights,
+                                       XMFLOAT3* normals, const FetchFn& fetch)const
+{
+    const XMVECTOR invSpacing = XMVectorReplicate(1.0f / mGrid.CellSpacing);
+    const XMVECTOR originX = XMVectorReplicate(mGrid.OriginX);
+    const XMVECTOR originZ = XMVectorReplicate(mGrid.OriginZ);
+    const XMVECTOR maxCol = XMVectorReplicate((float)(mGrid.Width - 1));
+    const XMVECTOR maxRow = XMVectorReplicate((float)(mGrid.Height - 1));
+    const XMVECTOR lastCellCol = XMVectorReplicate((float)(mGrid.Width - 2));
+    const XMVECTOR lastCellRow = XMVectorReplicate((float)(mGrid.Height - 2));
+
+    // Float samples pass through; unorm16 samples become heights.
+    const bool quantized = mHeights == nullptr;
+    const XMVECTOR sampleScale = XMVectorReplicate(quantized ? mHeightScale / 65535.0f : 1.0f);
+    const XMVECTOR sampleOffset = XMVectorReplicate(quantized ? mHeightOffset : 0.0f);
+
+    const UINT width = mGrid.Width;
+
+    for(UINT i = begin; i < end; i += 4)
+    {
+        const UINT n = std::min(4u, end - i);
+
+        // The tail repeats its last point.
+        XMFLOAT4 px, pz;
+        float* lx = &px.x;
+        float* lz = &pz.x;
+        for(UINT k = 0; k < 4; ++k)
+        {
+            lx[k] = x[i + std::min(k, n - 1)];
+            lz[k] = z[i + std::min(k, n - 1)];
+        }
+
+        // Cell space, clamped to the grid.
+        XMVECTOR c = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(XMLoadFloat4(&px), originX), invSpacing), g_XMZero, maxCol);
+        XMVECTOR d = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(originZ, XMLoadFloat4(&pz)), invSpacing), g_XMZero, maxRow);
+
+        XMVECTOR col = XMVectorMin(XMVectorFloor(c), lastCellCol);
+        XMVECTOR row = XMVectorMin(XMVectorFloor(d), lastCellRow);
+        XMVECTOR s = XMVectorSubtract(c, col);
+        XMVECTOR t = XMVectorSubtract(d, row);
+
+        // Gather the four corners of each lane's cell.  XMStoreSInt4 converts the
+        // (whole) floats to ints.
+        XMINT4 icol, irow;
+        XMStoreSInt4(&icol, col);
+        XMStoreSInt4(&irow, row);
+
+        const size_t k0 = (size_t)irow.x*width + icol.x;
+        const size_t k1 = (size_t)irow.y*width + icol.y;
+        const size_t k2 = (size_t)irow.z*width + icol.z;
+        const size_t k3 = (size_t)irow.w*width + icol.w;
+
+        XMVECTOR A = XMVectorSet(fetch(k0), fetch(k1), fetch(k2), fetch(k3));
+        XMVECTOR B = XMVectorSet(fetch(k0 + 1), fetch(k1 + 1), fetch(k2 + 1), fetch(k3 + 1));
+        XMVECTOR C = XMVectorSet(fetch(k0 + width), fetch(k1 + width), fetch(k2 + width), fetch(k3 + width));
+        XMVECTOR D = XMVectorSet(fetch(k0 + width + 1), fetch(k1 + width + 1), fetch(k2 + width + 1), fetch(k3 + width + 1));
+
+        A = XMVectorMultiplyAdd(A, sampleScale, sampleOffset);
+        B = XMVectorMultiplyAdd(B, sampleScale, sampleOffset);
+        C = XMVectorMultiplyAdd(C, sampleScale, sampleOffset);
+        D = XMVectorMultiplyAdd(D, sampleScale, sampleOffset);
+
+        // Both triangles, then pick per lane.
+        XMVECTOR upper = XMVectorLessOrEqual(XMVectorAdd(s, t), g_XMOne);
+
+        XMVECTOR upperH = XMVectorMultiplyAdd(t, XMVectorSubtract(C, A), XMVectorMultiplyAdd(s, XMVectorSubtract(B, A), A));
+        XMVECTOR lowerH = XMVectorMultiplyAdd(XMVectorSubtract(g_XMOne, t), XMVectorSubtract(B, D),
+                          XMVectorMultiplyAdd(XMVectorSubtract(g_XMOne, s), XMVectorSubtract(C, D), D));
+        XMVECTOR h = XMVectorSelect(lowerH, upperH, upper);
+
+        XMFLOAT4 outH;
+        XMStoreFloat4(&outH, h);
+        const float* lh = &outH.x;
+        for(UINT k = 0; k < n; ++k)
+            heights[i + k] = lh[k];
+
+        if(normals == nullptr)
+            continue;
+
+        // Normal = (-dh/dx, 1, -dh/dz) of the chosen triangle, normalized.
+        XMVECTOR dhds = XMVectorSelect(XMVectorSubtract(D, C), XMVectorSubtract(B, A), upper);
+        XMVECTOR dhdt = XMVectorSelect(XMVectorSubtract(D, B), XMVectorSubtract(C, A), upper);
+        XMVECTOR nx = XMVectorNegate(XMVectorMultiply(dhds, invSpacing));
+        XMVECTOR nz = XMVectorMultiply(dhdt, invSpacing);
+        XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(nz, nz, g_XMOne)));
+
+        XMFLOAT4 outX, outY, outZ;
+        XMStoreFloat4(&outX, XMVectorMultiply(nx, invLength));
+        XMStoreFloat4(&outY, invLength);
+        XMStoreFloat4(&outZ, XMVectorMultiply(nz, invLength));
+        for(UINT k = 0; k < n; ++k)
+            normals[i + k] = XMFLOAT3((&outX.x)[k], (&outY.x)[k], (&outZ.x)[k]);
+    }
+}
@@ -0,0 +1,72 @@
+//***************************************************************************************
+// HeightmapSampler.h
+//
+// Height (and normal) lookups on a heightmap in memory, one point at a time or in
+// batches.  Each cell is split into the triangles ABC and DCB like Terrain::GetHeight:
+//
+//   A*--*B
+//    | /|
+//    |/ |
+//   C*--*D
+//
+// Samples are either float heights or unorm16 values with a scale and offset.  The
+// batched GetHeights handles four points per iteration: the cell indices and the
+// interpolation run in SIMD, the 4x4 sample fetches are gathered lane by lane, and
+// large batches are split across a TaskPool.
+//
+// The sampler does not own the samples.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TaskPool;
+
+class HeightmapSampler
+{
+public:
+    // Placement of the samples in the xz-plane.  Sample (col, row) lies at
+    // x = OriginX + col*CellSpacing, z = OriginZ - row*CellSpacing, so rows run
+    // towards -z like the rows of a RAW heightmap.
+    struct Grid
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+        float CellSpacing = 1.0f;
+        float OriginX = 0.0f;
+        float OriginZ = 0.0f;
+    };
+
+    // Batches at least this large are split across the pool.
+    static constexpr UINT ParallelBatchSize = 8192;
+
+    HeightmapSampler(const float* heights, const Grid& grid);
+
+    // height = heightScale*sample/65535 + heightOffset.
+    HeightmapSampler(const uint16_t* samples, float heightScale, float heightOffset, const Grid& grid);
+
+    // Height at (x, z), and the unit normal of the triangle under it if normal is
+    // not null.  Points off the grid are clamped to its edge.
+    float GetHeight(float x, float z, DirectX::XMFLOAT3* normal = nullptr)const;
+
+    // heights[i] = GetHeight(x[i], z[i], &normals[i]); normals may be null.  Batches
+    // of ParallelBatchSize points or more run on pool (TaskPool::Default() if null).
+    void GetHeights(const float* x, const float* z, UINT count, float* heights,
+                    DirectX::XMFLOAT3* normals = nullptr, TaskPool* pool = nullptr)const;
+
+private:
+    template<typename FetchFn>
+    void GetHeightsRange(const float* x, const float* z, UINT begin, UINT end, float* heights,
+                         DirectX::XMFLOAT3* normals, const FetchFn& fetch)const;
+
+    float SampleToHeight(uint16_t sample)const;
+
+private:
+    const float* mHeights = nullptr;
+    const uint16_t* mSamples = nullptr;
+    float mHeightScale = 1.0f;
+    float mHeightOffset = 0.0f;
+
+    Grid mGrid;
+};
@@ -0,0 +1,128 @@
+//***************************************************************************************
+// JobGraph.cpp
+//***************************************************************************************
+
+#include "JobGraph.h"
+
+JobGraph::~JobGraph()
+{
+    Wait();
+}
+
+JobGraph::JobId JobGraph::Add(const std::string& name, std::function<void()> fn)
+{
+    assert(mPool == nullptr);
+
+    Job job;
+    job.Name = name;
+    job.Fn = std::move(fn);
+    mJobs.push_back(std::move(job));
+
+    return (JobId)mJobs.size() - 1;
+}
+
+void JobGraph::AddDependency(JobId job, JobId prerequisite)
+{
+    assert(mPool == nullptr);
+    assert(prerequisite < job && job < (JobId)mJobs.size());
+
+    mJobs[prerequisite].Dependents.push_back(job);
+    mJobs[job].PrerequisiteCount++;
+}
+
+void JobGraph::Clear()
+{
+    assert(mPool == nullptr);
+    mJobs.clear();
+}
+
+void JobGraph::Kick(TaskPool& pool)
+{
+    assert(mPool == nullptr);
+
+    if(mWaitCountCapacity < (UINT)mJobs.size())
+    {
+        mWaitCountCapacity = (UINT)mJobs.size();
+        mWaitCounts = std::make_unique<std::atomic<UINT>[]>(mWaitCountCapacity);
+    }
+
+    for(JobId j = 0; j < (JobId)mJobs.size(); ++j)
+        mWaitCounts[j].store(mJobs[j].PrerequisiteCount, std::memory_order_relaxed);
+
+    mPool = &pool;
+    mKickTime = std::chrono::high_resolution_clock::now();
+
+    for(JobId j = 0; j < (JobId)mJobs.size(); ++j)
+    {
+        if(mJobs[j].PrerequisiteCount == 0)
+            pool.Spawn(&JobGraph::Execute, this, j, j + 1, mPending);
+    }
+}
+
+void JobGraph::Wait()
+{
+    if(mPool == nullptr)
+        return;
+
+    mPool->WaitFor(mPending);
+    mPool = nullptr;
+}
+
+void JobGraph::Run(TaskPool& pool)
+{
+    Kick(pool);
+    Wait();
+}
+
+UINT JobGraph::JobCount()const
+{
+    return (UINT)mJobs.size();
+}
+
+const std::string& JobGraph::JobName(JobId job)const
+{
+    return mJobs[job].Name;
+}
+
+const JobTiming& JobGraph::GetTiming(JobId job)const
+{
+    return mJobs[job].Timing;
+}
+
+float JobGraph::RunMs()const
+{
+    float runMs = 0.0f;
+    for(const Job& job : mJobs)
+        runMs = std::max(runMs, job.Timing.EndMs);
+
+    return runMs;
+}
+
+void JobGraph::Execute(void* context, UINT job, UINT unused)
+{
+    static_cast<JobGraph*>(context)->RunJob(job);
+}
+
+void JobGraph::RunJob(JobId id)
+{
+    Job& job = mJobs[id];
+    job.Timing.Thread = mPool->CurrentThreadIndex();
+    job.Timing.StartMs = ElapsedMs();
+
+    job.Fn();
+
+    job.Timing.EndMs = ElapsedMs();
+
+    // Queued before this job counts as finished, so the run cannot end in between.
+    for(JobId dependent : job.Dependents)
+    {
+        if(mWaitCounts[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            mPool->Spawn(&JobGraph::Execute, this, dependent, dependent + 1, mPending);
+    }
+}
+
+float JobGraph::ElapsedMs()const
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float, std::milli>(now - mKickTime).count();
+}
@@ -0,0 +1,93 @@
+//***************************************************************************************
+// JobGraph.h
+//
+// A frame's CPU work split into jobs with dependencies, run on a TaskPool.  The graph
+// is built once and kicked every frame.  Kick queues the jobs that have no
+// prerequisites; a finishing job queues each dependent it was the last prerequisite
+// of, on the same thread's ring, where idle threads steal it.
+//
+// Kick returns at once, so the calling thread can do work that does not depend on
+// the jobs, such as recording the start of a command list, before Wait.  Wait runs
+// queued jobs rather than blocking.  A job with data parallel work of its own calls
+// TaskPool::ParallelFor from inside.
+//
+// Every run times its jobs, for frame time breakdowns.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TaskPool.h"
+#include <chrono>
+#include <functional>
+
+struct JobTiming
+{
+    // Milliseconds from Kick.
+    float StartMs = 0.0f;
+    float EndMs = 0.0f;
+
+    // TaskPool::CurrentThreadIndex of the thread that ran the job.
+    UINT Thread = 0;
+};
+
+class JobGraph
+{
+public:
+    using JobId = UINT;
+
+    JobGraph() = default;
+    JobGraph(const JobGraph& rhs) = delete;
+    JobGraph& operator=(const JobGraph& rhs) = delete;
+    ~JobGraph();
+
+    JobId Add(const std::string& name, std::function<void()> fn);
+
+    // job starts only once prerequisite has finished.  A job can only depend on jobs
+    // added before it, which keeps the graph free of cycles.
+    void AddDependency(JobId job, JobId prerequisite);
+
+    // Removes every job.  Not while a run is in flight.
+    void Clear();
+
+    // Starts a run on pool.  The previous run must have been waited for.
+    void Kick(TaskPool& pool);
+
+    // Returns once every job of the run has finished; nothing to do if none was kicked.
+    void Wait();
+
+    void Run(TaskPool& pool);
+
+    UINT JobCount()const;
+    const std::string& JobName(JobId job)const;
+
+    // Timing of the job in the last run that was waited for.
+    const JobTiming& GetTiming(JobId job)const;
+
+    // From Kick to the end of the last job to finish, in the last run.
+    float RunMs()const;
+
+private:
+    struct Job
+    {
+        std::string Name;
+        std::function<void()> Fn;
+        std::vector<JobId> Dependents;
+        UINT PrerequisiteCount = 0;
+        JobTiming Timing;
+    };
+
+    static void Execute(void* context, UINT job, UINT unused);
+    void RunJob(JobId job);
+    float ElapsedMs()const;
+
+    std::vector<Job> mJobs;
+
+    // Prerequisites each job still waits for in the current run.
+    std::unique_ptr<std::atomic<UINT>[]> mWaitCounts;
+    UINT mWaitCountCapacity = 0;
+
+    TaskPool* mPool = nullptr;
+    std::atomic<UINT> mPending = 0;
+    std::chrono::high_resolution_clock::time_point mKickTime;
+};
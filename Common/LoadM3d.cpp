@@ -1,4 +1,5 @@
 #include "LoadM3d.h"
+#include "M3dBinary.h"
  
 using namespace DirectX;
 
@@ -7,6 +8,75 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 						std::vector<UINT>& indices,
 						std::vector<Subset>& subsets,
 						std::vector<M3dMaterial>& mats)
+{
+	if(HasUpToDateBinary(filename))
+	{
+		M3dBinaryFile file;
+		if(file.Open(M3dBinary::BinaryFilename(filename)) && !file.IsSkinned())
+		{
+			Span<const Vertex> binVertices = file.Vertices();
+			Span<const UINT> binIndices = file.Indices();
+			Span<const Subset> binSubsets = file.Subsets();
+
+			vertices.assign(binVertices.begin(), binVertices.end());
+			indices.assign(binIndices.begin(), binIndices.end());
+			subsets.assign(binSubsets.begin(), binSubsets.end());
+			file.GetMaterials(mats);
+
+			return true;
+		}
+	}
+
+	return LoadM3dText(filename, vertices, indices, subsets, mats);
+}
+
+bool M3DLoader::LoadM3d(const std::string& filename, 
+						std::vector<SkinnedVertex>& vertices,
+						std::vector<UINT>& indices,
+						std::vector<Subset>& subsets,
+						std::vector<M3dMaterial>& mats,
+						SkinnedData& skinInfo,
+						const AnimationCompressionSettings* animationCompression)
+{
+	if(HasUpToDateBinary(filename))
+	{
+		M3dBinaryFile file;
+		if(file.Open(M3dBinary::BinaryFilename(filename)) && file.IsSkinned())
+		{
+			Span<const SkinnedVertex> binVertices = file.SkinnedVertices();
+			Span<const UINT> binIndices = file.Indices();
+			Span<const Subset> binSubsets = file.Subsets();
+
+			vertices.assign(binVertices.begin(), binVertices.end());
+			indices.assign(binIndices.begin(), binIndices.end());
+			subsets.assign(binSubsets.begin(), binSubsets.end());
+			file.GetMaterials(mats);
+			file.GetSkinnedData(skinInfo, animationCompression);
+
+			return true;
+		}
+	}
+
+	std::vector<XMFLOAT4X4> boneOffsets;
+	std::vector<int> boneIndexToParentIndex;
+	std::unordered_map<std::string, AnimationClip> animations;
+
+	if(!LoadM3dText(filename, vertices, indices, subsets, mats, 
+	                boneOffsets, boneIndexToParentIndex, animations))
+	{
+		return false;
+	}
+
+	skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations, animationCompression);
+
+	return true;
+}
+
+bool M3DLoader::LoadM3dText(const std::string& filename, 
+							std::vector<Vertex>& vertices,
+							std::vector<UINT>& indices,
+							std::vector<Subset>& subsets,
+							std::vector<M3dMaterial>& mats)
 {
 	std::ifstream fin(filename);
 
@@ -16,17 +86,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	UINT numBones     = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
-
-	if( fin )
+	if( ReadHeader(fin, numMaterials, numVertices, numTriangles, numBones, numAnimationClips) )
 	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
- 
 		ReadMaterials(fin, numMaterials, mats);
 		ReadSubsetTable(fin, numMaterials, subsets);
 	    ReadVertices(fin, numVertices, vertices);
@@ -37,12 +98,14 @@ bool M3DLoader::LoadM3d(const std::string& filename,
     return false;
 }
 
-bool M3DLoader::LoadM3d(const std::string& filename, 
-						std::vector<SkinnedVertex>& vertices,
-						std::vector<UINT>& indices,
-						std::vector<Subset>& subsets,
-						std::vector<M3dMaterial>& mats,
-						SkinnedData& skinInfo)
+bool M3DLoader::LoadM3dText(const std::string& filename, 
+							std::vector<SkinnedVertex>& vertices,
+							std::vector<UINT>& indices,
+							std::vector<Subset>& subsets,
+							std::vector<M3dMaterial>& mats,
+							std::vector<XMFLOAT4X4>& boneOffsets,
+							std::vector<int>& boneIndexToParentIndex,
+							std::unordered_map<std::string, AnimationClip>& animations)
 {
 	std::ifstream fin(filename.c_str());
 
@@ -58,21 +121,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	UINT numBones     = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
-
-	if( fin )
+	if( ReadHeader(fin, numMaterials, numVertices, numTriangles, numBones, numAnimationClips) )
 	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
- 
-		std::vector<XMFLOAT4X4> boneOffsets;
-		std::vector<int> boneIndexToParentIndex;
-		std::unordered_map<std::string, AnimationClip> animations;
-
 		ReadMaterials(fin, numMaterials, mats);
 		ReadSubsetTable(fin, numMaterials, subsets);
 	    ReadSkinnedVertices(fin, numVertices, vertices);
@@ -80,14 +130,85 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 		ReadBoneOffsets(fin, numBones, boneOffsets);
 	    ReadBoneHierarchy(fin, numBones, boneIndexToParentIndex);
 	    ReadAnimationClips(fin, numBones, numAnimationClips, animations);
- 
-		skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
 
 	    return true;
 	}
     return false;
 }
 
+bool M3DLoader::ConvertToBinary(const std::string& m3dFilename, const std::string& m3dbFilename)
+{
+	UINT numMaterials = 0;
+	UINT numVertices  = 0;
+	UINT numTriangles = 0;
+	UINT numBones     = 0;
+	UINT numAnimationClips = 0;
+
+	{
+		std::ifstream fin(m3dFilename);
+		if(!ReadHeader(fin, numMaterials, numVertices, numTriangles, numBones, numAnimationClips))
+			return false;
+	}
+
+	std::vector<UINT> indices;
+	std::vector<Subset> subsets;
+	std::vector<M3dMaterial> mats;
+
+	// Models without bones use the static vertex format.
+	if(numBones == 0)
+	{
+		std::vector<Vertex> vertices;
+		if(!LoadM3dText(m3dFilename, vertices, indices, subsets, mats))
+			return false;
+
+		return M3dBinary::WriteStatic(m3dbFilename, vertices, indices, subsets, mats);
+	}
+
+	std::vector<SkinnedVertex> vertices;
+	std::vector<XMFLOAT4X4> boneOffsets;
+	std::vector<int> boneIndexToParentIndex;
+	std::unordered_map<std::string, AnimationClip> animations;
+	if(!LoadM3dText(m3dFilename, vertices, indices, subsets, mats, 
+	                boneOffsets, boneIndexToParentIndex, animations))
+	{
+		return false;
+	}
+
+	return M3dBinary::WriteSkinned(m3dbFilename, vertices, indices, subsets, mats,
+	                               boneOffsets, boneIndexToParentIndex, animations);
+}
+
+bool M3DLoader::HasUpToDateBinary(const std::string& filename)
+{
+	std::error_code ec;
+	const std::string binaryFilename = M3dBinary::BinaryFilename(filename);
+	if(!std::filesystem::exists(binaryFilename, ec))
+		return false;
+
+	// If the text file was not shipped, the binary file is all we have.
+	if(!std::filesystem::exists(filename, ec))
+		return true;
+
+	return std::filesystem::last_write_time(binaryFilename, ec) >= std::filesystem::last_write_time(filename, ec);
+}
+
+bool M3DLoader::ReadHeader(std::ifstream& fin, UINT& numMaterials, UINT& numVertices, UINT& numTriangles, UINT& numBones, UINT& numAnimationClips)
+{
+	std::string ignore;
+
+	if( fin )
+	{
+		fin >> ignore; // file header text
+		fin >> ignore >> numMaterials;
+		fin >> ignore >> numVertices;
+		fin >> ignore >> numTriangles;
+		fin >> ignore >> numBones;
+		fin >> ignore >> numAnimationClips;
+	}
+
+	return !fin.fail();
+}
+
 void M3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
 {
 	 std::string ignore;
@@ -59,9 +59,36 @@ public:
 		std::vector<UINT>& indices,
 		std::vector<Subset>& subsets,
 		std::vector<M3dMaterial>& mats,
-		SkinnedData& skinInfo);
+		SkinnedData& skinInfo,
+		const AnimationCompressionSettings* animationCompression = nullptr);
+
+	// The LoadM3d functions above first look for an up-to-date binary .m3db file
+	// next to filename (see M3dBinary.h) and only parse the text file if there is
+	// none.  Passing animationCompression stores the skinned model's clips compressed
+	// (see SkinnedData::Set).  These always parse the text file.
+	bool LoadM3dText(const std::string& filename, 
+		std::vector<Vertex>& vertices,
+		std::vector<UINT>& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats);
+	bool LoadM3dText(const std::string& filename, 
+		std::vector<SkinnedVertex>& vertices,
+		std::vector<UINT>& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
+		std::vector<int>& boneIndexToParentIndex,
+		std::unordered_map<std::string, AnimationClip>& animations);
+
+	// Parses the text .m3d file and writes it out as a binary .m3db file.
+	bool ConvertToBinary(const std::string& m3dFilename, const std::string& m3dbFilename);
+
+	// Returns true if the .m3db file for filename exists and is not older than filename.
+	static bool HasUpToDateBinary(const std::string& filename);
 
 private:
+	bool ReadHeader(std::ifstream& fin, UINT& numMaterials, UINT& numVertices, UINT& numTriangles, UINT& numBones, UINT& numAnimationClips);
+
 	void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
 	void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets);
 	void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices);
@@ -0,0 +1,466 @@
+#include "M3dBinary.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // d3dUtil::Align works on UINT; section offsets are 64-bit.
+    uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + (alignment - 1)) & ~(alignment - 1);
+    }
+
+    // Accumulates the sections of an .m3db file in memory so we can patch
+    // the header's section table before writing everything in one go.
+    class M3dBinaryBuilder
+    {
+    public:
+        M3dBinaryBuilder()
+        {
+            // Offset 0 is reserved for the empty string.
+            mStrings.push_back('\0');
+        }
+
+        uint32_t AddString(const std::string& str)
+        {
+            if(str.empty())
+                return 0;
+
+            auto it = mStringOffsets.find(str);
+            if(it != mStringOffsets.end())
+                return it->second;
+
+            uint32_t offset = (uint32_t)mStrings.size();
+            mStrings.insert(mStrings.end(), str.begin(), str.end());
+            mStrings.push_back('\0');
+
+            mStringOffsets[str] = offset;
+            return offset;
+        }
+
+        template<typename T>
+        void SetSection(M3dBinary::Section section, const T* data, size_t count)
+        {
+            mSectionData[section] = data;
+            mHeader.Sections[section].ByteSize = count * sizeof(T);
+        }
+
+        M3dBinary::Header& GetHeader()
+        {
+            return mHeader;
+        }
+
+        bool Write(const std::string& filename)
+        {
+            SetSection(M3dBinary::SectionStrings, mStrings.data(), mStrings.size());
+
+            // Lay the sections out back to back after the header.
+            uint64_t offset = AlignOffset(sizeof(M3dBinary::Header), M3dBinary::SectionAlignment);
+            for(uint32_t i = 0; i < M3dBinary::SectionCount; ++i)
+            {
+                mHeader.Sections[i].Offset = offset;
+                offset = AlignOffset(offset + mHeader.Sections[i].ByteSize, M3dBinary::SectionAlignment);
+            }
+
+            std::vector<BYTE> fileData(offset, 0);
+            CopyMemory(fileData.data(), &mHeader, sizeof(M3dBinary::Header));
+            for(uint32_t i = 0; i < M3dBinary::SectionCount; ++i)
+            {
+                if(mHeader.Sections[i].ByteSize > 0)
+                {
+                    CopyMemory(fileData.data() + mHeader.Sections[i].Offset,
+                               mSectionData[i],
+                               (size_t)mHeader.Sections[i].ByteSize);
+                }
+            }
+
+            std::ofstream fout(filename, std::ios::binary);
+            if(!fout)
+                return false;
+
+            fout.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+            return fout.good();
+        }
+
+    private:
+        M3dBinary::Header mHeader;
+        const void* mSectionData[M3dBinary::SectionCount] = {};
+
+        std::vector<char> mStrings;
+        std::unordered_map<std::string, uint32_t> mStringOffsets;
+    };
+
+    std::vector<M3dBinary::Material> BuildMaterials(M3dBinaryBuilder& builder, const std::vector<M3DLoader::M3dMaterial>& mats)
+    {
+        std::vector<M3dBinary::Material> binMats(mats.size());
+        for(size_t i = 0; i < mats.size(); ++i)
+        {
+            binMats[i].NameOffset = builder.AddString(mats[i].Name);
+            binMats[i].MaterialTypeNameOffset = builder.AddString(mats[i].MaterialTypeName);
+            binMats[i].DiffuseMapNameOffset = builder.AddString(mats[i].DiffuseMapName);
+            binMats[i].NormalMapNameOffset = builder.AddString(mats[i].NormalMapName);
+            binMats[i].DiffuseAlbedo = mats[i].DiffuseAlbedo;
+            binMats[i].FresnelR0 = mats[i].FresnelR0;
+            binMats[i].Roughness = mats[i].Roughness;
+            binMats[i].AlphaClip = mats[i].AlphaClip ? 1 : 0;
+        }
+
+        return binMats;
+    }
+}
+
+std::string M3dBinary::BinaryFilename(const std::string& m3dFilename)
+{
+    return std::filesystem::path(m3dFilename).replace_extension(".m3db").string();
+}
+
+bool M3dBinary::WriteStatic(
+    const std::string& filename,
+    const std::vector<M3DLoader::Vertex>& vertices,
+    const std::vector<UINT>& indices,
+    const std::vector<M3DLoader::Subset>& subsets,
+    const std::vector<M3DLoader::M3dMaterial>& mats)
+{
+    M3dBinaryBuilder builder;
+
+    std::vector<M3dBinary::Material> binMats = BuildMaterials(builder, mats);
+
+    M3dBinary::Header& header = builder.GetHeader();
+    header.VertexByteStride = sizeof(M3DLoader::Vertex);
+    header.NumMaterials = (uint32_t)mats.size();
+    header.NumVertices = (uint32_t)vertices.size();
+    header.NumTriangles = (uint32_t)indices.size() / 3;
+
+    builder.SetSection(SectionMaterials, binMats.data(), binMats.size());
+    builder.SetSection(SectionSubsets, subsets.data(), subsets.size());
+    builder.SetSection(SectionVertices, vertices.data(), vertices.size());
+    builder.SetSection(SectionIndices, indices.data(), indices.size());
+
+    return builder.Write(filename);
+}
+
+bool M3dBinary::WriteSkinned(
+    const std::string& filename,
+    const std::vector<M3DLoader::SkinnedVertex>& vertices,
+    const std::vector<UINT>& indices,
+    const std::vector<M3DLoader::Subset>& subsets,
+    const std::vector<M3DLoader::M3dMaterial>& mats,
+    const std::vector<XMFLOAT4X4>& boneOffsets,
+    const std::vector<int>& boneHierarchy,
+    const std::unordered_map<std::string, AnimationClip>& animations)
+{
+    M3dBinaryBuilder builder;
+
+    std::vector<M3dBinary::Material> binMats = BuildMaterials(builder, mats);
+
+    // Flatten the clips: every clip has one track per bone, and the tracks
+    // index into a single keyframe array.
+    std::vector<M3dBinary::Clip> clips;
+    std::vector<M3dBinary::Track> tracks;
+    std::vector<M3dBinary::Keyframe> keyframes;
+    for(const auto& [clipName, clip] : animations)
+    {
+        M3dBinary::Clip binClip;
+        binClip.NameOffset = builder.AddString(clipName);
+        binClip.FirstTrack = (uint32_t)tracks.size();
+        clips.push_back(binClip);
+
+        assert(clip.BoneAnimations.size() == boneOffsets.size());
+        for(const BoneAnimation& boneAnim : clip.BoneAnimations)
+        {
+            M3dBinary::Track track;
+            track.FirstKeyframe = (uint32_t)keyframes.size();
+            track.KeyframeCount = (uint32_t)boneAnim.Keyframes.size();
+            tracks.push_back(track);
+
+            for(const ::Keyframe& key : boneAnim.Keyframes)
+            {
+                M3dBinary::Keyframe binKey;
+                binKey.TimePos = key.TimePos;
+                binKey.Translation = key.Translation;
+                binKey.Scale = key.Scale;
+                binKey.RotationQuat = key.RotationQuat;
+                keyframes.push_back(binKey);
+            }
+        }
+    }
+
+    M3dBinary::Header& header = builder.GetHeader();
+    header.Flags = FlagSkinned;
+    header.VertexByteStride = sizeof(M3DLoader::SkinnedVertex);
+    header.NumMaterials = (uint32_t)mats.size();
+    header.NumVertices = (uint32_t)vertices.size();
+    header.NumTriangles = (uint32_t)indices.size() / 3;
+    header.NumBones = (uint32_t)boneOffsets.size();
+    header.NumAnimationClips = (uint32_t)clips.size();
+
+    builder.SetSection(SectionMaterials, binMats.data(), binMats.size());
+    builder.SetSection(SectionSubsets, subsets.data(), subsets.size());
+    builder.SetSection(SectionVertices, vertices.data(), vertices.size());
+    builder.SetSection(SectionIndices, indices.data(), indices.size());
+    builder.SetSection(SectionBoneOffsets, boneOffsets.data(), boneOffsets.size());
+    builder.SetSection(SectionBoneHierarchy, boneHierarchy.data(), boneHierarchy.size());
+    builder.SetSection(SectionClips, clips.data(), clips.size());
+    builder.SetSection(SectionTracks, tracks.data(), tracks.size());
+    builder.SetSection(SectionKeyframes, keyframes.data(), keyframes.size());
+
+    return builder.Write(filename);
+}
+
+M3dBinaryFile::~M3dBinaryFile()
+{
+    Close();
+}
+
+bool M3dBinaryFile::Open(const std::string& filename)
+{
+    Close();
+
+    mFile = CreateFileW(AnsiToWString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(mFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(M3dBinary::Header))
+    {
+        Close();
+        return false;
+    }
+    mFileSize = (uint64_t)fileSize.QuadPart;
+
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mMapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mData = reinterpret_cast<const BYTE*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if(mData == nullptr || !Validate())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void M3dBinaryFile::Close()
+{
+    if(mData != nullptr)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+
+    if(mMapping != nullptr)
+    {
+        CloseHandle(mMapping);
+        mMapping = nullptr;
+    }
+
+    if(mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+
+    mFileSize = 0;
+}
+
+bool M3dBinaryFile::Validate()const
+{
+    const M3dBinary::Header& header = GetHeader();
+    if(header.Magic != M3dBinary::Magic || header.Version != M3dBinary::Version)
+        return false;
+
+    for(uint32_t i = 0; i < M3dBinary::SectionCount; ++i)
+    {
+        const M3dBinary::SectionDesc& desc = header.Sections[i];
+        if(desc.Offset % M3dBinary::SectionAlignment != 0 ||
+           desc.Offset > mFileSize ||
+           desc.ByteSize > mFileSize - desc.Offset)
+        {
+            return false;
+        }
+    }
+
+    const bool skinned = IsSkinned();
+    const uint32_t expectedStride = skinned ? sizeof(M3DLoader::SkinnedVertex) : sizeof(M3DLoader::Vertex);
+    const uint32_t numTracks = header.NumAnimationClips * header.NumBones;
+
+    auto sectionSize = [&header](M3dBinary::Section section) { return header.Sections[section].ByteSize; };
+
+    if(header.VertexByteStride != expectedStride ||
+       sectionSize(M3dBinary::SectionVertices) != (uint64_t)header.NumVertices * expectedStride ||
+       sectionSize(M3dBinary::SectionIndices) != (uint64_t)header.NumTriangles * 3 * sizeof(UINT) ||
+       sectionSize(M3dBinary::SectionMaterials) != (uint64_t)header.NumMaterials * sizeof(M3dBinary::Material) ||
+       sectionSize(M3dBinary::SectionSubsets) % sizeof(M3DLoader::Subset) != 0 ||
+       sectionSize(M3dBinary::SectionBoneOffsets) != (uint64_t)header.NumBones * sizeof(XMFLOAT4X4) ||
+       sectionSize(M3dBinary::SectionBoneHierarchy) != (uint64_t)header.NumBones * sizeof(int) ||
+       sectionSize(M3dBinary::SectionClips) != (uint64_t)header.NumAnimationClips * sizeof(M3dBinary::Clip) ||
+       sectionSize(M3dBinary::SectionTracks) != (uint64_t)numTracks * sizeof(M3dBinary::Track) ||
+       sectionSize(M3dBinary::SectionKeyframes) % sizeof(M3dBinary::Keyframe) != 0)
+    {
+        return false;
+    }
+
+    // Strings must be null-terminated so GetString can never run off the end.
+    Span<const char> strings = GetSection<char>(M3dBinary::SectionStrings);
+    if(strings.empty() || strings[strings.size() - 1] != '\0')
+        return false;
+
+    Span<const M3dBinary::Clip> clips = Clips();
+    for(const M3dBinary::Clip& clip : clips)
+    {
+        if(clip.FirstTrack + header.NumBones > numTracks)
+            return false;
+    }
+
+    const size_t numKeyframes = Keyframes().size();
+    for(const M3dBinary::Track& track : Tracks())
+    {
+        // BoneAnimation assumes at least one keyframe per track.
+        if(track.KeyframeCount == 0 || (size_t)track.FirstKeyframe + track.KeyframeCount > numKeyframes)
+            return false;
+    }
+
+    return true;
+}
+
+bool M3dBinaryFile::IsOpen()const
+{
+    return mData != nullptr;
+}
+
+bool M3dBinaryFile::IsSkinned()const
+{
+    return (GetHeader().Flags & M3dBinary::FlagSkinned) != 0;
+}
+
+const M3dBinary::Header& M3dBinaryFile::GetHeader()const
+{
+    assert(mData != nullptr);
+    return *reinterpret_cast<const M3dBinary::Header*>(mData);
+}
+
+Span<const M3DLoader::Vertex> M3dBinaryFile::Vertices()const
+{
+    if(IsSkinned())
+        return {};
+
+    return GetSection<M3DLoader::Vertex>(M3dBinary::SectionVertices);
+}
+
+Span<const M3DLoader::SkinnedVertex> M3dBinaryFile::SkinnedVertices()const
+{
+    if(!IsSkinned())
+        return {};
+
+    return GetSection<M3DLoader::SkinnedVertex>(M3dBinary::SectionVertices);
+}
+
+Span<const UINT> M3dBinaryFile::Indices()const
+{
+    return GetSection<UINT>(M3dBinary::SectionIndices);
+}
+
+Span<const M3DLoader::Subset> M3dBinaryFile::Subsets()const
+{
+    return GetSection<M3DLoader::Subset>(M3dBinary::SectionSubsets);
+}
+
+Span<const M3dBinary::Material> M3dBinaryFile::Materials()const
+{
+    return GetSection<M3dBinary::Material>(M3dBinary::SectionMaterials);
+}
+
+Span<const XMFLOAT4X4> M3dBinaryFile::BoneOffsets()const
+{
+    return GetSection<XMFLOAT4X4>(M3dBinary::SectionBoneOffsets);
+}
+
+Span<const int> M3dBinaryFile::BoneHierarchy()const
+{
+    return GetSection<int>(M3dBinary::SectionBoneHierarchy);
+}
+
+Span<const M3dBinary::Clip> M3dBinaryFile::Clips()const
+{
+    return GetSection<M3dBinary::Clip>(M3dBinary::SectionClips);
+}
+
+Span<const M3dBinary::Track> M3dBinaryFile::Tracks()const
+{
+    return GetSection<M3dBinary::Track>(M3dBinary::SectionTracks);
+}
+
+Span<const M3dBinary::Keyframe> M3dBinaryFile::Keyframes()const
+{
+    return GetSection<M3dBinary::Keyframe>(M3dBinary::SectionKeyframes);
+}
+
+const char* M3dBinaryFile::GetString(uint32_t offset)const
+{
+    Span<const char> strings = GetSection<char>(M3dBinary::SectionStrings);
+    if(offset >= strings.size())
+        return "";
+
+    return strings.data() + offset;
+}
+
+void M3dBinaryFile::GetMaterials(std::vector<M3DLoader::M3dMaterial>& mats)const
+{
+    Span<const M3dBinary::Material> binMats = Materials();
+
+    mats.resize(binMats.size());
+    for(size_t i = 0; i < binMats.size(); ++i)
+    {
+        mats[i].Name = GetString(binMats[i].NameOffset);
+        mats[i].DiffuseAlbedo = binMats[i].DiffuseAlbedo;
+        mats[i].FresnelR0 = binMats[i].FresnelR0;
+        mats[i].Roughness = binMats[i].Roughness;
+        mats[i].AlphaClip = binMats[i].AlphaClip != 0;
+        mats[i].MaterialTypeName = GetString(binMats[i].MaterialTypeNameOffset);
+        mats[i].DiffuseMapName = GetString(binMats[i].DiffuseMapNameOffset);
+        mats[i].NormalMapName = GetString(binMats[i].NormalMapNameOffset);
+    }
+}
+
+void M3dBinaryFile::GetSkinnedData(SkinnedData& skinInfo, const AnimationCompressionSettings* compression)const
+{
+    Span<const XMFLOAT4X4> binBoneOffsets = BoneOffsets();
+    Span<const int> binBoneHierarchy = BoneHierarchy();
+    Span<const M3dBinary::Track> tracks = Tracks();
+    Span<const M3dBinary::Keyframe> keyframes = Keyframes();
+
+    std::vector<XMFLOAT4X4> boneOffsets(binBoneOffsets.begin(), binBoneOffsets.end());
+    std::vector<int> boneHierarchy(binBoneHierarchy.begin(), binBoneHierarchy.end());
+    std::unordered_map<std::string, AnimationClip> animations;
+
+    const uint32_t numBones = GetHeader().NumBones;
+    for(const M3dBinary::Clip& binClip : Clips())
+    {
+        AnimationClip& clip = animations[GetString(binClip.NameOffset)];
+        clip.BoneAnimations.resize(numBones);
+
+        for(uint32_t boneIndex = 0; boneIndex < numBones; ++boneIndex)
+        {
+            const M3dBinary::Track& track = tracks[binClip.FirstTrack + boneIndex];
+            std::vector<::Keyframe>& boneKeyframes = clip.BoneAnimations[boneIndex].Keyframes;
+
+            boneKeyframes.resize(track.KeyframeCount);
+            for(uint32_t i = 0; i < track.KeyframeCount; ++i)
+            {
+                const M3dBinary::Keyframe& binKey = keyframes[track.FirstKeyframe + i];
+                boneKeyframes[i].TimePos = binKey.TimePos;
+                boneKeyframes[i].Translation = binKey.Translation;
+                boneKeyframes[i].Scale = binKey.Scale;
+                boneKeyframes[i].RotationQuat = binKey.RotationQuat;
+            }
+        }
+    }
+
+    skinInfo.Set(boneHierarchy, boneOffsets, animations, compression);
+}
@@ -0,0 +1,191 @@
+//***************************************************************************************
+// M3dBinary.h
+//
+// Binary ".m3db" container for .m3d models.  The text format is convenient to author
+// and inspect, but parsing it with std::ifstream is slow.  The binary file stores the
+// same data in the exact memory layout the loader wants, so it can be memory mapped
+// and the vertex/index/subset/material arrays handed out without any copy.
+//
+// Use M3DLoader::ConvertToBinary (or the Tools/M3dConvert command line tool) to
+// generate the .m3db file next to the .m3d file.  M3DLoader::LoadM3d automatically
+// prefers the binary file when it exists and is up to date.
+//***************************************************************************************
+
+#pragma once
+
+#include "LoadM3d.h"
+
+namespace M3dBinary
+{
+    // "M3DB" in little endian.
+    constexpr uint32_t Magic = 0x4244334D;
+
+    // Bump whenever the layout of anything below changes.
+    constexpr uint32_t Version = 1;
+
+    // Every section starts on this boundary so the mapped arrays are SIMD aligned.
+    constexpr uint32_t SectionAlignment = 16;
+
+    enum HeaderFlags : uint32_t
+    {
+        FlagSkinned = 0x1,
+    };
+
+    enum Section : uint32_t
+    {
+        SectionStrings = 0,
+        SectionMaterials,
+        SectionSubsets,
+        SectionVertices,
+        SectionIndices,
+        SectionBoneOffsets,
+        SectionBoneHierarchy,
+        SectionClips,
+        SectionTracks,
+        SectionKeyframes,
+        SectionCount
+    };
+
+    struct SectionDesc
+    {
+        uint64_t Offset = 0;
+        uint64_t ByteSize = 0;
+    };
+
+    struct Header
+    {
+        uint32_t Magic = M3dBinary::Magic;
+        uint32_t Version = M3dBinary::Version;
+        uint32_t Flags = 0;
+        uint32_t VertexByteStride = 0;
+
+        uint32_t NumMaterials = 0;
+        uint32_t NumVertices = 0;
+        uint32_t NumTriangles = 0;
+        uint32_t NumBones = 0;
+        uint32_t NumAnimationClips = 0;
+        uint32_t Pad[3] = { 0, 0, 0 };
+
+        SectionDesc Sections[SectionCount];
+    };
+
+    // Strings are stored as offsets into the null-terminated string section.
+    struct Material
+    {
+        uint32_t NameOffset = 0;
+        uint32_t MaterialTypeNameOffset = 0;
+        uint32_t DiffuseMapNameOffset = 0;
+        uint32_t NormalMapNameOffset = 0;
+
+        DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+        DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+        float Roughness = 0.8f;
+        uint32_t AlphaClip = 0;
+    };
+
+    // A clip owns NumBones consecutive tracks starting at FirstTrack.
+    struct Clip
+    {
+        uint32_t NameOffset = 0;
+        uint32_t FirstTrack = 0;
+    };
+
+    struct Track
+    {
+        uint32_t FirstKeyframe = 0;
+        uint32_t KeyframeCount = 0;
+    };
+
+    // Same data as ::Keyframe, but trivially copyable so it can live in mapped memory.
+    struct Keyframe
+    {
+        float TimePos = 0.0f;
+        DirectX::XMFLOAT3 Translation = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+        DirectX::XMFLOAT4 RotationQuat = { 0.0f, 0.0f, 0.0f, 1.0f };
+    };
+
+    // Returns the .m3db filename that sits next to the given .m3d filename.
+    std::string BinaryFilename(const std::string& m3dFilename);
+
+    bool WriteStatic(
+        const std::string& filename,
+        const std::vector<M3DLoader::Vertex>& vertices,
+        const std::vector<UINT>& indices,
+        const std::vector<M3DLoader::Subset>& subsets,
+        const std::vector<M3DLoader::M3dMaterial>& mats);
+
+    bool WriteSkinned(
+        const std::string& filename,
+        const std::vector<M3DLoader::SkinnedVertex>& vertices,
+        const std::vector<UINT>& indices,
+        const std::vector<M3DLoader::Subset>& subsets,
+        const std::vector<M3DLoader::M3dMaterial>& mats,
+        const std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
+        const std::vector<int>& boneHierarchy,
+        const std::unordered_map<std::string, AnimationClip>& animations);
+}
+
+///<summary>
+/// Read-only, memory mapped view of an .m3db file.  The spans returned by the
+/// accessors point directly into the mapped file and are valid until Close() is
+/// called or the object is destroyed.
+///</summary>
+class M3dBinaryFile
+{
+public:
+    M3dBinaryFile() = default;
+    M3dBinaryFile(const M3dBinaryFile& rhs) = delete;
+    M3dBinaryFile& operator=(const M3dBinaryFile& rhs) = delete;
+    ~M3dBinaryFile();
+
+    // Maps the file and validates the header and section table.  Returns false if
+    // the file does not exist, is not an .m3db file, or was written by another version.
+    bool Open(const std::string& filename);
+    void Close();
+
+    bool IsOpen()const;
+    bool IsSkinned()const;
+    const M3dBinary::Header& GetHeader()const;
+
+    // Empty if the file is skinned.
+    Span<const M3DLoader::Vertex> Vertices()const;
+
+    // Empty if the file is not skinned.
+    Span<const M3DLoader::SkinnedVertex> SkinnedVertices()const;
+
+    Span<const UINT> Indices()const;
+    Span<const M3DLoader::Subset> Subsets()const;
+    Span<const M3dBinary::Material> Materials()const;
+
+    Span<const DirectX::XMFLOAT4X4> BoneOffsets()const;
+    Span<const int> BoneHierarchy()const;
+    Span<const M3dBinary::Clip> Clips()const;
+    Span<const M3dBinary::Track> Tracks()const;
+    Span<const M3dBinary::Keyframe> Keyframes()const;
+
+    const char* GetString(uint32_t offset)const;
+
+    // Materials and animation clips own std::strings/std::vectors, so these copy
+    // out of the mapped file into the types the rest of the code uses.
+    void GetMaterials(std::vector<M3DLoader::M3dMaterial>& mats)const;
+    void GetSkinnedData(SkinnedData& skinInfo, const AnimationCompressionSettings* compression = nullptr)const;
+
+private:
+    template<typename T>
+    Span<const T> GetSection(M3dBinary::Section section)const
+    {
+        const M3dBinary::SectionDesc& desc = GetHeader().Sections[section];
+        return Span<const T>(
+            reinterpret_cast<const T*>(mData + desc.Offset),
+            static_cast<size_t>(desc.ByteSize / sizeof(T)));
+    }
+
+    bool Validate()const;
+
+private:
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const BYTE* mData = nullptr;
+    uint64_t mFileSize = 0;
+};
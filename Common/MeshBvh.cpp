@@ -0,0 +1,1178 @@
+//***************************************************************************************
+// MeshBvh.cpp
+//***************************************************************************************
+
+#include "MeshBvh.h"
+#include "TaskPool.h"
+
+using namespace DirectX;
+
+namespace
+{
+    using Node = MeshBvh::Node;
+
+    // From this depth on, nodes are split at the median instead of by the SAH, so no
+    // tree gets deeper than it plus 32 levels and the traversal stack cannot overflow.
+    const UINT SahMaxDepth = 48;
+    const UINT MaxTraversalStack = SahMaxDepth + 32;
+
+    // The four-wide hierarchy is no deeper than the binary one, and every node leaves
+    // at most three more children on the stack than it takes off.
+    const UINT MaxWideStack = 3*MaxTraversalStack + 1;
+
+    // Hits this far outside a triangle, in barycentrics, still count, so rounding on
+    // rays that graze a mesh cannot open cracks along the edges triangles share.
+    const float BarycentricEpsilon = 1e-5f;
+
+    // A subtree with at most this many triangles becomes one leaf block.
+    const UINT BlockSize = 4;
+
+    // Rays per chunk of a batch on the pool; a multiple of the packet size.
+    const UINT BatchGrainSize = 256;
+
+    // A primitive while building: its bounds, the center of its bounds and where it
+    // came from.
+    struct BuildRef
+    {
+        float Min[3];
+        float Max[3];
+        float Centroid[3];
+        UINT Index;
+    };
+
+    struct Aabb
+    {
+        float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const float min[3], const float max[3])
+        {
+            for(int a = 0; a < 3; ++a)
+            {
+                Min[a] = std::min(Min[a], min[a]);
+                Max[a] = std::max(Max[a], max[a]);
+            }
+        }
+
+        void Grow(const float p[3])
+        {
+            Grow(p, p);
+        }
+
+        // Half the surface area, which is all the SAH needs.
+        float HalfArea()const
+        {
+            const float dx = Max[0] - Min[0];
+            const float dy = Max[1] - Min[1];
+            const float dz = Max[2] - Min[2];
+            return (dx < 0.0f) ? 0.0f : dx*dy + dy*dz + dz*dx;
+        }
+    };
+
+    // Builds the nodes over refs, which it reorders so that each leaf covers a range.
+    std::vector<Node> BuildNodes(std::vector<BuildRef>& refs, const BvhSettings& settings)
+    {
+        std::vector<Node> nodes;
+        if(refs.empty())
+            return nodes;
+
+        const UINT binCount = MathHelper::Clamp(settings.BinCount, 2u, 64u);
+        const UINT maxLeafSize = std::max(settings.MaxLeafSize, 1u);
+
+        nodes.reserve(2*refs.size() - 1);
+        nodes.push_back(Node());
+        nodes[0].LeftFirst = 0;
+        nodes[0].Count = (UINT)refs.size();
+
+        struct Bin
+        {
+            Aabb Bounds;
+            UINT Count = 0;
+        };
+        std::vector<Bin> bins(binCount);
+        std::vector<float> rightArea(binCount);
+        std::vector<UINT> rightCount(binCount);
+
+        // Nodes still to split with their depth; each holds its range in LeftFirst/Count.
+        std::vector<std::pair<UINT, UINT>> stack = { { 0, 0 } };
+        while(!stack.empty())
+        {
+            const UINT nodeIndex = stack.back().first;
+            const UINT depth = stack.back().second;
+            stack.pop_back();
+
+            const UINT first = nodes[nodeIndex].LeftFirst;
+            const UINT count = nodes[nodeIndex].Count;
+
+            Aabb bounds;
+            Aabb centroidBounds;
+            for(UINT i = first; i < first + count; ++i)
+            {
+                bounds.Grow(refs[i].Min, refs[i].Max);
+                centroidBounds.Grow(refs[i].Centroid);
+            }
+
+            for(int a = 0; a < 3; ++a)
+            {
+                nodes[nodeIndex].Min[a] = bounds.Min[a];
+                nodes[nodeIndex].Max[a] = bounds.Max[a];
+            }
+
+            if(count == 1)
+                continue;
+
+            // Best binned split over the three axes.
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            UINT bestSplit = 0;
+            for(int axis = 0; axis < 3 && depth < SahMaxDepth; ++axis)
+            {
+                const float cmin = centroidBounds.Min[axis];
+                const float extent = centroidBounds.Max[axis] - cmin;
+                if(extent <= 0.0f)
+                    continue;
+
+                const float toBin = binCount / extent;
+                for(Bin& bin : bins)
+                    bin = Bin();
+
+                for(UINT i = first; i < first + count; ++i)
+                {
+                    const UINT b = std::min((UINT)((refs[i].Centroid[axis] - cmin) * toBin), binCount - 1);
+                    bins[b].Bounds.Grow(refs[i].Min, refs[i].Max);
+                    bins[b].Count++;
+                }
+
+                // Sweep from the right for the right side of every plane, then from the
+                // left for the left side and the cost.
+                Aabb right;
+                UINT rightSum = 0;
+                for(UINT b = binCount - 1; b > 0; --b)
+                {
+                    right.Grow(bins[b].Bounds.Min, bins[b].Bounds.Max);
+                    rightSum += bins[b].Count;
+                    rightArea[b] = right.HalfArea();
+                    rightCount[b] = rightSum;
+                }
+
+                Aabb left;
+                UINT leftSum = 0;
+                for(UINT b = 1; b < binCount; ++b)
+                {
+                    left.Grow(bins[b - 1].Bounds.Min, bins[b - 1].Bounds.Max);
+                    leftSum += bins[b - 1].Count;
+                    if(leftSum == 0 || rightCount[b] == 0)
+                        continue;
+
+                    const float cost = left.HalfArea()*leftSum + rightArea[b]*rightCount[b];
+                    if(cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b;
+                    }
+                }
+            }
+
+            // Compare with the cost of a leaf, both relative to the area of the node.
+            const float parentArea = bounds.HalfArea();
+            const float splitCost = settings.TraversalCost +
+                (parentArea > 0.0f ? bestCost / parentArea : (float)count);
+            if(count <= maxLeafSize && (bestAxis < 0 || splitCost >= (float)count))
+                continue;
+
+            UINT mid = first;
+            if(depth >= SahMaxDepth)
+            {
+                int axis = 0;
+                for(int a = 1; a < 3; ++a)
+                {
+                    if(centroidBounds.Max[a] - centroidBounds.Min[a] > centroidBounds.Max[axis] - centroidBounds.Min[axis])
+                        axis = a;
+                }
+
+                mid = first + count / 2;
+                std::nth_element(refs.begin() + first, refs.begin() + mid, refs.begin() + first + count,
+                    [axis](const BuildRef& a, const BuildRef& b) { return a.Centroid[axis] < b.Centroid[axis]; });
+            }
+            else if(bestAxis >= 0)
+            {
+                const float cmin = centroidBounds.Min[bestAxis];
+                const float toBin = binCount / (centroidBounds.Max[bestAxis] - cmin);
+                auto it = std::partition(refs.begin() + first, refs.begin() + first + count, [&](const BuildRef& ref)
+                {
+                    const UINT b = std::min((UINT)((ref.Centroid[bestAxis] - cmin) * toBin), binCount - 1);
+                    return b < bestSplit;
+                });
+                mid = (UINT)(it - refs.begin());
+            }
+
+            // All centroids in one spot: split the range in half.
+            if(mid == first || mid == first + count)
+                mid = first + count / 2;
+
+            const UINT leftIndex = (UINT)nodes.size();
+            nodes.push_back(Node());
+            nodes.push_back(Node());
+
+            nodes[leftIndex].LeftFirst = first;
+            nodes[leftIndex].Count = mid - first;
+            nodes[leftIndex + 1].LeftFirst = mid;
+            nodes[leftIndex + 1].Count = first + count - mid;
+
+            nodes[nodeIndex].LeftFirst = leftIndex;
+            nodes[nodeIndex].Count = 0;
+
+            stack.push_back({ leftIndex + 1, depth + 1 });
+            stack.push_back({ leftIndex, depth + 1 });
+        }
+
+        return nodes;
+    }
+
+    // The ray with the reciprocal of its direction for the slab tests.  Zero direction
+    // components are nudged so the reciprocal stays finite.
+    struct Ray
+    {
+        float Origin[3];
+        float Dir[3];
+        float InvDir[3];
+
+        Ray(FXMVECTOR origin, FXMVECTOR dir)
+        {
+            XMFLOAT3 o;
+            XMFLOAT3 d;
+            XMStoreFloat3(&o, origin);
+            XMStoreFloat3(&d, dir);
+
+            Origin[0] = o.x; Origin[1] = o.y; Origin[2] = o.z;
+            Dir[0] = d.x; Dir[1] = d.y; Dir[2] = d.z;
+            for(int a = 0; a < 3; ++a)
+            {
+                const float da = fabsf(Dir[a]) < 1e-20f ? (Dir[a] < 0.0f ? -1e-20f : 1e-20f) : Dir[a];
+                InvDir[a] = 1.0f / da;
+            }
+        }
+    };
+
+    // Entry distance of the ray into the node's box, or FLT_MAX if it misses the box
+    // or enters it at or beyond maxT.
+    float IntersectNode(const Ray& ray, const Node& node, float maxT)
+    {
+        float tmin = 0.0f;
+        float tmax = maxT;
+        for(int a = 0; a < 3; ++a)
+        {
+            float t0 = (node.Min[a] - ray.Origin[a]) * ray.InvDir[a];
+            float t1 = (node.Max[a] - ray.Origin[a]) * ray.InvDir[a];
+            if(t0 > t1)
+                std::swap(t0, t1);
+
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+        }
+
+        return (tmin <= tmax && tmin < maxT) ? tmin : FLT_MAX;
+    }
+
+    // Walks nodes front to back and calls testLeaf(first, count) for the leaves the ray
+    // reaches, which narrows hit.T as it finds hits.
+    template<typename LeafFn>
+    void Traverse(const std::vector<Node>& nodes, const Ray& ray, const RayHit& hit, const LeafFn& testLeaf)
+    {
+        if(nodes.empty() || IntersectNode(ray, nodes[0], hit.T) == FLT_MAX)
+            return;
+
+        UINT stack[MaxTraversalStack];
+        float stackT[MaxTraversalStack];
+        UINT stackSize = 0;
+
+        UINT nodeIndex = 0;
+        while(true)
+        {
+            const Node& node = nodes[nodeIndex];
+            if(node.Count > 0)
+            {
+                testLeaf(node.LeftFirst, node.Count);
+            }
+            else
+            {
+                UINT nearIndex = node.LeftFirst;
+                UINT farIndex = node.LeftFirst + 1;
+                float nearT = IntersectNode(ray, nodes[nearIndex], hit.T);
+                float farT = IntersectNode(ray, nodes[farIndex], hit.T);
+                if(farT < nearT)
+                {
+                    std::swap(nearIndex, farIndex);
+                    std::swap(nearT, farT);
+                }
+
+                if(nearT != FLT_MAX)
+                {
+                    if(farT != FLT_MAX)
+                    {
+                        assert(stackSize < MaxTraversalStack);
+                        stack[stackSize] = farIndex;
+                        stackT[stackSize] = farT;
+                        stackSize++;
+                    }
+
+                    nodeIndex = nearIndex;
+                    continue;
+                }
+            }
+
+            // Pop the next node that the hits found since it was pushed do not rule out.
+            bool found = false;
+            while(stackSize > 0)
+            {
+                stackSize--;
+                if(stackT[stackSize] < hit.T)
+                {
+                    nodeIndex = stack[stackSize];
+                    found = true;
+                    break;
+                }
+            }
+
+            if(!found)
+                return;
+        }
+    }
+
+    UINT ReadIndex(const void* indices, DXGI_FORMAT format, UINT i)
+    {
+        return format == DXGI_FORMAT_R32_UINT ?
+            static_cast<const uint32_t*>(indices)[i] :
+            static_cast<const uint16_t*>(indices)[i];
+    }
+
+    float SahCostOf(const std::vector<Node>& nodes, UINT primitiveCount, float traversalCost)
+    {
+        if(nodes.empty())
+            return 0.0f;
+
+        auto halfArea = [](const Node& node)
+        {
+            Aabb box;
+            box.Grow(node.Min, node.Max);
+            return box.HalfArea();
+        };
+
+        const float rootArea = halfArea(nodes[0]);
+        if(rootArea <= 0.0f)
+            return (float)primitiveCount;
+
+        float cost = 0.0f;
+        for(const Node& node : nodes)
+        {
+            const float p = halfArea(node) / rootArea;
+            cost += node.Count > 0 ? p*node.Count : p*traversalCost;
+        }
+
+        return cost;
+    }
+
+    // One bit per lane of a comparison result, lane 0 in bit 0.
+    UINT LaneMask(FXMVECTOR v)
+    {
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+        return (UINT)_mm_movemask_ps(v);
+#else
+        uint32_t lanes[4];
+        XMStoreInt4(lanes, v);
+        return (lanes[0] >> 31) | ((lanes[1] >> 31) << 1) | ((lanes[2] >> 31) << 2) | ((lanes[3] >> 31) << 3);
+#endif
+    }
+
+    float& Lane(XMFLOAT4A& v, UINT k)
+    {
+        return (&v.x)[k];
+    }
+
+    float Lane(const XMFLOAT4A& v, UINT k)
+    {
+        return (&v.x)[k];
+    }
+
+    // True if the four directions lie in one octant, by the signs Ray gives them.
+    bool SameOctant(const XMFLOAT3* dirs)
+    {
+        for(UINT k = 1; k < 4; ++k)
+        {
+            if((dirs[k].x < 0.0f) != (dirs[0].x < 0.0f) ||
+               (dirs[k].y < 0.0f) != (dirs[0].y < 0.0f) ||
+               (dirs[k].z < 0.0f) != (dirs[0].z < 0.0f))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Children of a node that a ray (or packet) enters, by distance.
+    struct ChildHit
+    {
+        UINT Child;
+        UINT Count;
+        float T;
+    };
+
+    // Inserts hit into hits[0..count) sorted from far to near, so pushing them in order
+    // leaves the nearest on top of the stack.
+    void InsertFarToNear(ChildHit* hits, UINT& count, const ChildHit& hit)
+    {
+        UINT j = count++;
+        while(j > 0 && hits[j - 1].T < hit.T)
+        {
+            hits[j] = hits[j - 1];
+            --j;
+        }
+        hits[j] = hit;
+    }
+
+    // Calls traceRange(begin, end) over [0, count), split across pool for large batches.
+    template<typename Fn>
+    void RunBatch(UINT count, TaskPool* pool, const Fn& traceRange)
+    {
+        if(count < MeshBvh::ParallelBatchSize)
+        {
+            traceRange(0u, count);
+            return;
+        }
+
+        if(pool == nullptr)
+            pool = &TaskPool::Default();
+
+        pool->ParallelFor(count, BatchGrainSize, traceRange);
+    }
+}
+
+void MeshBvh::Build(const MeshGeometry& geo, const SubmeshGeometry& submesh, const BvhSettings& settings)
+{
+    const UINT indexSize = geo.IndexFormat == DXGI_FORMAT_R32_UINT ? 4 : 2;
+    const byte* vertices = geo.VertexBufferCPU.data() + (INT64)submesh.BaseVertexLocation * geo.VertexByteStride;
+    const byte* indices = geo.IndexBufferCPU.data() + (size_t)submesh.StartIndexLocation * indexSize;
+
+    Build(vertices, geo.VertexByteStride, indices, geo.IndexFormat, submesh.IndexCount, settings);
+}
+
+void MeshBvh::Build(const void* vertices, UINT vertexStride, const void* indices, DXGI_FORMAT indexFormat,
+                    UINT indexCount, const BvhSettings& settings)
+{
+    const UINT triangleCount = indexCount / 3;
+    auto position = [&](UINT index)
+    {
+        return reinterpret_cast<const XMFLOAT3*>(static_cast<const byte*>(vertices) + (size_t)index * vertexStride);
+    };
+
+    std::vector<BuildRef> refs(triangleCount);
+    for(UINT t = 0; t < triangleCount; ++t)
+    {
+        BuildRef& ref = refs[t];
+        Aabb box;
+        for(UINT c = 0; c < 3; ++c)
+            box.Grow(&position(ReadIndex(indices, indexFormat, 3*t + c))->x);
+
+        for(int a = 0; a < 3; ++a)
+        {
+            ref.Min[a] = box.Min[a];
+            ref.Max[a] = box.Max[a];
+            ref.Centroid[a] = 0.5f*(box.Min[a] + box.Max[a]);
+        }
+        ref.Index = t;
+    }
+
+    const std::vector<Node> nodes = BuildNodes(refs, settings);
+
+    std::vector<UINT> ids(triangleCount);
+    std::vector<XMFLOAT3> corners(3*(size_t)triangleCount);
+    for(UINT i = 0; i < triangleCount; ++i)
+    {
+        ids[i] = refs[i].Index;
+        for(UINT c = 0; c < 3; ++c)
+            corners[3*i + c] = *position(ReadIndex(indices, indexFormat, 3*ids[i] + c));
+    }
+
+    Collapse(nodes, ids, corners);
+
+    mBounds = BoundingBox();
+    if(!nodes.empty())
+    {
+        BoundingBox::CreateFromPoints(mBounds,
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(nodes[0].Min)),
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(nodes[0].Max)));
+    }
+
+    mTriangleCount = triangleCount;
+    mSahCost = SahCostOf(nodes, triangleCount, settings.TraversalCost);
+}
+
+void MeshBvh::Collapse(const std::vector<Node>& nodes, const std::vector<UINT>& ids, const std::vector<XMFLOAT3>& corners)
+{
+    mNodes.clear();
+    mBlocks.clear();
+    if(nodes.empty())
+        return;
+
+    // Triangle range of every binary node.  Children come after their parents, so a
+    // pass from the back sees them first, and the right child's range follows the left's.
+    std::vector<UINT> first(nodes.size());
+    std::vector<UINT> count(nodes.size());
+    for(size_t i = nodes.size(); i-- > 0; )
+    {
+        const UINT left = nodes[i].LeftFirst;
+        first[i] = nodes[i].Count > 0 ? left : first[left];
+        count[i] = nodes[i].Count > 0 ? nodes[i].Count : count[left] + count[left + 1];
+    }
+
+    auto isLeaf = [&](UINT n) { return nodes[n].Count > 0 || count[n] <= BlockSize; };
+    auto halfArea = [&](UINT n)
+    {
+        Aabb box;
+        box.Grow(nodes[n].Min, nodes[n].Max);
+        return box.HalfArea();
+    };
+
+    // Binary nodes still to collapse with the four-wide node they become.
+    std::vector<std::pair<UINT, UINT>> stack = { { 0, 0 } };
+    mNodes.push_back(WideNode());
+    while(!stack.empty())
+    {
+        const UINT binaryIndex = stack.back().first;
+        const UINT wideIndex = stack.back().second;
+        stack.pop_back();
+
+        // Start from the two children, or the root itself if it is a leaf, and open the
+        // largest inner one until there are four.
+        UINT children[4];
+        UINT childCount = 0;
+        if(isLeaf(binaryIndex))
+        {
+            children[childCount++] = binaryIndex;
+        }
+        else
+        {
+            children[childCount++] = nodes[binaryIndex].LeftFirst;
+            children[childCount++] = nodes[binaryIndex].LeftFirst + 1;
+        }
+
+        while(childCount < 4)
+        {
+            int best = -1;
+            float bestArea = -1.0f;
+            for(UINT c = 0; c < childCount; ++c)
+            {
+                if(!isLeaf(children[c]) && halfArea(children[c]) > bestArea)
+                {
+                    best = (int)c;
+                    bestArea = halfArea(children[c]);
+                }
+            }
+
+            if(best < 0)
+                break;
+
+            const UINT opened = children[best];
+            children[best] = nodes[opened].LeftFirst;
+            children[childCount++] = nodes[opened].LeftFirst + 1;
+        }
+
+        WideNode wide;
+        for(UINT k = 0; k < 4; ++k)
+        {
+            if(k >= childCount)
+            {
+                for(int a = 0; a < 3; ++a)
+                {
+                    Lane(wide.Min[a], k) = FLT_MAX;
+                    Lane(wide.Max[a], k) = -FLT_MAX;
+                }
+                wide.Child[k] = UINT_MAX;
+                wide.Count[k] = 0;
+                continue;
+            }
+
+            const UINT c = children[k];
+            for(int a = 0; a < 3; ++a)
+            {
+                Lane(wide.Min[a], k) = nodes[c].Min[a];
+                Lane(wide.Max[a], k) = nodes[c].Max[a];
+            }
+
+            if(!isLeaf(c))
+            {
+                wide.Child[k] = (UINT)mNodes.size();
+                wide.Count[k] = 0;
+                mNodes.push_back(WideNode());
+                stack.push_back({ c, wide.Child[k] });
+                continue;
+            }
+
+            wide.Child[k] = (UINT)mBlocks.size();
+            wide.Count[k] = (count[c] + BlockSize - 1) / BlockSize;
+            for(UINT t = 0; t < count[c]; t += BlockSize)
+            {
+                TriangleBlock block;
+                for(UINT j = 0; j < BlockSize; ++j)
+                {
+                    const bool used = t + j < count[c];
+                    const UINT tri = first[c] + t + j;
+                    const XMFLOAT3 zero(0.0f, 0.0f, 0.0f);
+                    const XMFLOAT3& p0 = used ? corners[3*tri + 0] : zero;
+                    const XMFLOAT3& p1 = used ? corners[3*tri + 1] : zero;
+                    const XMFLOAT3& p2 = used ? corners[3*tri + 2] : zero;
+                    for(int a = 0; a < 3; ++a)
+                    {
+                        Lane(block.V0[a], j) = (&p0.x)[a];
+                        Lane(block.E1[a], j) = (&p1.x)[a] - (&p0.x)[a];
+                        Lane(block.E2[a], j) = (&p2.x)[a] - (&p0.x)[a];
+                    }
+                    block.Id[j] = used ? ids[tri] : UINT_MAX;
+                }
+                mBlocks.push_back(block);
+            }
+        }
+
+        mNodes[wideIndex] = wide;
+    }
+}
+
+template<bool AnyHit>
+bool MeshBvh::TraceRay(FXMVECTOR origin, FXMVECTOR dir, RayHit& hit)const
+{
+    if(mNodes.empty())
+        return false;
+
+    const Ray ray(origin, dir);
+    const XMVECTOR ox = XMVectorReplicate(ray.Origin[0]);
+    const XMVECTOR oy = XMVectorReplicate(ray.Origin[1]);
+    const XMVECTOR oz = XMVectorReplicate(ray.Origin[2]);
+    const XMVECTOR dx = XMVectorReplicate(ray.Dir[0]);
+    const XMVECTOR dy = XMVectorReplicate(ray.Dir[1]);
+    const XMVECTOR dz = XMVectorReplicate(ray.Dir[2]);
+    const XMVECTOR ix = XMVectorReplicate(ray.InvDir[0]);
+    const XMVECTOR iy = XMVectorReplicate(ray.InvDir[1]);
+    const XMVECTOR iz = XMVectorReplicate(ray.InvDir[2]);
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR lowEdge = XMVectorReplicate(-BarycentricEpsilon);
+    const XMVECTOR highEdge = XMVectorReplicate(1.0f + BarycentricEpsilon);
+
+    // The ray enters a box through the min or the max plane of each axis depending on
+    // the sign of its direction.  Inverted boxes then have their far plane before the
+    // near one, so unused children are never entered.
+    const bool negX = ray.InvDir[0] < 0.0f;
+    const bool negY = ray.InvDir[1] < 0.0f;
+    const bool negZ = ray.InvDir[2] < 0.0f;
+
+    ChildHit stack[MaxWideStack];
+    UINT stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0.0f };
+
+    bool found = false;
+    while(stackSize > 0)
+    {
+        const ChildHit entry = stack[--stackSize];
+        if(entry.T >= hit.T)
+            continue;
+
+        if(entry.Count == 0)
+        {
+            const WideNode& node = mNodes[entry.Child];
+            const XMVECTOR nearX = XMLoadFloat4A(negX ? &node.Max[0] : &node.Min[0]);
+            const XMVECTOR nearY = XMLoadFloat4A(negY ? &node.Max[1] : &node.Min[1]);
+            const XMVECTOR nearZ = XMLoadFloat4A(negZ ? &node.Max[2] : &node.Min[2]);
+            const XMVECTOR farX = XMLoadFloat4A(negX ? &node.Min[0] : &node.Max[0]);
+            const XMVECTOR farY = XMLoadFloat4A(negY ? &node.Min[1] : &node.Max[1]);
+            const XMVECTOR farZ = XMLoadFloat4A(negZ ? &node.Min[2] : &node.Max[2]);
+
+            const XMVECTOR tmin = XMVectorMax(XMVectorMax((nearX - ox) * ix, (nearY - oy) * iy),
+                                              XMVectorMax((nearZ - oz) * iz, zero));
+            const XMVECTOR tmax = XMVectorMin(XMVectorMin((farX - ox) * ix, (farY - oy) * iy),
+                                              XMVectorMin((farZ - oz) * iz, XMVectorReplicate(hit.T)));
+
+            const UINT mask = LaneMask(XMVectorLessOrEqual(tmin, tmax));
+            if(mask == 0)
+                continue;
+
+            XMFLOAT4A entryT;
+            XMStoreFloat4A(&entryT, tmin);
+
+            ChildHit hits[4];
+            UINT hitCount = 0;
+            for(UINT k = 0; k < 4; ++k)
+            {
+                if(mask & (1u << k))
+                    InsertFarToNear(hits, hitCount, { node.Child[k], node.Count[k], Lane(entryT, k) });
+            }
+
+            for(UINT j = 0; j < hitCount; ++j)
+                stack[stackSize++] = hits[j];
+            assert(stackSize <= MaxWideStack);
+            continue;
+        }
+
+        for(UINT b = entry.Child; b < entry.Child + entry.Count; ++b)
+        {
+            // Moller-Trumbore against four triangles.
+            const TriangleBlock& block = mBlocks[b];
+            const XMVECTOR e1x = XMLoadFloat4A(&block.E1[0]);
+            const XMVECTOR e1y = XMLoadFloat4A(&block.E1[1]);
+            const XMVECTOR e1z = XMLoadFloat4A(&block.E1[2]);
+            const XMVECTOR e2x = XMLoadFloat4A(&block.E2[0]);
+            const XMVECTOR e2y = XMLoadFloat4A(&block.E2[1]);
+            const XMVECTOR e2z = XMLoadFloat4A(&block.E2[2]);
+
+            const XMVECTOR px = dy * e2z - dz * e2y;
+            const XMVECTOR py = dz * e2x - dx * e2z;
+            const XMVECTOR pz = dx * e2y - dy * e2x;
+            const XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+            const XMVECTOR invDet = XMVectorReciprocal(det);
+
+            const XMVECTOR sx = ox - XMLoadFloat4A(&block.V0[0]);
+            const XMVECTOR sy = oy - XMLoadFloat4A(&block.V0[1]);
+            const XMVECTOR sz = oz - XMLoadFloat4A(&block.V0[2]);
+            const XMVECTOR u = (sx * px + sy * py + sz * pz) * invDet;
+
+            const XMVECTOR qx = sy * e1z - sz * e1y;
+            const XMVECTOR qy = sz * e1x - sx * e1z;
+            const XMVECTOR qz = sx * e1y - sy * e1x;
+            const XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+            const XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+            XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(u, lowEdge), XMVectorGreaterOrEqual(v, lowEdge));
+            inside = XMVectorAndInt(inside, XMVectorLessOrEqual(u + v, highEdge));
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(t, zero));
+            inside = XMVectorAndInt(inside, XMVectorLess(t, XMVectorReplicate(hit.T)));
+            inside = XMVectorAndCInt(inside, XMVectorEqual(det, zero));
+
+            const UINT mask = LaneMask(inside);
+            if(mask == 0)
+                continue;
+
+            XMFLOAT4A tl, ul, vl;
+            XMStoreFloat4A(&tl, t);
+            XMStoreFloat4A(&ul, u);
+            XMStoreFloat4A(&vl, v);
+            for(UINT k = 0; k < 4; ++k)
+            {
+                if((mask & (1u << k)) && Lane(tl, k) < hit.T)
+                {
+                    hit.T = Lane(tl, k);
+                    hit.U = Lane(ul, k);
+                    hit.V = Lane(vl, k);
+                    hit.Triangle = block.Id[k];
+                    found = true;
+
+                    if(AnyHit)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+template<bool AnyHit>
+void MeshBvh::TracePacket(const XMFLOAT3* origins, const XMFLOAT3* dirs, RayHit* hits)const
+{
+    if(mNodes.empty())
+        return;
+
+    // Lane k of every vector belongs to ray k.
+    XMFLOAT4A o[3], d[3], inv[3];
+    XMFLOAT4A hitT, hitU, hitV;
+    uint32_t hitId[4];
+    for(UINT k = 0; k < 4; ++k)
+    {
+        const Ray ray(XMLoadFloat3(&origins[k]), XMLoadFloat3(&dirs[k]));
+        for(int a = 0; a < 3; ++a)
+        {
+            Lane(o[a], k) = ray.Origin[a];
+            Lane(d[a], k) = ray.Dir[a];
+            Lane(inv[a], k) = ray.InvDir[a];
+        }
+
+        Lane(hitT, k) = hits[k].T;
+        Lane(hitU, k) = hits[k].U;
+        Lane(hitV, k) = hits[k].V;
+        hitId[k] = hits[k].Triangle;
+    }
+
+    const XMVECTOR ox = XMLoadFloat4A(&o[0]);
+    const XMVECTOR oy = XMLoadFloat4A(&o[1]);
+    const XMVECTOR oz = XMLoadFloat4A(&o[2]);
+    const XMVECTOR dx = XMLoadFloat4A(&d[0]);
+    const XMVECTOR dy = XMLoadFloat4A(&d[1]);
+    const XMVECTOR dz = XMLoadFloat4A(&d[2]);
+    const XMVECTOR ix = XMLoadFloat4A(&inv[0]);
+    const XMVECTOR iy = XMLoadFloat4A(&inv[1]);
+    const XMVECTOR iz = XMLoadFloat4A(&inv[2]);
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR lowEdge = XMVectorReplicate(-BarycentricEpsilon);
+    const XMVECTOR highEdge = XMVectorReplicate(1.0f + BarycentricEpsilon);
+    const XMVECTOR farAway = XMVectorReplicate(FLT_MAX);
+
+    // One octant, so the near and far planes of every axis are the same for all four.
+    const bool negX = Lane(inv[0], 0) < 0.0f;
+    const bool negY = Lane(inv[1], 0) < 0.0f;
+    const bool negZ = Lane(inv[2], 0) < 0.0f;
+
+    XMVECTOR nearestT = XMLoadFloat4A(&hitT);
+    XMVECTOR nearestU = XMLoadFloat4A(&hitU);
+    XMVECTOR nearestV = XMLoadFloat4A(&hitV);
+    XMVECTOR nearestId = XMLoadInt4(hitId);
+
+    // Distance beyond which nothing matters to a ray: its nearest hit so far, or for an
+    // any-hit query -FLT_MAX once it has one, which no box or triangle is nearer than.
+    XMVECTOR limit = nearestT;
+    UINT doneMask = 0;
+
+    struct PacketEntry
+    {
+        XMFLOAT4A T;
+        UINT Child;
+        UINT Count;
+    };
+
+    PacketEntry stack[MaxWideStack];
+    UINT stackSize = 0;
+    XMStoreFloat4A(&stack[0].T, zero);
+    stack[0].Child = 0;
+    stack[0].Count = 0;
+    stackSize++;
+
+    while(stackSize > 0 && doneMask != 0xf)
+    {
+        const PacketEntry entry = stack[--stackSize];
+        if(LaneMask(XMVectorLess(XMLoadFloat4A(&entry.T), limit)) == 0)
+            continue;
+
+        if(entry.Count == 0)
+        {
+            const WideNode& node = mNodes[entry.Child];
+            const XMFLOAT4A& nearX = negX ? node.Max[0] : node.Min[0];
+            const XMFLOAT4A& nearY = negY ? node.Max[1] : node.Min[1];
+            const XMFLOAT4A& nearZ = negZ ? node.Max[2] : node.Min[2];
+            const XMFLOAT4A& farX = negX ? node.Min[0] : node.Max[0];
+            const XMFLOAT4A& farY = negY ? node.Min[1] : node.Max[1];
+            const XMFLOAT4A& farZ = negZ ? node.Min[2] : node.Max[2];
+
+            // Each child against the four rays.  The children are ordered by the
+            // nearest distance any ray enters them at; ChildHit::Child holds the slot.
+            XMFLOAT4A childT[4];
+            ChildHit order[4];
+            UINT hitCount = 0;
+            for(UINT k = 0; k < 4; ++k)
+            {
+                if(node.Count[k] == 0 && node.Child[k] == UINT_MAX)
+                    continue;
+
+                const XMVECTOR tmin = XMVectorMax(
+                    XMVectorMax((XMVectorReplicate(Lane(nearX, k)) - ox) * ix, (XMVectorReplicate(Lane(nearY, k)) - oy) * iy),
+                    XMVectorMax((XMVectorReplicate(Lane(nearZ, k)) - oz) * iz, zero));
+                const XMVECTOR tmax = XMVectorMin(
+                    XMVectorMin((XMVectorReplicate(Lane(farX, k)) - ox) * ix, (XMVectorReplicate(Lane(farY, k)) - oy) * iy),
+                    XMVectorMin((XMVectorReplicate(Lane(farZ, k)) - oz) * iz, limit));
+
+                const XMVECTOR enters = XMVectorLessOrEqual(tmin, tmax);
+                if(LaneMask(enters) == 0)
+                    continue;
+
+                // Rays that miss the child get a distance that rules it out for them.
+                XMStoreFloat4A(&childT[k], XMVectorSelect(farAway, tmin, enters));
+                const float nearest = std::min(std::min(Lane(childT[k], 0), Lane(childT[k], 1)),
+                                               std::min(Lane(childT[k], 2), Lane(childT[k], 3)));
+                InsertFarToNear(order, hitCount, { k, 0, nearest });
+            }
+
+            for(UINT j = 0; j < hitCount; ++j)
+            {
+                const UINT k = order[j].Child;
+                PacketEntry& pushed = stack[stackSize++];
+                pushed.T = childT[k];
+                pushed.Child = node.Child[k];
+                pushed.Count = node.Count[k];
+            }
+            assert(stackSize <= MaxWideStack);
+            continue;
+        }
+
+        for(UINT b = entry.Child; b < entry.Child + entry.Count && doneMask != 0xf; ++b)
+        {
+            const TriangleBlock& block = mBlocks[b];
+            for(UINT j = 0; j < 4 && doneMask != 0xf; ++j)
+            {
+                if(block.Id[j] == UINT_MAX)
+                    continue;
+
+                // Moller-Trumbore of one triangle against four rays.
+                const XMVECTOR e1x = XMVectorReplicate(Lane(block.E1[0], j));
+                const XMVECTOR e1y = XMVectorReplicate(Lane(block.E1[1], j));
+                const XMVECTOR e1z = XMVectorReplicate(Lane(block.E1[2], j));
+                const XMVECTOR e2x = XMVectorReplicate(Lane(block.E2[0], j));
+                const XMVECTOR e2y = XMVectorReplicate(Lane(block.E2[1], j));
+                const XMVECTOR e2z = XMVectorReplicate(Lane(block.E2[2], j));
+
+                const XMVECTOR px = dy * e2z - dz * e2y;
+                const XMVECTOR py = dz * e2x - dx * e2z;
+                const XMVECTOR pz = dx * e2y - dy * e2x;
+                const XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+                const XMVECTOR invDet = XMVectorReciprocal(det);
+
+                const XMVECTOR sx = ox - XMVectorReplicate(Lane(block.V0[0], j));
+                const XMVECTOR sy = oy - XMVectorReplicate(Lane(block.V0[1], j));
+                const XMVECTOR sz = oz - XMVectorReplicate(Lane(block.V0[2], j));
+                const XMVECTOR u = (sx * px + sy * py + sz * pz) * invDet;
+
+                const XMVECTOR qx = sy * e1z - sz * e1y;
+                const XMVECTOR qy = sz * e1x - sx * e1z;
+                const XMVECTOR qz = sx * e1y - sy * e1x;
+                const XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+                const XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+                XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(u, lowEdge), XMVectorGreaterOrEqual(v, lowEdge));
+                inside = XMVectorAndInt(inside, XMVectorLessOrEqual(u + v, highEdge));
+                inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(t, zero));
+                inside = XMVectorAndInt(inside, XMVectorLess(t, limit));
+                inside = XMVectorAndCInt(inside, XMVectorEqual(det, zero));
+
+                const UINT mask = LaneMask(inside);
+                if(mask == 0)
+                    continue;
+
+                nearestT = XMVectorSelect(nearestT, t, inside);
+                nearestU = XMVectorSelect(nearestU, u, inside);
+                nearestV = XMVectorSelect(nearestV, v, inside);
+                nearestId = XMVectorSelect(nearestId, XMVectorReplicateInt(block.Id[j]), inside);
+
+                if(AnyHit)
+                {
+                    limit = XMVectorSelect(limit, XMVectorReplicate(-FLT_MAX), inside);
+                    doneMask |= mask;
+                }
+                else
+                {
+                    limit = nearestT;
+                }
+            }
+        }
+    }
+
+    XMStoreFloat4A(&hitT, nearestT);
+    XMStoreFloat4A(&hitU, nearestU);
+    XMStoreFloat4A(&hitV, nearestV);
+    XMStoreInt4(hitId, nearestId);
+    for(UINT k = 0; k < 4; ++k)
+    {
+        hits[k].T = Lane(hitT, k);
+        hits[k].U = Lane(hitU, k);
+        hits[k].V = Lane(hitV, k);
+        hits[k].Triangle = hitId[k];
+    }
+}
+
+template<bool AnyHit>
+void MeshBvh::TraceRange(const XMFLOAT3* origins, const XMFLOAT3* dirs, UINT count, RayHit* hits)const
+{
+    UINT i = 0;
+    while(i < count)
+    {
+        if(count - i >= 4 && SameOctant(dirs + i))
+        {
+            TracePacket<AnyHit>(origins + i, dirs + i, hits + i);
+            i += 4;
+        }
+        else
+        {
+            TraceRay<AnyHit>(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), hits[i]);
+            i++;
+        }
+    }
+}
+
+bool MeshBvh::Intersect(FXMVECTOR origin, FXMVECTOR dir, RayHit& hit)const
+{
+    return TraceRay<false>(origin, dir, hit);
+}
+
+bool MeshBvh::Occluded(FXMVECTOR origin, FXMVECTOR dir, float maxT)const
+{
+    RayHit hit;
+    hit.T = maxT;
+    return TraceRay<true>(origin, dir, hit);
+}
+
+void MeshBvh::IntersectBatch(const XMFLOAT3* origins, const XMFLOAT3* dirs, UINT count, RayHit* hits, TaskPool* pool)const
+{
+    RunBatch(count, pool, [&](UINT begin, UINT end)
+    {
+        TraceRange<false>(origins + begin, dirs + begin, end - begin, hits + begin);
+    });
+}
+
+void MeshBvh::OccludedBatch(const XMFLOAT3* origins, const XMFLOAT3* dirs, const float* maxT, UINT count,
+                            bool* occluded, TaskPool* pool)const
+{
+    RunBatch(count, pool, [&](UINT begin, UINT end)
+    {
+        // Through a few hits at a time, limited to maxT.
+        RayHit hits[64];
+        for(UINT i = begin; i < end; i += 64)
+        {
+            const UINT n = std::min(64u, end - i);
+            for(UINT k = 0; k < n; ++k)
+            {
+                hits[k] = RayHit();
+                hits[k].T = maxT[i + k];
+            }
+
+            TraceRange<true>(origins + i, dirs + i, n, hits);
+
+            for(UINT k = 0; k < n; ++k)
+                occluded[i + k] = hits[k].IsHit();
+        }
+    });
+}
+
+BoundingBox MeshBvh::GetBounds()const
+{
+    return mBounds;
+}
+
+UINT MeshBvh::TriangleCount()const
+{
+    return mTriangleCount;
+}
+
+UINT MeshBvh::NodeCount()const
+{
+    return (UINT)mNodes.size();
+}
+
+float MeshBvh::SahCost()const
+{
+    return mSahCost;
+}
+
+void SceneBvh::Build(const std::vector<BvhInstance>& instances, const BvhSettings& settings)
+{
+    std::vector<BuildRef> refs;
+    std::vector<Instance> unordered;
+    for(UINT i = 0; i < (UINT)instances.size(); ++i)
+    {
+        const BvhInstance& instance = instances[i];
+        if(instance.Mesh == nullptr || instance.Mesh->TriangleCount() == 0)
+            continue;
+
+        XMMATRIX world = XMLoadFloat4x4(&instance.World);
+        BoundingBox worldBounds;
+        instance.Mesh->GetBounds().Transform(worldBounds, world);
+
+        BuildRef ref;
+        for(int a = 0; a < 3; ++a)
+        {
+            const float c = (&worldBounds.Center.x)[a];
+            const float e = (&worldBounds.Extents.x)[a];
+            ref.Min[a] = c - e;
+            ref.Max[a] = c + e;
+            ref.Centroid[a] = c;
+        }
+        ref.Index = (UINT)unordered.size();
+        refs.push_back(ref);
+
+        Instance inst;
+        inst.Mesh = instance.Mesh;
+        XMStoreFloat4x4(&inst.InvWorld, XMMatrixInverse(nullptr, world));
+        inst.Id = i;
+        unordered.push_back(inst);
+    }
+
+    mNodes = BuildNodes(refs, settings);
+
+    mInstances.resize(refs.size());
+    for(size_t i = 0; i < refs.size(); ++i)
+        mInstances[i] = unordered[refs[i].Index];
+}
+
+bool SceneBvh::Intersect(FXMVECTOR origin, FXMVECTOR dir, RayHit& hit)const
+{
+    const Ray ray(origin, dir);
+
+    bool found = false;
+    Traverse(mNodes, ray, hit, [&](UINT first, UINT count)
+    {
+        for(UINT i = first; i < first + count; ++i)
+        {
+            const Instance& instance = mInstances[i];
+
+            // An affine transform keeps the ray parameter, so hit.T carries over.
+            XMMATRIX invWorld = XMLoadFloat4x4(&instance.InvWorld);
+            XMVECTOR originL = XMVector3TransformCoord(origin, invWorld);
+            XMVECTOR dirL = XMVector3TransformNormal(dir, invWorld);
+
+            if(instance.Mesh->Intersect(originL, dirL, hit))
+            {
+                hit.Instance = instance.Id;
+                found = true;
+            }
+        }
+    });
+
+    return found;
+}
+
+bool SceneBvh::Occluded(FXMVECTOR origin, FXMVECTOR dir, float maxT)const
+{
+    const Ray ray(origin, dir);
+
+    RayHit limit;
+    limit.T = maxT;
+
+    bool occluded = false;
+    Traverse(mNodes, ray, limit, [&](UINT first, UINT count)
+    {
+        for(UINT i = first; i < first + count && !occluded; ++i)
+        {
+            const Instance& instance = mInstances[i];
+            XMMATRIX invWorld = XMLoadFloat4x4(&instance.InvWorld);
+            occluded = instance.Mesh->Occluded(XMVector3TransformCoord(origin, invWorld),
+                                               XMVector3TransformNormal(dir, invWorld), maxT);
+        }
+
+        // No box is nearer than a negative distance, which ends the traversal.
+        if(occluded)
+            limit.T = -FLT_MAX;
+    });
+
+    return occluded;
+}
+
+void SceneBvh::IntersectBatch(const XMFLOAT3* origins, const XMFLOAT3* dirs, UINT count, RayHit* hits, TaskPool* pool)const
+{
+    RunBatch(count, pool, [&](UINT begin, UINT end)
+    {
+        for(UINT i = begin; i < end; ++i)
+            Intersect(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), hits[i]);
+    });
+}
+
+void SceneBvh::OccludedBatch(const XMFLOAT3* origins, const XMFLOAT3* dirs, const float* maxT, UINT count,
+                             bool* occluded, TaskPool* pool)const
+{
+    RunBatch(count, pool, [&](UINT begin, UINT end)
+    {
+        for(UINT i = begin; i < end; ++i)
+            occluded[i] = Occluded(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), maxT[i]);
+    });
+}
+
+UINT SceneBvh::InstanceCount()const
+{
+    return (UINT)mInstances.size();
+}
+
+UINT SceneBvh::NodeCount()const
+{
+    return (UINT)mNodes.size();
+}
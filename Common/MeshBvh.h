@@ -0,0 +1,211 @@
+//***************************************************************************************
+// MeshBvh.h
+//
+// Bounding volume hierarchies for CPU ray queries such as picking.  MeshBvh is built
+// over the triangles of a submesh of a MeshGeometry's CPU buffers, with 16 or 32-bit
+// indices.  SceneBvh is built over instances of them, each with a world transform,
+// and transforms the ray into an instance's local space when it reaches it.
+//
+// Both are binned surface area heuristic (SAH) builds: a node is split along the plane
+// that minimizes the expected cost of tracing a random ray through it, estimated by the
+// surface areas of the children, or becomes a leaf when no split is cheaper.
+//
+// Queries return the nearest hit with the barycentrics of the triangle.  Triangles are
+// hit from both sides.  The hierarchies copy what they need, so the geometry may be
+// freed after building, but they have to be rebuilt when it changes.
+//
+// MeshBvh collapses its binary hierarchy into one with four children per node and
+// stores the triangles of each leaf in blocks of four, so one ray is tested against
+// four boxes or four triangles at a time in SIMD.  The batched queries also trace
+// four rays at a time as a packet when they head the same way, and split large
+// batches across a TaskPool.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TaskPool;
+
+struct BvhSettings
+{
+    // Nodes with more primitives than this are always split.
+    UINT MaxLeafSize = 8;
+
+    // Candidate split planes per axis.
+    UINT BinCount = 16;
+
+    // Cost of visiting a node relative to intersecting one primitive.
+    float TraversalCost = 1.0f;
+};
+
+struct RayHit
+{
+    // Distance along the ray in units of the ray direction.  Only hits nearer than T
+    // are reported, so it can be set to limit a query.
+    float T = FLT_MAX;
+
+    // The hit point is (1 - U - V)*v0 + U*v1 + V*v2 of the triangle's vertices.
+    float U = 0.0f;
+    float V = 0.0f;
+
+    // Index of the triangle within its submesh: its indices start at
+    // StartIndexLocation + 3*Triangle.
+    UINT Triangle = UINT_MAX;
+
+    // Index of the instance in the list SceneBvh was built from; not set by MeshBvh.
+    UINT Instance = UINT_MAX;
+
+    bool IsHit()const { return Triangle != UINT_MAX; }
+};
+
+class MeshBvh
+{
+public:
+    // Batches at least this large are split across the pool.
+    static constexpr UINT ParallelBatchSize = 1024;
+
+    // Builds over the triangles of submesh.  Positions must be the first vertex element.
+    void Build(const MeshGeometry& geo, const SubmeshGeometry& submesh,
+               const BvhSettings& settings = BvhSettings());
+
+    // Builds over indexCount indices of DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT,
+    // which index vertices of vertexStride bytes that start with a float3 position.
+    void Build(const void* vertices, UINT vertexStride, const void* indices, DXGI_FORMAT indexFormat,
+               UINT indexCount, const BvhSettings& settings = BvhSettings());
+
+    // Finds the nearest triangle the ray hits nearer than hit.T and updates hit.  dir
+    // need not be unit length.  Returns false if there was no such hit.
+    bool Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, RayHit& hit)const;
+
+    // True if the ray hits any triangle before maxT, in units of dir; with dir = target -
+    // eye and maxT = 1 this is a line of sight test.  Stops at the first hit it finds.
+    bool Occluded(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT)const;
+
+    // hits[i] as by Intersect(origins[i], dirs[i], hits[i]).  Consecutive rays whose
+    // directions lie in the same octant are traced four at a time as a packet, which
+    // pays off when they also take similar paths, so keep coherent rays (from one eye,
+    // or to one target) next to each other.  Batches of ParallelBatchSize rays or more
+    // run on pool (TaskPool::Default() if null).
+    void IntersectBatch(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, UINT count,
+                        RayHit* hits, TaskPool* pool = nullptr)const;
+
+    // occluded[i] = Occluded(origins[i], dirs[i], maxT[i]), batched like IntersectBatch.
+    void OccludedBatch(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, const float* maxT,
+                       UINT count, bool* occluded, TaskPool* pool = nullptr)const;
+
+    DirectX::BoundingBox GetBounds()const;
+    UINT TriangleCount()const;
+
+    // Nodes of the four-wide hierarchy.
+    UINT NodeCount()const;
+
+    // Expected cost of a ray that hits the root box, in triangle tests, by the SAH of
+    // the binary hierarchy the four-wide one was collapsed from.
+    float SahCost()const;
+
+    // Node layout shared with SceneBvh.  Children are adjacent: an inner node's
+    // children are nodes LeftFirst and LeftFirst + 1.  A leaf (Count > 0) holds
+    // primitives LeftFirst to LeftFirst + Count - 1.
+    struct Node
+    {
+        float Min[3];
+        UINT LeftFirst;
+        float Max[3];
+        UINT Count;
+    };
+
+private:
+    // The boxes of four children side by side, x, y and z of their min and max corners.
+    // A child with Count > 0 is a leaf of Count triangle blocks from block Child on;
+    // otherwise it is node Child.  Unused children have inverted boxes that no ray
+    // enters.
+    struct WideNode
+    {
+        DirectX::XMFLOAT4A Min[3];
+        DirectX::XMFLOAT4A Max[3];
+        UINT Child[4];
+        UINT Count[4];
+    };
+
+    // Four triangles side by side as the first vertex and the two edges from it, for
+    // Moller-Trumbore, with the index of each within its submesh.  Unused lanes have
+    // zero edges, which no ray hits, and an Id of UINT_MAX.
+    struct TriangleBlock
+    {
+        DirectX::XMFLOAT4A V0[3];
+        DirectX::XMFLOAT4A E1[3];
+        DirectX::XMFLOAT4A E2[3];
+        UINT Id[4];
+    };
+
+    // One ray through the nodes, four boxes or triangles at a time.
+    template<bool AnyHit>
+    bool TraceRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, RayHit& hit)const;
+
+    // Four rays through the nodes at once.  Their directions must lie in one octant.
+    template<bool AnyHit>
+    void TracePacket(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, RayHit* hits)const;
+
+    // Consecutive rays of one octant as packets, the rest one at a time.
+    template<bool AnyHit>
+    void TraceRange(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, UINT count, RayHit* hits)const;
+
+    // Fills mNodes and mBlocks from the binary nodes over triangles in leaf order: ids
+    // in the submesh and three corners each.
+    void Collapse(const std::vector<Node>& nodes, const std::vector<UINT>& ids,
+                  const std::vector<DirectX::XMFLOAT3>& corners);
+
+    std::vector<WideNode> mNodes;
+    std::vector<TriangleBlock> mBlocks;
+
+    DirectX::BoundingBox mBounds;
+    UINT mTriangleCount = 0;
+    float mSahCost = 0.0f;
+};
+
+// An instance of a MeshBvh for SceneBvh.  The MeshBvh must outlive the SceneBvh.
+struct BvhInstance
+{
+    const MeshBvh* Mesh = nullptr;
+    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+};
+
+class SceneBvh
+{
+public:
+    // Instances without a mesh or with an empty one are left out.  RayHit::Instance
+    // refers to the index in instances.
+    void Build(const std::vector<BvhInstance>& instances, const BvhSettings& settings = BvhSettings());
+
+    // Like MeshBvh::Intersect with a world space ray.  hit.T is in units of dir in world
+    // space, so the nearest hit over all instances is the nearest in the world.
+    bool Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, RayHit& hit)const;
+
+    // Like MeshBvh::Occluded with a world space ray.
+    bool Occluded(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxT)const;
+
+    // Intersect and Occluded for every ray, split across pool (TaskPool::Default() if
+    // null) from MeshBvh::ParallelBatchSize rays on.  The rays are traced one at a time,
+    // since instances can turn rays of one octant into different ones.
+    void IntersectBatch(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, UINT count,
+                        RayHit* hits, TaskPool* pool = nullptr)const;
+    void OccludedBatch(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* dirs, const float* maxT,
+                       UINT count, bool* occluded, TaskPool* pool = nullptr)const;
+
+    UINT InstanceCount()const;
+    UINT NodeCount()const;
+
+private:
+    struct Instance
+    {
+        const MeshBvh* Mesh = nullptr;
+        DirectX::XMFLOAT4X4 InvWorld;
+        UINT Id = 0;
+    };
+
+    std::vector<MeshBvh::Node> mNodes;
+
+    // In leaf order.
+    std::vector<Instance> mInstances;
+};
@@ -3,39 +3,199 @@
 //***************************************************************************************
 
 #include "MeshGen.h"
+#include "TaskPool.h"
 #include <algorithm>
 
 using namespace DirectX;
 
-SubmeshGeometry MeshGenData::AppendSubmesh(const MeshGenData& MeshGenData)
+namespace
 {
-    UINT vertexOffset = static_cast<UINT>(Vertices.size());
-    UINT indexOffset  = static_cast<UINT>(Indices32.size());
+    // Calls fn(begin, end) over [0, count) in chunks of grainSize, on pool when the
+    // mesh has enough vertices to make it worthwhile and inline otherwise.
+    template<typename Fn>
+    void ForRange(uint32_t count, uint32_t grainSize, size_t vertexCount, TaskPool* pool, const Fn& fn)
+    {
+        if(vertexCount < MeshGen::ParallelVertexCount || count <= grainSize)
+        {
+            fn(0u, count);
+            return;
+        }
 
-    XMFLOAT3 vMinf3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
-    XMFLOAT3 vMaxf3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        if(pool == nullptr)
+            pool = &TaskPool::Default();
 
-    XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-    XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+        pool->ParallelFor(count, grainSize, fn);
+    }
 
-    for(UINT i = 0; i < MeshGenData.Vertices.size(); ++i)
+    // Rows (rings, stacks) per task so a task has a few thousand vertices to do.
+    uint32_t RowGrain(uint32_t verticesPerRow)
     {
-        XMVECTOR P = XMLoadFloat3(&MeshGenData.Vertices[i].Position);
+        return std::max(1u, 4096u / std::max(1u, verticesPerRow));
+    }
 
-        vMin = XMVectorMin(vMin, P);
-        vMax = XMVectorMax(vMax, P);
+    // cosf and sinf of j*dTheta for j in [0, sliceCount], shared by every ring.
+    void BuildSliceTable(uint32_t sliceCount, float dTheta, std::vector<XMFLOAT2>& cosSin)
+    {
+        cosSin.resize(sliceCount + 1);
+        for(uint32_t j = 0; j <= sliceCount; ++j)
+            cosSin[j] = XMFLOAT2(cosf(j*dTheta), sinf(j*dTheta));
     }
 
-    BoundingBox bounds;
-    XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
-    XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
+    ///<summary>
+    /// Midpoint vertex of each edge during geosphere subdivision.  An open addressing
+    /// hash table keyed on the sorted vertex pair, so the two faces that share an edge
+    /// share its midpoint.
+    ///</summary>
+    class EdgeMidpointTable
+    {
+    public:
+        // Empties the table and sizes it for edgeCount edges at most half full.
+        void Reset(size_t edgeCount)
+        {
+            size_t capacity = 64;
+            while(capacity < 2*edgeCount)
+                capacity *= 2;
+
+            mKeys.assign(capacity, EmptyKey);
+            mValues.resize(capacity);
+            mMask = capacity - 1;
+        }
+
+        // Returns true and sets index = newIndex if the edge was not in the table yet;
+        // otherwise sets index to the midpoint it already has.
+        bool FindOrInsert(uint32_t a, uint32_t b, uint32_t newIndex, uint32_t& index)
+        {
+            const uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mMask;
+            for(;;)
+            {
+                if(mKeys[slot] == key)
+                {
+                    index = mValues[slot];
+                    return false;
+                }
+
+                if(mKeys[slot] == EmptyKey)
+                {
+                    mKeys[slot] = key;
+                    mValues[slot] = newIndex;
+                    index = newIndex;
+                    return true;
+                }
+
+                slot = (slot + 1) & mMask;
+            }
+        }
+
+    private:
+        static constexpr uint64_t EmptyKey = ~0ull;
+
+        std::vector<uint64_t> mKeys;
+        std::vector<uint32_t> mValues;
+        size_t mMask = 0;
+    };
+
+    ///<summary>
+    /// Splits every triangle of a closed mesh in four, one level at a time.  Every
+    /// buffer is sized for the last level up front, so the levels only write.
+    ///</summary>
+    class GeosphereSubdivider
+    {
+    public:
+        GeosphereSubdivider(uint32_t finalVertexCount, uint32_t finalIndexCount)
+        {
+            mEdgeEnds.reserve(finalVertexCount);
+            mFaceMidpoints.reserve(finalIndexCount / 4);
+            mSubdivided.reserve(finalIndexCount);
+        }
+
+        //       v1
+        //       *
+        //      / \
+        //     /   \
+        //  m0*-----*m1
+        //   / \   / \
+        //  /   \ /   \
+        // *-----*-----*
+        // v0    m2     v2
+        void Subdivide(std::vector<XMFLOAT3>& positions, std::vector<uint32_t>& indices, TaskPool* pool)
+        {
+            const uint32_t numTris = (uint32_t)indices.size() / 3;
+            const uint32_t vertexCount = (uint32_t)positions.size();
+
+            // Number the midpoints in order of first use.  Each edge of a closed mesh
+            // belongs to two faces, so there are 3/2 edges per face.
+            mEdges.Reset(3*(size_t)numTris/2);
+            mEdgeEnds.clear();
+            mFaceMidpoints.resize(indices.size());
+            for(uint32_t i = 0; i < numTris; ++i)
+            {
+                const uint32_t* tri = &indices[i*3];
+                const uint32_t ends[3][2] = { { tri[0], tri[1] }, { tri[1], tri[2] }, { tri[0], tri[2] } };
+                for(uint32_t e = 0; e < 3; ++e)
+                {
+                    const uint32_t newIndex = vertexCount + (uint32_t)mEdgeEnds.size();
+                    if(mEdges.FindOrInsert(ends[e][0], ends[e][1], newIndex, mFaceMidpoints[i*3 + e]))
+                        mEdgeEnds.push_back(XMUINT2(ends[e][0], ends[e][1]));
+                }
+            }
+
+            const uint32_t newVertexCount = vertexCount + (uint32_t)mEdgeEnds.size();
+            positions.resize(newVertexCount);
+            ForRange((uint32_t)mEdgeEnds.size(), 4096, newVertexCount, pool, [&](uint32_t begin, uint32_t end)
+            {
+                for(uint32_t e = begin; e < end; ++e)
+                {
+                    XMVECTOR p0 = XMLoadFloat3(&positions[mEdgeEnds[e].x]);
+                    XMVECTOR p1 = XMLoadFloat3(&positions[mEdgeEnds[e].y]);
+                    XMStoreFloat3(&positions[vertexCount + e], 0.5f*(p0 + p1));
+                }
+            });
+
+            mSubdivided.resize(4*indices.size());
+            ForRange(numTris, 2048, newVertexCount, pool, [&](uint32_t begin, uint32_t end)
+            {
+                for(uint32_t i = begin; i < end; ++i)
+                {
+                    const uint32_t v0 = indices[i*3+0];
+                    const uint32_t v1 = indices[i*3+1];
+                    const uint32_t v2 = indices[i*3+2];
+                    const uint32_t m0 = mFaceMidpoints[i*3+0];
+                    const uint32_t m1 = mFaceMidpoints[i*3+1];
+                    const uint32_t m2 = mFaceMidpoints[i*3+2];
+
+                    uint32_t* out = &mSubdivided[i*12];
+                    out[0] = v0; out[1]  = m0; out[2]  = m2;
+                    out[3] = m0; out[4]  = m1; out[5]  = m2;
+                    out[6] = m2; out[7]  = m1; out[8]  = v2;
+                    out[9] = m0; out[10] = v1; out[11] = m1;
+                }
+            });
+
+            // The old index buffer becomes the next level's output buffer.
+            std::swap(indices, mSubdivided);
+        }
+
+    private:
+        EdgeMidpointTable mEdges;
+        std::vector<XMUINT2> mEdgeEnds;         // per new vertex, the edge it splits
+        std::vector<uint32_t> mFaceMidpoints;   // per face, the midpoints m0, m1, m2
+        std::vector<uint32_t> mSubdivided;
+    };
+}
+
+SubmeshGeometry MeshGenData::AppendSubmesh(const MeshGenData& MeshGenData)
+{
+    UINT vertexOffset = static_cast<UINT>(Vertices.size());
+    UINT indexOffset  = static_cast<UINT>(Indices32.size());
 
     SubmeshGeometry submesh;
     submesh.IndexCount = static_cast<UINT>(MeshGenData.Indices32.size());
     submesh.StartIndexLocation = indexOffset;
     submesh.BaseVertexLocation = vertexOffset;
     submesh.VertexCount = static_cast<UINT>(MeshGenData.Vertices.size());
-    submesh.Bounds = bounds;
+    submesh.Bounds = MeshGenData.ComputeBounds();
 
     Vertices.insert(std::end(Vertices), std::begin(MeshGenData.Vertices), std::end(MeshGenData.Vertices));
     Indices32.insert(std::end(Indices32), std::begin(MeshGenData.Indices32), std::end(MeshGenData.Indices32));
@@ -43,6 +203,49 @@ SubmeshGeometry MeshGenData::AppendSubmesh(const MeshGenData& MeshGenData)
     return submesh;
 }
 
+BoundingBox MeshGenData::ComputeBounds(TaskPool* pool)const
+{
+    // One min/max pair per chunk, then reduce those.  Chunks start on multiples of
+    // the grain size, which gives each its slot.
+    const uint32_t grainSize = 8192;
+    const uint32_t vertexCount = static_cast<uint32_t>(Vertices.size());
+    const uint32_t chunkCount = std::max(1u, (vertexCount + grainSize - 1) / grainSize);
+
+    std::vector<XMFLOAT3> chunkMin(chunkCount, XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX));
+    std::vector<XMFLOAT3> chunkMax(chunkCount, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+    ForRange(vertexCount, grainSize, vertexCount, pool, [&](uint32_t begin, uint32_t end)
+    {
+        XMVECTOR vMin = XMLoadFloat3(&chunkMin[begin / grainSize]);
+        XMVECTOR vMax = XMLoadFloat3(&chunkMax[begin / grainSize]);
+
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            XMVECTOR P = XMLoadFloat3(&Vertices[i].Position);
+
+            vMin = XMVectorMin(vMin, P);
+            vMax = XMVectorMax(vMax, P);
+        }
+
+        XMStoreFloat3(&chunkMin[begin / grainSize], vMin);
+        XMStoreFloat3(&chunkMax[begin / grainSize], vMax);
+    });
+
+    XMVECTOR vMin = XMLoadFloat3(&chunkMin[0]);
+    XMVECTOR vMax = XMLoadFloat3(&chunkMax[0]);
+    for(uint32_t c = 1; c < chunkCount; ++c)
+    {
+        vMin = XMVectorMin(vMin, XMLoadFloat3(&chunkMin[c]));
+        vMax = XMVectorMax(vMax, XMLoadFloat3(&chunkMax[c]));
+    }
+
+    BoundingBox bounds;
+    XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
+    XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
+
+    return bounds;
+}
+
 MeshGenData MeshGen::CreateBox(float width, float height, float depth, uint32_t numSubdivisions)
 {
     MeshGenData meshData;
@@ -136,10 +339,17 @@ MeshGenData MeshGen::CreateBox(float width, float height, float depth, uint32_t
     return meshData;
 }
 
-MeshGenData MeshGen::CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount)
+MeshGenData MeshGen::CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount, TaskPool* pool)
 {
     MeshGenData meshData;
 
+    const uint32_t ringVertexCount = sliceCount + 1;
+    const uint32_t ringCount = stackCount - 1;
+    const uint32_t vertexCount = 2 + ringCount*ringVertexCount;
+
+    meshData.Vertices.resize(vertexCount);
+    meshData.Indices32.resize(6*sliceCount*(stackCount - 1));
+
     //
     // Compute the vertices stating at the top pole and moving down the stacks.
     //
@@ -150,58 +360,69 @@ MeshGenData MeshGen::CreateSphere(float radius, uint32_t sliceCount, uint32_t st
     MeshGenVertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
     MeshGenVertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-    meshData.Vertices.push_back(topVertex);
+    meshData.Vertices.front() = topVertex;
+    meshData.Vertices.back() = bottomVertex;
 
     float phiStep   = XM_PI/stackCount;
     float thetaStep = 2.0f*XM_PI/sliceCount;
 
+    std::vector<XMFLOAT2> cosSinTheta;
+    BuildSliceTable(sliceCount, thetaStep, cosSinTheta);
+
     // Compute vertices for each stack ring (do not count the poles as rings).
-    for(uint32_t i = 1; i <= stackCount-1; ++i)
+    // Rings are independent, so large spheres fill them in parallel.
+    ForRange(ringCount, RowGrain(ringVertexCount), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        float phi = i*phiStep;
-
-        // Vertices of ring.
-        for(uint32_t j = 0; j <= sliceCount; ++j)
+        for(uint32_t ring = begin; ring < end; ++ring)
         {
-            float theta = j*thetaStep;
-
-            MeshGenVertex v;
-
-            // spherical to cartesian
-            v.Position.x = radius*sinf(phi)*cosf(theta);
-            v.Position.y = radius*cosf(phi);
-            v.Position.z = radius*sinf(phi)*sinf(theta);
-
-            // Partial derivative of P with respect to theta
-            v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-            v.TangentU.y = 0.0f;
-            v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-            XMVECTOR T = XMLoadFloat3(&v.TangentU);
-            XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-            XMVECTOR p = XMLoadFloat3(&v.Position);
-            XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-            v.TexC.x = theta / XM_2PI;
-            v.TexC.y = phi / XM_PI;
-
-            meshData.Vertices.push_back(v);
+            const uint32_t i = ring + 1;
+            float phi = i*phiStep;
+            float sinPhi = sinf(phi);
+            float cosPhi = cosf(phi);
+
+            // Vertices of ring.
+            MeshGenVertex* ringVertices = &meshData.Vertices[1 + ring*ringVertexCount];
+            for(uint32_t j = 0; j <= sliceCount; ++j)
+            {
+                float theta = j*thetaStep;
+                float cosTheta = cosSinTheta[j].x;
+                float sinTheta = cosSinTheta[j].y;
+
+                MeshGenVertex& v = ringVertices[j];
+
+                // spherical to cartesian
+                v.Position.x = radius*sinPhi*cosTheta;
+                v.Position.y = radius*cosPhi;
+                v.Position.z = radius*sinPhi*sinTheta;
+
+                // Partial derivative of P with respect to theta
+                v.TangentU.x = -radius*sinPhi*sinTheta;
+                v.TangentU.y = 0.0f;
+                v.TangentU.z = +radius*sinPhi*cosTheta;
+
+                XMVECTOR T = XMLoadFloat3(&v.TangentU);
+                XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+
+                XMVECTOR p = XMLoadFloat3(&v.Position);
+                XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+
+                v.TexC.x = theta / XM_2PI;
+                v.TexC.y = phi / XM_PI;
+            }
         }
-    }
-
-    meshData.Vertices.push_back(bottomVertex);
+    });
 
     //
     // Compute indices for top stack.  The top stack was written first to the vertex buffer
     // and connects the top pole to the first ring.
     //
 
+    uint32_t k = 0;
     for(uint32_t i = 1; i <= sliceCount; ++i)
     {
-        meshData.Indices32.push_back(0);
-        meshData.Indices32.push_back(i+1);
-        meshData.Indices32.push_back(i);
+        meshData.Indices32[k++] = 0;
+        meshData.Indices32[k++] = i+1;
+        meshData.Indices32[k++] = i;
     }
 
     //
@@ -211,20 +432,25 @@ MeshGenData MeshGen::CreateSphere(float radius, uint32_t sliceCount, uint32_t st
     // Offset the indices to the index of the first vertex in the first ring.
     // This is just skipping the top pole vertex.
     uint32_t baseIndex = 1;
-    uint32_t ringVertexCount = sliceCount + 1;
-    for(uint32_t i = 0; i < stackCount-2; ++i)
+    const uint32_t topIndexCount = k;
+    ForRange(stackCount - 2, RowGrain(ringVertexCount), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        for(uint32_t j = 0; j < sliceCount; ++j)
+        for(uint32_t i = begin; i < end; ++i)
         {
-            meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-            meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-            meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-            meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-            meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-            meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+            uint32_t* stack = &meshData.Indices32[topIndexCount + i*6*sliceCount];
+            for(uint32_t j = 0; j < sliceCount; ++j)
+            {
+                stack[j*6+0] = baseIndex + i*ringVertexCount + j;
+                stack[j*6+1] = baseIndex + i*ringVertexCount + j+1;
+                stack[j*6+2] = baseIndex + (i+1)*ringVertexCount + j;
+
+                stack[j*6+3] = baseIndex + (i+1)*ringVertexCount + j;
+                stack[j*6+4] = baseIndex + i*ringVertexCount + j+1;
+                stack[j*6+5] = baseIndex + (i+1)*ringVertexCount + j+1;
+            }
         }
-    }
+    });
+    k += 6*sliceCount*(stackCount - 2);
 
     //
     // Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
@@ -239,9 +465,9 @@ MeshGenData MeshGen::CreateSphere(float radius, uint32_t sliceCount, uint32_t st
 
     for(uint32_t i = 0; i < sliceCount; ++i)
     {
-        meshData.Indices32.push_back(southPoleIndex);
-        meshData.Indices32.push_back(baseIndex+i);
-        meshData.Indices32.push_back(baseIndex+i+1);
+        meshData.Indices32[k++] = southPoleIndex;
+        meshData.Indices32[k++] = baseIndex+i;
+        meshData.Indices32[k++] = baseIndex+i+1;
     }
 
     return meshData;
@@ -340,12 +566,12 @@ MeshGenVertex MeshGen::MidPoint(const MeshGenVertex& v0, const MeshGenVertex& v1
     return v;
 }
 
-MeshGenData MeshGen::CreateGeosphere(float radius, uint32_t numSubdivisions)
+MeshGenData MeshGen::CreateGeosphere(float radius, uint32_t numSubdivisions, TaskPool* pool)
 {
     MeshGenData meshData;
 
     // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32_t>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32_t>(numSubdivisions, MaxGeosphereSubdivisions);
 
     // Approximate a sphere by tessellating an icosahedron.
 
@@ -370,47 +596,60 @@ MeshGenData MeshGen::CreateGeosphere(float radius, uint32_t numSubdivisions)
         10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
     };
 
-    meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
+    // Each level splits every face in four and adds one vertex per edge, so after s
+    // levels there are 20*4^s faces and 10*4^s + 2 vertices.  Subdivide positions
+    // only, into buffers sized for the last level; the other attributes follow from
+    // the position on the sphere.
+    const uint32_t finalFaceCount = 20u << (2*numSubdivisions);
+    const uint32_t finalVertexCount = (10u << (2*numSubdivisions)) + 2;
+
+    std::vector<XMFLOAT3> positions;
+    positions.reserve(finalVertexCount);
+    positions.assign(&pos[0], &pos[12]);
 
-    for(uint32_t i = 0; i < 12; ++i)
-        meshData.Vertices[i].Position = pos[i];
+    meshData.Indices32.reserve(3*finalFaceCount);
+    meshData.Indices32.assign(&k[0], &k[60]);
 
+    GeosphereSubdivider subdivider(finalVertexCount, 3*finalFaceCount);
     for(uint32_t i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
+        subdivider.Subdivide(positions, meshData.Indices32, pool);
 
     // Project vertices onto sphere and scale.
-    for(uint32_t i = 0; i < meshData.Vertices.size(); ++i)
+    meshData.Vertices.resize(positions.size());
+    ForRange((uint32_t)positions.size(), 4096, positions.size(), pool, [&](uint32_t begin, uint32_t end)
     {
-        // Project onto unit sphere.
-        XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            // Project onto unit sphere.
+            XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&positions[i]));
 
-        // Project onto sphere.
-        XMVECTOR p = radius*n;
+            // Project onto sphere.
+            XMVECTOR p = radius*n;
 
-        XMStoreFloat3(&meshData.Vertices[i].Position, p);
-        XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+            XMStoreFloat3(&meshData.Vertices[i].Position, p);
+            XMStoreFloat3(&meshData.Vertices[i].Normal, n);
 
-        // Derive texture coordinates from spherical coordinates.
-        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+            // Derive texture coordinates from spherical coordinates.
+            float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
 
-        // Put in [0, 2pi].
-        if(theta < 0.0f)
-            theta += XM_2PI;
+            // Put in [0, 2pi].
+            if(theta < 0.0f)
+                theta += XM_2PI;
 
-        float phi = acosf(meshData.Vertices[i].Position.y / radius);
+            float phi = acosf(meshData.Vertices[i].Position.y / radius);
 
-        meshData.Vertices[i].TexC.x = theta/XM_2PI;
-        meshData.Vertices[i].TexC.y = phi/XM_PI;
+            meshData.Vertices[i].TexC.x = theta/XM_2PI;
+            meshData.Vertices[i].TexC.y = phi/XM_PI;
 
-        // Partial derivative of P with respect to theta
-        meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-        meshData.Vertices[i].TangentU.y = 0.0f;
-        meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+            // Partial derivative of P with respect to theta
+            meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
+            meshData.Vertices[i].TangentU.y = 0.0f;
+            meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-        XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-        XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-    }
+            XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
+            XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+        }
+    });
 
     return meshData;
 }
@@ -420,7 +659,8 @@ MeshGenData MeshGen::CreateCylinder(
     float topRadius,
     float height,
     uint32_t sliceCount,
-    uint32_t stackCount)
+    uint32_t stackCount,
+    TaskPool* pool)
 {
     MeshGenData meshData;
 
@@ -435,78 +675,94 @@ MeshGenData MeshGen::CreateCylinder(
 
     uint32_t ringCount = stackCount+1;
 
+    // Add one because we duplicate the first and last vertex per ring
+    // since the texture coordinates are different.
+    uint32_t ringVertexCount = sliceCount+1;
+
+    const uint32_t vertexCount = ringCount*ringVertexCount;
+
+    // Each cap appends a ring and a center vertex, and a triangle per slice.
+    meshData.Vertices.reserve(vertexCount + 2*(ringVertexCount + 1));
+    meshData.Indices32.reserve(6*sliceCount*stackCount + 2*3*sliceCount);
+    meshData.Vertices.resize(vertexCount);
+
+    float dTheta = 2.0f*XM_PI/sliceCount;
+    std::vector<XMFLOAT2> cosSinTheta;
+    BuildSliceTable(sliceCount, dTheta, cosSinTheta);
+
     // Compute vertices for each stack ring starting at the bottom and moving up.
-    for(uint32_t i = 0; i < ringCount; ++i)
+    ForRange(ringCount, RowGrain(ringVertexCount), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        float y = -0.5f*height + i*stackHeight;
-        float r = bottomRadius + i*radiusStep;
-
-        // vertices of ring
-        float dTheta = 2.0f*XM_PI/sliceCount;
-        for(uint32_t j = 0; j <= sliceCount; ++j)
+        for(uint32_t i = begin; i < end; ++i)
         {
-            MeshGenVertex vertex;
-
-            float c = cosf(j*dTheta);
-            float s = sinf(j*dTheta);
-
-            vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-            vertex.TexC.x = (float)j/sliceCount;
-            vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-            // Cylinder can be parameterized as follows, where we introduce v
-            // parameter that goes in the same direction as the v tex-coord
-            // so that the bitangent goes in the same direction as the v tex-coord.
-            //   Let r0 be the bottom radius and let r1 be the top radius.
-            //   y(v) = h - hv for v in [0,1].
-            //   r(v) = r1 + (r0-r1)v
-            //
-            //   x(t, v) = r(v)*cos(t)
-            //   y(t, v) = h - hv
-            //   z(t, v) = r(v)*sin(t)
-            // 
-            //  dx/dt = -r(v)*sin(t)
-            //  dy/dt = 0
-            //  dz/dt = +r(v)*cos(t)
-            //
-            //  dx/dv = (r0-r1)*cos(t)
-            //  dy/dv = -h
-            //  dz/dv = (r0-r1)*sin(t)
-
-            // This is unit length.
-            vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-            float dr = bottomRadius-topRadius;
-            XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-            XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-            XMVECTOR B = XMLoadFloat3(&bitangent);
-            XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-            XMStoreFloat3(&vertex.Normal, N);
-
-            meshData.Vertices.push_back(vertex);
+            float y = -0.5f*height + i*stackHeight;
+            float r = bottomRadius + i*radiusStep;
+
+            // vertices of ring
+            for(uint32_t j = 0; j <= sliceCount; ++j)
+            {
+                MeshGenVertex& vertex = meshData.Vertices[i*ringVertexCount + j];
+
+                float c = cosSinTheta[j].x;
+                float s = cosSinTheta[j].y;
+
+                vertex.Position = XMFLOAT3(r*c, y, r*s);
+
+                vertex.TexC.x = (float)j/sliceCount;
+                vertex.TexC.y = 1.0f - (float)i/stackCount;
+
+                // Cylinder can be parameterized as follows, where we introduce v
+                // parameter that goes in the same direction as the v tex-coord
+                // so that the bitangent goes in the same direction as the v tex-coord.
+                //   Let r0 be the bottom radius and let r1 be the top radius.
+                //   y(v) = h - hv for v in [0,1].
+                //   r(v) = r1 + (r0-r1)v
+                //
+                //   x(t, v) = r(v)*cos(t)
+                //   y(t, v) = h - hv
+                //   z(t, v) = r(v)*sin(t)
+                // 
+                //  dx/dt = -r(v)*sin(t)
+                //  dy/dt = 0
+                //  dz/dt = +r(v)*cos(t)
+                //
+                //  dx/dv = (r0-r1)*cos(t)
+                //  dy/dv = -h
+                //  dz/dv = (r0-r1)*sin(t)
+
+                // This is unit length.
+                vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+
+                float dr = bottomRadius-topRadius;
+                XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+                XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+                XMVECTOR B = XMLoadFloat3(&bitangent);
+                XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+                XMStoreFloat3(&vertex.Normal, N);
+            }
         }
-    }
-
-    // Add one because we duplicate the first and last vertex per ring
-    // since the texture coordinates are different.
-    uint32_t ringVertexCount = sliceCount+1;
+    });
 
     // Compute indices for each stack.
-    for(uint32_t i = 0; i < stackCount; ++i)
+    meshData.Indices32.resize(6*sliceCount*stackCount);
+    ForRange(stackCount, RowGrain(ringVertexCount), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        for(uint32_t j = 0; j < sliceCount; ++j)
+        for(uint32_t i = begin; i < end; ++i)
         {
-            meshData.Indices32.push_back(i*ringVertexCount + j);
-            meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-            meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-            meshData.Indices32.push_back(i*ringVertexCount + j);
-            meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-            meshData.Indices32.push_back(i*ringVertexCount + j+1);
+            uint32_t* stack = &meshData.Indices32[i*6*sliceCount];
+            for(uint32_t j = 0; j < sliceCount; ++j)
+            {
+                stack[j*6+0] = i*ringVertexCount + j;
+                stack[j*6+1] = (i+1)*ringVertexCount + j;
+                stack[j*6+2] = (i+1)*ringVertexCount + j+1;
+
+                stack[j*6+3] = i*ringVertexCount + j;
+                stack[j*6+4] = (i+1)*ringVertexCount + j+1;
+                stack[j*6+5] = i*ringVertexCount + j+1;
+            }
         }
-    }
+    });
 
     BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
     BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
@@ -617,7 +873,8 @@ void MeshGen::BuildCylinderBottomCap(
 
 MeshGenData MeshGen::CreateGrid(
     float width, float depth, 
-    uint32_t m, uint32_t n)
+    uint32_t m, uint32_t n,
+    TaskPool* pool)
 {
     MeshGenData meshData;
 
@@ -637,23 +894,27 @@ MeshGenData MeshGen::CreateGrid(
     float du = 1.0f / (n-1);
     float dv = 1.0f / (m-1);
 
+    // Rows are independent, so large grids fill them in parallel.
     meshData.Vertices.resize(vertexCount);
-    for(uint32_t i = 0; i < m; ++i)
+    ForRange(m, RowGrain(n), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        float z = halfDepth - i*dz;
-        for(uint32_t j = 0; j < n; ++j)
+        for(uint32_t i = begin; i < end; ++i)
         {
-            float x = -halfWidth + j*dx;
-
-            meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-            meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-            // Stretch texture over grid.
-            meshData.Vertices[i*n+j].TexC.x = j*du;
-            meshData.Vertices[i*n+j].TexC.y = i*dv;
+            float z = halfDepth - i*dz;
+            for(uint32_t j = 0; j < n; ++j)
+            {
+                float x = -halfWidth + j*dx;
+
+                meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
+                meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+                meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+
+                // Stretch texture over grid.
+                meshData.Vertices[i*n+j].TexC.x = j*du;
+                meshData.Vertices[i*n+j].TexC.y = i*dv;
+            }
         }
-    }
+    });
 
     //
     // Create the indices.
@@ -661,23 +922,27 @@ MeshGenData MeshGen::CreateGrid(
 
     meshData.Indices32.resize(faceCount*3); // 3 indices per face
 
-    // Iterate over each quad and compute indices.
-    uint32_t k = 0;
-    for(uint32_t i = 0; i < m-1; ++i)
+    // Iterate over each quad and compute indices.  Each row of quads starts at a
+    // known offset, so rows can be written in any order.
+    ForRange(m-1, RowGrain(n), vertexCount, pool, [&](uint32_t begin, uint32_t end)
     {
-        for(uint32_t j = 0; j < n-1; ++j)
+        for(uint32_t i = begin; i < end; ++i)
         {
-            meshData.Indices32[k]   = i*n+j;
-            meshData.Indices32[k+1] = i*n+j+1;
-            meshData.Indices32[k+2] = (i+1)*n+j;
-
-            meshData.Indices32[k+3] = (i+1)*n+j;
-            meshData.Indices32[k+4] = i*n+j+1;
-            meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-            k += 6; // next quad
+            uint32_t k = i*(n-1)*6;
+            for(uint32_t j = 0; j < n-1; ++j)
+            {
+                meshData.Indices32[k]   = i*n+j;
+                meshData.Indices32[k+1] = i*n+j+1;
+                meshData.Indices32[k+2] = (i+1)*n+j;
+
+                meshData.Indices32[k+3] = (i+1)*n+j;
+                meshData.Indices32[k+4] = i*n+j+1;
+                meshData.Indices32[k+5] = (i+1)*n+j+1;
+
+                k += 6; // next quad
+            }
         }
-    }
+    });
 
     return meshData;
 }
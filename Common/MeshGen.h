@@ -18,6 +18,8 @@
 #include <cstdint>
 #include <vector>
 
+class TaskPool;
+
 struct MeshGenVertex
 {
     MeshGenVertex() :
@@ -57,6 +59,10 @@ struct MeshGenData
 
     SubmeshGeometry AppendSubmesh(const MeshGenData& meshData);
 
+    // Axis-aligned box around the vertex positions.  Large meshes are reduced in
+    // parallel on pool (TaskPool::Default() if null).
+    DirectX::BoundingBox ComputeBounds(TaskPool* pool = nullptr)const;
+
     std::vector<uint16_t>& GetIndices16()
     {
         if(mIndices16.empty())
@@ -76,6 +82,14 @@ private:
 class MeshGen
 {
 public:
+    // Meshes with at least this many vertices are generated in parallel on the
+    // TaskPool passed to the Create functions (TaskPool::Default() if null), by
+    // rows, rings or faces.  Smaller ones are not worth waking the workers for.
+    static constexpr uint32_t ParallelVertexCount = 16384;
+
+    // Beyond 6 subdivisions a geosphere has more vertices than 16-bit indices can
+    // address.
+    static constexpr uint32_t MaxGeosphereSubdivisions = 8;
 
     ///<summary>
     /// Creates a box centered at the origin with the given dimensions, where each
@@ -87,26 +101,27 @@ public:
     /// Creates a sphere centered at the origin with the given radius.  The
     /// slices and stacks parameters control the degree of tessellation.
     ///</summary>
-    MeshGenData CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount);
+    MeshGenData CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount, TaskPool* pool = nullptr);
 
     ///<summary>
     /// Creates a geosphere centered at the origin with the given radius.  The
-    /// depth controls the level of tessellation.
+    /// depth controls the level of tessellation.  Edges shared by two faces share
+    /// their midpoint vertex, so the vertex count is 10*4^numSubdivisions + 2.
     ///</summary>
-    MeshGenData CreateGeosphere(float radius, uint32_t numSubdivisions);
+    MeshGenData CreateGeosphere(float radius, uint32_t numSubdivisions, TaskPool* pool = nullptr);
 
     ///<summary>
     /// Creates a cylinder parallel to the y-axis, and centered about the origin.  
     /// The bottom and top radius can vary to form various cone shapes rather than true
     // cylinders.  The slices and stacks parameters control the degree of tessellation.
     ///</summary>
-    MeshGenData CreateCylinder(float bottomRadius, float topRadius, float height, uint32_t sliceCount, uint32_t stackCount);
+    MeshGenData CreateCylinder(float bottomRadius, float topRadius, float height, uint32_t sliceCount, uint32_t stackCount, TaskPool* pool = nullptr);
 
     ///<summary>
     /// Creates an mxn grid in the xz-plane with m rows and n columns, centered
     /// at the origin with the specified width and depth.
     ///</summary>
-    MeshGenData CreateGrid(float width, float depth, uint32_t m, uint32_t n);
+    MeshGenData CreateGrid(float width, float depth, uint32_t m, uint32_t n, TaskPool* pool = nullptr);
 
     ///<summary>
     /// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
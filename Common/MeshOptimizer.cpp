@@ -0,0 +1,713 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+    ///<summary>
+    /// Triangles around each vertex, as one array of triangle indices with an offset
+    /// and count per vertex.
+    ///</summary>
+    struct VertexTriangles
+    {
+        std::vector<UINT> Offsets;
+        std::vector<UINT> Counts;
+        std::vector<UINT> Triangles;
+
+        VertexTriangles(const uint32_t* indices, UINT indexCount, UINT vertexCount)
+        {
+            Counts.assign(vertexCount, 0);
+            for(UINT i = 0; i < indexCount; ++i)
+                Counts[indices[i]]++;
+
+            Offsets.resize(vertexCount);
+            UINT offset = 0;
+            for(UINT v = 0; v < vertexCount; ++v)
+            {
+                Offsets[v] = offset;
+                offset += Counts[v];
+            }
+
+            // Fill, then restore the counts the fill used as cursors.
+            Triangles.resize(indexCount);
+            std::fill(Counts.begin(), Counts.end(), 0u);
+            for(UINT i = 0; i < indexCount; ++i)
+            {
+                const UINT v = indices[i];
+                Triangles[Offsets[v] + Counts[v]++] = i / 3;
+            }
+        }
+    };
+
+    ///<summary>
+    /// FIFO post-transform cache.  A vertex is resident while fewer than cacheSize
+    /// misses happened since its own miss, which a per-vertex timestamp answers
+    /// without keeping the queue.
+    ///</summary>
+    class FifoCache
+    {
+    public:
+        FifoCache(UINT vertexCount, UINT cacheSize) :
+            mTimestamps(vertexCount, 0),
+            mCacheSize(cacheSize),
+            mTime(cacheSize + 1)
+        {
+        }
+
+        // Returns true on a miss.
+        bool Access(UINT v)
+        {
+            if(mTime - mTimestamps[v] > mCacheSize)
+            {
+                mTimestamps[v] = mTime++;
+                return true;
+            }
+
+            return false;
+        }
+
+        // Every vertex misses afterwards.
+        void Flush()
+        {
+            mTime += mCacheSize + 1;
+        }
+
+        UINT Time()const { return mTime; }
+        UINT Timestamp(UINT v)const { return mTimestamps[v]; }
+
+    private:
+        std::vector<UINT> mTimestamps;
+        UINT mCacheSize;
+        UINT mTime;
+    };
+
+    // Post-transform cache misses of drawing the indices in order, from a cold cache.
+    UINT CountCacheMisses(const uint32_t* indices, UINT indexCount, UINT vertexCount, UINT cacheSize)
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        UINT misses = 0;
+        for(UINT i = 0; i < indexCount; ++i)
+            misses += cache.Access(indices[i]) ? 1 : 0;
+        return misses;
+    }
+
+    const XMFLOAT3& VertexPosition(const void* vertices, UINT vertexStride, UINT positionOffset, UINT v)
+    {
+        const BYTE* bytes = static_cast<const BYTE*>(vertices);
+        return *reinterpret_cast<const XMFLOAT3*>(bytes + (size_t)v*vertexStride + positionOffset);
+    }
+
+    // Tipsify's next fanning vertex once the candidates are exhausted: the most recent
+    // vertex on the dead-end stack that still has triangles, else the next such vertex
+    // in input order.  -1 when every triangle has been emitted.
+    int SkipDeadEnd(const std::vector<UINT>& live, std::vector<UINT>& deadEnd, UINT& cursor, UINT vertexCount)
+    {
+        while(!deadEnd.empty())
+        {
+            UINT v = deadEnd.back();
+            deadEnd.pop_back();
+            if(live[v] > 0)
+                return (int)v;
+        }
+
+        for(; cursor < vertexCount; ++cursor)
+        {
+            if(live[cursor] > 0)
+                return (int)cursor;
+        }
+
+        return -1;
+    }
+
+    // Forsyth's vertex score tables.
+    constexpr UINT ForsythCacheSize = 32;
+    constexpr UINT ForsythMaxValence = 32;
+
+    struct ForsythScores
+    {
+        float Cache[ForsythCacheSize];
+        float Valence[ForsythMaxValence];
+
+        ForsythScores()
+        {
+            // The last triangle's vertices get a fixed score so the next triangle does
+            // not simply reuse them in the same order.
+            for(UINT i = 0; i < ForsythCacheSize; ++i)
+            {
+                Cache[i] = i < 3 ? 0.75f :
+                    powf(1.0f - (float)(i - 3) / (ForsythCacheSize - 3), 1.5f);
+            }
+
+            // Vertices with few triangles left get a boost, so they are finished off
+            // instead of being left behind.
+            Valence[0] = 0.0f;
+            for(UINT i = 1; i < ForsythMaxValence; ++i)
+                Valence[i] = 2.0f / sqrtf((float)i);
+        }
+
+        float Score(int cachePosition, UINT live)const
+        {
+            if(live == 0)
+                return -1.0f;
+
+            float score = cachePosition >= 0 ? Cache[cachePosition] : 0.0f;
+            return score + Valence[std::min(live, ForsythMaxValence - 1)];
+        }
+    };
+}
+
+void MeshOptimizer::OptimizeVertexCacheTipsify(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT vertexCount,
+                                               UINT cacheSize, std::vector<UINT>* clusters)
+{
+    assert(dst != indices);
+
+    const UINT triCount = indexCount / 3;
+    VertexTriangles adjacency(indices, indexCount, vertexCount);
+
+    std::vector<UINT> live = adjacency.Counts;
+    std::vector<UINT> deadEnd;
+    deadEnd.reserve(indexCount);
+    std::vector<BYTE> emitted(triCount, 0);
+    std::vector<UINT> candidates;
+    candidates.reserve(64);
+
+    FifoCache cache(vertexCount, cacheSize);
+    UINT cursor = 0;
+    UINT outCount = 0;
+
+    if(clusters != nullptr)
+        clusters->clear();
+
+    int fan = SkipDeadEnd(live, deadEnd, cursor, vertexCount);
+    if(fan >= 0 && clusters != nullptr)
+        clusters->push_back(0);
+
+    while(fan >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        const UINT* tris = &adjacency.Triangles[adjacency.Offsets[fan]];
+        for(UINT k = 0; k < adjacency.Counts[fan]; ++k)
+        {
+            const UINT t = tris[k];
+            if(emitted[t])
+                continue;
+
+            for(UINT c = 0; c < 3; ++c)
+            {
+                const UINT v = indices[t*3 + c];
+                dst[outCount++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                cache.Access(v);
+            }
+
+            emitted[t] = 1;
+        }
+
+        // Next, the candidate that stays in the cache while its remaining triangles
+        // are emitted and that entered the cache earliest.
+        int next = -1;
+        UINT bestPriority = 0;
+        for(UINT v : candidates)
+        {
+            if(live[v] == 0)
+                continue;
+
+            UINT priority = 0;
+            const UINT age = cache.Time() - cache.Timestamp(v);
+            if(age + 2*live[v] <= cacheSize)
+                priority = age;
+
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = (int)v;
+            }
+        }
+
+        if(next < 0)
+        {
+            next = SkipDeadEnd(live, deadEnd, cursor, vertexCount);
+            if(next >= 0 && clusters != nullptr)
+                clusters->push_back(outCount / 3);
+        }
+
+        fan = next;
+    }
+
+    assert(outCount == triCount*3);
+}
+
+void MeshOptimizer::OptimizeVertexCacheForsyth(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT vertexCount)
+{
+    assert(dst != indices);
+
+    static const ForsythScores scores;
+
+    const UINT triCount = indexCount / 3;
+    VertexTriangles adjacency(indices, indexCount, vertexCount);
+
+    // Remaining triangles of a vertex are kept at the front of its range.
+    std::vector<UINT> live = adjacency.Counts;
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(UINT v = 0; v < vertexCount; ++v)
+        vertexScore[v] = scores.Score(-1, live[v]);
+
+    std::vector<float> triScore(triCount);
+    for(UINT t = 0; t < triCount; ++t)
+        triScore[t] = vertexScore[indices[t*3]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+
+    std::vector<BYTE> emitted(triCount, 0);
+
+    // The cache plus room for the three vertices pushed in front of it.
+    UINT cache[ForsythCacheSize + 3];
+    UINT newCache[ForsythCacheSize + 3];
+    UINT cacheCount = 0;
+
+    int best = -1;
+    float bestScore = -1.0f;
+    for(UINT t = 0; t < triCount; ++t)
+    {
+        if(triScore[t] > bestScore)
+        {
+            bestScore = triScore[t];
+            best = (int)t;
+        }
+    }
+
+    UINT cursor = 0;
+    for(UINT outTri = 0; outTri < triCount; ++outTri)
+    {
+        if(best < 0)
+        {
+            // Nothing in the cache has triangles left; continue with the next
+            // triangle in input order.
+            while(emitted[cursor])
+                ++cursor;
+            best = (int)cursor;
+        }
+
+        const UINT* tri = &indices[best*3];
+        dst[outTri*3 + 0] = tri[0];
+        dst[outTri*3 + 1] = tri[1];
+        dst[outTri*3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        // Remove the triangle from its vertices.
+        for(UINT c = 0; c < 3; ++c)
+        {
+            const UINT v = tri[c];
+            UINT* tris = &adjacency.Triangles[adjacency.Offsets[v]];
+            for(UINT k = 0; k < live[v]; ++k)
+            {
+                if(tris[k] == (UINT)best)
+                {
+                    std::swap(tris[k], tris[live[v] - 1]);
+                    break;
+                }
+            }
+            live[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache.
+        UINT newCount = 0;
+        for(UINT c = 0; c < 3; ++c)
+            newCache[newCount++] = tri[c];
+        for(UINT i = 0; i < cacheCount; ++i)
+        {
+            const UINT v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // Rescore everything that moved, including the vertices that fell out.
+        for(UINT i = 0; i < newCount; ++i)
+        {
+            const UINT v = newCache[i];
+            const int position = i < ForsythCacheSize ? (int)i : -1;
+            cachePosition[v] = position;
+
+            const float score = scores.Score(position, live[v]);
+            const float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const UINT* tris = &adjacency.Triangles[adjacency.Offsets[v]];
+            for(UINT k = 0; k < live[v]; ++k)
+                triScore[tris[k]] += delta;
+        }
+
+        cacheCount = std::min(newCount, ForsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // Best remaining triangle that touches the cache.
+        best = -1;
+        bestScore = -1.0f;
+        for(UINT i = 0; i < cacheCount; ++i)
+        {
+            const UINT v = cache[i];
+            const UINT* tris = &adjacency.Triangles[adjacency.Offsets[v]];
+            for(UINT k = 0; k < live[v]; ++k)
+            {
+                if(triScore[tris[k]] > bestScore)
+                {
+                    bestScore = triScore[tris[k]];
+                    best = (int)tris[k];
+                }
+            }
+        }
+    }
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* dst, const uint32_t* indices, UINT indexCount,
+                                     const void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+                                     const std::vector<UINT>& clusters, UINT cacheSize, float threshold)
+{
+    assert(dst != indices);
+
+    const UINT triCount = indexCount / 3;
+    if(triCount == 0)
+        return;
+
+    //
+    // Split the clusters where the cache order loses little by starting over.
+    //
+
+    auto triangleMisses = [&](FifoCache& cache, UINT t)
+    {
+        return (UINT)cache.Access(indices[t*3]) + (UINT)cache.Access(indices[t*3+1]) + (UINT)cache.Access(indices[t*3+2]);
+    };
+
+    std::vector<UINT> splits;
+    FifoCache cache(vertexCount, cacheSize);
+    for(size_t c = 0; c < clusters.size(); ++c)
+    {
+        const UINT begin = clusters[c];
+        const UINT end = c + 1 < clusters.size() ? clusters[c + 1] : triCount;
+
+        cache.Flush();
+        UINT clusterMisses = 0;
+        for(UINT t = begin; t < end; ++t)
+            clusterMisses += triangleMisses(cache, t);
+
+        const float acmrThreshold = threshold * clusterMisses / (end - begin);
+
+        cache.Flush();
+        UINT runBegin = begin;
+        UINT runMisses = 0;
+        for(UINT t = begin; t < end; ++t)
+        {
+            runMisses += triangleMisses(cache, t);
+            if((float)runMisses / (t + 1 - runBegin) <= acmrThreshold)
+            {
+                splits.push_back(runBegin);
+                runBegin = t + 1;
+                runMisses = 0;
+                cache.Flush();
+            }
+        }
+
+        // A last run over the threshold joins the run before it, which the cache
+        // order drew it after anyway.
+        if(runBegin < end && (runBegin == begin || (float)runMisses / (end - runBegin) <= acmrThreshold))
+            splits.push_back(runBegin);
+    }
+
+    //
+    // Draw the clusters facing away from the mesh center first: they are most
+    // likely to be in front of the others.
+    //
+
+    const UINT clusterCount = (UINT)splits.size();
+    std::vector<XMFLOAT3> clusterCenter(clusterCount);
+    std::vector<XMFLOAT3> clusterNormal(clusterCount);
+    XMVECTOR meshCenter = XMVectorZero();
+    float meshArea = 0.0f;
+
+    for(UINT c = 0; c < clusterCount; ++c)
+    {
+        const UINT begin = splits[c];
+        const UINT end = c + 1 < clusterCount ? splits[c + 1] : triCount;
+
+        XMVECTOR center = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for(UINT t = begin; t < end; ++t)
+        {
+            XMVECTOR p0 = XMLoadFloat3(&VertexPosition(vertices, vertexStride, positionOffset, indices[t*3+0]));
+            XMVECTOR p1 = XMLoadFloat3(&VertexPosition(vertices, vertexStride, positionOffset, indices[t*3+1]));
+            XMVECTOR p2 = XMLoadFloat3(&VertexPosition(vertices, vertexStride, positionOffset, indices[t*3+2]));
+
+            // Twice the area, along the face normal.
+            XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+            float a = XMVectorGetX(XMVector3Length(n));
+
+            center += a*(p0 + p1 + p2)/3.0f;
+            normal += n;
+            area += a;
+        }
+
+        meshCenter += center;
+        meshArea += area;
+
+        XMStoreFloat3(&clusterCenter[c], area > 0.0f ? center/area : center);
+        XMStoreFloat3(&clusterNormal[c], XMVector3Normalize(normal));
+    }
+
+    if(meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    std::vector<float> clusterKey(clusterCount);
+    for(UINT c = 0; c < clusterCount; ++c)
+    {
+        XMVECTOR toCluster = XMLoadFloat3(&clusterCenter[c]) - meshCenter;
+        clusterKey[c] = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&clusterNormal[c])));
+    }
+
+    std::vector<UINT> order(clusterCount);
+    for(UINT c = 0; c < clusterCount; ++c)
+        order[c] = c;
+
+    std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b)
+    {
+        return clusterKey[a] > clusterKey[b];
+    });
+
+    UINT outCount = 0;
+    for(UINT c : order)
+    {
+        const UINT begin = splits[c];
+        const UINT end = c + 1 < clusterCount ? splits[c + 1] : triCount;
+        std::copy(indices + begin*3, indices + end*3, dst + outCount);
+        outCount += (end - begin)*3;
+    }
+
+    // Every run starts with a cold cache in its new place, which the splits above
+    // did not price in between runs.  Keep the cache order if that broke the bound.
+    const UINT cacheOrderMisses = CountCacheMisses(indices, indexCount, vertexCount, cacheSize);
+    if(CountCacheMisses(dst, indexCount, vertexCount, cacheSize) > threshold*cacheOrderMisses)
+        std::copy(indices, indices + indexCount, dst);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(void* vertices, UINT vertexCount, UINT vertexStride, uint32_t* indices, UINT indexCount)
+{
+    const UINT Unused = ~0u;
+
+    std::vector<UINT> remap(vertexCount, Unused);
+    UINT nextVertex = 0;
+    for(UINT i = 0; i < indexCount; ++i)
+    {
+        UINT& newIndex = remap[indices[i]];
+        if(newIndex == Unused)
+            newIndex = nextVertex++;
+
+        indices[i] = newIndex;
+    }
+
+    for(UINT v = 0; v < vertexCount; ++v)
+    {
+        if(remap[v] == Unused)
+            remap[v] = nextVertex++;
+    }
+
+    BYTE* bytes = static_cast<BYTE*>(vertices);
+    std::vector<BYTE> source(bytes, bytes + (size_t)vertexCount*vertexStride);
+    for(UINT v = 0; v < vertexCount; ++v)
+        memcpy(bytes + (size_t)remap[v]*vertexStride, source.data() + (size_t)v*vertexStride, vertexStride);
+}
+
+void MeshOptimizer::Optimize(void* vertices, UINT vertexCount, UINT vertexStride, uint32_t* indices, UINT indexCount,
+                             const MeshOptimizerSettings& settings)
+{
+    if(indexCount < 3)
+        return;
+
+    // Some meshes are authored, or exported, in a better order than either algorithm
+    // finds.  Keep that order unless the cache order beats it.
+    const UINT inputMisses = CountCacheMisses(indices, indexCount, vertexCount, settings.CacheSize);
+
+    std::vector<uint32_t> cacheOrder(indexCount);
+    std::vector<UINT> clusters;
+    if(settings.Algorithm == MeshOptimizerSettings::CacheAlgorithm::Tipsify)
+        OptimizeVertexCacheTipsify(cacheOrder.data(), indices, indexCount, vertexCount, settings.CacheSize, &clusters);
+    else
+        OptimizeVertexCacheForsyth(cacheOrder.data(), indices, indexCount, vertexCount);
+
+    if(CountCacheMisses(cacheOrder.data(), indexCount, vertexCount, settings.CacheSize) < inputMisses)
+    {
+        std::copy(cacheOrder.begin(), cacheOrder.end(), indices);
+
+        // The clustering gives up some of the cache order's ACMR, but not so much
+        // that it falls behind the input order.
+        if(!clusters.empty() && settings.OverdrawThreshold > 1.0f)
+        {
+            OptimizeOverdraw(indices, cacheOrder.data(), indexCount, vertices, vertexCount, vertexStride,
+                             settings.PositionOffset, clusters, settings.CacheSize, settings.OverdrawThreshold);
+
+            if(CountCacheMisses(indices, indexCount, vertexCount, settings.CacheSize) >= inputMisses)
+                std::copy(cacheOrder.begin(), cacheOrder.end(), indices);
+        }
+    }
+
+    if(settings.OptimizeVertexFetch)
+        OptimizeVertexFetch(vertices, vertexCount, vertexStride, indices, indexCount);
+}
+
+MeshOptimizerStats MeshOptimizer::Analyze(const void* vertices, UINT vertexCount, UINT vertexStride,
+                                          const uint32_t* indices, UINT indexCount,
+                                          const MeshOptimizerSettings& settings)
+{
+    MeshOptimizerStats stats;
+    stats.TriangleCount = indexCount / 3;
+    if(stats.TriangleCount == 0)
+        return stats;
+
+    //
+    // Post-transform cache, and the vertex fetches its misses cause through a
+    // 4 KB cache of 64 byte lines.
+    //
+
+    const UINT LineSize = 64;
+    const UINT LineCacheSize = 64;
+    const UINT lineCount = (UINT)(((size_t)vertexCount*vertexStride + LineSize - 1) / LineSize);
+
+    FifoCache vertexCache(vertexCount, settings.CacheSize);
+    FifoCache lineCache(lineCount, LineCacheSize);
+    std::vector<BYTE> used(vertexCount, 0);
+    UINT misses = 0;
+    UINT linesFetched = 0;
+    for(UINT i = 0; i < indexCount; ++i)
+    {
+        const UINT v = indices[i];
+        if(!used[v])
+        {
+            used[v] = 1;
+            stats.VertexCount++;
+        }
+
+        if(!vertexCache.Access(v))
+            continue;
+
+        misses++;
+
+        const size_t first = (size_t)v*vertexStride;
+        const size_t last = first + vertexStride - 1;
+        for(size_t line = first / LineSize; line <= last / LineSize; ++line)
+            linesFetched += lineCache.Access((UINT)line) ? 1 : 0;
+    }
+
+    stats.Acmr = (float)misses / stats.TriangleCount;
+    stats.Atvr = (float)misses / stats.VertexCount;
+    stats.Overfetch = (float)linesFetched*LineSize / ((float)stats.VertexCount*vertexStride);
+
+    //
+    // Overdraw: rasterize the front faces in index order into a small depth buffer,
+    // looking down each axis from both sides.
+    //
+
+    const int Resolution = 256;
+
+    XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+    XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+    for(UINT i = 0; i < indexCount; ++i)
+    {
+        XMVECTOR p = XMLoadFloat3(&VertexPosition(vertices, vertexStride, settings.PositionOffset, indices[i]));
+        vMin = XMVectorMin(vMin, p);
+        vMax = XMVectorMax(vMax, p);
+    }
+
+    XMFLOAT3 boundsMin, boundsSize;
+    XMStoreFloat3(&boundsMin, vMin);
+    XMStoreFloat3(&boundsSize, XMVectorMax(vMax - vMin, XMVectorReplicate(1e-6f)));
+    const float* minf = &boundsMin.x;
+    const float* sizef = &boundsSize.x;
+
+    std::vector<float> depth((size_t)Resolution*Resolution);
+    uint64_t shaded = 0;
+    uint64_t covered = 0;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        const int axisU = (axis + 1) % 3;
+        const int axisV = (axis + 2) % 3;
+        for(float side : { +1.0f, -1.0f })
+        {
+            std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+            for(UINT t = 0; t < stats.TriangleCount; ++t)
+            {
+                float x[3], y[3], z[3];
+                XMFLOAT3 p[3];
+                for(int c = 0; c < 3; ++c)
+                {
+                    p[c] = VertexPosition(vertices, vertexStride, settings.PositionOffset, indices[t*3 + c]);
+                    const float* pf = &p[c].x;
+                    x[c] = (pf[axisU] - minf[axisU]) / sizef[axisU] * Resolution;
+                    y[c] = (pf[axisV] - minf[axisV]) / sizef[axisV] * Resolution;
+
+                    // The viewer is on the side's end of the axis; nearer is smaller.
+                    z[c] = -side*pf[axis];
+                }
+
+                // Front faces have their normal, cross(p1 - p0, p2 - p0), towards the viewer.
+                XMVECTOR n = XMVector3Cross(XMLoadFloat3(&p[1]) - XMLoadFloat3(&p[0]), XMLoadFloat3(&p[2]) - XMLoadFloat3(&p[0]));
+                XMFLOAT3 nf;
+                XMStoreFloat3(&nf, n);
+                if(side*(&nf.x)[axis] <= 0.0f)
+                    continue;
+
+                // Orient the edges so inside is positive.
+                float area = (x[1] - x[0])*(y[2] - y[0]) - (x[2] - x[0])*(y[1] - y[0]);
+                if(area == 0.0f)
+                    continue;
+                if(area < 0.0f)
+                {
+                    std::swap(x[1], x[2]);
+                    std::swap(y[1], y[2]);
+                    std::swap(z[1], z[2]);
+                    area = -area;
+                }
+
+                const int x0 = std::max(0, (int)floorf(std::min({ x[0], x[1], x[2] })));
+                const int x1 = std::min(Resolution - 1, (int)ceilf(std::max({ x[0], x[1], x[2] })));
+                const int y0 = std::max(0, (int)floorf(std::min({ y[0], y[1], y[2] })));
+                const int y1 = std::min(Resolution - 1, (int)ceilf(std::max({ y[0], y[1], y[2] })));
+
+                for(int py = y0; py <= y1; ++py)
+                {
+                    const float sy = py + 0.5f;
+                    for(int px = x0; px <= x1; ++px)
+                    {
+                        const float sx = px + 0.5f;
+                        const float w0 = (x[2] - x[1])*(sy - y[1]) - (y[2] - y[1])*(sx - x[1]);
+                        const float w1 = (x[0] - x[2])*(sy - y[2]) - (y[0] - y[2])*(sx - x[2]);
+                        const float w2 = (x[1] - x[0])*(sy - y[0]) - (y[1] - y[0])*(sx - x[0]);
+                        if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                            continue;
+
+                        const float pz = (w0*z[0] + w1*z[1] + w2*z[2]) / area;
+                        float& d = depth[(size_t)py*Resolution + px];
+                        if(pz < d)
+                        {
+                            d = pz;
+                            shaded++;
+                        }
+                    }
+                }
+            }
+
+            for(float d : depth)
+                covered += d < FLT_MAX ? 1 : 0;
+        }
+    }
+
+    stats.Overdraw = covered > 0 ? (float)shaded / covered : 0.0f;
+
+    return stats;
+}
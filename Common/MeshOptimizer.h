@@ -0,0 +1,95 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// CPU pass that reorders a triangle list for the GPU before it is uploaded, without
+// changing what is drawn:
+//
+//   1. Vertex cache order.  Triangles are reordered so that consecutive triangles
+//      reuse recently transformed vertices, with either Tipsify (Sander et al. 2007)
+//      or Forsyth's linear-speed score based optimizer.
+//   2. Overdraw order.  The cache ordered list is cut into clusters where the cache
+//      is cold anyway, and the clusters are sorted so that the ones facing away from
+//      the mesh center (and so likely in front) are drawn first.
+//   3. Vertex fetch order.  Vertices are renumbered in the order the index buffer
+//      first uses them, so fetches walk the vertex buffer front to back.
+//
+// Analyze measures the result: ACMR (cache misses per triangle), ATVR (cache misses
+// per vertex, 1 is ideal), overfetch (vertex bytes read per vertex byte used) and
+// overdraw (pixels shaded per pixel covered, rasterized headlessly from six axis
+// directions).
+//
+// Vertices are opaque blobs of vertexStride bytes with a float3 position at
+// positionOffset, so any vertex struct works.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+struct MeshOptimizerSettings
+{
+    enum class CacheAlgorithm
+    {
+        Tipsify,
+        Forsyth
+    };
+
+    CacheAlgorithm Algorithm = CacheAlgorithm::Tipsify;
+
+    // Post-transform cache entries Tipsify optimizes for and Analyze simulates.
+    UINT CacheSize = 16;
+
+    // Overdraw clustering may give up at most this factor of ACMR; 1 keeps the cache
+    // order as is.  Only used with Tipsify, which reports where the cache is cold.
+    float OverdrawThreshold = 1.05f;
+
+    bool OptimizeVertexFetch = true;
+
+    // Byte offset of the float3 position in a vertex.
+    UINT PositionOffset = 0;
+};
+
+struct MeshOptimizerStats
+{
+    UINT TriangleCount = 0;
+    UINT VertexCount = 0;
+
+    float Acmr = 0.0f;
+    float Atvr = 0.0f;
+    float Overfetch = 0.0f;
+    float Overdraw = 0.0f;
+};
+
+namespace MeshOptimizer
+{
+    // Writes indices in vertex cache order to dst (may not alias indices).  If
+    // clusters is not null it receives the first triangle of every run after which
+    // the cache was cold, starting with 0.
+    void OptimizeVertexCacheTipsify(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT vertexCount,
+                                    UINT cacheSize, std::vector<UINT>* clusters = nullptr);
+
+    void OptimizeVertexCacheForsyth(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT vertexCount);
+
+    // Reorders the clusters of a cache optimized index list (see above) for less
+    // overdraw.  Clusters are split further where that costs no more than threshold
+    // times the cluster's ACMR.  If the new order still has more than threshold times
+    // the ACMR of indices, dst receives indices unchanged.
+    void OptimizeOverdraw(uint32_t* dst, const uint32_t* indices, UINT indexCount,
+                          const void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+                          const std::vector<UINT>& clusters, UINT cacheSize, float threshold);
+
+    // Renumbers vertices in order of first use and reorders the vertex blobs to
+    // match, in place.  Unused vertices keep their data and move to the end, so the
+    // vertex count does not change.
+    void OptimizeVertexFetch(void* vertices, UINT vertexCount, UINT vertexStride, uint32_t* indices, UINT indexCount);
+
+    // All of the above, in place.  Indices are relative to the first vertex.  The
+    // triangles are only reordered if that lowers the ACMR of the input order, so a
+    // mesh that is already well ordered only gets the vertex fetch pass.
+    void Optimize(void* vertices, UINT vertexCount, UINT vertexStride, uint32_t* indices, UINT indexCount,
+                  const MeshOptimizerSettings& settings = MeshOptimizerSettings());
+
+    MeshOptimizerStats Analyze(const void* vertices, UINT vertexCount, UINT vertexStride,
+                               const uint32_t* indices, UINT indexCount,
+                               const MeshOptimizerSettings& settings = MeshOptimizerSettings());
+}
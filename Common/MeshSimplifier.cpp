@@ -0,0 +1,1044 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "Camera.h"
+
+using namespace DirectX;
+
+namespace
+{
+    enum class VertexKind : uint8_t
+    {
+        // Interior vertex; collapses onto any neighbor.
+        Manifold,
+
+        // On an open boundary; collapses along it onto a Border or Locked vertex.
+        Border,
+
+        // One of two split vertices on an attribute seam; collapses along the seam
+        // onto a Seam or Locked vertex, both halves together.
+        Seam,
+
+        // Anything more complex; never moves.
+        Locked
+    };
+
+    ///<summary>
+    /// Sum of weighted squared distances to a set of planes, w*(dot(n, p) + d)^2,
+    /// kept as the symmetric matrix A, vector b and scalar c of p'Ap + 2b'p + c.
+    ///</summary>
+    struct Quadric
+    {
+        float A00 = 0.0f, A11 = 0.0f, A22 = 0.0f;
+        float A01 = 0.0f, A02 = 0.0f, A12 = 0.0f;
+        float B0 = 0.0f, B1 = 0.0f, B2 = 0.0f;
+        float C = 0.0f;
+        float W = 0.0f;
+
+        Quadric() = default;
+
+        Quadric(const XMFLOAT3& n, float d, float w) :
+            A00(w*n.x*n.x), A11(w*n.y*n.y), A22(w*n.z*n.z),
+            A01(w*n.x*n.y), A02(w*n.x*n.z), A12(w*n.y*n.z),
+            B0(w*n.x*d), B1(w*n.y*d), B2(w*n.z*d),
+            C(w*d*d),
+            W(w)
+        {
+        }
+
+        Quadric& operator+=(const Quadric& q)
+        {
+            A00 += q.A00; A11 += q.A11; A22 += q.A22;
+            A01 += q.A01; A02 += q.A02; A12 += q.A12;
+            B0 += q.B0; B1 += q.B1; B2 += q.B2;
+            C += q.C;
+            W += q.W;
+            return *this;
+        }
+
+        float Evaluate(const XMFLOAT3& p)const
+        {
+            const float rx = A00*p.x + A01*p.y + A02*p.z + 2.0f*B0;
+            const float ry = A01*p.x + A11*p.y + A12*p.z + 2.0f*B1;
+            const float rz = A02*p.x + A12*p.y + A22*p.z + 2.0f*B2;
+            return fabsf(rx*p.x + ry*p.y + rz*p.z + C);
+        }
+    };
+
+    // Directed edges as sorted keys, for asking whether an edge has an opposite.
+    class EdgeSet
+    {
+    public:
+        void Reset(size_t capacity)
+        {
+            mKeys.clear();
+            mKeys.reserve(capacity);
+        }
+
+        void Add(UINT a, UINT b) { mKeys.push_back(Key(a, b)); }
+        void Finish() { std::sort(mKeys.begin(), mKeys.end()); }
+
+        bool Contains(UINT a, UINT b)const
+        {
+            return std::binary_search(mKeys.begin(), mKeys.end(), Key(a, b));
+        }
+
+    private:
+        static uint64_t Key(UINT a, UINT b) { return ((uint64_t)a << 32) | b; }
+
+        std::vector<uint64_t> mKeys;
+    };
+
+    struct Collapse
+    {
+        UINT U = 0;
+        UINT V = 0;
+        float Error = 0.0f;
+    };
+
+    float DistanceToTriangle(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c)
+    {
+        // Closest point by Voronoi region, from Ericson's Real-Time Collision Detection.
+        XMVECTOR ab = b - a;
+        XMVECTOR ac = c - a;
+        XMVECTOR ap = p - a;
+        const float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+        const float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+        if(d1 <= 0.0f && d2 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(ap));
+
+        XMVECTOR bp = p - b;
+        const float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+        const float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+        if(d3 >= 0.0f && d4 <= d3)
+            return XMVectorGetX(XMVector3Length(bp));
+
+        const float vc = d1*d4 - d3*d2;
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (a + ab*(d1 / (d1 - d3)))));
+
+        XMVECTOR cp = p - c;
+        const float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+        const float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+        if(d6 >= 0.0f && d5 <= d6)
+            return XMVectorGetX(XMVector3Length(cp));
+
+        const float vb = d5*d2 - d1*d6;
+        if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (a + ac*(d2 / (d2 - d6)))));
+
+        const float va = d3*d6 - d5*d4;
+        if(va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6))))));
+
+        const float denom = 1.0f / (va + vb + vc);
+        return XMVectorGetX(XMVector3Length(p - (a + ab*(vb*denom) + ac*(vc*denom))));
+    }
+
+    ///<summary>
+    /// Uniform grid over the triangles of a mesh for the distance from a point to its
+    /// surface.  Each cell lists the triangles whose bounds overlap it, and a query
+    /// visits rings of cells around the point until no closer triangle can be left.
+    ///</summary>
+    class SurfaceGrid
+    {
+    public:
+        void Build(const std::vector<XMFLOAT3>& positions, const uint32_t* indices, UINT indexCount)
+        {
+            mPositions = &positions;
+            mIndices = indices;
+
+            XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+            XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+            for(UINT i = 0; i < indexCount; ++i)
+            {
+                vMin = XMVectorMin(vMin, XMLoadFloat3(&positions[indices[i]]));
+                vMax = XMVectorMax(vMax, XMLoadFloat3(&positions[indices[i]]));
+            }
+
+            // About two cells per triangle count's cube root along the longest axis, so
+            // a surface cell holds a handful of triangles.
+            const UINT triangleCount = indexCount / 3;
+            XMFLOAT3 extent;
+            XMStoreFloat3(&mOrigin, vMin);
+            XMStoreFloat3(&extent, vMax - vMin);
+            const float maxExtent = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+            mCellSize = maxExtent / std::min(2.0f*cbrtf((float)std::max(triangleCount, 1u)), 128.0f);
+
+            const float extents[3] = { extent.x, extent.y, extent.z };
+            for(int k = 0; k < 3; ++k)
+                mDims[k] = std::max((int)ceilf(extents[k] / mCellSize), 1);
+
+            // A sphere around each triangle, to skip it without the exact distance.
+            mTriangleSpheres.resize(triangleCount);
+            for(UINT t = 0; t < triangleCount; ++t)
+            {
+                const XMVECTOR a = XMLoadFloat3(&positions[indices[t*3 + 0]]);
+                const XMVECTOR b = XMLoadFloat3(&positions[indices[t*3 + 1]]);
+                const XMVECTOR c = XMLoadFloat3(&positions[indices[t*3 + 2]]);
+                const XMVECTOR center = 0.5f*(XMVectorMin(XMVectorMin(a, b), c) + XMVectorMax(XMVectorMax(a, b), c));
+                const float radius = sqrtf(std::max(std::max(
+                    XMVectorGetX(XMVector3LengthSq(a - center)),
+                    XMVectorGetX(XMVector3LengthSq(b - center))),
+                    XMVectorGetX(XMVector3LengthSq(c - center))));
+                XMStoreFloat4(&mTriangleSpheres[t], XMVectorSetW(center, radius));
+            }
+
+            // Triangles per cell as a prefix sum over the cells.
+            const size_t cellCount = (size_t)mDims[0]*mDims[1]*mDims[2];
+            mCellOffsets.assign(cellCount + 1, 0);
+            for(int pass = 0; pass < 2; ++pass)
+            {
+                for(UINT t = 0; t < triangleCount; ++t)
+                {
+                    int lo[3], hi[3];
+                    TriangleCells(t, lo, hi);
+                    for(int z = lo[2]; z <= hi[2]; ++z)
+                        for(int y = lo[1]; y <= hi[1]; ++y)
+                            for(int x = lo[0]; x <= hi[0]; ++x)
+                            {
+                                const size_t cell = CellIndex(x, y, z);
+                                if(pass == 0)
+                                    mCellOffsets[cell + 1]++;
+                                else
+                                    mCellTriangles[mCellOffsets[cell] + mCellFill[cell]++] = t;
+                            }
+                }
+
+                if(pass == 0)
+                {
+                    for(size_t cell = 0; cell < cellCount; ++cell)
+                        mCellOffsets[cell + 1] += mCellOffsets[cell];
+                    mCellTriangles.resize(mCellOffsets[cellCount]);
+                    mCellFill.assign(cellCount, 0);
+                }
+            }
+        }
+
+        float Distance(const XMFLOAT3& point)const
+        {
+            int c[3];
+            PointCell(point, c);
+
+            const XMVECTOR p = XMLoadFloat3(&point);
+            const float coords[3] = { point.x - mOrigin.x, point.y - mOrigin.y, point.z - mOrigin.z };
+
+            float nearest = MathHelper::Infinity;
+            for(int ring = 0; ; ++ring)
+            {
+                int lo[3], hi[3];
+                for(int k = 0; k < 3; ++k)
+                {
+                    lo[k] = std::max(c[k] - ring, 0);
+                    hi[k] = std::min(c[k] + ring, mDims[k] - 1);
+                }
+
+                for(int z = lo[2]; z <= hi[2]; ++z)
+                    for(int y = lo[1]; y <= hi[1]; ++y)
+                        for(int x = lo[0]; x <= hi[0]; ++x)
+                        {
+                            // Only the cells new to this ring, and only if they can be
+                            // nearer than the nearest triangle so far.
+                            const int cell[3] = { x, y, z };
+                            if(std::max(std::max(abs(x - c[0]), abs(y - c[1])), abs(z - c[2])) != ring)
+                                continue;
+                            if(DistanceToCells(coords, cell, cell) >= nearest)
+                                continue;
+
+                            const size_t index = CellIndex(x, y, z);
+                            for(UINT k = mCellOffsets[index]; k < mCellOffsets[index + 1]; ++k)
+                            {
+                                const UINT t = mCellTriangles[k];
+                                const XMFLOAT4& sphere = mTriangleSpheres[t];
+                                const float dx = point.x - sphere.x;
+                                const float dy = point.y - sphere.y;
+                                const float dz = point.z - sphere.z;
+                                if(sqrtf(dx*dx + dy*dy + dz*dz) - sphere.w >= nearest)
+                                    continue;
+
+                                const uint32_t* tri = mIndices + (size_t)t*3;
+                                nearest = std::min(nearest, DistanceToTriangle(p,
+                                    XMLoadFloat3(&(*mPositions)[tri[0]]),
+                                    XMLoadFloat3(&(*mPositions)[tri[1]]),
+                                    XMLoadFloat3(&(*mPositions)[tri[2]])));
+                            }
+                        }
+
+                // Every cell not visited yet lies outside the box of cells visited.
+                if(lo[0] == 0 && lo[1] == 0 && lo[2] == 0 &&
+                   hi[0] == mDims[0] - 1 && hi[1] == mDims[1] - 1 && hi[2] == mDims[2] - 1)
+                    break;
+                if(nearest <= DistanceOutside(coords, lo, hi))
+                    break;
+            }
+
+            return nearest;
+        }
+
+    private:
+        void PointCell(const XMFLOAT3& p, int c[3])const
+        {
+            const float coords[3] = { p.x - mOrigin.x, p.y - mOrigin.y, p.z - mOrigin.z };
+            for(int k = 0; k < 3; ++k)
+                c[k] = std::min(std::max((int)floorf(coords[k] / mCellSize), 0), mDims[k] - 1);
+        }
+
+        void TriangleCells(UINT t, int lo[3], int hi[3])const
+        {
+            const uint32_t* tri = mIndices + (size_t)t*3;
+            const XMFLOAT3& a = (*mPositions)[tri[0]];
+            const XMFLOAT3& b = (*mPositions)[tri[1]];
+            const XMFLOAT3& c = (*mPositions)[tri[2]];
+
+            PointCell(XMFLOAT3(std::min(std::min(a.x, b.x), c.x), std::min(std::min(a.y, b.y), c.y), std::min(std::min(a.z, b.z), c.z)), lo);
+            PointCell(XMFLOAT3(std::max(std::max(a.x, b.x), c.x), std::max(std::max(a.y, b.y), c.y), std::max(std::max(a.z, b.z), c.z)), hi);
+        }
+
+        // Distance from a point, relative to the origin, to the box of cells lo..hi.
+        float DistanceToCells(const float coords[3], const int lo[3], const int hi[3])const
+        {
+            float distanceSq = 0.0f;
+            for(int k = 0; k < 3; ++k)
+            {
+                const float d = std::max(std::max(lo[k]*mCellSize - coords[k], coords[k] - (hi[k] + 1)*mCellSize), 0.0f);
+                distanceSq += d*d;
+            }
+            return sqrtf(distanceSq);
+        }
+
+        // Distance from a point inside the box of cells lo..hi to the cells outside it.
+        // Sides of the box on the edge of the grid have no cells beyond them.
+        float DistanceOutside(const float coords[3], const int lo[3], const int hi[3])const
+        {
+            float distance = MathHelper::Infinity;
+            for(int k = 0; k < 3; ++k)
+            {
+                if(lo[k] > 0)
+                    distance = std::min(distance, coords[k] - lo[k]*mCellSize);
+                if(hi[k] < mDims[k] - 1)
+                    distance = std::min(distance, (hi[k] + 1)*mCellSize - coords[k]);
+            }
+            return std::max(distance, 0.0f);
+        }
+
+        size_t CellIndex(int x, int y, int z)const
+        {
+            return ((size_t)z*mDims[1] + y)*mDims[0] + x;
+        }
+
+        const std::vector<XMFLOAT3>* mPositions = nullptr;
+        const uint32_t* mIndices = nullptr;
+
+        XMFLOAT3 mOrigin = { 0.0f, 0.0f, 0.0f };
+        float mCellSize = 1.0f;
+        int mDims[3] = { 1, 1, 1 };
+
+        std::vector<UINT> mCellOffsets;
+        std::vector<UINT> mCellFill;
+        std::vector<UINT> mCellTriangles;
+        std::vector<XMFLOAT4> mTriangleSpheres;
+    };
+
+    // Largest distance between two surfaces over the same vertices: from the vertices
+    // of the source to the level, and from the centers of the level's triangles back
+    // to the source.  The level's vertices lie on the source, so this catches both
+    // detail the level cuts off and level triangles that bulge out of the source.
+    float MeasureLodError(const std::vector<XMFLOAT3>& positions, const SurfaceGrid& sourceGrid,
+                          const uint32_t* sourceIndices, UINT sourceIndexCount,
+                          const uint32_t* lodIndices, UINT lodIndexCount)
+    {
+        SurfaceGrid lodGrid;
+        lodGrid.Build(positions, lodIndices, lodIndexCount);
+
+        std::vector<bool> visited(positions.size(), false);
+        float error = 0.0f;
+        for(UINT i = 0; i < sourceIndexCount; ++i)
+        {
+            const uint32_t v = sourceIndices[i];
+            if(visited[v])
+                continue;
+            visited[v] = true;
+            error = std::max(error, lodGrid.Distance(positions[v]));
+        }
+
+        for(UINT i = 0; i < lodIndexCount; i += 3)
+        {
+            XMFLOAT3 center;
+            XMStoreFloat3(&center, (XMLoadFloat3(&positions[lodIndices[i]]) +
+                                    XMLoadFloat3(&positions[lodIndices[i + 1]]) +
+                                    XMLoadFloat3(&positions[lodIndices[i + 2]])) / 3.0f);
+            error = std::max(error, sourceGrid.Distance(center));
+        }
+
+        return error;
+    }
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const void* vertices, UINT vertexCount, UINT vertexStride, const MeshSimplifierSettings& settings) :
+            mVertexCount(vertexCount),
+            mSettings(settings)
+        {
+            LoadPositions(static_cast<const BYTE*>(vertices), vertexStride);
+            WeldPositions();
+        }
+
+        UINT Run(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT targetIndexCount,
+                 float maxError, float* resultError);
+
+    private:
+        void LoadPositions(const BYTE* vertices, UINT vertexStride);
+        void WeldPositions();
+        void BuildEdges();
+        void BuildAdjacency();
+        void ClassifyVertices();
+        void ComputeQuadrics();
+
+        bool CanCollapse(UINT u, UINT v)const;
+        bool FindSeamPartner(UINT u, UINT pv, UINT& partner)const;
+        bool FlipsTriangle(UINT pu, UINT pv)const;
+        UINT TrianglesRemoved(UINT pu, UINT pv)const;
+
+        UINT mVertexCount = 0;
+        MeshSimplifierSettings mSettings;
+
+        // Positions scaled into the unit cube, so errors do not depend on the mesh size.
+        std::vector<XMFLOAT3> mPositions;
+        float mScale = 1.0f;
+
+        // First vertex with the same position, and the next one in a cycle through them.
+        std::vector<UINT> mRemap;
+        std::vector<UINT> mWedge;
+
+        std::vector<VertexKind> mKinds;
+        std::vector<Quadric> mQuadrics;
+
+        std::vector<uint32_t> mIndices;
+        EdgeSet mWedgeEdges;
+        EdgeSet mPositionEdges;
+
+        // Triangles around each vertex.
+        std::vector<UINT> mTriangleOffsets;
+        std::vector<UINT> mTriangles;
+
+        // This pass's collapses.
+        std::vector<UINT> mCollapseRemap;
+        std::vector<bool> mCollapseLocked;
+    };
+
+    void Simplifier::LoadPositions(const BYTE* vertices, UINT vertexStride)
+    {
+        mPositions.resize(mVertexCount);
+        XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+        XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+        for(UINT v = 0; v < mVertexCount; ++v)
+        {
+            memcpy(&mPositions[v], vertices + (size_t)v*vertexStride + mSettings.PositionOffset, sizeof(XMFLOAT3));
+            XMVECTOR p = XMLoadFloat3(&mPositions[v]);
+            vMin = XMVectorMin(vMin, p);
+            vMax = XMVectorMax(vMax, p);
+        }
+
+        if(mVertexCount == 0)
+            return;
+
+        XMFLOAT3 extent;
+        XMStoreFloat3(&extent, vMax - vMin);
+        mScale = std::max(std::max(extent.x, extent.y), extent.z);
+        if(mScale <= 0.0f)
+            mScale = 1.0f;
+
+        const float invScale = 1.0f / mScale;
+        for(XMFLOAT3& p : mPositions)
+            XMStoreFloat3(&p, (XMLoadFloat3(&p) - vMin)*invScale);
+    }
+
+    void Simplifier::WeldPositions()
+    {
+        // Sort by position so vertices that share one are adjacent.
+        std::vector<UINT> order(mVertexCount);
+        for(UINT v = 0; v < mVertexCount; ++v)
+            order[v] = v;
+
+        std::sort(order.begin(), order.end(), [this](UINT a, UINT b)
+        {
+            const XMFLOAT3& pa = mPositions[a];
+            const XMFLOAT3& pb = mPositions[b];
+            if(pa.x != pb.x) return pa.x < pb.x;
+            if(pa.y != pb.y) return pa.y < pb.y;
+            if(pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        });
+
+        mRemap.resize(mVertexCount);
+        mWedge.resize(mVertexCount);
+        for(UINT i = 0; i < mVertexCount;)
+        {
+            UINT end = i + 1;
+            while(end < mVertexCount &&
+                  memcmp(&mPositions[order[end]], &mPositions[order[i]], sizeof(XMFLOAT3)) == 0)
+            {
+                ++end;
+            }
+
+            for(UINT k = i; k < end; ++k)
+            {
+                mRemap[order[k]] = order[i];
+                mWedge[order[k]] = order[k + 1 < end ? k + 1 : i];
+            }
+
+            i = end;
+        }
+    }
+
+    void Simplifier::BuildEdges()
+    {
+        mWedgeEdges.Reset(mIndices.size());
+        mPositionEdges.Reset(mIndices.size());
+        for(size_t i = 0; i < mIndices.size(); i += 3)
+        {
+            for(UINT k = 0; k < 3; ++k)
+            {
+                const UINT a = mIndices[i + k];
+                const UINT b = mIndices[i + (k + 1) % 3];
+                mWedgeEdges.Add(a, b);
+                mPositionEdges.Add(mRemap[a], mRemap[b]);
+            }
+        }
+
+        mWedgeEdges.Finish();
+        mPositionEdges.Finish();
+    }
+
+    void Simplifier::BuildAdjacency()
+    {
+        mTriangleOffsets.assign(mVertexCount + 1, 0);
+        for(uint32_t v : mIndices)
+            mTriangleOffsets[v + 1]++;
+
+        for(UINT v = 0; v < mVertexCount; ++v)
+            mTriangleOffsets[v + 1] += mTriangleOffsets[v];
+
+        std::vector<UINT> cursor(mTriangleOffsets.begin(), mTriangleOffsets.end() - 1);
+        mTriangles.resize(mIndices.size());
+        for(size_t i = 0; i < mIndices.size(); ++i)
+            mTriangles[cursor[mIndices[i]]++] = (UINT)(i / 3);
+    }
+
+    void Simplifier::ClassifyVertices()
+    {
+        // Open edges: without an opposite in position space the edge is on a boundary,
+        // with one only in position space it is on a seam.
+        std::vector<UINT> borderEdges(mVertexCount, 0);
+        std::vector<UINT> seamOut(mVertexCount, 0);
+        std::vector<UINT> seamIn(mVertexCount, 0);
+        for(size_t i = 0; i < mIndices.size(); i += 3)
+        {
+            for(UINT k = 0; k < 3; ++k)
+            {
+                const UINT a = mIndices[i + k];
+                const UINT b = mIndices[i + (k + 1) % 3];
+                if(!mPositionEdges.Contains(mRemap[b], mRemap[a]))
+                {
+                    borderEdges[mRemap[a]]++;
+                    borderEdges[mRemap[b]]++;
+                }
+                else if(!mWedgeEdges.Contains(b, a))
+                {
+                    seamOut[a]++;
+                    seamIn[b]++;
+                }
+            }
+        }
+
+        mKinds.assign(mVertexCount, VertexKind::Locked);
+        for(UINT v = 0; v < mVertexCount; ++v)
+        {
+            if(mRemap[v] != v)
+                continue;
+
+            const UINT w = mWedge[v];
+            const bool noSeam = seamOut[v] == 0 && seamIn[v] == 0;
+
+            VertexKind kind = VertexKind::Locked;
+            if(w == v && noSeam)
+            {
+                if(borderEdges[v] == 0)
+                    kind = VertexKind::Manifold;
+                else if(borderEdges[v] == 2)
+                    kind = VertexKind::Border;
+            }
+            else if(w != v && mWedge[w] == v && borderEdges[v] == 0 &&
+                    seamOut[v] == 1 && seamIn[v] == 1 && seamOut[w] == 1 && seamIn[w] == 1)
+            {
+                kind = VertexKind::Seam;
+            }
+
+            mKinds[v] = kind;
+        }
+    }
+
+    void Simplifier::ComputeQuadrics()
+    {
+        mQuadrics.assign(mVertexCount, Quadric());
+        for(size_t i = 0; i < mIndices.size(); i += 3)
+        {
+            const UINT v[3] = { mIndices[i], mIndices[i + 1], mIndices[i + 2] };
+            XMVECTOR p[3];
+            for(UINT k = 0; k < 3; ++k)
+                p[k] = XMLoadFloat3(&mPositions[v[k]]);
+
+            XMVECTOR n = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+            const float length = XMVectorGetX(XMVector3Length(n));
+            if(length <= 0.0f)
+                continue;
+
+            n /= length;
+            XMFLOAT3 normal;
+            XMStoreFloat3(&normal, n);
+
+            // Weighted by area, so small triangles do not hold large ones in place.
+            Quadric plane(normal, -XMVectorGetX(XMVector3Dot(n, p[0])), 0.5f*length);
+            for(UINT k = 0; k < 3; ++k)
+                mQuadrics[mRemap[v[k]]] += plane;
+
+            // Planes through open edges, perpendicular to the triangle, keep
+            // boundaries and seams from moving inward.
+            for(UINT k = 0; k < 3; ++k)
+            {
+                const UINT a = v[k];
+                const UINT b = v[(k + 1) % 3];
+                if(mPositionEdges.Contains(mRemap[b], mRemap[a]) && mWedgeEdges.Contains(b, a))
+                    continue;
+
+                XMVECTOR edge = p[(k + 1) % 3] - p[k];
+                XMVECTOR edgeNormal = XMVector3Normalize(XMVector3Cross(edge, n));
+                XMFLOAT3 en;
+                XMStoreFloat3(&en, edgeNormal);
+
+                const float edgeLengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+                Quadric edgePlane(en, -XMVectorGetX(XMVector3Dot(edgeNormal, p[k])), edgeLengthSq*mSettings.BorderWeight);
+                mQuadrics[mRemap[a]] += edgePlane;
+                mQuadrics[mRemap[b]] += edgePlane;
+            }
+        }
+    }
+
+    bool Simplifier::CanCollapse(UINT u, UINT v)const
+    {
+        const UINT pu = mRemap[u];
+        const UINT pv = mRemap[v];
+        const VertexKind kv = mKinds[pv];
+
+        switch(mKinds[pu])
+        {
+        case VertexKind::Manifold:
+            return true;
+
+        case VertexKind::Border:
+            return (kv == VertexKind::Border || kv == VertexKind::Locked) &&
+                   (!mPositionEdges.Contains(pu, pv) || !mPositionEdges.Contains(pv, pu));
+
+        case VertexKind::Seam:
+            return (kv == VertexKind::Seam || kv == VertexKind::Locked) &&
+                   mPositionEdges.Contains(pu, pv) && mPositionEdges.Contains(pv, pu) &&
+                   (!mWedgeEdges.Contains(u, v) || !mWedgeEdges.Contains(v, u));
+
+        default:
+            return false;
+        }
+    }
+
+    // The vertex at position pv that shares a triangle with seam vertex u, which its
+    // half of the seam collapses onto.
+    bool Simplifier::FindSeamPartner(UINT u, UINT pv, UINT& partner)const
+    {
+        for(UINT t = mTriangleOffsets[u]; t < mTriangleOffsets[u + 1]; ++t)
+        {
+            const UINT tri = mTriangles[t];
+            for(UINT k = 0; k < 3; ++k)
+            {
+                const UINT v = mIndices[tri*3 + k];
+                if(mRemap[v] == pv)
+                {
+                    partner = v;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool Simplifier::FlipsTriangle(UINT pu, UINT pv)const
+    {
+        const XMVECTOR target = XMLoadFloat3(&mPositions[pv]);
+
+        UINT u = pu;
+        do
+        {
+            for(UINT t = mTriangleOffsets[u]; t < mTriangleOffsets[u + 1]; ++t)
+            {
+                const UINT tri = mTriangles[t];
+
+                // Corners as moved by this pass's collapses so far.
+                UINT corner[3];
+                for(UINT k = 0; k < 3; ++k)
+                    corner[k] = mRemap[mCollapseRemap[mIndices[tri*3 + k]]];
+
+                if(corner[0] == corner[1] || corner[1] == corner[2] || corner[0] == corner[2])
+                    continue;
+                if(corner[0] == pv || corner[1] == pv || corner[2] == pv)
+                    continue;
+
+                const UINT k = corner[0] == pu ? 0 : (corner[1] == pu ? 1 : 2);
+                const XMVECTOR p0 = XMLoadFloat3(&mPositions[corner[k]]);
+                const XMVECTOR p1 = XMLoadFloat3(&mPositions[corner[(k + 1) % 3]]);
+                const XMVECTOR p2 = XMLoadFloat3(&mPositions[corner[(k + 2) % 3]]);
+
+                const XMVECTOR before = XMVector3Cross(p1 - p0, p2 - p0);
+                const XMVECTOR after = XMVector3Cross(p1 - target, p2 - target);
+
+                // Rejects turns of more than about 75 degrees, not only full flips.
+                const float d = XMVectorGetX(XMVector3Dot(before, after));
+                const float lengths = XMVectorGetX(XMVector3Length(before)*XMVector3Length(after));
+                if(d <= 0.25f*lengths)
+                    return true;
+            }
+
+            u = mWedge[u];
+        } while(u != pu);
+
+        return false;
+    }
+
+    UINT Simplifier::TrianglesRemoved(UINT pu, UINT pv)const
+    {
+        UINT removed = 0;
+
+        UINT u = pu;
+        do
+        {
+            for(UINT t = mTriangleOffsets[u]; t < mTriangleOffsets[u + 1]; ++t)
+            {
+                const UINT tri = mTriangles[t];
+                for(UINT k = 0; k < 3; ++k)
+                {
+                    if(mRemap[mCollapseRemap[mIndices[tri*3 + k]]] == pv)
+                    {
+                        removed++;
+                        break;
+                    }
+                }
+            }
+
+            u = mWedge[u];
+        } while(u != pu);
+
+        return removed;
+    }
+
+    UINT Simplifier::Run(uint32_t* dst, const uint32_t* indices, UINT indexCount, UINT targetIndexCount,
+                         float maxError, float* resultError)
+    {
+        mIndices.assign(indices, indices + indexCount);
+
+        BuildEdges();
+        ClassifyVertices();
+        ComputeQuadrics();
+
+        // Errors are squared distances in the unit cube.
+        const float maxErrorSq = std::max(maxError, 0.0f)*std::max(maxError, 0.0f) / (mScale*mScale);
+        float resultErrorSq = 0.0f;
+
+        std::vector<Collapse> collapses;
+        mCollapseRemap.resize(mVertexCount);
+
+        while(mIndices.size() > targetIndexCount)
+        {
+            BuildAdjacency();
+
+            // Each edge once, in the cheaper direction it can collapse in.
+            collapses.clear();
+            for(size_t i = 0; i < mIndices.size(); i += 3)
+            {
+                for(UINT k = 0; k < 3; ++k)
+                {
+                    const UINT a = mIndices[i + k];
+                    const UINT b = mIndices[i + (k + 1) % 3];
+                    const UINT pa = mRemap[a];
+                    const UINT pb = mRemap[b];
+                    if(pa == pb || (pa > pb && mPositionEdges.Contains(pb, pa)))
+                        continue;
+
+                    Quadric q = mQuadrics[pa];
+                    q += mQuadrics[pb];
+
+                    Collapse collapse;
+                    collapse.Error = FLT_MAX;
+                    if(CanCollapse(a, b))
+                        collapse = { a, b, q.Evaluate(mPositions[pb]) / q.W };
+                    if(CanCollapse(b, a))
+                    {
+                        const float error = q.Evaluate(mPositions[pa]) / q.W;
+                        if(error < collapse.Error)
+                            collapse = { b, a, error };
+                    }
+
+                    if(collapse.Error < FLT_MAX)
+                        collapses.push_back(collapse);
+                }
+            }
+
+            if(collapses.empty())
+                break;
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+            {
+                return x.Error < y.Error;
+            });
+
+            // A collapse removes about two triangles.  Stop the pass a little past the
+            // error of the collapses it needs, so one pass does not take expensive
+            // collapses that cheaper ones uncovered by the next pass would have beaten.
+            const UINT trianglesToRemove = (UINT)(mIndices.size() - targetIndexCount + 2) / 3;
+            const size_t goal = std::min(collapses.size() - 1, (size_t)trianglesToRemove / 2);
+            const float passErrorLimit = std::max(collapses[goal].Error*1.5f, 1e-12f);
+
+            for(UINT v = 0; v < mVertexCount; ++v)
+                mCollapseRemap[v] = v;
+            mCollapseLocked.assign(mVertexCount, false);
+
+            UINT trianglesRemoved = 0;
+            UINT collapseCount = 0;
+            for(const Collapse& collapse : collapses)
+            {
+                if(trianglesRemoved >= trianglesToRemove || collapse.Error > passErrorLimit || collapse.Error > maxErrorSq)
+                    break;
+
+                const UINT pu = mRemap[collapse.U];
+                const UINT pv = mRemap[collapse.V];
+                if(mCollapseLocked[pu] || mCollapseLocked[pv])
+                    continue;
+
+                // Both halves of a seam move together, each onto the vertex at the
+                // target position it shares a triangle with.
+                UINT seamU = collapse.U;
+                UINT seamV = collapse.V;
+                if(mKinds[pu] == VertexKind::Seam)
+                {
+                    seamU = mWedge[collapse.U];
+                    if(!FindSeamPartner(seamU, pv, seamV))
+                        continue;
+                }
+
+                if(FlipsTriangle(pu, pv))
+                    continue;
+
+                trianglesRemoved += TrianglesRemoved(pu, pv);
+
+                mCollapseRemap[collapse.U] = collapse.V;
+                mCollapseRemap[seamU] = seamV;
+                mQuadrics[pv] += mQuadrics[pu];
+                mCollapseLocked[pu] = true;
+                mCollapseLocked[pv] = true;
+
+                resultErrorSq = std::max(resultErrorSq, collapse.Error);
+                collapseCount++;
+            }
+
+            if(collapseCount == 0)
+                break;
+
+            // Apply the collapses and drop the triangles they made degenerate.
+            size_t write = 0;
+            for(size_t i = 0; i < mIndices.size(); i += 3)
+            {
+                const UINT a = mCollapseRemap[mIndices[i]];
+                const UINT b = mCollapseRemap[mIndices[i + 1]];
+                const UINT c = mCollapseRemap[mIndices[i + 2]];
+                if(a == b || b == c || a == c)
+                    continue;
+
+                mIndices[write++] = a;
+                mIndices[write++] = b;
+                mIndices[write++] = c;
+            }
+            mIndices.resize(write);
+
+            BuildEdges();
+        }
+
+        if(resultError != nullptr)
+            *resultError = sqrtf(resultErrorSq)*mScale;
+
+        std::copy(mIndices.begin(), mIndices.end(), dst);
+        return (UINT)mIndices.size();
+    }
+}
+
+UINT MeshSimplifier::Simplify(uint32_t* dst, const uint32_t* indices, UINT indexCount,
+                              const void* vertices, UINT vertexCount, UINT vertexStride,
+                              UINT targetIndexCount, float maxError, float* resultError,
+                              const MeshSimplifierSettings& settings)
+{
+    Simplifier simplifier(vertices, vertexCount, vertexStride, settings);
+    return simplifier.Run(dst, indices, indexCount, targetIndexCount, maxError, resultError);
+}
+
+std::string MeshSimplifier::LodName(const std::string& drawArgName, UINT level)
+{
+    return level == 0 ? drawArgName : drawArgName + "_lod" + std::to_string(level);
+}
+
+UINT MeshSimplifier::GenerateLods(MeshGeometry& geo, const std::string& drawArgName, UINT lodCount,
+                                  const MeshSimplifierSettings& settings)
+{
+    auto it = geo.DrawArgs.find(drawArgName);
+    if(it == geo.DrawArgs.end())
+        return 0;
+
+    // A copy, as adding entries may rehash the map.
+    const SubmeshGeometry source = it->second;
+
+    const bool index16 = geo.IndexFormat == DXGI_FORMAT_R16_UINT;
+    const UINT indexSize = index16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    std::vector<uint32_t> lod(source.IndexCount);
+    for(UINT i = 0; i < source.IndexCount; ++i)
+    {
+        const UINT k = source.StartIndexLocation + i;
+        lod[i] = index16 ?
+            reinterpret_cast<const uint16_t*>(geo.IndexBufferCPU.data())[k] :
+            reinterpret_cast<const uint32_t*>(geo.IndexBufferCPU.data())[k];
+    }
+
+    // Indices are relative to the base vertex.
+    UINT vertexCount = 0;
+    for(uint32_t index : lod)
+        vertexCount = std::max(vertexCount, index + 1);
+
+    const BYTE* vertices = geo.VertexBufferCPU.data() + (size_t)source.BaseVertexLocation*geo.VertexByteStride;
+
+    std::vector<XMFLOAT3> positions(vertexCount);
+    XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+    XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+    for(UINT v = 0; v < vertexCount; ++v)
+    {
+        memcpy(&positions[v], vertices + (size_t)v*geo.VertexByteStride + settings.PositionOffset, sizeof(XMFLOAT3));
+        vMin = XMVectorMin(vMin, XMLoadFloat3(&positions[v]));
+        vMax = XMVectorMax(vMax, XMLoadFloat3(&positions[v]));
+    }
+
+    XMFLOAT3 extent;
+    XMStoreFloat3(&extent, vMax - vMin);
+    const float maxError = settings.MaxLodError*std::max(std::max(extent.x, extent.y), extent.z);
+
+    // Levels are measured against the source, not the level they were simplified from.
+    const std::vector<uint32_t> sourceIndices = lod;
+    SurfaceGrid sourceGrid;
+    sourceGrid.Build(positions, sourceIndices.data(), source.IndexCount);
+
+    float error = source.LodError;
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> ordered;
+
+    UINT level = 1;
+    for(; level <= lodCount; ++level)
+    {
+        const UINT target = (UINT)((lod.size() / 3)*settings.LodReduction)*3;
+
+        // The quadric error of the collapses underestimates how far the surface moves,
+        // so it only limits the simplification; the level's error is measured below.
+        next.resize(lod.size());
+        const UINT count = MeshSimplifier::Simplify(next.data(), lod.data(), (UINT)lod.size(),
+                                                    vertices, vertexCount, geo.VertexByteStride,
+                                                    target, maxError - error, nullptr, settings);
+
+        // Not worth a level unless it drops at least a quarter of the triangles.
+        if(count == 0 || (size_t)count*4 > lod.size()*3)
+            break;
+
+        next.resize(count);
+
+        const float levelError = MeasureLodError(positions, sourceGrid, sourceIndices.data(), source.IndexCount,
+                                                 next.data(), count);
+        if(levelError > maxError)
+            break;
+
+        // Coarser levels never claim less error than finer ones.
+        error = std::max(error, levelError);
+
+        if(settings.OptimizeVertexCache)
+        {
+            ordered.resize(count);
+            MeshOptimizer::OptimizeVertexCacheTipsify(ordered.data(), next.data(), count, vertexCount,
+                                                      MeshOptimizerSettings().CacheSize);
+            next.swap(ordered);
+        }
+
+        SubmeshGeometry submesh = source;
+        submesh.IndexCount = count;
+        submesh.StartIndexLocation = (UINT)(geo.IndexBufferCPU.size() / indexSize);
+        submesh.LodError = error;
+
+        geo.IndexBufferCPU.resize(geo.IndexBufferCPU.size() + (size_t)count*indexSize);
+        BYTE* dst = geo.IndexBufferCPU.data() + (size_t)submesh.StartIndexLocation*indexSize;
+        for(UINT i = 0; i < count; ++i)
+        {
+            if(index16)
+                reinterpret_cast<uint16_t*>(dst)[i] = (uint16_t)next[i];
+            else
+                reinterpret_cast<uint32_t*>(dst)[i] = next[i];
+        }
+        geo.IndexBufferByteSize = (UINT)geo.IndexBufferCPU.size();
+
+        geo.DrawArgs[LodName(drawArgName, level)] = submesh;
+
+        lod.swap(next);
+    }
+
+    return level - 1;
+}
+
+float MeshSimplifier::ErrorToPixels(const BoundingBox& bounds, FXMMATRIX world, const Camera& camera, float viewportHeight)
+{
+    // The largest scale of the world transform, which scales the error at most by it.
+    const float scale = sqrtf(std::max(std::max(
+        XMVectorGetX(XMVector3LengthSq(world.r[0])),
+        XMVectorGetX(XMVector3LengthSq(world.r[1]))),
+        XMVectorGetX(XMVector3LengthSq(world.r[2]))));
+
+    XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&bounds.Center), world);
+    const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)))*scale;
+
+    float distance = XMVectorGetX(XMVector3Length(center - camera.GetPosition())) - radius;
+    distance = std::max(distance, camera.GetNearZ());
+
+    // A unit at that distance covers 1/(2 distance tan(fovY/2)) of the viewport height.
+    return scale*viewportHeight / (2.0f*distance*tanf(0.5f*camera.GetFovY()));
+}
+
+UINT MeshSimplifier::SelectLod(const std::vector<const SubmeshGeometry*>& lods, float errorToPixels, float maxPixelError)
+{
+    for(UINT level = (UINT)lods.size(); level-- > 1;)
+    {
+        if(lods[level]->LodError*errorToPixels <= maxPixelError)
+            return level;
+    }
+
+    return 0;
+}
+
+UINT MeshSimplifier::SelectLod(const std::vector<const SubmeshGeometry*>& lods, FXMMATRIX world,
+                               const Camera& camera, float viewportHeight, float maxPixelError)
+{
+    if(lods.empty())
+        return 0;
+
+    return SelectLod(lods, ErrorToPixels(lods[0]->Bounds, world, camera, viewportHeight), maxPixelError);
+}
@@ -0,0 +1,85 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error metric simplification (Garland and Heckbert 1997) for discrete levels
+// of detail.  Edges are collapsed onto one of their vertices, cheapest first, so every
+// level reuses the vertex buffer of the source and only adds indices.  Each vertex
+// accumulates the planes of the triangles around it, and the cost of moving it onto a
+// neighbor is the squared distance of the neighbor to those planes.
+//
+// Open boundaries and attribute seams (vertices split for a UV or hard edge) only
+// collapse along themselves and get extra planes through their edges, so holes do not
+// grow and seams do not tear.  Collapses that would flip a triangle are skipped.
+//
+// GenerateLods appends the levels of a DrawArgs entry to a MeshGeometry as further
+// DrawArgs entries, each with its geometric error.  SelectLod picks the coarsest level
+// whose error projects to fewer than a given number of pixels on screen.
+//
+// The quadric distance of a collapse averages over the planes around a vertex, and
+// the largest distance between a level and the source is typically two to four times
+// it.  So the error of a level is measured instead: the largest distance from the
+// source's vertices to the level's surface and from the centers of the level's
+// triangles to the source's surface.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class Camera;
+
+struct MeshSimplifierSettings
+{
+    // Byte offset of the float3 position in a vertex.
+    UINT PositionOffset = 0;
+
+    // Weight of the planes that hold open boundaries and seams in place, relative to
+    // the triangle planes.
+    float BorderWeight = 10.0f;
+
+    // Each level of detail keeps this fraction of the triangles of the one before it.
+    float LodReduction = 0.5f;
+
+    // Levels are not generated past this error, as a fraction of the mesh's extent.
+    float MaxLodError = 0.05f;
+
+    // Reorder each level for the vertex cache.
+    bool OptimizeVertexCache = true;
+};
+
+namespace MeshSimplifier
+{
+    // Simplifies an indexed triangle list to at most targetIndexCount indices, or as
+    // close as it gets without an error above maxError (in position units).  Writes
+    // the indices to dst, which must hold indexCount indices and may alias indices,
+    // and returns how many were written.  If resultError is not null it receives the
+    // largest error of any collapse, in position units.
+    UINT Simplify(uint32_t* dst, const uint32_t* indices, UINT indexCount,
+                  const void* vertices, UINT vertexCount, UINT vertexStride,
+                  UINT targetIndexCount, float maxError, float* resultError = nullptr,
+                  const MeshSimplifierSettings& settings = MeshSimplifierSettings());
+
+    // DrawArgs name of a level of detail; level 0 is the source itself.
+    std::string LodName(const std::string& drawArgName, UINT level);
+
+    // Simplifies geo.DrawArgs[drawArgName] into up to lodCount levels, each from the
+    // one before, and appends them to the CPU index buffer as the DrawArgs entries
+    // LodName(drawArgName, 1..lodCount), with their measured error as LodError.  Stops
+    // early once a level would exceed MaxLodError or no longer shrinks.  The GPU index
+    // buffer is not touched; upload IndexBufferCPU afterward.  Returns the number of
+    // levels added.
+    UINT GenerateLods(MeshGeometry& geo, const std::string& drawArgName, UINT lodCount,
+                      const MeshSimplifierSettings& settings = MeshSimplifierSettings());
+
+    // Pixels covered by one unit of object space error of geometry with the given
+    // bounds and world transform, on a viewport viewportHeight pixels tall.  Taken at
+    // the point of the bounds' sphere nearest the camera, so it does not underestimate.
+    float ErrorToPixels(const DirectX::BoundingBox& bounds, DirectX::FXMMATRIX world,
+                        const Camera& camera, float viewportHeight);
+
+    // The coarsest of lods (finest first) whose LodError projects to at most
+    // maxPixelError pixels.  Returns 0 if lods is empty.
+    UINT SelectLod(const std::vector<const SubmeshGeometry*>& lods, float errorToPixels, float maxPixelError);
+    UINT SelectLod(const std::vector<const SubmeshGeometry*>& lods, DirectX::FXMMATRIX world,
+                   const Camera& camera, float viewportHeight, float maxPixelError);
+}
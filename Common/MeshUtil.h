@@ -26,6 +26,10 @@ struct SubmeshGeometry
 	// Bounding box of the geometry defined by this submesh. 
 	// This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+	// Geometric error, in object space units, of a level of detail generated by
+	// MeshSimplifier::GenerateLods.  0 for authored geometry.
+	float LodError = 0.0f;
 };
 
 struct MeshGeometry
@@ -0,0 +1,675 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // "MSHL" in little endian.
+    constexpr uint32_t FileMagic = 0x4C48534D;
+
+    // Bump whenever the file layout or the build algorithm changes.
+    constexpr uint32_t FileVersion = 1;
+
+    struct FileHeader
+    {
+        uint32_t Magic = FileMagic;
+        uint32_t Version = FileVersion;
+        uint64_t SourceHash = 0;
+
+        uint32_t MaxVertices = 0;
+        uint32_t MaxPrimitives = 0;
+        float ConeWeight = 0.0f;
+        uint32_t SubmeshCount = 0;
+
+        uint32_t MeshletCount = 0;
+        uint32_t VertexIndexCount = 0;
+        uint32_t PrimitiveIndexCount = 0;
+        uint32_t Pad = 0;
+    };
+
+    uint64_t Fnv1a(uint64_t hash, const void* data, size_t byteSize)
+    {
+        const BYTE* bytes = static_cast<const BYTE*>(data);
+        for(size_t i = 0; i < byteSize; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+
+    XMVECTOR LoadPosition(const void* vertices, UINT vertexStride, UINT positionOffset, UINT v)
+    {
+        const BYTE* bytes = static_cast<const BYTE*>(vertices);
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bytes + (size_t)v*vertexStride + positionOffset));
+    }
+
+    uint32_t PackPrimitive(UINT i0, UINT i1, UINT i2)
+    {
+        return i0 | (i1 << 10) | (i2 << 20);
+    }
+
+    bool ConeCulls(const MeshletCullData& cull, FXMVECTOR eye)
+    {
+        XMVECTOR apex = XMLoadFloat3(&cull.ConeApex);
+        XMVECTOR axis = XMLoadFloat4(&cull.NormalCone);
+        XMVECTOR view = XMVector3Normalize(apex - eye);
+        return XMVectorGetX(XMVector3Dot(view, axis)) >= cull.NormalCone.w;
+    }
+
+    ///<summary>
+    /// Builds the meshlets of one triangle list.  The triangles around each vertex
+    /// are kept in one array, the ones not yet in a meshlet at the front of each
+    /// vertex's range, so candidate scans only see live triangles.
+    ///</summary>
+    class MeshletPartitioner
+    {
+    public:
+        // Triangles looked at ahead in index order once a meshlet cannot grow along
+        // the surface.
+        static constexpr UINT FallbackWindow = 256;
+
+        MeshletPartitioner(MeshletGeometry& out, const void* vertices, UINT vertexCount, UINT vertexStride,
+                           UINT positionOffset, const uint32_t* indices, UINT indexCount,
+                           const MeshletSettings& settings) :
+            mOut(out),
+            mVertices(vertices),
+            mVertexStride(vertexStride),
+            mPositionOffset(positionOffset),
+            mIndices(indices),
+            mTriangleCount(indexCount / 3),
+            mSettings(settings),
+            mLocal(vertexCount, -1),
+            mEmitted(mTriangleCount, 0)
+        {
+            BuildAdjacency(vertexCount, indexCount);
+            ComputeTriangles();
+        }
+
+        void Run()
+        {
+            UINT remaining = mTriangleCount;
+            while(remaining > 0)
+            {
+                int t = mMeshletVertices.empty() ? PickSeed() : PickNext();
+                if(t < 0)
+                {
+                    FinishMeshlet();
+                    continue;
+                }
+
+                AddTriangle((UINT)t);
+                --remaining;
+
+                if(mMeshletPrimitives.size() == mSettings.MaxPrimitives)
+                    FinishMeshlet();
+            }
+
+            if(!mMeshletPrimitives.empty())
+                FinishMeshlet();
+        }
+
+    private:
+        void BuildAdjacency(UINT vertexCount, UINT indexCount)
+        {
+            mLive.assign(vertexCount, 0);
+            for(UINT i = 0; i < mTriangleCount*3; ++i)
+                mLive[mIndices[i]]++;
+
+            mOffsets.resize(vertexCount);
+            UINT offset = 0;
+            for(UINT v = 0; v < vertexCount; ++v)
+            {
+                mOffsets[v] = offset;
+                offset += mLive[v];
+            }
+
+            std::vector<UINT> fill(vertexCount, 0);
+            mTriangles.resize(mTriangleCount*3);
+            for(UINT i = 0; i < mTriangleCount*3; ++i)
+            {
+                const UINT v = mIndices[i];
+                mTriangles[mOffsets[v] + fill[v]++] = i / 3;
+            }
+        }
+
+        void ComputeTriangles()
+        {
+            mCentroids.resize(mTriangleCount);
+            mNormals.resize(mTriangleCount);
+
+            float totalArea = 0.0f;
+            for(UINT t = 0; t < mTriangleCount; ++t)
+            {
+                XMVECTOR p0 = Position(mIndices[t*3 + 0]);
+                XMVECTOR p1 = Position(mIndices[t*3 + 1]);
+                XMVECTOR p2 = Position(mIndices[t*3 + 2]);
+
+                XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+                totalArea += 0.5f*XMVectorGetX(XMVector3Length(n));
+
+                XMStoreFloat3(&mCentroids[t], (p0 + p1 + p2)*(1.0f/3.0f));
+                XMStoreFloat3(&mNormals[t], XMVector3Normalize(n));
+            }
+
+            // Distances are measured against the radius of a disk with the area of a
+            // full meshlet of average triangles.
+            const float meshletArea = mTriangleCount > 0 ? totalArea / mTriangleCount * mSettings.MaxPrimitives : 0.0f;
+            mExpectedRadius = std::max(sqrtf(meshletArea / XM_PI), 1e-6f);
+        }
+
+        XMVECTOR Position(UINT v)const
+        {
+            return LoadPosition(mVertices, mVertexStride, mPositionOffset, v);
+        }
+
+        UINT NewVertexCount(UINT t)const
+        {
+            return (mLocal[mIndices[t*3 + 0]] < 0 ? 1 : 0) +
+                   (mLocal[mIndices[t*3 + 1]] < 0 ? 1 : 0) +
+                   (mLocal[mIndices[t*3 + 2]] < 0 ? 1 : 0);
+        }
+
+        // First triangle of a meshlet: one next to the previous meshlet, so meshlets
+        // tile the surface, else the next one in index order.
+        int PickSeed()
+        {
+            for(auto it = mPreviousVertices.rbegin(); it != mPreviousVertices.rend(); ++it)
+            {
+                if(mLive[*it] > 0)
+                    return (int)mTriangles[mOffsets[*it]];
+            }
+
+            while(mEmitted[mCursor])
+                ++mCursor;
+
+            return (int)mCursor;
+        }
+
+        // The live triangle around the meshlet's vertices that fits and adds the fewest
+        // vertices, ties broken by distance and facing.  Once nothing around the
+        // meshlet is left, the closest fitting triangle in a window ahead in index
+        // order (which is cache order, so close by) within twice the radius a full
+        // meshlet would have.  -1 closes the meshlet.
+        int PickNext()
+        {
+            const float primitiveCount = (float)mMeshletPrimitives.size();
+            XMVECTOR center = XMLoadFloat3(&mCentroidSum) / primitiveCount;
+            XMVECTOR axis = XMVector3Normalize(XMLoadFloat3(&mNormalSum));
+
+            auto score = [&](UINT t, float& distance)
+            {
+                distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&mCentroids[t]) - center));
+                const float facing = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&mNormals[t]), axis));
+                return (1.0f - mSettings.ConeWeight)*distance/mExpectedRadius + mSettings.ConeWeight*(1.0f - facing);
+            };
+
+            int best = -1;
+            UINT bestNewVertices = 4;
+            float bestScore = FLT_MAX;
+            bool adjacent = false;
+            for(UINT v : mMeshletVertices)
+            {
+                const UINT* tris = &mTriangles[mOffsets[v]];
+                for(UINT k = 0; k < mLive[v]; ++k)
+                {
+                    adjacent = true;
+
+                    const UINT t = tris[k];
+                    const UINT newVertices = NewVertexCount(t);
+                    if(mMeshletVertices.size() + newVertices > mSettings.MaxVertices || newVertices > bestNewVertices)
+                        continue;
+
+                    float distance;
+                    const float s = score(t, distance);
+                    if(newVertices < bestNewVertices || s < bestScore)
+                    {
+                        best = (int)t;
+                        bestNewVertices = newVertices;
+                        bestScore = s;
+                    }
+                }
+            }
+
+            // Full, as far as the surface around the meshlet goes.
+            if(adjacent)
+                return best;
+
+            while(mCursor < mTriangleCount && mEmitted[mCursor])
+                ++mCursor;
+
+            const UINT windowEnd = std::min(mTriangleCount, mCursor + FallbackWindow);
+            for(UINT t = mCursor; t < windowEnd; ++t)
+            {
+                if(mEmitted[t] || mMeshletVertices.size() + NewVertexCount(t) > mSettings.MaxVertices)
+                    continue;
+
+                float distance;
+                const float s = score(t, distance);
+                if(distance <= 2.0f*mExpectedRadius && s < bestScore)
+                {
+                    best = (int)t;
+                    bestScore = s;
+                }
+            }
+
+            return best;
+        }
+
+        void AddTriangle(UINT t)
+        {
+            UINT local[3];
+            for(UINT c = 0; c < 3; ++c)
+            {
+                const UINT v = mIndices[t*3 + c];
+                if(mLocal[v] < 0)
+                {
+                    mLocal[v] = (int)mMeshletVertices.size();
+                    mMeshletVertices.push_back(v);
+                }
+                local[c] = (UINT)mLocal[v];
+
+                // Swap the triangle out of the vertex's live range.
+                UINT* tris = &mTriangles[mOffsets[v]];
+                for(UINT k = 0; k < mLive[v]; ++k)
+                {
+                    if(tris[k] == t)
+                    {
+                        std::swap(tris[k], tris[mLive[v] - 1]);
+                        break;
+                    }
+                }
+                mLive[v]--;
+            }
+
+            mMeshletPrimitives.push_back(PackPrimitive(local[0], local[1], local[2]));
+            mMeshletTriangles.push_back(t);
+            mEmitted[t] = 1;
+
+            XMStoreFloat3(&mCentroidSum, XMLoadFloat3(&mCentroidSum) + XMLoadFloat3(&mCentroids[t]));
+            XMStoreFloat3(&mNormalSum, XMLoadFloat3(&mNormalSum) + XMLoadFloat3(&mNormals[t]));
+        }
+
+        void FinishMeshlet()
+        {
+            Meshlet meshlet;
+            meshlet.VertexCount = (uint32_t)mMeshletVertices.size();
+            meshlet.VertexOffset = (uint32_t)mOut.VertexIndices.size();
+            meshlet.PrimitiveCount = (uint32_t)mMeshletPrimitives.size();
+            meshlet.PrimitiveOffset = (uint32_t)mOut.PrimitiveIndices.size();
+
+            mOut.Meshlets.push_back(meshlet);
+            mOut.CullData.push_back(ComputeCullData());
+            mOut.VertexIndices.insert(mOut.VertexIndices.end(), mMeshletVertices.begin(), mMeshletVertices.end());
+            mOut.PrimitiveIndices.insert(mOut.PrimitiveIndices.end(), mMeshletPrimitives.begin(), mMeshletPrimitives.end());
+
+            for(UINT v : mMeshletVertices)
+                mLocal[v] = -1;
+
+            std::swap(mPreviousVertices, mMeshletVertices);
+            mMeshletVertices.clear();
+            mMeshletPrimitives.clear();
+            mMeshletTriangles.clear();
+            mCentroidSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            mNormalSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        }
+
+        MeshletCullData ComputeCullData()const
+        {
+            MeshletCullData cull = {};
+
+            // Sphere around the box of the vertices.
+            XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+            XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+            for(UINT v : mMeshletVertices)
+            {
+                XMVECTOR p = Position(v);
+                vMin = XMVectorMin(vMin, p);
+                vMax = XMVectorMax(vMax, p);
+            }
+
+            XMVECTOR center = 0.5f*(vMin + vMax);
+            float radius = 0.0f;
+            for(UINT v : mMeshletVertices)
+                radius = std::max(radius, XMVectorGetX(XMVector3Length(Position(v) - center)));
+
+            XMStoreFloat4(&cull.BoundingSphere, XMVectorSetW(center, radius));
+
+            // Normal cone around the average normal.  Degenerate triangles have no
+            // facing and are ignored.
+            XMVECTOR axis = XMVector3Normalize(XMLoadFloat3(&mNormalSum));
+            float minDot = 1.0f;
+            for(UINT t : mMeshletTriangles)
+            {
+                XMVECTOR n = XMLoadFloat3(&mNormals[t]);
+                if(XMVector3Equal(n, XMVectorZero()))
+                    continue;
+
+                minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+            }
+
+            XMStoreFloat4(&cull.NormalCone, XMVectorSetW(axis, 1.0f));
+            XMStoreFloat3(&cull.ConeApex, center);
+
+            // Cones wider than ~84 degrees cull almost nothing; leave them uncullable.
+            if(XMVector3Equal(axis, XMVectorZero()) || minDot <= 0.1f)
+                return cull;
+
+            cull.NormalCone.w = sqrtf(1.0f - minDot*minDot);
+
+            // Move the apex back along the axis until it is behind every triangle's
+            // plane, so the test from the apex is conservative for the whole meshlet.
+            float maxT = 0.0f;
+            for(UINT t : mMeshletTriangles)
+            {
+                XMVECTOR n = XMLoadFloat3(&mNormals[t]);
+                const float dn = XMVectorGetX(XMVector3Dot(n, axis));
+                if(dn <= 0.0f)
+                    continue;
+
+                XMVECTOR p0 = Position(mIndices[t*3]);
+                maxT = std::max(maxT, XMVectorGetX(XMVector3Dot(center - p0, n)) / dn);
+            }
+
+            XMStoreFloat3(&cull.ConeApex, center - axis*maxT);
+            return cull;
+        }
+
+    private:
+        MeshletGeometry& mOut;
+        const void* mVertices;
+        UINT mVertexStride;
+        UINT mPositionOffset;
+        const uint32_t* mIndices;
+        UINT mTriangleCount;
+        const MeshletSettings& mSettings;
+
+        std::vector<UINT> mOffsets;
+        std::vector<UINT> mLive;
+        std::vector<UINT> mTriangles;
+        std::vector<XMFLOAT3> mCentroids;
+        std::vector<XMFLOAT3> mNormals;
+        float mExpectedRadius = 1.0f;
+
+        // Local index of each vertex in the current meshlet, or -1.
+        std::vector<int> mLocal;
+        std::vector<BYTE> mEmitted;
+        UINT mCursor = 0;
+
+        std::vector<UINT> mMeshletVertices;
+        std::vector<UINT> mPreviousVertices;
+        std::vector<uint32_t> mMeshletPrimitives;
+        std::vector<UINT> mMeshletTriangles;
+        XMFLOAT3 mCentroidSum = { 0.0f, 0.0f, 0.0f };
+        XMFLOAT3 mNormalSum = { 0.0f, 0.0f, 0.0f };
+    };
+
+    template<typename T>
+    void WriteArray(std::ofstream& fout, const std::vector<T>& v)
+    {
+        fout.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+    }
+
+    template<typename T>
+    void ReadArray(std::ifstream& fin, std::vector<T>& v, uint32_t count)
+    {
+        v.resize(count);
+        fin.read(reinterpret_cast<char*>(v.data()), (std::streamsize)count*sizeof(T));
+    }
+}
+
+MeshletSubmesh MeshletBuilder::AppendSubmesh(MeshletGeometry& meshlets,
+                                             const void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+                                             const uint32_t* indices, UINT indexCount,
+                                             const MeshletSettings& settings)
+{
+    assert(settings.MaxVertices >= 3 && settings.MaxVertices <= MaxVerticesLimit);
+    assert(settings.MaxPrimitives >= 1 && settings.MaxPrimitives <= MaxPrimitivesLimit);
+
+    MeshletSubmesh submesh;
+    submesh.MeshletOffset = (UINT)meshlets.Meshlets.size();
+
+    MeshletPartitioner partitioner(meshlets, vertices, vertexCount, vertexStride, positionOffset,
+                                   indices, indexCount, settings);
+    partitioner.Run();
+
+    submesh.MeshletCount = (UINT)meshlets.Meshlets.size() - submesh.MeshletOffset;
+    return submesh;
+}
+
+MeshletGeometry MeshletBuilder::Build(const MeshGeometry& geo, UINT positionOffset, const MeshletSettings& settings)
+{
+    MeshletGeometry meshlets;
+
+    // Sorted so the buffers do not depend on the hash map's order.
+    std::vector<std::string> names;
+    for(const auto& drawArg : geo.DrawArgs)
+        names.push_back(drawArg.first);
+    std::sort(names.begin(), names.end());
+
+    const bool index16 = geo.IndexFormat == DXGI_FORMAT_R16_UINT;
+    std::vector<uint32_t> indices;
+    for(const std::string& name : names)
+    {
+        const SubmeshGeometry& submesh = geo.DrawArgs.at(name);
+
+        indices.resize(submesh.IndexCount);
+        for(UINT i = 0; i < submesh.IndexCount; ++i)
+        {
+            const UINT k = submesh.StartIndexLocation + i;
+            indices[i] = index16 ?
+                reinterpret_cast<const uint16_t*>(geo.IndexBufferCPU.data())[k] :
+                reinterpret_cast<const uint32_t*>(geo.IndexBufferCPU.data())[k];
+        }
+
+        // Indices are relative to the base vertex.
+        UINT vertexCount = 0;
+        for(uint32_t index : indices)
+            vertexCount = std::max(vertexCount, index + 1);
+
+        const BYTE* vertices = geo.VertexBufferCPU.data() + (size_t)submesh.BaseVertexLocation*geo.VertexByteStride;
+
+        MeshletSubmesh meshletSubmesh = AppendSubmesh(meshlets, vertices, vertexCount, geo.VertexByteStride, positionOffset,
+                                                      indices.data(), submesh.IndexCount, settings);
+        meshletSubmesh.BaseVertexLocation = submesh.BaseVertexLocation;
+        meshlets.DrawArgs[name] = meshletSubmesh;
+    }
+
+    return meshlets;
+}
+
+MeshletStats MeshletBuilder::Analyze(const MeshletGeometry& meshlets, const MeshletSettings& settings)
+{
+    MeshletStats stats;
+    stats.MeshletCount = (UINT)meshlets.Meshlets.size();
+    if(stats.MeshletCount == 0)
+        return stats;
+
+    UINT vertexTotal = 0;
+    for(const Meshlet& meshlet : meshlets.Meshlets)
+    {
+        vertexTotal += meshlet.VertexCount;
+        stats.TriangleCount += meshlet.PrimitiveCount;
+    }
+
+    stats.AverageVertices = (float)vertexTotal / stats.MeshletCount;
+    stats.AveragePrimitives = (float)stats.TriangleCount / stats.MeshletCount;
+    stats.VertexFill = stats.AverageVertices / settings.MaxVertices;
+    stats.PrimitiveFill = stats.AveragePrimitives / settings.MaxPrimitives;
+
+    // Unique vertices, counting each submesh's vertex range separately.
+    std::vector<int64_t> used;
+    for(const auto& drawArg : meshlets.DrawArgs)
+    {
+        const MeshletSubmesh& submesh = drawArg.second;
+        for(UINT m = submesh.MeshletOffset; m < submesh.MeshletOffset + submesh.MeshletCount; ++m)
+        {
+            const Meshlet& meshlet = meshlets.Meshlets[m];
+            for(UINT i = 0; i < meshlet.VertexCount; ++i)
+                used.push_back((int64_t)submesh.BaseVertexLocation + meshlets.VertexIndices[meshlet.VertexOffset + i]);
+        }
+    }
+    std::sort(used.begin(), used.end());
+    const size_t uniqueCount = std::unique(used.begin(), used.end()) - used.begin();
+    stats.VertexDuplication = uniqueCount > 0 ? (float)vertexTotal / uniqueCount : 0.0f;
+
+    // The whole mesh's sphere, from the meshlet spheres.
+    auto toSphere = [](const MeshletCullData& cull)
+    {
+        const XMFLOAT4& s = cull.BoundingSphere;
+        return BoundingSphere(XMFLOAT3(s.x, s.y, s.z), s.w);
+    };
+
+    BoundingSphere meshSphere = toSphere(meshlets.CullData[0]);
+    for(const MeshletCullData& cull : meshlets.CullData)
+        BoundingSphere::CreateMerged(meshSphere, meshSphere, toSphere(cull));
+
+    float radiusSum = 0.0f;
+    UINT cullable = 0;
+    for(const MeshletCullData& cull : meshlets.CullData)
+    {
+        radiusSum += cull.BoundingSphere.w;
+        cullable += cull.NormalCone.w < 1.0f ? 1 : 0;
+    }
+
+    stats.AverageRadius = meshSphere.Radius > 0.0f ? radiusSum / stats.MeshletCount / meshSphere.Radius : 0.0f;
+    stats.ConeCullable = (float)cullable / stats.MeshletCount;
+
+    const XMFLOAT3 directions[6] =
+    {
+        { +1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+        { 0.0f, +1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+        { 0.0f, 0.0f, +1.0f }, { 0.0f, 0.0f, -1.0f },
+    };
+
+    UINT culled = 0;
+    for(const XMFLOAT3& direction : directions)
+    {
+        XMVECTOR eye = XMLoadFloat3(&meshSphere.Center) + 10.0f*meshSphere.Radius*XMLoadFloat3(&direction);
+        for(const MeshletCullData& cull : meshlets.CullData)
+            culled += ConeCulls(cull, eye) ? 1 : 0;
+    }
+
+    stats.ConeCullRate = (float)culled / (6.0f*stats.MeshletCount);
+
+    return stats;
+}
+
+uint64_t MeshletBuilder::HashSource(const MeshGeometry& geo)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = Fnv1a(hash, geo.VertexBufferCPU.data(), geo.VertexBufferCPU.size());
+    hash = Fnv1a(hash, geo.IndexBufferCPU.data(), geo.IndexBufferCPU.size());
+    hash = Fnv1a(hash, &geo.VertexByteStride, sizeof(geo.VertexByteStride));
+    hash = Fnv1a(hash, &geo.IndexFormat, sizeof(geo.IndexFormat));
+
+    std::vector<std::string> names;
+    for(const auto& drawArg : geo.DrawArgs)
+        names.push_back(drawArg.first);
+    std::sort(names.begin(), names.end());
+
+    for(const std::string& name : names)
+    {
+        const SubmeshGeometry& submesh = geo.DrawArgs.at(name);
+        hash = Fnv1a(hash, name.data(), name.size());
+        hash = Fnv1a(hash, &submesh.IndexCount, sizeof(submesh.IndexCount));
+        hash = Fnv1a(hash, &submesh.StartIndexLocation, sizeof(submesh.StartIndexLocation));
+        hash = Fnv1a(hash, &submesh.BaseVertexLocation, sizeof(submesh.BaseVertexLocation));
+    }
+
+    return hash;
+}
+
+std::string MeshletBuilder::MeshletFilename(const std::string& modelFilename)
+{
+    return std::filesystem::path(modelFilename).replace_extension(".meshlets").string();
+}
+
+bool MeshletBuilder::Write(const std::string& filename, const MeshletGeometry& meshlets, uint64_t sourceHash,
+                           const MeshletSettings& settings)
+{
+    std::ofstream fout(filename, std::ios::binary);
+    if(!fout)
+        return false;
+
+    FileHeader header;
+    header.SourceHash = sourceHash;
+    header.MaxVertices = settings.MaxVertices;
+    header.MaxPrimitives = settings.MaxPrimitives;
+    header.ConeWeight = settings.ConeWeight;
+    header.SubmeshCount = (uint32_t)meshlets.DrawArgs.size();
+    header.MeshletCount = (uint32_t)meshlets.Meshlets.size();
+    header.VertexIndexCount = (uint32_t)meshlets.VertexIndices.size();
+    header.PrimitiveIndexCount = (uint32_t)meshlets.PrimitiveIndices.size();
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    WriteArray(fout, meshlets.Meshlets);
+    WriteArray(fout, meshlets.CullData);
+    WriteArray(fout, meshlets.VertexIndices);
+    WriteArray(fout, meshlets.PrimitiveIndices);
+
+    for(const auto& [name, submesh] : meshlets.DrawArgs)
+    {
+        const uint32_t nameLength = (uint32_t)name.size();
+        fout.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+        fout.write(name.data(), nameLength);
+        fout.write(reinterpret_cast<const char*>(&submesh), sizeof(submesh));
+    }
+
+    return fout.good();
+}
+
+bool MeshletBuilder::Read(const std::string& filename, MeshletGeometry& meshlets, uint64_t sourceHash,
+                          const MeshletSettings& settings)
+{
+    std::ifstream fin(filename, std::ios::binary);
+    if(!fin)
+        return false;
+
+    FileHeader header;
+    fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!fin ||
+       header.Magic != FileMagic ||
+       header.Version != FileVersion ||
+       header.SourceHash != sourceHash ||
+       header.MaxVertices != settings.MaxVertices ||
+       header.MaxPrimitives != settings.MaxPrimitives ||
+       header.ConeWeight != settings.ConeWeight)
+    {
+        return false;
+    }
+
+    MeshletGeometry result;
+    ReadArray(fin, result.Meshlets, header.MeshletCount);
+    ReadArray(fin, result.CullData, header.MeshletCount);
+    ReadArray(fin, result.VertexIndices, header.VertexIndexCount);
+    ReadArray(fin, result.PrimitiveIndices, header.PrimitiveIndexCount);
+
+    for(uint32_t i = 0; i < header.SubmeshCount && fin; ++i)
+    {
+        uint32_t nameLength = 0;
+        fin.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
+
+        std::string name(nameLength, '\0');
+        fin.read(name.data(), nameLength);
+
+        MeshletSubmesh submesh;
+        fin.read(reinterpret_cast<char*>(&submesh), sizeof(submesh));
+        result.DrawArgs[name] = submesh;
+    }
+
+    if(!fin)
+        return false;
+
+    meshlets.Meshlets = std::move(result.Meshlets);
+    meshlets.CullData = std::move(result.CullData);
+    meshlets.VertexIndices = std::move(result.VertexIndices);
+    meshlets.PrimitiveIndices = std::move(result.PrimitiveIndices);
+    meshlets.DrawArgs = std::move(result.DrawArgs);
+    return true;
+}
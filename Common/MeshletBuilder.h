@@ -0,0 +1,122 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits the index buffers of a MeshGeometry into meshlets for the mesh shader
+// path: small clusters of at most MaxVertices vertices and MaxPrimitives triangles
+// that one mesh shader group outputs.  Triangles are added greedily to the current
+// meshlet, preferring those that add no new vertices, then those closest to the
+// meshlet in position and facing.
+//
+// Each meshlet gets a bounding sphere and a normal cone, so an amplification shader
+// can skip meshlets that are outside the frustum or entirely back facing (see
+// MeshletCullData in Shaders/SharedTypes.h).
+//
+// Building is too slow to do every run for large models, so the result can be saved
+// next to the model and read back.  The file records a hash of the geometry it was
+// built from and is rejected if the geometry changed.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "../Shaders/SharedTypes.h"
+
+struct MeshletSettings
+{
+    // Mesh shaders can output at most 256 vertices and 256 primitives; 64 and 126
+    // are the sizes the hardware vendors recommend.
+    UINT MaxVertices = 64;
+    UINT MaxPrimitives = 126;
+
+    // How much facing counts against distance when picking the next triangle.  Higher
+    // gives tighter normal cones and looser bounding spheres.
+    float ConeWeight = 0.5f;
+};
+
+// The meshlets of one DrawArgs entry.
+struct MeshletSubmesh
+{
+    UINT MeshletOffset = 0;
+    UINT MeshletCount = 0;
+    INT BaseVertexLocation = 0;
+};
+
+struct MeshletStats
+{
+    UINT MeshletCount = 0;
+    UINT TriangleCount = 0;
+
+    // Average vertices and triangles per meshlet, and as a fraction of the limits.
+    float AverageVertices = 0.0f;
+    float AveragePrimitives = 0.0f;
+    float VertexFill = 0.0f;
+    float PrimitiveFill = 0.0f;
+
+    // Vertices transformed by all meshlets per vertex used; 1 is ideal.
+    float VertexDuplication = 0.0f;
+
+    // Average bounding sphere radius relative to the radius of the whole mesh.
+    float AverageRadius = 0.0f;
+
+    // Meshlets whose normal cone can cull at all, and the fraction culled on average
+    // when the mesh is viewed from afar along each axis.
+    float ConeCullable = 0.0f;
+    float ConeCullRate = 0.0f;
+};
+
+///<summary>
+/// The meshlets of a MeshGeometry, on the CPU and, once uploaded with
+/// d3dUtil::BuildMeshletGeometry, as structured buffers on the GPU.
+///</summary>
+struct MeshletGeometry
+{
+    std::vector<Meshlet> Meshlets;
+    std::vector<MeshletCullData> CullData;
+
+    // Relative to the submesh's BaseVertexLocation.
+    std::vector<uint32_t> VertexIndices;
+
+    // Three 10-bit meshlet vertex indices per triangle.
+    std::vector<uint32_t> PrimitiveIndices;
+
+    std::unordered_map<std::string, MeshletSubmesh> DrawArgs;
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> MeshletBufferGPU = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource> CullDataBufferGPU = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource> VertexIndexBufferGPU = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource> PrimitiveIndexBufferGPU = nullptr;
+};
+
+namespace MeshletBuilder
+{
+    constexpr UINT MaxVerticesLimit = 256;
+    constexpr UINT MaxPrimitivesLimit = 256;
+
+    // Builds the meshlets of one indexed triangle list and appends them to meshlets.
+    // Vertices are opaque blobs of vertexStride bytes with a float3 position at
+    // positionOffset.
+    MeshletSubmesh AppendSubmesh(MeshletGeometry& meshlets,
+                                 const void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+                                 const uint32_t* indices, UINT indexCount,
+                                 const MeshletSettings& settings = MeshletSettings());
+
+    // The meshlets of every DrawArgs entry of geo, from its CPU copies.
+    MeshletGeometry Build(const MeshGeometry& geo, UINT positionOffset = 0,
+                          const MeshletSettings& settings = MeshletSettings());
+
+    MeshletStats Analyze(const MeshletGeometry& meshlets, const MeshletSettings& settings = MeshletSettings());
+
+    // Fingerprint of the buffers and draw arguments the meshlets are built from.
+    uint64_t HashSource(const MeshGeometry& geo);
+
+    // Returns the .meshlets filename that sits next to the given model filename.
+    std::string MeshletFilename(const std::string& modelFilename);
+
+    // Write stores the CPU data with the source hash and settings.  Read fails if the
+    // file does not exist, or was written by another version, from other geometry or
+    // with other settings.
+    bool Write(const std::string& filename, const MeshletGeometry& meshlets, uint64_t sourceHash,
+               const MeshletSettings& settings = MeshletSettings());
+    bool Read(const std::string& filename, MeshletGeometry& meshlets, uint64_t sourceHash,
+              const MeshletSettings& settings = MeshletSettings());
+}
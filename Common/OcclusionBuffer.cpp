@@ -0,0 +1,393 @@
+//***************************************************************************************
+// OcclusionBuffer.cpp
+//***************************************************************************************
+
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    // Triangles with less area than this, in pixels, cover no pixel center worth drawing.
+    const float MinTriangleArea = 1e-6f;
+
+    // Clips a polygon against the near plane, z >= 0 in clip space.  Returns the
+    // number of vertices written to out, which has room for count + 1.
+    uint32_t ClipNear(const XMVECTOR* in, uint32_t count, XMVECTOR* out)
+    {
+        uint32_t outCount = 0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const XMVECTOR a = in[i];
+            const XMVECTOR b = in[(i + 1) % count];
+            const float za = XMVectorGetZ(a);
+            const float zb = XMVectorGetZ(b);
+
+            if(za >= 0.0f)
+                out[outCount++] = a;
+
+            if((za >= 0.0f) != (zb >= 0.0f))
+                out[outCount++] = XMVectorLerp(a, b, za / (za - zb));
+        }
+
+        return outCount;
+    }
+
+    // True if all three clip space vertices are outside the same side of the frustum.
+    bool OutsideFrustum(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c)
+    {
+        XMFLOAT4 v[3];
+        XMStoreFloat4(&v[0], a);
+        XMStoreFloat4(&v[1], b);
+        XMStoreFloat4(&v[2], c);
+
+        auto allOutside = [&](auto outside)
+        {
+            return outside(v[0]) && outside(v[1]) && outside(v[2]);
+        };
+
+        return allOutside([](const XMFLOAT4& p) { return p.x < -p.w; }) ||
+               allOutside([](const XMFLOAT4& p) { return p.x > p.w; }) ||
+               allOutside([](const XMFLOAT4& p) { return p.y < -p.w; }) ||
+               allOutside([](const XMFLOAT4& p) { return p.y > p.w; }) ||
+               allOutside([](const XMFLOAT4& p) { return p.z < 0.0f; }) ||
+               allOutside([](const XMFLOAT4& p) { return p.z > p.w; });
+    }
+}
+
+void OccluderMesh::Build(const void* vertices, uint32_t vertexStride, const void* indices, uint32_t indexSize,
+                         uint32_t indexCount)
+{
+    Positions.clear();
+    Indices.resize(indexCount);
+
+    // Old vertex index to new, for the vertices used so far.
+    std::vector<uint32_t> remap;
+    for(uint32_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t index = indexSize == 2 ? static_cast<const uint16_t*>(indices)[i] : static_cast<const uint32_t*>(indices)[i];
+        if(index >= remap.size())
+            remap.resize(index + 1, UINT32_MAX);
+
+        if(remap[index] == UINT32_MAX)
+        {
+            remap[index] = (uint32_t)Positions.size();
+            Positions.push_back(*reinterpret_cast<const XMFLOAT3*>(static_cast<const uint8_t*>(vertices) + (size_t)index * vertexStride));
+        }
+
+        Indices[i] = remap[index];
+    }
+}
+
+void OcclusionBuffer::Resize(uint32_t width, uint32_t height)
+{
+    mWidth = (std::max(width, 4u) + 3) & ~3u;
+    mHeight = std::max(height, 1u);
+    mDepth.assign((size_t)mWidth * mHeight, 1.0f);
+
+    mLevels.clear();
+    uint32_t levelWidth = mWidth;
+    uint32_t levelHeight = mHeight;
+    while(levelWidth > 1 || levelHeight > 1)
+    {
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+
+        Level level;
+        level.Width = levelWidth;
+        level.Height = levelHeight;
+        level.Min.assign((size_t)levelWidth * levelHeight, 1.0f);
+        level.Max.assign((size_t)levelWidth * levelHeight, 1.0f);
+        mLevels.push_back(std::move(level));
+    }
+}
+
+uint32_t OcclusionBuffer::Width()const
+{
+    return mWidth;
+}
+
+uint32_t OcclusionBuffer::Height()const
+{
+    return mHeight;
+}
+
+uint32_t OcclusionBuffer::LevelCount()const
+{
+    return (uint32_t)mLevels.size() + 1;
+}
+
+void OcclusionBuffer::Clear(FXMMATRIX viewProj)
+{
+    XMStoreFloat4x4(&mViewProj, viewProj);
+    std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+}
+
+XMFLOAT3 OcclusionBuffer::ToScreen(FXMVECTOR clip)const
+{
+    const XMVECTOR ndc = XMVectorDivide(clip, XMVectorSplatW(clip));
+    const XMVECTOR scale = XMVectorSet(0.5f*mWidth, -0.5f*mHeight, 1.0f, 0.0f);
+    const XMVECTOR offset = XMVectorSet(0.5f*mWidth, 0.5f*mHeight, 0.0f, 0.0f);
+
+    XMFLOAT3 screen;
+    XMStoreFloat3(&screen, XMVectorMultiplyAdd(ndc, scale, offset));
+    return screen;
+}
+
+void OcclusionBuffer::DrawOccluder(const OccluderMesh& mesh, FXMMATRIX world)
+{
+    const XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+
+    mClipVertices.resize(mesh.Positions.size());
+    for(size_t i = 0; i < mesh.Positions.size(); ++i)
+        XMStoreFloat4(&mClipVertices[i], XMVector3Transform(XMLoadFloat3(&mesh.Positions[i]), worldViewProj));
+
+    for(size_t t = 0; t + 2 < mesh.Indices.size(); t += 3)
+    {
+        XMVECTOR clip[3] =
+        {
+            XMLoadFloat4(&mClipVertices[mesh.Indices[t + 0]]),
+            XMLoadFloat4(&mClipVertices[mesh.Indices[t + 1]]),
+            XMLoadFloat4(&mClipVertices[mesh.Indices[t + 2]]),
+        };
+
+        if(OutsideFrustum(clip[0], clip[1], clip[2]))
+            continue;
+
+        // Only the near plane needs clipping; the rest is left to the pixel bounds.
+        XMVECTOR polygon[4];
+        uint32_t vertexCount = 3;
+        const XMVECTOR* verts = clip;
+        if(XMVectorGetZ(clip[0]) < 0.0f || XMVectorGetZ(clip[1]) < 0.0f || XMVectorGetZ(clip[2]) < 0.0f)
+        {
+            vertexCount = ClipNear(clip, 3, polygon);
+            verts = polygon;
+        }
+
+        if(vertexCount < 3)
+            continue;
+
+        const XMFLOAT3 v0 = ToScreen(verts[0]);
+        XMFLOAT3 v1 = ToScreen(verts[1]);
+        for(uint32_t i = 2; i < vertexCount; ++i)
+        {
+            const XMFLOAT3 v2 = ToScreen(verts[i]);
+            DrawTriangle(v0, v1, v2);
+            v1 = v2;
+        }
+    }
+}
+
+void OcclusionBuffer::DrawTriangle(const XMFLOAT3& v0, const XMFLOAT3& in1, const XMFLOAT3& in2)
+{
+    float area = (in1.x - v0.x)*(in2.y - v0.y) - (in1.y - v0.y)*(in2.x - v0.x);
+    if(fabsf(area) < MinTriangleArea)
+        return;
+
+    // Wind the triangle so that its edge functions are positive inside.
+    const bool flip = area < 0.0f;
+    const XMFLOAT3& v1 = flip ? in2 : in1;
+    const XMFLOAT3& v2 = flip ? in1 : in2;
+    area = fabsf(area);
+
+    const int minX = std::max((int)floorf(std::min(v0.x, std::min(v1.x, v2.x))), 0);
+    const int maxX = std::min((int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))), (int)mWidth - 1);
+    const int minY = std::max((int)floorf(std::min(v0.y, std::min(v1.y, v2.y))), 0);
+    const int maxY = std::min((int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))), (int)mHeight - 1);
+    if(minX > maxX || minY > maxY)
+        return;
+
+    // Edge i runs from vertex i to vertex i + 1 and is a*x + b*y + c, positive on the
+    // side of the opposite vertex.
+    const XMFLOAT3* v[3] = { &v0, &v1, &v2 };
+    float a[3], b[3], c[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        const XMFLOAT3& p = *v[i];
+        const XMFLOAT3& q = *v[(i + 1) % 3];
+        a[i] = p.y - q.y;
+        b[i] = q.x - p.x;
+        c[i] = p.x*q.y - q.x*p.y;
+    }
+
+    // Depth is linear in screen space: the edge functions over the area are the
+    // barycentrics of the vertex opposite each edge.
+    const float invArea = 1.0f / area;
+    const float dzdx = (a[1]*v0.z + a[2]*v1.z + a[0]*v2.z) * invArea;
+    const float dzdy = (b[1]*v0.z + b[2]*v1.z + b[0]*v2.z) * invArea;
+    const float z0 = (c[1]*v0.z + c[2]*v1.z + c[0]*v2.z) * invArea;
+
+    const XMVECTOR pixelOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+    const XMVECTOR a0 = XMVectorReplicate(a[0]);
+    const XMVECTOR a1 = XMVectorReplicate(a[1]);
+    const XMVECTOR a2 = XMVectorReplicate(a[2]);
+    const XMVECTOR zx = XMVectorReplicate(dzdx);
+    const XMVECTOR zero = XMVectorZero();
+
+    for(int y = minY; y <= maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        const XMVECTOR row0 = XMVectorReplicate(b[0]*py + c[0]);
+        const XMVECTOR row1 = XMVectorReplicate(b[1]*py + c[1]);
+        const XMVECTOR row2 = XMVectorReplicate(b[2]*py + c[2]);
+        const XMVECTOR rowZ = XMVectorReplicate(dzdy*py + z0);
+
+        float* depthRow = mDepth.data() + (size_t)y * mWidth;
+        for(int x = minX & ~3; x <= maxX; x += 4)
+        {
+            const XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), pixelOffsets);
+
+            XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a0, px, row0), zero);
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a1, px, row1), zero));
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a2, px, row2), zero));
+
+            XMFLOAT4* span = reinterpret_cast<XMFLOAT4*>(depthRow + x);
+            const XMVECTOR depth = XMLoadFloat4(span);
+            const XMVECTOR z = XMVectorMultiplyAdd(zx, px, rowZ);
+            XMStoreFloat4(span, XMVectorSelect(depth, XMVectorMin(depth, z), inside));
+        }
+    }
+}
+
+void OcclusionBuffer::BuildPyramid()
+{
+    for(size_t l = 0; l < mLevels.size(); ++l)
+    {
+        Level& level = mLevels[l];
+        const uint32_t srcWidth = l == 0 ? mWidth : mLevels[l - 1].Width;
+        const uint32_t srcHeight = l == 0 ? mHeight : mLevels[l - 1].Height;
+        const float* srcMin = l == 0 ? mDepth.data() : mLevels[l - 1].Min.data();
+        const float* srcMax = l == 0 ? mDepth.data() : mLevels[l - 1].Max.data();
+
+        for(uint32_t y = 0; y < level.Height; ++y)
+        {
+            const uint32_t y0 = 2*y;
+            const uint32_t y1 = std::min(2*y + 1, srcHeight - 1);
+            for(uint32_t x = 0; x < level.Width; ++x)
+            {
+                const uint32_t x0 = 2*x;
+                const uint32_t x1 = std::min(2*x + 1, srcWidth - 1);
+
+                const size_t i00 = (size_t)y0*srcWidth + x0, i01 = (size_t)y0*srcWidth + x1;
+                const size_t i10 = (size_t)y1*srcWidth + x0, i11 = (size_t)y1*srcWidth + x1;
+
+                const size_t dst = (size_t)y*level.Width + x;
+                level.Min[dst] = std::min(std::min(srcMin[i00], srcMin[i01]), std::min(srcMin[i10], srcMin[i11]));
+                level.Max[dst] = std::max(std::max(srcMax[i00], srcMax[i01]), std::max(srcMax[i10], srcMax[i11]));
+            }
+        }
+    }
+}
+
+float OcclusionBuffer::MinDepth(uint32_t level, uint32_t x, uint32_t y)const
+{
+    if(level == 0)
+        return mDepth[(size_t)y*mWidth + x];
+
+    const Level& l = mLevels[level - 1];
+    return l.Min[(size_t)y*l.Width + x];
+}
+
+float OcclusionBuffer::MaxDepth(uint32_t level, uint32_t x, uint32_t y)const
+{
+    if(level == 0)
+        return mDepth[(size_t)y*mWidth + x];
+
+    const Level& l = mLevels[level - 1];
+    return l.Max[(size_t)y*l.Width + x];
+}
+
+bool OcclusionBuffer::IsOccluded(const BoundingBox& localBounds, FXMMATRIX world)const
+{
+    if(mDepth.empty())
+        return false;
+
+    const XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    localBounds.GetCorners(corners);
+
+    float minX = FLT_MAX, minY = FLT_MAX, nearZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for(const XMFLOAT3& corner : corners)
+    {
+        const XMVECTOR clip = XMVector3Transform(XMLoadFloat3(&corner), worldViewProj);
+        if(XMVectorGetZ(clip) < 0.0f)
+            return false;
+
+        const XMFLOAT3 p = ToScreen(clip);
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+        nearZ = std::min(nearZ, p.z);
+    }
+
+    if(maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+        return false;
+
+    // Every pixel whose center is within half a pixel of the box's screen rectangle.
+    // Occluders only cover the pixels whose centers they cover, so a box that ends
+    // inside a pixel on an occluder's edge is checked against the pixel beside it too.
+    const uint32_t rect[4] =
+    {
+        (uint32_t)std::max(minX - 0.5f, 0.0f),
+        (uint32_t)std::max(minY - 0.5f, 0.0f),
+        (uint32_t)std::min(maxX + 0.5f, (float)(mWidth - 1)),
+        (uint32_t)std::min(maxY + 0.5f, (float)(mHeight - 1)),
+    };
+
+    // Start where the rectangle covers at most 2x2 texels.
+    uint32_t level = 0;
+    while(level + 1 < LevelCount() &&
+          ((rect[2] >> level) - (rect[0] >> level) > 1 || (rect[3] >> level) - (rect[1] >> level) > 1))
+    {
+        ++level;
+    }
+
+    for(uint32_t y = rect[1] >> level; y <= rect[3] >> level; ++y)
+    {
+        for(uint32_t x = rect[0] >> level; x <= rect[2] >> level; ++x)
+        {
+            if(!TexelOccluded(level, x, y, rect, nearZ))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool OcclusionBuffer::TexelOccluded(uint32_t level, uint32_t x, uint32_t y, const uint32_t rect[4], float nearZ)const
+{
+    // Behind the farthest occluder in the texel, or in front of the nearest, which
+    // leaves no part of it that can be occluded.
+    if(nearZ > MaxDepth(level, x, y))
+        return true;
+    if(level == 0 || nearZ <= MinDepth(level, x, y))
+        return false;
+
+    // Otherwise every child texel under the rectangle has to be occluded.
+    const uint32_t childLevel = level - 1;
+    const uint32_t childWidth = childLevel == 0 ? mWidth : mLevels[childLevel - 1].Width;
+    const uint32_t childHeight = childLevel == 0 ? mHeight : mLevels[childLevel - 1].Height;
+
+    const uint32_t x0 = std::max(2*x, rect[0] >> childLevel);
+    const uint32_t x1 = std::min(std::min(2*x + 1, rect[2] >> childLevel), childWidth - 1);
+    const uint32_t y0 = std::max(2*y, rect[1] >> childLevel);
+    const uint32_t y1 = std::min(std::min(2*y + 1, rect[3] >> childLevel), childHeight - 1);
+
+    for(uint32_t cy = y0; cy <= y1; ++cy)
+    {
+        for(uint32_t cx = x0; cx <= x1; ++cx)
+        {
+            if(!TexelOccluded(childLevel, cx, cy, rect, nearZ))
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,103 @@
+//***************************************************************************************
+// OcclusionBuffer.h
+//
+// Occlusion culling on the CPU.  A few designated occluders, simplified stand-ins
+// for large nearby objects such as walls, terrain patches or the nearest instances,
+// are rasterized into a small depth buffer.  Over that buffer is a pyramid of levels
+// that each keep the nearest and the farthest depth of 2x2 texels of the level below.
+// A bounding box is occluded if its nearest depth lies behind the farthest occluder
+// depth everywhere it covers on screen.  The test starts at the level where the box
+// covers at most 2x2 texels and only goes down into texels it cannot decide.
+//
+// Triangles are rasterized four pixels at a time with XMVECTOR edge functions.  Depth
+// is z/w of a D3D projection, 0 at the near plane and 1 at the far plane.
+//
+// The buffer only depends on DirectXMath, not on a device, so it runs and can be
+// tested headless, including on Linux with the DirectXMath headers.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+// The triangles of an occluder.  An occluder has to lie inside the object it stands
+// for, or it can hide things in front of that object's surface.
+struct OccluderMesh
+{
+    std::vector<DirectX::XMFLOAT3> Positions;
+    std::vector<uint32_t> Indices;
+
+    // Copies the triangles of indexCount indices of indexSize bytes (2 or 4), with
+    // only the vertices they use.  Vertices are vertexStride bytes apart and start with
+    // a float3 position.
+    void Build(const void* vertices, uint32_t vertexStride, const void* indices, uint32_t indexSize,
+               uint32_t indexCount);
+};
+
+class OcclusionBuffer
+{
+public:
+    // The width is rounded up to a multiple of four.
+    void Resize(uint32_t width, uint32_t height);
+
+    uint32_t Width()const;
+    uint32_t Height()const;
+    uint32_t LevelCount()const;
+
+    // Clears the depth to the far plane, for occluders seen through viewProj.
+    void Clear(DirectX::FXMMATRIX viewProj);
+
+    // Draws the triangles of mesh placed by world, keeping the nearest depth of each
+    // pixel.  Both sides of a triangle are drawn.
+    void DrawOccluder(const OccluderMesh& mesh, DirectX::FXMMATRIX world);
+
+    // Builds the pyramid over the occluders drawn since Clear.
+    void BuildPyramid();
+
+    // True if the box, in the local space of world, is wholly hidden behind the
+    // occluders.  Boxes that reach in front of the near plane, or lie wholly off the
+    // screen, count as visible; of a box partly off the screen only the part on it is
+    // tested.  Call after BuildPyramid.
+    bool IsOccluded(const DirectX::BoundingBox& localBounds, DirectX::FXMMATRIX world)const;
+
+    // Nearest and farthest depth of texel (x, y) of a level; level 0 is the depth
+    // buffer itself.
+    float MinDepth(uint32_t level, uint32_t x, uint32_t y)const;
+    float MaxDepth(uint32_t level, uint32_t x, uint32_t y)const;
+
+private:
+    // A triangle in pixels with its depth in z.
+    void DrawTriangle(const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+
+    // Clip space to pixels and depth.
+    DirectX::XMFLOAT3 ToScreen(DirectX::FXMVECTOR clip)const;
+
+    // True if nearZ is behind every occluder in the part of texel (x, y) of level that
+    // lies in the pixel rectangle rect (min x, min y, max x, max y).
+    bool TexelOccluded(uint32_t level, uint32_t x, uint32_t y, const uint32_t rect[4], float nearZ)const;
+
+    struct Level
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<float> Min;
+        std::vector<float> Max;
+    };
+
+    // Level 0, one depth per pixel.
+    std::vector<float> mDepth;
+
+    // Levels 1 and up.
+    std::vector<Level> mLevels;
+
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+
+    DirectX::XMFLOAT4X4 mViewProj;
+
+    // Clip space vertices of the occluder being drawn.
+    std::vector<DirectX::XMFLOAT4> mClipVertices;
+};
@@ -48,6 +48,27 @@ void PsoLib::Init(ID3D12Device5* device,
         { "BONEINDICES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, 56, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
     };
 
+    // PackedModelVertex and PackedSkinnedVertex (VertexCompression.h).  The input assembler
+    // expands the normalized and half formats; the vertex shader dequantizes the position
+    // and decodes the octahedral normal and tangent.
+    const std::vector<D3D12_INPUT_ELEMENT_DESC> packedModelInputLayout =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+
+    const std::vector<D3D12_INPUT_ELEMENT_DESC> packedSkinnedInputLayout =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "BONEINDICES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC basePsoDesc;
 
@@ -164,6 +185,10 @@ void PsoLib::Init(ID3D12Device5* device,
     smapPsoDesc.NumRenderTargets = 0;
     ThrowIfFailed(device->CreateGraphicsPipelineState(&smapPsoDesc, IID_PPV_ARGS(&mPSOs["shadow_opaque"])));
 
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC instancedSmapPsoDesc = smapPsoDesc;
+    instancedSmapPsoDesc.VS = d3dUtil::ByteCodeFromBlob(shaderLib["instancedShadowVS"]);
+    ThrowIfFailed(device->CreateGraphicsPipelineState(&instancedSmapPsoDesc, IID_PPV_ARGS(&mPSOs["shadow_opaque_instanced"])));
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC skinnedSmapPsoDesc = smapPsoDesc;
     skinnedSmapPsoDesc.InputLayout = { skinnedInputLayout.data(), (UINT)skinnedInputLayout.size() };
     skinnedSmapPsoDesc.VS = d3dUtil::ByteCodeFromBlob(shaderLib["skinnedShadowVS"]);
@@ -214,6 +239,35 @@ void PsoLib::Init(ID3D12Device5* device,
     drawSkinnedBumpedWorldNormalsPsoDesc.PS = d3dUtil::ByteCodeFromBlob(shaderLib["drawBumpedWorldNormalsPS"]);
     ThrowIfFailed(device->CreateGraphicsPipelineState(&drawSkinnedBumpedWorldNormalsPsoDesc, IID_PPV_ARGS(&mPSOs["drawSkinnedBumpedWorldNormals"])));
 
+    //
+    // PSOs for packed vertices.  Same as the ones above, with the packed input layouts
+    // and vertex shaders; named with a "_packed" suffix.
+    //
+    const D3D12_INPUT_LAYOUT_DESC packedModelLayoutDesc = { packedModelInputLayout.data(), (UINT)packedModelInputLayout.size() };
+    const D3D12_INPUT_LAYOUT_DESC packedSkinnedLayoutDesc = { packedSkinnedInputLayout.data(), (UINT)packedSkinnedInputLayout.size() };
+
+    auto createPackedPso = [&](const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, const std::string& name,
+                               const D3D12_INPUT_LAYOUT_DESC& layout, const std::string& vs)
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC packedPsoDesc = desc;
+        packedPsoDesc.InputLayout = layout;
+        packedPsoDesc.VS = d3dUtil::ByteCodeFromBlob(shaderLib[vs]);
+        ThrowIfFailed(device->CreateGraphicsPipelineState(&packedPsoDesc, IID_PPV_ARGS(&mPSOs[name + "_packed"])));
+    };
+
+    createPackedPso(opaquePsoDesc, "opaque", packedModelLayoutDesc, "packedVS");
+    createPackedPso(opaqueWireframePsoDesc, "opaque_wireframe", packedModelLayoutDesc, "packedVS");
+    createPackedPso(opaqueWithPrepassPsoDesc, "opaque_wprepass", packedModelLayoutDesc, "packedVS");
+    createPackedPso(opaqueSkinnedPsoDesc, "skinnedOpaque", packedSkinnedLayoutDesc, "packedSkinnedVS");
+    createPackedPso(opaqueSkinnedWireframePsoDesc, "skinnedOpaque_wireframe", packedSkinnedLayoutDesc, "packedSkinnedVS");
+    createPackedPso(opaqueSkinnedWithPrePassPsoDesc, "skinnedOpaque_wprepass", packedSkinnedLayoutDesc, "packedSkinnedVS");
+    createPackedPso(smapPsoDesc, "shadow_opaque", packedModelLayoutDesc, "packedShadowVS");
+    createPackedPso(skinnedSmapPsoDesc, "skinnedShadow_opaque", packedSkinnedLayoutDesc, "packedSkinnedShadowVS");
+    createPackedPso(drawViewNormalsPsoDesc, "drawViewNormals", packedModelLayoutDesc, "drawPackedNormalsVS");
+    createPackedPso(drawSkinnedViewNormalsPsoDesc, "drawSkinnedViewNormals", packedSkinnedLayoutDesc, "drawPackedSkinnedNormalsVS");
+    createPackedPso(drawBumpedWorldNormalsPsoDesc, "drawBumpedWorldNormals", packedModelLayoutDesc, "drawPackedNormalsVS");
+    createPackedPso(drawSkinnedBumpedWorldNormalsPsoDesc, "drawSkinnedBumpedWorldNormals", packedSkinnedLayoutDesc, "drawPackedSkinnedNormalsVS");
+
     //
     // PSO for SSAO.
     //
@@ -0,0 +1,416 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+
+namespace
+{
+    const UINT LayerBits = 4;
+    const UINT PsoBits = 8;
+    const UINT GeometryBits = 10;
+    const UINT DrawArgsBits = 10;
+    const UINT MaterialBits = 12;
+    const UINT DepthBits = 20;
+
+    const UINT64 DepthMax = (1ull << DepthBits) - 1;
+
+    UINT64 Field(UINT value, UINT bits)
+    {
+        return value & ((1ull << bits) - 1);
+    }
+}
+
+void RadixSortKeys(DrawSortKey* keys, DrawSortKey* scratch, size_t count)
+{
+    if(count < 2)
+        return;
+
+    // Histograms of all eight digits in one pass over the keys.
+    UINT histograms[8][256] = {};
+    for(size_t i = 0; i < count; ++i)
+    {
+        const UINT64 key = keys[i].Key;
+        for(UINT d = 0; d < 8; ++d)
+            histograms[d][(key >> (8*d)) & 0xFF]++;
+    }
+
+    DrawSortKey* src = keys;
+    DrawSortKey* dst = scratch;
+    for(UINT d = 0; d < 8; ++d)
+    {
+        const UINT shift = 8*d;
+        const UINT* histogram = histograms[d];
+        if(histogram[(src[0].Key >> shift) & 0xFF] == count)
+            continue;
+
+        UINT offsets[256];
+        UINT sum = 0;
+        for(UINT b = 0; b < 256; ++b)
+        {
+            offsets[b] = sum;
+            sum += histogram[b];
+        }
+
+        for(size_t i = 0; i < count; ++i)
+            dst[offsets[(src[i].Key >> shift) & 0xFF]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    if(src != keys)
+        std::copy(src, src + count, keys);
+}
+
+CommandListDrawSink::CommandListDrawSink(ID3D12GraphicsCommandList* cmdList, UINT objectCbvRootArg, UINT instanceSrvRootArg) :
+    mCmdList(cmdList),
+    mObjectCbvRootArg(objectCbvRootArg),
+    mInstanceSrvRootArg(instanceSrvRootArg)
+{
+}
+
+void CommandListDrawSink::SetPipelineState(ID3D12PipelineState* pso)
+{
+    mCmdList->SetPipelineState(pso);
+}
+
+void CommandListDrawSink::SetGeometry(const MeshGeometry* geo)
+{
+    const D3D12_VERTEX_BUFFER_VIEW vbv = geo->VertexBufferView();
+    const D3D12_INDEX_BUFFER_VIEW ibv = geo->IndexBufferView();
+    mCmdList->IASetVertexBuffers(0, 1, &vbv);
+    mCmdList->IASetIndexBuffer(&ibv);
+}
+
+void CommandListDrawSink::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    mCmdList->IASetPrimitiveTopology(topology);
+}
+
+void CommandListDrawSink::SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    mCmdList->SetGraphicsRootConstantBufferView(mObjectCbvRootArg, address);
+}
+
+void CommandListDrawSink::SetInstanceData(D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    mCmdList->SetGraphicsRootShaderResourceView(mInstanceSrvRootArg, address);
+}
+
+void CommandListDrawSink::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)
+{
+    mCmdList->DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, baseVertexLocation, 0);
+}
+
+void RecordingDrawSink::SetPipelineState(ID3D12PipelineState* pso)
+{
+    Record record;
+    record.Type = Command::SetPipelineState;
+    record.Object = pso;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::SetGeometry(const MeshGeometry* geo)
+{
+    Record record;
+    record.Type = Command::SetGeometry;
+    record.Object = geo;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    Record record;
+    record.Type = Command::SetPrimitiveTopology;
+    record.Value = (UINT64)topology;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Record record;
+    record.Type = Command::SetObjectConstants;
+    record.Value = address;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::SetInstanceData(D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    Record record;
+    record.Type = Command::SetInstanceData;
+    record.Value = address;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)
+{
+    Record record;
+    record.Type = Command::Draw;
+    record.IndexCount = indexCount;
+    record.InstanceCount = instanceCount;
+    record.StartIndexLocation = startIndexLocation;
+    record.BaseVertexLocation = baseVertexLocation;
+    mRecords.push_back(record);
+    mCounts[(int)record.Type]++;
+}
+
+void RecordingDrawSink::Clear()
+{
+    mRecords.clear();
+    std::fill(std::begin(mCounts), std::end(mCounts), 0);
+}
+
+UINT RecordingDrawSink::CommandCount(Command type)const
+{
+    return mCounts[(int)type];
+}
+
+const std::vector<RecordingDrawSink::Record>& RecordingDrawSink::GetRecords()const
+{
+    return mRecords;
+}
+
+void RenderQueue::SetLayerOrder(UINT layer, DepthOrder order)
+{
+    assert(layer < MaxLayers);
+    mLayerOrders[layer] = order;
+}
+
+void RenderQueue::SetDepthRange(float maxDepth)
+{
+    assert(maxDepth > 0.0f);
+    mDepthScale = 1.0f / maxDepth;
+}
+
+void RenderQueue::SetMinBatchSize(UINT count)
+{
+    mMinBatchSize = count;
+}
+
+void RenderQueue::Clear()
+{
+    mItems.clear();
+    mKeys.clear();
+    mDraws.clear();
+    mInstanceData.clear();
+}
+
+void RenderQueue::Add(const DrawItem& item)
+{
+    assert(item.Layer < MaxLayers);
+    assert(item.Pso != nullptr && item.Geo != nullptr);
+
+    mKeys.push_back({ MakeKey(item), (UINT)mItems.size() });
+    mItems.push_back(item);
+}
+
+void RenderQueue::Build()
+{
+    mScratch.resize(mKeys.size());
+    RadixSortKeys(mKeys.data(), mScratch.data(), mKeys.size());
+
+    mDraws.clear();
+    mInstanceData.clear();
+
+    const UINT count = (UINT)mKeys.size();
+    for(UINT first = 0; first < count; )
+    {
+        const DrawItem& firstItem = mItems[mKeys[first].Item];
+
+        UINT end = first + 1;
+        if(mMinBatchSize > 0 && firstItem.InstancedPso != nullptr && firstItem.Constants != nullptr)
+        {
+            while(end < count && CanBatch(firstItem, mItems[mKeys[end].Item]))
+                ++end;
+        }
+
+        Draw draw;
+        draw.Geo = firstItem.Geo;
+        draw.PrimitiveType = firstItem.PrimitiveType;
+        draw.IndexCount = firstItem.IndexCount;
+        draw.StartIndexLocation = firstItem.StartIndexLocation;
+        draw.BaseVertexLocation = firstItem.BaseVertexLocation;
+
+        if(end - first >= std::max(mMinBatchSize, 2u))
+        {
+            draw.Pso = firstItem.InstancedPso;
+            draw.Batch = true;
+            draw.FirstInstance = (UINT)mInstanceData.size();
+            draw.InstanceCount = end - first;
+            mDraws.push_back(draw);
+
+            // PerObjectCB already holds the matrices transposed for the shaders.
+            for(UINT i = first; i < end; ++i)
+            {
+                const PerObjectCB& constants = *mItems[mKeys[i].Item].Constants;
+
+                InstanceData data;
+                data.World = constants.gWorld;
+                data.TexTransform = constants.gTexTransform;
+                data.MaterialIndex = constants.gMaterialIndex;
+                data.CubeMapIndex = constants.gCubeMapIndex;
+                mInstanceData.push_back(data);
+            }
+        }
+        else
+        {
+            for(UINT i = first; i < end; ++i)
+            {
+                const DrawItem& item = mItems[mKeys[i].Item];
+                draw.Pso = item.Pso;
+                draw.ObjectCB = item.ObjectCB;
+                mDraws.push_back(draw);
+            }
+        }
+
+        first = end;
+    }
+}
+
+UINT RenderQueue::ItemCount()const
+{
+    return (UINT)mItems.size();
+}
+
+const DrawSortKey& RenderQueue::SortedKey(UINT position)const
+{
+    return mKeys[position];
+}
+
+const std::vector<InstanceData>& RenderQueue::GetInstanceData()const
+{
+    return mInstanceData;
+}
+
+RenderQueueStats RenderQueue::Execute(DrawCommandSink& sink, D3D12_GPU_VIRTUAL_ADDRESS instanceData)const
+{
+    RenderQueueStats stats;
+    stats.Items = (UINT)mItems.size();
+
+    ID3D12PipelineState* pso = nullptr;
+    const MeshGeometry* geo = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    D3D12_GPU_VIRTUAL_ADDRESS objectCB = 0;
+
+    for(const Draw& draw : mDraws)
+    {
+        if(draw.Pso != pso)
+        {
+            pso = draw.Pso;
+            sink.SetPipelineState(pso);
+            stats.PsoChanges++;
+        }
+
+        if(draw.Geo != geo)
+        {
+            geo = draw.Geo;
+            sink.SetGeometry(geo);
+            stats.GeometryChanges++;
+        }
+
+        if(draw.PrimitiveType != topology)
+        {
+            topology = draw.PrimitiveType;
+            sink.SetPrimitiveTopology(topology);
+            stats.TopologyChanges++;
+        }
+
+        if(draw.Batch)
+        {
+            // SV_InstanceID starts from zero whatever the start instance, so each batch
+            // binds the buffer at its own first instance.
+            assert(instanceData != 0);
+            sink.SetInstanceData(instanceData + (UINT64)draw.FirstInstance * sizeof(InstanceData));
+            stats.RootArgChanges++;
+            stats.InstancedDraws++;
+            stats.InstancedItems += draw.InstanceCount;
+        }
+        else if(draw.ObjectCB != objectCB)
+        {
+            objectCB = draw.ObjectCB;
+            sink.SetObjectConstants(objectCB);
+            stats.RootArgChanges++;
+        }
+
+        sink.DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.StartIndexLocation, draw.BaseVertexLocation);
+        stats.Draws++;
+    }
+
+    return stats;
+}
+
+UINT64 RenderQueue::MakeKey(const DrawItem& item)
+{
+    GeometryIds& geoIds = GeometryEntry(item.Geo);
+
+    const UINT64 argsKey = ((UINT64)item.StartIndexLocation << 32) | (UINT)item.BaseVertexLocation;
+    auto args = geoIds.DrawArgs.find(argsKey);
+    if(args == geoIds.DrawArgs.end())
+        args = geoIds.DrawArgs.emplace(argsKey, (UINT)geoIds.DrawArgs.size()).first;
+
+    const float depth01 = MathHelper::Clamp(item.Depth * mDepthScale, 0.0f, 1.0f);
+    const UINT64 depth = (UINT64)(depth01 * DepthMax);
+
+    UINT64 state = Field(PsoId(item.Pso), PsoBits);
+    state = (state << GeometryBits) | Field(geoIds.Id, GeometryBits);
+    state = (state << DrawArgsBits) | Field(args->second, DrawArgsBits);
+    state = (state << MaterialBits) | Field(item.MaterialIndex, MaterialBits);
+
+    const UINT64 layer = (UINT64)item.Layer << (64 - LayerBits);
+    if(mLayerOrders[item.Layer] == DepthOrder::BackToFront)
+        return layer | ((DepthMax - depth) << (64 - LayerBits - DepthBits)) | state;
+
+    return layer | (state << DepthBits) | depth;
+}
+
+UINT RenderQueue::PsoId(ID3D12PipelineState* pso)
+{
+    if(pso != mLastPso)
+    {
+        auto it = mPsoIds.find(pso);
+        if(it == mPsoIds.end())
+            it = mPsoIds.emplace(pso, (UINT)mPsoIds.size()).first;
+
+        mLastPso = pso;
+        mLastPsoId = it->second;
+    }
+
+    return mLastPsoId;
+}
+
+RenderQueue::GeometryIds& RenderQueue::GeometryEntry(const MeshGeometry* geo)
+{
+    if(geo != mLastGeo)
+    {
+        auto it = mGeometryIds.find(geo);
+        if(it == mGeometryIds.end())
+        {
+            GeometryIds ids;
+            ids.Id = (UINT)mGeometryIds.size();
+            it = mGeometryIds.emplace(geo, std::move(ids)).first;
+        }
+
+        mLastGeo = geo;
+        mLastGeoIds = &it->second;
+    }
+
+    return *mLastGeoIds;
+}
+
+bool RenderQueue::CanBatch(const DrawItem& first, const DrawItem& item)const
+{
+    return item.Layer == first.Layer &&
+        item.Pso == first.Pso &&
+        item.InstancedPso == first.InstancedPso &&
+        item.Geo == first.Geo &&
+        item.PrimitiveType == first.PrimitiveType &&
+        item.IndexCount == first.IndexCount &&
+        item.StartIndexLocation == first.StartIndexLocation &&
+        item.BaseVertexLocation == first.BaseVertexLocation &&
+        item.Constants != nullptr;
+}
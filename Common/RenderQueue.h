@@ -0,0 +1,264 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// A frame's draws sorted by a 64-bit key and recorded with redundant state changes
+// left out.  Items are added in any order; Build radix sorts their keys and merges
+// runs of items with the same pipeline state and draw arguments into instanced draws
+// that read their per object data from an InstanceData buffer.  Execute records the
+// draws into a DrawCommandSink: a command list in the demos, or a recorder that keeps
+// the commands so state changes can be counted without a GPU.
+//
+// Key, from the most significant bits:
+//
+//   layer 4 | pso 8 | geometry 10 | draw args 10 | material 12 | depth 20
+//
+// so a layer is drawn whole before the next, and within it the draws sharing a PSO,
+// then vertex and index buffers, then a submesh are adjacent and drawn front to back.
+// A layer set to draw back to front moves the inverted depth up under the layer,
+// since for blending the order matters more than the state changes.
+//
+// The PSO, geometry and draw args ids are given out in first-seen order and kept from
+// frame to frame, so draws that sort equal keep a stable order.  Ids past the width of
+// their field wrap; that only loosens the grouping, since batching compares the items
+// themselves.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "../Shaders/SharedTypes.h"
+
+struct DrawItem
+{
+    // Layers are drawn in increasing order; 0 to 15.
+    UINT Layer = 0;
+
+    ID3D12PipelineState* Pso = nullptr;
+
+    // Draws the item with its data read from the InstanceData buffer at SV_InstanceID.
+    // Null if the item is never batched.
+    ID3D12PipelineState* InstancedPso = nullptr;
+
+    const MeshGeometry* Geo = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+    // DrawIndexedInstanced parameters.
+    UINT IndexCount = 0;
+    UINT StartIndexLocation = 0;
+    int BaseVertexLocation = 0;
+
+    UINT MaterialIndex = 0;
+
+    // View space depth of the item.
+    float Depth = 0.0f;
+
+    // The item's constants, bound as the object CBV when drawn alone and copied into
+    // the InstanceData buffer when batched.
+    D3D12_GPU_VIRTUAL_ADDRESS ObjectCB = 0;
+    const PerObjectCB* Constants = nullptr;
+};
+
+struct DrawSortKey
+{
+    UINT64 Key;
+    UINT Item;
+};
+
+// Least significant digit first radix sort of count keys, 8 bits at a time.  Stable,
+// and passes on a digit every key shares are skipped.  scratch holds count keys.
+void RadixSortKeys(DrawSortKey* keys, DrawSortKey* scratch, size_t count);
+
+// Receives the commands RenderQueue::Execute records.
+class DrawCommandSink
+{
+public:
+    virtual ~DrawCommandSink() = default;
+
+    virtual void SetPipelineState(ID3D12PipelineState* pso) = 0;
+    virtual void SetGeometry(const MeshGeometry* geo) = 0;
+    virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void SetInstanceData(D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation) = 0;
+};
+
+// Records into a command list, with the object constants and the instance data bound
+// as root descriptors at the given root parameters.
+class CommandListDrawSink : public DrawCommandSink
+{
+public:
+    CommandListDrawSink(ID3D12GraphicsCommandList* cmdList, UINT objectCbvRootArg, UINT instanceSrvRootArg);
+
+    void SetPipelineState(ID3D12PipelineState* pso)override;
+    void SetGeometry(const MeshGeometry* geo)override;
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+    void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void SetInstanceData(D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)override;
+
+private:
+    ID3D12GraphicsCommandList* mCmdList = nullptr;
+    UINT mObjectCbvRootArg = 0;
+    UINT mInstanceSrvRootArg = 0;
+};
+
+// Keeps the commands, for checking what was recorded.
+class RecordingDrawSink : public DrawCommandSink
+{
+public:
+    enum class Command
+    {
+        SetPipelineState = 0,
+        SetGeometry,
+        SetPrimitiveTopology,
+        SetObjectConstants,
+        SetInstanceData,
+        Draw,
+        Count
+    };
+
+    struct Record
+    {
+        Command Type = Command::Draw;
+
+        // The PSO or geometry set.
+        const void* Object = nullptr;
+
+        // The topology or GPU address set.
+        UINT64 Value = 0;
+
+        // Draw parameters.
+        UINT IndexCount = 0;
+        UINT InstanceCount = 0;
+        UINT StartIndexLocation = 0;
+        int BaseVertexLocation = 0;
+    };
+
+    void SetPipelineState(ID3D12PipelineState* pso)override;
+    void SetGeometry(const MeshGeometry* geo)override;
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+    void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void SetInstanceData(D3D12_GPU_VIRTUAL_ADDRESS address)override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndexLocation, int baseVertexLocation)override;
+
+    void Clear();
+
+    UINT CommandCount(Command type)const;
+    const std::vector<Record>& GetRecords()const;
+
+private:
+    std::vector<Record> mRecords;
+    UINT mCounts[(int)Command::Count] = {};
+};
+
+struct RenderQueueStats
+{
+    UINT Items = 0;
+    UINT Draws = 0;
+
+    // Draws of batched items, and the items they draw.
+    UINT InstancedDraws = 0;
+    UINT InstancedItems = 0;
+
+    UINT PsoChanges = 0;
+    UINT GeometryChanges = 0;
+    UINT TopologyChanges = 0;
+
+    // Object CBV and instance data SRV changes.
+    UINT RootArgChanges = 0;
+};
+
+enum class DepthOrder
+{
+    FrontToBack = 0,
+    BackToFront
+};
+
+class RenderQueue
+{
+public:
+    RenderQueue() = default;
+    RenderQueue(const RenderQueue& rhs) = delete;
+    RenderQueue& operator=(const RenderQueue& rhs) = delete;
+
+    static const UINT MaxLayers = 16;
+
+    void SetLayerOrder(UINT layer, DepthOrder order);
+
+    // Depths from 0 to maxDepth span the depth bits of the key; farther ones are clamped.
+    void SetDepthRange(float maxDepth);
+
+    // Runs of at least this many batchable items become one instanced draw; 0 turns
+    // batching off.
+    void SetMinBatchSize(UINT count);
+
+    void Clear();
+    void Add(const DrawItem& item);
+
+    // Sorts the items added since Clear and forms the draws.
+    void Build();
+
+    UINT ItemCount()const;
+
+    // Key at the given position of the sorted order, with the index of its item in the
+    // order added.
+    const DrawSortKey& SortedKey(UINT position)const;
+
+    // Per instance data of the batched draws, for the caller to copy to GPU memory and
+    // pass the address of to Execute.  Empty if nothing was batched.
+    const std::vector<InstanceData>& GetInstanceData()const;
+
+    // Records the draws of the last Build.  Nothing is assumed about the state the sink
+    // starts in, and the last state set is left bound.
+    RenderQueueStats Execute(DrawCommandSink& sink, D3D12_GPU_VIRTUAL_ADDRESS instanceData)const;
+
+private:
+    struct Draw
+    {
+        ID3D12PipelineState* Pso = nullptr;
+        const MeshGeometry* Geo = nullptr;
+        D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        UINT IndexCount = 0;
+        UINT StartIndexLocation = 0;
+        int BaseVertexLocation = 0;
+
+        // A batch reads its instances from the instance data instead of ObjectCB.
+        bool Batch = false;
+        D3D12_GPU_VIRTUAL_ADDRESS ObjectCB = 0;
+        UINT FirstInstance = 0;
+        UINT InstanceCount = 1;
+    };
+
+    struct GeometryIds
+    {
+        UINT Id = 0;
+
+        // Keyed by start index and base vertex.
+        std::unordered_map<UINT64, UINT> DrawArgs;
+    };
+
+    UINT64 MakeKey(const DrawItem& item);
+    UINT PsoId(ID3D12PipelineState* pso);
+    GeometryIds& GeometryEntry(const MeshGeometry* geo);
+    bool CanBatch(const DrawItem& first, const DrawItem& item)const;
+
+    DepthOrder mLayerOrders[MaxLayers] = {};
+    float mDepthScale = 1.0f / 1000.0f;
+    UINT mMinBatchSize = 2;
+
+    std::vector<DrawItem> mItems;
+    std::vector<DrawSortKey> mKeys;
+    std::vector<DrawSortKey> mScratch;
+
+    std::vector<Draw> mDraws;
+    std::vector<InstanceData> mInstanceData;
+
+    std::unordered_map<const void*, UINT> mPsoIds;
+    std::unordered_map<const void*, GeometryIds> mGeometryIds;
+
+    // The last lookups, since consecutive items mostly share them.
+    ID3D12PipelineState* mLastPso = nullptr;
+    UINT mLastPsoId = 0;
+    const MeshGeometry* mLastGeo = nullptr;
+    GeometryIds* mLastGeoIds = nullptr;
+};
@@ -33,6 +33,10 @@ void ShaderLib::Init(ID3D12Device* device)
 
     std::vector<LPCWSTR> vsSkinnedArgs = std::vector<LPCWSTR> { L"-E", L"VS", L"-T", L"vs_6_6", L"-D SKINNED=1" COMMA_DEBUG_ARGS };
 
+    // Vertex shaders that read the PackedModelVertex/PackedSkinnedVertex layouts of VertexCompression.
+    std::vector<LPCWSTR> vsPackedArgs = std::vector<LPCWSTR> { L"-E", L"VS", L"-T", L"vs_6_6", L"-D PACKED_VERTEX=1" COMMA_DEBUG_ARGS };
+    std::vector<LPCWSTR> vsPackedSkinnedArgs = std::vector<LPCWSTR> { L"-E", L"VS", L"-T", L"vs_6_6", L"-D PACKED_VERTEX=1", L"-D SKINNED=1" COMMA_DEBUG_ARGS };
+
     std::vector<LPCWSTR> vsDrawInstancedArgs = std::vector<LPCWSTR> { L"-E", L"VS", L"-T", L"vs_6_6", L"-D DRAW_INSTANCED=1" COMMA_DEBUG_ARGS };
     std::vector<LPCWSTR> psDrawInstancedArgs = std::vector<LPCWSTR> { L"-E", L"PS", L"-T", L"ps_6_6", L"-D DRAW_INSTANCED=1" COMMA_DEBUG_ARGS };
 
@@ -53,15 +57,23 @@ void ShaderLib::Init(ID3D12Device* device)
     mShaders["shadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", vsArgs);
     mShaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", psArgs);
     mShaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", psAlphaTestedArgs);
+    mShaders["instancedShadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", vsDrawInstancedArgs);
 
     mShaders["skinnedVS"] = d3dUtil::CompileShader(L"Shaders\\DefaultGeo.hlsl", vsSkinnedArgs);
     mShaders["skinnedShadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", vsSkinnedArgs);
 
+    mShaders["packedVS"] = d3dUtil::CompileShader(L"Shaders\\DefaultGeo.hlsl", vsPackedArgs);
+    mShaders["packedShadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", vsPackedArgs);
+    mShaders["packedSkinnedVS"] = d3dUtil::CompileShader(L"Shaders\\DefaultGeo.hlsl", vsPackedSkinnedArgs);
+    mShaders["packedSkinnedShadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", vsPackedSkinnedArgs);
+
     mShaders["debugVS"] = d3dUtil::CompileShader(L"Shaders\\DebugTex.hlsl", vsArgs);
     mShaders["debugPS"] = d3dUtil::CompileShader(L"Shaders\\DebugTex.hlsl", psArgs);
 
     mShaders["drawNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", vsArgs);
     mShaders["drawSkinnedNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", vsSkinnedArgs);
+    mShaders["drawPackedNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", vsPackedArgs);
+    mShaders["drawPackedSkinnedNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", vsPackedSkinnedArgs);
 
     mShaders["drawViewNormalsPS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", drawViewspaceNormalsPsArgs);
     mShaders["drawBumpedWorldNormalsPS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", drawBumpedWorldNormalsPsArgs);
@@ -1,7 +1,34 @@
 #include "SkinnedData.h"
+#include "TaskPool.h"
 
 using namespace DirectX;
 
+namespace
+{
+	// Per-thread scratch for the to-parent and to-root matrices.  It only ever grows,
+	// so once it holds the bone count no more memory is allocated while skinning.
+	struct SkinningScratch
+	{
+		std::vector<XMFLOAT4X4> ToParent;
+		std::vector<XMFLOAT4X4> ToRoot;
+
+		// Accumulated and current layer for layered poses.
+		LocalPose Pose;
+		LocalPose LayerPose;
+
+		void Reserve(UINT numBones)
+		{
+			if(ToParent.size() < numBones)
+			{
+				ToParent.resize(numBones);
+				ToRoot.resize(numBones);
+			}
+		}
+	};
+
+	thread_local SkinningScratch tSkinningScratch;
+}
+
 Keyframe::Keyframe()
 	: TimePos(0.0f),
 	Translation(0.0f, 0.0f, 0.0f),
@@ -29,52 +56,50 @@ float BoneAnimation::GetEndTime()const
 }
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	XMVECTOR S, Q, P;
+	Interpolate(t, S, Q, P);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+}
+
+void BoneAnimation::Interpolate(float t, XMVECTOR& S, XMVECTOR& Q, XMVECTOR& P)const
 {
 	if( t <= Keyframes.front().TimePos )
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		S = XMLoadFloat3(&Keyframes.front().Scale);
+		P = XMLoadFloat3(&Keyframes.front().Translation);
+		Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
 	}
 	else if( t >= Keyframes.back().TimePos )
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		S = XMLoadFloat3(&Keyframes.back().Scale);
+		P = XMLoadFloat3(&Keyframes.back().Translation);
+		Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
 	}
 	else
 	{
-		for(UINT i = 0; i < Keyframes.size()-1; ++i)
-		{
-			if( t >= Keyframes[i].TimePos && t <= Keyframes[i+1].TimePos )
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
-
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
+		// Keyframes are sorted by time, so binary search for the first key after t.
+		// The checks above guarantee 0 < i < Keyframes.size().
+		auto next = std::upper_bound(Keyframes.begin(), Keyframes.end(), t,
+			[](float time, const Keyframe& key) { return time < key.TimePos; });
+		size_t i = (next - Keyframes.begin()) - 1;
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
 
-				break;
-			}
-		}
+		S = XMVectorLerp(s0, s1, lerpPercent);
+		P = XMVectorLerp(p0, p1, lerpPercent);
+		Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 	}
 }
 
@@ -112,14 +137,62 @@ void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms
 
 float SkinnedData::GetClipStartTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipStartTime();
+	return GetClipStartTime(FindClip(clipName));
 }
 
 float SkinnedData::GetClipEndTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipEndTime();
+	return GetClipEndTime(FindClip(clipName));
+}
+
+AnimationClipHandle SkinnedData::FindClip(const std::string& clipName)const
+{
+	auto it = mClipHandles.find(clipName);
+	return it != mClipHandles.end() ? it->second : InvalidAnimationClip;
+}
+
+float SkinnedData::GetClipStartTime(AnimationClipHandle clip)const
+{
+	const ClipData& data = mClips[clip];
+	return data.IsCompressed ? data.Compressed.GetClipStartTime() : data.Compiled.GetClipStartTime();
+}
+
+float SkinnedData::GetClipEndTime(AnimationClipHandle clip)const
+{
+	const ClipData& data = mClips[clip];
+	return data.IsCompressed ? data.Compressed.GetClipEndTime() : data.Compiled.GetClipEndTime();
+}
+
+const std::vector<int>& SkinnedData::GetBoneHierarchy()const
+{
+	return mBoneHierarchy;
+}
+
+AnimationClipHandle SkinnedData::MakeAdditiveClip(const std::string& name, AnimationClipHandle clip,
+	AnimationClipHandle referenceClip, float referenceTime)
+{
+	LocalPose reference;
+	SamplePose(referenceClip, referenceTime, nullptr, reference);
+
+	// Additive clips are always compiled; a compressed source is expanded first.
+	ClipData additive;
+	if(mClips[clip].IsCompressed)
+	{
+		AnimationClip source;
+		mClips[clip].Compressed.Decompress(source);
+		additive.Compiled.Build(source);
+	}
+	else
+	{
+		additive.Compiled = mClips[clip].Compiled;
+	}
+	additive.Compiled.MakeAdditive(reference);
+
+	AnimationClipHandle handle = (AnimationClipHandle)mClips.size();
+	mClips.push_back(std::move(additive));
+	mClipHandles[name] = handle;
+
+	return handle;
 }
 
 UINT SkinnedData::BoneCount()const
@@ -129,29 +202,172 @@ UINT SkinnedData::BoneCount()const
 
 void SkinnedData::Set(std::vector<int>& boneHierarchy, 
 		              std::vector<XMFLOAT4X4>& boneOffsets,
-		              std::unordered_map<std::string, AnimationClip>& animations)
+		              std::unordered_map<std::string, AnimationClip>& animations,
+		              const AnimationCompressionSettings* compression)
 {
 	mBoneHierarchy = boneHierarchy;
 	mBoneOffsets   = boneOffsets;
-	mAnimations    = animations;
+
+	mClips.clear();
+	mClipHandles.clear();
+	for(const auto& [clipName, clip] : animations)
+	{
+		mClipHandles[clipName] = (AnimationClipHandle)mClips.size();
+
+		ClipData& data = mClips.emplace_back();
+		if(compression != nullptr)
+		{
+			data.IsCompressed = true;
+			data.Compressed.Compress(clip, *compression);
+		}
+		else
+		{
+			data.Compiled.Build(clip);
+		}
+	}
+}
+
+const CompressedAnimationClip* SkinnedData::GetCompressedClip(AnimationClipHandle clip)const
+{
+	return mClips[clip].IsCompressed ? &mClips[clip].Compressed : nullptr;
 }
  
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
 {
-	UINT numBones = (UINT)mBoneOffsets.size();
+	// Interpolate all the bones of this clip at the given time instance, from the
+	// compressed or the float tracks, whichever the clip is stored as.
+	AnimationClipHandle clip = FindClip(clipName);
+	assert(clip != InvalidAnimationClip);
+	if(clip == InvalidAnimationClip)
+		return;
+
+	GetFinalTransforms(clip, timePos, nullptr, finalTransforms.data());
+}
+
+void SkinnedData::GetFinalTransforms(AnimationClipHandle clip, float timePos, AnimationCursor* cursor,
+	XMFLOAT4X4* finalTransforms)const
+{
+	assert(clip < mClips.size());
+
+	SkinningScratch& scratch = tSkinningScratch;
+	scratch.Reserve(BoneCount());
+
+	const ClipData& data = mClips[clip];
+	if(data.IsCompressed)
+		data.Compressed.Interpolate(timePos, scratch.ToParent.data());
+	else
+		data.Compiled.Interpolate(timePos, scratch.ToParent.data(), cursor);
+
+	CalcFinalTransforms(scratch.ToParent.data(), scratch.ToRoot.data(), finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(Span<const SkinnedPoseRequest> requests,
+	Span<XMFLOAT4X4> finalTransforms, TaskPool* pool)const
+{
+	const UINT numBones = BoneCount();
+	const UINT numInstances = (UINT)requests.size();
+	assert(finalTransforms.size() >= (size_t)numInstances * numBones);
+
+	auto poseInstances = [&](UINT begin, UINT end)
+	{
+		for(UINT i = begin; i < end; ++i)
+		{
+			const SkinnedPoseRequest& request = requests[i];
+			GetFinalTransforms(request.Clip, request.TimePos, request.Cursor,
+				finalTransforms.data() + (size_t)i * numBones);
+		}
+	};
+
+	// A skeleton takes a few microseconds, so hand out instances in small batches.
+	const UINT instancesPerTask = 8;
+	if(pool != nullptr)
+		pool->ParallelFor(numInstances, instancesPerTask, poseInstances);
+	else
+		poseInstances(0, numInstances);
+}
+
+void SkinnedData::SamplePose(AnimationClipHandle clip, float timePos, AnimationCursor* cursor, LocalPose& pose)const
+{
+	assert(clip < mClips.size());
+
+	const ClipData& data = mClips[clip];
+	if(data.IsCompressed)
+		data.Compressed.SamplePose(timePos, pose);
+	else
+		data.Compiled.SamplePose(timePos, pose, cursor);
+}
+
+void SkinnedData::GetFinalTransforms(const LocalPose& pose, XMFLOAT4X4* finalTransforms)const
+{
+	assert(pose.BoneCount() == BoneCount());
 
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	SkinningScratch& scratch = tSkinningScratch;
+	scratch.Reserve(BoneCount());
 
-	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+	pose.ToTransforms(scratch.ToParent.data());
+
+	CalcFinalTransforms(scratch.ToParent.data(), scratch.ToRoot.data(), finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(const AnimationLayer* layers, UINT numLayers, XMFLOAT4X4* finalTransforms)const
+{
+	assert(numLayers > 0);
+
+	SkinningScratch& scratch = tSkinningScratch;
+	scratch.Reserve(BoneCount());
+
+	SamplePose(layers[0].Clip, layers[0].TimePos, layers[0].Cursor, scratch.Pose);
+
+	for(UINT i = 1; i < numLayers; ++i)
+	{
+		const AnimationLayer& layer = layers[i];
+		if(layer.Weight <= 0.0f)
+			continue;
+
+		SamplePose(layer.Clip, layer.TimePos, layer.Cursor, scratch.LayerPose);
+
+		if(layer.Mode == AnimationBlendMode::Additive)
+			scratch.Pose.Add(scratch.Pose, scratch.LayerPose, layer.Weight, layer.Mask);
+		else
+			scratch.Pose.Blend(scratch.Pose, scratch.LayerPose, layer.Weight, layer.Mask);
+	}
+
+	GetFinalTransforms(scratch.Pose, finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(Span<const LayeredPoseRequest> requests,
+	Span<XMFLOAT4X4> finalTransforms, TaskPool* pool)const
+{
+	const UINT numBones = BoneCount();
+	const UINT numInstances = (UINT)requests.size();
+	assert(finalTransforms.size() >= (size_t)numInstances * numBones);
+
+	auto poseInstances = [&](UINT begin, UINT end)
+	{
+		for(UINT i = begin; i < end; ++i)
+		{
+			const LayeredPoseRequest& request = requests[i];
+			GetFinalTransforms(request.Layers, request.NumLayers,
+				finalTransforms.data() + (size_t)i * numBones);
+		}
+	};
+
+	const UINT instancesPerTask = 8;
+	if(pool != nullptr)
+		pool->ParallelFor(numInstances, instancesPerTask, poseInstances);
+	else
+		poseInstances(0, numInstances);
+}
+
+void SkinnedData::CalcFinalTransforms(const XMFLOAT4X4* toParentTransforms,
+	XMFLOAT4X4* toRootTransforms, XMFLOAT4X4* finalTransforms)const
+{
+	UINT numBones = (UINT)mBoneOffsets.size();
 
 	//
 	// Traverse the hierarchy and transform all the bones to the root space.
 	//
 
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
-
 	// The root bone has index 0.  The root bone has no parent, so its toRootTransform
 	// is just its local bone transform.
 	toRootTransforms[0] = toParentTransforms[0];
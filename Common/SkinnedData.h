@@ -3,6 +3,10 @@
 
 #include "d3dUtil.h"
 #include "MathHelper.h"
+#include "AnimationSampler.h"
+#include "AnimationCompression.h"
+
+class TaskPool;
 
 ///<summary>
 /// A Keyframe defines the bone transformation at an instant in time.
@@ -32,6 +36,10 @@ struct BoneAnimation
 
     void Interpolate(float t, DirectX::XMFLOAT4X4& M)const;
 
+	// Same as above, but returns the scale, rotation quaternion and translation
+	// instead of composing them into a matrix.
+	void Interpolate(float t, DirectX::XMVECTOR& S, DirectX::XMVECTOR& Q, DirectX::XMVECTOR& P)const;
+
 	std::vector<Keyframe> Keyframes; 	
 };
 
@@ -50,6 +58,62 @@ struct AnimationClip
     std::vector<BoneAnimation> BoneAnimations; 	
 };
 
+///<summary>
+/// Index of a clip inside a SkinnedData.  Resolve it once with SkinnedData::FindClip
+/// so per frame code does not hash clip names.
+///</summary>
+using AnimationClipHandle = UINT;
+inline constexpr AnimationClipHandle InvalidAnimationClip = UINT(-1);
+
+///<summary>
+/// One character instance to pose with SkinnedData::GetFinalTransforms.
+///</summary>
+struct SkinnedPoseRequest
+{
+	AnimationClipHandle Clip = InvalidAnimationClip;
+	float TimePos = 0.0f;
+
+	// Optional per instance key cursor, see AnimationCursor.
+	AnimationCursor* Cursor = nullptr;
+};
+
+enum class AnimationBlendMode
+{
+	// Blend from the layers below toward this layer's pose by Weight.
+	Override,
+
+	// Add this layer's difference pose (see SkinnedData::MakeAdditiveClip) on top
+	// of the layers below, scaled by Weight.
+	Additive
+};
+
+///<summary>
+/// One layer of a layered pose.  Layers are applied bottom up; the first layer's
+/// Mode and Weight are ignored since there is nothing below it to blend with.
+///</summary>
+struct AnimationLayer
+{
+	AnimationClipHandle Clip = InvalidAnimationClip;
+	float TimePos = 0.0f;
+	float Weight = 1.0f;
+	AnimationBlendMode Mode = AnimationBlendMode::Override;
+
+	// Optional, restricts the layer to part of the skeleton.
+	const BoneMask* Mask = nullptr;
+
+	// Optional per instance key cursor, see AnimationCursor.
+	AnimationCursor* Cursor = nullptr;
+};
+
+///<summary>
+/// One character instance to pose from a stack of layers.
+///</summary>
+struct LayeredPoseRequest
+{
+	const AnimationLayer* Layers = nullptr;
+	UINT NumLayers = 0;
+};
+
 class SkinnedData
 {
 public:
@@ -59,10 +123,31 @@ public:
 	float GetClipStartTime(const std::string& clipName)const;
 	float GetClipEndTime(const std::string& clipName)const;
 
+	// Returns InvalidAnimationClip if there is no clip with that name.
+	AnimationClipHandle FindClip(const std::string& clipName)const;
+
+	float GetClipStartTime(AnimationClipHandle clip)const;
+	float GetClipEndTime(AnimationClipHandle clip)const;
+
+	const std::vector<int>& GetBoneHierarchy()const;
+
+	// Adds a copy of clip stored as the difference from referenceClip's pose at
+	// referenceTime, for use in AnimationBlendMode::Additive layers.  The new clip can
+	// only be used through its handle.
+	AnimationClipHandle MakeAdditiveClip(const std::string& name, AnimationClipHandle clip,
+		AnimationClipHandle referenceClip, float referenceTime);
+
+	// When compression is not null every clip is stored as a CompressedAnimationClip
+	// instead of a CompiledAnimationClip.  That uses a fraction
+	// of the memory but samples slower.
 	void Set(
 		std::vector<int>& boneHierarchy, 
 		std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
-		std::unordered_map<std::string, AnimationClip>& animations);
+		std::unordered_map<std::string, AnimationClip>& animations,
+		const AnimationCompressionSettings* compression = nullptr);
+
+	// Returns null if the clip is not stored compressed.
+	const CompressedAnimationClip* GetCompressedClip(AnimationClipHandle clip)const;
 
 	 // In a real project, you'd want to cache the result if there was a chance
 	 // that you were calling this several times with the same clipName at 
@@ -70,13 +155,58 @@ public:
     void GetFinalTransforms(const std::string& clipName, float timePos, 
 		 std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
 
+	void GetFinalTransforms(AnimationClipHandle clip, float timePos, AnimationCursor* cursor,
+		DirectX::XMFLOAT4X4* finalTransforms)const;
+
+	// Poses many instances at once.  The final transforms of instance i are written to
+	// finalTransforms[i*BoneCount()] through finalTransforms[(i+1)*BoneCount()-1], so
+	// finalTransforms can point straight at a mapped upload buffer.  Work is split
+	// across the pool's threads when pool is not null.  Intermediate matrices live in
+	// per-thread scratch memory, so once that has grown to the bone count this does
+	// not allocate.
+	void GetFinalTransforms(Span<const SkinnedPoseRequest> requests,
+		Span<DirectX::XMFLOAT4X4> finalTransforms, TaskPool* pool = nullptr)const;
+
+	//
+	// Pose pipeline: sample clips into LocalPoses, combine them with LocalPose::Blend
+	// and LocalPose::Add, then build the matrices once from the final pose.
+	//
+
+	void SamplePose(AnimationClipHandle clip, float timePos, AnimationCursor* cursor, LocalPose& pose)const;
+	void GetFinalTransforms(const LocalPose& pose, DirectX::XMFLOAT4X4* finalTransforms)const;
+
+	// Samples and combines the layers in local space and builds matrices only for
+	// the result.
+	void GetFinalTransforms(const AnimationLayer* layers, UINT numLayers,
+		DirectX::XMFLOAT4X4* finalTransforms)const;
+
+	// Batched version of the above; same output layout as the SkinnedPoseRequest version.
+	void GetFinalTransforms(Span<const LayeredPoseRequest> requests,
+		Span<DirectX::XMFLOAT4X4> finalTransforms, TaskPool* pool = nullptr)const;
+
+private:
+	// Walks the hierarchy and writes the transposed final transforms.  toRootTransforms
+	// is scratch space for BoneCount() matrices.
+	void CalcFinalTransforms(const DirectX::XMFLOAT4X4* toParentTransforms,
+		DirectX::XMFLOAT4X4* toRootTransforms, DirectX::XMFLOAT4X4* finalTransforms)const;
+
 private:
     // Gives parentIndex of ith bone.
 	std::vector<int> mBoneHierarchy;
 
 	std::vector<DirectX::XMFLOAT4X4> mBoneOffsets;
    
-	std::unordered_map<std::string, AnimationClip> mAnimations;
+	// Either the compiled or the compressed copy of a clip passed to Set.
+	struct ClipData
+	{
+		bool IsCompressed = false;
+		CompiledAnimationClip Compiled;
+		CompressedAnimationClip Compressed;
+	};
+
+	// Indexed by AnimationClipHandle.
+	std::vector<ClipData> mClips;
+	std::unordered_map<std::string, AnimationClipHandle> mClipHandles;
 };
  
 #endif // SKINNEDDATA_H
\ No newline at end of file
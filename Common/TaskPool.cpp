@@ -0,0 +1,212 @@
+#include "d3dUtil.h"
+#include "TaskPool.h"
+
+namespace
+{
+    // Which pool owns the current thread and the thread's index in that pool.
+    thread_local const TaskPool* tCurrentPool = nullptr;
+    thread_local UINT tCurrentThreadIndex = 0;
+}
+
+bool TaskPool::TaskQueue::PushBack(const Task& task)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if(Count == Capacity)
+        return false;
+
+    Tasks[(Head + Count) % Capacity] = task;
+    ++Count;
+    return true;
+}
+
+bool TaskPool::TaskQueue::PopBack(Task& task)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if(Count == 0)
+        return false;
+
+    --Count;
+    task = Tasks[(Head + Count) % Capacity];
+    return true;
+}
+
+bool TaskPool::TaskQueue::PopFront(Task& task)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if(Count == 0)
+        return false;
+
+    task = Tasks[Head];
+    Head = (Head + 1) % Capacity;
+    --Count;
+    return true;
+}
+
+TaskPool::TaskPool(UINT numThreads)
+{
+    if(numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    mThreadCount = numThreads;
+    mQueues = std::make_unique<TaskQueue[]>(mThreadCount);
+
+    for(UINT i = 1; i < mThreadCount; ++i)
+        mWorkers.emplace_back(&TaskPool::WorkerMain, this, i);
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mShutdown = true;
+    }
+    mWakeCondition.notify_all();
+
+    for(std::thread& worker : mWorkers)
+        worker.join();
+}
+
+UINT TaskPool::ThreadCount()const
+{
+    return mThreadCount;
+}
+
+UINT TaskPool::CurrentThreadIndex()const
+{
+    return tCurrentPool == this ? tCurrentThreadIndex : 0;
+}
+
+TaskPool& TaskPool::Default()
+{
+    static TaskPool pool;
+    return pool;
+}
+
+void TaskPool::Run(UINT count, UINT grainSize, TaskFn fn, void* context)
+{
+    if(count == 0)
+        return;
+
+    grainSize = std::max(1u, grainSize);
+    if(mThreadCount == 1 || count <= grainSize)
+    {
+        fn(context, 0, count);
+        return;
+    }
+
+    std::atomic<UINT> pending = 0;
+
+    // Queue every chunk but the first on this thread's ring; idle threads steal them.
+    for(UINT begin = grainSize; begin < count; begin += grainSize)
+    {
+        Task task;
+        task.Fn = fn;
+        task.Context = context;
+        task.Begin = begin;
+        task.End = std::min(begin + grainSize, count);
+        task.Pending = &pending;
+
+        pending.fetch_add(1, std::memory_order_relaxed);
+        Push(task);
+    }
+
+    WakeWorkers();
+
+    fn(context, 0, std::min(grainSize, count));
+
+    // Help out until every chunk of this call is done.  Tasks picked up here may
+    // belong to other ParallelFor calls, which is fine; they all must finish anyway.
+    WaitFor(pending);
+}
+
+void TaskPool::Spawn(TaskFn fn, void* context, UINT begin, UINT end, std::atomic<UINT>& pending)
+{
+    Task task;
+    task.Fn = fn;
+    task.Context = context;
+    task.Begin = begin;
+    task.End = end;
+    task.Pending = &pending;
+
+    pending.fetch_add(1, std::memory_order_relaxed);
+    Push(task);
+    WakeWorkers();
+}
+
+void TaskPool::WaitFor(const std::atomic<UINT>& pending)
+{
+    const UINT threadIndex = CurrentThreadIndex();
+    while(pending.load(std::memory_order_acquire) > 0)
+    {
+        Task task;
+        if(FindTask(threadIndex, task))
+            Execute(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void TaskPool::Push(const Task& task)
+{
+    mQueuedTasks.fetch_add(1);
+    if(!mQueues[CurrentThreadIndex()].PushBack(task))
+    {
+        // Ring is full, so just do the work here.
+        mQueuedTasks.fetch_sub(1);
+        Execute(task);
+    }
+}
+
+void TaskPool::WakeWorkers()
+{
+    if(mWorkers.empty())
+        return;
+
+    // Taking the lock orders the counter update with a worker that is about to sleep.
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+    }
+    mWakeCondition.notify_all();
+}
+
+bool TaskPool::FindTask(UINT threadIndex, Task& task)
+{
+    bool found = mQueues[threadIndex].PopBack(task);
+    for(UINT i = 1; i < mThreadCount && !found; ++i)
+    {
+        UINT victim = (threadIndex + i) % mThreadCount;
+        found = mQueues[victim].PopFront(task);
+    }
+
+    if(found)
+        mQueuedTasks.fetch_sub(1);
+
+    return found;
+}
+
+void TaskPool::Execute(const Task& task)
+{
+    task.Fn(task.Context, task.Begin, task.End);
+    task.Pending->fetch_sub(1, std::memory_order_release);
+}
+
+void TaskPool::WorkerMain(UINT threadIndex)
+{
+    tCurrentPool = this;
+    tCurrentThreadIndex = threadIndex;
+
+    for(;;)
+    {
+        Task task;
+        if(FindTask(threadIndex, task))
+        {
+            Execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWakeCondition.wait(lock, [this]() { return mShutdown || mQueuedTasks.load() > 0; });
+        if(mShutdown)
+            return;
+    }
+}
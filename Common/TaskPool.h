@@ -0,0 +1,112 @@
+//***************************************************************************************
+// TaskPool.h
+//
+// Small portable work-stealing thread pool for data parallel CPU work (skinning,
+// simulation, culling).  Every thread has its own bounded task ring; a thread pops
+// its newest task and, when its ring runs dry, steals the oldest task of another
+// thread.  The thread that calls ParallelFor takes part in the work, so nested
+// ParallelFor calls from inside a task are fine.
+//
+// Tasks are a function pointer, a context pointer and an index range, so queuing
+// work never allocates.  Spawn queues a single task without waiting for it, for work
+// that is not a loop, such as the jobs of a JobGraph.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool
+{
+public:
+    using TaskFn = void(*)(void* context, UINT begin, UINT end);
+
+    // numThreads counts the calling thread, so TaskPool(4) starts three workers.
+    // Zero picks std::thread::hardware_concurrency().
+    explicit TaskPool(UINT numThreads = 0);
+    TaskPool(const TaskPool& rhs) = delete;
+    TaskPool& operator=(const TaskPool& rhs) = delete;
+    ~TaskPool();
+
+    // Number of threads that execute tasks, including the caller of ParallelFor.
+    UINT ThreadCount()const;
+
+    // Index in [0, ThreadCount()) of the calling thread.  Worker threads of this pool
+    // get 1..ThreadCount()-1; every other thread gets 0.  Use it to pick per-thread
+    // scratch memory inside a task.
+    UINT CurrentThreadIndex()const;
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most grainSize items and
+    // returns once every chunk has finished.
+    template<typename Fn>
+    void ParallelFor(UINT count, UINT grainSize, const Fn& fn)
+    {
+        Run(count, grainSize,
+            [](void* context, UINT begin, UINT end) { (*static_cast<const Fn*>(context))(begin, end); },
+            const_cast<Fn*>(&fn));
+    }
+
+    // Queues fn(context, begin, end) to run on some thread of the pool and returns at
+    // once.  pending is incremented now and decremented once the call has returned,
+    // so one counter can track many spawned calls.  A spawned call may spawn more.
+    void Spawn(TaskFn fn, void* context, UINT begin, UINT end, std::atomic<UINT>& pending);
+
+    // Runs queued tasks, of any caller, until pending drops to zero.
+    void WaitFor(const std::atomic<UINT>& pending);
+
+    // Process wide pool sized to the machine, created on first use.
+    static TaskPool& Default();
+
+private:
+    struct Task
+    {
+        TaskFn Fn = nullptr;
+        void* Context = nullptr;
+        UINT Begin = 0;
+        UINT End = 0;
+        std::atomic<UINT>* Pending = nullptr;
+    };
+
+    // Bounded ring with one mutex for both ends: the owner pushes and pops at the
+    // back and thieves take from the front, but every operation takes the lock.
+    // Each thread has its own ring, so owners only contend with thieves, which only
+    // steal once their own ring is empty.
+    struct TaskQueue
+    {
+        static constexpr UINT Capacity = 1024;
+
+        std::mutex Mutex;
+        Task Tasks[Capacity];
+        UINT Head = 0;
+        UINT Count = 0;
+
+        bool PushBack(const Task& task);
+        bool PopBack(Task& task);
+        bool PopFront(Task& task);
+    };
+
+    void Run(UINT count, UINT grainSize, TaskFn fn, void* context);
+
+    // Queues a task on the calling thread's ring, or runs it here if the ring is full.
+    void Push(const Task& task);
+    void WakeWorkers();
+    void WorkerMain(UINT threadIndex);
+
+    // Pops from the given thread's own queue, otherwise steals from the others.
+    bool FindTask(UINT threadIndex, Task& task);
+    void Execute(const Task& task);
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::unique_ptr<TaskQueue[]> mQueues;
+    UINT mThreadCount = 1;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCondition;
+    std::atomic<UINT> mQueuedTasks = 0;
+    bool mShutdown = false;
+};
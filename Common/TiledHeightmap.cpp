@@ -0,0 +1,493 @@
+//***************************************************************************************
+// TiledHeightmap.cpp
+//***************************************************************************************
+
+#include "TiledHeightmap.h"
+
+using namespace DirectX;
+
+std::wstring TiledHeightmapFile::TiledFilename(const std::wstring& rawFilename)
+{
+    std::filesystem::path path(rawFilename);
+    path.replace_extension(L".tiles");
+    return path.wstring();
+}
+
+bool TiledHeightmapFile::ConvertRaw16(const std::wstring& rawFilename, UINT width, UINT height, UINT tileCells,
+                                      const std::wstring& tiledFilename)
+{
+    assert(width >= 2 && height >= 2 && tileCells > 0);
+
+    std::ifstream fin(std::filesystem::path(rawFilename), std::ios::binary);
+    if(!fin)
+        return false;
+
+    Header header;
+    header.Width = width;
+    header.Height = height;
+    header.TileCells = tileCells;
+    header.TilesX = (width - 1 + tileCells - 1) / tileCells;
+    header.TilesZ = (height - 1 + tileCells - 1) / tileCells;
+
+    std::vector<TileDesc> tiles((size_t)header.TilesX * header.TilesZ);
+
+    const std::filesystem::path path(tiledFilename);
+    std::filesystem::path tempPath = path;
+    tempPath += L".tmp";
+
+    std::ofstream fout(tempPath, std::ios::binary);
+    if(!fout)
+        return false;
+
+    auto fail = [&]()
+    {
+        fout.close();
+        std::error_code ec;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    };
+
+    // The directory is written again once the tile offsets are known.
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    fout.write(reinterpret_cast<const char*>(tiles.data()), tiles.size()*sizeof(TileDesc));
+
+    const UINT tileSamples = tileCells + 1;
+    std::vector<uint16_t> band((size_t)tileSamples * width);
+    std::vector<uint16_t> tile((size_t)tileSamples * tileSamples);
+
+    for(UINT tz = 0; tz < header.TilesZ; ++tz)
+    {
+        // The rows of this row of tiles, including the row shared with the next one.
+        const UINT z0 = tz*tileCells;
+        const UINT numRows = std::min(tileSamples, height - z0);
+
+        fin.seekg((std::streamoff)z0 * width * sizeof(uint16_t));
+        fin.read(reinterpret_cast<char*>(band.data()), (std::streamsize)numRows * width * sizeof(uint16_t));
+        if(!fin)
+            return fail();
+
+        for(UINT tx = 0; tx < header.TilesX; ++tx)
+        {
+            const UINT x0 = tx*tileCells;
+
+            uint16_t minSample = std::numeric_limits<uint16_t>::max();
+            uint16_t maxSample = 0;
+            for(UINT r = 0; r < tileSamples; ++r)
+            {
+                const uint16_t* src = &band[(size_t)std::min(r, numRows - 1) * width];
+                uint16_t* dst = &tile[(size_t)r * tileSamples];
+                for(UINT c = 0; c < tileSamples; ++c)
+                {
+                    const uint16_t s = src[std::min(x0 + c, width - 1)];
+                    minSample = std::min(minSample, s);
+                    maxSample = std::max(maxSample, s);
+                    dst[c] = s;
+                }
+            }
+
+            TileDesc& desc = tiles[(size_t)tz*header.TilesX + tx];
+            desc.Offset = (uint64_t)fout.tellp();
+            desc.MinSample = minSample;
+            desc.MaxSample = maxSample;
+
+            fout.write(reinterpret_cast<const char*>(tile.data()), tile.size()*sizeof(uint16_t));
+        }
+    }
+
+    fout.seekp(sizeof(Header));
+    fout.write(reinterpret_cast<const char*>(tiles.data()), tiles.size()*sizeof(TileDesc));
+    fout.close();
+    if(!fout)
+        return fail();
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if(ec)
+        return fail();
+
+    return true;
+}
+
+bool TiledHeightmap::Open(const std::wstring& filename)
+{
+    std::lock_guard<std::mutex> lock(mFileMutex);
+
+    mFile.close();
+    mFile.clear();
+    mTiles.clear();
+
+    mFile.open(std::filesystem::path(filename), std::ios::binary);
+    if(!mFile)
+        return false;
+
+    TiledHeightmapFile::Header header;
+    mFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!mFile ||
+       header.Magic != TiledHeightmapFile::Magic ||
+       header.Version != TiledHeightmapFile::Version ||
+       header.Width < 2 || header.Height < 2 || header.TileCells == 0 ||
+       header.TilesX != (header.Width - 1 + header.TileCells - 1) / header.TileCells ||
+       header.TilesZ != (header.Height - 1 + header.TileCells - 1) / header.TileCells)
+    {
+        mFile.close();
+        return false;
+    }
+
+    mTiles.resize((size_t)header.TilesX * header.TilesZ);
+    mFile.read(reinterpret_cast<char*>(mTiles.data()), (std::streamsize)(mTiles.size()*sizeof(TiledHeightmapFile::TileDesc)));
+    if(!mFile)
+    {
+        mTiles.clear();
+        mFile.close();
+        return false;
+    }
+
+    mHeader = header;
+    return true;
+}
+
+UINT TiledHeightmap::GetWidth()const
+{
+    return mHeader.Width;
+}
+
+UINT TiledHeightmap::GetHeight()const
+{
+    return mHeader.Height;
+}
+
+UINT TiledHeightmap::GetTileCells()const
+{
+    return mHeader.TileCells;
+}
+
+UINT TiledHeightmap::GetTileSamples()const
+{
+    return mHeader.TileCells + 1;
+}
+
+UINT TiledHeightmap::GetTilesX()const
+{
+    return mHeader.TilesX;
+}
+
+UINT TiledHeightmap::GetTilesZ()const
+{
+    return mHeader.TilesZ;
+}
+
+UINT TiledHeightmap::GetTileCount()const
+{
+    return (UINT)mTiles.size();
+}
+
+const TiledHeightmapFile::TileDesc& TiledHeightmap::GetTileDesc(UINT tile)const
+{
+    return mTiles[tile];
+}
+
+void TiledHeightmap::GetTileRect(UINT tile, UINT& x0, UINT& z0, UINT& x1, UINT& z1)const
+{
+    const UINT tx = tile % mHeader.TilesX;
+    const UINT tz = tile / mHeader.TilesX;
+
+    x0 = tx*mHeader.TileCells;
+    z0 = tz*mHeader.TileCells;
+    x1 = std::min(x0 + mHeader.TileCells, mHeader.Width - 1);
+    z1 = std::min(z0 + mHeader.TileCells, mHeader.Height - 1);
+}
+
+bool TiledHeightmap::ReadTile(UINT tile, uint16_t* samples)const
+{
+    const size_t byteSize = (size_t)GetTileSamples() * GetTileSamples() * sizeof(uint16_t);
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+
+    mFile.clear();
+    mFile.seekg((std::streamoff)mTiles[tile].Offset);
+    mFile.read(reinterpret_cast<char*>(samples), (std::streamsize)byteSize);
+    return (bool)mFile;
+}
+
+HeightmapPageCache::HeightmapPageCache(const TiledHeightmap& heightmap, UINT capacity, float heightScale, float heightOffset) :
+    mHeightmap(heightmap),
+    mHeightScale(heightScale),
+    mHeightOffset(heightOffset)
+{
+    assert(capacity > 0);
+
+    const size_t tileSamples = (size_t)heightmap.GetTileSamples() * heightmap.GetTileSamples();
+
+    mPages.resize(capacity);
+    for(Page& page : mPages)
+        page.Samples.resize(tileSamples);
+
+    mTilePage.assign(heightmap.GetTileCount(), -1);
+    mTileFailed.assign(heightmap.GetTileCount(), false);
+    mBuildScratch.resize(tileSamples);
+
+    mWorker = std::thread(&HeightmapPageCache::WorkerMain, this);
+}
+
+HeightmapPageCache::~HeightmapPageCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWorkReady.notify_all();
+    mWorker.join();
+}
+
+void HeightmapPageCache::RequestAround(float x, float z, float radius)
+{
+    const UINT tileCells = mHeightmap.GetTileCells();
+    const int lastTileX = (int)mHeightmap.GetTilesX() - 1;
+    const int lastTileZ = (int)mHeightmap.GetTilesZ() - 1;
+
+    const int tx0 = std::clamp((int)floorf((x - radius) / tileCells), 0, lastTileX);
+    const int tx1 = std::clamp((int)floorf((x + radius) / tileCells), 0, lastTileX);
+    const int tz0 = std::clamp((int)floorf((z - radius) / tileCells), 0, lastTileZ);
+    const int tz1 = std::clamp((int)floorf((z + radius) / tileCells), 0, lastTileZ);
+
+    struct Candidate
+    {
+        float DistSq;
+        UINT Tile;
+    };
+
+    std::vector<Candidate> missing;
+
+    // Mark everything in range first so none of it gets evicted for a nearer tile.
+    for(int tz = tz0; tz <= tz1; ++tz)
+    {
+        for(int tx = tx0; tx <= tx1; ++tx)
+        {
+            const UINT tile = (UINT)tz*mHeightmap.GetTilesX() + (UINT)tx;
+            if(mTileFailed[tile])
+                continue;
+
+            UINT x0, z0, x1, z1;
+            mHeightmap.GetTileRect(tile, x0, z0, x1, z1);
+            const float dx = std::max({ (float)x0 - x, 0.0f, x - (float)x1 });
+            const float dz = std::max({ (float)z0 - z, 0.0f, z - (float)z1 });
+            const float distSq = dx*dx + dz*dz;
+            if(distSq > radius*radius)
+                continue;
+
+            const int page = mTilePage[tile];
+            if(page >= 0)
+                mPages[page].LastUsedFrame = mFrame;
+            else
+                missing.push_back({ distSq, tile });
+        }
+    }
+
+    std::sort(missing.begin(), missing.end(),
+        [](const Candidate& a, const Candidate& b) { return a.DistSq < b.DistSq; });
+
+    std::vector<int> loads;
+    for(const Candidate& candidate : missing)
+    {
+        const int page = AcquirePage();
+        if(page < 0)
+            break;
+
+        mPages[page].State = PageState::Loading;
+        mPages[page].Tile = candidate.Tile;
+        mPages[page].LastUsedFrame = mFrame;
+        mTilePage[candidate.Tile] = page;
+        loads.push_back(page);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFocusX = x;
+        mFocusZ = z;
+        mQueue.insert(mQueue.end(), loads.begin(), loads.end());
+        mInFlight += (UINT)loads.size();
+    }
+
+    if(!loads.empty())
+        mWorkReady.notify_one();
+}
+
+int HeightmapPageCache::AcquirePage()
+{
+    int victim = -1;
+    for(int i = 0; i < (int)mPages.size(); ++i)
+    {
+        const Page& page = mPages[i];
+        if(page.State == PageState::Free)
+            return i;
+
+        if(page.State == PageState::Resident && page.LastUsedFrame < mFrame &&
+           (victim < 0 || page.LastUsedFrame < mPages[victim].LastUsedFrame))
+        {
+            victim = i;
+        }
+    }
+
+    if(victim >= 0)
+    {
+        mTilePage[mPages[victim].Tile] = -1;
+        mPages[victim].State = PageState::Free;
+        --mResidentCount;
+    }
+
+    return victim;
+}
+
+const std::vector<UINT>& HeightmapPageCache::Update()
+{
+    std::vector<int> completed;
+    std::vector<int> failed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        completed.swap(mCompleted);
+        failed.swap(mFailed);
+    }
+
+    for(int pageIndex : failed)
+    {
+        Page& page = mPages[pageIndex];
+        page.State = PageState::Free;
+        mTilePage[page.Tile] = -1;
+        mTileFailed[page.Tile] = true;
+    }
+    mFailedLoadCount += (UINT)failed.size();
+
+    mNewlyResident.clear();
+    for(int pageIndex : completed)
+    {
+        Page& page = mPages[pageIndex];
+        page.State = PageState::Resident;
+        mNewlyResident.push_back(page.Tile);
+    }
+
+    mResidentCount += (UINT)completed.size();
+    mLoadCount += (UINT)completed.size();
+    ++mFrame;
+
+    return mNewlyResident;
+}
+
+void HeightmapPageCache::Flush()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWorkDone.wait(lock, [this]() { return mInFlight == 0; });
+}
+
+const uint16_t* HeightmapPageCache::FindTile(UINT tile)const
+{
+    const int page = mTilePage[tile];
+    if(page < 0 || mPages[page].State != PageState::Resident)
+        return nullptr;
+
+    mPages[page].LastUsedFrame = mFrame;
+    return mPages[page].Samples.data();
+}
+
+const HeightPyramid* HeightmapPageCache::FindTilePyramid(UINT tile)const
+{
+    const int page = mTilePage[tile];
+    if(page < 0 || mPages[page].State != PageState::Resident)
+        return nullptr;
+
+    mPages[page].LastUsedFrame = mFrame;
+    return &mPages[page].Pyramid;
+}
+
+UINT HeightmapPageCache::GetCapacity()const
+{
+    return (UINT)mPages.size();
+}
+
+UINT HeightmapPageCache::GetResidentCount()const
+{
+    return mResidentCount;
+}
+
+UINT HeightmapPageCache::GetLoadCount()const
+{
+    return mLoadCount;
+}
+
+UINT HeightmapPageCache::GetFailedLoadCount()const
+{
+    return mFailedLoadCount;
+}
+
+size_t HeightmapPageCache::GetMemoryByteSize()const
+{
+    // Every page holds a full tile of samples, and a pyramid over it once it has been
+    // loaded.  Both only depend on the tile size, so pages being loaded, which belong
+    // to the worker, are not touched.
+    const UINT tileSamples = mHeightmap.GetTileSamples();
+    const size_t pageBytes = (size_t)tileSamples*tileSamples*sizeof(uint16_t) +
+        HeightPyramid::CalcMemoryByteSize(tileSamples, tileSamples);
+    return pageBytes*mPages.size();
+}
+
+void HeightmapPageCache::WorkerMain()
+{
+    const UINT tileSamples = mHeightmap.GetTileSamples();
+    constexpr float MaxUShort = static_cast<float>(std::numeric_limits<uint16_t>::max());
+
+    for(;;)
+    {
+        int pageIndex = -1;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWorkReady.wait(lock, [this]() { return mQuit || !mQueue.empty(); });
+            if(mQuit)
+                return;
+
+            // The camera may have moved on since these were queued; load the tile
+            // nearest to where it is now.
+            size_t best = 0;
+            float bestDistSq = FLT_MAX;
+            for(size_t k = 0; k < mQueue.size(); ++k)
+            {
+                UINT x0, z0, x1, z1;
+                mHeightmap.GetTileRect(mPages[mQueue[k]].Tile, x0, z0, x1, z1);
+                const float dx = 0.5f*(x0 + x1) - mFocusX;
+                const float dz = 0.5f*(z0 + z1) - mFocusZ;
+                if(dx*dx + dz*dz < bestDistSq)
+                {
+                    bestDistSq = dx*dx + dz*dz;
+                    best = k;
+                }
+            }
+
+            pageIndex = mQueue[best];
+            mQueue[best] = mQueue.back();
+            mQueue.pop_back();
+        }
+
+        // The page belongs to the worker until it is published, so no lock is needed.
+        // A tile that cannot be read is handed back to be freed rather than shown flat.
+        Page& page = mPages[pageIndex];
+        if(!mHeightmap.ReadTile(page.Tile, page.Samples.data()))
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFailed.push_back(pageIndex);
+                --mInFlight;
+            }
+            mWorkDone.notify_all();
+            continue;
+        }
+
+        for(size_t k = 0; k < page.Samples.size(); ++k)
+            mBuildScratch[k] = mHeightScale * (page.Samples[k] / MaxUShort) + mHeightOffset;
+        page.Pyramid.Build(mBuildScratch.data(), tileSamples, tileSamples, &mBuildPool);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCompleted.push_back(pageIndex);
+            --mInFlight;
+        }
+        mWorkDone.notify_all();
+    }
+}
@@ -0,0 +1,224 @@
+//***************************************************************************************
+// TiledHeightmap.h
+//
+// Tiled ".tiles" heightmap file and a page cache that streams its tiles in around the
+// camera.  A RAW16 heightmap has to be read and kept whole; the tiled file splits it
+// into square tiles of TileCells x TileCells cells that can be loaded on their own:
+//
+//   Header
+//   TileDesc[TilesX*TilesZ]         row major, file offset and height range per tile
+//   tile payloads                   (TileCells+1)^2 uint16 samples each, row major
+//
+// Neighbouring tiles share their edge samples, so a tile alone is enough to answer
+// height queries anywhere inside it.  Tiles on the right and bottom edge of the map
+// repeat the last sample to keep every payload the same size.
+//
+// Use TiledHeightmapFile::ConvertRaw16 to generate the file from a RAW16 heightmap.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "HeightPyramid.h"
+#include "TaskPool.h"
+#include <fstream>
+
+namespace TiledHeightmapFile
+{
+    // "HMTL" in little endian.
+    constexpr uint32_t Magic = 0x4C544D48;
+
+    // Bump whenever the layout of anything below changes.
+    constexpr uint32_t Version = 1;
+
+    struct Header
+    {
+        uint32_t Magic = TiledHeightmapFile::Magic;
+        uint32_t Version = TiledHeightmapFile::Version;
+
+        // Samples of the whole heightmap.
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+
+        uint32_t TileCells = 0;
+        uint32_t TilesX = 0;
+        uint32_t TilesZ = 0;
+        uint32_t Pad = 0;
+    };
+
+    struct TileDesc
+    {
+        uint64_t Offset = 0;
+
+        // Lowest and highest raw sample of the tile, so bounds are known before the
+        // tile is loaded.
+        uint16_t MinSample = 0;
+        uint16_t MaxSample = 0;
+        uint32_t Pad = 0;
+    };
+
+    // Returns the .tiles filename that sits next to the given RAW filename.
+    std::wstring TiledFilename(const std::wstring& rawFilename);
+
+    // Splits a width x height RAW16 heightmap into tiles of tileCells cells.  Reads the
+    // RAW file one row of tiles at a time.  The tiles are written to a temporary file
+    // that replaces tiledFilename once complete, so a failed conversion leaves any
+    // existing file as it was and never a partial one.
+    bool ConvertRaw16(const std::wstring& rawFilename, UINT width, UINT height, UINT tileCells,
+                      const std::wstring& tiledFilename);
+}
+
+///<summary>
+/// Reads the directory of a .tiles file up front and single tiles on demand.
+///</summary>
+class TiledHeightmap
+{
+public:
+    TiledHeightmap() = default;
+    TiledHeightmap(const TiledHeightmap& rhs) = delete;
+    TiledHeightmap& operator=(const TiledHeightmap& rhs) = delete;
+
+    // Reads and validates the header and tile directory.  Returns false if the file
+    // does not exist, is not a .tiles file, or was written by another version.
+    bool Open(const std::wstring& filename);
+
+    UINT GetWidth()const;
+    UINT GetHeight()const;
+    UINT GetTileCells()const;
+
+    // Samples per tile edge: GetTileCells() + 1.
+    UINT GetTileSamples()const;
+
+    UINT GetTilesX()const;
+    UINT GetTilesZ()const;
+    UINT GetTileCount()const;
+
+    const TiledHeightmapFile::TileDesc& GetTileDesc(UINT tile)const;
+
+    // Samples [x0, x1] x [z0, z1] of the heightmap that tile covers.
+    void GetTileRect(UINT tile, UINT& x0, UINT& z0, UINT& x1, UINT& z1)const;
+
+    // Reads the GetTileSamples()^2 samples of tile.  Safe to call from any thread.
+    bool ReadTile(UINT tile, uint16_t* samples)const;
+
+private:
+    TiledHeightmapFile::Header mHeader;
+    std::vector<TiledHeightmapFile::TileDesc> mTiles;
+
+    mutable std::mutex mFileMutex;
+    mutable std::ifstream mFile;
+};
+
+///<summary>
+/// Keeps at most a fixed number of tiles of a TiledHeightmap in memory.  The render
+/// thread asks for the tiles around the camera every frame; a worker thread loads the
+/// missing ones, nearest to the camera first, and builds a HeightPyramid per tile for
+/// ray queries.  When every page is taken, the tile used least recently is evicted.
+///
+/// Everything but the worker runs on the thread that calls Update().
+///</summary>
+class HeightmapPageCache
+{
+public:
+    // heightScale and heightOffset turn raw samples into heights for the per-tile
+    // pyramids: height = heightScale*sample/65535 + heightOffset.
+    HeightmapPageCache(const TiledHeightmap& heightmap, UINT capacity, float heightScale, float heightOffset);
+    HeightmapPageCache(const HeightmapPageCache& rhs) = delete;
+    HeightmapPageCache& operator=(const HeightmapPageCache& rhs) = delete;
+    ~HeightmapPageCache();
+
+    // Marks the resident tiles whose samples lie within radius samples of (x, z) as
+    // used this frame, and queues loads for the others while pages are free or hold
+    // tiles that were not used this frame.
+    void RequestAround(float x, float z, float radius);
+
+    // Publishes the tiles the worker finished since the last call, frees the pages of
+    // those it failed to read, and starts a new frame.  Returns the tiles that became
+    // resident.
+    const std::vector<UINT>& Update();
+
+    // Blocks until every queued load has finished.  Call Update() afterwards to
+    // publish them.
+    void Flush();
+
+    // Samples of tile, GetTileSamples()^2 row major, or null if tile is not resident.
+    // Counts as a use of the tile.
+    const uint16_t* FindTile(UINT tile)const;
+
+    // Pyramid over the heights of tile, or null if it is not resident.
+    const HeightPyramid* FindTilePyramid(UINT tile)const;
+
+    UINT GetCapacity()const;
+    UINT GetResidentCount()const;
+
+    // Tiles loaded since the cache was created.
+    UINT GetLoadCount()const;
+
+    // Tiles that could not be read from the file.  They are not requested again.
+    UINT GetFailedLoadCount()const;
+
+    // Bytes held by the pages, resident or not, including their pyramids.
+    size_t GetMemoryByteSize()const;
+
+private:
+    enum class PageState
+    {
+        Free,
+        Loading,
+        Resident
+    };
+
+    struct Page
+    {
+        PageState State = PageState::Free;
+        UINT Tile = 0;
+        mutable uint64_t LastUsedFrame = 0;
+
+        std::vector<uint16_t> Samples;
+        HeightPyramid Pyramid;
+    };
+
+    // A free page, or the page of the least recently used tile that was not used
+    // this frame, which is evicted.  -1 if every page is loading or in use.
+    int AcquirePage();
+
+    void WorkerMain();
+
+private:
+    const TiledHeightmap& mHeightmap;
+    const float mHeightScale;
+    const float mHeightOffset;
+
+    std::vector<Page> mPages;
+
+    // Page index per tile, -1 if the tile has no page.
+    std::vector<int> mTilePage;
+
+    // Tiles whose read failed.
+    std::vector<bool> mTileFailed;
+
+    uint64_t mFrame = 1;
+    UINT mResidentCount = 0;
+    UINT mLoadCount = 0;
+    UINT mFailedLoadCount = 0;
+    std::vector<UINT> mNewlyResident;
+
+    // Shared with the worker.
+    std::mutex mMutex;
+    std::condition_variable mWorkReady;
+    std::condition_variable mWorkDone;
+    std::vector<int> mQueue;        // pages waiting to be loaded
+    std::vector<int> mCompleted;    // pages loaded, not yet published
+    std::vector<int> mFailed;       // pages whose read failed, not yet freed
+    UINT mInFlight = 0;             // queued or being loaded
+    float mFocusX = 0.0f;
+    float mFocusZ = 0.0f;
+    bool mQuit = false;
+
+    // Pyramid builds run serially on the worker; a pool of one thread never starts
+    // threads of its own.
+    TaskPool mBuildPool{ 1 };
+    std::vector<float> mBuildScratch;
+
+    std::thread mWorker;
+};
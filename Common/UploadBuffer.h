@@ -62,6 +62,15 @@ public:
         memcpy(mMappedData, data, count * sizeof(T));
     }
 
+    // The mapped elements of a buffer that is not a constant buffer, so a producer
+    // can write them in place instead of building a copy for CopyData.
+    T* MappedData()
+    {
+        assert(mElementByteSize == sizeof(T));
+
+        return reinterpret_cast<T*>(mMappedData);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
@@ -0,0 +1,323 @@
+//***************************************************************************************
+// VertexCompression.cpp
+//***************************************************************************************
+
+#include "VertexCompression.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    uint16_t QuantizeUnorm16(float v, float offset, float scale)
+    {
+        const float t = scale > 0.0f ? (v - offset) / scale : 0.0f;
+        return (uint16_t)std::lround(MathHelper::Clamp(t, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    float DequantizeUnorm16(uint16_t q, float offset, float scale)
+    {
+        return (q / 65535.0f) * scale + offset;
+    }
+
+    float DecodeSnorm16(int16_t q)
+    {
+        return std::max(q / 32767.0f, -1.0f);
+    }
+
+    // Inverse of OctEncode; the same steps as OctDecode in Shaders/PackedVertex.hlsl.
+    XMFLOAT3 OctDecode(const int16_t e[2])
+    {
+        float x = DecodeSnorm16(e[0]);
+        float y = DecodeSnorm16(e[1]);
+        const float z = 1.0f - fabsf(x) - fabsf(y);
+        const float t = MathHelper::Clamp(-z, 0.0f, 1.0f);
+        x += x >= 0.0f ? -t : t;
+        y += y >= 0.0f ? -t : t;
+
+        XMFLOAT3 n;
+        XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+        return n;
+    }
+
+    // Projects a direction onto the octahedron |x|+|y|+|z| = 1 and unfolds the lower
+    // half over the corners of the square.  Of the four snorm16 pairs around the exact
+    // mapping, keeps the one that decodes closest to the direction, which about halves
+    // the error of plain rounding.  A zero vector encodes as +z.
+    void OctEncode(const XMFLOAT3& v, int16_t e[2])
+    {
+        XMVECTOR n = XMLoadFloat3(&v);
+        const float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+        if(l1 <= 0.0f)
+        {
+            e[0] = e[1] = 0;
+            return;
+        }
+
+        float x = v.x / l1;
+        float y = v.y / l1;
+        if(v.z < 0.0f)
+        {
+            const float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = ox;
+            y = oy;
+        }
+
+        const float fx = floorf(MathHelper::Clamp(x, -1.0f, 1.0f) * 32767.0f);
+        const float fy = floorf(MathHelper::Clamp(y, -1.0f, 1.0f) * 32767.0f);
+
+        n = XMVector3Normalize(n);
+        float bestDot = -2.0f;
+        for(int i = 0; i < 4; ++i)
+        {
+            const int16_t candidate[2] =
+            {
+                (int16_t)MathHelper::Clamp(fx + (i & 1), -32767.0f, 32767.0f),
+                (int16_t)MathHelper::Clamp(fy + (i >> 1), -32767.0f, 32767.0f)
+            };
+
+            const XMFLOAT3 decoded = OctDecode(candidate);
+            const float dot = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&decoded), n));
+            if(dot > bestDot)
+            {
+                bestDot = dot;
+                e[0] = candidate[0];
+                e[1] = candidate[1];
+            }
+        }
+    }
+
+    // Degrees between a source direction and its decoded copy; 0 for a zero source.
+    float AngleBetween(const XMFLOAT3& source, const XMFLOAT3& decoded)
+    {
+        XMVECTOR a = XMLoadFloat3(&source);
+        if(XMVectorGetX(XMVector3LengthSq(a)) <= 0.0f)
+            return 0.0f;
+
+        const float cosAngle = XMVectorGetX(XMVector3Dot(XMVector3Normalize(a), XMLoadFloat3(&decoded)));
+        return XMConvertToDegrees(acosf(MathHelper::Clamp(cosAngle, -1.0f, 1.0f)));
+    }
+
+    template<typename VertexT, typename PackedT>
+    void EncodeCommon(const VertexT& src, const VertexQuantization& q, PackedT& dst)
+    {
+        dst.Pos[0] = QuantizeUnorm16(src.Pos.x, q.Offset.x, q.Scale.x);
+        dst.Pos[1] = QuantizeUnorm16(src.Pos.y, q.Offset.y, q.Scale.y);
+        dst.Pos[2] = QuantizeUnorm16(src.Pos.z, q.Offset.z, q.Scale.z);
+        dst.Pos[3] = 0;
+
+        OctEncode(src.Normal, dst.Normal);
+        OctEncode(src.TangentU, dst.TangentU);
+
+        dst.TexC[0] = XMConvertFloatToHalf(src.TexC.x);
+        dst.TexC[1] = XMConvertFloatToHalf(src.TexC.y);
+    }
+
+    template<typename PackedT, typename VertexT>
+    void DecodeCommon(const PackedT& src, const VertexQuantization& q, VertexT& dst)
+    {
+        dst.Pos.x = DequantizeUnorm16(src.Pos[0], q.Offset.x, q.Scale.x);
+        dst.Pos.y = DequantizeUnorm16(src.Pos[1], q.Offset.y, q.Scale.y);
+        dst.Pos.z = DequantizeUnorm16(src.Pos[2], q.Offset.z, q.Scale.z);
+
+        dst.Normal = OctDecode(src.Normal);
+        dst.TangentU = OctDecode(src.TangentU);
+
+        dst.TexC.x = XMConvertHalfToFloat(src.TexC[0]);
+        dst.TexC.y = XMConvertHalfToFloat(src.TexC[1]);
+    }
+
+    template<typename VertexT>
+    void CompareCommon(const VertexT& src, const VertexT& decoded, VertexCompressionError& error)
+    {
+        const float dp = XMVectorGetX(XMVector3Length(XMLoadFloat3(&src.Pos) - XMLoadFloat3(&decoded.Pos)));
+        error.MaxPosition = std::max(error.MaxPosition, dp);
+
+        error.MaxNormalAngle = std::max(error.MaxNormalAngle, AngleBetween(src.Normal, decoded.Normal));
+        error.MaxTangentAngle = std::max(error.MaxTangentAngle, AngleBetween(src.TangentU, decoded.TangentU));
+
+        error.MaxTexC = std::max(error.MaxTexC, fabsf(src.TexC.x - decoded.TexC.x));
+        error.MaxTexC = std::max(error.MaxTexC, fabsf(src.TexC.y - decoded.TexC.y));
+    }
+
+    // The four weights of a float vertex, the fourth implied as in ApplySkinning.
+    void SourceWeights(const M3DLoader::SkinnedVertex& v, float w[4])
+    {
+        w[0] = v.BoneWeights.x;
+        w[1] = v.BoneWeights.y;
+        w[2] = v.BoneWeights.z;
+        w[3] = 1.0f - w[0] - w[1] - w[2];
+    }
+
+    // Rounds four weights to bytes that sum to exactly 255: each is rounded down, and
+    // the remainder goes to those that lost the most.
+    void QuantizeWeights(const float w[4], uint8_t dst[4])
+    {
+        float scaled[4];
+        int sum = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            scaled[i] = MathHelper::Clamp(w[i], 0.0f, 1.0f) * 255.0f;
+            dst[i] = (uint8_t)floorf(scaled[i]);
+            sum += dst[i];
+        }
+
+        for(; sum < 255; ++sum)
+        {
+            int best = 0;
+            for(int i = 1; i < 4; ++i)
+            {
+                if(scaled[i] - dst[i] > scaled[best] - dst[best])
+                    best = i;
+            }
+
+            dst[best]++;
+            scaled[best] = std::max(scaled[best], (float)dst[best]);
+        }
+
+        // Weights that summed to more than 1 are scaled back down.
+        for(int i = 3; sum > 255; i = (i + 3) % 4)
+        {
+            if(dst[i] > 0)
+            {
+                dst[i]--;
+                sum--;
+            }
+        }
+    }
+}
+
+VertexQuantization VertexCompression::QuantizationFromBounds(const BoundingBox& bounds)
+{
+    VertexQuantization q;
+    q.Offset = XMFLOAT3(
+        bounds.Center.x - bounds.Extents.x,
+        bounds.Center.y - bounds.Extents.y,
+        bounds.Center.z - bounds.Extents.z);
+    q.Scale = XMFLOAT3(
+        2.0f * std::max(bounds.Extents.x, 0.0f),
+        2.0f * std::max(bounds.Extents.y, 0.0f),
+        2.0f * std::max(bounds.Extents.z, 0.0f));
+    return q;
+}
+
+BoundingBox VertexCompression::ComputeBounds(const void* vertices, UINT count, UINT stride)
+{
+    BoundingBox bounds;
+    if(count == 0)
+        return bounds;
+
+    // Positions are the first element of every vertex type here.
+    BoundingBox::CreateFromPoints(bounds, count, reinterpret_cast<const XMFLOAT3*>(vertices), stride);
+    return bounds;
+}
+
+void VertexCompression::WriteDequantConstants(const BoundingBox& bounds, PerObjectCB& constants)
+{
+    const VertexQuantization q = QuantizationFromBounds(bounds);
+    constants.gPosDequantScale = q.Scale;
+    constants.gPosDequantOffset = q.Offset;
+}
+
+void VertexCompression::Encode(const ModelVertex* src, UINT count, const VertexQuantization& quantization, PackedModelVertex* dst)
+{
+    for(UINT i = 0; i < count; ++i)
+        EncodeCommon(src[i], quantization, dst[i]);
+}
+
+void VertexCompression::Encode(const M3DLoader::SkinnedVertex* src, UINT count, const VertexQuantization& quantization, PackedSkinnedVertex* dst)
+{
+    for(UINT i = 0; i < count; ++i)
+    {
+        EncodeCommon(src[i], quantization, dst[i]);
+
+        float w[4];
+        SourceWeights(src[i], w);
+        QuantizeWeights(w, dst[i].BoneWeights);
+
+        for(int j = 0; j < 4; ++j)
+            dst[i].BoneIndices[j] = src[i].BoneIndices[j];
+    }
+}
+
+void VertexCompression::Decode(const PackedModelVertex* src, UINT count, const VertexQuantization& quantization, ModelVertex* dst)
+{
+    for(UINT i = 0; i < count; ++i)
+        DecodeCommon(src[i], quantization, dst[i]);
+}
+
+void VertexCompression::Decode(const PackedSkinnedVertex* src, UINT count, const VertexQuantization& quantization, M3DLoader::SkinnedVertex* dst)
+{
+    for(UINT i = 0; i < count; ++i)
+    {
+        DecodeCommon(src[i], quantization, dst[i]);
+
+        dst[i].BoneWeights.x = src[i].BoneWeights[0] / 255.0f;
+        dst[i].BoneWeights.y = src[i].BoneWeights[1] / 255.0f;
+        dst[i].BoneWeights.z = src[i].BoneWeights[2] / 255.0f;
+
+        for(int j = 0; j < 4; ++j)
+            dst[i].BoneIndices[j] = src[i].BoneIndices[j];
+    }
+}
+
+VertexCompressionError VertexCompression::Validate(const ModelVertex* src, const PackedModelVertex* packed, UINT count,
+                                                   const VertexQuantization& quantization)
+{
+    VertexCompressionError error;
+    for(UINT i = 0; i < count; ++i)
+    {
+        ModelVertex decoded;
+        Decode(&packed[i], 1, quantization, &decoded);
+        CompareCommon(src[i], decoded, error);
+    }
+
+    return error;
+}
+
+VertexCompressionError VertexCompression::Validate(const M3DLoader::SkinnedVertex* src, const PackedSkinnedVertex* packed, UINT count,
+                                                   const VertexQuantization& quantization)
+{
+    VertexCompressionError error;
+    for(UINT i = 0; i < count; ++i)
+    {
+        M3DLoader::SkinnedVertex decoded;
+        Decode(&packed[i], 1, quantization, &decoded);
+        CompareCommon(src[i], decoded, error);
+
+        float w[4];
+        float dw[4];
+        SourceWeights(src[i], w);
+        SourceWeights(decoded, dw);
+        for(int j = 0; j < 4; ++j)
+            error.MaxBoneWeight = std::max(error.MaxBoneWeight, fabsf(w[j] - dw[j]));
+
+        const int byteSum = packed[i].BoneWeights[0] + packed[i].BoneWeights[1] +
+                            packed[i].BoneWeights[2] + packed[i].BoneWeights[3];
+        if(byteSum != 255 || memcmp(decoded.BoneIndices, src[i].BoneIndices, sizeof(decoded.BoneIndices)) != 0)
+            error.BadSkinCount++;
+    }
+
+    return error;
+}
+
+void VertexCompression::Accumulate(VertexCompressionError& total, const VertexCompressionError& error)
+{
+    total.MaxPosition = std::max(total.MaxPosition, error.MaxPosition);
+    total.MaxNormalAngle = std::max(total.MaxNormalAngle, error.MaxNormalAngle);
+    total.MaxTangentAngle = std::max(total.MaxTangentAngle, error.MaxTangentAngle);
+    total.MaxTexC = std::max(total.MaxTexC, error.MaxTexC);
+    total.MaxBoneWeight = std::max(total.MaxBoneWeight, error.MaxBoneWeight);
+    total.BadSkinCount += error.BadSkinCount;
+}
+
+VertexByteReport VertexCompression::ReportBytes(UINT vertexCount, UINT sourceStride, UINT packedStride, UINT64 indexBytes)
+{
+    VertexByteReport report;
+    report.VertexCount = vertexCount;
+    report.SourceBytes = (UINT64)vertexCount * sourceStride;
+    report.PackedBytes = (UINT64)vertexCount * packedStride;
+    report.IndexBytes = indexBytes;
+    return report;
+}
@@ -0,0 +1,119 @@
+//***************************************************************************************
+// VertexCompression.h
+//
+// Packed vertex layouts for ModelVertex (44 bytes) and M3DLoader::SkinnedVertex
+// (60 bytes), at 20 and 28 bytes.  Positions are unorm16 within the bounds of their
+// submesh, normals and tangents are octahedral snorm16 pairs, texture coordinates are
+// half floats and bone weights unorm8.  The GPU side is Shaders/PackedVertex.hlsl, with
+// the input layouts and "_packed" PSOs in PsoLib.
+//
+// A packed vertex buffer needs the dequantization of its submesh in the per object
+// constants (WriteDequantConstants), so submeshes with different bounds must not share
+// vertices.  Validate decodes a packed buffer and reports how far it is from the
+// source, and ReportBytes how much it saves.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "LoadM3d.h"
+#include "../Shaders/SharedTypes.h"
+
+// Matches packedModelInputLayout in PsoLib.cpp.
+struct PackedModelVertex
+{
+    uint16_t Pos[4];        // R16G16B16A16_UNORM; w is unused.
+    int16_t Normal[2];      // R16G16_SNORM, octahedral.
+    int16_t TangentU[2];    // R16G16_SNORM, octahedral.
+    DirectX::PackedVector::HALF TexC[2];
+};
+
+// Matches packedSkinnedInputLayout in PsoLib.cpp.
+struct PackedSkinnedVertex
+{
+    uint16_t Pos[4];
+    int16_t Normal[2];
+    int16_t TangentU[2];
+    DirectX::PackedVector::HALF TexC[2];
+
+    // R8G8B8A8_UNORM.  The four weights sum to exactly 255; the shader reads the first
+    // three and implies the fourth, as for the float layout.
+    uint8_t BoneWeights[4];
+    uint8_t BoneIndices[4];
+};
+
+static_assert(sizeof(PackedModelVertex) == 20, "PackedModelVertex must match packedModelInputLayout.");
+static_assert(sizeof(PackedSkinnedVertex) == 28, "PackedSkinnedVertex must match packedSkinnedInputLayout.");
+
+// Maps unorm16 positions back to object space: position = q/65535 * Scale + Offset.
+struct VertexQuantization
+{
+    DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 Offset = { 0.0f, 0.0f, 0.0f };
+};
+
+// Largest differences between source vertices and their packed, then decoded, copies.
+struct VertexCompressionError
+{
+    // Object space units.
+    float MaxPosition = 0.0f;
+
+    // Degrees.
+    float MaxNormalAngle = 0.0f;
+    float MaxTangentAngle = 0.0f;
+
+    float MaxTexC = 0.0f;
+
+    // Of any of the four weights, the fourth implied.
+    float MaxBoneWeight = 0.0f;
+
+    // Vertices whose bone indices or weight sum did not survive.
+    UINT BadSkinCount = 0;
+};
+
+struct VertexByteReport
+{
+    UINT VertexCount = 0;
+    UINT64 SourceBytes = 0;
+    UINT64 PackedBytes = 0;
+    UINT64 IndexBytes = 0;
+
+    // Vertex and index bytes with packed vertices as a fraction of those with float ones.
+    float Ratio()const
+    {
+        return SourceBytes + IndexBytes == 0 ? 1.0f :
+            float(PackedBytes + IndexBytes) / float(SourceBytes + IndexBytes);
+    }
+};
+
+namespace VertexCompression
+{
+    // The quantization that spans bounds.  Flat axes get a scale of 0.
+    VertexQuantization QuantizationFromBounds(const DirectX::BoundingBox& bounds);
+
+    // Bounds of the positions of count vertices stride bytes apart.
+    DirectX::BoundingBox ComputeBounds(const void* vertices, UINT count, UINT stride);
+
+    // Sets gPosDequantScale/gPosDequantOffset for drawing a submesh with these bounds.
+    void WriteDequantConstants(const DirectX::BoundingBox& bounds, PerObjectCB& constants);
+
+    // Packs count vertices with one quantization.  Normals and tangents need not be
+    // unit length.
+    void Encode(const ModelVertex* src, UINT count, const VertexQuantization& quantization, PackedModelVertex* dst);
+    void Encode(const M3DLoader::SkinnedVertex* src, UINT count, const VertexQuantization& quantization, PackedSkinnedVertex* dst);
+
+    // Unpacks the way Shaders/PackedVertex.hlsl does.
+    void Decode(const PackedModelVertex* src, UINT count, const VertexQuantization& quantization, ModelVertex* dst);
+    void Decode(const PackedSkinnedVertex* src, UINT count, const VertexQuantization& quantization, M3DLoader::SkinnedVertex* dst);
+
+    // Decodes packed and compares it to the source it was encoded from.
+    VertexCompressionError Validate(const ModelVertex* src, const PackedModelVertex* packed, UINT count,
+                                    const VertexQuantization& quantization);
+    VertexCompressionError Validate(const M3DLoader::SkinnedVertex* src, const PackedSkinnedVertex* packed, UINT count,
+                                    const VertexQuantization& quantization);
+
+    // The larger of each error.
+    void Accumulate(VertexCompressionError& total, const VertexCompressionError& error);
+
+    VertexByteReport ReportBytes(UINT vertexCount, UINT sourceStride, UINT packedStride, UINT64 indexBytes);
+}
@@ -2,6 +2,10 @@
 #include "d3dUtil.h"
 #include "MeshGen.h"
 #include "LoadM3d.h"
+#include "M3dBinary.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
 #include <comdef.h>
 #include <fstream>
 
@@ -185,6 +189,15 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildShapeGeometry(ID3D12Device* device,
     MeshGenData cylinder = meshGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
     MeshGenData quad = meshGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 
+    // Reorder each shape for the vertex cache before they are concatenated.
+    MeshOptimizerSettings optimizerSettings;
+    optimizerSettings.PositionOffset = offsetof(MeshGenVertex, Position);
+    for(MeshGenData* mesh : { &box, &grid, &sphere, &cylinder, &quad })
+    {
+        MeshOptimizer::Optimize(mesh->Vertices.data(), (UINT)mesh->Vertices.size(), sizeof(MeshGenVertex),
+                                mesh->Indices32.data(), (UINT)mesh->Indices32.size(), optimizerSettings);
+    }
+
     //
     // We are concatenating all the geometry into one big vertex/index buffer.  So
     // define the regions in the buffer each submesh covers.
@@ -247,7 +260,7 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildShapeGeometry(ID3D12Device* device,
     return geo;
 }
 
-std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch)
+std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch, UINT lodCount)
 {
     std::ifstream fin("Models/skull.txt");
 
@@ -333,7 +346,7 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device,
     fin >> ignore;
     fin >> ignore;
 
-    std::vector<std::int32_t> indices(3 * tcount);
+    std::vector<std::uint32_t> indices(3 * tcount);
     for(UINT i = 0; i < tcount; ++i)
     {
         fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -341,10 +354,16 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device,
 
     fin.close();
 
+    // The skull is stored in authoring order; reorder it for the vertex cache.
+    MeshOptimizerSettings optimizerSettings;
+    optimizerSettings.PositionOffset = offsetof(ModelVertex, Pos);
+    MeshOptimizer::Optimize(vertices.data(), vcount, sizeof(ModelVertex),
+                            indices.data(), (UINT)indices.size(), optimizerSettings);
+
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(ModelVertex);
 
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "skullGeo";
@@ -355,14 +374,6 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device,
     geo->IndexBufferCPU.resize(ibByteSize);
     CopyMemory(geo->IndexBufferCPU.data(), indices.data(), ibByteSize);
 
-    CreateStaticBuffer(device, uploadBatch,
-                       vertices.data(), vertices.size(), sizeof(ModelVertex),
-                       D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, &geo->VertexBufferGPU);
-
-    CreateStaticBuffer(device, uploadBatch,
-                       indices.data(), indices.size(), sizeof(std::uint32_t),
-                       D3D12_RESOURCE_STATE_INDEX_BUFFER, &geo->IndexBufferGPU);
-
     geo->VertexByteStride = sizeof(ModelVertex);
     geo->VertexBufferByteSize = vbByteSize;
     geo->IndexFormat = DXGI_FORMAT_R32_UINT;
@@ -377,6 +388,23 @@ std::unique_ptr<MeshGeometry> d3dUtil::BuildSkullGeometry(ID3D12Device* device,
 
     geo->DrawArgs["skull"] = submesh;
 
+    // The levels of detail only append indices, so simplify before the index
+    // buffer is uploaded.
+    if(lodCount > 0)
+    {
+        MeshSimplifierSettings simplifierSettings;
+        simplifierSettings.PositionOffset = offsetof(ModelVertex, Pos);
+        MeshSimplifier::GenerateLods(*geo, "skull", lodCount, simplifierSettings);
+    }
+
+    CreateStaticBuffer(device, uploadBatch,
+                       vertices.data(), vertices.size(), sizeof(ModelVertex),
+                       D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, &geo->VertexBufferGPU);
+
+    CreateStaticBuffer(device, uploadBatch,
+                       geo->IndexBufferCPU.data(), geo->IndexBufferByteSize / sizeof(std::uint32_t), sizeof(std::uint32_t),
+                       D3D12_RESOURCE_STATE_INDEX_BUFFER, &geo->IndexBufferGPU);
+
     return geo;
 }
 
@@ -387,17 +415,40 @@ std::unique_ptr<MeshGeometry> d3dUtil::LoadSimpleModelGeometry(
     const std::string& geoName, 
     bool useIndex32)
 {
-    std::vector<M3DLoader::Vertex> m3dVertices;
-    std::vector<UINT> indices32;
-    std::vector<M3DLoader::Subset> subsets;
-    std::vector<M3DLoader::M3dMaterial> mats;
+    Span<const M3DLoader::Vertex> m3dVertices;
+    Span<const UINT> indices32;
+
+    // Prefer the memory mapped binary model, so the vertices and indices are read
+    // straight out of the file mapping without parsing or an intermediate copy.
+    M3dBinaryFile binFile;
+    std::vector<M3DLoader::Vertex> textVertices;
+    std::vector<UINT> textIndices;
+    if(M3DLoader::HasUpToDateBinary(filename) &&
+       binFile.Open(M3dBinary::BinaryFilename(filename)) &&
+       !binFile.IsSkinned())
+    {
+        m3dVertices = binFile.Vertices();
+        indices32 = binFile.Indices();
 
-    M3DLoader loader;
-    loader.LoadM3d(filename, m3dVertices, indices32, subsets, mats);
+        // Assume simple model has one subset and one material.
+        assert(binFile.Subsets().size() == 1);
+        assert(binFile.Materials().size() == 1);
+    }
+    else
+    {
+        std::vector<M3DLoader::Subset> subsets;
+        std::vector<M3DLoader::M3dMaterial> mats;
+
+        M3DLoader loader;
+        loader.LoadM3dText(filename, textVertices, textIndices, subsets, mats);
+
+        m3dVertices = textVertices;
+        indices32 = textIndices;
 
-    // Assume simple model has one subset and one material.
-    assert(subsets.size() == 1);
-    assert(mats.size() == 1);
+        // Assume simple model has one subset and one material.
+        assert(subsets.size() == 1);
+        assert(mats.size() == 1);
+    }
 
     XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
     XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
@@ -423,9 +474,17 @@ std::unique_ptr<MeshGeometry> d3dUtil::LoadSimpleModelGeometry(
     XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
     XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
 
+    // Reorder for the vertex cache.  The mapped indices are read only, so reorder
+    // a copy.
+    std::vector<UINT> indices(std::begin(indices32), std::end(indices32));
+    MeshOptimizerSettings optimizerSettings;
+    optimizerSettings.PositionOffset = offsetof(ModelVertex, Pos);
+    MeshOptimizer::Optimize(vertices.data(), (UINT)vertices.size(), sizeof(ModelVertex),
+                            indices.data(), (UINT)indices.size(), optimizerSettings);
+
     const UINT indexElementByteSize = useIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(ModelVertex);
-    const UINT ibByteSize = (UINT)indices32.size() * indexElementByteSize;
+    const UINT ibByteSize = (UINT)indices.size() * indexElementByteSize;
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = geoName;
@@ -440,17 +499,17 @@ std::unique_ptr<MeshGeometry> d3dUtil::LoadSimpleModelGeometry(
     if(useIndex32)
     {
         geo->IndexBufferCPU.resize(ibByteSize);
-        CopyMemory(geo->IndexBufferCPU.data(), indices32.data(), ibByteSize);
+        CopyMemory(geo->IndexBufferCPU.data(), indices.data(), ibByteSize);
 
         CreateStaticBuffer(
             device, uploadBatch,
-            indices32.data(), indices32.size(), sizeof(uint32_t),
+            indices.data(), indices.size(), sizeof(uint32_t),
             D3D12_RESOURCE_STATE_INDEX_BUFFER, &geo->IndexBufferGPU);
     }
     else
     {
-        std::vector<USHORT> indices16(indices32.size());
-        std::transform(std::begin(indices32), std::end(indices32), std::begin(indices16), [](UINT x)
+        std::vector<USHORT> indices16(indices.size());
+        std::transform(std::begin(indices), std::end(indices), std::begin(indices16), [](UINT x)
         {
             return static_cast<USHORT>(x);
         });
@@ -470,7 +529,7 @@ std::unique_ptr<MeshGeometry> d3dUtil::LoadSimpleModelGeometry(
     geo->IndexBufferByteSize = ibByteSize;
 
     SubmeshGeometry submesh;
-    submesh.IndexCount = (UINT)indices32.size();
+    submesh.IndexCount = (UINT)indices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
     submesh.VertexCount = (UINT)vertices.size();
@@ -481,6 +540,46 @@ std::unique_ptr<MeshGeometry> d3dUtil::LoadSimpleModelGeometry(
     return geo;
 }
 
+std::unique_ptr<MeshletGeometry> d3dUtil::BuildMeshletGeometry(
+    ID3D12Device* device,
+    DirectX::ResourceUploadBatch& uploadBatch,
+    const MeshGeometry& geo,
+    const std::string& meshletFilename,
+    const MeshletSettings* settings)
+{
+    const MeshletSettings defaultSettings;
+    if(settings == nullptr)
+        settings = &defaultSettings;
+
+    auto meshlets = std::make_unique<MeshletGeometry>();
+
+    const uint64_t sourceHash = MeshletBuilder::HashSource(geo);
+    if(meshletFilename.empty() || !MeshletBuilder::Read(meshletFilename, *meshlets, sourceHash, *settings))
+    {
+        *meshlets = MeshletBuilder::Build(geo, 0, *settings);
+
+        if(!meshletFilename.empty())
+            MeshletBuilder::Write(meshletFilename, *meshlets, sourceHash, *settings);
+    }
+
+    CreateStaticBuffer(device, uploadBatch,
+                       meshlets->Meshlets.data(), meshlets->Meshlets.size(), sizeof(Meshlet),
+                       D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, &meshlets->MeshletBufferGPU);
+
+    CreateStaticBuffer(device, uploadBatch,
+                       meshlets->CullData.data(), meshlets->CullData.size(), sizeof(MeshletCullData),
+                       D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, &meshlets->CullDataBufferGPU);
+
+    CreateStaticBuffer(device, uploadBatch,
+                       meshlets->VertexIndices.data(), meshlets->VertexIndices.size(), sizeof(uint32_t),
+                       D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, &meshlets->VertexIndexBufferGPU);
+
+    CreateStaticBuffer(device, uploadBatch,
+                       meshlets->PrimitiveIndices.data(), meshlets->PrimitiveIndices.size(), sizeof(uint32_t),
+                       D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, &meshlets->PrimitiveIndexBufferGPU);
+
+    return meshlets;
+}
 
 std::vector<float> d3dUtil::CalcGaussWeights(float sigma)
 {
@@ -47,6 +47,39 @@ extern const int gNumFrameResources;
 inline constexpr DXGI_FORMAT SsaoAmbientMapFormat = DXGI_FORMAT_R16_UNORM;
 inline constexpr DXGI_FORMAT SceneNormalMapFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
 
+// Non-owning view of a contiguous array.  We target C++17, so we cannot use std::span.
+template<typename T>
+class Span
+{
+public:
+    Span() = default;
+    Span(T* data, size_t count) : mData(data), mCount(count) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Span(std::vector<U>& v) : mData(v.data()), mCount(v.size()) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<const U*, T*>>>
+    Span(const std::vector<U>& v) : mData(v.data()), mCount(v.size()) {}
+
+    T* data()const { return mData; }
+    size_t size()const { return mCount; }
+    size_t size_bytes()const { return mCount * sizeof(T); }
+    bool empty()const { return mCount == 0; }
+
+    T* begin()const { return mData; }
+    T* end()const { return mData + mCount; }
+
+    T& operator[](size_t i)const
+    {
+        assert(i < mCount);
+        return mData[i];
+    }
+
+private:
+    T* mData = nullptr;
+    size_t mCount = 0;
+};
+
 inline void d3dSetDebugName(IDXGIObject* obj, const char* name)
 {
     if(obj)
@@ -76,6 +109,9 @@ inline std::wstring AnsiToWString(const std::string& str)
     return std::wstring(buffer);
 }
 
+struct MeshletGeometry;
+struct MeshletSettings;
+
 class d3dUtil
 {
 public:
@@ -133,13 +169,27 @@ public:
         size_t width, size_t height);
 
     static std::unique_ptr<MeshGeometry> BuildShapeGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch, bool useIndex32 = false);
-    static std::unique_ptr<MeshGeometry> BuildSkullGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch);
+    // With lodCount > 0 the skull also gets up to that many simplified levels of
+    // detail, as the DrawArgs entries "skull_lod1" and on (see MeshSimplifier).
+    static std::unique_ptr<MeshGeometry> BuildSkullGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch, UINT lodCount = 0);
     static std::unique_ptr<MeshGeometry> LoadSimpleModelGeometry(
         ID3D12Device* device, 
         DirectX::ResourceUploadBatch& uploadBatch, 
         const std::string& filename, 
         const std::string& geoName,
         bool useIndex32 = false);
+
+    // Meshlets of geo for the mesh shader path, uploaded as structured buffers.  If
+    // meshletFilename is not empty they are read from that file when it was built
+    // from the same geometry and settings, else built and saved there.  Positions
+    // must be the first vertex element.
+    static std::unique_ptr<MeshletGeometry> BuildMeshletGeometry(
+        ID3D12Device* device,
+        DirectX::ResourceUploadBatch& uploadBatch,
+        const MeshGeometry& geo,
+        const std::string& meshletFilename = "",
+        const MeshletSettings* settings = nullptr);
+
     static std::vector<float> CalcGaussWeights(float sigma);
 };
 
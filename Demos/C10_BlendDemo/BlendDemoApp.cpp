@@ -511,42 +511,36 @@ void BlendDemoApp::UpdateMainPassCB(const GameTimer& gt)
 
 void BlendDemoApp::UpdateWaves(const GameTimer& gt)
 {
-    // Every quarter second, generate a random wave.
+    // Every quarter second, generate a random wave.  A long frame may owe several;
+    // they are handed to the simulation together.
     static float t_base = 0.0f;
-    if((mTimer.TotalTime() - t_base) >= 0.25f)
+    Waves::Disturbance ripples[8];
+    int numRipples = 0;
+    while((mTimer.TotalTime() - t_base) >= 0.25f && numRipples < _countof(ripples))
     {
         t_base += 0.25f;
 
-        int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
-        int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
-
-        float r = mWaveScale * MathHelper::RandF(0.3f, 0.6f);
-
-        mWaves->Disturb(i, j, r);
+        Waves::Disturbance& ripple = ripples[numRipples++];
+        ripple.I = MathHelper::Rand(4, mWaves->RowCount() - 5);
+        ripple.J = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
+        ripple.Magnitude = mWaveScale * MathHelper::RandF(0.3f, 0.6f);
     }
 
+    mWaves->Disturb(ripples, numRipples);
+
     // Update the wave simulation.
     mWaves->Update(gt.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
-    auto currWavesVB = mCurrFrameResource->WavesVB.get();
-    std::vector<ModelVertex> verts(mWaves->VertexCount());
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        XMFLOAT3 pos = mWaves->Position(i);
-
-        verts[i].Pos = pos;
-        verts[i].Normal = mWaves->Normal(i);
-        
-        // Derive tex-coords from position by 
-        // mapping [-w/2,w/2] --> [0,1]
-        verts[i].TexC.x = 0.5f + pos.x / mWaves->Width();
-        verts[i].TexC.y = 0.5f - pos.z / mWaves->Depth();
+    // Write the new solution straight into this frame's wave vertex buffer.  The
+    // attributes the simulation does not own were filled in BuildFrameResources.
+    Waves::VertexLayout layout;
+    layout.Stride = sizeof(ModelVertex);
+    layout.PositionOffset = offsetof(ModelVertex, Pos);
+    layout.NormalOffset = offsetof(ModelVertex, Normal);
+    layout.TexCOffset = offsetof(ModelVertex, TexC);
 
-        // Not used in this demo.
-        verts[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    }
-    currWavesVB->CopyData(verts.data(), verts.size());
+    auto currWavesVB = mCurrFrameResource->WavesVB.get();
+    mWaves->WriteVertices(currWavesVB->MappedData(), mWaves->VertexCount()*sizeof(ModelVertex), layout);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -720,6 +714,13 @@ void BlendDemoApp::BuildFrameResources()
             std::make_unique<FrameResource>(md3dDevice.Get(),
             passCount, matLib.GetMaterialCount(), mWaves->VertexCount()));
     }
+
+    // UpdateWaves only rewrites the attributes the simulation computes; the rest
+    // stay zero (they are not used by the wave shaders).
+    std::vector<ModelVertex> waveVerts(mWaves->VertexCount());
+
+    for(auto& frameResource : mFrameResources)
+        frameResource->WavesVB->CopyData(waveVerts.data(), (uint32_t)waveVerts.size());
 }
 
 void BlendDemoApp::BuildMaterials()
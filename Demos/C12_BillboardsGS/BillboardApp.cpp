@@ -524,42 +524,36 @@ void BillboardApp::UpdateMainPassCB(const GameTimer& gt)
 
 void BillboardApp::UpdateWaves(const GameTimer& gt)
 {
-    // Every quarter second, generate a random wave.
+    // Every quarter second, generate a random wave.  A long frame may owe several;
+    // they are handed to the simulation together.
     static float t_base = 0.0f;
-    if((mTimer.TotalTime() - t_base) >= 0.25f)
+    Waves::Disturbance ripples[8];
+    int numRipples = 0;
+    while((mTimer.TotalTime() - t_base) >= 0.25f && numRipples < _countof(ripples))
     {
         t_base += 0.25f;
 
-        int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
-        int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
-
-        float r = mWaveScale * MathHelper::RandF(0.3f, 0.6f);
-
-        mWaves->Disturb(i, j, r);
+        Waves::Disturbance& ripple = ripples[numRipples++];
+        ripple.I = MathHelper::Rand(4, mWaves->RowCount() - 5);
+        ripple.J = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
+        ripple.Magnitude = mWaveScale * MathHelper::RandF(0.3f, 0.6f);
     }
 
+    mWaves->Disturb(ripples, numRipples);
+
     // Update the wave simulation.
     mWaves->Update(gt.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
-    auto currWavesVB = mCurrFrameResource->WavesVB.get();
-    std::vector<ModelVertex> verts(mWaves->VertexCount());
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        XMFLOAT3 pos = mWaves->Position(i);
-
-        verts[i].Pos = pos;
-        verts[i].Normal = mWaves->Normal(i);
-        
-        // Derive tex-coords from position by 
-        // mapping [-w/2,w/2] --> [0,1]
-        verts[i].TexC.x = 0.5f + pos.x / mWaves->Width();
-        verts[i].TexC.y = 0.5f - pos.z / mWaves->Depth();
+    // Write the new solution straight into this frame's wave vertex buffer.  The
+    // attributes the simulation does not own were filled in BuildFrameResources.
+    Waves::VertexLayout layout;
+    layout.Stride = sizeof(ModelVertex);
+    layout.PositionOffset = offsetof(ModelVertex, Pos);
+    layout.NormalOffset = offsetof(ModelVertex, Normal);
+    layout.TexCOffset = offsetof(ModelVertex, TexC);
 
-        // Not used in this demo.
-        verts[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    }
-    currWavesVB->CopyData(verts.data(), verts.size());
+    auto currWavesVB = mCurrFrameResource->WavesVB.get();
+    mWaves->WriteVertices(currWavesVB->MappedData(), mWaves->VertexCount()*sizeof(ModelVertex), layout);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -782,6 +776,13 @@ void BillboardApp::BuildFrameResources()
             std::make_unique<FrameResource>(md3dDevice.Get(),
             passCount, matLib.GetMaterialCount(), mWaves->VertexCount()));
     }
+
+    // UpdateWaves only rewrites the attributes the simulation computes; the rest
+    // stay zero (they are not used by the wave shaders).
+    std::vector<ModelVertex> waveVerts(mWaves->VertexCount());
+
+    for(auto& frameResource : mFrameResources)
+        frameResource->WavesVB->CopyData(waveVerts.data(), (uint32_t)waveVerts.size());
 }
 
 void BillboardApp::BuildMaterials()
@@ -1009,6 +1010,11 @@ std::unique_ptr<MeshGeometry> BillboardApp::BuildBillboardSpriteGeometry(ID3D12D
 
     constexpr int gridY = 11;
     constexpr int gridX = 11;
+
+    std::vector<float> treeX;
+    std::vector<float> treeZ;
+    treeX.reserve(gridX*gridY);
+    treeZ.reserve(gridX*gridY);
     
     for(int i = 0; i < gridY; ++i)
     {
@@ -1021,26 +1027,33 @@ std::unique_ptr<MeshGeometry> BillboardApp::BuildBillboardSpriteGeometry(ID3D12D
             float x = -50.0f + i * 10.0f;
             float z = +50.0f - j * 10.0f;
 
-            x += jitterX;
-            z += jitterZ;
+            treeX.push_back(x + jitterX);
+            treeZ.push_back(z + jitterZ);
+        }
+    }
+
+    // Snap all of them to the ground at once.
+    std::vector<float> treeY(treeX.size());
+    GetHillsHeights(treeX.data(), treeZ.data(), (UINT)treeX.size(), treeY.data());
 
-            float y = GetHillsHeight(x, z);
+    for(size_t i = 0; i < treeX.size(); ++i)
+    {
+        float y = treeY[i];
 
-            // Only spawn trees above water
-            if(y < 0.25f)
-                continue;
+        // Only spawn trees above water
+        if(y < 0.25f)
+            continue;
 
-            // Move sprite slightly above land height.
-            y += 6.0f;
+        // Move sprite slightly above land height.
+        y += 6.0f;
 
-            float size = MathHelper::RandF(12.0f, 16.0f);
+        float size = MathHelper::RandF(12.0f, 16.0f);
 
-            TreeSpriteVertex sprite;
-            sprite.Pos = XMFLOAT3(x, y, z);
-            sprite.Size = XMFLOAT2(size, size);
+        TreeSpriteVertex sprite;
+        sprite.Pos = XMFLOAT3(treeX[i], y, treeZ[i]);
+        sprite.Size = XMFLOAT2(size, size);
 
-            mTreeSprites.push_back(sprite);
-        }
+        mTreeSprites.push_back(sprite);
     }
 
     std::vector<uint16_t> indices;
@@ -1093,6 +1106,34 @@ float BillboardApp::GetHillsHeight(float x, float z)const
     return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
 }
 
+void BillboardApp::GetHillsHeights(const float* x, const float* z, UINT count, float* heights)const
+{
+    // GetHillsHeight four points at a time.
+    for(UINT i = 0; i < count; i += 4)
+    {
+        const UINT n = std::min(4u, count - i);
+
+        XMFLOAT4 px(0.0f, 0.0f, 0.0f, 0.0f);
+        XMFLOAT4 pz(0.0f, 0.0f, 0.0f, 0.0f);
+        for(UINT k = 0; k < n; ++k)
+        {
+            (&px.x)[k] = x[i + k];
+            (&pz.x)[k] = z[i + k];
+        }
+
+        XMVECTOR vx = XMLoadFloat4(&px);
+        XMVECTOR vz = XMLoadFloat4(&pz);
+        XMVECTOR sinX = XMVectorSin(XMVectorScale(vx, 0.1f));
+        XMVECTOR cosZ = XMVectorCos(XMVectorScale(vz, 0.1f));
+        XMVECTOR h = XMVectorScale(XMVectorMultiplyAdd(vz, sinX, XMVectorMultiply(vx, cosZ)), 0.3f);
+
+        XMFLOAT4 outH;
+        XMStoreFloat4(&outH, h);
+        for(UINT k = 0; k < n; ++k)
+            heights[i + k] = (&outH.x)[k];
+    }
+}
+
 DirectX::XMFLOAT3 BillboardApp::GetHillsNormal(float x, float z)const
 {
     // n = (-df/dx, 1, -df/dz)
@@ -103,6 +103,7 @@ private:
     std::unique_ptr<MeshGeometry> BuildBillboardSpriteGeometry(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch);
 
     float GetHillsHeight(float x, float z)const;
+    void GetHillsHeights(const float* x, const float* z, UINT count, float* heights)const;
     DirectX::XMFLOAT3 GetHillsNormal(float x, float z)const;
 
 private:
@@ -82,7 +82,7 @@ bool InstancingAndCullingApp::Initialize()
         mGeometries[shapeGeo->Name] = std::move(shapeGeo);
     }
 
-    std::unique_ptr<MeshGeometry> skullGeo = d3dUtil::BuildSkullGeometry(md3dDevice.Get(), *mUploadBatch.get());
+    std::unique_ptr<MeshGeometry> skullGeo = d3dUtil::BuildSkullGeometry(md3dDevice.Get(), *mUploadBatch.get(), SkullLodCount);
     if(skullGeo != nullptr)
     {
         mGeometries[skullGeo->Name] = std::move(skullGeo);
@@ -98,6 +98,8 @@ bool InstancingAndCullingApp::Initialize()
 	BuildMaterials();
     BuildRenderItems();
     BuildFrameResources();
+    BuildFrameJobs();
+    mOcclusionBuffer.Resize(OcclusionBufferWidth, OcclusionBufferHeight);
     BuildPSOs();
 
     // Block until the upload work is complete.
@@ -117,8 +119,6 @@ void InstancingAndCullingApp::OnResize()
     D3DApp::OnResize();
 
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-
-    BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
 }
 
 void InstancingAndCullingApp::Update(const GameTimer& gt)
@@ -153,10 +153,8 @@ void InstancingAndCullingApp::Update(const GameTimer& gt)
         XMStoreFloat3(&mRotatedLightDirections[i], lightDir);
     }
 
-	AnimateMaterials(gt);
-    UpdateInstanceData(gt);
-	UpdateMaterialBuffer(gt);
-	UpdateMainPassCB(gt);
+    // The rest runs on the pool while Draw starts recording.
+    mFrameJobs.Kick(TaskPool::Default());
 }
 
 void InstancingAndCullingApp::Draw(const GameTimer& gt)
@@ -165,8 +163,6 @@ void InstancingAndCullingApp::Draw(const GameTimer& gt)
     CbvSrvUavHeap& cbvSrvUavHeap = CbvSrvUavHeap::Get();
     SamplerHeap& samHeap = SamplerHeap::Get();
 
-    UpdateImgui(gt);
-
     auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
 
     // Reuse the memory associated with command recording.
@@ -207,6 +203,11 @@ void InstancingAndCullingApp::Draw(const GameTimer& gt)
 	auto passCB = mCurrFrameResource->PassCB->Resource();
 	mCommandList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_PASS_CBV, passCB->GetGPUVirtualAddress());
 
+    // Everything above only needs the addresses of the frame resource's buffers.  The
+    // draws need the instance counts, and the UI reads and changes what the jobs use.
+    mFrameJobs.Wait();
+    UpdateImgui(gt);
+
     mCommandList->SetPipelineState(mDrawWireframe ? psoLib["opaque_wireframe"] : psoLib["opaque"]);
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
@@ -262,6 +263,35 @@ void InstancingAndCullingApp::UpdateImgui(const GameTimer& gt)
 
     ImGui::Checkbox("Wireframe", &mDrawWireframe);
     ImGui::Checkbox("FrustumCulling Enabled", &mFrustumCullingEnabled);
+    ImGui::Checkbox("OcclusionCulling Enabled", &mOcclusionCullingEnabled);
+    ImGui::SliderInt("Occluders", &mOccluderCount, 1, 64);
+    ImGui::Text("Occluded instances: %u", mOccludedCount);
+    ImGui::Checkbox("LOD Enabled", &mLodEnabled);
+    ImGui::SliderFloat("LOD Pixel Error", &mLodPixelError, 0.25f, 8.0f);
+
+    for(const RenderItem* ri : mRitemLayer[(int)RenderLayer::OpaqueInstanced])
+    {
+        UINT triangleCount = 0;
+        for(size_t lod = 0; lod < ri->Lods.size() && lod < ri->LodInstanceCounts.size(); ++lod)
+        {
+            ImGui::Text("LOD %u: %u triangles, %u instances", (UINT)lod, ri->Lods[lod]->IndexCount / 3, ri->LodInstanceCounts[lod]);
+            triangleCount += ri->Lods[lod]->IndexCount / 3 * ri->LodInstanceCounts[lod];
+        }
+
+        if(!ri->Lods.empty())
+            ImGui::Text("Instanced triangles drawn: %u", triangleCount);
+    }
+
+    if(ImGui::CollapsingHeader("Update jobs"))
+    {
+        for(UINT job = 0; job < mFrameJobs.JobCount(); ++job)
+        {
+            const JobTiming& timing = mFrameJobs.GetTiming(job);
+            ImGui::Text("%s: %.3f ms on thread %u", mFrameJobs.JobName(job).c_str(), timing.EndMs - timing.StartMs, timing.Thread);
+        }
+
+        ImGui::Text("Kick to last job done: %.3f ms", mFrameJobs.RunMs());
+    }
 
     GraphicsMemoryStatistics gfxMemStats = GraphicsMemory::Get(md3dDevice.Get()).GetStatistics();
     
@@ -367,48 +397,126 @@ void InstancingAndCullingApp::AnimateMaterials(const GameTimer& gt)
 	
 }
 
+void InstancingAndCullingApp::CullInstances(const GameTimer& gt)
+{
+    // The instances' bounds are kept in world space, so they are all tested against
+    // the world space planes of the frustum at once.
+    XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+    XMFLOAT4 frustumPlanes[6];
+    MathHelper::ExtractFrustumPlanes(viewProj, frustumPlanes);
+
+    mOccludedCount = 0;
+    for(auto& e : mRitemLayer[(int)RenderLayer::OpaqueInstanced])
+    {
+        const auto& instanceData = e->Instances;
+        std::vector<UINT>& visibleIndices = e->VisibleIndices;
+
+        if(mFrustumCullingEnabled)
+        {
+            e->InstanceCuller.Cull(frustumPlanes, visibleIndices);
+        }
+        else
+        {
+            visibleIndices.resize(instanceData.size());
+            for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
+                visibleIndices[i] = i;
+        }
+
+        if(mOcclusionCullingEnabled && !e->Occluder.Indices.empty())
+        {
+            // The nearest instances in view hide the most, so they are the occluders.
+            XMFLOAT3 eyePos = mCamera.GetPosition3f();
+            mOccluderCandidates.clear();
+            for(UINT i : visibleIndices)
+            {
+                const XMFLOAT4X4& world = instanceData[i].World;
+                const float dx = world._41 - eyePos.x;
+                const float dy = world._42 - eyePos.y;
+                const float dz = world._43 - eyePos.z;
+                mOccluderCandidates.push_back({ dx*dx + dy*dy + dz*dz, i });
+            }
+
+            const size_t occluderCount = std::min((size_t)mOccluderCount, mOccluderCandidates.size());
+            std::nth_element(mOccluderCandidates.begin(), mOccluderCandidates.begin() + occluderCount, mOccluderCandidates.end());
+
+            mOcclusionBuffer.Clear(viewProj);
+            for(size_t o = 0; o < occluderCount; ++o)
+                mOcclusionBuffer.DrawOccluder(e->Occluder, XMLoadFloat4x4(&instanceData[mOccluderCandidates[o].second].World));
+            mOcclusionBuffer.BuildPyramid();
+
+            // Drop the hidden instances before they are given a level of detail and
+            // written to the instance buffer.  The occluders are in front of their own
+            // boxes, so they stay.
+            const size_t inViewCount = visibleIndices.size();
+            visibleIndices.erase(std::remove_if(visibleIndices.begin(), visibleIndices.end(), [&](UINT i)
+            {
+                return mOcclusionBuffer.IsOccluded(e->Bounds, XMLoadFloat4x4(&instanceData[i].World));
+            }), visibleIndices.end());
+            mOccludedCount += (UINT)(inViewCount - visibleIndices.size());
+        }
+    }
+}
+
 void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 {
-    XMMATRIX view = mCamera.GetView();
-    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+    TaskPool& pool = TaskPool::Default();
 
     auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
     for(auto& e : mRitemLayer[(int)RenderLayer::OpaqueInstanced])
     {
         const auto& instanceData = e->Instances;
+        const std::vector<UINT>& visibleIndices = e->VisibleIndices;
 
-        int visibleInstanceCount = 0;
-
-        for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
+        // Coarsest level whose error stays under the pixel threshold.
+        mVisibleInstances.resize(visibleIndices.size());
+        pool.ParallelFor((UINT)visibleIndices.size(), 1024, [&](UINT begin, UINT end)
         {
-            XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-            XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+            for(UINT v = begin; v < end; ++v)
+            {
+                const UINT i = visibleIndices[v];
+
+                UINT lod = 0;
+                if(mLodEnabled)
+                    lod = MeshSimplifier::SelectLod(e->Lods, XMLoadFloat4x4(&instanceData[i].World), mCamera, (float)mClientHeight, mLodPixelError);
+
+                mVisibleInstances[v] = { i, lod };
+            }
+        });
 
-            XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+        // Group the visible instances by level of detail, so each level is one
+        // instanced draw over a contiguous range of the instance buffer.
+        const UINT lodCount = std::max((UINT)e->Lods.size(), 1u);
+        e->LodInstanceCounts.assign(lodCount, 0);
+        for(const auto& visible : mVisibleInstances)
+            e->LodInstanceCounts[visible.second]++;
 
-            // View space to the object's local space.
-            XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+        std::vector<UINT> lodOffsets(lodCount, 0);
+        for(UINT lod = 1; lod < lodCount; ++lod)
+            lodOffsets[lod] = lodOffsets[lod - 1] + e->LodInstanceCounts[lod - 1];
 
-            // Transform the camera frustum from view space to the object's local space.
-            BoundingFrustum localSpaceFrustum;
-            mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+        // Replace each level with the instance's slot, so the slots can be written
+        // in any order.
+        for(auto& visible : mVisibleInstances)
+            visible.second = lodOffsets[visible.second]++;
 
-            // Perform the box/frustum intersection test in local space.
-            auto result = localSpaceFrustum.Contains(e->Bounds);
-            if(mFrustumCullingEnabled==false || result != DirectX::DISJOINT)
+        pool.ParallelFor((UINT)mVisibleInstances.size(), 1024, [&](UINT begin, UINT end)
+        {
+            for(UINT v = begin; v < end; ++v)
             {
+                const InstanceData& instance = instanceData[mVisibleInstances[v].first];
+
                 InstanceData data;
-                XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-                XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-                data.MaterialIndex = instanceData[i].MaterialIndex;
+                XMStoreFloat4x4(&data.World, XMMatrixTranspose(XMLoadFloat4x4(&instance.World)));
+                XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instance.TexTransform)));
+                data.MaterialIndex = instance.MaterialIndex;
                 data.CubeMapIndex = mSkyBindlessIndex;
 
                 // Write the instance data to structured buffer for the visible objects.
-                currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+                currInstanceBuffer->CopyData(mVisibleInstances[v].second, data);
             }
-        }
+        });
 
-        e->InstanceCount = visibleInstanceCount;
+        e->InstanceCount = (UINT)mVisibleInstances.size();
 
         std::wostringstream outs;
         outs.precision(6);
@@ -600,6 +708,24 @@ void InstancingAndCullingApp::BuildFrameResources()
     }
 }
 
+void InstancingAndCullingApp::BuildFrameJobs()
+{
+    // The jobs write only the current frame resource, which the GPU is done with by
+    // the time Update kicks them, while it may still be drawing the previous frames
+    // from the others.
+    mFrameJobs.Add("Materials", [this]()
+    {
+        AnimateMaterials(mTimer);
+        UpdateMaterialBuffer(mTimer);
+    });
+
+    mFrameJobs.Add("PassCB", [this]() { UpdateMainPassCB(mTimer); });
+
+    JobGraph::JobId cull = mFrameJobs.Add("CullInstances", [this]() { CullInstances(mTimer); });
+    JobGraph::JobId instances = mFrameJobs.Add("InstanceData", [this]() { UpdateInstanceData(mTimer); });
+    mFrameJobs.AddDependency(instances, cull);
+}
+
 void InstancingAndCullingApp::BuildMaterials()
 {
     MaterialLib::GetLib().Init(md3dDevice.Get());
@@ -633,7 +759,12 @@ void InstancingAndCullingApp::BuildRenderItems()
 
     XMStoreFloat4x4(&worldTransform, XMMatrixScaling(0.4f, 0.4f, 0.4f) * XMMatrixTranslation(0.0f, 1.0f, 0.0f));
     texTransform = MathHelper::Identity4x4();
-    RenderItem* skullRitem = AddRenderItem(RenderLayer::OpaqueInstanced, worldTransform, texTransform, matLib["skullMat"], mGeometries["skullGeo"].get(), mGeometries["skullGeo"]->DrawArgs["skull"]);
+    MeshGeometry* skullGeo = mGeometries["skullGeo"].get();
+    RenderItem* skullRitem = AddRenderItem(RenderLayer::OpaqueInstanced, worldTransform, texTransform, matLib["skullMat"], skullGeo, skullGeo->DrawArgs["skull"]);
+
+    // The skull's levels of detail, as many as the simplifier generated.
+    for(UINT lod = 0; skullGeo->DrawArgs.count(MeshSimplifier::LodName("skull", lod)) != 0; ++lod)
+        skullRitem->Lods.push_back(&skullGeo->DrawArgs[MeshSimplifier::LodName("skull", lod)]);
 
     // Generate instance data.
     skullRitem->Instances.resize(MaxInstanceCount);
@@ -668,6 +799,17 @@ void InstancingAndCullingApp::BuildRenderItems()
             }
         }
     }
+
+    const SubmeshGeometry& skullSubmesh = skullGeo->DrawArgs["skull"];
+    skullRitem->Occluder.Build(skullGeo->VertexBufferCPU.data() + (size_t)skullSubmesh.BaseVertexLocation * skullGeo->VertexByteStride,
+                               skullGeo->VertexByteStride,
+                               skullGeo->IndexBufferCPU.data() + (size_t)skullSubmesh.StartIndexLocation * sizeof(std::uint32_t),
+                               sizeof(std::uint32_t), skullSubmesh.IndexCount);
+
+    // The instances never move, so their world space bounds are set once.
+    skullRitem->InstanceCuller.Resize((UINT)skullRitem->Instances.size());
+    for(UINT i = 0; i < (UINT)skullRitem->Instances.size(); ++i)
+        skullRitem->InstanceCuller.SetTransformed(i, skullRitem->Bounds, XMLoadFloat4x4(&skullRitem->Instances[i].World));
 }
 
 void InstancingAndCullingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -700,7 +842,32 @@ void InstancingAndCullingApp::DrawInstancedRenderItems(ID3D12GraphicsCommandList
 
         cmdList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_OBJECT_CBV, 0);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+        if(ri->Lods.empty())
+        {
+            cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+            continue;
+        }
+
+        // SV_InstanceID starts at 0 whatever the start instance location, so each
+        // level points the instance buffer view at its own range instead.
+        auto instanceBuffer = mCurrFrameResource->InstanceBuffer->Resource();
+        UINT startInstance = 0;
+        for(size_t lod = 0; lod < ri->Lods.size(); ++lod)
+        {
+            const UINT instanceCount = ri->LodInstanceCounts[lod];
+            if(instanceCount == 0)
+                continue;
+
+            cmdList->SetGraphicsRootShaderResourceView(GFX_ROOT_ARG_INSTANCEDATA_SRV,
+                instanceBuffer->GetGPUVirtualAddress() + startInstance*sizeof(InstanceData));
+
+            const SubmeshGeometry* submesh = ri->Lods[lod];
+            cmdList->DrawIndexedInstanced(submesh->IndexCount, instanceCount, submesh->StartIndexLocation, submesh->BaseVertexLocation, 0);
+            startInstance += instanceCount;
+        }
+
+        // Restore the view for anything drawn after.
+        cmdList->SetGraphicsRootShaderResourceView(GFX_ROOT_ARG_INSTANCEDATA_SRV, instanceBuffer->GetGPUVirtualAddress());
     }
 }
 
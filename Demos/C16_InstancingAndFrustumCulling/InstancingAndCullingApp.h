@@ -4,6 +4,10 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/MeshGen.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/OcclusionBuffer.h"
+#include "../../Common/JobGraph.h"
 #include "../../Common/DescriptorUtil.h"
 #include "../../Common/Camera.h"
 #include "../../Common/ShaderLib.h"
@@ -41,6 +45,20 @@ struct RenderItem
     DirectX::BoundingBox Bounds;
     std::vector<InstanceData> Instances;
 
+    // World space bounds of the instances, set when they are created.
+    FrustumCuller InstanceCuller;
+
+    // Triangles drawn into the occlusion buffer for the nearest instances.
+    OccluderMesh Occluder;
+
+    // Indices of the instances that pass culling this frame.
+    std::vector<UINT> VisibleIndices;
+
+    // Levels of detail, finest first, and how many visible instances draw with each.
+    // Empty to draw all instances with the DrawIndexedInstanced parameters below.
+    std::vector<const SubmeshGeometry*> Lods;
+    std::vector<UINT> LodInstanceCounts;
+
     // DrawIndexedInstanced parameters.
     UINT IndexCount = 0;
     UINT InstanceCount = 0;
@@ -81,6 +99,7 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
     void AnimateMaterials(const GameTimer& gt);
+    void CullInstances(const GameTimer& gt);
     void UpdateInstanceData(const GameTimer& gt);
     void UpdateMaterialBuffer(const GameTimer& gt);
     void UpdateMainPassCB(const GameTimer& gt);
@@ -93,6 +112,7 @@ private:
     void BuildFrameResources();
 
     void BuildMaterials();
+    void BuildFrameJobs();
 
     RenderItem* AddRenderItem(RenderLayer layer, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& texTransform, Material* mat, MeshGeometry* geo, SubmeshGeometry& drawArgs);
     void BuildRenderItems();
@@ -132,6 +152,24 @@ private:
 
     static constexpr int InstanceGridSize = 15;
     static constexpr int MaxInstanceCount = InstanceGridSize * InstanceGridSize * InstanceGridSize;
+    static constexpr UINT SkullLodCount = 5;
+
+    // The index and level of detail of each visible instance, then the index and its
+    // slot in the instance buffer, rebuilt every frame.
+    std::vector<std::pair<UINT, UINT>> mVisibleInstances;
+
+    // Instances in the frustum by squared distance from the camera; the nearest are
+    // drawn as occluders.
+    std::vector<std::pair<float, UINT>> mOccluderCandidates;
+
+    // Low resolution depth of the occluders, rebuilt every frame.
+    OcclusionBuffer mOcclusionBuffer;
+    static constexpr UINT OcclusionBufferWidth = 256;
+    static constexpr UINT OcclusionBufferHeight = 144;
+
+    // The Update work as jobs.  Update kicks them once the frame resource they write is
+    // free, and Draw waits for them before the draws that need the instance counts.
+    JobGraph mFrameJobs;
 
     float mLightNearZ = 0.0f;
     float mLightFarZ = 0.0f;
@@ -147,10 +185,13 @@ private:
     };
     DirectX::XMFLOAT3 mRotatedLightDirections[3];
 
-    DirectX::BoundingFrustum mCamFrustum;
-
     bool mDrawWireframe = false;
     bool mFrustumCullingEnabled = true;
+    bool mOcclusionCullingEnabled = true;
+    int mOccluderCount = 16;
+    UINT mOccludedCount = 0;
+    bool mLodEnabled = true;
+    float mLodPixelError = 1.0f;
     bool mNormalMapsEnabled = false;
     bool mReflectionsEnabled = false;
 
@@ -86,6 +86,7 @@ bool PickingApp::Initialize()
     BuildShadersAndInputLayout();
     BuildMaterials();
     BuildRenderItems();
+    BuildPickingBvh();
     BuildFrameResources();
     BuildPSOs();
 
@@ -660,6 +661,14 @@ void PickingApp::AddRenderItem(RenderLayer layer, const XMFLOAT4X4& world, const
     ritem->BaseVertexLocation = drawArgs.BaseVertexLocation;
     ritem->Bounds = drawArgs.Bounds;
 
+    std::unique_ptr<MeshBvh>& bvh = mMeshBvhs[&drawArgs];
+    if(bvh == nullptr)
+    {
+        bvh = std::make_unique<MeshBvh>();
+        bvh->Build(*geo, drawArgs);
+    }
+    ritem->Bvh = bvh.get();
+
     mRitemLayer[(int)layer].push_back(ritem.get());
     mAllRitems.push_back(std::move(ritem));
 }
@@ -746,6 +755,17 @@ void PickingApp::BuildRenderItems()
     mPickedRitem = mAllRitems.back().get();
 }
 
+void PickingApp::BuildPickingBvh()
+{
+    // A real app might keep a separate "picking list" of objects that can be selected.
+    for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+    {
+        BoundingBox worldBounds;
+        ri->Bounds.Transform(worldBounds, XMLoadFloat4x4(&ri->World));
+        ri->SceneProxy = mSceneTree.Insert(worldBounds, ri);
+    }
+}
+
 void PickingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
     for(size_t i = 0; i < ritems.size(); ++i)
@@ -780,93 +800,51 @@ void PickingApp::Pick(int sx, int sy)
     XMMATRIX V = mCamera.GetView();
     XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
 
+    // Transform the ray to world space.  The scene hierarchy finds the render items
+    // whose bounds the ray passes through, and each of those is tested in its local
+    // space against the hierarchy over its own triangles.
+    XMVECTOR rayOriginW = XMVector3TransformCoord(rayOriginV, invView);
+    XMVECTOR rayDirW = XMVector3TransformNormal(rayDirV, invView);
+
     // Assume nothing is picked to start, so the picked render-item is invisible.
     mPickedRitem->Visible = false;
 
-    float minWorldDist = MathHelper::Infinity;
+    // The items come in the order the ray enters their bounds, so once one is entered
+    // beyond the nearest hit so far, none of the rest can be nearer to the camera.
+    mSceneTree.QueryRay(rayOriginW, rayDirW, FLT_MAX, mRayHits);
 
-    // Check if we picked an opaque render item.  A real app might keep a separate "picking list"
-    // of objects that can be selected.   
-    for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+    RayHit hit;
+    RenderItem* ri = nullptr;
+    for(const DynamicBvhRayHit& entry : mRayHits)
     {
-        auto geo = ri->Geo;
+        if(entry.T >= hit.T)
+            break;
 
-        // Skip invisible render-items.
-        if(ri->Visible == false)
-            continue;
+        RenderItem* candidate = static_cast<RenderItem*>(mSceneTree.GetUserData(entry.Proxy));
 
-        XMMATRIX W = XMLoadFloat4x4(&ri->World);
+        // An affine transform keeps the ray parameter, so hit.T carries over.
+        XMMATRIX W = XMLoadFloat4x4(&candidate->World);
         XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+        XMVECTOR rayOriginL = XMVector3TransformCoord(rayOriginW, invWorld);
+        XMVECTOR rayDirL = XMVector3TransformNormal(rayDirW, invWorld);
 
-        // Tranform ray from view space to the local space of the mesh.
-        XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+        if(candidate->Bvh->Intersect(rayOriginL, rayDirL, hit))
+            ri = candidate;
+    }
 
-        XMVECTOR rayOriginL = XMVector3TransformCoord(rayOriginV, toLocal);
-        XMVECTOR rayDirL = XMVector3TransformNormal(rayDirV, toLocal);
+    if(ri == nullptr || ri->Visible == false)
+        return;
 
-        // Make the ray direction unit length for the intersection tests.
-        rayDirL = XMVector3Normalize(rayDirL);
+    mPickedRitem->Visible = true;
 
-        // If we did not hit the bounding box, then it is impossible that we hit 
-        // the Mesh, so do not waste effort doing ray/triangle tests.
-        float boxDist = 0.0f;
-        if(ri->Bounds.Intersects(rayOriginL, rayDirL, boxDist))
-        {
-            // NOTE: For the demo, we know what to cast the vertex/index data to (we force 16-bit indices). 
-            // If we were mixing formats, some metadata would be needed to figure out what to cast it to.
-            ModelVertex* vertices = (ModelVertex*)geo->VertexBufferCPU.data();
-            uint16_t* indices = (uint16_t*)geo->IndexBufferCPU.data();
-
-            UINT triCount = ri->IndexCount / 3;
-
-            // Find the nearest ray/triangle intersection.
-            for(UINT i = 0; i < triCount; ++i)
-            {
-                // Indices for this triangle.
-                UINT i0 = ri->BaseVertexLocation + indices[ri->StartIndexLocation + i * 3 + 0];
-                UINT i1 = ri->BaseVertexLocation + indices[ri->StartIndexLocation + i * 3 + 1];
-                UINT i2 = ri->BaseVertexLocation + indices[ri->StartIndexLocation + i * 3 + 2];
-
-                // Vertices for this triangle.
-                XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-                XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-                XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-                // We have to iterate over all the triangles of all the objects whose bounds
-                // we hit in order to find the nearest intersection.
-                float t = FLT_MAX;
-                if(TriangleTests::Intersects(rayOriginL, rayDirL, v0, v1, v2, t))
-                {
-                    XMVECTOR hitPosL = rayOriginL + t * rayDirL;
-
-                    XMVECTOR hitPosW = XMVector3TransformCoord(hitPosL, W);
-
-                    // Take hit position closest to the camera. Do this in world space, as 
-                    // we want the nearest hit across all objects in the scene, not just
-                    // the current mesh.
-                    float t_world = XMVectorGetX(XMVector3Length(hitPosW - mCamera.GetPosition()));
-
-                    if(t_world < minWorldDist)
-                    {
-                        // This is the new nearest picked triangle.
-                        minWorldDist = t_world;
-                        UINT pickedTriangle = i;
-
-                        mPickedRitem->Visible = true;
-
-                        // Propagate properties from selected geometry.
-                        mPickedRitem->BaseVertexLocation = ri->BaseVertexLocation;
-                        mPickedRitem->World = ri->World;
-                        mPickedRitem->TexTransform = ri->TexTransform;
-                        mPickedRitem->Geo = ri->Geo;
-                        mPickedRitem->PrimitiveType = ri->PrimitiveType;
-
-                        // Offset to the picked triangle in the mesh index buffer.
-                        mPickedRitem->IndexCount = 3;
-                        mPickedRitem->StartIndexLocation = ri->StartIndexLocation + 3 * pickedTriangle;
-                    }
-                }
-            }
-        }
-    }
+    // Propagate properties from selected geometry.
+    mPickedRitem->BaseVertexLocation = ri->BaseVertexLocation;
+    mPickedRitem->World = ri->World;
+    mPickedRitem->TexTransform = ri->TexTransform;
+    mPickedRitem->Geo = ri->Geo;
+    mPickedRitem->PrimitiveType = ri->PrimitiveType;
+
+    // Offset to the picked triangle in the mesh index buffer.
+    mPickedRitem->IndexCount = 3;
+    mPickedRitem->StartIndexLocation = ri->StartIndexLocation + 3 * hit.Triangle;
 }
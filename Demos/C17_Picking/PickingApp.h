@@ -10,6 +10,8 @@
 #include "../../Common/TextureLib.h"
 #include "../../Common/MaterialLib.h"
 #include "../../Common/PsoLib.h"
+#include "../../Common/MeshBvh.h"
+#include "../../Common/DynamicBvh.h"
 #include "FrameResource.h"
 
 
@@ -38,6 +40,11 @@ struct RenderItem
     Material* Mat = nullptr;
     MeshGeometry* Geo = nullptr;
 
+    // Hierarchy over the triangles of the drawn submesh, for picking, and the item's
+    // proxy in the scene hierarchy if it can be picked.
+    const MeshBvh* Bvh = nullptr;
+    UINT SceneProxy = DynamicBvh::NullProxy;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -96,6 +103,7 @@ private:
 
     void AddRenderItem(RenderLayer layer, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& texTransform, Material* mat, MeshGeometry* geo, SubmeshGeometry& drawArgs);
     void BuildRenderItems();
+    void BuildPickingBvh();
 
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 
@@ -124,6 +132,13 @@ private:
     // triangle in the PickingApp class.
     RenderItem* mPickedRitem = nullptr;
 
+    // One hierarchy per drawn submesh, shared by the render items that draw it, and
+    // one over the world space bounds of the pickable render items, which a render
+    // item that moves would update.
+    std::unordered_map<const SubmeshGeometry*, std::unique_ptr<MeshBvh>> mMeshBvhs;
+    DynamicBvh mSceneTree;
+    std::vector<DynamicBvhRayHit> mRayHits;
+
     uint32_t mRandomTexBindlessIndex = -1;
     uint32_t mSkyBindlessIndex = -1;
 
@@ -157,6 +157,8 @@ void ShadowMapApp::Update(const GameTimer& gt)
     UpdateShadowTransform(gt);
 	UpdateMainPassCB(gt);
     UpdateShadowPassCB(gt);
+    UpdateVisibleRenderItems(gt);
+    UpdateRenderQueues(gt);
 }
 
 void ShadowMapApp::Draw(const GameTimer& gt)
@@ -206,14 +208,8 @@ void ShadowMapApp::Draw(const GameTimer& gt)
 	auto passCB = mCurrFrameResource->PassCB->Resource();
 	mCommandList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_PASS_CBV, passCB->GetGPUVirtualAddress());
 
-    mCommandList->SetPipelineState(mDrawWireframe ? psoLib["opaque_wireframe"] : psoLib["opaque"]);
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-
-    mCommandList->SetPipelineState(psoLib["debug"]);
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Debug]);
-
-	mCommandList->SetPipelineState(psoLib["sky"]);
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
+    // The opaque, debug and sky layers, in that order.
+    mMainQueueStats = DrawRenderQueue(mCommandList.Get(), mMainQueue, mMainInstanceData);
 
     // Draw imgui UI.
     ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), mCommandList.Get());
@@ -260,6 +256,7 @@ void ShadowMapApp::UpdateImgui(const GameTimer& gt)
     ImGui::Checkbox("NormalMaps", &mNormalMapsEnabled);
     ImGui::Checkbox("Reflections", &mReflectionsEnabled);
     ImGui::Checkbox("Shadows", &mShadowsEnabled);
+    ImGui::Checkbox("Draw batching", &mDrawBatchingEnabled);
 
     GraphicsMemoryStatistics gfxMemStats = GraphicsMemory::Get(md3dDevice.Get()).GetStatistics();
     
@@ -291,6 +288,18 @@ void ShadowMapApp::UpdateImgui(const GameTimer& gt)
         ImGui::Text("Total bytes used: %u", gfxMemStats.totalMemory);
         ImGui::Text("Total page count: %u", gfxMemStats.totalPages);
     }
+    if (ImGui::CollapsingHeader("RenderQueues"))
+    {
+        const RenderQueueStats* stats[] = { &mMainQueueStats, &mShadowQueueStats };
+        const char* names[] = { "Main", "Shadow" };
+        for(int i = 0; i < 2; ++i)
+        {
+            ImGui::Text("%s: %u items in %u draws (%u instanced, %u items)", names[i], stats[i]->Items, stats[i]->Draws,
+                stats[i]->InstancedDraws, stats[i]->InstancedItems);
+            ImGui::Text("    PSO %u, geometry %u, topology %u, root arg %u changes", stats[i]->PsoChanges,
+                stats[i]->GeometryChanges, stats[i]->TopologyChanges, stats[i]->RootArgChanges);
+        }
+    }
 
     ImGui::End();
 
@@ -531,6 +540,69 @@ void ShadowMapApp::UpdateShadowPassCB(const GameTimer& gt)
     currPassCB->CopyData(1, mShadowPassCB);
 }
 
+void ShadowMapApp::UpdateVisibleRenderItems(const GameTimer& gt)
+{
+    // The opaque items in the camera frustum...
+    XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+    XMFLOAT4 frustumPlanes[6];
+    MathHelper::ExtractFrustumPlanes(viewProj, frustumPlanes);
+
+    mQueryProxies.clear();
+    mSceneTree.QueryFrustum(frustumPlanes, mQueryProxies);
+
+    mVisibleRitems.clear();
+    for(UINT proxy : mQueryProxies)
+        mVisibleRitems.push_back(static_cast<RenderItem*>(mSceneTree.GetUserData(proxy)));
+
+    // ...and the ones that overlap the region the shadow map is fitted to, which are
+    // the ones drawn into it.
+    mQueryProxies.clear();
+    mSceneTree.QuerySphere(mSceneBounds, mQueryProxies);
+
+    mShadowCasterRitems.clear();
+    for(UINT proxy : mQueryProxies)
+        mShadowCasterRitems.push_back(static_cast<RenderItem*>(mSceneTree.GetUserData(proxy)));
+}
+
+void ShadowMapApp::UpdateRenderQueues(const GameTimer& gt)
+{
+    PsoLib& psoLib = PsoLib::GetLib();
+
+    // Sorted front to back from the camera...
+    XMMATRIX view = mCamera.GetView();
+
+    mMainQueue.SetDepthRange(mCamera.GetFarZ());
+    mMainQueue.SetMinBatchSize(mDrawBatchingEnabled ? 2 : 0);
+    mMainQueue.Clear();
+
+    ID3D12PipelineState* opaquePso = mDrawWireframe ? psoLib["opaque_wireframe"] : psoLib["opaque"];
+    ID3D12PipelineState* opaqueInstancedPso = mDrawWireframe ? psoLib["opaque_instanced_wireframe"] : psoLib["opaque_instanced"];
+    for(const RenderItem* ri : mVisibleRitems)
+        AddToRenderQueue(mMainQueue, RenderLayer::Opaque, ri, view, opaquePso, opaqueInstancedPso);
+
+    for(const RenderItem* ri : mRitemLayer[(int)RenderLayer::Debug])
+        AddToRenderQueue(mMainQueue, RenderLayer::Debug, ri, view, psoLib["debug"], nullptr);
+
+    for(const RenderItem* ri : mRitemLayer[(int)RenderLayer::Sky])
+        AddToRenderQueue(mMainQueue, RenderLayer::Sky, ri, view, psoLib["sky"], nullptr);
+
+    mMainQueue.Build();
+    mMainInstanceData = CopyInstanceData(mMainQueue);
+
+    // ...and from the light.
+    XMMATRIX lightView = XMLoadFloat4x4(&mLightView);
+
+    mShadowQueue.SetDepthRange(mLightFarZ);
+    mShadowQueue.SetMinBatchSize(mDrawBatchingEnabled ? 2 : 0);
+    mShadowQueue.Clear();
+
+    for(const RenderItem* ri : mShadowCasterRitems)
+        AddToRenderQueue(mShadowQueue, RenderLayer::Opaque, ri, lightView, psoLib["shadow_opaque"], psoLib["shadow_opaque_instanced"]);
+
+    mShadowQueue.Build();
+    mShadowInstanceData = CopyInstanceData(mShadowQueue);
+}
+
 void ShadowMapApp::LoadTextures()
 {
     TextureLib& texLib = TextureLib::GetLib();
@@ -744,6 +816,15 @@ void ShadowMapApp::AddRenderItem(RenderLayer layer, const XMFLOAT4X4& world, con
     ritem->IndexCount = drawArgs.IndexCount;
     ritem->StartIndexLocation = drawArgs.StartIndexLocation;
     ritem->BaseVertexLocation = drawArgs.BaseVertexLocation;
+    ritem->Bounds = drawArgs.Bounds;
+
+    // Opaque items are drawn from what the scene hierarchy finds in view.
+    if(layer == RenderLayer::Opaque)
+    {
+        BoundingBox worldBounds;
+        ritem->Bounds.Transform(worldBounds, XMLoadFloat4x4(&world));
+        ritem->SceneProxy = mSceneTree.Insert(worldBounds, ritem.get());
+    }
 
     mRitemLayer[(int)layer].push_back(ritem.get());
     mAllRitems.push_back(std::move(ritem));
@@ -827,26 +908,49 @@ void ShadowMapApp::BuildRenderItems()
     AddRenderItem(RenderLayer::Debug, worldTransform, texTransform, matLib["bricks0"], mGeometries["shapeGeo"].get(), mGeometries["shapeGeo"]->DrawArgs["quad"]);
 }
 
-void ShadowMapApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void ShadowMapApp::AddToRenderQueue(RenderQueue& queue, RenderLayer layer, const RenderItem* ri, FXMMATRIX view,
+    ID3D12PipelineState* pso, ID3D12PipelineState* instancedPso)
+{
+    XMVECTOR centerW = XMVector3Transform(XMLoadFloat3(&ri->Bounds.Center), XMLoadFloat4x4(&ri->World));
+
+    DrawItem item;
+    item.Layer = (UINT)layer;
+    item.Pso = pso;
+    item.InstancedPso = instancedPso;
+    item.Geo = ri->Geo;
+    item.PrimitiveType = ri->PrimitiveType;
+    item.IndexCount = ri->IndexCount;
+    item.StartIndexLocation = ri->StartIndexLocation;
+    item.BaseVertexLocation = ri->BaseVertexLocation;
+    item.MaterialIndex = ri->Mat->MatIndex;
+    item.Depth = XMVectorGetZ(XMVector3Transform(centerW, view));
+    item.ObjectCB = ri->MemHandleToObjectCB.GpuAddress();
+    item.Constants = &ri->ObjectConstants;
+
+    queue.Add(item);
+}
+
+GraphicsResource ShadowMapApp::CopyInstanceData(const RenderQueue& queue)
 {
-    for(size_t i = 0; i < ritems.size(); ++i)
-    {
-        auto ri = ritems[i];
+    const std::vector<InstanceData>& instanceData = queue.GetInstanceData();
+    if(instanceData.empty())
+        return GraphicsResource();
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+    const size_t byteSize = instanceData.size() * sizeof(InstanceData);
+    GraphicsResource mem = mLinearAllocator->Allocate(byteSize);
+    memcpy(mem.Memory(), instanceData.data(), byteSize);
 
-		cmdList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_OBJECT_CBV, ri->MemHandleToObjectCB.GpuAddress());
+    return mem;
+}
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-    }
+RenderQueueStats ShadowMapApp::DrawRenderQueue(ID3D12GraphicsCommandList* cmdList, const RenderQueue& queue, const GraphicsResource& instanceData)
+{
+    CommandListDrawSink sink(cmdList, GFX_ROOT_ARG_OBJECT_CBV, GFX_ROOT_ARG_INSTANCEDATA_SRV);
+    return queue.Execute(sink, instanceData.GpuAddress());
 }
 
 void ShadowMapApp::DrawSceneToShadowMap()
 {
-    PsoLib& psoLib = PsoLib::GetLib();
-
     mCommandList->RSSetViewports(1, &mShadowMap->Viewport());
     mCommandList->RSSetScissorRects(1, &mShadowMap->ScissorRect());
 
@@ -870,9 +974,7 @@ void ShadowMapApp::DrawSceneToShadowMap()
     D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1*passCBByteSize;
     mCommandList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_PASS_CBV, passCBAddress);
 
-    mCommandList->SetPipelineState(psoLib["shadow_opaque"]);
-
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+    mShadowQueueStats = DrawRenderQueue(mCommandList.Get(), mShadowQueue, mShadowInstanceData);
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
@@ -10,6 +10,8 @@
 #include "../../Common/TextureLib.h"
 #include "../../Common/MaterialLib.h"
 #include "../../Common/PsoLib.h"
+#include "../../Common/DynamicBvh.h"
+#include "../../Common/RenderQueue.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
 
@@ -39,6 +41,10 @@ struct RenderItem
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
+    // Local space bounds, and the item's proxy in the scene hierarchy if it has one.
+    DirectX::BoundingBox Bounds;
+    UINT SceneProxy = DynamicBvh::NullProxy;
+
     // DrawIndexedInstanced parameters.
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
@@ -82,6 +88,8 @@ private:
     void UpdateShadowTransform(const GameTimer& gt);
     void UpdateMainPassCB(const GameTimer& gt);
     void UpdateShadowPassCB(const GameTimer& gt);
+    void UpdateVisibleRenderItems(const GameTimer& gt);
+    void UpdateRenderQueues(const GameTimer& gt);
 
     void LoadTextures();
     void LoadGeometry();
@@ -96,7 +104,10 @@ private:
     void AddRenderItem(RenderLayer layer, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& texTransform, Material* mat, MeshGeometry* geo, SubmeshGeometry& drawArgs);
     void BuildRenderItems();
 
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+    void AddToRenderQueue(RenderQueue& queue, RenderLayer layer, const RenderItem* ri, DirectX::FXMMATRIX view,
+        ID3D12PipelineState* pso, ID3D12PipelineState* instancedPso);
+    DirectX::GraphicsResource CopyInstanceData(const RenderQueue& queue);
+    RenderQueueStats DrawRenderQueue(ID3D12GraphicsCommandList* cmdList, const RenderQueue& queue, const DirectX::GraphicsResource& instanceData);
     void DrawSceneToShadowMap();
 
 private:
@@ -118,6 +129,24 @@ private:
     // Render items divided by PSO.
     std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+    // Hierarchy over the world space bounds of the opaque render items, and the ones
+    // it finds in the camera frustum and in the shadowed region each frame.
+    DynamicBvh mSceneTree;
+    std::vector<UINT> mQueryProxies;
+    std::vector<RenderItem*> mVisibleRitems;
+    std::vector<RenderItem*> mShadowCasterRitems;
+
+    // The draws of the main and shadow passes, sorted by state with the items sharing
+    // geometry merged into instanced draws.  The instance data handles are held until
+    // the frame's work is submitted.
+    RenderQueue mMainQueue;
+    RenderQueue mShadowQueue;
+    DirectX::GraphicsResource mMainInstanceData;
+    DirectX::GraphicsResource mShadowInstanceData;
+    RenderQueueStats mMainQueueStats;
+    RenderQueueStats mShadowQueueStats;
+    bool mDrawBatchingEnabled = true;
+
     uint32_t mRandomTexBindlessIndex = -1;
     uint32_t mSkyBindlessIndex = -1;
     uint32_t mShadowMapBindlessIndex = -1;
@@ -259,7 +259,7 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
     mCommandList->SetPipelineState(mDrawWireframe ? psoLib["opaque_wireframe"] : psoLib["opaque_wprepass"]);
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
-    mCommandList->SetPipelineState(mDrawWireframe ? psoLib["skinnedOpaque_wireframe"] : psoLib["skinnedOpaque_wprepass"]);
+    mCommandList->SetPipelineState(mDrawWireframe ? SkinnedPso("skinnedOpaque_wireframe") : SkinnedPso("skinnedOpaque_wprepass"));
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::SkinnedOpaque]);
 
     mCommandList->SetPipelineState(psoLib["debug"]);
@@ -313,6 +313,19 @@ void SkinnedMeshApp::UpdateImgui(const GameTimer& gt)
     ImGui::Checkbox("NormalMaps", &mNormalMapsEnabled);
     ImGui::Checkbox("Reflections", &mReflectionsEnabled);
     ImGui::Checkbox("Shadows", &mShadowsEnabled);
+    ImGui::Checkbox("PackedVertices", &mPackedVertices);
+
+    if(ImGui::CollapsingHeader("PackedVertices"))
+    {
+        ImGui::Text("Vertices: %u", mPackedVertexReport.VertexCount);
+        ImGui::Text("Vertex bytes: %llu float, %llu packed", mPackedVertexReport.SourceBytes, mPackedVertexReport.PackedBytes);
+        ImGui::Text("Index bytes: %llu", mPackedVertexReport.IndexBytes);
+        ImGui::Text("Packed size: %.1f%%", 100.0f * mPackedVertexReport.Ratio());
+        ImGui::Text("Max position error: %g", mPackedVertexError.MaxPosition);
+        ImGui::Text("Max normal/tangent error: %.3f/%.3f deg", mPackedVertexError.MaxNormalAngle, mPackedVertexError.MaxTangentAngle);
+        ImGui::Text("Max texcoord error: %g", mPackedVertexError.MaxTexC);
+        ImGui::Text("Max bone weight error: %.4f", mPackedVertexError.MaxBoneWeight);
+    }
 
     if(ImGui::CollapsingHeader("SSAO"))
     {
@@ -439,6 +452,9 @@ void SkinnedMeshApp::UpdatePerObjectCB(const GameTimer& gt)
         ri->ObjectConstants.gMaterialIndex = ri->Mat->MatIndex;
         ri->ObjectConstants.gCubeMapIndex = mSkyBindlessIndex;
 
+        if(ri->PackedGeo != nullptr)
+            VertexCompression::WriteDequantConstants(ri->Bounds, ri->ObjectConstants);
+
         // Need to hold handle until we submit work to GPU.
         ri->MemHandleToObjectCB = mLinearAllocator->AllocateConstant(ri->ObjectConstants);
     }
@@ -747,6 +763,7 @@ bool SkinnedMeshApp::LoadSkinnedModel()
     mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
     mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
     mSkinnedModelInst->ClipName = "Take1";
+    mSkinnedModelInst->Clip = mSkinnedInfo.FindClip(mSkinnedModelInst->ClipName);
     mSkinnedModelInst->TimePos = 0.0f;
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(M3DLoader::SkinnedVertex);
@@ -774,21 +791,60 @@ bool SkinnedMeshApp::LoadSkinnedModel()
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
 
+    //
+    // A packed copy for the "_packed" PSOs.  Each subset owns its range of vertices, so
+    // those are quantized within the bounds of the subset.  The index buffer is shared.
+    //
+
+    std::vector<PackedSkinnedVertex> packedVertices(vertices.size());
+    mPackedVertexError = VertexCompressionError();
+
     for(UINT i = 0; i < (UINT)mSkinnedSubsets.size(); ++i)
     {
+        const M3DLoader::Subset& subset = mSkinnedSubsets[i];
+
         SubmeshGeometry submesh;
         std::string name = "sm_" + std::to_string(i);
 
-        submesh.IndexCount = (UINT)mSkinnedSubsets[i].FaceCount * 3;
-        submesh.StartIndexLocation = mSkinnedSubsets[i].FaceStart * 3;
+        submesh.IndexCount = (UINT)subset.FaceCount * 3;
+        submesh.StartIndexLocation = subset.FaceStart * 3;
         submesh.BaseVertexLocation = 0;
         submesh.VertexCount = (UINT)vertices.size();
-        //submesh.Bounds = bounds;
+        submesh.Bounds = VertexCompression::ComputeBounds(
+            &vertices[subset.VertexStart], subset.VertexCount, sizeof(M3DLoader::SkinnedVertex));
+
+        const VertexQuantization quantization = VertexCompression::QuantizationFromBounds(submesh.Bounds);
+        VertexCompression::Encode(&vertices[subset.VertexStart], subset.VertexCount, quantization, &packedVertices[subset.VertexStart]);
+        VertexCompression::Accumulate(mPackedVertexError, VertexCompression::Validate(
+            &vertices[subset.VertexStart], &packedVertices[subset.VertexStart], subset.VertexCount, quantization));
 
         geo->DrawArgs[name] = submesh;
     }
 
+    const UINT packedVbByteSize = (UINT)packedVertices.size() * sizeof(PackedSkinnedVertex);
+
+    auto packedGeo = std::make_unique<MeshGeometry>();
+    packedGeo->Name = mSkinnedModelFilename + "_packed";
+
+    packedGeo->VertexBufferCPU.resize(packedVbByteSize);
+    CopyMemory(packedGeo->VertexBufferCPU.data(), packedVertices.data(), packedVbByteSize);
+
+    CreateStaticBuffer(md3dDevice.Get(), *mUploadBatch.get(),
+                       packedVertices.data(), packedVertices.size(), sizeof(PackedSkinnedVertex),
+                       D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, &packedGeo->VertexBufferGPU);
+
+    packedGeo->IndexBufferGPU = geo->IndexBufferGPU;
+    packedGeo->VertexByteStride = sizeof(PackedSkinnedVertex);
+    packedGeo->VertexBufferByteSize = packedVbByteSize;
+    packedGeo->IndexFormat = geo->IndexFormat;
+    packedGeo->IndexBufferByteSize = geo->IndexBufferByteSize;
+    packedGeo->DrawArgs = geo->DrawArgs;
+
+    mPackedVertexReport = VertexCompression::ReportBytes(
+        (UINT)vertices.size(), sizeof(M3DLoader::SkinnedVertex), sizeof(PackedSkinnedVertex), ibByteSize);
+
     mGeometries[geo->Name] = std::move(geo);
+    mGeometries[packedGeo->Name] = std::move(packedGeo);
 
     return true;
 }
@@ -1035,6 +1091,8 @@ void SkinnedMeshApp::BuildRenderItems()
         ritem->IndexCount = ritem->Geo->DrawArgs[submeshName].IndexCount;
         ritem->StartIndexLocation = ritem->Geo->DrawArgs[submeshName].StartIndexLocation;
         ritem->BaseVertexLocation = ritem->Geo->DrawArgs[submeshName].BaseVertexLocation;
+        ritem->PackedGeo = mGeometries[mSkinnedModelFilename + "_packed"].get();
+        ritem->Bounds = ritem->PackedGeo->DrawArgs[submeshName].Bounds;
 
         // All render items for this solider.m3d instance share
         // the same skinned model instance.
@@ -1057,9 +1115,10 @@ void SkinnedMeshApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const s
     for(size_t i = 0; i < ritems.size(); ++i)
     {
         auto ri = ritems[i];
+        MeshGeometry* geo = (mPackedVertices && ri->PackedGeo != nullptr) ? ri->PackedGeo : ri->Geo;
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+        cmdList->IASetVertexBuffers(0, 1, &geo->VertexBufferView());
+        cmdList->IASetIndexBuffer(&geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		cmdList->SetGraphicsRootConstantBufferView(GFX_ROOT_ARG_OBJECT_CBV, ri->MemHandleToObjectCB.GpuAddress());
@@ -1077,6 +1136,11 @@ void SkinnedMeshApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const s
     }
 }
 
+ID3D12PipelineState* SkinnedMeshApp::SkinnedPso(const std::string& name)
+{
+    return PsoLib::GetLib()[mPackedVertices ? name + "_packed" : name];
+}
+
 void SkinnedMeshApp::DrawSceneToShadowMap()
 {
     PsoLib& psoLib = PsoLib::GetLib();
@@ -1107,7 +1171,7 @@ void SkinnedMeshApp::DrawSceneToShadowMap()
     mCommandList->SetPipelineState(psoLib["shadow_opaque"]);
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
-    mCommandList->SetPipelineState(psoLib["skinnedShadow_opaque"]);
+    mCommandList->SetPipelineState(SkinnedPso("skinnedShadow_opaque"));
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::SkinnedOpaque]);
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
@@ -1144,7 +1208,7 @@ void SkinnedMeshApp::DrawNormalsAndDepth()
     mCommandList->SetPipelineState(psoLib["drawViewNormals"]);
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
-    mCommandList->SetPipelineState(psoLib["drawSkinnedViewNormals"]);
+    mCommandList->SetPipelineState(SkinnedPso("drawSkinnedViewNormals"));
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::SkinnedOpaque]);
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
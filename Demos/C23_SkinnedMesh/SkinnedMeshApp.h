@@ -12,6 +12,7 @@
 #include "../../Common/PsoLib.h"
 #include "../../Common/SkinnedData.h"
 #include "../../Common/LoadM3d.h"
+#include "../../Common/VertexCompression.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "Ssao.h"
@@ -22,6 +23,8 @@ struct SkinnedModelInstance
     SkinnedData* SkinnedInfo = nullptr;
     std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
     std::string ClipName;
+    AnimationClipHandle Clip = InvalidAnimationClip;
+    AnimationCursor Cursor;
     float TimePos = 0.0f;
 
     DirectX::GraphicsResource MemHandleToSkinnedCB;
@@ -35,11 +38,11 @@ struct SkinnedModelInstance
         TimePos += dt;
 
         // Loop animation
-        if(TimePos > SkinnedInfo->GetClipEndTime(ClipName))
+        if(TimePos > SkinnedInfo->GetClipEndTime(Clip))
             TimePos = 0.0f;
 
         // Compute the final transforms for this time position.
-        SkinnedInfo->GetFinalTransforms(ClipName, TimePos, FinalTransforms);
+        SkinnedInfo->GetFinalTransforms(Clip, TimePos, &Cursor, FinalTransforms.data());
     }
 };
 
@@ -68,6 +71,11 @@ struct RenderItem
     Material* Mat = nullptr;
     MeshGeometry* Geo = nullptr;
 
+    // Geo in the VertexCompression layout, drawn instead of Geo when packed vertices are
+    // enabled; nullptr if there is none.  Its positions are quantized within Bounds.
+    MeshGeometry* PackedGeo = nullptr;
+    DirectX::BoundingBox Bounds;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -133,6 +141,9 @@ private:
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
     void DrawSceneToShadowMap();
     void DrawNormalsAndDepth();
+
+    // The PSO with the given name, or its "_packed" variant when packed vertices are enabled.
+    ID3D12PipelineState* SkinnedPso(const std::string& name);
 private:
 
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -192,6 +203,10 @@ private:
     std::vector<M3DLoader::M3dMaterial> mSkinnedMats;
     std::vector<std::string> mSkinnedTextureNames;
 
+    // Byte counts and round trip error of the packed copy of the skinned model.
+    VertexByteReport mPackedVertexReport;
+    VertexCompressionError mPackedVertexError;
+
 
     float mOcclusionRadius = 0.5f;
     float mOcclusionFadeStart = 0.2f;
@@ -203,6 +218,7 @@ private:
     bool mReflectionsEnabled = true;
     bool mShadowsEnabled = true;
     bool mSsaoEnabled = true;
+    bool mPackedVertices = false;
 
     POINT mLastMousePos;
 };
\ No newline at end of file
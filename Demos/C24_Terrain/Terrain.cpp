@@ -20,7 +20,28 @@ Terrain::Terrain(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadBatch
 	mNumPatchVertices  = mNumPatchVertRows*mNumPatchVertCols;
 	mNumPatchQuadFaces = (mNumPatchVertRows-1)*(mNumPatchVertCols-1);
 
-	LoadHeightmapRaw16();
+	if(mInfo.StreamingTileCapacity > 0 && OpenHeightmapTiles())
+	{
+		mPageCache = std::make_unique<HeightmapPageCache>(
+			*mTiledHeightmap, mInfo.StreamingTileCapacity, mInfo.HeightScale, mInfo.HeightOffset);
+	}
+	else
+	{
+		LoadHeightmapRaw16();
+		if(mInfo.QuantizedHeights)
+		{
+			// The pyramid needs heights; build it from a temporary float copy.
+			std::vector<float> heights(mHeightmap16.size());
+			for(size_t i = 0; i < heights.size(); ++i)
+				heights[i] = SampleToHeight(mHeightmap16[i]);
+			mHeightPyramid.Build(heights.data(), mInfo.HeightmapWidth, mInfo.HeightmapHeight);
+		}
+		else
+		{
+			mHeightPyramid.Build(mHeightmap.data(), mInfo.HeightmapWidth, mInfo.HeightmapHeight);
+		}
+	}
+
 	CalcAllPatchBoundsY();
 
 	BuildQuadPatchVB(uploadBatch);
@@ -37,7 +58,7 @@ void Terrain::BuildDescriptors()
 	CbvSrvUavHeap& heap = CbvSrvUavHeap::Get();
 	mHeightMapSrvIndex = heap.NextFreeIndex();
 
-	CreateSrv2d(md3dDevice, mHeightMapTexture.Get(), DXGI_FORMAT_R32_FLOAT, 1, heap.CpuHandle(mHeightMapSrvIndex));
+	CreateSrv2d(md3dDevice, mHeightMapTexture.Get(), GetHeightMapFormat(), 1, heap.CpuHandle(mHeightMapSrvIndex));
 }
 
 void Terrain::SetMaterialLayers(std::initializer_list<Material*> layers, UINT blendMap0SrvIndex, UINT blendMap1SrvIndex)
@@ -87,42 +108,240 @@ float Terrain::GetDepth()const
 }
 
 float Terrain::GetHeight(float x, float z)const
+{
+	if(mPageCache)
+		return GetStreamedHeight(x, z, nullptr);
+
+	return GetSampler().GetHeight(x, z);
+}
+
+void Terrain::GetHeights(const float* x, const float* z, UINT count, float* heights,
+						 XMFLOAT3* normals, TaskPool* pool)const
+{
+	if(mPageCache)
+	{
+		// Tiles come and go, so streamed lookups stay one at a time.
+		for(UINT i = 0; i < count; ++i)
+			heights[i] = GetStreamedHeight(x[i], z[i], normals ? &normals[i] : nullptr);
+		return;
+	}
+
+	GetSampler().GetHeights(x, z, count, heights, normals, pool);
+}
+
+HeightmapSampler::Grid Terrain::GetSamplerGrid()const
+{
+	HeightmapSampler::Grid grid;
+	grid.Width = mInfo.HeightmapWidth;
+	grid.Height = mInfo.HeightmapHeight;
+	grid.CellSpacing = mInfo.CellSpacing;
+	grid.OriginX = -0.5f*GetWidth();
+	grid.OriginZ = 0.5f*GetDepth();
+	return grid;
+}
+
+HeightmapSampler Terrain::GetSampler()const
+{
+	if(mInfo.QuantizedHeights)
+		return HeightmapSampler(mHeightmap16.data(), mInfo.HeightScale, mInfo.HeightOffset, GetSamplerGrid());
+
+	return HeightmapSampler(mHeightmap.data(), GetSamplerGrid());
+}
+
+float Terrain::GetStreamedHeight(float x, float z, XMFLOAT3* normal)const
 {
 	// Transform from terrain local space to "cell" space.
-	float c = (x + 0.5f*GetWidth()) /  mInfo.CellSpacing;
-	float d = (z - 0.5f*GetDepth()) / -mInfo.CellSpacing;
-
-	// Get the row and column we are in.
-	int row = (int)floorf(d);
-	int col = (int)floorf(c);
-
-	// Grab the heights of the cell we are in.
-	// A*--*B
-	//  | /|
-	//  |/ |
-	// C*--*D
-	float A = mHeightmap[row*mInfo.HeightmapWidth + col];
-	float B = mHeightmap[row*mInfo.HeightmapWidth + col + 1];
-	float C = mHeightmap[(row+1)*mInfo.HeightmapWidth + col];
-	float D = mHeightmap[(row+1)*mInfo.HeightmapWidth + col + 1];
-
-	// Where we are relative to the cell.
-	float s = c - (float)col;
-	float t = d - (float)row;
-
-	// If upper triangle ABC.
-	if( s + t <= 1.0f)
+	const HeightmapSampler::Grid grid = GetSamplerGrid();
+	float c = MathHelper::Clamp((x - grid.OriginX) / grid.CellSpacing, 0.0f, (float)(grid.Width - 2));
+	float d = MathHelper::Clamp((grid.OriginZ - z) / grid.CellSpacing, 0.0f, (float)(grid.Height - 2));
+
+	// Tiles share their edge samples, so the cell's tile has all four corners.  Until
+	// it is resident, the middle of the tile's height range has to do.
+	const UINT tile = GetTileOfCell((UINT)d, (UINT)c);
+	const uint16_t* samples = mPageCache->FindTile(tile);
+	if(samples == nullptr)
+	{
+		if(normal != nullptr)
+			*normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+		XMFLOAT2 range = GetTileRangeY(tile);
+		return 0.5f*(range.x + range.y);
+	}
+
+	UINT x0, z0, x1, z1;
+	mTiledHeightmap->GetTileRect(tile, x0, z0, x1, z1);
+
+	HeightmapSampler::Grid tileGrid = grid;
+	tileGrid.Width = mTiledHeightmap->GetTileSamples();
+	tileGrid.Height = mTiledHeightmap->GetTileSamples();
+	tileGrid.OriginX += x0*grid.CellSpacing;
+	tileGrid.OriginZ -= z0*grid.CellSpacing;
+
+	HeightmapSampler sampler(samples, mInfo.HeightScale, mInfo.HeightOffset, tileGrid);
+	return sampler.GetHeight(x, z, normal);
+}
+
+XMFLOAT2 Terrain::GetHeightRange(float minX, float minZ, float maxX, float maxZ)const
+{
+	// Transform the rectangle to sample indices.  Rows go down as z goes up.
+	const float maxCol = (float)(mInfo.HeightmapWidth - 1);
+	const float maxRow = (float)(mInfo.HeightmapHeight - 1);
+
+	float c0 = MathHelper::Clamp(floorf((minX + 0.5f*GetWidth()) / mInfo.CellSpacing), 0.0f, maxCol);
+	float c1 = MathHelper::Clamp(ceilf((maxX + 0.5f*GetWidth()) / mInfo.CellSpacing), 0.0f, maxCol);
+	float r0 = MathHelper::Clamp(floorf((0.5f*GetDepth() - maxZ) / mInfo.CellSpacing), 0.0f, maxRow);
+	float r1 = MathHelper::Clamp(ceilf((0.5f*GetDepth() - minZ) / mInfo.CellSpacing), 0.0f, maxRow);
+
+	if(!mPageCache)
+		return mHeightPyramid.GetRangeY((UINT)c0, (UINT)r0, (UINT)c1, (UINT)r1);
+
+	// Streaming: union over the tiles the rectangle touches, from the pyramids of
+	// resident tiles and the tile directory otherwise.
+	const UINT tileCells = mTiledHeightmap->GetTileCells();
+	const UINT tx0 = std::min((UINT)c0 / tileCells, mTiledHeightmap->GetTilesX() - 1);
+	const UINT tx1 = std::min((UINT)c1 / tileCells, mTiledHeightmap->GetTilesX() - 1);
+	const UINT tz0 = std::min((UINT)r0 / tileCells, mTiledHeightmap->GetTilesZ() - 1);
+	const UINT tz1 = std::min((UINT)r1 / tileCells, mTiledHeightmap->GetTilesZ() - 1);
+
+	XMFLOAT2 range(+MathHelper::Infinity, -MathHelper::Infinity);
+	for(UINT tz = tz0; tz <= tz1; ++tz)
+	{
+		for(UINT tx = tx0; tx <= tx1; ++tx)
+		{
+			const UINT tile = tz*mTiledHeightmap->GetTilesX() + tx;
+
+			XMFLOAT2 tileRange;
+			if(const HeightPyramid* pyramid = mPageCache->FindTilePyramid(tile))
+			{
+				UINT x0, z0, x1, z1;
+				mTiledHeightmap->GetTileRect(tile, x0, z0, x1, z1);
+				tileRange = pyramid->GetRangeY(
+					std::max((UINT)c0, x0) - x0, std::max((UINT)r0, z0) - z0,
+					std::min((UINT)c1, x1) - x0, std::min((UINT)r1, z1) - z0);
+			}
+			else
+			{
+				tileRange = GetTileRangeY(tile);
+			}
+
+			range.x = std::min(range.x, tileRange.x);
+			range.y = std::max(range.y, tileRange.y);
+		}
+	}
+
+	return range;
+}
+
+bool Terrain::Intersects(FXMVECTOR origin, FXMVECTOR dir, float maxDist, float& dist)const
+{
+	// Transform to the heightmap grid the pyramid works in: x = column, z = row,
+	// y = height.  The map is affine, so dist means the same in both spaces.
+	const float invSpacing = 1.0f / mInfo.CellSpacing;
+
+	XMVECTOR gridOrigin = XMVectorSet(
+		(XMVectorGetX(origin) + 0.5f*GetWidth()) * invSpacing,
+		XMVectorGetY(origin),
+		(0.5f*GetDepth() - XMVectorGetZ(origin)) * invSpacing,
+		0.0f);
+
+	XMVECTOR gridDir = XMVectorSet(
+		XMVectorGetX(dir) * invSpacing,
+		XMVectorGetY(dir),
+		-XMVectorGetZ(dir) * invSpacing,
+		0.0f);
+
+	if(mPageCache)
+		return IntersectsResidentTiles(gridOrigin, gridDir, maxDist, dist);
+
+	const UINT width = mInfo.HeightmapWidth;
+	if(mInfo.QuantizedHeights)
 	{
-		float uy = B - A;
-		float vy = C - A;
-		return A + s*uy + t*vy;
+		auto sample = [&](int x, int z) { return SampleToHeight(mHeightmap16[z*width + x]); };
+		return mHeightPyramid.Raycast(gridOrigin, gridDir, maxDist, sample, dist);
 	}
-	else // lower triangle DCB.
+
+	auto sample = [&](int x, int z) { return mHeightmap[z*width + x]; };
+	return mHeightPyramid.Raycast(gridOrigin, gridDir, maxDist, sample, dist);
+}
+
+bool Terrain::IntersectsResidentTiles(FXMVECTOR gridOrigin, FXMVECTOR gridDir, float maxDist, float& dist)const
+{
+	// Tiles do not overlap, so visiting them in the order the ray enters their
+	// boxes makes the first hit the nearest one.  Tiles that are not resident are
+	// skipped.
+	struct TileSpan
+	{
+		float T0;
+		float T1;
+		UINT Tile;
+	};
+
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, gridOrigin);
+	XMStoreFloat3(&d, gridDir);
+	const float org[3] = { o.x, o.y, o.z };
+	const float dir[3] = { d.x, d.y, d.z };
+
+	std::vector<TileSpan> spans;
+	for(UINT tile = 0; tile < mTiledHeightmap->GetTileCount(); ++tile)
+	{
+		UINT x0, z0, x1, z1;
+		mTiledHeightmap->GetTileRect(tile, x0, z0, x1, z1);
+		XMFLOAT2 rangeY = GetTileRangeY(tile);
+
+		const float lo[3] = { (float)x0, rangeY.x, (float)z0 };
+		const float hi[3] = { (float)x1, rangeY.y, (float)z1 };
+
+		float t0 = 0.0f;
+		float t1 = maxDist;
+		for(int axis = 0; axis < 3 && t0 <= t1; ++axis)
+		{
+			if(dir[axis] == 0.0f)
+			{
+				if(org[axis] < lo[axis] || org[axis] > hi[axis])
+					t0 = MathHelper::Infinity;
+				continue;
+			}
+
+			float tNear = (lo[axis] - org[axis]) / dir[axis];
+			float tFar = (hi[axis] - org[axis]) / dir[axis];
+			if(tNear > tFar)
+				std::swap(tNear, tFar);
+			t0 = std::max(t0, tNear);
+			t1 = std::min(t1, tFar);
+		}
+
+		if(t0 <= t1)
+			spans.push_back({ t0, t1, tile });
+	}
+
+	std::sort(spans.begin(), spans.end(), [](const TileSpan& a, const TileSpan& b) { return a.T0 < b.T0; });
+
+	const UINT tileSamples = mTiledHeightmap->GetTileSamples();
+	for(const TileSpan& span : spans)
 	{
-		float uy = C - D;
-		float vy = B - D;
-		return D + (1.0f-s)*uy + (1.0f-t)*vy;
+		const HeightPyramid* pyramid = mPageCache->FindTilePyramid(span.Tile);
+		if(pyramid == nullptr)
+			continue;
+
+		const uint16_t* samples = mPageCache->FindTile(span.Tile);
+		auto sample = [&](int x, int z) { return SampleToHeight(samples[z*tileSamples + x]); };
+
+		// The tile's pyramid is in tile local coordinates.  Ending the ray where it
+		// leaves the tile keeps it out of the repeated samples past the map edge.
+		UINT x0, z0, x1, z1;
+		mTiledHeightmap->GetTileRect(span.Tile, x0, z0, x1, z1);
+		XMVECTOR localOrigin = XMVectorSubtract(gridOrigin, XMVectorSet((float)x0, 0.0f, (float)z0, 0.0f));
+
+		float t;
+		if(pyramid->Raycast(localOrigin, gridDir, span.T1, sample, t) && t >= span.T0 - 1e-4f)
+		{
+			dist = t;
+			return true;
+		}
 	}
+
+	return false;
 }
 
 XMFLOAT4X4 Terrain::GetWorld()const
@@ -135,6 +354,173 @@ void Terrain::SetWorld(const XMFLOAT4X4& W)
 	mWorld = W;
 }
 
+bool Terrain::IsStreaming()const
+{
+	return mPageCache != nullptr;
+}
+
+void Terrain::UpdateStreaming(ID3D12GraphicsCommandList* cmdList, const XMFLOAT3& eyePosW)
+{
+	if(!mPageCache)
+		return;
+
+	// Camera in heightmap grid space.
+	XMMATRIX world = XMLoadFloat4x4(&mWorld);
+	XMVECTOR eyeL = XMVector3TransformCoord(XMLoadFloat3(&eyePosW), XMMatrixInverse(nullptr, world));
+
+	const float invSpacing = 1.0f / mInfo.CellSpacing;
+	const float gridX = (XMVectorGetX(eyeL) + 0.5f*GetWidth()) * invSpacing;
+	const float gridZ = (0.5f*GetDepth() - XMVectorGetZ(eyeL)) * invSpacing;
+
+	const bool firstFrame = mPageCache->GetLoadCount() == 0;
+	mPageCache->RequestAround(gridX, gridZ, mInfo.StreamingRadius * invSpacing);
+
+	// Nothing to draw yet; wait for the tiles around the camera rather than show a
+	// flat world for the first frames.
+	if(firstFrame)
+		mPageCache->Flush();
+
+	const std::vector<UINT>& newTiles = mPageCache->Update();
+
+	// Tiles that could not be read stay missing from the terrain.
+	if(mPageCache->GetFailedLoadCount() != mReportedFailedLoads)
+	{
+		mReportedFailedLoads = mPageCache->GetFailedLoadCount();
+		std::string message = "Terrain: " + std::to_string(mReportedFailedLoads) + " heightmap tiles failed to load\n";
+		::OutputDebugStringA(message.c_str());
+	}
+
+	if(newTiles.empty())
+		return;
+
+	D3D12_RESOURCE_BARRIER toCopy[2] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mHeightMapTexture.Get(),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(mQuadPatchVB.Get(),
+			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST)
+	};
+	cmdList->ResourceBarrier(2, toCopy);
+
+	for(UINT tile : newTiles)
+	{
+		UploadTileHeights(cmdList, tile);
+		UploadTilePatchBounds(cmdList, tile);
+	}
+
+	D3D12_RESOURCE_BARRIER toRead[2] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mHeightMapTexture.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(mQuadPatchVB.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER)
+	};
+	cmdList->ResourceBarrier(2, toRead);
+}
+
+void Terrain::UploadTileHeights(ID3D12GraphicsCommandList* cmdList, UINT tile)
+{
+	UINT x0, z0, x1, z1;
+	mTiledHeightmap->GetTileRect(tile, x0, z0, x1, z1);
+
+	const UINT width = x1 - x0 + 1;
+	const UINT height = z1 - z0 + 1;
+	const UINT texelSize = mInfo.QuantizedHeights ? sizeof(uint16_t) : sizeof(float);
+	const UINT rowPitch = (width*texelSize + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+
+	// Released right away; GraphicsMemory keeps the memory until the GPU is done with it.
+	GraphicsMemory& linearAllocator = GraphicsMemory::Get(md3dDevice);
+	GraphicsResource upload = linearAllocator.Allocate(rowPitch*height, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	const uint16_t* samples = mPageCache->FindTile(tile);
+	const UINT tileSamples = mTiledHeightmap->GetTileSamples();
+	for(UINT z = 0; z < height; ++z)
+	{
+		BYTE* dst = static_cast<BYTE*>(upload.Memory()) + (size_t)z*rowPitch;
+		const uint16_t* src = samples + (size_t)z*tileSamples;
+		if(mInfo.QuantizedHeights)
+		{
+			memcpy(dst, src, width*sizeof(uint16_t));
+			continue;
+		}
+
+		for(UINT x = 0; x < width; ++x)
+			reinterpret_cast<float*>(dst)[x] = SampleToHeight(src[x]);
+	}
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+	footprint.Offset = upload.ResourceOffset();
+	footprint.Footprint = CD3DX12_SUBRESOURCE_FOOTPRINT(GetHeightMapFormat(), width, height, 1, rowPitch);
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(mHeightMapTexture.Get(), 0);
+	CD3DX12_TEXTURE_COPY_LOCATION src(upload.Resource(), footprint);
+	cmdList->CopyTextureRegion(&dst, x0, z0, 0, &src, nullptr);
+}
+
+void Terrain::UploadTilePatchBounds(ID3D12GraphicsCommandList* cmdList, UINT tile)
+{
+	UINT x0, z0, x1, z1;
+	mTiledHeightmap->GetTileRect(tile, x0, z0, x1, z1);
+
+	// Patches of the tile, whose upper-left vertices carry their bounds.
+	const UINT i0 = z0 / CellsPerPatch;
+	const UINT j0 = x0 / CellsPerPatch;
+	const UINT i1 = z1 / CellsPerPatch;
+	const UINT j1 = x1 / CellsPerPatch;
+	const UINT numCols = j1 - j0;
+
+	const HeightPyramid* pyramid = mPageCache->FindTilePyramid(tile);
+
+	const UINT rowBytes = numCols*sizeof(XMFLOAT4);
+	GraphicsMemory& linearAllocator = GraphicsMemory::Get(md3dDevice);
+	GraphicsResource upload = linearAllocator.Allocate(rowBytes*(i1 - i0));
+
+	XMFLOAT4* vertices = static_cast<XMFLOAT4*>(upload.Memory());
+	for(UINT i = i0; i < i1; ++i)
+	{
+		for(UINT j = j0; j < j1; ++j)
+		{
+			// Patches are whole pyramid blocks, so the tile's pyramid is exact.
+			UINT patchID = i*(mNumPatchVertCols-1)+j;
+			mPatchBoundsY[patchID] = pyramid->GetRangeY(
+				j*CellsPerPatch - x0, i*CellsPerPatch - z0, (j+1)*CellsPerPatch - x0, (i+1)*CellsPerPatch - z0);
+
+			*vertices++ = GetPatchVertex(i, j);
+		}
+
+		const UINT64 dstOffset = ((UINT64)i*mNumPatchVertCols + j0)*sizeof(XMFLOAT4);
+		const UINT64 srcOffset = upload.ResourceOffset() + (UINT64)(i - i0)*rowBytes;
+		cmdList->CopyBufferRegion(mQuadPatchVB.Get(), dstOffset, upload.Resource(), srcOffset, rowBytes);
+	}
+}
+
+float Terrain::SampleToHeight(uint16_t sample)const
+{
+	constexpr float MaxUShort = static_cast<float>(std::numeric_limits<uint16_t>::max());
+	return mInfo.HeightScale * (sample / MaxUShort) + mInfo.HeightOffset;
+}
+
+DXGI_FORMAT Terrain::GetHeightMapFormat()const
+{
+	return mInfo.QuantizedHeights ? DXGI_FORMAT_R16_UNORM : DXGI_FORMAT_R32_FLOAT;
+}
+
+UINT Terrain::GetTileOfCell(UINT row, UINT col)const
+{
+	const UINT tileCells = mTiledHeightmap->GetTileCells();
+	const UINT tx = std::min(col / tileCells, mTiledHeightmap->GetTilesX() - 1);
+	const UINT tz = std::min(row / tileCells, mTiledHeightmap->GetTilesZ() - 1);
+	return tz*mTiledHeightmap->GetTilesX() + tx;
+}
+
+XMFLOAT2 Terrain::GetTileRangeY(UINT tile)const
+{
+	const TiledHeightmapFile::TileDesc& desc = mTiledHeightmap->GetTileDesc(tile);
+	float a = SampleToHeight(desc.MinSample);
+	float b = SampleToHeight(desc.MaxSample);
+	return XMFLOAT2(std::min(a, b), std::max(a, b));
+}
+
 void Terrain::Draw(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* drawTerrainPso)
 {
 	cmdList->SetPipelineState(drawTerrainPso);
@@ -186,6 +572,10 @@ void Terrain::Draw(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* draw
 	drawCB.gHeightMapSrvIndex = mHeightMapSrvIndex;
 	drawCB.gNumTerrainLayers = mInfo.NumLayers;
 
+	// An R16_UNORM heightmap samples to [0, 1]; the shaders turn that into heights.
+	drawCB.gTerrainHeightScale = mInfo.QuantizedHeights ? mInfo.HeightScale : 1.0f;
+	drawCB.gTerrainHeightOffset = mInfo.QuantizedHeights ? mInfo.HeightOffset : 0.0f;
+
 	drawCB.gUseTerrainHeightMap = mUseTerrainHeightMap ? 1 : 0;
 	drawCB.gUseMaterialHeightMaps = mUseMaterialHeightMaps ? 1 : 0;
 
@@ -215,6 +605,13 @@ void Terrain::LoadHeightmapRaw16()
 		inFile.close();
 	}
 
+	// Quantized: the samples are the heightmap.
+	if(mInfo.QuantizedHeights)
+	{
+		mHeightmap16 = std::move(in);
+		return;
+	}
+
 	constexpr float MaxUShort = static_cast<float>(std::numeric_limits<uint16_t>::max());
 
 	// Copy the array data into a float array and scale it.
@@ -226,6 +623,38 @@ void Terrain::LoadHeightmapRaw16()
 	}
 }
 
+bool Terrain::OpenHeightmapTiles()
+{
+	// (Re)build the tiled file when it is missing or older than the RAW file.
+	std::error_code ec;
+	const std::wstring tiledFilename = TiledHeightmapFile::TiledFilename(mInfo.HeightMapFilename);
+	const bool upToDate = std::filesystem::exists(tiledFilename, ec) &&
+		(!std::filesystem::exists(mInfo.HeightMapFilename, ec) ||
+		 std::filesystem::last_write_time(tiledFilename, ec) >= std::filesystem::last_write_time(mInfo.HeightMapFilename, ec));
+
+	auto matches = [this]()
+	{
+		return mTiledHeightmap->GetWidth() == mInfo.HeightmapWidth &&
+			   mTiledHeightmap->GetHeight() == mInfo.HeightmapHeight &&
+			   mTiledHeightmap->GetTileCells() == StreamingTileCells;
+	};
+
+	mTiledHeightmap = std::make_unique<TiledHeightmap>();
+	if(upToDate && mTiledHeightmap->Open(tiledFilename) && matches())
+		return true;
+
+	if(TiledHeightmapFile::ConvertRaw16(mInfo.HeightMapFilename, mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+										StreamingTileCells, tiledFilename) &&
+	   mTiledHeightmap->Open(tiledFilename) && matches())
+	{
+		return true;
+	}
+
+	// Fall back to loading the RAW file whole.
+	mTiledHeightmap = nullptr;
+	return false;
+}
+
 void Terrain::CalcAllPatchBoundsY()
 {
 	mPatchBoundsY.resize(mNumPatchQuadFaces);
@@ -242,7 +671,8 @@ void Terrain::CalcAllPatchBoundsY()
 
 void Terrain::CalcPatchBoundsY(UINT i, UINT j)
 {
-	// Scan the heightmap values this patch covers and compute the min/max height.
+	// Min/max height of the heightmap values this patch covers.  Patches are whole
+	// pyramid blocks, so this reads a handful of nodes instead of every sample.
 
 	UINT x0 = j*CellsPerPatch;
 	UINT x1 = (j+1)*CellsPerPatch;
@@ -250,54 +680,54 @@ void Terrain::CalcPatchBoundsY(UINT i, UINT j)
 	UINT y0 = i*CellsPerPatch;
 	UINT y1 = (i+1)*CellsPerPatch;
 
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for(UINT y = y0; y <= y1; ++y)
+	UINT patchID = i*(mNumPatchVertCols-1)+j;
+	if(mPageCache)
 	{
-		for(UINT x = x0; x <= x1; ++x)
-		{
-			UINT k = y*mInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, mHeightmap[k]);
-			maxY = MathHelper::Max(maxY, mHeightmap[k]);
-		}
+		// Until its tile is resident, a patch gets the range of the whole tile.
+		// UploadTilePatchBounds tightens it.
+		mPatchBoundsY[patchID] = GetTileRangeY(GetTileOfCell(y0, x0));
+		return;
 	}
 
-	UINT patchID = i*(mNumPatchVertCols-1)+j;
-	mPatchBoundsY[patchID] = XMFLOAT2(minY, maxY);
+	mPatchBoundsY[patchID] = mHeightPyramid.GetRangeY(x0, y0, x1, y1);
 }
 
-void Terrain::BuildQuadPatchVB(DirectX::ResourceUploadBatch& uploadBatch)
+XMFLOAT4 Terrain::GetPatchVertex(UINT i, UINT j)const
 {
-	std::vector<XMFLOAT4> patchVertices(mNumPatchVertRows*mNumPatchVertCols);
-
 	float halfWidth = 0.5f*GetWidth();
 	float halfDepth = 0.5f*GetDepth();
 
 	float patchWidth = GetWidth() / (mNumPatchVertCols-1);
 	float patchDepth = GetDepth() / (mNumPatchVertRows-1);
 
-	for(UINT i = 0; i < mNumPatchVertRows; ++i)
+	float z = halfDepth - i*patchDepth;
+	float x = -halfWidth + j*patchWidth;
+
+	// xy: Patch 2d point position in xz-plane.
+	XMFLOAT4 v(x, z, 0.0f, 0.0f);
+
+	// Store axis-aligned bounding box y-bounds in upper-left patch corner.
+	if(i < mNumPatchVertRows-1 && j < mNumPatchVertCols-1)
 	{
-		float z = halfDepth - i*patchDepth;
-		for(UINT j = 0; j < mNumPatchVertCols; ++j)
-		{
-			float x = -halfWidth + j*patchWidth;
+		UINT patchID = i*(mNumPatchVertCols-1)+j;
 
-			// xy: Patch 2d point position in xz-plane.
-			patchVertices[i*mNumPatchVertCols+j] = XMFLOAT4(x, z, 0.0f, 0.0f);
-		}
+		// zw: Patch axis y-bounds.
+		v.z = mPatchBoundsY[patchID].x;
+		v.w = mPatchBoundsY[patchID].y;
 	}
 
-	// Store axis-aligned bounding box y-bounds in upper-left patch corner.
-	for(UINT i = 0; i < mNumPatchVertRows-1; ++i)
+	return v;
+}
+
+void Terrain::BuildQuadPatchVB(DirectX::ResourceUploadBatch& uploadBatch)
+{
+	std::vector<XMFLOAT4> patchVertices(mNumPatchVertRows*mNumPatchVertCols);
+
+	for(UINT i = 0; i < mNumPatchVertRows; ++i)
 	{
-		for(UINT j = 0; j < mNumPatchVertCols-1; ++j)
+		for(UINT j = 0; j < mNumPatchVertCols; ++j)
 		{
-			UINT patchID = i*(mNumPatchVertCols-1)+j;
-
-			// zw: Patch axis y-bounds.
-			patchVertices[i*mNumPatchVertCols+j].z = mPatchBoundsY[patchID].x;
-			patchVertices[i*mNumPatchVertCols+j].w = mPatchBoundsY[patchID].y;
+			patchVertices[i*mNumPatchVertCols+j] = GetPatchVertex(i, j);
 		}
 	}
 
@@ -337,15 +767,40 @@ void Terrain::BuildQuadPatchIB(DirectX::ResourceUploadBatch& uploadBatch)
 
 void Terrain::BuildHeightMapTexture(DirectX::ResourceUploadBatch& uploadBatch)
 {
+	if(mPageCache)
+	{
+		// Filled in tile by tile as tiles become resident; see UpdateStreaming.
+		auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		auto texDesc = CD3DX12_RESOURCE_DESC::Tex2D(GetHeightMapFormat(),
+			mInfo.HeightmapWidth, mInfo.HeightmapHeight, 1, 1);
+
+		ThrowIfFailed(md3dDevice->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&texDesc,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+			nullptr,
+			IID_PPV_ARGS(&mHeightMapTexture)));
+		return;
+	}
+
 	D3D12_SUBRESOURCE_DATA subResourceData = {};
-	subResourceData.pData = mHeightmap.data();
-	subResourceData.RowPitch = mInfo.HeightmapWidth*sizeof(float);
+	if(mInfo.QuantizedHeights)
+	{
+		subResourceData.pData = mHeightmap16.data();
+		subResourceData.RowPitch = mInfo.HeightmapWidth*sizeof(uint16_t);
+	}
+	else
+	{
+		subResourceData.pData = mHeightmap.data();
+		subResourceData.RowPitch = mInfo.HeightmapWidth*sizeof(float);
+	}
 	subResourceData.SlicePitch = 0;
 
 	ThrowIfFailed(CreateTextureFromMemory(md3dDevice,
 				  uploadBatch,
 				  mInfo.HeightmapWidth, mInfo.HeightmapHeight,
-				  DXGI_FORMAT_R32_FLOAT,
+				  GetHeightMapFormat(),
 				  subResourceData,
 				  &mHeightMapTexture,
 				  false,
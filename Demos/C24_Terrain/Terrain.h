@@ -4,6 +4,9 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/GameTimer.h"
 #include "../../Common/DescriptorUtil.h"
+#include "../../Common/HeightPyramid.h"
+#include "../../Common/HeightmapSampler.h"
+#include "../../Common/TiledHeightmap.h"
 
 #include "../../Shaders/SharedTypes.h"
 
@@ -36,6 +39,19 @@ public:
 
 		// The number of material layers.
 		UINT NumLayers;
+
+		// Nonzero streams the heightmap instead of loading it whole: the RAW file is
+		// converted once to a .tiles file next to it, and at most this many tiles
+		// are kept in memory.  Zero loads the whole RAW file.
+		UINT StreamingTileCapacity;
+
+		// Tiles closer than this to the camera are streamed in by UpdateStreaming.
+		float StreamingRadius;
+
+		// Keep the heights as the RAW file's unorm16 samples instead of floats, on
+		// the CPU and in an R16_UNORM texture, for half the memory.  GetHeight and
+		// the shaders apply HeightScale and HeightOffset on the fly.
+		bool QuantizedHeights;
 	};
 
 public:
@@ -59,21 +75,64 @@ public:
 
 	float GetWidth()const;
 	float GetDepth()const;
+
+	// Height of the terrain surface at (x, z) in the terrain's local space.  Points
+	// off the terrain get the height of its nearest edge.
 	float GetHeight(float x, float z)const;
 
+	// heights[i] = GetHeight(x[i], z[i]), plus the unit surface normals if normals is
+	// not null.  Several points per call are much cheaper than as many GetHeight calls;
+	// see HeightmapSampler::GetHeights for how large batches use pool.
+	void GetHeights(const float* x, const float* z, UINT count, float* heights,
+					DirectX::XMFLOAT3* normals = nullptr, TaskPool* pool = nullptr)const;
+
+	// Lowest (x) and highest (y) terrain height over the rectangle [minX, maxX] x
+	// [minZ, maxZ], clamped to the terrain.  Conservative: it may be slightly wider
+	// than the exact range.
+	DirectX::XMFLOAT2 GetHeightRange(float minX, float minZ, float maxX, float maxZ)const;
+
+	// Finds the first point origin + dist*dir, dist in [0, maxDist], on the terrain
+	// surface.  dir does not have to be normalized, so a segment p0p1 is
+	// origin = p0, dir = p1 - p0, maxDist = 1.  Like GetHeight, this works in the
+	// terrain's local space.
+	bool Intersects(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDist, float& dist)const;
+
 	DirectX::XMFLOAT4X4 GetWorld()const;
 	void SetWorld(const DirectX::XMFLOAT4X4& W);
 
+	// Streaming only, a no-op otherwise.  Requests the tiles around the camera and
+	// records the copies that upload the tiles loaded since the last call: their
+	// heights into the heightmap texture and their exact patch bounds into the
+	// patch vertex buffer.  Call once per frame before Draw.
+	void UpdateStreaming(ID3D12GraphicsCommandList* cmdList, const DirectX::XMFLOAT3& eyePosW);
+
+	bool IsStreaming()const;
+
 	void Draw(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* drawTerrainPso);
 	
 private:
 	void LoadHeightmapRaw16();
+	HeightmapSampler::Grid GetSamplerGrid()const;
+	HeightmapSampler GetSampler()const;
+	bool OpenHeightmapTiles();
 	void CalcAllPatchBoundsY();
 	void CalcPatchBoundsY(UINT i, UINT j);
+	DirectX::XMFLOAT4 GetPatchVertex(UINT i, UINT j)const;
 	void BuildQuadPatchVB(DirectX::ResourceUploadBatch& uploadBatch);
 	void BuildQuadPatchIB(DirectX::ResourceUploadBatch& uploadBatch);
 	void BuildHeightMapTexture(DirectX::ResourceUploadBatch& uploadBatch);
 
+	// Streaming: heights of raw samples, the tile holding a cell, and the copies for
+	// a tile that just became resident.
+	float SampleToHeight(uint16_t sample)const;
+	DXGI_FORMAT GetHeightMapFormat()const;
+	UINT GetTileOfCell(UINT row, UINT col)const;
+	DirectX::XMFLOAT2 GetTileRangeY(UINT tile)const;
+	float GetStreamedHeight(float x, float z, DirectX::XMFLOAT3* normal)const;
+	void UploadTileHeights(ID3D12GraphicsCommandList* cmdList, UINT tile);
+	void UploadTilePatchBounds(ID3D12GraphicsCommandList* cmdList, UINT tile);
+	bool IntersectsResidentTiles(DirectX::FXMVECTOR gridOrigin, DirectX::FXMVECTOR gridDir, float maxDist, float& dist)const;
+
 private:
 
 	ID3D12Device* md3dDevice = nullptr;
@@ -83,6 +142,11 @@ private:
 	// Note: Can't make this too small without going to 32-bit indices.
 	static const int CellsPerPatch = 32;
 
+	// Cells per edge of a streamed tile.  A whole number of patches, so every patch
+	// lies in one tile.
+	static const UINT StreamingTileCells = 256;
+	static_assert(StreamingTileCells % CellsPerPatch == 0, "patches must not straddle tiles");
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> mQuadPatchVB = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mQuadPatchIB = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mHeightMapTexture = nullptr;
@@ -104,7 +168,18 @@ private:
 	DirectX::XMFLOAT4X4 mWorld = MathHelper::Identity4x4();
 
 	std::vector<DirectX::XMFLOAT2> mPatchBoundsY;
+	// Exactly one of these holds the heightmap, depending on mInfo.QuantizedHeights.
 	std::vector<float> mHeightmap;
+	std::vector<uint16_t> mHeightmap16;
+
+	// Min/max heights of the heightmap; patch bounds and spatial queries come from it.
+	HeightPyramid mHeightPyramid;
+
+	// Streaming replaces mHeightmap and mHeightPyramid with the resident tiles and
+	// their pyramids.
+	std::unique_ptr<TiledHeightmap> mTiledHeightmap;
+	std::unique_ptr<HeightmapPageCache> mPageCache;
+	UINT mReportedFailedLoads = 0;
 
 	std::vector<Material*> mLayerMaterials;
 
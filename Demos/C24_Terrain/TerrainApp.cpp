@@ -101,6 +101,15 @@ bool TerrainApp::Initialize()
     terrainInitInfo.CellSpacing = 0.125f;
     terrainInitInfo.NumLayers = 7;
 
+    // The RAW file only has 16 bits per sample; keeping them as floats buys nothing.
+    terrainInitInfo.QuantizedHeights = true;
+
+    // A nonzero tile capacity (e.g. 128 tiles of 32x32 units) streams the heightmap
+    // from a heightmap4097.tiles file converted on first run, instead of keeping it
+    // all in memory.
+    terrainInitInfo.StreamingTileCapacity = 0;
+    terrainInitInfo.StreamingRadius = 150.0f;
+
     mTerrain = std::make_unique<Terrain>(md3dDevice.Get(), *mUploadBatch.get(), terrainInitInfo);
 
     // Kick off upload work asyncronously.
@@ -252,6 +261,8 @@ void TerrainApp::Draw(const GameTimer& gt)
     auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
     mCommandList->SetGraphicsRootShaderResourceView(GFX_ROOT_ARG_MATERIAL_SRV, matBuffer->GetGPUVirtualAddress());
 
+    mTerrain->UpdateStreaming(mCommandList.Get(), mCamera.GetPosition3f());
+
     DrawSceneToShadowMap();
 
     // TODO: Should execute command list here per pass?
@@ -341,6 +352,7 @@ void TerrainApp::UpdateImgui(const GameTimer& gt)
 
     ImGui::Checkbox("Wireframe", &mIsWireframe);
     ImGui::Checkbox("Use TerrainHeightMap", &mUseTerrainHeightMap);
+    ImGui::Checkbox("Keep camera above terrain", &mCameraAboveTerrain);
     ImGui::Checkbox("Use MaterialHeightMaps", &mUseMaterialHeightMaps);
 
     ImGui::SliderFloat("Min Tess Distance", &mMinTessDistance, 0.0f, 200.0f);
@@ -470,8 +482,49 @@ void TerrainApp::OnKeyboardInput(const GameTimer& gt)
 	if(GetAsyncKeyState('D') & 0x8000)
 		mCamera.Strafe(cameraSpeed*dt);
 
+	if(mCameraAboveTerrain && mUseTerrainHeightMap)
+		ClampCameraAboveTerrain();
+
 	mCamera.UpdateViewMatrix();
 }
+
+void TerrainApp::ClampCameraAboveTerrain()
+{
+	// The eye plus a ring around it, so the near plane does not clip into a slope
+	// the eye itself is still above.  One batched lookup for all of them.
+	const float ringRadius = 1.5f;
+	const float clearance = 2.0f;
+	constexpr UINT NumSamples = 9;
+
+	XMFLOAT4X4 terrainWorld = mTerrain->GetWorld();
+	XMMATRIX world = XMLoadFloat4x4(&terrainWorld);
+	XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+	XMFLOAT3 eyeL;
+	XMStoreFloat3(&eyeL, XMVector3TransformCoord(mCamera.GetPosition(), invWorld));
+
+	float x[NumSamples];
+	float z[NumSamples];
+	float heights[NumSamples];
+	x[0] = eyeL.x;
+	z[0] = eyeL.z;
+	for(UINT i = 1; i < NumSamples; ++i)
+	{
+		float angle = XM_2PI*(i - 1) / (NumSamples - 1);
+		x[i] = eyeL.x + ringRadius*cosf(angle);
+		z[i] = eyeL.z + ringRadius*sinf(angle);
+	}
+
+	mTerrain->GetHeights(x, z, NumSamples, heights);
+
+	float groundY = *std::max_element(heights, heights + NumSamples);
+	if(eyeL.y < groundY + clearance)
+	{
+		eyeL.y = groundY + clearance;
+		XMFLOAT3 eyeW;
+		XMStoreFloat3(&eyeW, XMVector3TransformCoord(XMLoadFloat3(&eyeL), world));
+		mCamera.SetPosition(eyeW);
+	}
+}
  
 void TerrainApp::AnimateMaterials(const GameTimer& gt)
 {
@@ -77,6 +77,7 @@ private:
     virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
     void OnKeyboardInput(const GameTimer& gt);
+    void ClampCameraAboveTerrain();
     void AnimateMaterials(const GameTimer& gt);
     void UpdatePerObjectCB(const GameTimer& gt);
     void UpdateMaterialBuffer(const GameTimer& gt);
@@ -181,6 +182,7 @@ private:
     bool mShadowsEnabled = true;
     bool mUseTerrainHeightMap = true;
     bool mUseMaterialHeightMaps = true;
+    bool mCameraAboveTerrain = true;
 
     POINT mLastMousePos;
 };
\ No newline at end of file
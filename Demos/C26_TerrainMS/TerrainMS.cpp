@@ -35,6 +35,8 @@ TerrainMS::TerrainMS(ID3D12Device* device, DirectX::ResourceUploadBatch& uploadB
 	mNumPatchQuadFaces = (mNumPatchVertRows-1)*(mNumPatchVertCols-1);
 
 	LoadHeightmapRaw16();
+	mHeightPyramid.Build(mHeightmap.data(), mInfo.HeightmapWidth, mInfo.HeightmapHeight);
+
 	CalcAllQuadGroupBounds();
 	CalcAllQuadPatchBoundsY();
 	BuildQuadPatchVB(uploadBatch);
@@ -140,6 +142,44 @@ float TerrainMS::GetHeight(float x, float z)const
 	}
 }
 
+XMFLOAT2 TerrainMS::GetHeightRange(float minX, float minZ, float maxX, float maxZ)const
+{
+	// Transform the rectangle to sample indices.  Rows go down as z goes up.
+	const float maxCol = (float)(mInfo.HeightmapWidth - 1);
+	const float maxRow = (float)(mInfo.HeightmapHeight - 1);
+
+	float c0 = MathHelper::Clamp(floorf((minX + 0.5f*GetWidth()) / mInfo.CellSpacing), 0.0f, maxCol);
+	float c1 = MathHelper::Clamp(ceilf((maxX + 0.5f*GetWidth()) / mInfo.CellSpacing), 0.0f, maxCol);
+	float r0 = MathHelper::Clamp(floorf((0.5f*GetDepth() - maxZ) / mInfo.CellSpacing), 0.0f, maxRow);
+	float r1 = MathHelper::Clamp(ceilf((0.5f*GetDepth() - minZ) / mInfo.CellSpacing), 0.0f, maxRow);
+
+	return mHeightPyramid.GetRangeY((UINT)c0, (UINT)r0, (UINT)c1, (UINT)r1);
+}
+
+bool TerrainMS::Intersects(FXMVECTOR origin, FXMVECTOR dir, float maxDist, float& dist)const
+{
+	// Transform to the heightmap grid the pyramid works in: x = column, z = row,
+	// y = height.  The map is affine, so dist means the same in both spaces.
+	const float invSpacing = 1.0f / mInfo.CellSpacing;
+
+	XMVECTOR gridOrigin = XMVectorSet(
+		(XMVectorGetX(origin) + 0.5f*GetWidth()) * invSpacing,
+		XMVectorGetY(origin),
+		(0.5f*GetDepth() - XMVectorGetZ(origin)) * invSpacing,
+		0.0f);
+
+	XMVECTOR gridDir = XMVectorSet(
+		XMVectorGetX(dir) * invSpacing,
+		XMVectorGetY(dir),
+		-XMVectorGetZ(dir) * invSpacing,
+		0.0f);
+
+	const UINT width = mInfo.HeightmapWidth;
+	auto sample = [&](int x, int z) { return mHeightmap[z*width + x]; };
+
+	return mHeightPyramid.Raycast(gridOrigin, gridDir, maxDist, sample, dist);
+}
+
 Matrix TerrainMS::GetWorld()const
 {
 	return mWorld;
@@ -268,7 +308,7 @@ BoundingBox TerrainMS::CalcQuadGroupBounds(UINT groupX, UINT groupY)
 	float groupWidth = GetWidth() / mNumAmplificationGroupsX;
 	float groupDepth = GetDepth() / mNumAmplificationGroupsY;
 
-	// Scan the heightmap values this patch covers and compute the min/max height.
+	// Min/max height of the heightmap values this group covers, from the pyramid.
 
 	UINT x0 = groupX * mNumQuadsPerGroupX * CellsPerQuadPatch;
 	UINT x1 = (groupX+1) * mNumQuadsPerGroupX * CellsPerQuadPatch;
@@ -276,17 +316,9 @@ BoundingBox TerrainMS::CalcQuadGroupBounds(UINT groupX, UINT groupY)
 	UINT y0 = groupY * mNumQuadsPerGroupY * CellsPerQuadPatch;
 	UINT y1 = (groupY+1) * mNumQuadsPerGroupY * CellsPerQuadPatch;
 
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for(UINT y = y0; y <= y1; ++y)
-	{
-		for(UINT x = x0; x <= x1; ++x)
-		{
-			UINT k = y*mInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, mHeightmap[k]);
-			maxY = MathHelper::Max(maxY, mHeightmap[k]);
-		}
-	}
+	XMFLOAT2 rangeY = mHeightPyramid.GetRangeY(x0, y0, x1, y1);
+	float minY = rangeY.x;
+	float maxY = rangeY.y;
 
 	float groupCenterX = -halfWidth + groupX*groupWidth + 0.5f * groupWidth;
 	float groupCenterZ =  halfDepth - groupY*groupDepth - 0.5f * groupDepth;
@@ -317,26 +349,14 @@ void TerrainMS::CalcAllQuadPatchBoundsY()
 }
 void TerrainMS::CalcQuadPatchBoundsY(UINT i, UINT j)
 {
-	// Scan the heightmap values this patch covers and compute the min/max height.
+	// Min/max height of the heightmap values this patch covers, from the pyramid.
 	UINT x0 = j*CellsPerQuadPatch;
 	UINT x1 = (j+1)*CellsPerQuadPatch;
 	UINT y0 = i*CellsPerQuadPatch;
 	UINT y1 = (i+1)*CellsPerQuadPatch;
 
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for(UINT y = y0; y <= y1; ++y)
-	{
-		for(UINT x = x0; x <= x1; ++x)
-		{
-			UINT k = y*mInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, mHeightmap[k]);
-			maxY = MathHelper::Max(maxY, mHeightmap[k]);
-		}
-	}
-
 	UINT patchID = i*(mNumPatchVertCols-1)+j;
-	mQuadPatchBoundsY[patchID] = XMFLOAT2(minY, maxY);
+	mQuadPatchBoundsY[patchID] = mHeightPyramid.GetRangeY(x0, y0, x1, y1);
 }
 
 void TerrainMS::BuildQuadPatchVB(DirectX::ResourceUploadBatch& uploadBatch)
@@ -7,6 +7,7 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/GameTimer.h"
 #include "../../Common/DescriptorUtil.h"
+#include "../../Common/HeightPyramid.h"
 
 #include "../../Shaders/SharedTypes.h"
 
@@ -54,6 +55,17 @@ public:
 	float GetDepth()const;
 	float GetHeight(float x, float z)const;
 
+	// Lowest (x) and highest (y) terrain height over the rectangle [minX, maxX] x
+	// [minZ, maxZ], clamped to the terrain.  Conservative: it may be slightly wider
+	// than the exact range.
+	DirectX::XMFLOAT2 GetHeightRange(float minX, float minZ, float maxX, float maxZ)const;
+
+	// Finds the first point origin + dist*dir, dist in [0, maxDist], on the terrain
+	// surface.  dir does not have to be normalized, so a segment p0p1 is
+	// origin = p0, dir = p1 - p0, maxDist = 1.  Like GetHeight, this works in the
+	// terrain's local space.
+	bool Intersects(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDist, float& dist)const;
+
 	Matrix GetWorld()const;
 	void SetWorld(const Matrix& W);
 
@@ -114,6 +126,9 @@ private:
 	std::vector<Vector2> mQuadPatchBoundsY;
 	std::vector<float> mHeightmap;
 
+	// Min/max heights of mHeightmap; patch bounds and spatial queries come from it.
+	HeightPyramid mHeightPyramid;
+
 	std::vector<Material*> mLayerMaterials;
 
 	float mSkirtOffsetY = 2.0f;
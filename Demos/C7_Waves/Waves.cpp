@@ -3,14 +3,17 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../../Common/d3dUtil.h"
+#include "../../Common/TaskPool.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 
 using namespace DirectX;
 
-Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
+Waves::Waves(int m, int n, float dx, float dt, float speed, float damping, TaskPool* pool)
 {
     mNumRows = m;
     mNumCols = n;
@@ -21,30 +24,30 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mTimeStep = dt;
     mSpatialStep = dx;
 
-	SetConstants(speed, damping);
+    mTaskPool = pool != nullptr ? pool : &TaskPool::Default();
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+	SetConstants(speed, damping);
 
-    // Generate grid vertices in system memory.
+    // Grid points lie in the xz-plane centered at the origin.  Only the heights
+    // change, so x and z are derived from the grid index (see Position).
+    mMinX = -(n - 1)*dx*0.5f;
+    mMaxZ = (m - 1)*dx*0.5f;
 
-    float halfWidth = (n - 1)*dx*0.5f;
-    float halfDepth = (m - 1)*dx*0.5f;
-    for(int i = 0; i < m; ++i)
-    {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
+    mPrevHeights.assign(m*n, 0.0f);
+    mCurrHeights.assign(m*n, 0.0f);
+    mNormalX.assign(m*n, 0.0f);
+    mNormalY.assign(m*n, 1.0f);
+    mNormalZ.assign(m*n, 0.0f);
+    mTangentXx.assign(m*n, 1.0f);
+    mTangentXy.assign(m*n, 0.0f);
 
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
-    }
+    // Everything starts flat, so no tile is active until it is disturbed.
+    mNumTileRows = (m + TileSize - 1) / TileSize;
+    mNumTileCols = (n + TileSize - 1) / TileSize;
+    mActiveTiles.assign(mNumTileRows*mNumTileCols, 0);
+    mTileAmplitude.assign(mNumTileRows*mNumTileCols, 0.0f);
+    mFirstRange.assign(mNumTileRows + 1, 0);
+    mTileScratch.assign(mNumTileCols, 0);
 }
 
 Waves::~Waves()
@@ -90,73 +93,423 @@ void Waves::SetConstants(float speed, float damping)
 	mK3 = (2.0f*e) / d;
 }
 
-void Waves::Update(float dt)
+void Waves::SetMaxSubsteps(int maxSubsteps)
+{
+	mMaxSubsteps = std::max(1, maxSubsteps);
+}
+
+void Waves::WriteVertices(void* vertices, size_t byteSize, const VertexLayout& layout)const
+{
+	assert(byteSize >= (size_t)mVertexCount*layout.Stride);
+
+	const int n = mNumCols;
+	const float dx = mSpatialStep;
+	const float t = mInterpolation;
+	const float invWidth = 1.0f / Width();
+	const float invDepth = 1.0f / Depth();
+
+	uint8_t* base = static_cast<uint8_t*>(vertices);
+
+	mTaskPool->ParallelFor(mNumRows, 16, [&](UINT begin, UINT end)
+	{
+		for(int i = (int)begin; i < (int)end; ++i)
+		{
+			const float z = mMaxZ - i*dx;
+			uint8_t* vertex = base + (size_t)i*n*layout.Stride;
+
+			for(int j = 0; j < n; ++j, vertex += layout.Stride)
+			{
+				const int k = i*n + j;
+				const float x = mMinX + j*dx;
+
+				if(layout.PositionOffset >= 0)
+				{
+					const float p[3] = { x, mPrevHeights[k] + t*(mCurrHeights[k] - mPrevHeights[k]), z };
+					std::memcpy(vertex + layout.PositionOffset, p, sizeof(p));
+				}
+
+				if(layout.NormalOffset >= 0)
+				{
+					const float normal[3] = { mNormalX[k], mNormalY[k], mNormalZ[k] };
+					std::memcpy(vertex + layout.NormalOffset, normal, sizeof(normal));
+				}
+
+				if(layout.TangentXOffset >= 0)
+				{
+					const float tangent[3] = { mTangentXx[k], mTangentXy[k], 0.0f };
+					std::memcpy(vertex + layout.TangentXOffset, tangent, sizeof(tangent));
+				}
+
+				if(layout.TexCOffset >= 0)
+				{
+					// Map [-w/2,w/2] --> [0,1].
+					const float texC[2] = { 0.5f + x*invWidth, 0.5f - z*invDepth };
+					std::memcpy(vertex + layout.TexCOffset, texC, sizeof(texC));
+				}
+			}
+		}
+	});
+}
+
+void Waves::SetQuiescentThreshold(float threshold)
+{
+	mQuiescentThreshold = std::max(0.0f, threshold);
+
+	// Without a threshold every tile is simulated.  Otherwise the tiles settle down
+	// on their own after the next step.
+	if(mQuiescentThreshold == 0.0f)
+		std::fill(mActiveTiles.begin(), mActiveTiles.end(), (uint8_t)1);
+}
+
+int Waves::ActiveTileCount()const
+{
+	return (int)std::count(mActiveTiles.begin(), mActiveTiles.end(), (uint8_t)1);
+}
+
+int Waves::TileCount()const
 {
-	static float t = 0;
+	return mNumTileRows*mNumTileCols;
+}
 
+void Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulatedTime += dt;
 
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	int numSteps = (int)(mAccumulatedTime / mTimeStep);
+	if(numSteps > mMaxSubsteps)
+	{
+		// Too far behind; drop the whole steps we cannot afford but keep the phase.
+		mAccumulatedTime -= (numSteps - mMaxSubsteps)*mTimeStep;
+		numSteps = mMaxSubsteps;
+	}
+
+	if(numSteps > 0)
+	{
+		Step(numSteps);
+		mAccumulatedTime -= numSteps*mTimeStep;
+	}
+
+	mInterpolation = std::clamp(mAccumulatedTime / mTimeStep, 0.0f, 1.0f);
+}
+
+void Waves::Update(Waves* const* waves, int count, float dt, TaskPool* pool)
+{
+	if(pool == nullptr)
+		pool = &TaskPool::Default();
+
+	pool->ParallelFor(count, 1, [&](UINT begin, UINT end)
+	{
+		for(UINT i = begin; i < end; ++i)
+			waves[i]->Update(dt);
+	});
+}
+
+void Waves::Step(int numSteps)
+{
+	if(numSteps <= 0)
+		return;
+
+	BuildSteppedRanges((numSteps + TileSize - 1) / TileSize);
+	if(mRanges.empty())
+		return;
+
+	while(numSteps > 0)
+	{
+		int blockSteps = std::min(numSteps, MaxStepsPerBlock);
+		StepBlock(blockSteps);
+		numSteps -= blockSteps;
+	}
+
+	UpdateNormals();
+}
+
+void Waves::StepRow(float* next, const float* curr, int row)const
+{
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to
+	// keep consistent with our row indices going down.
+	//
+	// next holds the step before curr.  We can overwrite it in place because each
+	// point reads its own old value only.
+
+	const int n = mNumCols;
+	float* dst = next + row*n;
+	const float* c = curr + row*n;
+	const float* up = c - n;
+	const float* down = c + n;
+
+	const XMVECTOR k1 = XMVectorReplicate(mK1);
+	const XMVECTOR k2 = XMVectorReplicate(mK2);
+	const XMVECTOR k3 = XMVectorReplicate(mK3);
+
+	// Only update interior points of stepped tiles; we use zero boundary conditions
+	// and frozen tiles keep their heights.
+	const int tileRow = row / TileSize;
+	for(int r = mFirstRange[tileRow]; r < mFirstRange[tileRow + 1]; ++r)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		const int end = mRanges[r].End;
+
+		int j = mRanges[r].Begin;
+		for(; j + 4 <= end; j += 4)
+		{
+			XMVECTOR prev = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(dst + j));
+			XMVECTOR center = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j));
+			XMVECTOR sum = XMVectorAdd(
+				XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(up + j)),
+				            XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(down + j))),
+				XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j - 1)),
+				            XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j + 1))));
+
+			XMVECTOR h = XMVectorMultiply(k1, prev);
+			h = XMVectorMultiplyAdd(k2, center, h);
+			h = XMVectorMultiplyAdd(k3, sum, h);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dst + j), h);
+		}
+
+		for(; j < end; ++j)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			dst[j] = mK1*dst[j] + mK2*c[j] + mK3*(up[j] + down[j] + c[j+1] + c[j-1]);
+		}
+	}
+}
+
+void Waves::StepBlock(int numSteps)
+{
+	const int m = mNumRows;
+
+	// Time level s lives in heights[s % 2]; level 0 is the current solution and
+	// level -1 the previous one.  Level s overwrites level s-2 row by row.
+	float* heights[2] = { mCurrHeights.data(), mPrevHeights.data() };
+
+	// Split the interior rows [1, m-1) into bands.  Inside a band the steps run as
+	// a wavefront: after row i of step s is done, row i-1 of step s+1 has all its
+	// inputs, so a few rows stay hot in cache for all numSteps steps.  Step s can
+	// only advance s-1 rows into a band from a neighbouring band, so the rows near
+	// band boundaries are finished afterwards (split tiling).
+	const int interiorRows = m - 2;
+	const int minBandRows = std::max(2*numSteps, 16);
+	const int numBands = std::clamp(interiorRows / minBandRows, 1, (int)mTaskPool->ThreadCount());
+
+	auto bandBegin = [&](int band) { return 1 + (int)((long long)interiorRows * band / numBands); };
+
+	mTaskPool->ParallelFor(numBands, 1, [&](UINT begin, UINT end)
+	{
+		for(int band = (int)begin; band < (int)end; ++band)
+		{
+			const int a = bandBegin(band);
+			const int b = bandBegin(band + 1);
+
+			for(int i = a; i < b + numSteps - 1; ++i)
+			{
+				for(int s = 1; s <= numSteps; ++s)
+				{
+					// Rows next to the fixed boundary rows do not shrink.
+					int lo = a == 1 ? 1 : a + s - 1;
+					int hi = b == m - 1 ? m - 1 : b - s + 1;
+
+					int row = i - (s - 1);
+					if(row >= lo && row < hi)
+						StepRow(heights[s % 2], heights[(s - 1) % 2], row);
+				}
+			}
+		}
+	});
+
+	// Fill in the triangles around each band boundary, one step at a time.
+	if(numBands > 1 && numSteps > 1)
+	{
+		mTaskPool->ParallelFor(numBands - 1, 1, [&](UINT begin, UINT end)
+		{
+			for(int boundary = (int)begin + 1; boundary < (int)end + 1; ++boundary)
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
+				const int b = bandBegin(boundary);
+				for(int s = 2; s <= numSteps; ++s)
+				{
+					for(int row = b - s + 1; row < b + s - 1; ++row)
+						StepRow(heights[s % 2], heights[(s - 1) % 2], row);
+				}
 			}
 		});
+	}
+
+	// An odd number of steps leaves the newest solution in the previous buffer.
+	if(numSteps % 2 == 1)
+		std::swap(mPrevHeights, mCurrHeights);
+}
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+void Waves::BuildSteppedRanges(int margin)
+{
+	const int m = mNumRows;
+	const int n = mNumCols;
+	const int tileCols = mNumTileCols;
+
+	mRanges.clear();
+
+	for(int ty = 0; ty < mNumTileRows; ++ty)
+	{
+		mFirstRange[ty] = (int)mRanges.size();
 
-		t = 0.0f; // reset time
+		// Tile columns with an active tile within margin tile rows.
+		const int y0 = std::max(0, ty - margin);
+		const int y1 = std::min(mNumTileRows - 1, ty + margin);
+		for(int tx = 0; tx < tileCols; ++tx)
+		{
+			uint8_t active = 0;
+			for(int y = y0; y <= y1; ++y)
+				active |= mActiveTiles[y*tileCols + tx];
+			mTileScratch[tx] = active;
+		}
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+		// Then grow each of them by margin tile columns and merge into runs.
+		int runBegin = -1;
+		int lastActive = -margin - 2;
+		for(int tx = 0; tx <= tileCols; ++tx)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			if(tx < tileCols && mTileScratch[tx])
+				lastActive = tx;
+
+			bool stepped = tx < tileCols && tx - lastActive <= margin;
+			for(int x = tx + 1; x <= std::min(tx + margin, tileCols - 1) && !stepped; ++x)
+				stepped = mTileScratch[x] != 0;
+
+			if(stepped && runBegin < 0)
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				runBegin = tx;
 			}
-		});
+			else if(!stepped && runBegin >= 0)
+			{
+				ColumnRange range;
+				range.Begin = std::max(1, runBegin*TileSize);
+				range.End = std::min(n - 1, tx*TileSize);
+				if(range.Begin < range.End)
+					mRanges.push_back(range);
+				runBegin = -1;
+			}
+		}
+
+		// Tile rows without interior rows have nothing to step.
+		if(std::max(1, ty*TileSize) >= std::min(m - 1, (ty + 1)*TileSize))
+			mRanges.resize(mFirstRange[ty]);
 	}
+
+	mFirstRange[mNumTileRows] = (int)mRanges.size();
+}
+
+void Waves::UpdateNormals()
+{
+	//
+	// Compute normals using finite difference scheme.
+	//
+
+	const int m = mNumRows;
+	const int n = mNumCols;
+	const float twoDx = 2.0f*mSpatialStep;
+
+	// Each task owns whole tile rows, so it can decide alone which tiles go quiet.
+	// Rows are walked in full across a tile row to keep the loads sequential.
+	mTaskPool->ParallelFor(mNumTileRows, 1, [&](UINT begin, UINT end)
+	{
+		const XMVECTOR twoDxV = XMVectorReplicate(twoDx);
+		const XMVECTOR twoDxSq = XMVectorReplicate(twoDx*twoDx);
+
+		for(int ty = (int)begin; ty < (int)end; ++ty)
+		{
+			// Largest |height| of each tile over the last two time steps.
+			float* amplitude = &mTileAmplitude[ty*mNumTileCols];
+
+			const int i0 = std::max(1, ty*TileSize);
+			const int i1 = std::min(m - 1, (ty + 1)*TileSize);
+
+			for(int i = i0; i < i1; ++i)
+			{
+				const float* c = mCurrHeights.data() + i*n;
+				const float* p = mPrevHeights.data() + i*n;
+				const float* up = c - n;
+				const float* down = c + n;
+
+				for(int r = mFirstRange[ty]; r < mFirstRange[ty + 1]; ++r)
+				{
+					const ColumnRange range = mRanges[r];
+
+					for(int tx = range.Begin / TileSize; tx*TileSize < range.End; ++tx)
+					{
+						const int j1 = std::min(range.End, (tx + 1)*TileSize);
+
+						XMVECTOR amplitudeV = XMVectorZero();
+						float tileAmplitude = i == i0 ? 0.0f : amplitude[tx];
+
+						int j = std::max(range.Begin, tx*TileSize);
+						for(; j + 4 <= j1; j += 4)
+						{
+							XMVECTOR center = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j));
+							XMVECTOR l = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j - 1));
+							XMVECTOR r = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(c + j + 1));
+							XMVECTOR t = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(up + j));
+							XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(down + j));
+
+							amplitudeV = XMVectorMax(amplitudeV, XMVectorAbs(center));
+							amplitudeV = XMVectorMax(amplitudeV,
+								XMVectorAbs(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + j))));
+
+							// n = (l-r, 2dx, b-t) and tangent = (2dx, r-l, 0), normalized.
+							XMVECTOR dX = XMVectorSubtract(l, r);
+							XMVECTOR dZ = XMVectorSubtract(b, t);
+
+							XMVECTOR dXSq = XMVectorMultiply(dX, dX);
+							XMVECTOR invNormalLength = XMVectorReciprocalSqrt(
+								XMVectorAdd(XMVectorMultiplyAdd(dZ, dZ, dXSq), twoDxSq));
+							XMVECTOR invTangentLength = XMVectorReciprocalSqrt(XMVectorAdd(dXSq, twoDxSq));
+
+							XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&mNormalX[i*n + j]), XMVectorMultiply(dX, invNormalLength));
+							XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&mNormalY[i*n + j]), XMVectorMultiply(twoDxV, invNormalLength));
+							XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&mNormalZ[i*n + j]), XMVectorMultiply(dZ, invNormalLength));
+							XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&mTangentXx[i*n + j]), XMVectorMultiply(twoDxV, invTangentLength));
+							XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&mTangentXy[i*n + j]), XMVectorNegate(XMVectorMultiply(dX, invTangentLength)));
+						}
+
+						for(; j < j1; ++j)
+						{
+							float l = c[j-1];
+							float r = c[j+1];
+							float t = up[j];
+							float b = down[j];
+
+							tileAmplitude = std::max(tileAmplitude, std::max(std::abs(c[j]), std::abs(p[j])));
+
+							XMVECTOR N = XMVector3Normalize(XMVectorSet(l - r, twoDx, b - t, 0.0f));
+							mNormalX[i*n + j] = XMVectorGetX(N);
+							mNormalY[i*n + j] = XMVectorGetY(N);
+							mNormalZ[i*n + j] = XMVectorGetZ(N);
+
+							XMVECTOR T = XMVector3Normalize(XMVectorSet(twoDx, r - l, 0.0f, 0.0f));
+							mTangentXx[i*n + j] = XMVectorGetX(T);
+							mTangentXy[i*n + j] = XMVectorGetY(T);
+						}
+
+						XMFLOAT4 lanes;
+						XMStoreFloat4(&lanes, amplitudeV);
+						amplitude[tx] = std::max(std::max(tileAmplitude, std::max(lanes.x, lanes.y)), std::max(lanes.z, lanes.w));
+					}
+				}
+			}
+
+			// Only the stepped tiles were measured; the others stay frozen.
+			for(int r = mFirstRange[ty]; r < mFirstRange[ty + 1]; ++r)
+			{
+				for(int tx = mRanges[r].Begin / TileSize; tx*TileSize < mRanges[r].End; ++tx)
+				{
+					mActiveTiles[ty*mNumTileCols + tx] = mQuiescentThreshold == 0.0f || amplitude[tx] > mQuiescentThreshold;
+				}
+			}
+		}
+	});
+}
+
+void Waves::MarkActive(int i, int j)
+{
+	mActiveTiles[(i / TileSize)*mNumTileCols + j / TileSize] = 1;
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -168,10 +521,18 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f*magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	mCurrHeights[i*mNumCols+j]     += magnitude;
+	mCurrHeights[i*mNumCols+j+1]   += halfMag;
+	mCurrHeights[i*mNumCols+j-1]   += halfMag;
+	mCurrHeights[(i+1)*mNumCols+j] += halfMag;
+	mCurrHeights[(i-1)*mNumCols+j] += halfMag;
+
+	// The neighbours may lie in the next tile, which the one tile margin covers.
+	MarkActive(i, j);
+}
+
+void Waves::Disturb(const Disturbance* disturbances, int count)
+{
+	for(int k = 0; k < count; ++k)
+		Disturb(disturbances[k].I, disturbances[k].J, disturbances[k].Magnitude);
 }
-	
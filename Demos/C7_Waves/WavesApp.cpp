@@ -380,15 +380,14 @@ void WavesApp::UpdateWaves(const GameTimer& gt)
     // Update the wave simulation.
     mWaves->Update(gt.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
+    // Write the new solution straight into this frame's wave vertex buffer.  The
+    // attributes the simulation does not own were filled in BuildFrameResources.
+    Waves::VertexLayout layout;
+    layout.Stride = sizeof(ColorVertex);
+    layout.PositionOffset = offsetof(ColorVertex, Pos);
+
     auto currWavesVB = mCurrFrameResource->WavesVB.get();
-    std::vector<ColorVertex> verts(mWaves->VertexCount());
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        verts[i].Pos = mWaves->Position(i);
-        verts[i].Color = XMFLOAT4(DirectX::Colors::Blue);
-    }
-    currWavesVB->CopyData(verts.data(), verts.size());
+    mWaves->WriteVertices(currWavesVB->MappedData(), mWaves->VertexCount()*sizeof(ColorVertex), layout);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -492,6 +491,14 @@ void WavesApp::BuildFrameResources()
             std::make_unique<FrameResource>(md3dDevice.Get(),
             passCount, mWaves->VertexCount()));
     }
+
+    // UpdateWaves only rewrites the positions of the wave vertices.
+    std::vector<ColorVertex> waveVerts(mWaves->VertexCount());
+    for(ColorVertex& v : waveVerts)
+        v.Color = XMFLOAT4(DirectX::Colors::Blue);
+
+    for(auto& frameResource : mFrameResources)
+        frameResource->WavesVB->CopyData(waveVerts.data(), (uint32_t)waveVerts.size());
 }
 
 void WavesApp::AddRenderItem(RenderLayer layer, const DirectX::XMFLOAT4X4& world, MeshGeometry* geo, SubmeshGeometry& drawArgs)
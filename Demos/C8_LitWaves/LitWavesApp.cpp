@@ -461,19 +461,15 @@ void LitWavesApp::UpdateWaves(const GameTimer& gt)
     // Update the wave simulation.
     mWaves->Update(gt.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
-    auto currWavesVB = mCurrFrameResource->WavesVB.get();
-    std::vector<ModelVertex> verts(mWaves->VertexCount());
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        verts[i].Pos = mWaves->Position(i);
-        verts[i].Normal = mWaves->Normal(i);
+    // Write the new solution straight into this frame's wave vertex buffer.  The
+    // attributes the simulation does not own were filled in BuildFrameResources.
+    Waves::VertexLayout layout;
+    layout.Stride = sizeof(ModelVertex);
+    layout.PositionOffset = offsetof(ModelVertex, Pos);
+    layout.NormalOffset = offsetof(ModelVertex, Normal);
 
-        // Not used in this demo.
-        verts[i].TexC = XMFLOAT2(0.0f, 0.0f);
-        verts[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    }
-    currWavesVB->CopyData(verts.data(), verts.size());
+    auto currWavesVB = mCurrFrameResource->WavesVB.get();
+    mWaves->WriteVertices(currWavesVB->MappedData(), mWaves->VertexCount()*sizeof(ModelVertex), layout);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -580,6 +576,13 @@ void LitWavesApp::BuildFrameResources()
             std::make_unique<FrameResource>(md3dDevice.Get(),
             passCount, mMaterials.size(), mWaves->VertexCount()));
     }
+
+    // UpdateWaves only rewrites the attributes the simulation computes; the rest
+    // stay zero (they are not used by the wave shaders).
+    std::vector<ModelVertex> waveVerts(mWaves->VertexCount());
+
+    for(auto& frameResource : mFrameResources)
+        frameResource->WavesVB->CopyData(waveVerts.data(), (uint32_t)waveVerts.size());
 }
 
 void LitWavesApp::BuildMaterials()
@@ -496,25 +496,16 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
     // Update the wave simulation.
     mWaves->Update(gt.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
-    auto currWavesVB = mCurrFrameResource->WavesVB.get();
-    std::vector<ModelVertex> verts(mWaves->VertexCount());
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        XMFLOAT3 pos = mWaves->Position(i);
+    // Write the new solution straight into this frame's wave vertex buffer.  The
+    // attributes the simulation does not own were filled in BuildFrameResources.
+    Waves::VertexLayout layout;
+    layout.Stride = sizeof(ModelVertex);
+    layout.PositionOffset = offsetof(ModelVertex, Pos);
+    layout.NormalOffset = offsetof(ModelVertex, Normal);
+    layout.TexCOffset = offsetof(ModelVertex, TexC);
 
-        verts[i].Pos = pos;
-        verts[i].Normal = mWaves->Normal(i);
-        
-        // Derive tex-coords from position by 
-        // mapping [-w/2,w/2] --> [0,1]
-        verts[i].TexC.x = 0.5f + pos.x / mWaves->Width();
-        verts[i].TexC.y = 0.5f - pos.z / mWaves->Depth();
-
-        // Not used in this demo.
-        verts[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    }
-    currWavesVB->CopyData(verts.data(), verts.size());
+    auto currWavesVB = mCurrFrameResource->WavesVB.get();
+    mWaves->WriteVertices(currWavesVB->MappedData(), mWaves->VertexCount()*sizeof(ModelVertex), layout);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -649,6 +640,13 @@ void TexWavesApp::BuildFrameResources()
             std::make_unique<FrameResource>(md3dDevice.Get(),
             passCount, matLib.GetMaterialCount(), mWaves->VertexCount()));
     }
+
+    // UpdateWaves only rewrites the attributes the simulation computes; the rest
+    // stay zero (they are not used by the wave shaders).
+    std::vector<ModelVertex> waveVerts(mWaves->VertexCount());
+
+    for(auto& frameResource : mFrameResources)
+        frameResource->WavesVB->CopyData(waveVerts.data(), (uint32_t)waveVerts.size());
 }
 
 void TexWavesApp::BuildMaterials()
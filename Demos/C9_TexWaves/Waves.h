@@ -3,19 +3,54 @@
 //
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
-// This class only does the calculations, it does not do any drawing.
+// This class only does the calculations, it does not do any drawing.  WriteVertices
+// writes the solution straight into a vertex buffer of the caller's vertex format.
+//
+// Heights, normals and tangents are kept in separate planes of floats (the x and z
+// of a grid point never change), so the stencil streams through dense rows four
+// points per SIMD instruction.  Several time steps are run per pass over the grid
+// (temporal blocking) and the rows are split into bands that run on a TaskPool.
+//
+// The grid is also divided into square tiles.  Only tiles that are moving, and a
+// one tile margin around them, are stepped and get new normals; a tile whose heights
+// have all decayed below the quiescent threshold is frozen until a wave or a
+// disturbance reaches it again, so a calm surface costs in proportion to the area
+// that is actually moving.
 //***************************************************************************************
 
 #ifndef WAVES_H
 #define WAVES_H
 
+#include <cstdint>
 #include <vector>
 #include <DirectXMath.h>
 
+class TaskPool;
+
 class Waves
 {
 public:
-    Waves(int m, int n, float dx, float dt, float speed, float damping);
+    // Byte offsets of the attributes WriteVertices fills in a vertex of Stride bytes;
+    // -1 leaves the attribute alone.  Positions, normals and tangents are float3 and
+    // texture coordinates float2, mapping the grid onto [0,1]^2.
+    struct VertexLayout
+    {
+        size_t Stride = 0;
+        int PositionOffset = -1;
+        int NormalOffset = -1;
+        int TangentXOffset = -1;
+        int TexCOffset = -1;
+    };
+
+    struct Disturbance
+    {
+        int I = 0;
+        int J = 0;
+        float Magnitude = 0.0f;
+    };
+
+    // pool may be null to use TaskPool::Default().
+    Waves(int m, int n, float dx, float dt, float speed, float damping, TaskPool* pool = nullptr);
     Waves(const Waves& rhs) = delete;
     Waves& operator=(const Waves& rhs) = delete;
     ~Waves();
@@ -27,21 +62,105 @@ public:
 	float Width()const;
 	float Depth()const;
 
-	// Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+	// Returns the solution at the ith grid point, interpolated between the last two
+	// time steps by how far Update has got into the next step.
+    DirectX::XMFLOAT3 Position(int i)const
+    {
+        float y = mPrevHeights[i] + mInterpolation*(mCurrHeights[i] - mPrevHeights[i]);
+        return DirectX::XMFLOAT3(mMinX + (i % mNumCols)*mSpatialStep, y, mMaxZ - (i / mNumCols)*mSpatialStep);
+    }
 
-	// Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+	// Returns the solution normal at the ith grid point.  Normals and tangents are
+	// those of the latest time step; they are not interpolated.
+    DirectX::XMFLOAT3 Normal(int i)const
+    {
+        return DirectX::XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]);
+    }
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+    DirectX::XMFLOAT3 TangentX(int i)const
+    {
+        return DirectX::XMFLOAT3(mTangentXx[i], mTangentXy[i], 0.0f);
+    }
+
+	// Writes every grid point, row major, into vertices, which must hold VertexCount()
+	// vertices of layout.Stride bytes.  vertices may be mapped upload memory: it is
+	// only written, front to back.  Gives the same values as Position, Normal and
+	// TangentX without a copy in between.
+	void WriteVertices(void* vertices, size_t byteSize, const VertexLayout& layout)const;
 
     void SetConstants(float speed, float damping);
 
+	// Runs as many fixed time steps as fit in the time accumulated so far, at most
+	// the substep cap, and keeps the remainder for the next call.  If the cap is hit
+	// the simulation falls behind real time rather than taking ever longer frames.
 	void Update(float dt);
 	void Disturb(int i, int j, float magnitude);
 
+	// Applies count disturbances at once and wakes the tiles they touch.
+	void Disturb(const Disturbance* disturbances, int count);
+
+	// Updates several independent grids in parallel on pool (TaskPool::Default() if
+	// null).  Each grid still splits its own steps over the pool.
+	static void Update(Waves* const* waves, int count, float dt, TaskPool* pool = nullptr);
+
+	void SetMaxSubsteps(int maxSubsteps);
+
+	// Tiles whose heights stay within +-threshold are frozen.  0 simulates every
+	// tile on every step.
+	void SetQuiescentThreshold(float threshold);
+
+	// Number of tiles that were still moving after the last step, out of TileCount().
+	int ActiveTileCount()const;
+	int TileCount()const;
+
+	// Advances the simulation by numSteps time steps and recomputes the normals and
+	// tangents once at the end.
+	void Step(int numSteps);
+
 private:
+	// Runs numSteps <= MaxStepsPerBlock steps over the grid in one pass.
+	void StepBlock(int numSteps);
+
+	// Computes one row of the next time step in place over the step before last.
+	void StepRow(float* next, const float* curr, int row)const;
+
+	// Recomputes normals and tangents in the stepped tiles and decides which of them
+	// are still active.
+	void UpdateNormals();
+
+	void MarkActive(int i, int j);
+
+	// Fills mRanges with the tiles to step: the active tiles grown by margin tiles.
+	void BuildSteppedRanges(int margin);
+
+private:
+	// More steps per pass keep the grid in cache longer, but need wider bands.
+	static constexpr int MaxStepsPerBlock = 8;
+
+	// Tile edge in grid points.  A wave moves one point per step, so a margin of one
+	// tile contains everything that can leave the active tiles in TileSize steps.
+	static constexpr int TileSize = 32;
+
+	// Columns [Begin, End) of a run of stepped tiles in one tile row.
+	struct ColumnRange
+	{
+		int Begin;
+		int End;
+	};
+
+	TaskPool* mTaskPool = nullptr;
+
+	// Time not yet simulated, always less than one time step after Update.
+	float mAccumulatedTime = 0.0f;
+
+	// mAccumulatedTime / mTimeStep, used to interpolate heights for rendering.
+	float mInterpolation = 1.0f;
+
+	int mMaxSubsteps = MaxStepsPerBlock;
+
+	float mQuiescentThreshold = 1e-4f;
+
     int mNumRows = 0;
     int mNumCols = 0;
 
@@ -56,10 +175,33 @@ private:
     float mTimeStep = 0.0f;
     float mSpatialStep = 0.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
-    std::vector<DirectX::XMFLOAT3> mNormals;
-    std::vector<DirectX::XMFLOAT3> mTangentX;
+	// x of the first column and z of the first row.
+	float mMinX = 0.0f;
+	float mMaxZ = 0.0f;
+
+	// One float per grid point, row major.
+    std::vector<float> mPrevHeights;
+    std::vector<float> mCurrHeights;
+    std::vector<float> mNormalX;
+    std::vector<float> mNormalY;
+    std::vector<float> mNormalZ;
+    std::vector<float> mTangentXx;
+    std::vector<float> mTangentXy;
+
+	int mNumTileRows = 0;
+	int mNumTileCols = 0;
+
+	// One flag per tile, row major: nonzero if the tile was moving after the last
+	// step or has been disturbed since.
+	std::vector<uint8_t> mActiveTiles;
+
+	// Largest |height| per tile, measured while updating the normals.
+	std::vector<float> mTileAmplitude;
+
+	// Stepped column ranges of tile row r are mRanges[mFirstRange[r], mFirstRange[r+1]).
+	std::vector<ColumnRange> mRanges;
+	std::vector<int> mFirstRange;
+	std::vector<uint8_t> mTileScratch;
 };
 
 #endif // WAVES_H
\ No newline at end of file
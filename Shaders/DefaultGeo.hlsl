@@ -1,6 +1,9 @@
 // Include common HLSL code.
 #include "Shaders/Common.hlsl"
 
+#if PACKED_VERTEX
+#include "Shaders/PackedVertex.hlsl"
+#else
 struct VertexIn
 {
     float3 PosL    : POSITION;
@@ -12,6 +15,7 @@ struct VertexIn
     uint4 BoneIndices  : BONEINDICES;
 #endif
 };
+#endif
 
 struct VertexOut
 {
@@ -31,14 +35,22 @@ struct VertexOut
 #endif
 };
 
+#if PACKED_VERTEX
+VertexOut VS(PackedVertexIn pvin)
+#else
 VertexOut VS(VertexIn vin
     #if DRAW_INSTANCED
     , uint instanceID : SV_InstanceID
     #endif
     )
+#endif
 {
     VertexOut vout = (VertexOut)0.0f;
 
+#if PACKED_VERTEX
+    VertexIn vin = UnpackVertex(pvin);
+#endif
+
 #if DRAW_INSTANCED
     // Fetch the instance data.
     InstanceData instData = gInstanceData[instanceID];
@@ -5,6 +5,9 @@
 // Include common HLSL code.
 #include "Shaders/Common.hlsl"
 
+#if PACKED_VERTEX
+#include "Shaders/PackedVertex.hlsl"
+#else
 struct VertexIn
 {
 	float3 PosL    : POSITION;
@@ -16,6 +19,7 @@ struct VertexIn
     uint4 BoneIndices  : BONEINDICES;
 #endif
 };
+#endif
 
 struct VertexOut
 {
@@ -25,10 +29,18 @@ struct VertexOut
 	float2 TexC     : TEXCOORD;
 };
 
+#if PACKED_VERTEX
+VertexOut VS(PackedVertexIn pvin)
+#else
 VertexOut VS(VertexIn vin)
+#endif
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+#if PACKED_VERTEX
+	VertexIn vin = UnpackVertex(pvin);
+#endif
+
 	// Fetch the material data.
 	MaterialData matData = gMaterialData[gMaterialIndex];
 	
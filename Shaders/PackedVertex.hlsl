@@ -0,0 +1,66 @@
+//***************************************************************************************
+// PackedVertex.hlsl
+//
+// Vertex input for the PackedModelVertex/PackedSkinnedVertex layouts written by
+// VertexCompression on the CPU.  The input assembler already expands the unorm, snorm
+// and half formats to floats; UnpackVertex dequantizes the position with the per object
+// constants and decodes the octahedral normal and tangent, so a vertex shader compiled
+// with PACKED_VERTEX=1 can run its unchanged body on the result.
+//
+// Include after Common.hlsl.  Not supported with DRAW_INSTANCED, which binds no
+// per object constants to dequantize with.
+//***************************************************************************************
+
+#if DRAW_INSTANCED
+#error Packed vertices are dequantized with per object constants, which instanced draws do not have.
+#endif
+
+struct PackedVertexIn
+{
+    float4 PosQ       : POSITION;
+    float2 NormalOct  : NORMAL;
+    float2 TangentOct : TANGENT;
+    float2 TexC       : TEXCOORD;
+#if SKINNED
+    float4 BoneWeights : WEIGHTS;
+    uint4 BoneIndices  : BONEINDICES;
+#endif
+};
+
+// The same members as the float VertexIn structures of the shaders that include this.
+struct VertexIn
+{
+    float3 PosL;
+    float3 NormalL;
+    float2 TexC;
+    float3 TangentU;
+#if SKINNED
+    float3 BoneWeights;
+    uint4 BoneIndices;
+#endif
+};
+
+// Inverse of the octahedral mapping in VertexCompression.cpp.
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+VertexIn UnpackVertex(PackedVertexIn pvin)
+{
+    VertexIn vin;
+    vin.PosL = pvin.PosQ.xyz * gPosDequantScale + gPosDequantOffset;
+    vin.NormalL = OctDecode(pvin.NormalOct);
+    vin.TexC = pvin.TexC;
+    vin.TangentU = OctDecode(pvin.TangentOct);
+#if SKINNED
+    // The fourth weight is implied, as in ApplySkinning.
+    vin.BoneWeights = pvin.BoneWeights.xyz;
+    vin.BoneIndices = pvin.BoneIndices;
+#endif
+    return vin;
+}
@@ -5,6 +5,9 @@
 // Include common HLSL code.
 #include "Shaders/Common.hlsl"
 
+#if PACKED_VERTEX
+#include "Shaders/PackedVertex.hlsl"
+#else
 struct VertexIn
 {
 	float3 PosL    : POSITION;
@@ -14,6 +17,7 @@ struct VertexIn
     uint4 BoneIndices  : BONEINDICES;
 #endif
 };
+#endif
 
 struct VertexOut
 {
@@ -21,24 +25,46 @@ struct VertexOut
 	float2 TexC    : TEXCOORD;
 };
 
-VertexOut VS(VertexIn vin)
+#if PACKED_VERTEX
+VertexOut VS(PackedVertexIn pvin)
+#else
+VertexOut VS(VertexIn vin
+    #if DRAW_INSTANCED
+    , uint instanceID : SV_InstanceID
+    #endif
+    )
+#endif
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+#if PACKED_VERTEX
+	VertexIn vin = UnpackVertex(pvin);
+#endif
+
+#if DRAW_INSTANCED
+    // Fetch the instance data.
+    InstanceData instData = gInstanceData[instanceID];
+    float4x4 world = instData.World;
+    float4x4 texTransform = instData.TexTransform;
+    MaterialData matData = gMaterialData[instData.MaterialIndex];
+#else
+    float4x4 world = gWorld;
+    float4x4 texTransform = gTexTransform;
 	MaterialData matData = gMaterialData[gMaterialIndex];
+#endif
 	
 #if SKINNED
     ApplySkinningShadows( vin.BoneWeights, vin.BoneIndices, vin.PosL);
 #endif
 
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
 	vout.TexC = mul(texC, matData.MatTransform).xy;
 	
     return vout;
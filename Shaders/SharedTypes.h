@@ -63,6 +63,12 @@ DEFINE_CBUFFER(PerObjectCB, b0)
     // Add some generic members so we can reuse the same structure for different objects.
     uint4    gMiscUint4;
     float4   gMiscFloat4;
+
+    // Used only for packed vertices: position = unorm16 position * scale + offset.
+    float3   gPosDequantScale;
+    float    PerObjectCB_Pad1;
+    float3   gPosDequantOffset;
+    float    PerObjectCB_Pad2;
 };
 
 struct Light
@@ -197,7 +203,10 @@ DEFINE_CBUFFER(PerTerrainCB, b0)
 
     uint gUseTerrainHeightMap;
     uint gUseMaterialHeightMaps;
-    uint2 gTerrain_Pad0;
+
+    // Height = scale * heightmap sample + offset; (1, 0) for float heightmaps.
+    float gTerrainHeightScale;
+    float gTerrainHeightOffset;
 
     //
     // Used for Mesh Shader based Terrains
@@ -363,6 +372,30 @@ struct InstanceData
     uint     CubeMapIndex;
 };
 
+// Structured Buffers for drawing a MeshGeometry with mesh shaders; built by
+// Common/MeshletBuilder.  A meshlet's vertices are VertexCount entries of the
+// vertex index buffer starting at VertexOffset, relative to the submesh's base
+// vertex.  Its triangles are PrimitiveCount entries of the primitive buffer,
+// each three 10-bit indices into the meshlet's vertices.
+struct Meshlet
+{
+    uint VertexCount;
+    uint VertexOffset;
+    uint PrimitiveCount;
+    uint PrimitiveOffset;
+};
+
+// A meshlet is entirely back facing, and can be culled, if
+// dot(normalize(ConeApex - gEyePosW), NormalCone.xyz) >= NormalCone.w (in the
+// meshlet's space).  NormalCone.w is 1 when the normals are too spread out.
+struct MeshletCullData
+{
+    float4 BoundingSphere; // xyz = center, w = radius
+    float4 NormalCone;     // xyz = axis, w = sine of the cone's half angle
+    float3 ConeApex;
+    uint   MeshletCullData_Pad0;
+};
+
 //////////////
 // Ray Tracing
 //////////////
@@ -12,6 +12,13 @@ struct VertexOut
 	float2 BoundsY  : TEXCOORD1;
 };
 
+// The heightmap is either float heights or unorm16 samples (Terrain::InitInfo::
+// QuantizedHeights); gTerrainHeightScale/Offset turn a sample into a height.
+float SampleTerrainHeight(Texture2D heightMap, float2 texC)
+{
+	return gTerrainHeightScale * heightMap.SampleLevel(GetLinearClampSampler(), texC, 0).r + gTerrainHeightOffset;
+}
+
 VertexOut VS(float4 vin : POSITION)
 {
 	VertexOut vout;
@@ -32,7 +39,7 @@ VertexOut VS(float4 vin : POSITION)
 	// Displace the patch corners to world space.  This is to make 
 	// the eye to patch distance calculation more accurate.
 	Texture2D heightMap = ResourceDescriptorHeap[gHeightMapSrvIndex];
-	posL.y = heightMap.SampleLevel(GetLinearClampSampler(), texC, 0).r;
+	posL.y = SampleTerrainHeight(heightMap, texC);
 
 	vout.PosW     = mul(float4(posL, 1.0f), gTerrainWorld).xyz;
 	vout.TexC     = texC;
@@ -223,7 +230,7 @@ DomainOut DS(PatchTess patchTess,
 	if( gUseTerrainHeightMap )
 	{
 		Texture2D heightMap = ResourceDescriptorHeap[gHeightMapSrvIndex];
-		dout.PosW.y = heightMap.SampleLevel(GetLinearClampSampler(), dout.TexC, 0).r;
+		dout.PosW.y = SampleTerrainHeight(heightMap, dout.TexC);
 	}
 
 	if( gUseMaterialHeightMaps )
@@ -260,10 +267,10 @@ void EstimateTangentFrame(float2 texC, out float3 outTangentW, out float3 outBit
 	float2 topTexC    = texC + float2(0.0f, -gTerrainTexelSizeUV.y);
 
 	Texture2D heightMap = ResourceDescriptorHeap[gHeightMapSrvIndex];
-	float leftY   = heightMap.SampleLevel(GetLinearClampSampler(), leftTexC, 0).r;
-	float rightY  = heightMap.SampleLevel(GetLinearClampSampler(), rightTexC, 0).r;
-	float bottomY = heightMap.SampleLevel(GetLinearClampSampler(), bottomTexC, 0).r;
-	float topY    = heightMap.SampleLevel(GetLinearClampSampler(), topTexC, 0).r;
+	float leftY   = SampleTerrainHeight(heightMap, leftTexC);
+	float rightY  = SampleTerrainHeight(heightMap, rightTexC);
+	float bottomY = SampleTerrainHeight(heightMap, bottomTexC);
+	float topY    = SampleTerrainHeight(heightMap, topTexC);
 
 	outTangentW = normalize(float3(2.0f*gTerrainWorldCellSpacing.x, rightY - leftY, 0.0f));
 	outBitangentW = normalize(float3(0.0f, bottomY - topY, -2.0f*gTerrainWorldCellSpacing.y));
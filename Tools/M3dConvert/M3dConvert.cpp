@@ -0,0 +1,60 @@
+//***************************************************************************************
+// M3dConvert.cpp
+//
+// Offline converter from the text .m3d model format to the binary .m3db format
+// described in Common/M3dBinary.h.
+//
+// Usage:
+//   M3dConvert model.m3d [model2.m3d ...]     writes model.m3db next to each input
+//   M3dConvert -o out.m3db model.m3d          writes to an explicit output file
+//***************************************************************************************
+
+#include "../../Common/LoadM3d.h"
+#include "../../Common/M3dBinary.h"
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cout << "Usage: M3dConvert [-o output.m3db] input.m3d [input2.m3d ...]" << std::endl;
+        return 1;
+    }
+
+    std::string explicitOutput;
+    std::vector<std::string> inputs;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "-o" && i + 1 < argc)
+            explicitOutput = argv[++i];
+        else
+            inputs.push_back(arg);
+    }
+
+    if(!explicitOutput.empty() && inputs.size() != 1)
+    {
+        std::cout << "-o can only be used with a single input file." << std::endl;
+        return 1;
+    }
+
+    int numFailed = 0;
+    for(const std::string& input : inputs)
+    {
+        const std::string output = explicitOutput.empty() ? M3dBinary::BinaryFilename(input) : explicitOutput;
+
+        M3DLoader loader;
+        if(!loader.ConvertToBinary(input, output))
+        {
+            std::cout << "FAILED  " << input << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        std::error_code ec;
+        std::cout << "OK      " << input << " (" << std::filesystem::file_size(input, ec) << " bytes) -> "
+                  << output << " (" << std::filesystem::file_size(output, ec) << " bytes)" << std::endl;
+    }
+
+    return numFailed == 0 ? 0 : 1;
+}
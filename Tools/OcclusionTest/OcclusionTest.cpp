@@ -0,0 +1,302 @@
+//***************************************************************************************
+// OcclusionTest.cpp
+//
+// Self-checking tests of OcclusionBuffer.  Only needs DirectXMath and the standard
+// library, so it also builds and runs headless on Linux, e.g.
+//
+//   g++ -std=c++17 -O2 -I<DirectXMath>/Inc OcclusionTest.cpp ../../Common/OcclusionBuffer.cpp
+//
+// with the DirectXMath headers (and a sal.h, as in the DirectX-Headers package).
+// Prints a line per test and exits with 1 if any fails.
+//
+//   pyramid      every texel of a level holds the min and max of the 2x2 below it.
+//   reference    IsOccluded agrees with testing the box's pixels on level 0 alone.
+//   conservative no box reported occluded has a point on the screen that a ray from
+//                the eye reaches before hitting an occluder.
+//   cases        boxes in front, behind, across the near plane and off the screen.
+//***************************************************************************************
+
+#include "../../Common/OcclusionBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const float FovY = 0.25f*XM_PI;
+    const float AspectRatio = 16.0f / 9.0f;
+    const float NearZ = 1.0f;
+    const float FarZ = 500.0f;
+
+    // The twelve triangles of a box, from the corners in BoundingBox::GetCorners order.
+    OccluderMesh BoxOccluder(const BoundingBox& box)
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        box.GetCorners(corners);
+
+        const uint32_t indices[36] =
+        {
+            0, 1, 2,  0, 2, 3,
+            4, 6, 5,  4, 7, 6,
+            0, 4, 5,  0, 5, 1,
+            1, 5, 6,  1, 6, 2,
+            2, 6, 7,  2, 7, 3,
+            3, 7, 4,  3, 4, 0,
+        };
+
+        OccluderMesh mesh;
+        mesh.Build(corners, sizeof(XMFLOAT3), indices, sizeof(uint32_t), 36);
+        return mesh;
+    }
+
+    bool Report(const char* name, uint32_t failures, uint32_t tested)
+    {
+        printf("  %-12s %6u tested  %s", name, tested, failures == 0 ? "ok\n" : "");
+        if(failures != 0)
+            printf("%u FAILED\n", failures);
+
+        return failures == 0;
+    }
+
+    // Level sizes halve, rounding up.
+    void LevelSize(const OcclusionBuffer& buffer, uint32_t level, uint32_t& width, uint32_t& height)
+    {
+        width = buffer.Width();
+        height = buffer.Height();
+        for(uint32_t l = 0; l < level; ++l)
+        {
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+    }
+
+    bool TestPyramid(const OcclusionBuffer& buffer)
+    {
+        uint32_t failures = 0;
+        uint32_t tested = 0;
+        for(uint32_t level = 1; level < buffer.LevelCount(); ++level)
+        {
+            uint32_t childWidth, childHeight, width, height;
+            LevelSize(buffer, level - 1, childWidth, childHeight);
+            LevelSize(buffer, level, width, height);
+
+            for(uint32_t y = 0; y < height; ++y)
+            {
+                for(uint32_t x = 0; x < width; ++x)
+                {
+                    float minDepth = FLT_MAX;
+                    float maxDepth = -FLT_MAX;
+                    for(uint32_t c = 0; c < 4; ++c)
+                    {
+                        const uint32_t cx = std::min(2*x + (c & 1), childWidth - 1);
+                        const uint32_t cy = std::min(2*y + (c >> 1), childHeight - 1);
+                        minDepth = std::min(minDepth, buffer.MinDepth(level - 1, cx, cy));
+                        maxDepth = std::max(maxDepth, buffer.MaxDepth(level - 1, cx, cy));
+                    }
+
+                    if(minDepth != buffer.MinDepth(level, x, y) || maxDepth != buffer.MaxDepth(level, x, y))
+                        failures++;
+                    tested++;
+                }
+            }
+        }
+
+        return Report("pyramid", failures, tested);
+    }
+
+    // IsOccluded without the pyramid: every pixel the box's rectangle reaches, widened
+    // by half a pixel, must hold a nearer depth than the box's nearest.
+    bool OccludedOnLevel0(const OcclusionBuffer& buffer, const BoundingBox& box, FXMMATRIX worldViewProj)
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        box.GetCorners(corners);
+
+        float minX = FLT_MAX, minY = FLT_MAX, nearZ = FLT_MAX;
+        float maxX = -FLT_MAX, maxY = -FLT_MAX;
+        for(const XMFLOAT3& corner : corners)
+        {
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), worldViewProj));
+            if(clip.z < 0.0f)
+                return false;
+
+            const float x = (0.5f + 0.5f*clip.x / clip.w) * buffer.Width();
+            const float y = (0.5f - 0.5f*clip.y / clip.w) * buffer.Height();
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearZ = std::min(nearZ, clip.z / clip.w);
+        }
+
+        if(maxX < 0.0f || maxY < 0.0f || minX >= (float)buffer.Width() || minY >= (float)buffer.Height())
+            return false;
+
+        const uint32_t x0 = (uint32_t)std::max(minX - 0.5f, 0.0f);
+        const uint32_t y0 = (uint32_t)std::max(minY - 0.5f, 0.0f);
+        const uint32_t x1 = (uint32_t)std::min(maxX + 0.5f, (float)(buffer.Width() - 1));
+        const uint32_t y1 = (uint32_t)std::min(maxY + 0.5f, (float)(buffer.Height() - 1));
+        for(uint32_t y = y0; y <= y1; ++y)
+        {
+            for(uint32_t x = x0; x <= x1; ++x)
+            {
+                if(nearZ <= buffer.MaxDepth(0, x, y))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    // True if point is off the screen or the segment from the eye to it passes through
+    // an occluder box.
+    bool PointHidden(FXMVECTOR eye, FXMMATRIX viewProj, const XMFLOAT3& point, const std::vector<BoundingBox>& occluders)
+    {
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&point), viewProj));
+        if(fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w || clip.z < 0.0f || clip.z > clip.w)
+            return true;
+
+        const XMVECTOR toPoint = XMVectorSubtract(XMLoadFloat3(&point), eye);
+        const float length = XMVectorGetX(XMVector3Length(toPoint));
+        const XMVECTOR dir = XMVectorScale(toPoint, 1.0f / length);
+
+        for(const BoundingBox& occluder : occluders)
+        {
+            float dist = 0.0f;
+            if(occluder.Intersects(eye, dir, dist) && dist < length)
+                return true;
+        }
+
+        return false;
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    const XMVECTOR eye = XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f);
+    const XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorSet(6.0f, 1.5f, 20.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const XMMATRIX proj = XMMatrixPerspectiveFovLH(FovY, AspectRatio, NearZ, FarZ);
+    const XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+    // Walls standing around the view, some of them crossing the near plane.  A width
+    // that is not a multiple of four and an odd height exercise the padded and the
+    // rounded up pyramid levels.
+    std::vector<BoundingBox> walls;
+    for(int i = 0; i < 12; ++i)
+    {
+        walls.push_back(BoundingBox(XMFLOAT3((unit(rng) - 0.5f) * 40.0f, 1.5f, unit(rng) * 40.0f - 2.0f),
+            XMFLOAT3(1.0f + 4.0f*unit(rng), 3.0f, 0.3f + 2.0f*unit(rng))));
+    }
+
+    OcclusionBuffer buffer;
+    buffer.Resize(250, 141);
+    buffer.Clear(viewProj);
+    for(const BoundingBox& wall : walls)
+        buffer.DrawOccluder(BoxOccluder(wall), XMMatrixIdentity());
+    buffer.BuildPyramid();
+
+    printf("OcclusionBuffer %ux%u, %u levels, %u occluders\n", buffer.Width(), buffer.Height(),
+        buffer.LevelCount(), (uint32_t)walls.size());
+
+    bool passed = TestPyramid(buffer);
+
+    // Rotated boxes scattered among and behind the walls.
+    const uint32_t boxCount = 50000;
+    std::vector<BoundingBox> boxes(boxCount);
+    std::vector<XMFLOAT4X4> worlds(boxCount);
+    for(uint32_t i = 0; i < boxCount; ++i)
+    {
+        boxes[i] = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.1f + unit(rng), 0.1f + unit(rng), 0.1f + unit(rng)));
+        const XMMATRIX world = XMMatrixRotationY(XM_2PI * unit(rng)) *
+            XMMatrixTranslation((unit(rng) - 0.5f) * 60.0f, (unit(rng) - 0.5f) * 10.0f, unit(rng) * 80.0f);
+        XMStoreFloat4x4(&worlds[i], world);
+    }
+
+    std::vector<uint32_t> occluded;
+    uint32_t referenceFailures = 0;
+    for(uint32_t i = 0; i < boxCount; ++i)
+    {
+        const XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+        const bool isOccluded = buffer.IsOccluded(boxes[i], world);
+        if(isOccluded != OccludedOnLevel0(buffer, boxes[i], XMMatrixMultiply(world, viewProj)))
+            referenceFailures++;
+
+        if(isOccluded)
+            occluded.push_back(i);
+    }
+    passed &= Report("reference", referenceFailures, boxCount);
+
+    // The corners and random points of every occluded box must be hidden.
+    uint32_t conservativeFailures = 0;
+    for(uint32_t i : occluded)
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        boxes[i].GetCorners(corners);
+
+        const XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+        bool hidden = true;
+        for(uint32_t s = 0; s < 32 && hidden; ++s)
+        {
+            const XMFLOAT3& e = boxes[i].Extents;
+            XMFLOAT3 local = s < BoundingBox::CORNER_COUNT ? corners[s] :
+                XMFLOAT3((2.0f*unit(rng) - 1.0f)*e.x, (2.0f*unit(rng) - 1.0f)*e.y, (2.0f*unit(rng) - 1.0f)*e.z);
+
+            XMFLOAT3 point;
+            XMStoreFloat3(&point, XMVector3Transform(XMLoadFloat3(&local), world));
+            hidden = PointHidden(eye, viewProj, point, walls);
+        }
+
+        if(!hidden)
+            conservativeFailures++;
+    }
+    passed &= Report("conservative", conservativeFailures, (uint32_t)occluded.size());
+
+    // A single wall straight ahead of a camera at the origin, wider than the screen.
+    // At twice its distance it hides everything from y = -10 to 10.
+    const XMMATRIX frontView = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
+        XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    buffer.Clear(XMMatrixMultiply(frontView, proj));
+    buffer.DrawOccluder(BoxOccluder(BoundingBox(XMFLOAT3(0.0f, 0.0f, 20.0f), XMFLOAT3(40.0f, 5.0f, 0.5f))), XMMatrixIdentity());
+    buffer.BuildPyramid();
+
+    struct Case
+    {
+        const char* Name;
+        BoundingBox Box;
+        bool Occluded;
+    };
+
+    const Case cases[] =
+    {
+        { "in front of the wall", BoundingBox(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)), false },
+        { "behind the wall", BoundingBox(XMFLOAT3(0.0f, 0.0f, 40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)), true },
+        { "reaching over the wall", BoundingBox(XMFLOAT3(0.0f, 9.5f, 40.0f), XMFLOAT3(1.0f, 2.0f, 1.0f)), false },
+        { "across the near plane", BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.5f), XMFLOAT3(1.0f, 1.0f, 1.0f)), false },
+        { "wholly off the screen", BoundingBox(XMFLOAT3(200.0f, 0.0f, 40.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)), false },
+        { "behind the wall, partly off the screen", BoundingBox(XMFLOAT3(35.0f, 0.0f, 40.0f), XMFLOAT3(10.0f, 1.0f, 1.0f)), true },
+        { "over the wall, partly off the screen", BoundingBox(XMFLOAT3(0.0f, 14.0f, 40.0f), XMFLOAT3(1.0f, 10.0f, 1.0f)), false },
+    };
+
+    uint32_t caseFailures = 0;
+    for(const Case& c : cases)
+    {
+        if(buffer.IsOccluded(c.Box, XMMatrixIdentity()) != c.Occluded)
+        {
+            printf("  box %s should be %s\n", c.Name, c.Occluded ? "occluded" : "visible");
+            caseFailures++;
+        }
+    }
+    passed &= Report("cases", caseFailures, (uint32_t)std::size(cases));
+
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+//***************************************************************************************
+// BenchAnimCompression.cpp
+//
+// Compresses the soldier clips at a few tolerances and reports the bytes saved, the
+// measured error, and what sampling the compressed clip costs compared with the
+// source AnimationClip.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/LoadM3d.h"
+#include "../../Common/AnimationCompression.h"
+
+using namespace DirectX;
+
+bool RunAnimationCompressionBenchmark(const BenchOptions& options)
+{
+    const std::string filename = options.DataRoot + "Models/soldier.m3d";
+
+    std::vector<M3DLoader::SkinnedVertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<M3DLoader::Subset> subsets;
+    std::vector<M3DLoader::M3dMaterial> mats;
+    std::vector<XMFLOAT4X4> boneOffsets;
+    std::vector<int> boneHierarchy;
+    std::unordered_map<std::string, AnimationClip> animations;
+
+    M3DLoader loader;
+    if(!loader.LoadM3dText(filename, vertices, indices, subsets, mats, boneOffsets, boneHierarchy, animations))
+    {
+        printf("failed to load %s\n", filename.c_str());
+        return false;
+    }
+
+    const int numInstances = 256;
+    const int framesPerIteration = 60;
+
+    printf("%-10s %9s %7s %11s %11s %7s %10s %10s %10s %10s %10s\n",
+        "clip", "tolerance", "keys", "src bytes", "comp bytes", "ratio",
+        "max T err", "max S err", "max R err", "src (ms)", "comp (ms)");
+
+    for(const auto& [clipName, clip] : animations)
+    {
+        const UINT numBones = (UINT)clip.BoneAnimations.size();
+        const float startTime = clip.GetClipStartTime();
+        const float duration = clip.GetClipEndTime() - startTime;
+
+        std::vector<XMFLOAT4X4> transforms(numBones);
+
+        auto timeAt = [&](int frame, int instance)
+        {
+            float t = frame * (1.0f / 60.0f) + instance * (duration / numInstances);
+            return startTime + fmodf(t, duration);
+        };
+
+        double sourceMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(int frame = 0; frame < framesPerIteration; ++frame)
+                for(int instance = 0; instance < numInstances; ++instance)
+                    clip.Interpolate(timeAt(frame, instance), transforms);
+        });
+
+        for(float tolerance : { 0.0001f, 0.001f, 0.01f })
+        {
+            AnimationCompressionSettings settings;
+            settings.TranslationTolerance = tolerance;
+            settings.ScaleTolerance = tolerance;
+            settings.RotationTolerance = tolerance;
+
+            CompressedAnimationClip compressed;
+            AnimationCompressionStats stats = compressed.Compress(clip, settings);
+
+            double compressedMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                for(int frame = 0; frame < framesPerIteration; ++frame)
+                    for(int instance = 0; instance < numInstances; ++instance)
+                        compressed.Interpolate(timeAt(frame, instance), transforms.data());
+            });
+
+            printf("%-10s %9g %7u %11zu %11zu %6.1fx %10.2e %10.2e %10.2e %10.3f %10.3f\n",
+                clipName.c_str(), tolerance, stats.CompressedKeyCount,
+                stats.SourceByteSize, stats.CompressedByteSize,
+                (double)stats.SourceByteSize / stats.CompressedByteSize,
+                stats.MaxTranslationError, stats.MaxScaleError, stats.MaxRotationError,
+                sourceMs, compressedMs);
+        }
+    }
+
+    printf("(keys count translation, scale and rotation tracks separately; rotation error is in radians;\n");
+    printf(" times are for %d instances x %d frames)\n", numInstances, framesPerIteration);
+
+    return true;
+}
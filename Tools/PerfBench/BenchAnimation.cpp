@@ -0,0 +1,112 @@
+//***************************************************************************************
+// BenchAnimation.cpp
+//
+// Compares AnimationClip::Interpolate against the SoA CompiledAnimationClip sampler
+// on the soldier clips, and checks that both produce the same bone transforms.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/LoadM3d.h"
+#include "../../Common/AnimationSampler.h"
+
+using namespace DirectX;
+
+bool RunAnimationSampleBenchmark(const BenchOptions& options)
+{
+    const std::string filename = options.DataRoot + "Models/soldier.m3d";
+
+    std::vector<M3DLoader::SkinnedVertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<M3DLoader::Subset> subsets;
+    std::vector<M3DLoader::M3dMaterial> mats;
+    std::vector<XMFLOAT4X4> boneOffsets;
+    std::vector<int> boneHierarchy;
+    std::unordered_map<std::string, AnimationClip> animations;
+
+    M3DLoader loader;
+    if(!loader.LoadM3dText(filename, vertices, indices, subsets, mats, boneOffsets, boneHierarchy, animations))
+    {
+        printf("failed to load %s\n", filename.c_str());
+        return false;
+    }
+
+    // Emulate a crowd: every instance plays the clip at its own time offset.
+    const int numInstances = 256;
+    const int framesPerIteration = 60;
+
+    printf("%-12s %6s %6s %12s %12s %12s %9s %10s  %s\n",
+        "clip", "bones", "keys", "aos (ms)", "soa (ms)", "soa+cursor", "speedup", "max error", "check");
+
+    bool passed = true;
+    for(const auto& [clipName, clip] : animations)
+    {
+        CompiledAnimationClip compiled;
+        compiled.Build(clip);
+
+        const UINT numBones = (UINT)clip.BoneAnimations.size();
+        const float startTime = clip.GetClipStartTime();
+        const float duration = clip.GetClipEndTime() - startTime;
+
+        std::vector<XMFLOAT4X4> reference(numBones);
+        std::vector<XMFLOAT4X4> transforms(numBones);
+        std::vector<AnimationCursor> cursors(numInstances);
+
+        auto timeAt = [&](int frame, int instance)
+        {
+            float t = frame * (1.0f / 60.0f) + instance * (duration / numInstances);
+            return startTime + fmodf(t, duration);
+        };
+
+        // Validate over the same sample times that are timed below.
+        float maxError = 0.0f;
+        for(int frame = 0; frame < framesPerIteration; ++frame)
+        {
+            for(int instance = 0; instance < numInstances; ++instance)
+            {
+                float t = timeAt(frame, instance);
+                clip.Interpolate(t, reference);
+                compiled.Interpolate(t, transforms, &cursors[instance]);
+
+                for(UINT b = 0; b < numBones; ++b)
+                {
+                    for(int i = 0; i < 4; ++i)
+                        for(int j = 0; j < 4; ++j)
+                            maxError = std::max(maxError, fabsf(reference[b].m[i][j] - transforms[b].m[i][j]));
+                }
+            }
+        }
+
+        double aosMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(int frame = 0; frame < framesPerIteration; ++frame)
+                for(int instance = 0; instance < numInstances; ++instance)
+                    clip.Interpolate(timeAt(frame, instance), reference);
+        });
+
+        double soaMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(int frame = 0; frame < framesPerIteration; ++frame)
+                for(int instance = 0; instance < numInstances; ++instance)
+                    compiled.Interpolate(timeAt(frame, instance), transforms);
+        });
+
+        double cursorMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(int frame = 0; frame < framesPerIteration; ++frame)
+                for(int instance = 0; instance < numInstances; ++instance)
+                    compiled.Interpolate(timeAt(frame, instance), transforms, &cursors[instance]);
+        });
+
+        // Both evaluate the same keys, so they only differ by float rounding.
+        const bool same = maxError <= 1e-4f;
+        passed &= same;
+
+        printf("%-12s %6u %6u %12.3f %12.3f %12.3f %8.1fx %10.2e  %s\n",
+            clipName.c_str(), numBones, compiled.KeyframeCount(),
+            aosMs, soaMs, cursorMs, aosMs / cursorMs, maxError, same ? "ok" : "transforms differ");
+    }
+
+    printf("(times are for %d instances x %d frames)\n", numInstances, framesPerIteration);
+
+    return passed;
+}
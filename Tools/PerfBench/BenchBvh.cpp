@@ -0,0 +1,283 @@
+//***************************************************************************************
+// BenchBvh.cpp
+//
+// MeshBvh on the skull and car: build time, node count and SAH cost with 16 and 32-bit
+// indices, then 1M nearest-hit rays from a sphere around each model towards random
+// points in its bounds, against the brute force loop over every triangle the picking
+// demo used before.  Then a SceneBvh over a grid of rotated skulls and cars against a
+// loop over the instances.  A sample of the rays is checked against brute force: the
+// same hits at the same distances, with barycentrics that land on the ray.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshBvh.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    struct Ray
+    {
+        XMFLOAT3 Origin;
+        XMFLOAT3 Dir;
+    };
+
+    // Rays from a sphere twice the size of bounds towards random points within them, so
+    // most hit the box and some miss the mesh.
+    std::vector<Ray> MakeRays(const BoundingBox& bounds, UINT count, UINT seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        const XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        const XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+        const float radius = 2.0f * XMVectorGetX(XMVector3Length(extents));
+
+        std::vector<Ray> rays(count);
+        for(Ray& ray : rays)
+        {
+            XMVECTOR onSphere;
+            do
+            {
+                onSphere = XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+            } while(XMVectorGetX(XMVector3LengthSq(onSphere)) < 1e-4f);
+
+            const XMVECTOR origin = center + radius * XMVector3Normalize(onSphere);
+            const XMVECTOR target = center + extents * XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+            XMStoreFloat3(&ray.Origin, origin);
+            XMStoreFloat3(&ray.Dir, XMVector3Normalize(target - origin));
+        }
+        return rays;
+    }
+
+    // The loop PickingApp::Pick used: every triangle with unit length rays.
+    RayHit BruteForce(const BenchModel& model, FXMVECTOR origin, FXMVECTOR dir)
+    {
+        RayHit hit;
+        for(UINT i = 0; i < (UINT)model.Indices.size() / 3; ++i)
+        {
+            const XMVECTOR v0 = XMLoadFloat3(&model.Positions[model.Indices[i * 3 + 0]]);
+            const XMVECTOR v1 = XMLoadFloat3(&model.Positions[model.Indices[i * 3 + 1]]);
+            const XMVECTOR v2 = XMLoadFloat3(&model.Positions[model.Indices[i * 3 + 2]]);
+
+            float t = 0.0f;
+            if(TriangleTests::Intersects(origin, dir, v0, v1, v2, t) && t < hit.T)
+            {
+                hit.T = t;
+                hit.Triangle = i;
+            }
+        }
+        return hit;
+    }
+
+    // The point the barycentrics of hit give on its triangle.
+    XMVECTOR HitPoint(const BenchModel& model, const RayHit& hit)
+    {
+        const XMVECTOR v0 = XMLoadFloat3(&model.Positions[model.Indices[hit.Triangle * 3 + 0]]);
+        const XMVECTOR v1 = XMLoadFloat3(&model.Positions[model.Indices[hit.Triangle * 3 + 1]]);
+        const XMVECTOR v2 = XMLoadFloat3(&model.Positions[model.Indices[hit.Triangle * 3 + 2]]);
+        return (1.0f - hit.U - hit.V) * v0 + hit.U * v1 + hit.V * v2;
+    }
+
+    // Empty if hit and reference agree within tolerance, which is relative to the size
+    // of the model.  Different triangles at the same distance are fine: rays through an
+    // edge hit both.
+    std::string Compare(const RayHit& hit, const RayHit& reference, FXMVECTOR origin, FXMVECTOR dir,
+                        const BenchModel& model, float tolerance)
+    {
+        if(hit.IsHit() != reference.IsHit())
+            return hit.IsHit() ? "hit that brute force missed" : "missed a brute force hit";
+        if(!hit.IsHit())
+            return "";
+        if(fabsf(hit.T - reference.T) > tolerance)
+            return "nearest hit differs from brute force";
+
+        const XMVECTOR onRay = origin + hit.T * dir;
+        if(XMVectorGetX(XMVector3Length(HitPoint(model, hit) - onRay)) > tolerance)
+            return "barycentrics off the ray";
+        return "";
+    }
+}
+
+bool RunBvhBenchmark(const BenchOptions& options)
+{
+    const UINT rayCount = 1000000;
+    const UINT checkCount = 2000;
+
+    const char* modelNames[] = { "skull.txt", "car.txt" };
+    BenchModel models[_countof(modelNames)];
+    MeshBvh bvhs[_countof(modelNames)];
+
+    printf("  %-10s %5s %9s %9s %8s %7s %10s %10s %10s %8s  %s\n", "model", "index", "tris", "nodes",
+        "build ms", "sah", "Mrays/s", "brute r/s", "speedup", "hit %", "check");
+
+    bool passed = true;
+    for(size_t m = 0; m < _countof(modelNames); ++m)
+    {
+        BenchModel& model = models[m];
+        if(!LoadBenchModel(options, modelNames[m], model))
+        {
+            printf("%s failed to load\n", modelNames[m]);
+            passed = false;
+            continue;
+        }
+
+        std::vector<uint16_t> indices16(model.Indices.begin(), model.Indices.end());
+        const bool fits16 = model.Positions.size() <= 0xffff;
+
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            const bool use16 = pass == 0;
+            if(use16 && !fits16)
+                continue;
+
+            MeshBvh& bvh = bvhs[m];
+            const double buildMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                if(use16)
+                    bvh.Build(model.Positions.data(), sizeof(XMFLOAT3), indices16.data(),
+                        DXGI_FORMAT_R16_UINT, (UINT)indices16.size());
+                else
+                    bvh.Build(model.Positions.data(), sizeof(XMFLOAT3), model.Indices.data(),
+                        DXGI_FORMAT_R32_UINT, (UINT)model.Indices.size());
+            });
+
+            const std::vector<Ray> rays = MakeRays(bvh.GetBounds(), rayCount, 17 + (UINT)m);
+
+            UINT hitCount = 0;
+            BenchTimer timer;
+            for(const Ray& ray : rays)
+            {
+                RayHit hit;
+                if(bvh.Intersect(XMLoadFloat3(&ray.Origin), XMLoadFloat3(&ray.Dir), hit))
+                    ++hitCount;
+            }
+            const double bvhMs = timer.ElapsedMs();
+
+            // Brute force is far too slow for all of them; time and check a sample.
+            std::string check;
+            timer.Reset();
+            std::vector<RayHit> reference(checkCount);
+            for(UINT i = 0; i < checkCount; ++i)
+                reference[i] = BruteForce(model, XMLoadFloat3(&rays[i].Origin), XMLoadFloat3(&rays[i].Dir));
+            const double bruteMs = timer.ElapsedMs();
+
+            const BoundingBox bounds = bvh.GetBounds();
+            const float tolerance = 1e-4f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+            for(UINT i = 0; i < checkCount && check.empty(); ++i)
+            {
+                const XMVECTOR origin = XMLoadFloat3(&rays[i].Origin);
+                const XMVECTOR dir = XMLoadFloat3(&rays[i].Dir);
+
+                RayHit hit;
+                bvh.Intersect(origin, dir, hit);
+                check = Compare(hit, reference[i], origin, dir, model, tolerance);
+            }
+            passed &= check.empty();
+
+            const double raysPerSec = rayCount / (bvhMs / 1000.0);
+            const double bruteRaysPerSec = checkCount / (bruteMs / 1000.0);
+            printf("  %-10s %5s %9u %9u %8.2f %7.2f %10.2f %10.0f %9.0fx %7.1f%%  %s\n", modelNames[m],
+                use16 ? "16" : "32", bvh.TriangleCount(), bvh.NodeCount(), buildMs, bvh.SahCost(),
+                raysPerSec / 1e6, bruteRaysPerSec, raysPerSec / bruteRaysPerSec, 100.0 * hitCount / rayCount,
+                check.empty() ? "ok" : check.c_str());
+        }
+    }
+
+    if(bvhs[0].TriangleCount() == 0 || bvhs[1].TriangleCount() == 0)
+        return passed;
+
+    // A grid of skulls and cars, rotated and scaled, with rays across the whole grid.
+    const UINT gridSize = 16;
+    const float spacing = 20.0f;
+    std::vector<BvhInstance> instances;
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+    std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+    for(UINT z = 0; z < gridSize; ++z)
+    {
+        for(UINT x = 0; x < gridSize; ++x)
+        {
+            const MeshBvh& mesh = bvhs[(x + z) % 2];
+            const BoundingBox bounds = mesh.GetBounds();
+            const float fit = 5.0f / XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+
+            BvhInstance instance;
+            instance.Mesh = &mesh;
+            XMStoreFloat4x4(&instance.World,
+                XMMatrixScaling(fit * scale(rng), fit * scale(rng), fit * scale(rng)) *
+                XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+                XMMatrixTranslation(spacing * x, 0.0f, spacing * z));
+            instances.push_back(instance);
+        }
+    }
+
+    SceneBvh scene;
+    const double sceneBuildMs = TimeAverageMs(options.Iterations, [&]() { scene.Build(instances); });
+
+    const float half = 0.5f * spacing * gridSize;
+    const BoundingBox sceneBounds(XMFLOAT3(half - 0.5f * spacing, 0.0f, half - 0.5f * spacing), XMFLOAT3(half, 8.0f, half));
+    const std::vector<Ray> rays = MakeRays(sceneBounds, rayCount, 29);
+
+    UINT hitCount = 0;
+    BenchTimer timer;
+    for(const Ray& ray : rays)
+    {
+        RayHit hit;
+        if(scene.Intersect(XMLoadFloat3(&ray.Origin), XMLoadFloat3(&ray.Dir), hit))
+            ++hitCount;
+    }
+    const double sceneMs = timer.ElapsedMs();
+
+    // Every instance in turn, each with its own hierarchy.
+    std::vector<XMFLOAT4X4> invWorlds(instances.size());
+    for(size_t i = 0; i < instances.size(); ++i)
+    {
+        const XMMATRIX world = XMLoadFloat4x4(&instances[i].World);
+        XMStoreFloat4x4(&invWorlds[i], XMMatrixInverse(nullptr, world));
+    }
+
+    auto intersectEach = [&](FXMVECTOR origin, FXMVECTOR dir)
+    {
+        RayHit nearest;
+        for(size_t i = 0; i < instances.size(); ++i)
+        {
+            const XMMATRIX invWorld = XMLoadFloat4x4(&invWorlds[i]);
+            if(instances[i].Mesh->Intersect(XMVector3TransformCoord(origin, invWorld),
+                                            XMVector3TransformNormal(dir, invWorld), nearest))
+                nearest.Instance = (UINT)i;
+        }
+        return nearest;
+    };
+
+    timer.Reset();
+    std::string check;
+    const UINT loopCount = rayCount / 10;
+    for(UINT i = 0; i < loopCount; ++i)
+    {
+        const XMVECTOR origin = XMLoadFloat3(&rays[i].Origin);
+        const XMVECTOR dir = XMLoadFloat3(&rays[i].Dir);
+        const RayHit reference = intersectEach(origin, dir);
+
+        if(check.empty())
+        {
+            RayHit hit;
+            scene.Intersect(origin, dir, hit);
+            if(hit.IsHit() != reference.IsHit())
+                check = "scene hit differs from the instance loop";
+            else if(hit.IsHit() && (hit.Instance != reference.Instance || fabsf(hit.T - reference.T) > 1e-3f))
+                check = "scene nearest hit differs from the instance loop";
+        }
+    }
+    const double loopMs = timer.ElapsedMs();
+
+    const double sceneRaysPerSec = rayCount / (sceneMs / 1000.0);
+    const double loopRaysPerSec = loopCount / (loopMs / 1000.0);
+    printf("  scene: %u instances, %u nodes, %.3f ms build, %.2f Mrays/s against %.2f Mrays/s for a loop over "
+        "the instances (%.1fx), %.1f%% hit  %s\n", scene.InstanceCount(), scene.NodeCount(), sceneBuildMs,
+        sceneRaysPerSec / 1e6, loopRaysPerSec / 1e6, sceneRaysPerSec / loopRaysPerSec, 100.0 * hitCount / rayCount,
+        check.empty() ? "ok" : check.c_str());
+
+    return passed && check.empty();
+}
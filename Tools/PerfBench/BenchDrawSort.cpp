@@ -0,0 +1,343 @@
+//***************************************************************************************
+// BenchDrawSort.cpp
+//
+// RenderQueue on a frame of 20K draws: 16 meshes of 4 submeshes each, 64 materials and
+// 8 PSOs, in an opaque layer, a small back to front layer of blended items and a sky.
+// The items are added in a random order, as a culling pass would hand them over.
+//
+// Times building the keys, the radix sort against std::stable_sort on the same keys,
+// the whole Build and Execute into a RecordingDrawSink, and reports the commands
+// recorded against a draw per item with every state set, as DrawRenderItems does,
+// with batching off and on.
+//
+// The recorded commands are replayed: every item must be drawn exactly once with its
+// own geometry, draw arguments, topology and PSO (the instanced one when batched),
+// the layers in order, and the back to front layer farthest first.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/RenderQueue.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const UINT ObjectCBStride = 256;
+    const D3D12_GPU_VIRTUAL_ADDRESS ObjectCBBase = 0x10000000;
+    const D3D12_GPU_VIRTUAL_ADDRESS InstanceDataBase = 0x80000000;
+
+    // The sink never looks through the PSO pointers, so they only need to differ.
+    ID3D12PipelineState* FakePso(UINT i)
+    {
+        return reinterpret_cast<ID3D12PipelineState*>(uintptr_t(0x1000 + 0x100*i));
+    }
+
+    // Records the commands DrawRenderItems makes: buffers, topology and constants for
+    // every item, with the PSO set where it changes.
+    void RecordPerItem(const std::vector<DrawItem>& items, DrawCommandSink& sink)
+    {
+        ID3D12PipelineState* pso = nullptr;
+        for(const DrawItem& item : items)
+        {
+            if(item.Pso != pso)
+            {
+                pso = item.Pso;
+                sink.SetPipelineState(pso);
+            }
+
+            sink.SetGeometry(item.Geo);
+            sink.SetPrimitiveTopology(item.PrimitiveType);
+            sink.SetObjectConstants(item.ObjectCB);
+            sink.DrawIndexedInstanced(item.IndexCount, 1, item.StartIndexLocation, item.BaseVertexLocation);
+        }
+    }
+
+    // Replays the records and returns the number of errors found.
+    UINT CheckRecords(const std::vector<DrawItem>& items, const std::vector<InstanceData>& instanceData,
+        const RecordingDrawSink& sink, UINT backToFrontLayer)
+    {
+        std::vector<UINT> drawCounts(items.size(), 0);
+        UINT errors = 0;
+
+        std::vector<ID3D12PipelineState*> instancedPsos;
+        for(const DrawItem& item : items)
+        {
+            if(item.InstancedPso != nullptr)
+                instancedPsos.push_back(item.InstancedPso);
+        }
+        std::sort(instancedPsos.begin(), instancedPsos.end());
+
+        ID3D12PipelineState* pso = nullptr;
+        const MeshGeometry* geo = nullptr;
+        D3D12_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        D3D12_GPU_VIRTUAL_ADDRESS objectCB = 0;
+        D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = 0;
+
+        UINT layer = 0;
+        float lastDepth = FLT_MAX;
+
+        for(const RecordingDrawSink::Record& record : sink.GetRecords())
+        {
+            switch(record.Type)
+            {
+            case RecordingDrawSink::Command::SetPipelineState:
+                pso = (ID3D12PipelineState*)record.Object;
+                break;
+            case RecordingDrawSink::Command::SetGeometry:
+                geo = (const MeshGeometry*)record.Object;
+                break;
+            case RecordingDrawSink::Command::SetPrimitiveTopology:
+                topology = (D3D12_PRIMITIVE_TOPOLOGY)record.Value;
+                break;
+            case RecordingDrawSink::Command::SetObjectConstants:
+                objectCB = record.Value;
+                break;
+            case RecordingDrawSink::Command::SetInstanceData:
+                instanceAddress = record.Value;
+                break;
+            case RecordingDrawSink::Command::Draw:
+                for(UINT k = 0; k < record.InstanceCount; ++k)
+                {
+                    UINT index = 0;
+                    const bool instanced = std::binary_search(instancedPsos.begin(), instancedPsos.end(), pso);
+                    if(instanced)
+                    {
+                        // Each item's world translation x is its index.
+                        const UINT64 first = (instanceAddress - InstanceDataBase) / sizeof(InstanceData);
+                        index = (UINT)instanceData[first + k].World._14;
+                    }
+                    else
+                    {
+                        index = (UINT)((objectCB - ObjectCBBase) / ObjectCBStride);
+                    }
+
+                    if(index >= items.size())
+                    {
+                        errors++;
+                        continue;
+                    }
+
+                    const DrawItem& item = items[index];
+                    drawCounts[index]++;
+
+                    if(item.Geo != geo || item.PrimitiveType != topology || item.IndexCount != record.IndexCount ||
+                        item.StartIndexLocation != record.StartIndexLocation || item.BaseVertexLocation != record.BaseVertexLocation ||
+                        pso != (instanced ? item.InstancedPso : item.Pso))
+                    {
+                        errors++;
+                    }
+
+                    if(item.Layer < layer)
+                        errors++;
+                    if(item.Layer != layer)
+                        lastDepth = FLT_MAX;
+                    layer = item.Layer;
+
+                    if(item.Layer == backToFrontLayer)
+                    {
+                        if(item.Depth > lastDepth)
+                            errors++;
+                        lastDepth = item.Depth;
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        for(UINT count : drawCounts)
+        {
+            if(count != 1)
+                errors++;
+        }
+
+        return errors;
+    }
+}
+
+bool RunDrawSortBenchmark(const BenchOptions& options)
+{
+    const UINT itemCount = 20000;
+    const UINT meshCount = 16;
+    const UINT submeshCount = 4;
+    const UINT materialCount = 64;
+    const UINT opaquePsoCount = 6;
+    const float farZ = 1000.0f;
+
+    const UINT opaqueLayer = 0;
+    const UINT blendLayer = 1;
+    const UINT skyLayer = 2;
+
+    std::mt19937 rng(25);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<MeshGeometry> meshes(meshCount);
+
+    // Opaque PSOs 0 to 5 with instanced variants, except the last two, which stand in
+    // for alpha tested and tessellated ones; a blended and a sky PSO.
+    ID3D12PipelineState* blendPso = FakePso(2*opaquePsoCount);
+    ID3D12PipelineState* skyPso = FakePso(2*opaquePsoCount + 1);
+
+    std::vector<PerObjectCB> constants(itemCount);
+    std::vector<DrawItem> items(itemCount);
+    for(UINT i = 0; i < itemCount; ++i)
+    {
+        DrawItem& item = items[i];
+
+        const float r = unit(rng);
+        item.Layer = i == 0 ? skyLayer : (r < 0.05f ? blendLayer : opaqueLayer);
+
+        const UINT mesh = std::min((UINT)(meshCount * unit(rng) * unit(rng)), meshCount - 1);
+        const UINT submesh = rng() % submeshCount;
+        item.Geo = &meshes[mesh];
+        item.IndexCount = 600 * (submesh + 1);
+        item.StartIndexLocation = 6000 * submesh;
+        item.BaseVertexLocation = 1000 * submesh;
+
+        if(item.Layer == opaqueLayer)
+        {
+            const UINT pso = std::min((UINT)(opaquePsoCount * unit(rng) * unit(rng)), opaquePsoCount - 1);
+            item.Pso = FakePso(pso);
+            item.InstancedPso = pso < opaquePsoCount - 2 ? FakePso(opaquePsoCount + pso) : nullptr;
+        }
+        else
+        {
+            item.Pso = item.Layer == blendLayer ? blendPso : skyPso;
+        }
+
+        item.MaterialIndex = rng() % materialCount;
+        item.Depth = farZ * unit(rng);
+
+        PerObjectCB& cb = constants[i];
+        XMStoreFloat4x4(&cb.gWorld, XMMatrixTranspose(XMMatrixTranslation((float)i, 0.0f, item.Depth)));
+        cb.gTexTransform = MathHelper::Identity4x4();
+        cb.gMaterialIndex = item.MaterialIndex;
+
+        item.ObjectCB = ObjectCBBase + (D3D12_GPU_VIRTUAL_ADDRESS)i * ObjectCBStride;
+        item.Constants = &cb;
+    }
+
+    // Per item commands in the order the items came in, layer by layer.
+    std::vector<DrawItem> layerOrder;
+    for(UINT layer = opaqueLayer; layer <= skyLayer; ++layer)
+    {
+        for(const DrawItem& item : items)
+        {
+            if(item.Layer == layer)
+                layerOrder.push_back(item);
+        }
+    }
+
+    RecordingDrawSink perItemSink;
+    const double perItemMs = TimeAverageMs(options.Iterations, [&]()
+    {
+        perItemSink.Clear();
+        RecordPerItem(layerOrder, perItemSink);
+    });
+
+    // Adding makes the keys; the frame's keys are then put back in the order added,
+    // to time the sorts alone.
+    RenderQueue keyQueue;
+    keyQueue.SetLayerOrder(blendLayer, DepthOrder::BackToFront);
+    keyQueue.SetDepthRange(farZ);
+
+    const double addMs = TimeAverageMs(options.Iterations, [&]()
+    {
+        keyQueue.Clear();
+        for(const DrawItem& item : items)
+            keyQueue.Add(item);
+    });
+    keyQueue.Build();
+
+    std::vector<DrawSortKey> keys(itemCount);
+    for(UINT p = 0; p < itemCount; ++p)
+    {
+        const DrawSortKey& key = keyQueue.SortedKey(p);
+        keys[key.Item] = key;
+    }
+
+    std::vector<DrawSortKey> sortedKeys;
+    std::vector<DrawSortKey> scratch(itemCount);
+
+    const double radixMs = TimeAverageMs(options.Iterations, [&]()
+    {
+        sortedKeys = keys;
+        RadixSortKeys(sortedKeys.data(), scratch.data(), sortedKeys.size());
+    });
+
+    std::vector<DrawSortKey> stdKeys;
+    const double stdMs = TimeAverageMs(options.Iterations, [&]()
+    {
+        stdKeys = keys;
+        std::stable_sort(stdKeys.begin(), stdKeys.end(), [](const DrawSortKey& a, const DrawSortKey& b)
+        {
+            return a.Key < b.Key;
+        });
+    });
+
+    UINT sortMismatches = 0;
+    for(UINT i = 0; i < itemCount; ++i)
+    {
+        if(sortedKeys[i].Key != stdKeys[i].Key || sortedKeys[i].Item != stdKeys[i].Item)
+            sortMismatches++;
+    }
+
+    printf("  %u items: keys %.1f us, radix sort %.1f us, std::stable_sort %.1f us (%s)\n", itemCount,
+        addMs * 1000.0, radixMs * 1000.0, stdMs * 1000.0, sortMismatches == 0 ? "same order" : "ORDER DIFFERS");
+
+    printf("  %-10s %9s %10s %7s %7s %9s %8s %8s  %s\n", "mode", "build us", "execute us", "draws", "PSOs",
+        "geometry", "topology", "root arg", "check");
+
+    auto printCounts = [](const char* mode, double buildMs, double executeMs, const RecordingDrawSink& sink, const char* check)
+    {
+        using Command = RecordingDrawSink::Command;
+        printf("  %-10s %9.1f %10.1f %7u %7u %9u %8u %8u  %s\n", mode, buildMs * 1000.0, executeMs * 1000.0,
+            sink.CommandCount(Command::Draw), sink.CommandCount(Command::SetPipelineState),
+            sink.CommandCount(Command::SetGeometry), sink.CommandCount(Command::SetPrimitiveTopology),
+            sink.CommandCount(Command::SetObjectConstants) + sink.CommandCount(Command::SetInstanceData), check);
+    };
+
+    const bool perItemPassed = CheckRecords(items, std::vector<InstanceData>(), perItemSink, UINT_MAX) == 0;
+    printCounts("per item", 0.0, perItemMs, perItemSink, perItemPassed ? "ok" : "FAILED");
+
+    bool passed = sortMismatches == 0 && perItemPassed;
+
+    const UINT minBatchSizes[] = { 0, 2 };
+    for(UINT minBatchSize : minBatchSizes)
+    {
+        RenderQueue queue;
+        queue.SetLayerOrder(blendLayer, DepthOrder::BackToFront);
+        queue.SetDepthRange(farZ);
+        queue.SetMinBatchSize(minBatchSize);
+
+        const double buildMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            queue.Clear();
+            for(const DrawItem& item : items)
+                queue.Add(item);
+            queue.Build();
+        });
+
+        RecordingDrawSink sink;
+        const double executeMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            sink.Clear();
+            queue.Execute(sink, InstanceDataBase);
+        });
+
+        const UINT errors = CheckRecords(items, queue.GetInstanceData(), sink, blendLayer);
+
+        char check[64] = "ok";
+        if(errors != 0)
+        {
+            snprintf(check, sizeof(check), "%u errors", errors);
+            passed = false;
+        }
+
+        printCounts(minBatchSize == 0 ? "sorted" : "batched", buildMs, executeMs, sink, check);
+    }
+
+    return passed;
+}
@@ -0,0 +1,410 @@
+//***************************************************************************************
+// BenchFrameJobs.cpp
+//
+// The Update phase of an instancing demo scaled up, as a JobGraph: a material buffer,
+// per object constants, the pass constants, an occlusion buffer and four instanced
+// items of 64K instances that are frustum culled, occlusion tested, given a level of
+// detail and written to an instance buffer.  Upload buffers are plain memory.
+//
+// The serial frame runs the jobs in order and then records a mock command list of a
+// draw per object.  The job frame kicks the graph, records the same command list on
+// the calling thread and then waits, as InstancingAndCullingApp does.  Both are timed
+// on pools of 1, 4, 8 and 16 threads, with each job's time, and the job frame's output
+// must match the serial frame's.  Threads beyond the machine's cores share them, so
+// the speedup only shows on a machine with that many.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/OcclusionBuffer.h"
+#include "../../Common/JobGraph.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    struct BenchObjectConstants
+    {
+        XMFLOAT4X4 World;
+        XMFLOAT4X4 TexTransform;
+        UINT MaterialIndex;
+        UINT Pad[3];
+    };
+
+    struct BenchMaterialData
+    {
+        XMFLOAT4 DiffuseAlbedo;
+        XMFLOAT3 FresnelR0;
+        float Roughness;
+        XMFLOAT4X4 MatTransform;
+    };
+
+    struct BenchPassConstants
+    {
+        XMFLOAT4X4 View;
+        XMFLOAT4X4 InvView;
+        XMFLOAT4X4 Proj;
+        XMFLOAT4X4 InvProj;
+        XMFLOAT4X4 ViewProj;
+        XMFLOAT4X4 InvViewProj;
+    };
+
+    struct BenchInstanceData
+    {
+        XMFLOAT4X4 World;
+        UINT MaterialIndex;
+        UINT Lod;
+        UINT Pad[2];
+    };
+
+    // What a draw would set on a command list.
+    struct BenchDrawCommand
+    {
+        UINT64 ObjectCbAddress;
+        UINT IndexCount;
+        UINT StartIndex;
+    };
+
+    struct BenchInstancedItem
+    {
+        std::vector<XMFLOAT4X4> Worlds;
+        FrustumCuller Culler;
+        std::vector<UINT> Visible;
+        std::vector<uint8_t> Occluded;
+        UINT LodCounts[4] = {};
+        std::vector<BenchInstanceData> InstanceBuffer;
+    };
+
+    class BenchScene
+    {
+    public:
+        static constexpr UINT ItemCount = 4;
+        static constexpr UINT InstancesPerItem = 65536;
+        static constexpr UINT ObjectCount = 20000;
+        static constexpr UINT MaterialCount = 2000;
+        static constexpr UINT OccluderCount = 24;
+
+        BenchScene()
+        {
+            std::mt19937 rng(24);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+            mLocalBox = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+            // Each item is a 64x16x64 block of instances, side by side along x.
+            for(UINT item = 0; item < ItemCount; ++item)
+            {
+                BenchInstancedItem& e = mItems[item];
+                e.Worlds.resize(InstancesPerItem);
+                e.Culler.Resize(InstancesPerItem);
+                e.InstanceBuffer.resize(InstancesPerItem);
+                for(UINT i = 0; i < InstancesPerItem; ++i)
+                {
+                    const float x = (item * 64.0f + (i % 64) - 128.0f) * 4.0f;
+                    const float y = (i / 64 % 16) * 4.0f;
+                    const float z = (i / 1024) * 4.0f + 10.0f;
+                    XMStoreFloat4x4(&e.Worlds[i], XMMatrixRotationY(XM_2PI * unit(rng)) * XMMatrixTranslation(x, y, z));
+                    e.Culler.SetTransformed(i, mLocalBox, XMLoadFloat4x4(&e.Worlds[i]));
+                }
+            }
+
+            mObjectWorlds.resize(ObjectCount);
+            for(XMFLOAT4X4& world : mObjectWorlds)
+            {
+                XMStoreFloat4x4(&world, XMMatrixScaling(1.0f + unit(rng), 1.0f + unit(rng), 1.0f + unit(rng)) *
+                    XMMatrixTranslation(400.0f * (unit(rng) - 0.5f), 0.0f, 400.0f * unit(rng)));
+            }
+            mObjectBuffer.resize(ObjectCount);
+            mMaterialBuffer.resize(MaterialCount);
+
+            // Walls across the view, some way in front of the instances.
+            for(UINT o = 0; o < OccluderCount; ++o)
+            {
+                const BoundingBox wall(XMFLOAT3(((float)o - 0.5f*OccluderCount) * 20.0f, 10.0f, 60.0f + 40.0f * unit(rng)),
+                    XMFLOAT3(6.0f, 10.0f + 20.0f * unit(rng), 1.0f));
+
+                XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+                wall.GetCorners(corners);
+                const uint32_t indices[36] =
+                {
+                    0, 1, 2,  0, 2, 3,  4, 6, 5,  4, 7, 6,  0, 4, 5,  0, 5, 1,
+                    1, 5, 6,  1, 6, 2,  2, 6, 7,  2, 7, 3,  3, 7, 4,  3, 4, 0,
+                };
+                mOccluders.emplace_back();
+                mOccluders.back().Build(corners, sizeof(XMFLOAT3), indices, sizeof(uint32_t), 36);
+            }
+            mOcclusionBuffer.Resize(256, 144);
+
+            mEye = XMFLOAT3(0.0f, 20.0f, -40.0f);
+            const XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&mEye), XMVectorSet(0.0f, 10.0f, 200.0f, 1.0f),
+                XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+            const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.3f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+            XMStoreFloat4x4(&mView, view);
+            XMStoreFloat4x4(&mProj, proj);
+            MathHelper::ExtractFrustumPlanes(XMMatrixMultiply(view, proj), mPlanes);
+
+            mCommands.reserve(ObjectCount);
+        }
+
+        // The jobs of a frame.  Each item's culling waits for the occluders, and its
+        // instance data for its culling.
+        void BuildGraph(JobGraph& graph, TaskPool& pool)
+        {
+            graph.Add("materials", [this]() { UpdateMaterials(); });
+            graph.Add("objects", [this, &pool]() { UpdateObjects(pool); });
+            graph.Add("pass", [this]() { UpdatePass(); });
+            const JobGraph::JobId occluders = graph.Add("occluders", [this]() { DrawOccluders(); });
+
+            for(UINT item = 0; item < ItemCount; ++item)
+            {
+                const JobGraph::JobId cull = graph.Add("cull " + std::to_string(item), [this, item, &pool]() { Cull(item, pool); });
+                graph.AddDependency(cull, occluders);
+
+                const JobGraph::JobId write = graph.Add("instances " + std::to_string(item), [this, item, &pool]() { WriteInstances(item, pool); });
+                graph.AddDependency(write, cull);
+            }
+        }
+
+        // A draw per object.
+        void RecordCommands()
+        {
+            mCommands.clear();
+            for(UINT i = 0; i < ObjectCount; ++i)
+            {
+                BenchDrawCommand command;
+                command.ObjectCbAddress = 0x10000 + (UINT64)i * sizeof(BenchObjectConstants);
+                command.IndexCount = 36 + (i % 7) * 3;
+                command.StartIndex = (i % 13) * 36;
+                mCommands.push_back(command);
+            }
+        }
+
+        // Output of a frame, to compare two frames.
+        bool SameOutput(const BenchScene& other)const
+        {
+            for(UINT item = 0; item < ItemCount; ++item)
+            {
+                const BenchInstancedItem& a = mItems[item];
+                const BenchInstancedItem& b = other.mItems[item];
+                if(a.Visible != b.Visible || memcmp(a.LodCounts, b.LodCounts, sizeof(a.LodCounts)) != 0 ||
+                   memcmp(a.InstanceBuffer.data(), b.InstanceBuffer.data(), a.Visible.size() * sizeof(BenchInstanceData)) != 0)
+                {
+                    return false;
+                }
+            }
+
+            return memcmp(mObjectBuffer.data(), other.mObjectBuffer.data(), mObjectBuffer.size() * sizeof(BenchObjectConstants)) == 0 &&
+                   memcmp(mMaterialBuffer.data(), other.mMaterialBuffer.data(), mMaterialBuffer.size() * sizeof(BenchMaterialData)) == 0 &&
+                   memcmp(&mPass, &other.mPass, sizeof(mPass)) == 0;
+        }
+
+        UINT VisibleCount()const
+        {
+            UINT count = 0;
+            for(const BenchInstancedItem& e : mItems)
+                count += (UINT)e.Visible.size();
+            return count;
+        }
+
+    private:
+        void UpdateMaterials()
+        {
+            for(UINT m = 0; m < MaterialCount; ++m)
+            {
+                BenchMaterialData& data = mMaterialBuffer[m];
+                data.DiffuseAlbedo = XMFLOAT4(0.1f * (m % 10), 0.5f, 0.5f, 1.0f);
+                data.FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
+                data.Roughness = 0.001f * m;
+                XMStoreFloat4x4(&data.MatTransform, XMMatrixTranspose(XMMatrixScaling(1.0f + m, 1.0f, 1.0f)));
+            }
+        }
+
+        void UpdateObjects(TaskPool& pool)
+        {
+            pool.ParallelFor(ObjectCount, 1024, [&](UINT begin, UINT end)
+            {
+                for(UINT i = begin; i < end; ++i)
+                {
+                    BenchObjectConstants& constants = mObjectBuffer[i];
+                    XMStoreFloat4x4(&constants.World, XMMatrixTranspose(XMLoadFloat4x4(&mObjectWorlds[i])));
+                    XMStoreFloat4x4(&constants.TexTransform, XMMatrixTranspose(XMMatrixScaling(2.0f, 2.0f, 1.0f)));
+                    constants.MaterialIndex = i % MaterialCount;
+                }
+            });
+        }
+
+        void UpdatePass()
+        {
+            const XMMATRIX view = XMLoadFloat4x4(&mView);
+            const XMMATRIX proj = XMLoadFloat4x4(&mProj);
+            const XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+            XMStoreFloat4x4(&mPass.View, XMMatrixTranspose(view));
+            XMStoreFloat4x4(&mPass.InvView, XMMatrixTranspose(XMMatrixInverse(nullptr, view)));
+            XMStoreFloat4x4(&mPass.Proj, XMMatrixTranspose(proj));
+            XMStoreFloat4x4(&mPass.InvProj, XMMatrixTranspose(XMMatrixInverse(nullptr, proj)));
+            XMStoreFloat4x4(&mPass.ViewProj, XMMatrixTranspose(viewProj));
+            XMStoreFloat4x4(&mPass.InvViewProj, XMMatrixTranspose(XMMatrixInverse(nullptr, viewProj)));
+        }
+
+        void DrawOccluders()
+        {
+            mOcclusionBuffer.Clear(XMMatrixMultiply(XMLoadFloat4x4(&mView), XMLoadFloat4x4(&mProj)));
+            for(const OccluderMesh& occluder : mOccluders)
+                mOcclusionBuffer.DrawOccluder(occluder, XMMatrixIdentity());
+            mOcclusionBuffer.BuildPyramid();
+        }
+
+        void Cull(UINT item, TaskPool& pool)
+        {
+            BenchInstancedItem& e = mItems[item];
+            e.Culler.Cull(mPlanes, e.Visible, &pool);
+
+            // The occlusion tests in parallel, then the survivors kept in order.
+            e.Occluded.resize(e.Visible.size());
+            pool.ParallelFor((UINT)e.Visible.size(), 1024, [&](UINT begin, UINT end)
+            {
+                for(UINT v = begin; v < end; ++v)
+                    e.Occluded[v] = mOcclusionBuffer.IsOccluded(mLocalBox, XMLoadFloat4x4(&e.Worlds[e.Visible[v]]));
+            });
+
+            UINT kept = 0;
+            for(size_t v = 0; v < e.Visible.size(); ++v)
+            {
+                if(!e.Occluded[v])
+                    e.Visible[kept++] = e.Visible[v];
+            }
+            e.Visible.resize(kept);
+        }
+
+        void WriteInstances(UINT item, TaskPool& pool)
+        {
+            BenchInstancedItem& e = mItems[item];
+
+            // A level per 50 units from the eye, grouped by level as the demo does.
+            std::vector<UINT> lods(e.Visible.size());
+            memset(e.LodCounts, 0, sizeof(e.LodCounts));
+            for(size_t v = 0; v < e.Visible.size(); ++v)
+            {
+                const XMFLOAT4X4& world = e.Worlds[e.Visible[v]];
+                const float dx = world._41 - mEye.x, dy = world._42 - mEye.y, dz = world._43 - mEye.z;
+                lods[v] = std::min((UINT)(sqrtf(dx*dx + dy*dy + dz*dz) / 50.0f), 3u);
+                e.LodCounts[lods[v]]++;
+            }
+
+            UINT offsets[4] = { 0, e.LodCounts[0], e.LodCounts[0] + e.LodCounts[1], e.LodCounts[0] + e.LodCounts[1] + e.LodCounts[2] };
+            std::vector<UINT> slots(e.Visible.size());
+            for(size_t v = 0; v < e.Visible.size(); ++v)
+                slots[v] = offsets[lods[v]]++;
+
+            pool.ParallelFor((UINT)e.Visible.size(), 1024, [&](UINT begin, UINT end)
+            {
+                for(UINT v = begin; v < end; ++v)
+                {
+                    BenchInstanceData& data = e.InstanceBuffer[slots[v]];
+                    XMStoreFloat4x4(&data.World, XMMatrixTranspose(XMLoadFloat4x4(&e.Worlds[e.Visible[v]])));
+                    data.MaterialIndex = e.Visible[v] % MaterialCount;
+                    data.Lod = lods[v];
+                }
+            });
+        }
+
+        BoundingBox mLocalBox;
+        BenchInstancedItem mItems[ItemCount];
+
+        std::vector<XMFLOAT4X4> mObjectWorlds;
+        std::vector<BenchObjectConstants> mObjectBuffer;
+        std::vector<BenchMaterialData> mMaterialBuffer;
+        BenchPassConstants mPass;
+
+        std::vector<OccluderMesh> mOccluders;
+        OcclusionBuffer mOcclusionBuffer;
+
+        XMFLOAT3 mEye;
+        XMFLOAT4X4 mView;
+        XMFLOAT4X4 mProj;
+        XMFLOAT4 mPlanes[6];
+
+        std::vector<BenchDrawCommand> mCommands;
+    };
+}
+
+bool RunFrameJobsBenchmark(const BenchOptions& options)
+{
+    // The serial frame on one thread, as the reference for output and time.
+    auto serialScene = std::make_unique<BenchScene>();
+    TaskPool serialPool(1);
+    JobGraph serialGraph;
+    serialScene->BuildGraph(serialGraph, serialPool);
+
+    const double serialUpdateMs = TimeAverageMs(options.Iterations, [&]() { serialGraph.Run(serialPool); });
+    const double serialRecordMs = TimeAverageMs(options.Iterations, [&]() { serialScene->RecordCommands(); });
+    const double serialFrameMs = serialUpdateMs + serialRecordMs;
+
+    printf("  %u objects, %u instances, %u visible, %u hardware threads\n", BenchScene::ObjectCount,
+        BenchScene::ItemCount * BenchScene::InstancesPerItem, serialScene->VisibleCount(), std::thread::hardware_concurrency());
+    printf("  %-8s %9s %9s %9s %8s  %s\n", "threads", "frame ms", "jobs ms", "record ms", "speedup", "check");
+    printf("  %-8s %9.3f %9.3f %9.3f %7.2fx  %s\n", "serial", serialFrameMs, serialUpdateMs, serialRecordMs, 1.0, "ok");
+
+    // Average time of every job, per pool size.
+    const UINT threadCounts[] = { 1, 4, 8, 16 };
+    std::vector<std::string> jobNames;
+    std::vector<std::vector<double>> jobMs;
+
+    bool passed = true;
+    for(UINT threadCount : threadCounts)
+    {
+        auto scene = std::make_unique<BenchScene>();
+        TaskPool pool(threadCount);
+        JobGraph graph;
+        scene->BuildGraph(graph, pool);
+
+        std::vector<double> jobTotals(graph.JobCount(), 0.0);
+        double jobsMs = 0.0;
+        double recordMs = 0.0;
+        const double frameMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            BenchTimer timer;
+            graph.Kick(pool);
+            scene->RecordCommands();
+            recordMs += timer.ElapsedMs();
+            graph.Wait();
+
+            jobsMs += graph.RunMs();
+            for(UINT job = 0; job < graph.JobCount(); ++job)
+                jobTotals[job] += graph.GetTiming(job).EndMs - graph.GetTiming(job).StartMs;
+        });
+
+        for(double& total : jobTotals)
+            total /= options.Iterations;
+        jobMs.push_back(jobTotals);
+
+        jobNames.clear();
+        for(UINT job = 0; job < graph.JobCount(); ++job)
+            jobNames.push_back(graph.JobName(job));
+
+        const bool sameOutput = scene->SameOutput(*serialScene);
+        passed &= sameOutput;
+
+        char name[16];
+        snprintf(name, sizeof(name), "%u", threadCount);
+        printf("  %-8s %9.3f %9.3f %9.3f %7.2fx  %s\n", name, frameMs, jobsMs / options.Iterations,
+            recordMs / options.Iterations, serialFrameMs / frameMs, sameOutput ? "ok" : "output differs");
+    }
+
+    printf("\n  %-12s", "job ms");
+    for(UINT threadCount : threadCounts)
+        printf(" %8u", threadCount);
+    printf("\n");
+
+    for(size_t job = 0; job < jobNames.size(); ++job)
+    {
+        printf("  %-12s", jobNames[job].c_str());
+        for(const std::vector<double>& times : jobMs)
+            printf(" %8.3f", times[job]);
+        printf("\n");
+    }
+
+    return passed;
+}
@@ -0,0 +1,174 @@
+//***************************************************************************************
+// BenchFrustumCull.cpp
+//
+// Frustum culling of 1M instances on a 100x100x100 grid, with random rotations and
+// scales, seen from outside the grid.  The per-instance path the instancing demo used
+// to take, which inverts every world matrix and transforms the view space
+// BoundingFrustum into the instance's local space, is timed on a sample.  The
+// FrustumCuller tests the world space bounds against the world space planes on one
+// thread and on the TaskPool; both must give the indices of a scalar test of the same
+// bounds, and must keep every instance the per-instance path keeps.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/TaskPool.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // Scalar box and sphere test of the world space bounds of one instance.
+    bool ReferenceVisible(const XMFLOAT4 planes[6], const BoundingBox& box, float radius)
+    {
+        for(int p = 0; p < 6; ++p)
+        {
+            const XMFLOAT4& n = planes[p];
+            const float s = n.x*box.Center.x + n.y*box.Center.y + n.z*box.Center.z + n.w;
+            const float r = fabsf(n.x)*box.Extents.x + fabsf(n.y)*box.Extents.y + fabsf(n.z)*box.Extents.z;
+            if(s + std::min(r, radius) < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+bool RunFrustumCullBenchmark(const BenchOptions& options)
+{
+    const UINT gridSize = 100;
+    const UINT instanceCount = gridSize * gridSize * gridSize;
+    const float spacing = 4.0f;
+
+    // About the skull's bounds.
+    const BoundingBox localBox(XMFLOAT3(0.0f, 0.2f, 0.0f), XMFLOAT3(1.0f, 1.2f, 0.8f));
+
+    std::mt19937 rng(41);
+    std::uniform_real_distribution<float> angle(-MathHelper::Pi, MathHelper::Pi);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    std::vector<XMFLOAT4X4> worlds(instanceCount);
+    for(UINT i = 0; i < instanceCount; ++i)
+    {
+        const float x = ((i % gridSize) - 0.5f*gridSize) * spacing;
+        const float y = ((i / gridSize % gridSize) - 0.5f*gridSize) * spacing;
+        const float z = ((i / (gridSize*gridSize)) - 0.5f*gridSize) * spacing;
+
+        const XMMATRIX world = XMMatrixScaling(scale(rng), scale(rng), scale(rng)) *
+            XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+            XMMatrixTranslation(x, y, z);
+        XMStoreFloat4x4(&worlds[i], world);
+    }
+
+    // From outside the grid, looking at its center, as in the instancing demo.
+    const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(60.0f, 40.0f, -320.0f, 1.0f), XMVectorZero(),
+        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+    XMFLOAT4 planes[6];
+    MathHelper::ExtractFrustumPlanes(XMMatrixMultiply(view, proj), planes);
+
+    FrustumCuller culler;
+    const double setupMs = TimeAverageMs(1, [&]()
+    {
+        culler.Resize(instanceCount);
+        for(UINT i = 0; i < instanceCount; ++i)
+            culler.SetTransformed(i, localBox, XMLoadFloat4x4(&worlds[i]));
+    });
+
+    // Every sampleStride-th instance through the per-instance path.
+    const UINT sampleStride = 16;
+    BoundingFrustum viewFrustum;
+    BoundingFrustum::CreateFromMatrix(viewFrustum, proj);
+    const XMMATRIX invView = XMMatrixInverse(nullptr, view);
+
+    std::vector<UINT> transformVisible;
+    const double transformMs = TimeAverageMs(1, [&]()
+    {
+        transformVisible.clear();
+        for(UINT i = 0; i < instanceCount; i += sampleStride)
+        {
+            const XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+            const XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+
+            BoundingFrustum localFrustum;
+            viewFrustum.Transform(localFrustum, XMMatrixMultiply(invView, invWorld));
+            if(localFrustum.Contains(localBox) != DISJOINT)
+                transformVisible.push_back(i);
+        }
+    });
+    const UINT sampleCount = (instanceCount + sampleStride - 1) / sampleStride;
+
+    TaskPool serial(1);
+    std::vector<UINT> serialVisible;
+    std::vector<UINT> poolVisible;
+    const double serialMs = TimeAverageMs(options.Iterations, [&]() { culler.Cull(planes, serialVisible, &serial); });
+    const double poolMs = TimeAverageMs(options.Iterations, [&]() { culler.Cull(planes, poolVisible, &TaskPool::Default()); });
+
+    // The same bounds one at a time.
+    std::vector<UINT> referenceVisible;
+    for(UINT i = 0; i < instanceCount; ++i)
+    {
+        const XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+
+        // The box around the transformed corners, which is the one SetTransformed works
+        // out from the matrix up to rounding.
+        BoundingBox box;
+        localBox.Transform(box, world);
+
+        const XMVECTOR extents = XMLoadFloat3(&localBox.Extents);
+        const float maxScale = sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(world.r[0])),
+            std::max(XMVectorGetX(XMVector3LengthSq(world.r[1])), XMVectorGetX(XMVector3LengthSq(world.r[2])))));
+        const float radius = XMVectorGetX(XMVector3Length(extents)) * maxScale;
+
+        if(ReferenceVisible(planes, box, radius))
+            referenceVisible.push_back(i);
+    }
+
+    std::string check;
+    if(serialVisible != poolVisible)
+        check = "pool differs from one thread";
+
+    // Count differences from the reference; only instances that touch a plane, where the
+    // corner box and the rotated box round differently, may differ.
+    UINT referenceDiffs = 0;
+    {
+        size_t a = 0, b = 0;
+        while(a < serialVisible.size() || b < referenceVisible.size())
+        {
+            if(b == referenceVisible.size() || (a < serialVisible.size() && serialVisible[a] < referenceVisible[b]))
+                ++a, ++referenceDiffs;
+            else if(a == serialVisible.size() || referenceVisible[b] < serialVisible[a])
+                ++b, ++referenceDiffs;
+            else
+                ++a, ++b;
+        }
+    }
+    if(referenceDiffs > instanceCount / 10000 && check.empty())
+        check = "culler differs from the scalar test";
+
+    // The planes test is conservative, so it keeps everything the exact test keeps.
+    for(UINT i : transformVisible)
+    {
+        if(!std::binary_search(serialVisible.begin(), serialVisible.end(), i) && check.empty())
+        {
+            check = "culler drops an instance the per-instance test keeps";
+            break;
+        }
+    }
+
+    printf("  %u instances, %u threads, bounds set up in %.2f ms\n", instanceCount, TaskPool::Default().ThreadCount(), setupMs);
+    printf("  %-24s %10s %12s %10s\n", "method", "ms", "ns/instance", "visible %");
+    printf("  %-24s %10.2f %12.2f %9.1f%%  (1 in %u sampled)\n", "transform frustum", transformMs * sampleStride,
+        transformMs * 1e6 / sampleCount, 100.0 * transformVisible.size() / sampleCount, sampleStride);
+    printf("  %-24s %10.3f %12.2f %9.1f%%\n", "culler, 1 thread", serialMs,
+        serialMs * 1e6 / instanceCount, 100.0 * serialVisible.size() / instanceCount);
+    printf("  %-24s %10.3f %12.2f %9.1f%%\n", "culler, pool", poolMs,
+        poolMs * 1e6 / instanceCount, 100.0 * poolVisible.size() / instanceCount);
+    printf("  speedup %.1fx on 1 thread, %.1fx on the pool; %u differ from the scalar test  %s\n",
+        transformMs * sampleStride / serialMs, transformMs * sampleStride / poolMs, referenceDiffs,
+        check.empty() ? "ok" : check.c_str());
+
+    return check.empty();
+}
@@ -0,0 +1,284 @@
+//***************************************************************************************
+// BenchLod.cpp
+//
+// MeshSimplifier on the shipped models: triangles and error of each generated level of
+// detail, the distance of the source surface to each level measured at sampled source
+// vertices, and the time to generate the chain.  Then the instancing demo's grid of
+// skulls from its start camera: how many instances land on each level and how many
+// triangles that saves for a few pixel error thresholds.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/Camera.h"
+
+using namespace DirectX;
+
+namespace
+{
+    float DistanceToTriangle(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c)
+    {
+        // Closest point by Voronoi region, from Ericson's Real-Time Collision Detection.
+        XMVECTOR ab = b - a;
+        XMVECTOR ac = c - a;
+        XMVECTOR ap = p - a;
+        const float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+        const float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+        if(d1 <= 0.0f && d2 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(ap));
+
+        XMVECTOR bp = p - b;
+        const float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+        const float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+        if(d3 >= 0.0f && d4 <= d3)
+            return XMVectorGetX(XMVector3Length(bp));
+
+        const float vc = d1*d4 - d3*d2;
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (a + ab*(d1 / (d1 - d3)))));
+
+        XMVECTOR cp = p - c;
+        const float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+        const float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+        if(d6 >= 0.0f && d5 <= d6)
+            return XMVectorGetX(XMVector3Length(cp));
+
+        const float vb = d5*d2 - d1*d6;
+        if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (a + ac*(d2 / (d2 - d6)))));
+
+        const float va = d3*d6 - d5*d4;
+        if(va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return XMVectorGetX(XMVector3Length(p - (b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6))))));
+
+        const float denom = 1.0f / (va + vb + vc);
+        return XMVectorGetX(XMVector3Length(p - (a + ab*(vb*denom) + ac*(vc*denom))));
+    }
+
+    // Largest and average distance from a sample of the source vertices to the level.
+    void MeasureDeviation(const BenchModel& model, const uint32_t* indices, UINT indexCount, float& maxDistance, float& averageDistance)
+    {
+        const UINT vertexCount = (UINT)model.Positions.size();
+        const UINT step = std::max(vertexCount / 1000, 1u);
+
+        maxDistance = 0.0f;
+        averageDistance = 0.0f;
+        UINT samples = 0;
+        for(UINT v = 0; v < vertexCount; v += step)
+        {
+            XMVECTOR p = XMLoadFloat3(&model.Positions[v]);
+            float nearest = FLT_MAX;
+            for(UINT i = 0; i < indexCount; i += 3)
+            {
+                nearest = std::min(nearest, DistanceToTriangle(p,
+                    XMLoadFloat3(&model.Positions[indices[i]]),
+                    XMLoadFloat3(&model.Positions[indices[i + 1]]),
+                    XMLoadFloat3(&model.Positions[indices[i + 2]])));
+            }
+
+            maxDistance = std::max(maxDistance, nearest);
+            averageDistance += nearest;
+            samples++;
+        }
+
+        averageDistance /= std::max(samples, 1u);
+    }
+
+    MeshGeometry MakeGeometry(const BenchModel& model)
+    {
+        MeshGeometry geo;
+        geo.VertexByteStride = sizeof(XMFLOAT3);
+        geo.VertexBufferByteSize = (UINT)model.Positions.size()*sizeof(XMFLOAT3);
+        geo.VertexBufferCPU.resize(geo.VertexBufferByteSize);
+        memcpy(geo.VertexBufferCPU.data(), model.Positions.data(), geo.VertexBufferByteSize);
+        geo.IndexFormat = DXGI_FORMAT_R32_UINT;
+        geo.IndexBufferByteSize = (UINT)model.Indices.size()*sizeof(uint32_t);
+        geo.IndexBufferCPU.resize(geo.IndexBufferByteSize);
+        memcpy(geo.IndexBufferCPU.data(), model.Indices.data(), geo.IndexBufferByteSize);
+
+        XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+        XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+        for(const XMFLOAT3& p : model.Positions)
+        {
+            vMin = XMVectorMin(vMin, XMLoadFloat3(&p));
+            vMax = XMVectorMax(vMax, XMLoadFloat3(&p));
+        }
+
+        SubmeshGeometry submesh;
+        submesh.IndexCount = (UINT)model.Indices.size();
+        submesh.VertexCount = (UINT)model.Positions.size();
+        XMStoreFloat3(&submesh.Bounds.Center, 0.5f*(vMin + vMax));
+        XMStoreFloat3(&submesh.Bounds.Extents, 0.5f*(vMax - vMin));
+        geo.DrawArgs["model"] = submesh;
+
+        return geo;
+    }
+
+    // Returns an empty string if the chain is valid, else what is wrong.
+    std::string Validate(const MeshGeometry& geo, UINT levelCount, UINT vertexCount)
+    {
+        const uint32_t* indices = reinterpret_cast<const uint32_t*>(geo.IndexBufferCPU.data());
+        const SubmeshGeometry* previous = &geo.DrawArgs.at("model");
+        for(UINT level = 1; level <= levelCount; ++level)
+        {
+            const SubmeshGeometry& lod = geo.DrawArgs.at(MeshSimplifier::LodName("model", level));
+            if(lod.IndexCount % 3 != 0 || lod.IndexCount >= previous->IndexCount)
+                return "level does not shrink";
+            if(lod.LodError < previous->LodError)
+                return "error decreases";
+            if((size_t)(lod.StartIndexLocation + lod.IndexCount)*sizeof(uint32_t) > geo.IndexBufferCPU.size())
+                return "level outside the index buffer";
+
+            for(UINT i = 0; i < lod.IndexCount; i += 3)
+            {
+                const uint32_t* tri = indices + lod.StartIndexLocation + i;
+                if(tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+                    return "index out of range";
+                if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+                    return "degenerate triangle";
+            }
+
+            previous = &lod;
+        }
+
+        return "";
+    }
+
+    void RunInstanceGrid(const BenchOptions& options)
+    {
+        BenchModel skull;
+        if(!LoadBenchModel(options, "skull.txt", skull))
+            return;
+
+        MeshOptimizer::Optimize(skull.Positions.data(), (UINT)skull.Positions.size(), sizeof(XMFLOAT3),
+                                skull.Indices.data(), (UINT)skull.Indices.size());
+
+        MeshGeometry geo = MakeGeometry(skull);
+        const UINT levelCount = MeshSimplifier::GenerateLods(geo, "model", 5);
+
+        std::vector<const SubmeshGeometry*> lods;
+        for(UINT level = 0; level <= levelCount; ++level)
+            lods.push_back(&geo.DrawArgs[MeshSimplifier::LodName("model", level)]);
+
+        // The instancing demo: a 15^3 grid over 200 units, seen from its start camera
+        // on a 1280x720 viewport.
+        const int n = 15;
+        const float spacing = 200.0f / (n - 1);
+        std::vector<XMFLOAT4X4> worlds;
+        for(int k = 0; k < n; ++k)
+            for(int i = 0; i < n; ++i)
+                for(int j = 0; j < n; ++j)
+                    XMStoreFloat4x4(&worlds.emplace_back(), XMMatrixTranslation(-100.0f + j*spacing, -100.0f + i*spacing, -100.0f + k*spacing));
+
+        Camera camera;
+        camera.SetLens(0.25f*MathHelper::Pi, 1280.0f / 720.0f, 1.0f, 1000.0f);
+        camera.SetPosition(0.0f, 2.0f, -14.0f);
+        camera.UpdateViewMatrix();
+
+        const UINT fullTriangles = lods[0]->IndexCount / 3*(UINT)worlds.size();
+        printf("skull grid, %u instances, %u triangles at full detail\n", (UINT)worlds.size(), fullTriangles);
+        printf("  %-8s", "pixels");
+        for(UINT level = 0; level <= levelCount; ++level)
+            printf(" %7s%u", "lod", level);
+        printf(" %12s %8s %10s\n", "triangles", "saved", "ns/select");
+
+        for(float pixels : { 0.5f, 1.0f, 2.0f, 4.0f })
+        {
+            std::vector<UINT> counts(levelCount + 1, 0);
+            for(const XMFLOAT4X4& world : worlds)
+                counts[MeshSimplifier::SelectLod(lods, XMLoadFloat4x4(&world), camera, 720.0f, pixels)]++;
+
+            UINT sink = 0;
+            double ms = TimeAverageMs(options.Iterations, [&]()
+            {
+                for(const XMFLOAT4X4& world : worlds)
+                    sink += MeshSimplifier::SelectLod(lods, XMLoadFloat4x4(&world), camera, 720.0f, pixels);
+            });
+
+            UINT triangles = 0;
+            printf("  %-8.2f", pixels);
+            for(UINT level = 0; level <= levelCount; ++level)
+            {
+                printf(" %8u", counts[level]);
+                triangles += counts[level]*(lods[level]->IndexCount / 3);
+            }
+            printf(" %12u %7.1f%% %10.1f%s\n", triangles, 100.0f*(1.0f - (float)triangles / fullTriangles),
+                1e6*ms / worlds.size(), sink == 0xFFFFFFFF ? " " : "");
+        }
+    }
+}
+
+bool RunLodBenchmark(const BenchOptions& options)
+{
+    const char* modelNames[] =
+    {
+        "skull.txt",
+        "car.txt",
+        "columnRound.m3d",
+        "columnRoundBroken.m3d",
+        "columnSquare.m3d",
+        "columnSquareBroken.m3d",
+        "soldier.m3d",
+    };
+
+    const UINT lodCount = 6;
+
+    bool passed = true;
+    for(const char* modelName : modelNames)
+    {
+        BenchModel model;
+        if(!LoadBenchModel(options, modelName, model))
+        {
+            printf("%s failed to load\n", modelName);
+            passed = false;
+            continue;
+        }
+
+        const UINT vertexCount = (UINT)model.Positions.size();
+        MeshOptimizer::Optimize(model.Positions.data(), vertexCount, sizeof(XMFLOAT3),
+                                model.Indices.data(), (UINT)model.Indices.size());
+
+        const MeshGeometry source = MakeGeometry(model);
+        const BoundingBox& bounds = source.DrawArgs.at("model").Bounds;
+        const float extent = 2.0f*std::max(std::max(bounds.Extents.x, bounds.Extents.y), bounds.Extents.z);
+
+        MeshGeometry geo;
+        UINT levelCount = 0;
+        double ms = TimeAverageMs(options.Iterations, [&]()
+        {
+            geo = source;
+            levelCount = MeshSimplifier::GenerateLods(geo, "model", lodCount);
+        });
+
+        const std::string error = Validate(geo, levelCount, vertexCount);
+
+        printf("%s: %u vertices, %u levels in %.2f ms, %s\n", modelName, vertexCount, levelCount, ms,
+            error.empty() ? "ok" : error.c_str());
+        passed &= error.empty();
+        printf("  %-6s %10s %8s %10s %10s %10s\n", "level", "triangles", "kept", "error", "max dist", "avg dist");
+
+        for(UINT level = 0; level <= levelCount; ++level)
+        {
+            const SubmeshGeometry& lod = geo.DrawArgs.at(MeshSimplifier::LodName("model", level));
+            const uint32_t* indices = reinterpret_cast<const uint32_t*>(geo.IndexBufferCPU.data()) + lod.StartIndexLocation;
+
+            float maxDistance = 0.0f;
+            float averageDistance = 0.0f;
+            MeasureDeviation(model, indices, lod.IndexCount, maxDistance, averageDistance);
+
+            // The sampled distance can not exceed the error SelectLod relies on.
+            const bool covered = maxDistance <= lod.LodError + 1e-5f*extent;
+            passed &= covered;
+
+            // Errors as a percentage of the model's extent.
+            printf("  %-6u %10u %7.1f%% %9.3f%% %9.3f%% %9.3f%%%s\n", level, lod.IndexCount / 3,
+                100.0f*lod.IndexCount / model.Indices.size(), 100.0f*lod.LodError / extent,
+                100.0f*maxDistance / extent, 100.0f*averageDistance / extent,
+                covered ? "" : " error below max dist");
+        }
+    }
+
+    RunInstanceGrid(options);
+    return passed;
+}
@@ -0,0 +1,151 @@
+//***************************************************************************************
+// BenchMeshGen.cpp
+//
+// MeshGen at high tessellation: geospheres at 5 to 8 subdivisions, and large spheres,
+// cylinders and grids, on one thread and on the TaskPool.  The geosphere is also
+// built with the previous subdivision, which copied the mesh every level and gave
+// each face its own six vertices; it is kept below as the reference.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshGen.h"
+#include "../../Common/TaskPool.h"
+
+using namespace DirectX;
+
+namespace
+{
+    MeshGenVertex ReferenceMidPoint(const MeshGenVertex& v0, const MeshGenVertex& v1)
+    {
+        MeshGenVertex v;
+        XMStoreFloat3(&v.Position, 0.5f*(XMLoadFloat3(&v0.Position) + XMLoadFloat3(&v1.Position)));
+        XMStoreFloat3(&v.Normal, XMVector3Normalize(0.5f*(XMLoadFloat3(&v0.Normal) + XMLoadFloat3(&v1.Normal))));
+        XMStoreFloat3(&v.TangentU, XMVector3Normalize(0.5f*(XMLoadFloat3(&v0.TangentU) + XMLoadFloat3(&v1.TangentU))));
+        XMStoreFloat2(&v.TexC, 0.5f*(XMLoadFloat2(&v0.TexC) + XMLoadFloat2(&v1.TexC)));
+        return v;
+    }
+
+    void ReferenceSubdivide(MeshGenData& meshData)
+    {
+        MeshGenData inputCopy = meshData;
+
+        meshData.Vertices.resize(0);
+        meshData.Indices32.resize(0);
+
+        uint32_t numTris = (uint32_t)inputCopy.Indices32.size()/3;
+        for(uint32_t i = 0; i < numTris; ++i)
+        {
+            MeshGenVertex v0 = inputCopy.Vertices[inputCopy.Indices32[i*3+0]];
+            MeshGenVertex v1 = inputCopy.Vertices[inputCopy.Indices32[i*3+1]];
+            MeshGenVertex v2 = inputCopy.Vertices[inputCopy.Indices32[i*3+2]];
+
+            meshData.Vertices.push_back(v0);
+            meshData.Vertices.push_back(v1);
+            meshData.Vertices.push_back(v2);
+            meshData.Vertices.push_back(ReferenceMidPoint(v0, v1));
+            meshData.Vertices.push_back(ReferenceMidPoint(v1, v2));
+            meshData.Vertices.push_back(ReferenceMidPoint(v0, v2));
+
+            const uint32_t tris[12] = { 0,3,5, 3,4,5, 5,4,2, 3,1,4 };
+            for(uint32_t k : tris)
+                meshData.Indices32.push_back(i*6 + k);
+        }
+    }
+
+    // The previous CreateGeosphere: per-face subdivision, then a serial projection.
+    MeshGenData ReferenceGeosphere(float radius, uint32_t numSubdivisions)
+    {
+        // Twelve vertices and twenty faces of the icosahedron.
+        MeshGenData icosahedron = MeshGen().CreateGeosphere(1.0f, 0);
+
+        MeshGenData meshData;
+        meshData.Indices32 = icosahedron.Indices32;
+        meshData.Vertices.resize(icosahedron.Vertices.size());
+        for(size_t i = 0; i < icosahedron.Vertices.size(); ++i)
+            meshData.Vertices[i].Position = icosahedron.Vertices[i].Position;
+
+        for(uint32_t i = 0; i < numSubdivisions; ++i)
+            ReferenceSubdivide(meshData);
+
+        for(MeshGenVertex& v : meshData.Vertices)
+        {
+            XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&v.Position));
+            XMStoreFloat3(&v.Position, radius*n);
+            XMStoreFloat3(&v.Normal, n);
+
+            float theta = atan2f(v.Position.z, v.Position.x);
+            if(theta < 0.0f)
+                theta += XM_2PI;
+            float phi = acosf(v.Position.y / radius);
+
+            v.TexC = XMFLOAT2(theta/XM_2PI, phi/XM_PI);
+            v.TangentU = XMFLOAT3(-radius*sinf(phi)*sinf(theta), 0.0f, +radius*sinf(phi)*cosf(theta));
+            XMStoreFloat3(&v.TangentU, XMVector3Normalize(XMLoadFloat3(&v.TangentU)));
+        }
+
+        return meshData;
+    }
+
+    void PrintRow(const char* name, const MeshGenData& mesh, double referenceMs, double serialMs, double poolMs)
+    {
+        char reference[32] = "-";
+        if(referenceMs > 0.0)
+            snprintf(reference, sizeof(reference), "%.2f", referenceMs);
+
+        printf("%-22s %10zu %10zu %12s %12.2f %12.2f\n", name, mesh.Vertices.size(), mesh.Indices32.size()/3,
+            reference, serialMs, poolMs);
+    }
+}
+
+bool RunMeshGenBenchmark(const BenchOptions& options)
+{
+    MeshGen meshGen;
+    TaskPool serialPool(1);
+    TaskPool& pool = TaskPool::Default();
+
+    printf("%u threads\n", pool.ThreadCount());
+    printf("%-22s %10s %10s %12s %12s %12s\n", "mesh", "vertices", "triangles", "previous ms", "1 thread ms", "pool ms");
+
+    for(uint32_t subdivisions = 5; subdivisions <= MeshGen::MaxGeosphereSubdivisions; ++subdivisions)
+    {
+        MeshGenData mesh;
+
+        // The reference is slow and large at the top levels.
+        double referenceMs = 0.0;
+        if(subdivisions <= 7)
+        {
+            size_t referenceVertexCount = 0;
+            referenceMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                referenceVertexCount = ReferenceGeosphere(1.0f, subdivisions).Vertices.size();
+            });
+
+            printf("%-22s %10zu\n", "  previous", referenceVertexCount);
+        }
+
+        double serialMs = TimeAverageMs(options.Iterations, [&]() { mesh = meshGen.CreateGeosphere(1.0f, subdivisions, &serialPool); });
+        double poolMs = TimeAverageMs(options.Iterations, [&]() { mesh = meshGen.CreateGeosphere(1.0f, subdivisions, &pool); });
+
+        char name[32];
+        snprintf(name, sizeof(name), "geosphere %u", subdivisions);
+        PrintRow(name, mesh, referenceMs, serialMs, poolMs);
+    }
+
+    auto run = [&](const char* name, const auto& create)
+    {
+        MeshGenData mesh;
+        double serialMs = TimeAverageMs(options.Iterations, [&]() { mesh = create(&serialPool); });
+        double poolMs = TimeAverageMs(options.Iterations, [&]() { mesh = create(&pool); });
+        PrintRow(name, mesh, 0.0, serialMs, poolMs);
+
+        double boundsSerialMs = TimeAverageMs(options.Iterations, [&]() { mesh.ComputeBounds(&serialPool); });
+        double boundsPoolMs = TimeAverageMs(options.Iterations, [&]() { mesh.ComputeBounds(&pool); });
+        PrintRow("  bounds", mesh, 0.0, boundsSerialMs, boundsPoolMs);
+    };
+
+    run("sphere 1024x512", [&](TaskPool* p) { return meshGen.CreateSphere(1.0f, 1024, 512, p); });
+    run("cylinder 1024x512", [&](TaskPool* p) { return meshGen.CreateCylinder(1.0f, 0.5f, 2.0f, 1024, 512, p); });
+    run("grid 2048x2048", [&](TaskPool* p) { return meshGen.CreateGrid(100.0f, 100.0f, 2048, 2048, p); });
+
+    return true;
+}
@@ -0,0 +1,125 @@
+//***************************************************************************************
+// BenchMeshOpt.cpp
+//
+// MeshOptimizer on the shipped models: ACMR, ATVR, vertex overfetch and overdraw of the
+// authored order, of Tipsify alone, of Tipsify with overdraw clustering and of Forsyth,
+// and the time each pass takes.  Each optimized mesh is checked to draw the same
+// triangles, with the same winding, as the authored one, to have no higher ACMR than
+// it, and overdraw clustering to stay within its threshold of Tipsify's ACMR.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshOptimizer.h"
+#include <array>
+
+using namespace DirectX;
+
+namespace
+{
+    void PrintRow(const char* name, const MeshOptimizerStats& stats, double ms, const char* check)
+    {
+        char time[32] = "-";
+        if(ms > 0.0)
+            snprintf(time, sizeof(time), "%.2f", ms);
+
+        printf("  %-14s %8.3f %8.3f %10.3f %9.3f %10s  %s\n", name, stats.Acmr, stats.Atvr, stats.Overfetch,
+            stats.Overdraw, time, check);
+    }
+
+    // The triangles by their corner positions, each started at its smallest corner so
+    // that the winding is kept, in sorted order.
+    std::vector<std::array<float, 9>> SortedTriangles(const BenchModel& model)
+    {
+        std::vector<std::array<float, 9>> triangles(model.Indices.size() / 3);
+        for(size_t t = 0; t < triangles.size(); ++t)
+        {
+            std::array<float, 3> corners[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                const XMFLOAT3& p = model.Positions[model.Indices[3*t + k]];
+                corners[k] = { p.x, p.y, p.z };
+            }
+
+            const int first = (int)(std::min_element(corners, corners + 3) - corners);
+            for(int k = 0; k < 3; ++k)
+                std::copy(corners[(first + k) % 3].begin(), corners[(first + k) % 3].end(), triangles[t].begin() + 3*k);
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+}
+
+bool RunMeshOptimizerBenchmark(const BenchOptions& options)
+{
+    const char* modelNames[] =
+    {
+        "skull.txt",
+        "car.txt",
+        "columnRound.m3d",
+        "columnRoundBroken.m3d",
+        "columnSquare.m3d",
+        "columnSquareBroken.m3d",
+    };
+
+    MeshOptimizerSettings tipsifyOnly;
+    tipsifyOnly.OverdrawThreshold = 1.0f;
+    MeshOptimizerSettings tipsify;
+    MeshOptimizerSettings forsyth;
+    forsyth.Algorithm = MeshOptimizerSettings::CacheAlgorithm::Forsyth;
+
+    printf("cache size %u, overdraw threshold %.2f\n", tipsify.CacheSize, tipsify.OverdrawThreshold);
+    printf("  %-14s %8s %8s %10s %9s %10s  %s\n", "order", "ACMR", "ATVR", "overfetch", "overdraw", "ms", "check");
+
+    bool passed = true;
+    for(const char* modelName : modelNames)
+    {
+        BenchModel mesh;
+        if(!LoadBenchModel(options, modelName, mesh))
+        {
+            printf("%s failed to load\n", modelName);
+            passed = false;
+            continue;
+        }
+
+        const UINT vertexCount = (UINT)mesh.Positions.size();
+        const UINT indexCount = (UINT)mesh.Indices.size();
+        printf("%s: %u vertices, %u triangles\n", modelName, vertexCount, indexCount / 3);
+
+        auto analyze = [&](const BenchModel& m)
+        {
+            return MeshOptimizer::Analyze(m.Positions.data(), vertexCount, sizeof(XMFLOAT3), m.Indices.data(), indexCount);
+        };
+
+        const MeshOptimizerStats authoredStats = analyze(mesh);
+        PrintRow("authored", authoredStats, 0.0, "-");
+        const std::vector<std::array<float, 9>> authored = SortedTriangles(mesh);
+
+        float tipsifyOnlyAcmr = 0.0f;
+        for(const MeshOptimizerSettings* settings : { &tipsifyOnly, &tipsify, &forsyth })
+        {
+            BenchModel optimized;
+            double ms = TimeAverageMs(options.Iterations, [&]()
+            {
+                optimized = mesh;
+                MeshOptimizer::Optimize(optimized.Positions.data(), vertexCount, sizeof(XMFLOAT3),
+                                        optimized.Indices.data(), indexCount, *settings);
+            });
+
+            const MeshOptimizerStats stats = analyze(optimized);
+            if(settings == &tipsifyOnly)
+                tipsifyOnlyAcmr = stats.Acmr;
+
+            const bool same = SortedTriangles(optimized) == authored;
+            const bool bounded = settings != &tipsify || stats.Acmr <= tipsify.OverdrawThreshold*tipsifyOnlyAcmr + 1e-6f;
+            const bool improved = stats.Acmr <= authoredStats.Acmr + 1e-6f;
+            passed &= same && bounded && improved;
+
+            const char* name = settings == &tipsifyOnly ? "tipsify only" : (settings == &tipsify ? "tipsify" : "forsyth");
+            PrintRow(name, stats, ms, !same ? "triangles differ" :
+                (!bounded ? "ACMR over threshold" : (!improved ? "ACMR above authored" : "ok")));
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,215 @@
+//***************************************************************************************
+// BenchMeshlets.cpp
+//
+// MeshletBuilder on the shipped models, in the vertex cache order the loaders upload
+// them in: build time, meshlet fill, vertex duplication, bounding sphere size and how
+// much the normal cones cull, for a few vertex/primitive limits.  Every build is
+// checked: each triangle is in exactly one meshlet, the limits hold, the spheres
+// contain their vertices, no meshlet with a front facing triangle is cone culled, and
+// the saved file reads back identical.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshletBuilder.h"
+#include "../../Common/MeshOptimizer.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // Returns an empty string if the meshlets are valid, else what is wrong.
+    std::string Validate(const MeshletGeometry& meshlets, const BenchModel& model, const MeshletSettings& settings)
+    {
+        const UINT triangleCount = (UINT)model.Indices.size() / 3;
+
+        // Triangles by their sorted vertices, so each must come up exactly once.
+        auto key = [](UINT a, UINT b, UINT c)
+        {
+            if(a > b) std::swap(a, b);
+            if(b > c) std::swap(b, c);
+            if(a > b) std::swap(a, b);
+            return ((uint64_t)a << 42) | ((uint64_t)b << 21) | c;
+        };
+
+        std::vector<uint64_t> expected(triangleCount);
+        for(UINT t = 0; t < triangleCount; ++t)
+            expected[t] = key(model.Indices[t*3], model.Indices[t*3 + 1], model.Indices[t*3 + 2]);
+
+        std::vector<uint64_t> found;
+        found.reserve(triangleCount);
+
+        const XMFLOAT3 directions[6] =
+        {
+            { +1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+            { 0.0f, +1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+            { 0.0f, 0.0f, +1.0f }, { 0.0f, 0.0f, -1.0f },
+        };
+
+        for(size_t m = 0; m < meshlets.Meshlets.size(); ++m)
+        {
+            const Meshlet& meshlet = meshlets.Meshlets[m];
+            const MeshletCullData& cull = meshlets.CullData[m];
+            if(meshlet.VertexCount > settings.MaxVertices || meshlet.PrimitiveCount > settings.MaxPrimitives)
+                return "meshlet over the limits";
+
+            XMVECTOR center = XMLoadFloat4(&cull.BoundingSphere);
+            XMVECTOR axis = XMLoadFloat4(&cull.NormalCone);
+            XMVECTOR apex = XMLoadFloat3(&cull.ConeApex);
+            for(UINT i = 0; i < meshlet.VertexCount; ++i)
+            {
+                XMVECTOR p = XMLoadFloat3(&model.Positions[meshlets.VertexIndices[meshlet.VertexOffset + i]]);
+                if(XMVectorGetX(XMVector3Length(XMVectorSetW(p - center, 0.0f))) > cull.BoundingSphere.w*1.0001f + 1e-5f)
+                    return "vertex outside the bounding sphere";
+            }
+
+            for(UINT i = 0; i < meshlet.PrimitiveCount; ++i)
+            {
+                const uint32_t packed = meshlets.PrimitiveIndices[meshlet.PrimitiveOffset + i];
+                const UINT local[3] = { packed & 0x3FF, (packed >> 10) & 0x3FF, (packed >> 20) & 0x3FF };
+                UINT v[3];
+                for(UINT c = 0; c < 3; ++c)
+                {
+                    if(local[c] >= meshlet.VertexCount)
+                        return "primitive index out of range";
+                    v[c] = meshlets.VertexIndices[meshlet.VertexOffset + local[c]];
+                }
+
+                found.push_back(key(v[0], v[1], v[2]));
+
+                // If the cone culls the meshlet, this triangle must face away from
+                // the eye, here taken at a few spots around the apex.
+                XMVECTOR p0 = XMLoadFloat3(&model.Positions[v[0]]);
+                XMVECTOR p1 = XMLoadFloat3(&model.Positions[v[1]]);
+                XMVECTOR p2 = XMLoadFloat3(&model.Positions[v[2]]);
+                XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+                for(const XMFLOAT3& direction : directions)
+                {
+                    XMVECTOR eye = apex + 100.0f*cull.BoundingSphere.w*XMLoadFloat3(&direction);
+                    const bool culled = XMVectorGetX(XMVector3Dot(XMVector3Normalize(apex - eye), axis)) >= cull.NormalCone.w;
+
+                    // Edge on triangles of flat meshlets are culled within rounding.
+                    const float facing = XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), XMVector3Normalize(p0 - eye)));
+                    if(culled && facing < -1e-4f)
+                        return "normal cone culls a front facing triangle";
+                }
+            }
+        }
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        if(expected != found)
+            return "triangles missing or repeated";
+
+        return "";
+    }
+
+    bool SameMeshlets(const MeshletGeometry& a, const MeshletGeometry& b)
+    {
+        auto same = [](const auto& x, const auto& y)
+        {
+            return x.size() == y.size() && memcmp(x.data(), y.data(), x.size()*sizeof(x[0])) == 0;
+        };
+
+        return same(a.Meshlets, b.Meshlets) && same(a.CullData, b.CullData) &&
+               same(a.VertexIndices, b.VertexIndices) && same(a.PrimitiveIndices, b.PrimitiveIndices) &&
+               a.DrawArgs.size() == b.DrawArgs.size();
+    }
+}
+
+bool RunMeshletBenchmark(const BenchOptions& options)
+{
+    const char* modelNames[] =
+    {
+        "skull.txt",
+        "car.txt",
+        "columnRound.m3d",
+        "columnRoundBroken.m3d",
+        "columnSquare.m3d",
+        "columnSquareBroken.m3d",
+        "soldier.m3d",
+    };
+
+    const UINT limits[][2] = { { 64, 126 }, { 128, 256 }, { 256, 256 } };
+
+    printf("  %-10s %8s %8s %8s %8s %8s %8s %8s %8s %8s  %s\n", "limits", "meshlets", "verts", "prims",
+        "v fill", "p fill", "dup", "radius", "cone cull", "ms", "check");
+
+    bool passed = true;
+    for(const char* modelName : modelNames)
+    {
+        BenchModel model;
+        if(!LoadBenchModel(options, modelName, model))
+        {
+            printf("%s failed to load\n", modelName);
+            passed = false;
+            continue;
+        }
+
+        const UINT vertexCount = (UINT)model.Positions.size();
+        const UINT indexCount = (UINT)model.Indices.size();
+        MeshOptimizer::Optimize(model.Positions.data(), vertexCount, sizeof(XMFLOAT3), model.Indices.data(), indexCount);
+
+        printf("%s: %u vertices, %u triangles\n", modelName, vertexCount, indexCount / 3);
+
+        MeshGeometry geo;
+        geo.Name = modelName;
+        geo.VertexByteStride = sizeof(XMFLOAT3);
+        geo.VertexBufferByteSize = vertexCount*sizeof(XMFLOAT3);
+        geo.VertexBufferCPU.resize(geo.VertexBufferByteSize);
+        memcpy(geo.VertexBufferCPU.data(), model.Positions.data(), geo.VertexBufferByteSize);
+        geo.IndexFormat = DXGI_FORMAT_R32_UINT;
+        geo.IndexBufferByteSize = indexCount*sizeof(uint32_t);
+        geo.IndexBufferCPU.resize(geo.IndexBufferByteSize);
+        memcpy(geo.IndexBufferCPU.data(), model.Indices.data(), geo.IndexBufferByteSize);
+
+        SubmeshGeometry submesh;
+        submesh.IndexCount = indexCount;
+        submesh.VertexCount = vertexCount;
+        geo.DrawArgs["model"] = submesh;
+
+        const uint64_t sourceHash = MeshletBuilder::HashSource(geo);
+
+        for(const auto& limit : limits)
+        {
+            MeshletSettings settings;
+            settings.MaxVertices = limit[0];
+            settings.MaxPrimitives = limit[1];
+
+            MeshletGeometry meshlets;
+            double ms = TimeAverageMs(options.Iterations, [&]()
+            {
+                meshlets = MeshletBuilder::Build(geo, 0, settings);
+            });
+
+            std::string error = Validate(meshlets, model, settings);
+
+            // Round trip through a file, which must refuse other settings.
+            const std::string filename = (std::filesystem::temp_directory_path() / "PerfBench.meshlets").string();
+            MeshletGeometry readBack;
+            MeshletSettings otherSettings = settings;
+            otherSettings.MaxPrimitives--;
+            if(error.empty() &&
+               (!MeshletBuilder::Write(filename, meshlets, sourceHash, settings) ||
+                !MeshletBuilder::Read(filename, readBack, sourceHash, settings) ||
+                !SameMeshlets(meshlets, readBack) ||
+                MeshletBuilder::Read(filename, readBack, sourceHash, otherSettings) ||
+                MeshletBuilder::Read(filename, readBack, sourceHash + 1, settings)))
+            {
+                error = "file round trip failed";
+            }
+            std::filesystem::remove(filename);
+
+            const MeshletStats stats = MeshletBuilder::Analyze(meshlets, settings);
+
+            char name[32];
+            snprintf(name, sizeof(name), "%u/%u", settings.MaxVertices, settings.MaxPrimitives);
+            printf("  %-10s %8u %8.1f %8.1f %8.3f %8.3f %8.3f %8.3f %9.3f %8.2f  %s\n", name, stats.MeshletCount,
+                stats.AverageVertices, stats.AveragePrimitives, stats.VertexFill, stats.PrimitiveFill,
+                stats.VertexDuplication, stats.AverageRadius, stats.ConeCullRate, ms,
+                error.empty() ? "ok" : error.c_str());
+            passed &= error.empty();
+        }
+    }
+
+    return passed;
+}
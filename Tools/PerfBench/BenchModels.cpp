@@ -0,0 +1,118 @@
+//***************************************************************************************
+// BenchModels.cpp
+//
+// Loads the geometry of the shipped models for the mesh processing benchmarks.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/LoadM3d.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // The skull.txt/car.txt format: counts, then "pos normal" vertices, then triangles.
+    bool LoadTextModel(const std::string& filename, BenchModel& model)
+    {
+        std::ifstream fin(filename);
+        if(!fin)
+            return false;
+
+        UINT vcount = 0;
+        UINT tcount = 0;
+        std::string ignore;
+
+        fin >> ignore >> vcount;
+        fin >> ignore >> tcount;
+        fin >> ignore >> ignore >> ignore >> ignore;
+
+        model.Positions.resize(vcount);
+        model.Vertices.resize(vcount);
+        for(UINT i = 0; i < vcount; ++i)
+        {
+            ModelVertex& v = model.Vertices[i];
+            fin >> v.Pos.x >> v.Pos.y >> v.Pos.z;
+            fin >> v.Normal.x >> v.Normal.y >> v.Normal.z;
+            model.Positions[i] = v.Pos;
+        }
+
+        fin >> ignore >> ignore >> ignore;
+
+        model.Indices.resize(3 * tcount);
+        for(UINT i = 0; i < 3 * tcount; ++i)
+            fin >> model.Indices[i];
+
+        M3DLoader::Subset subset;
+        subset.Id = 0;
+        subset.VertexCount = vcount;
+        subset.FaceCount = tcount;
+        model.Subsets.assign(1, subset);
+
+        return !fin.fail();
+    }
+
+    template<typename VertexT>
+    bool LoadM3dModel(const std::string& filename, BenchModel& model, std::vector<VertexT>& vertices)
+    {
+        std::vector<M3DLoader::Subset>& subsets = model.Subsets;
+        std::vector<M3DLoader::M3dMaterial> mats;
+
+        M3DLoader loader;
+        bool loaded = false;
+        if constexpr(std::is_same_v<VertexT, M3DLoader::SkinnedVertex>)
+        {
+            SkinnedData skinInfo;
+            loaded = loader.LoadM3d(filename, vertices, model.Indices, subsets, mats, skinInfo);
+        }
+        else
+        {
+            loaded = loader.LoadM3d(filename, vertices, model.Indices, subsets, mats);
+        }
+
+        if(!loaded)
+            return false;
+
+        model.Positions.resize(vertices.size());
+        for(size_t i = 0; i < vertices.size(); ++i)
+            model.Positions[i] = vertices[i].Pos;
+
+        return true;
+    }
+}
+
+bool LoadBenchModel(const BenchOptions& options, const std::string& modelName, BenchModel& model)
+{
+    const std::string filename = options.DataRoot + "Models/" + modelName;
+    const std::string extension = std::filesystem::path(filename).extension().string();
+
+    if(extension == ".txt")
+        return LoadTextModel(filename, model);
+
+    // "***************m3d-File-Header***************", then "#Materials N" and so on.
+    std::ifstream fin(filename);
+    std::string ignore;
+    UINT numBones = 0;
+    fin >> ignore >> ignore >> ignore >> ignore >> ignore >> ignore >> ignore >> ignore >> numBones;
+    if(!fin)
+        return false;
+
+    if(numBones == 0)
+    {
+        std::vector<M3DLoader::Vertex> vertices;
+        if(!LoadM3dModel(filename, model, vertices))
+            return false;
+
+        model.Vertices.resize(vertices.size());
+        for(size_t i = 0; i < vertices.size(); ++i)
+        {
+            model.Vertices[i].Pos = vertices[i].Pos;
+            model.Vertices[i].Normal = vertices[i].Normal;
+            model.Vertices[i].TexC = vertices[i].TexC;
+            model.Vertices[i].TangentU = XMFLOAT3(vertices[i].TangentU.x, vertices[i].TangentU.y, vertices[i].TangentU.z);
+        }
+
+        return true;
+    }
+
+    return LoadM3dModel(filename, model, model.SkinnedVertices);
+}
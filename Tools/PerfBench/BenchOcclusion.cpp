@@ -0,0 +1,212 @@
+//***************************************************************************************
+// BenchOcclusion.cpp
+//
+// OcclusionBuffer on a street level view of a city: rows of buildings are the
+// occluders and 100K small boxes are scattered among and behind them.  Times clearing
+// and drawing the occluders, building the pyramid and testing the boxes at a few
+// buffer sizes, and reports how many boxes in the frustum were found occluded.
+//
+// Every box reported occluded is checked: rays from the eye to those of its corners
+// and of random points inside it that are on the screen must hit a building first.  The buffer is conservative, so any box
+// that fails the check is a bug.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/OcclusionBuffer.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // The twelve triangles of a box, from the corners in BoundingBox::GetCorners order.
+    OccluderMesh BoxOccluder(const BoundingBox& box)
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        box.GetCorners(corners);
+
+        const uint32_t indices[36] =
+        {
+            0, 1, 2,  0, 2, 3,
+            4, 6, 5,  4, 7, 6,
+            0, 4, 5,  0, 5, 1,
+            1, 5, 6,  1, 6, 2,
+            2, 6, 7,  2, 7, 3,
+            3, 7, 4,  3, 4, 0,
+        };
+
+        OccluderMesh mesh;
+        mesh.Build(corners, sizeof(XMFLOAT3), indices, sizeof(uint32_t), 36);
+        return mesh;
+    }
+
+    bool BoxInFrustum(const XMFLOAT4 planes[6], const BoundingBox& box)
+    {
+        for(int p = 0; p < 6; ++p)
+        {
+            const XMFLOAT4& n = planes[p];
+            const float s = n.x*box.Center.x + n.y*box.Center.y + n.z*box.Center.z + n.w;
+            const float r = fabsf(n.x)*box.Extents.x + fabsf(n.y)*box.Extents.y + fabsf(n.z)*box.Extents.z;
+            if(s + r < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+
+    // True if point is off the screen or the segment from the eye to it passes through
+    // a building.
+    bool PointHidden(FXMVECTOR eye, FXMMATRIX viewProj, const XMFLOAT3& point, const std::vector<BoundingBox>& buildings)
+    {
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&point), viewProj));
+        if(fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w || clip.z < 0.0f || clip.z > clip.w)
+            return true;
+
+        const XMVECTOR toPoint = XMVectorSubtract(XMLoadFloat3(&point), eye);
+        const float length = XMVectorGetX(XMVector3Length(toPoint));
+        const XMVECTOR dir = XMVectorScale(toPoint, 1.0f / length);
+
+        for(const BoundingBox& building : buildings)
+        {
+            float dist = 0.0f;
+            if(building.Intersects(eye, dir, dist) && dist < length)
+                return true;
+        }
+
+        return false;
+    }
+}
+
+bool RunOcclusionBenchmark(const BenchOptions& options)
+{
+    const UINT boxCount = 100000;
+    const UINT samplesPerBox = 16;
+    const float farZ = 500.0f;
+
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Blocks of buildings 20 units apart along both sides of the street the camera
+    // looks down, and across it further on.
+    std::vector<BoundingBox> buildings;
+    for(int row = 0; row < 12; ++row)
+    {
+        for(int side = -1; side <= 1; side += 2)
+        {
+            const float height = 10.0f + 30.0f * unit(rng);
+            buildings.push_back(BoundingBox(XMFLOAT3(side * 14.0f, 0.5f*height, 20.0f + row * 20.0f),
+                XMFLOAT3(8.0f, 0.5f*height, 8.0f)));
+        }
+    }
+    for(int block = -3; block <= 3; ++block)
+        buildings.push_back(BoundingBox(XMFLOAT3(block * 24.0f, 15.0f, 120.0f), XMFLOAT3(10.0f, 15.0f, 6.0f)));
+
+    std::vector<OccluderMesh> occluders;
+    for(const BoundingBox& building : buildings)
+        occluders.push_back(BoxOccluder(building));
+
+    // Objects of 0.5 to 3 units on the ground over the whole city, with their own
+    // rotations, so their boxes are tested through a world matrix.
+    std::vector<BoundingBox> boxes(boxCount);
+    std::vector<XMFLOAT4X4> worlds(boxCount);
+    const BoundingBox localBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+    for(UINT i = 0; i < boxCount; ++i)
+    {
+        const float scale = 0.25f + 1.25f * unit(rng);
+        const XMMATRIX world = XMMatrixScaling(scale, scale, scale) * XMMatrixRotationY(XM_2PI * unit(rng)) *
+            XMMatrixTranslation((unit(rng) - 0.5f) * 200.0f, scale + 4.0f * unit(rng), 5.0f + unit(rng) * 295.0f);
+        XMStoreFloat4x4(&worlds[i], world);
+        localBox.Transform(boxes[i], world);
+    }
+
+    const XMVECTOR eye = XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f);
+    const XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorSet(4.0f, 4.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, farZ);
+    const XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+    XMFLOAT4 planes[6];
+    MathHelper::ExtractFrustumPlanes(viewProj, planes);
+
+    std::vector<UINT> inFrustum;
+    for(UINT i = 0; i < boxCount; ++i)
+    {
+        if(BoxInFrustum(planes, boxes[i]))
+            inFrustum.push_back(i);
+    }
+
+    printf("  %u occluders, %u triangles, %u of %u boxes in the frustum\n", (UINT)occluders.size(),
+        (UINT)occluders.size() * 12, (UINT)inFrustum.size(), boxCount);
+    printf("  %-9s %6s %9s %10s %10s %10s %9s  %s\n", "buffer", "levels", "draw us", "pyramid us", "test ns",
+        "occluded", "culled", "check");
+
+    bool passed = true;
+    const UINT sizes[][2] = { { 128, 72 }, { 256, 144 }, { 512, 288 } };
+    for(const auto& size : sizes)
+    {
+        OcclusionBuffer buffer;
+        buffer.Resize(size[0], size[1]);
+
+        const double drawMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            buffer.Clear(viewProj);
+            for(const OccluderMesh& occluder : occluders)
+                buffer.DrawOccluder(occluder, XMMatrixIdentity());
+        });
+
+        const double pyramidMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            buffer.BuildPyramid();
+        });
+
+        std::vector<UINT> occluded;
+        const double testMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            occluded.clear();
+            for(UINT i : inFrustum)
+            {
+                if(buffer.IsOccluded(localBox, XMLoadFloat4x4(&worlds[i])))
+                    occluded.push_back(i);
+            }
+        });
+
+        // The corners and random points of every occluded box that are on the screen must
+        // be behind a building.
+        UINT falseCount = 0;
+        XMFLOAT3 localCorners[BoundingBox::CORNER_COUNT];
+        localBox.GetCorners(localCorners);
+        for(UINT i : occluded)
+        {
+            const XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+            bool hidden = true;
+            for(UINT s = 0; s < samplesPerBox && hidden; ++s)
+            {
+                XMFLOAT3 local = s < BoundingBox::CORNER_COUNT ? localCorners[s] :
+                    XMFLOAT3(2.0f*unit(rng) - 1.0f, 2.0f*unit(rng) - 1.0f, 2.0f*unit(rng) - 1.0f);
+
+                XMFLOAT3 point;
+                XMStoreFloat3(&point, XMVector3Transform(XMLoadFloat3(&local), world));
+                hidden = PointHidden(eye, viewProj, point, buildings);
+            }
+
+            if(!hidden)
+                falseCount++;
+        }
+
+        char bufferName[32];
+        snprintf(bufferName, sizeof(bufferName), "%ux%u", buffer.Width(), buffer.Height());
+
+        char check[64] = "ok";
+        if(falseCount != 0)
+        {
+            snprintf(check, sizeof(check), "%u boxes wrongly occluded", falseCount);
+            passed = false;
+        }
+
+        printf("  %-9s %6u %9.1f %10.1f %10.1f %10u %8.1f%%  %s\n", bufferName, buffer.LevelCount(), drawMs * 1000.0,
+            pyramidMs * 1000.0, testMs * 1e6 / std::max((UINT)inFrustum.size(), 1u), (UINT)occluded.size(),
+            100.0 * occluded.size() / std::max((UINT)inFrustum.size(), 1u), check);
+    }
+
+    return passed;
+}
@@ -0,0 +1,134 @@
+//***************************************************************************************
+// BenchPoseBlend.cpp
+//
+// Poses a crowd of soldiers from stacks of animation layers: the plain clip, an
+// upper body override layer and an additive layer on top.  Layers are combined as
+// local poses, so the matrices are built once per instance however many layers
+// there are.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/LoadM3d.h"
+#include "../../Common/TaskPool.h"
+
+using namespace DirectX;
+
+bool RunPoseBlendBenchmark(const BenchOptions& options)
+{
+    const std::string filename = options.DataRoot + "Models/soldier.m3d";
+
+    std::vector<M3DLoader::SkinnedVertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<M3DLoader::Subset> subsets;
+    std::vector<M3DLoader::M3dMaterial> mats;
+    SkinnedData skinInfo;
+
+    M3DLoader loader;
+    if(!loader.LoadM3d(filename, vertices, indices, subsets, mats, skinInfo))
+    {
+        printf("failed to load %s\n", filename.c_str());
+        return false;
+    }
+
+    const AnimationClipHandle clip = skinInfo.FindClip("Take1");
+    if(clip == InvalidAnimationClip)
+    {
+        printf("%s has no clip named Take1\n", filename.c_str());
+        return false;
+    }
+
+    const UINT numBones = skinInfo.BoneCount();
+    const float duration = skinInfo.GetClipEndTime(clip);
+
+    // The soldier only has one clip, so layer it against itself at other times.
+    // The additive clip stores the motion relative to the first frame.
+    const AnimationClipHandle additiveClip = skinInfo.MakeAdditiveClip("Take1Additive", clip, clip, 0.0f);
+
+    // Upper body mask: everything below the first child of the root.
+    BoneMask upperBody;
+    upperBody.Resize(numBones, 0.0f);
+    const std::vector<int>& hierarchy = skinInfo.GetBoneHierarchy();
+    for(UINT i = 1; i < numBones; ++i)
+    {
+        if(hierarchy[i] == 0)
+        {
+            upperBody.SetSubtreeWeight(hierarchy, i, 1.0f);
+            break;
+        }
+    }
+
+    TaskPool& pool = TaskPool::Default();
+
+    const UINT maxLayers = 3;
+
+    printf("%10s %7s %14s %14s\n", "instances", "layers", "batched (ms)", "pool (ms)");
+
+    for(UINT numInstances : { 256u, 1024u, 4096u })
+    {
+        std::vector<AnimationLayer> layers((size_t)numInstances * maxLayers);
+        std::vector<AnimationCursor> cursors(layers.size());
+        for(UINT i = 0; i < numInstances; ++i)
+        {
+            AnimationLayer* instanceLayers = &layers[(size_t)i * maxLayers];
+            AnimationCursor* instanceCursors = &cursors[(size_t)i * maxLayers];
+
+            const float timePos = duration * i / numInstances;
+
+            instanceLayers[0].Clip = clip;
+            instanceLayers[0].TimePos = timePos;
+            instanceLayers[0].Cursor = &instanceCursors[0];
+
+            instanceLayers[1].Clip = clip;
+            instanceLayers[1].TimePos = std::fmod(timePos + 0.5f * duration, duration);
+            instanceLayers[1].Weight = 0.75f;
+            instanceLayers[1].Mask = &upperBody;
+            instanceLayers[1].Cursor = &instanceCursors[1];
+
+            instanceLayers[2].Clip = additiveClip;
+            instanceLayers[2].TimePos = std::fmod(timePos + 0.25f * duration, duration);
+            instanceLayers[2].Weight = 0.5f;
+            instanceLayers[2].Mode = AnimationBlendMode::Additive;
+            instanceLayers[2].Cursor = &instanceCursors[2];
+        }
+
+        std::vector<LayeredPoseRequest> requests(numInstances);
+        std::vector<XMFLOAT4X4> finalTransforms((size_t)numInstances * numBones);
+
+        auto advance = [&]()
+        {
+            for(AnimationLayer& layer : layers)
+            {
+                layer.TimePos += 1.0f / 60.0f;
+                if(layer.TimePos > duration)
+                    layer.TimePos = 0.0f;
+            }
+        };
+
+        for(UINT numLayers = 1; numLayers <= maxLayers; ++numLayers)
+        {
+            for(UINT i = 0; i < numInstances; ++i)
+            {
+                requests[i].Layers = &layers[(size_t)i * maxLayers];
+                requests[i].NumLayers = numLayers;
+            }
+
+            double batchedMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                advance();
+                skinInfo.GetFinalTransforms(requests, finalTransforms);
+            });
+
+            double poolMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                advance();
+                skinInfo.GetFinalTransforms(requests, finalTransforms, &pool);
+            });
+
+            printf("%10u %7u %14.3f %14.3f\n", numInstances, numLayers, batchedMs, poolMs);
+        }
+    }
+
+    printf("(%u pool threads)\n", pool.ThreadCount());
+
+    return true;
+}
@@ -0,0 +1,290 @@
+//***************************************************************************************
+// BenchRayBatch.cpp
+//
+// Batched MeshBvh queries on the skull and car, built from a MeshGeometry's
+// VertexBufferCPU the way the picking demo builds them.  Three sets of 1M rays: a
+// 1024x1024 view of the model in 2x2 pixel quads (coherent, so traced as packets),
+// rays from a sphere around the model to random points in it (incoherent) and line of
+// sight tests between random pairs of points on that sphere (Occluded).  Each set is
+// traced by a loop of single ray queries, by one batch on one thread and by one batch
+// on the TaskPool; the batches must give the loop's results.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/MeshBvh.h"
+#include "../../Common/TaskPool.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    struct RaySet
+    {
+        const char* Name = "";
+        std::vector<XMFLOAT3> Origins;
+        std::vector<XMFLOAT3> Dirs;
+
+        // Line of sight tests reach up to 1 in units of Dirs; the rest are unlimited.
+        bool LineOfSight = false;
+    };
+
+    // The CPU side of a MeshGeometry over the model, with 16-bit indices if they fit.
+    void BuildCpuGeometry(const BenchModel& model, MeshGeometry& geo, SubmeshGeometry& submesh)
+    {
+        const UINT vbByteSize = (UINT)(model.Vertices.size() * sizeof(ModelVertex));
+        geo.VertexBufferCPU.resize(vbByteSize);
+        memcpy(geo.VertexBufferCPU.data(), model.Vertices.data(), vbByteSize);
+        geo.VertexByteStride = sizeof(ModelVertex);
+        geo.VertexBufferByteSize = vbByteSize;
+
+        if(model.Vertices.size() <= 0xffff)
+        {
+            std::vector<uint16_t> indices16(model.Indices.begin(), model.Indices.end());
+            geo.IndexBufferByteSize = (UINT)(indices16.size() * sizeof(uint16_t));
+            geo.IndexBufferCPU.resize(geo.IndexBufferByteSize);
+            memcpy(geo.IndexBufferCPU.data(), indices16.data(), geo.IndexBufferByteSize);
+            geo.IndexFormat = DXGI_FORMAT_R16_UINT;
+        }
+        else
+        {
+            geo.IndexBufferByteSize = (UINT)(model.Indices.size() * sizeof(uint32_t));
+            geo.IndexBufferCPU.resize(geo.IndexBufferByteSize);
+            memcpy(geo.IndexBufferCPU.data(), model.Indices.data(), geo.IndexBufferByteSize);
+            geo.IndexFormat = DXGI_FORMAT_R32_UINT;
+        }
+
+        submesh.IndexCount = (UINT)model.Indices.size();
+        submesh.StartIndexLocation = 0;
+        submesh.BaseVertexLocation = 0;
+        submesh.VertexCount = (UINT)model.Vertices.size();
+    }
+
+    RaySet MakeViewRays(const BoundingBox& bounds, UINT size)
+    {
+        RaySet set;
+        set.Name = "view";
+
+        const XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+        const XMVECTOR eye = center + XMVectorSet(0.3f*radius, 0.5f*radius, -2.5f*radius, 0.0f);
+
+        const XMMATRIX view = XMMatrixLookAtLH(eye, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        const XMMATRIX invView = XMMatrixInverse(nullptr, view);
+        const float tanHalfFov = tanf(0.5f * 0.25f*MathHelper::Pi);
+
+        XMFLOAT3 eyeW;
+        XMStoreFloat3(&eyeW, eye);
+
+        // 2x2 quads of neighbouring pixels in a row.
+        for(UINT y = 0; y < size; y += 2)
+        {
+            for(UINT x = 0; x < size; x += 2)
+            {
+                for(UINT k = 0; k < 4; ++k)
+                {
+                    const float px = (x + (k & 1) + 0.5f) / size * 2.0f - 1.0f;
+                    const float py = 1.0f - (y + (k >> 1) + 0.5f) / size * 2.0f;
+                    const XMVECTOR dirV = XMVectorSet(px * tanHalfFov, py * tanHalfFov, 1.0f, 0.0f);
+
+                    XMFLOAT3 dir;
+                    XMStoreFloat3(&dir, XMVector3TransformNormal(dirV, invView));
+                    set.Origins.push_back(eyeW);
+                    set.Dirs.push_back(dir);
+                }
+            }
+        }
+
+        return set;
+    }
+
+    XMVECTOR RandomOnSphere(std::mt19937& rng, FXMVECTOR center, float radius)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        XMVECTOR p;
+        do
+        {
+            p = XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+        } while(XMVectorGetX(XMVector3LengthSq(p)) < 1e-4f);
+
+        return center + radius * XMVector3Normalize(p);
+    }
+
+    RaySet MakeRandomRays(const BoundingBox& bounds, UINT count, UINT seed)
+    {
+        RaySet set;
+        set.Name = "random";
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        const XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        const XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+        const float radius = 2.0f * XMVectorGetX(XMVector3Length(extents));
+
+        set.Origins.resize(count);
+        set.Dirs.resize(count);
+        for(UINT i = 0; i < count; ++i)
+        {
+            const XMVECTOR origin = RandomOnSphere(rng, center, radius);
+            const XMVECTOR target = center + extents * XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+            XMStoreFloat3(&set.Origins[i], origin);
+            XMStoreFloat3(&set.Dirs[i], target - origin);
+        }
+
+        return set;
+    }
+
+    // Agents on a sphere around the model that the model sits between.
+    RaySet MakeSightRays(const BoundingBox& bounds, UINT count, UINT seed)
+    {
+        RaySet set;
+        set.Name = "sight";
+        set.LineOfSight = true;
+
+        std::mt19937 rng(seed);
+        const XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        const float radius = 1.2f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+
+        set.Origins.resize(count);
+        set.Dirs.resize(count);
+        for(UINT i = 0; i < count; ++i)
+        {
+            const XMVECTOR eye = RandomOnSphere(rng, center, radius);
+            const XMVECTOR target = RandomOnSphere(rng, center, radius);
+            XMStoreFloat3(&set.Origins[i], eye);
+            XMStoreFloat3(&set.Dirs[i], target - eye);
+        }
+
+        return set;
+    }
+
+    struct SetResult
+    {
+        double LoopMs = 0.0;
+        double BatchMs = 0.0;
+        double PoolMs = 0.0;
+        UINT HitCount = 0;
+        std::string Check;
+    };
+
+    SetResult TraceSet(const BenchOptions& options, const MeshBvh& bvh, const RaySet& set, TaskPool& serial)
+    {
+        const UINT count = (UINT)set.Origins.size();
+        const XMFLOAT3* origins = set.Origins.data();
+        const XMFLOAT3* dirs = set.Dirs.data();
+        const std::vector<float> maxT(count, 1.0f);
+
+        SetResult result;
+        std::vector<RayHit> loopHits(count);
+        std::vector<RayHit> batchHits(count);
+        std::unique_ptr<bool[]> loopOccluded(new bool[count]);
+        std::unique_ptr<bool[]> batchOccluded(new bool[count]);
+
+        result.LoopMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(UINT i = 0; i < count; ++i)
+            {
+                if(set.LineOfSight)
+                {
+                    loopOccluded[i] = bvh.Occluded(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), 1.0f);
+                }
+                else
+                {
+                    loopHits[i] = RayHit();
+                    bvh.Intersect(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i]), loopHits[i]);
+                }
+            }
+        });
+
+        auto batch = [&](TaskPool* pool)
+        {
+            if(set.LineOfSight)
+            {
+                bvh.OccludedBatch(origins, dirs, maxT.data(), count, batchOccluded.get(), pool);
+            }
+            else
+            {
+                for(RayHit& hit : batchHits)
+                    hit = RayHit();
+                bvh.IntersectBatch(origins, dirs, count, batchHits.data(), pool);
+            }
+        };
+
+        result.BatchMs = TimeAverageMs(options.Iterations, [&]() { batch(&serial); });
+        result.PoolMs = TimeAverageMs(options.Iterations, [&]() { batch(&TaskPool::Default()); });
+
+        // The same triangles at the same distance; different triangles only where a ray
+        // passes through an edge they share.
+        for(UINT i = 0; i < count; ++i)
+        {
+            if(set.LineOfSight)
+            {
+                result.HitCount += loopOccluded[i] ? 1 : 0;
+                if(loopOccluded[i] != batchOccluded[i] && result.Check.empty())
+                    result.Check = "batch occlusion differs from the loop";
+                continue;
+            }
+
+            const RayHit& a = loopHits[i];
+            const RayHit& b = batchHits[i];
+            result.HitCount += a.IsHit() ? 1 : 0;
+            if((a.IsHit() != b.IsHit() || (a.IsHit() && fabsf(a.T - b.T) > 1e-5f * a.T)) && result.Check.empty())
+                result.Check = "batch hits differ from the loop";
+        }
+
+        return result;
+    }
+}
+
+bool RunRayBatchBenchmark(const BenchOptions& options)
+{
+    const UINT viewSize = 1024;
+    const UINT rayCount = viewSize * viewSize;
+
+    TaskPool serial(1);
+    printf("  %u threads, %u rays per set\n", TaskPool::Default().ThreadCount(), rayCount);
+    printf("  %-10s %-7s %10s %10s %10s %8s %8s %7s  %s\n", "model", "rays", "loop Mr/s", "batch Mr/s",
+        "pool Mr/s", "batch x", "pool x", "hit %", "check");
+
+    bool passed = true;
+    const char* modelNames[] = { "skull.txt", "car.txt" };
+    for(const char* modelName : modelNames)
+    {
+        BenchModel model;
+        if(!LoadBenchModel(options, modelName, model))
+        {
+            printf("%s failed to load\n", modelName);
+            passed = false;
+            continue;
+        }
+
+        MeshGeometry geo;
+        SubmeshGeometry submesh;
+        BuildCpuGeometry(model, geo, submesh);
+
+        MeshBvh bvh;
+        bvh.Build(geo, submesh);
+
+        const RaySet sets[] =
+        {
+            MakeViewRays(bvh.GetBounds(), viewSize),
+            MakeRandomRays(bvh.GetBounds(), rayCount, 31),
+            MakeSightRays(bvh.GetBounds(), rayCount, 37),
+        };
+
+        for(const RaySet& set : sets)
+        {
+            const SetResult result = TraceSet(options, bvh, set, serial);
+            const double count = (double)set.Origins.size();
+            printf("  %-10s %-7s %10.2f %10.2f %10.2f %7.2fx %7.2fx %6.1f%%  %s\n", modelName, set.Name,
+                count / (result.LoopMs * 1000.0), count / (result.BatchMs * 1000.0), count / (result.PoolMs * 1000.0),
+                result.LoopMs / result.BatchMs, result.LoopMs / result.PoolMs, 100.0 * result.HitCount / count,
+                result.Check.empty() ? "ok" : result.Check.c_str());
+            passed &= result.Check.empty();
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,219 @@
+//***************************************************************************************
+// BenchSceneTree.cpp
+//
+// DynamicBvh queries against scenes of 10K to 1M objects spread at the same density
+// over a world that grows with them, seen by a camera whose far plane stays the same,
+// so about as many objects are in view at every size.  Frustum queries are timed
+// against testing every object's box, along with sphere queries of a fixed radius,
+// ray queries for picking and a frame of updates that moves a tenth of the objects.
+// Every query is checked against a brute force test of the loose boxes.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/DynamicBvh.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    bool BoxInFrustum(const XMFLOAT4 planes[6], const BoundingBox& box)
+    {
+        for(int p = 0; p < 6; ++p)
+        {
+            const XMFLOAT4& n = planes[p];
+            const float s = n.x*box.Center.x + n.y*box.Center.y + n.z*box.Center.z + n.w;
+            const float r = fabsf(n.x)*box.Extents.x + fabsf(n.y)*box.Extents.y + fabsf(n.z)*box.Extents.z;
+            if(s + r < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool BoxInSphere(const BoundingSphere& sphere, const BoundingBox& box)
+    {
+        float distSq = 0.0f;
+        const float c[3] = { sphere.Center.x - box.Center.x, sphere.Center.y - box.Center.y, sphere.Center.z - box.Center.z };
+        const float e[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+        for(int a = 0; a < 3; ++a)
+        {
+            const float d = std::max(fabsf(c[a]) - e[a], 0.0f);
+            distSq += d*d;
+        }
+
+        return distSq <= sphere.Radius*sphere.Radius;
+    }
+
+    // Sorted copy, so results of different orders compare equal.
+    std::vector<UINT> Sorted(std::vector<UINT> proxies)
+    {
+        std::sort(proxies.begin(), proxies.end());
+        return proxies;
+    }
+}
+
+bool RunSceneTreeBenchmark(const BenchOptions& options)
+{
+    // One object per 8x8x8 cell, in a world as deep as it is wide and half as high.
+    const float cellSize = 8.0f;
+    const float farZ = 200.0f;
+    const UINT sphereQueryCount = 100;
+    const UINT rayQueryCount = 1000;
+
+    const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f),
+        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, farZ);
+    XMFLOAT4 planes[6];
+    MathHelper::ExtractFrustumPlanes(XMMatrixMultiply(view, proj), planes);
+
+    printf("  %-8s %9s %6s %8s %10s %10s %8s %10s %10s %10s %9s  %s\n", "objects", "insert ms", "height",
+        "visible", "brute us", "frustum us", "speedup", "sphere us", "ray us", "update ns", "reinsert", "check");
+
+    bool passed = true;
+    const UINT sizes[] = { 10000, 100000, 1000000 };
+    for(UINT objectCount : sizes)
+    {
+        const UINT side = (UINT)ceilf(powf(2.0f * objectCount, 1.0f / 3.0f));
+        const float width = side * cellSize;
+
+        std::mt19937 rng(objectCount);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Objects of 0.5 to 3 units around the camera, which sits at the world center.
+        std::vector<BoundingBox> bounds(objectCount);
+        for(BoundingBox& box : bounds)
+        {
+            box.Center = XMFLOAT3((unit(rng) - 0.5f) * width, (unit(rng) - 0.5f) * 0.5f * width, (unit(rng) - 0.5f) * width);
+            box.Extents = XMFLOAT3(0.25f + 1.25f*unit(rng), 0.25f + 1.25f*unit(rng), 0.25f + 1.25f*unit(rng));
+        }
+
+        DynamicBvh tree;
+        std::vector<UINT> proxies(objectCount);
+        const double insertMs = TimeAverageMs(1, [&]()
+        {
+            for(UINT i = 0; i < objectCount; ++i)
+                proxies[i] = tree.Insert(bounds[i], nullptr);
+        });
+
+        std::vector<BoundingBox> looseBounds(objectCount);
+        for(UINT i = 0; i < objectCount; ++i)
+            looseBounds[i] = tree.GetLooseBounds(proxies[i]);
+
+        // Every box against the planes, as a flat list of render items would.
+        std::vector<UINT> bruteVisible;
+        const double bruteMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            bruteVisible.clear();
+            for(UINT i = 0; i < objectCount; ++i)
+            {
+                if(BoxInFrustum(planes, looseBounds[i]))
+                    bruteVisible.push_back(proxies[i]);
+            }
+        });
+
+        std::vector<UINT> treeVisible;
+        const double frustumMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            treeVisible.clear();
+            tree.QueryFrustum(planes, treeVisible);
+        });
+
+        std::string check;
+        if(Sorted(treeVisible) != Sorted(bruteVisible))
+            check = "frustum query differs";
+
+        // Spheres the size of a shadowed region, around points in view.
+        std::vector<BoundingSphere> spheres(sphereQueryCount);
+        for(BoundingSphere& sphere : spheres)
+            sphere = BoundingSphere(XMFLOAT3((unit(rng) - 0.5f) * 100.0f, (unit(rng) - 0.5f) * 50.0f, unit(rng) * farZ), 20.0f);
+
+        std::vector<UINT> sphereHits;
+        const double sphereMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(const BoundingSphere& sphere : spheres)
+            {
+                sphereHits.clear();
+                tree.QuerySphere(sphere, sphereHits);
+            }
+        });
+
+        {
+            std::vector<UINT> expected;
+            for(UINT i = 0; i < objectCount; ++i)
+            {
+                if(BoxInSphere(spheres.back(), looseBounds[i]))
+                    expected.push_back(proxies[i]);
+            }
+
+            if(Sorted(sphereHits) != expected && check.empty())
+                check = "sphere query differs";
+        }
+
+        // Picking rays from the camera into the view.
+        std::vector<XMFLOAT3> rayDirs(rayQueryCount);
+        for(XMFLOAT3& dir : rayDirs)
+            dir = XMFLOAT3(unit(rng) - 0.5f, 0.5f * (unit(rng) - 0.5f), 1.0f);
+
+        std::vector<DynamicBvhRayHit> rayHits;
+        const double rayMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(const XMFLOAT3& dir : rayDirs)
+                tree.QueryRay(XMVectorZero(), XMLoadFloat3(&dir), farZ, rayHits);
+        });
+
+        {
+            UINT expected = 0;
+            const XMVECTOR dir = XMLoadFloat3(&rayDirs.back());
+            const float dirLength = XMVectorGetX(XMVector3Length(dir));
+            for(UINT i = 0; i < objectCount; ++i)
+            {
+                float dist = 0.0f;
+                if(looseBounds[i].Intersects(XMVectorZero(), XMVector3Normalize(dir), dist) && dist < farZ * dirLength)
+                    expected++;
+            }
+
+            if(expected != rayHits.size() && check.empty())
+                check = "ray query differs";
+        }
+
+        // A frame in which a tenth of the objects move: most a little, within their
+        // loose boxes, and one in ten of those far enough to be reinserted.
+        const UINT movedCount = objectCount / 10;
+        std::vector<UINT> moved(movedCount);
+        std::vector<BoundingBox> movedBounds(movedCount);
+        for(UINT m = 0; m < movedCount; ++m)
+        {
+            moved[m] = (UINT)(rng() % objectCount);
+            movedBounds[m] = bounds[moved[m]];
+            movedBounds[m].Center.x += (m % 10 == 0) ? 2.0f : 0.05f;
+        }
+
+        UINT reinsertCount = 0;
+        const double updateMs = TimeAverageMs(1, [&]()
+        {
+            for(UINT m = 0; m < movedCount; ++m)
+                reinsertCount += tree.Update(proxies[moved[m]], movedBounds[m]) ? 1 : 0;
+        });
+
+        // The moved objects are still found where they went.
+        treeVisible.clear();
+        tree.QueryFrustum(planes, treeVisible);
+        bruteVisible.clear();
+        for(UINT i = 0; i < objectCount; ++i)
+        {
+            if(BoxInFrustum(planes, tree.GetLooseBounds(proxies[i])))
+                bruteVisible.push_back(proxies[i]);
+        }
+        if(Sorted(treeVisible) != Sorted(bruteVisible) && check.empty())
+            check = "frustum query differs after updates";
+
+        printf("  %-8u %9.1f %6u %8u %10.1f %10.1f %7.1fx %10.2f %10.2f %10.1f %8.1f%%  %s\n", objectCount, insertMs,
+            tree.Height(), (UINT)treeVisible.size(), bruteMs * 1000.0, frustumMs * 1000.0, bruteMs / frustumMs,
+            sphereMs * 1000.0 / sphereQueryCount, rayMs * 1000.0 / rayQueryCount, updateMs * 1e6 / movedCount,
+            100.0 * reinsertCount / movedCount, check.empty() ? "ok" : check.c_str());
+        passed &= check.empty();
+    }
+
+    return passed;
+}
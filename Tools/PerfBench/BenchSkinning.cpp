@@ -0,0 +1,96 @@
+//***************************************************************************************
+// BenchSkinning.cpp
+//
+// Poses a crowd of soldiers with SkinnedData::GetFinalTransforms: one instance at a
+// time by clip name, batched by clip handle, and batched across a TaskPool.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/LoadM3d.h"
+#include "../../Common/TaskPool.h"
+
+using namespace DirectX;
+
+bool RunSkinningBenchmark(const BenchOptions& options)
+{
+    const std::string filename = options.DataRoot + "Models/soldier.m3d";
+
+    std::vector<M3DLoader::SkinnedVertex> vertices;
+    std::vector<UINT> indices;
+    std::vector<M3DLoader::Subset> subsets;
+    std::vector<M3DLoader::M3dMaterial> mats;
+    SkinnedData skinInfo;
+
+    M3DLoader loader;
+    if(!loader.LoadM3d(filename, vertices, indices, subsets, mats, skinInfo))
+    {
+        printf("failed to load %s\n", filename.c_str());
+        return false;
+    }
+
+    const std::string clipName = "Take1";
+    const AnimationClipHandle clip = skinInfo.FindClip(clipName);
+    if(clip == InvalidAnimationClip)
+    {
+        printf("%s has no clip named %s\n", filename.c_str(), clipName.c_str());
+        return false;
+    }
+
+    const UINT numBones = skinInfo.BoneCount();
+    const float duration = skinInfo.GetClipEndTime(clip);
+
+    TaskPool& pool = TaskPool::Default();
+
+    printf("%10s %14s %14s %14s %9s\n", "instances", "by name (ms)", "batched (ms)", "pool (ms)", "speedup");
+
+    for(UINT numInstances : { 16u, 256u, 1024u, 4096u })
+    {
+        std::vector<SkinnedPoseRequest> requests(numInstances);
+        std::vector<AnimationCursor> cursors(numInstances);
+        for(UINT i = 0; i < numInstances; ++i)
+        {
+            requests[i].Clip = clip;
+            requests[i].TimePos = duration * i / numInstances;
+            requests[i].Cursor = &cursors[i];
+        }
+
+        std::vector<XMFLOAT4X4> finalTransforms((size_t)numInstances * numBones);
+        std::vector<XMFLOAT4X4> instanceTransforms(numBones);
+
+        // Advance the crowd by one 60Hz frame per call, like the demos do.
+        auto advance = [&]()
+        {
+            for(SkinnedPoseRequest& request : requests)
+            {
+                request.TimePos += 1.0f / 60.0f;
+                if(request.TimePos > duration)
+                    request.TimePos = 0.0f;
+            }
+        };
+
+        double byNameMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            advance();
+            for(const SkinnedPoseRequest& request : requests)
+                skinInfo.GetFinalTransforms(clipName, request.TimePos, instanceTransforms);
+        });
+
+        double batchedMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            advance();
+            skinInfo.GetFinalTransforms(requests, finalTransforms);
+        });
+
+        double poolMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            advance();
+            skinInfo.GetFinalTransforms(requests, finalTransforms, &pool);
+        });
+
+        printf("%10u %14.3f %14.3f %14.3f %8.1fx\n", numInstances, byNameMs, batchedMs, poolMs, byNameMs / poolMs);
+    }
+
+    printf("(%u pool threads)\n", pool.ThreadCount());
+
+    return true;
+}
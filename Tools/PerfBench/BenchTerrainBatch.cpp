@@ -0,0 +1,124 @@
+//***************************************************************************************
+// BenchTerrainBatch.cpp
+//
+// Snapping a crowd to the ground: N scalar HeightmapSampler::GetHeight calls against
+// one batched GetHeights call, with and without normals, on one thread and on the
+// TaskPool.  The agents are scattered in clusters over a 4k heightmap, the float and
+// the unorm16 variant of it.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/HeightmapSampler.h"
+#include "../../Common/TaskPool.h"
+#include <random>
+
+using namespace DirectX;
+
+bool RunTerrainBatchBenchmark(const BenchOptions& options)
+{
+    const UINT size = 4097;
+    const float heightScale = 100.0f;
+    const float heightOffset = -50.0f;
+
+    std::vector<uint16_t> samples((size_t)size*size);
+    std::vector<float> heights(samples.size());
+    for(UINT z = 0; z < size; ++z)
+    {
+        for(UINT x = 0; x < size; ++x)
+        {
+            float fx = (float)x / size;
+            float fz = (float)z / size;
+            float h = 0.5f + 0.3f*sinf(fx*9.0f)*cosf(fz*7.0f) + 0.15f*sinf(fx*41.0f + fz*37.0f);
+            const size_t i = (size_t)z*size + x;
+            samples[i] = (uint16_t)(MathHelper::Clamp(h, 0.0f, 1.0f) * 65535.0f);
+            heights[i] = heightScale*(samples[i] / 65535.0f) + heightOffset;
+        }
+    }
+
+    // Terrain's placement: centered on the origin, rows towards -z.
+    HeightmapSampler::Grid grid;
+    grid.Width = size;
+    grid.Height = size;
+    grid.CellSpacing = 0.5f;
+    grid.OriginX = -0.5f*(size - 1)*grid.CellSpacing;
+    grid.OriginZ = 0.5f*(size - 1)*grid.CellSpacing;
+
+    const HeightmapSampler floatSampler(heights.data(), grid);
+    const HeightmapSampler unormSampler(samples.data(), heightScale, heightOffset, grid);
+
+    // A new crowd every 4096 agents.
+    const UINT numAgents = 1 << 20;
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> anywhere(grid.OriginX, -grid.OriginX);
+    std::uniform_real_distribution<float> nearby(-100.0f, 100.0f);
+
+    std::vector<float> agentX(numAgents);
+    std::vector<float> agentZ(numAgents);
+    float centerX = 0.0f;
+    float centerZ = 0.0f;
+    for(UINT i = 0; i < numAgents; ++i)
+    {
+        if(i % 4096 == 0)
+        {
+            centerX = anywhere(rng);
+            centerZ = anywhere(rng);
+        }
+        agentX[i] = centerX + nearby(rng);
+        agentZ[i] = centerZ + nearby(rng);
+    }
+
+    std::vector<float> scalarY(numAgents);
+    std::vector<float> batchY(numAgents);
+    std::vector<XMFLOAT3> scalarN(numAgents);
+    std::vector<XMFLOAT3> batchN(numAgents);
+
+    TaskPool serialPool(1);
+    TaskPool& pool = TaskPool::Default();
+
+    printf("%u agents, %ux%u heightmap, %u threads\n", numAgents, size, size, pool.ThreadCount());
+    printf("%10s %8s %12s %14s %14s %10s\n", "format", "normals", "scalar", "batch 1 thread", "batch pool", "max error");
+
+    for(const HeightmapSampler* sampler : { &floatSampler, &unormSampler })
+    {
+        for(bool withNormals : { false, true })
+        {
+            XMFLOAT3* scalarNormals = withNormals ? scalarN.data() : nullptr;
+            XMFLOAT3* batchNormals = withNormals ? batchN.data() : nullptr;
+
+            double scalarMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                for(UINT i = 0; i < numAgents; ++i)
+                    scalarY[i] = sampler->GetHeight(agentX[i], agentZ[i], scalarNormals ? &scalarNormals[i] : nullptr);
+            });
+
+            double serialMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                sampler->GetHeights(agentX.data(), agentZ.data(), numAgents, batchY.data(), batchNormals, &serialPool);
+            });
+
+            double poolMs = TimeAverageMs(options.Iterations, [&]()
+            {
+                sampler->GetHeights(agentX.data(), agentZ.data(), numAgents, batchY.data(), batchNormals, &pool);
+            });
+
+            float maxError = 0.0f;
+            for(UINT i = 0; i < numAgents; ++i)
+            {
+                maxError = std::max(maxError, fabsf(scalarY[i] - batchY[i]));
+                if(withNormals)
+                {
+                    maxError = std::max(maxError, fabsf(scalarN[i].x - batchN[i].x));
+                    maxError = std::max(maxError, fabsf(scalarN[i].y - batchN[i].y));
+                    maxError = std::max(maxError, fabsf(scalarN[i].z - batchN[i].z));
+                }
+            }
+
+            auto mqps = [&](double ms) { return numAgents / (ms * 1e3); };
+            printf("%10s %8s %7.1f Mq/s %9.1f Mq/s %9.1f Mq/s %10g\n",
+                sampler == &floatSampler ? "R32_FLOAT" : "R16_UNORM", withNormals ? "yes" : "no",
+                mqps(scalarMs), mqps(serialMs), mqps(poolMs), maxError);
+        }
+    }
+
+    return true;
+}
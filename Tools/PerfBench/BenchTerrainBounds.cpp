@@ -0,0 +1,265 @@
+//***************************************************************************************
+// BenchTerrainBounds.cpp
+//
+// Terrain load-time bounds and ray queries on synthetic 4k and 8k heightmaps.  The
+// scan columns are what Terrain::CalcAllPatchBoundsY and TerrainMS::CalcQuadGroupBounds
+// used to do: visit every sample of every patch (32x32 cells) and of every group of
+// 8x8 patches.  The pyramid columns build a HeightPyramid once and answer the same
+// bounds from it.  Rays start above the terrain and head down at grazing angles; the
+// walk column tests every cell under the ray until the first hit.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/HeightPyramid.h"
+#include "../../Common/TaskPool.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const UINT CellsPerPatch = 32;
+    const UINT PatchesPerGroup = 8;
+
+    // Rolling hills plus some high frequency detail, in [0, 100].
+    std::vector<float> MakeHeightmap(UINT size, TaskPool& pool)
+    {
+        std::vector<float> heights((size_t)size*size);
+        pool.ParallelFor(size, 64, [&](UINT begin, UINT end)
+        {
+            for(UINT z = begin; z < end; ++z)
+            {
+                for(UINT x = 0; x < size; ++x)
+                {
+                    float fx = (float)x / size;
+                    float fz = (float)z / size;
+                    float h = 50.0f + 30.0f*sinf(fx*9.0f)*cosf(fz*7.0f) + 15.0f*sinf(fx*41.0f + fz*37.0f);
+                    UINT hash = (x*73856093u) ^ (z*19349663u);
+                    h += 5.0f * (float)(hash % 1024) / 1024.0f;
+                    heights[(size_t)z*size + x] = h;
+                }
+            }
+        });
+        return heights;
+    }
+
+    XMFLOAT2 ScanBounds(const std::vector<float>& heights, UINT size, UINT x0, UINT z0, UINT x1, UINT z1)
+    {
+        float minY = +MathHelper::Infinity;
+        float maxY = -MathHelper::Infinity;
+        for(UINT z = z0; z <= z1; ++z)
+        {
+            for(UINT x = x0; x <= x1; ++x)
+            {
+                float h = heights[(size_t)z*size + x];
+                minY = MathHelper::Min(minY, h);
+                maxY = MathHelper::Max(maxY, h);
+            }
+        }
+        return XMFLOAT2(minY, maxY);
+    }
+
+    // Reference ray query: walk every cell under the ray, no pyramid.
+    bool WalkRay(const std::vector<float>& heights, UINT size, const XMFLOAT3& o, const XMFLOAT3& d, float maxT, float& t)
+    {
+        // Enter the grid first.
+        float t0 = 0.0f;
+        float t1 = maxT;
+        const float lo[2] = { 0.0f, 0.0f };
+        const float hi[2] = { (float)(size - 1), (float)(size - 1) };
+        const float org[2] = { o.x, o.z };
+        const float dir[2] = { d.x, d.z };
+        for(int axis = 0; axis < 2; ++axis)
+        {
+            if(dir[axis] == 0.0f)
+            {
+                if(org[axis] < lo[axis] || org[axis] > hi[axis])
+                    return false;
+                continue;
+            }
+            float a = (lo[axis] - org[axis]) / dir[axis];
+            float b = (hi[axis] - org[axis]) / dir[axis];
+            t0 = std::max(t0, std::min(a, b));
+            t1 = std::min(t1, std::max(a, b));
+        }
+        if(t0 > t1)
+            return false;
+
+        XMVECTOR origin = XMLoadFloat3(&o);
+        XMVECTOR direction = XMLoadFloat3(&d);
+        float length = XMVectorGetX(XMVector3Length(direction));
+        XMVECTOR unitDir = XMVectorScale(direction, 1.0f / length);
+
+        int cx = std::clamp((int)floorf(o.x + t0*d.x), 0, (int)size - 2);
+        int cz = std::clamp((int)floorf(o.z + t0*d.z), 0, (int)size - 2);
+        const int stepX = d.x > 0.0f ? 1 : -1;
+        const int stepZ = d.z > 0.0f ? 1 : -1;
+        float nextX = d.x != 0.0f ? ((float)(cx + (stepX > 0)) - o.x) / d.x : FLT_MAX;
+        float nextZ = d.z != 0.0f ? ((float)(cz + (stepZ > 0)) - o.z) / d.z : FLT_MAX;
+
+        for(;;)
+        {
+            auto corner = [&](int x, int z) { return XMVectorSet((float)x, heights[(size_t)z*size + x], (float)z, 0.0f); };
+            XMVECTOR A = corner(cx, cz), B = corner(cx + 1, cz), C = corner(cx, cz + 1), D = corner(cx + 1, cz + 1);
+
+            float best = FLT_MAX;
+            float dist;
+            if(TriangleTests::Intersects(origin, unitDir, A, B, C, dist))
+                best = std::min(best, dist / length);
+            if(TriangleTests::Intersects(origin, unitDir, D, C, B, dist))
+                best = std::min(best, dist / length);
+            if(best <= t1)
+            {
+                t = best;
+                return true;
+            }
+
+            if(std::min(nextX, nextZ) > t1)
+                return false;
+            if(nextX < nextZ) { cx += stepX; nextX += fabsf(1.0f / d.x); }
+            else              { cz += stepZ; nextZ += fabsf(1.0f / d.z); }
+            if(cx < 0 || cz < 0 || cx >= (int)size - 1 || cz >= (int)size - 1)
+                return false;
+        }
+    }
+}
+
+bool RunTerrainBoundsBenchmark(const BenchOptions& options)
+{
+    TaskPool& pool = TaskPool::Default();
+
+    printf("%10s %12s %12s %12s %12s %12s %9s\n", "heightmap", "patch scan", "group scan", "build",
+        "pyr queries", "pyramid", "speedup");
+
+    struct RayResult
+    {
+        UINT Size;
+        double WalkRaysPerSec;
+        double PyramidRaysPerSec;
+        UINT Hits;
+        UINT NumRays;
+    };
+    std::vector<RayResult> rayResults;
+
+    for(UINT size : { 4097u, 8193u })
+    {
+        std::vector<float> heights = MakeHeightmap(size, pool);
+
+        const UINT numPatches = (size - 1) / CellsPerPatch;
+        const UINT numGroups = numPatches / PatchesPerGroup;
+
+        std::vector<XMFLOAT2> patchBounds((size_t)numPatches*numPatches);
+        std::vector<XMFLOAT2> groupBounds((size_t)numGroups*numGroups);
+
+        double patchScanMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(UINT i = 0; i < numPatches; ++i)
+                for(UINT j = 0; j < numPatches; ++j)
+                    patchBounds[i*numPatches + j] = ScanBounds(heights, size,
+                        j*CellsPerPatch, i*CellsPerPatch, (j+1)*CellsPerPatch, (i+1)*CellsPerPatch);
+        });
+
+        const UINT groupCells = CellsPerPatch*PatchesPerGroup;
+        double groupScanMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(UINT i = 0; i < numGroups; ++i)
+                for(UINT j = 0; j < numGroups; ++j)
+                    groupBounds[i*numGroups + j] = ScanBounds(heights, size,
+                        j*groupCells, i*groupCells, (j+1)*groupCells, (i+1)*groupCells);
+        });
+
+        HeightPyramid pyramid;
+        double buildMs = TimeAverageMs(options.Iterations, [&]() { pyramid.Build(heights.data(), size, size, &pool); });
+
+        // Same bounds from the pyramid; they must match the scan exactly.
+        bool match = true;
+        double queryMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(UINT i = 0; i < numPatches; ++i)
+            {
+                for(UINT j = 0; j < numPatches; ++j)
+                {
+                    XMFLOAT2 r = pyramid.GetRangeY(j*CellsPerPatch, i*CellsPerPatch, (j+1)*CellsPerPatch, (i+1)*CellsPerPatch);
+                    const XMFLOAT2& s = patchBounds[i*numPatches + j];
+                    match = match && r.x == s.x && r.y == s.y;
+                }
+            }
+            for(UINT i = 0; i < numGroups; ++i)
+            {
+                for(UINT j = 0; j < numGroups; ++j)
+                {
+                    XMFLOAT2 r = pyramid.GetRangeY(j*groupCells, i*groupCells, (j+1)*groupCells, (i+1)*groupCells);
+                    const XMFLOAT2& s = groupBounds[i*numGroups + j];
+                    match = match && r.x == s.x && r.y == s.y;
+                }
+            }
+        });
+
+        double scanMs = patchScanMs + groupScanMs;
+        double pyramidMs = buildMs + queryMs;
+        printf("%5ux%-5u %9.2f ms %9.2f ms %9.2f ms %9.2f ms %9.2f ms %8.1fx%s\n", size, size,
+            patchScanMs, groupScanMs, buildMs, queryMs, pyramidMs, scanMs / pyramidMs, match ? "" : "  MISMATCH");
+        printf("%10s pyramid: %u levels, %.2f MB (heightmap %.2f MB)\n", "", pyramid.GetLevelCount(),
+            pyramid.GetMemoryByteSize() / (1024.0*1024.0), heights.size()*sizeof(float) / (1024.0*1024.0));
+
+        // Gameplay style rays: from 20 units above the highest point, heading
+        // down at 2 to 20 degrees, at most 2000 cells long.
+        const UINT numRays = 20000;
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> position(0.0f, (float)(size - 1));
+        std::uniform_real_distribution<float> heading(0.0f, XM_2PI);
+        std::uniform_real_distribution<float> pitch(XMConvertToRadians(2.0f), XMConvertToRadians(20.0f));
+
+        std::vector<XMFLOAT3> origins(numRays);
+        std::vector<XMFLOAT3> dirs(numRays);
+        for(UINT r = 0; r < numRays; ++r)
+        {
+            origins[r] = XMFLOAT3(position(rng), pyramid.GetRangeY().y + 20.0f, position(rng));
+            float a = heading(rng);
+            float p = pitch(rng);
+            dirs[r] = XMFLOAT3(cosf(a)*cosf(p), -sinf(p), sinf(a)*cosf(p));
+        }
+        const float maxT = 2000.0f;
+
+        auto sample = [&](int x, int z) { return heights[(size_t)z*size + x]; };
+
+        UINT hits = 0;
+        UINT disagreements = 0;
+        std::vector<float> walkT(numRays, -1.0f);
+        BenchTimer timer;
+        for(UINT r = 0; r < numRays; ++r)
+        {
+            float t;
+            if(WalkRay(heights, size, origins[r], dirs[r], maxT, t))
+                walkT[r] = t;
+        }
+        double walkMs = timer.ElapsedMs();
+
+        timer.Reset();
+        for(UINT r = 0; r < numRays; ++r)
+        {
+            float t = -1.0f;
+            bool hit = pyramid.Raycast(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), maxT, sample, t);
+            hits += hit ? 1 : 0;
+            if(hit != (walkT[r] >= 0.0f) || (hit && fabsf(t - walkT[r]) > 1e-2f))
+                ++disagreements;
+        }
+        double pyramidRayMs = timer.ElapsedMs();
+
+        if(disagreements > 0)
+            printf("%10s %u of %u rays disagree with the cell walk\n", "", disagreements, numRays);
+
+        rayResults.push_back({ size, numRays / (walkMs * 1e-3), numRays / (pyramidRayMs * 1e-3), hits, numRays });
+    }
+
+    printf("\n%10s %14s %14s %9s %8s\n", "heightmap", "walk rays/s", "pyramid rays/s", "speedup", "hits");
+    for(const RayResult& r : rayResults)
+    {
+        printf("%5ux%-5u %14.0f %14.0f %8.1fx %7.1f%%\n", r.Size, r.Size, r.WalkRaysPerSec, r.PyramidRaysPerSec,
+            r.PyramidRaysPerSec / r.WalkRaysPerSec, 100.0 * r.Hits / r.NumRays);
+    }
+
+    printf("(build uses %u pool threads; rays run on one thread)\n", pool.ThreadCount());
+
+    return true;
+}
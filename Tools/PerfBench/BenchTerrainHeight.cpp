@@ -0,0 +1,136 @@
+//***************************************************************************************
+// BenchTerrainHeight.cpp
+//
+// Terrain::GetHeight on a float heightmap and on a quantized (unorm16 + scale/offset)
+// one, over synthetic 4k and 8k maps.  The lookups below are Terrain::GetHeight with
+// the two sample fetches of Terrain.cpp.  Scattered queries land anywhere on the map
+// and mostly miss the cache; clustered queries stay within a few hundred cells of one
+// another like a crowd of agents.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const float HeightScale = 100.0f;
+    const float HeightOffset = -50.0f;
+
+    // Terrain::GetHeight in heightmap cell space, with the sample fetch left to fetch.
+    template<typename SampleFn>
+    float CellHeight(float c, float d, UINT width, const SampleFn& fetch)
+    {
+        int row = (int)floorf(d);
+        int col = (int)floorf(c);
+
+        float A = fetch(row*width + col);
+        float B = fetch(row*width + col + 1);
+        float C = fetch((row+1)*width + col);
+        float D = fetch((row+1)*width + col + 1);
+
+        float s = c - (float)col;
+        float t = d - (float)row;
+
+        if(s + t <= 1.0f)
+            return A + s*(B - A) + t*(C - A);
+        else
+            return D + (1.0f-s)*(C - D) + (1.0f-t)*(B - D);
+    }
+
+    float SampleToHeight(uint16_t sample)
+    {
+        constexpr float MaxUShort = static_cast<float>(std::numeric_limits<uint16_t>::max());
+        return HeightScale * (sample / MaxUShort) + HeightOffset;
+    }
+}
+
+bool RunTerrainHeightBenchmark(const BenchOptions& options)
+{
+    printf("%10s %10s %12s %12s %13s %13s %10s\n", "heightmap", "format", "CPU MB", "GPU MB",
+        "scattered", "clustered", "max error");
+
+    for(UINT size : { 4097u, 8193u })
+    {
+        // Rolling hills plus fine detail, as the RAW file's unorm16 samples.
+        std::vector<uint16_t> samples((size_t)size*size);
+        for(UINT z = 0; z < size; ++z)
+        {
+            for(UINT x = 0; x < size; ++x)
+            {
+                float fx = (float)x / size;
+                float fz = (float)z / size;
+                float h = 0.5f + 0.3f*sinf(fx*9.0f)*cosf(fz*7.0f) + 0.15f*sinf(fx*41.0f + fz*37.0f);
+                samples[(size_t)z*size + x] = (uint16_t)(MathHelper::Clamp(h, 0.0f, 1.0f) * 65535.0f);
+            }
+        }
+
+        // What LoadHeightmapRaw16 keeps without QuantizedHeights.
+        std::vector<float> heights(samples.size());
+        for(size_t i = 0; i < samples.size(); ++i)
+            heights[i] = SampleToHeight(samples[i]);
+
+        const UINT numQueries = 1 << 20;
+        std::mt19937 rng(11);
+        const float maxCell = (float)(size - 1) - 1e-3f;
+        std::uniform_real_distribution<float> anywhere(0.0f, maxCell);
+        std::uniform_real_distribution<float> nearby(-200.0f, 200.0f);
+
+        std::vector<XMFLOAT2> scattered(numQueries);
+        std::vector<XMFLOAT2> clustered(numQueries);
+        XMFLOAT2 center(anywhere(rng), anywhere(rng));
+        for(UINT q = 0; q < numQueries; ++q)
+        {
+            scattered[q] = XMFLOAT2(anywhere(rng), anywhere(rng));
+
+            // A new crowd every 4096 agents.
+            if(q % 4096 == 0)
+                center = XMFLOAT2(anywhere(rng), anywhere(rng));
+            clustered[q] = XMFLOAT2(
+                MathHelper::Clamp(center.x + nearby(rng), 0.0f, maxCell),
+                MathHelper::Clamp(center.y + nearby(rng), 0.0f, maxCell));
+        }
+
+        auto fetchFloat = [&](UINT i) { return heights[i]; };
+        auto fetchUnorm16 = [&](UINT i) { return SampleToHeight(samples[i]); };
+
+        std::vector<float> floatResults(numQueries);
+        std::vector<float> unormResults(numQueries);
+
+        auto run = [&](const std::vector<XMFLOAT2>& points, std::vector<float>& results, const auto& fetch)
+        {
+            return TimeAverageMs(options.Iterations, [&]()
+            {
+                for(UINT q = 0; q < numQueries; ++q)
+                    results[q] = CellHeight(points[q].x, points[q].y, size, fetch);
+            });
+        };
+
+        double floatScatteredMs = run(scattered, floatResults, fetchFloat);
+        double floatClusteredMs = run(clustered, floatResults, fetchFloat);
+        double unormScatteredMs = run(scattered, unormResults, fetchUnorm16);
+        double unormClusteredMs = run(clustered, unormResults, fetchUnorm16);
+
+        // Both are computed from the same samples, so they should agree exactly; the
+        // quantization error itself is already in the RAW file.
+        run(scattered, floatResults, fetchFloat);
+        run(scattered, unormResults, fetchUnorm16);
+        float maxError = 0.0f;
+        for(UINT q = 0; q < numQueries; ++q)
+            maxError = std::max(maxError, fabsf(floatResults[q] - unormResults[q]));
+
+        const double floatMB = heights.size()*sizeof(float) / (1024.0*1024.0);
+        const double unormMB = samples.size()*sizeof(uint16_t) / (1024.0*1024.0);
+        auto mqps = [&](double ms) { return numQueries / (ms * 1e3); };
+
+        printf("%5ux%-5u %10s %12.1f %12.1f %8.1f Mq/s %8.1f Mq/s %10s\n", size, size, "R32_FLOAT",
+            floatMB, floatMB, mqps(floatScatteredMs), mqps(floatClusteredMs), "");
+        printf("%11s %10s %12.1f %12.1f %8.1f Mq/s %8.1f Mq/s %10g\n", "", "R16_UNORM",
+            unormMB, unormMB, mqps(unormScatteredMs), mqps(unormClusteredMs), maxError);
+    }
+
+    printf("(CPU MB is the resident heightmap; GPU MB the heightmap texture, without mips)\n");
+
+    return true;
+}
@@ -0,0 +1,147 @@
+//***************************************************************************************
+// BenchVertexPack.cpp
+//
+// VertexCompression on the shipped models, each subset quantized within its own bounds
+// the way the skinned mesh demo uploads them: vertex and index bytes with float and
+// packed vertices, encode and decode time, and the largest error of every attribute
+// after a round trip.  The check fails if positions are off by more than half a
+// quantization step, directions by more than 0.05 degrees, weights by more than one
+// step of 1/255 or if bone indices or weight sums do not survive.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/VertexCompression.h"
+
+using namespace DirectX;
+
+namespace
+{
+    struct PackResult
+    {
+        VertexByteReport Report;
+        VertexCompressionError Error;
+        double EncodeMs = 0.0;
+        double DecodeMs = 0.0;
+        std::string Check;
+    };
+
+    // Half a quantization step along each axis, plus rounding of the float math at
+    // the magnitude of the bounds.
+    float PositionTolerance(const VertexQuantization& q)
+    {
+        XMVECTOR scale = XMLoadFloat3(&q.Scale);
+        XMVECTOR magnitude = XMVectorAbs(XMLoadFloat3(&q.Offset)) + scale;
+        return XMVectorGetX(XMVector3Length(0.5f / 65535.0f * scale + 4.0f * FLT_EPSILON * magnitude));
+    }
+
+    template<typename VertexT, typename PackedT>
+    PackResult Pack(const BenchOptions& options, const std::vector<VertexT>& vertices, const BenchModel& model)
+    {
+        std::vector<VertexQuantization> quantizations;
+        for(const M3DLoader::Subset& subset : model.Subsets)
+        {
+            const BoundingBox bounds = VertexCompression::ComputeBounds(
+                &vertices[subset.VertexStart], subset.VertexCount, sizeof(VertexT));
+            quantizations.push_back(VertexCompression::QuantizationFromBounds(bounds));
+        }
+
+        PackResult result;
+        std::vector<PackedT> packed(vertices.size());
+        result.EncodeMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(size_t s = 0; s < model.Subsets.size(); ++s)
+            {
+                const M3DLoader::Subset& subset = model.Subsets[s];
+                VertexCompression::Encode(&vertices[subset.VertexStart], subset.VertexCount,
+                    quantizations[s], &packed[subset.VertexStart]);
+            }
+        });
+
+        std::vector<VertexT> decoded(vertices.size());
+        result.DecodeMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            for(size_t s = 0; s < model.Subsets.size(); ++s)
+            {
+                const M3DLoader::Subset& subset = model.Subsets[s];
+                VertexCompression::Decode(&packed[subset.VertexStart], subset.VertexCount,
+                    quantizations[s], &decoded[subset.VertexStart]);
+            }
+        });
+
+        for(size_t s = 0; s < model.Subsets.size(); ++s)
+        {
+            const M3DLoader::Subset& subset = model.Subsets[s];
+            const VertexCompressionError error = VertexCompression::Validate(&vertices[subset.VertexStart],
+                &packed[subset.VertexStart], subset.VertexCount, quantizations[s]);
+            VertexCompression::Accumulate(result.Error, error);
+
+            if(error.MaxPosition > PositionTolerance(quantizations[s]) && result.Check.empty())
+                result.Check = "position error above half a step";
+        }
+
+        if(result.Error.MaxNormalAngle > 0.05f || result.Error.MaxTangentAngle > 0.05f)
+            result.Check = "direction error above 0.05 degrees";
+        if(result.Error.MaxBoneWeight > 1.0f / 255.0f + 1e-6f)
+            result.Check = "bone weight error above 1/255";
+        if(result.Error.BadSkinCount > 0)
+            result.Check = "bone indices or weight sum changed";
+
+        const UINT indexSize = vertices.size() <= 0xffff ? sizeof(uint16_t) : sizeof(uint32_t);
+        result.Report = VertexCompression::ReportBytes((UINT)vertices.size(), sizeof(VertexT), sizeof(PackedT),
+            (UINT64)model.Indices.size() * indexSize);
+        return result;
+    }
+}
+
+bool RunVertexPackBenchmark(const BenchOptions& options)
+{
+    const char* modelNames[] =
+    {
+        "skull.txt",
+        "car.txt",
+        "columnRound.m3d",
+        "columnRoundBroken.m3d",
+        "columnSquare.m3d",
+        "columnSquareBroken.m3d",
+        "soldier.m3d",
+    };
+
+    printf("  %-24s %8s %10s %10s %8s %8s %8s %10s %8s %8s %9s %8s  %s\n", "model", "verts", "float B", "packed B",
+        "total", "enc ms", "dec ms", "pos err", "n deg", "t deg", "uv err", "w err", "check");
+
+    UINT64 sourceTotal = 0;
+    UINT64 packedTotal = 0;
+    bool passed = true;
+    for(const char* modelName : modelNames)
+    {
+        BenchModel model;
+        if(!LoadBenchModel(options, modelName, model))
+        {
+            printf("%s failed to load\n", modelName);
+            passed = false;
+            continue;
+        }
+
+        const PackResult result = model.SkinnedVertices.empty() ?
+            Pack<ModelVertex, PackedModelVertex>(options, model.Vertices, model) :
+            Pack<M3DLoader::SkinnedVertex, PackedSkinnedVertex>(options, model.SkinnedVertices, model);
+
+        const VertexByteReport& report = result.Report;
+        const VertexCompressionError& error = result.Error;
+        printf("  %-24s %8u %10llu %10llu %7.1f%% %8.3f %8.3f %10.2e %8.4f %8.4f %9.2e %8.5f  %s\n", modelName,
+            report.VertexCount, (unsigned long long)report.SourceBytes, (unsigned long long)report.PackedBytes,
+            100.0f * report.Ratio(), result.EncodeMs, result.DecodeMs, error.MaxPosition,
+            error.MaxNormalAngle, error.MaxTangentAngle, error.MaxTexC, error.MaxBoneWeight,
+            result.Check.empty() ? "ok" : result.Check.c_str());
+        passed &= result.Check.empty();
+
+        sourceTotal += report.SourceBytes + report.IndexBytes;
+        packedTotal += report.PackedBytes + report.IndexBytes;
+    }
+
+    printf("  all models: %llu -> %llu vertex and index bytes (%.1f%%)\n",
+        (unsigned long long)sourceTotal, (unsigned long long)packedTotal,
+        sourceTotal == 0 ? 100.0 : 100.0 * packedTotal / sourceTotal);
+
+    return passed;
+}
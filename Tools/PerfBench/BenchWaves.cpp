@@ -0,0 +1,204 @@
+//***************************************************************************************
+// BenchWaves.cpp
+//
+// Times one step of the CPU wave simulation (heights plus normals and tangents) for
+// grids from 128x128 to 4096x4096.  The reference column is the original solver:
+// XMFLOAT3 per grid point, scalar loops, one step per pass, one thread.
+//
+// The second table times a calm 2048x2048 lake with a few splashes, with and without
+// freezing the quiescent tiles.  The third times getting one frame of the solution
+// into a ModelVertex buffer: the per-vertex accessor loop into a temporary vector
+// plus the copy that the demos used to do, against Waves::WriteVertices.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "../../Common/TaskPool.h"
+#include "../../Demos/C10_BlendDemo/Waves.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    // The solver as it was before the SoA rewrite, without parallel_for.
+    struct ReferenceWaves
+    {
+        int M = 0;
+        int N = 0;
+        float K1 = 0.0f;
+        float K2 = 0.0f;
+        float K3 = 0.0f;
+        float Dx = 0.0f;
+
+        std::vector<XMFLOAT3> Prev;
+        std::vector<XMFLOAT3> Curr;
+        std::vector<XMFLOAT3> Normals;
+        std::vector<XMFLOAT3> TangentX;
+
+        ReferenceWaves(int m, int n, float dx, float dt, float speed, float damping)
+            : M(m), N(n), Dx(dx), Prev(m*n), Curr(m*n), Normals(m*n), TangentX(m*n)
+        {
+            float d = damping*dt + 2.0f;
+            float e = (speed*speed)*(dt*dt) / (dx*dx);
+            K1 = (damping*dt - 2.0f) / d;
+            K2 = (4.0f - 8.0f*e) / d;
+            K3 = (2.0f*e) / d;
+        }
+
+        void Step()
+        {
+            for(int i = 1; i < M - 1; ++i)
+            {
+                for(int j = 1; j < N - 1; ++j)
+                {
+                    Prev[i*N+j].y = K1*Prev[i*N+j].y + K2*Curr[i*N+j].y +
+                        K3*(Curr[(i+1)*N+j].y + Curr[(i-1)*N+j].y + Curr[i*N+j+1].y + Curr[i*N+j-1].y);
+                }
+            }
+            std::swap(Prev, Curr);
+
+            for(int i = 1; i < M - 1; ++i)
+            {
+                for(int j = 1; j < N - 1; ++j)
+                {
+                    float l = Curr[i*N+j-1].y;
+                    float r = Curr[i*N+j+1].y;
+                    float t = Curr[(i-1)*N+j].y;
+                    float b = Curr[(i+1)*N+j].y;
+                    XMStoreFloat3(&Normals[i*N+j], XMVector3Normalize(XMVectorSet(-r+l, 2.0f*Dx, b-t, 0.0f)));
+                    XMStoreFloat3(&TangentX[i*N+j], XMVector3Normalize(XMVectorSet(2.0f*Dx, r-l, 0.0f, 0.0f)));
+                }
+            }
+        }
+    };
+}
+
+bool RunWavesBenchmark(const BenchOptions& options)
+{
+    const float dx = 0.25f;
+    const float dt = 0.03f;
+    const float speed = 3.25f;
+    const float damping = 0.4f;
+    const int blockSteps = 8;
+
+    TaskPool serial(1);
+    TaskPool& pool = TaskPool::Default();
+
+    printf("%10s %14s %14s %14s %14s %10s %9s\n", "grid", "reference", "soa 1 thread", "soa pool",
+        "soa pool x8", "Mpts/s", "speedup");
+
+    for(int size = 128; size <= 4096; size *= 2)
+    {
+        double referenceMs = 0.0;
+        {
+            ReferenceWaves reference(size, size, dx, dt, speed, damping);
+            reference.Curr[(size/2)*size + size/2].y = 1.0f;
+            referenceMs = TimeAverageMs(options.Iterations, [&]() { reference.Step(); });
+        }
+
+        double serialMs = 0.0;
+        {
+            Waves waves(size, size, dx, dt, speed, damping, &serial);
+            waves.SetQuiescentThreshold(0.0f);
+            waves.Disturb(size/2, size/2, 1.0f);
+            serialMs = TimeAverageMs(options.Iterations, [&]() { waves.Step(1); });
+        }
+
+        Waves waves(size, size, dx, dt, speed, damping, &pool);
+        waves.SetQuiescentThreshold(0.0f);
+        waves.Disturb(size/2, size/2, 1.0f);
+
+        double poolMs = TimeAverageMs(options.Iterations, [&]() { waves.Step(1); });
+
+        // Several steps per call use temporal blocking; report the time per step.
+        double blockedMs = TimeAverageMs(options.Iterations, [&]() { waves.Step(blockSteps); }) / blockSteps;
+
+        double pointsPerSecond = (double)size*size / (blockedMs * 1000.0);
+
+        printf("%4dx%-5d %11.3f ms %11.3f ms %11.3f ms %11.3f ms %10.1f %8.1fx\n",
+            size, size, referenceMs, serialMs, poolMs, blockedMs, pointsPerSecond, referenceMs / blockedMs);
+    }
+
+    printf("(times are per step; x8 runs %d steps per call and pays for one normal pass;\n", blockSteps);
+    printf(" %u pool threads)\n", pool.ThreadCount());
+
+    const int lakeSize = 2048;
+    printf("\n%10s %14s %14s %14s %9s\n", "splashes", "full grid", "active tiles", "active", "speedup");
+
+    // Same splashes on every run.
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> position(4, lakeSize - 5);
+    std::uniform_real_distribution<float> magnitude(0.3f, 0.6f);
+
+    for(int splashes : { 1, 8, 64 })
+    {
+        std::vector<Waves::Disturbance> disturbances(splashes);
+        for(Waves::Disturbance& d : disturbances)
+        {
+            d.I = position(rng);
+            d.J = position(rng);
+            d.Magnitude = magnitude(rng);
+        }
+
+        double ms[2] = {};
+        double activeFraction = 0.0;
+        for(int frozen = 0; frozen < 2; ++frozen)
+        {
+            Waves lake(lakeSize, lakeSize, dx, dt, speed, damping, &pool);
+            lake.SetQuiescentThreshold(frozen ? 1e-4f : 0.0f);
+            lake.Disturb(disturbances.data(), splashes);
+
+            // Let the splashes spread a little first.
+            lake.Step(32);
+
+            ms[frozen] = TimeAverageMs(options.Iterations, [&]() { lake.Step(1); });
+            activeFraction = (double)lake.ActiveTileCount() / lake.TileCount();
+        }
+
+        printf("%10d %11.3f ms %11.3f ms %13.1f%% %8.1fx\n", splashes, ms[0], ms[1],
+            100.0 * activeFraction, ms[0] / ms[1]);
+    }
+
+    printf("\n%10s %14s %14s %9s\n", "grid", "copy loop", "write", "speedup");
+
+    for(int size = 128; size <= 1024; size *= 2)
+    {
+        Waves waves(size, size, dx, dt, speed, damping, &pool);
+        waves.Disturb(size/2, size/2, 1.0f);
+        waves.Update(1.5f*dt);
+
+        // Stands in for the mapped upload buffer.
+        std::vector<ModelVertex> vertexBuffer(waves.VertexCount());
+
+        double copyMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            std::vector<ModelVertex> verts(waves.VertexCount());
+            for(int i = 0; i < waves.VertexCount(); ++i)
+            {
+                XMFLOAT3 pos = waves.Position(i);
+
+                verts[i].Pos = pos;
+                verts[i].Normal = waves.Normal(i);
+                verts[i].TexC.x = 0.5f + pos.x / waves.Width();
+                verts[i].TexC.y = 0.5f - pos.z / waves.Depth();
+                verts[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            }
+            memcpy(vertexBuffer.data(), verts.data(), verts.size()*sizeof(ModelVertex));
+        });
+
+        Waves::VertexLayout layout;
+        layout.Stride = sizeof(ModelVertex);
+        layout.PositionOffset = offsetof(ModelVertex, Pos);
+        layout.NormalOffset = offsetof(ModelVertex, Normal);
+        layout.TexCOffset = offsetof(ModelVertex, TexC);
+
+        double writeMs = TimeAverageMs(options.Iterations, [&]()
+        {
+            waves.WriteVertices(vertexBuffer.data(), vertexBuffer.size()*sizeof(ModelVertex), layout);
+        });
+
+        printf("%4dx%-5d %11.3f ms %11.3f ms %8.1fx\n", size, size, copyMs, writeMs, copyMs / writeMs);
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// Benchmarks.h
+//
+// Shared helpers for the PerfBench command line tool.  Each Bench*.cpp file adds
+// one benchmark function that is registered in PerfBench.cpp.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+#include "../../Common/LoadM3d.h"
+#include <chrono>
+#include <cstdio>
+
+struct BenchOptions
+{
+    // Directory containing the Models/ folder.
+    std::string DataRoot = "";
+
+    // How many times each timed operation is repeated.
+    int Iterations = 10;
+};
+
+class BenchTimer
+{
+public:
+    BenchTimer() : mStart(std::chrono::high_resolution_clock::now()) {}
+
+    void Reset()
+    {
+        mStart = std::chrono::high_resolution_clock::now();
+    }
+
+    double ElapsedMs()const
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(now - mStart).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point mStart;
+};
+
+// Runs fn the given number of times and returns the average time in milliseconds.
+template<typename Fn>
+double TimeAverageMs(int iterations, Fn&& fn)
+{
+    BenchTimer timer;
+    for(int i = 0; i < iterations; ++i)
+        fn();
+
+    return timer.ElapsedMs() / iterations;
+}
+
+// Positions and indices of a shipped model, from the skull.txt/car.txt text format or
+// an .m3d file, skinned or not.  Returns false if the model could not be read.
+struct BenchModel
+{
+    std::vector<DirectX::XMFLOAT3> Positions;
+    std::vector<uint32_t> Indices;
+
+    // The full vertices: Vertices for text and static .m3d models, SkinnedVertices for
+    // skinned ones.  The text format only has positions and normals.
+    std::vector<ModelVertex> Vertices;
+    std::vector<M3DLoader::SkinnedVertex> SkinnedVertices;
+
+    // One subset spanning the model for the text format.
+    std::vector<M3DLoader::Subset> Subsets;
+};
+
+bool LoadBenchModel(const BenchOptions& options, const std::string& modelName, BenchModel& model);
+
+// Each benchmark returns false if one of its checks failed or its data could not be read.
+
+bool RunM3dLoadBenchmark(const BenchOptions& options);
+bool RunAnimationSampleBenchmark(const BenchOptions& options);
+bool RunAnimationCompressionBenchmark(const BenchOptions& options);
+bool RunSkinningBenchmark(const BenchOptions& options);
+bool RunPoseBlendBenchmark(const BenchOptions& options);
+bool RunWavesBenchmark(const BenchOptions& options);
+bool RunTerrainBoundsBenchmark(const BenchOptions& options);
+bool RunTerrainHeightBenchmark(const BenchOptions& options);
+bool RunTerrainBatchBenchmark(const BenchOptions& options);
+bool RunMeshGenBenchmark(const BenchOptions& options);
+bool RunMeshOptimizerBenchmark(const BenchOptions& options);
+bool RunMeshletBenchmark(const BenchOptions& options);
+bool RunLodBenchmark(const BenchOptions& options);
+bool RunVertexPackBenchmark(const BenchOptions& options);
+bool RunBvhBenchmark(const BenchOptions& options);
+bool RunRayBatchBenchmark(const BenchOptions& options);
+bool RunFrustumCullBenchmark(const BenchOptions& options);
+bool RunSceneTreeBenchmark(const BenchOptions& options);
+bool RunOcclusionBenchmark(const BenchOptions& options);
+bool RunFrameJobsBenchmark(const BenchOptions& options);
+bool RunDrawSortBenchmark(const BenchOptions& options);
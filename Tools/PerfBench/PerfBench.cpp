@@ -0,0 +1,87 @@
+//***************************************************************************************
+// PerfBench.cpp
+//
+// Headless benchmarks for the CPU side code in Common/.
+//
+// Usage:
+//   PerfBench [-root dataDir] [-iterations n] [benchmark ...]
+//
+// With no benchmark names, every benchmark is run.  Exits with 1 if a check of any
+// benchmark run failed.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include <iostream>
+
+struct BenchEntry
+{
+    const char* Name;
+    bool (*Run)(const BenchOptions& options);
+};
+
+static const BenchEntry gBenchmarks[] =
+{
+    { "m3d", RunM3dLoadBenchmark },
+    { "anim", RunAnimationSampleBenchmark },
+    { "animcompress", RunAnimationCompressionBenchmark },
+    { "skinning", RunSkinningBenchmark },
+    { "layers", RunPoseBlendBenchmark },
+    { "waves", RunWavesBenchmark },
+    { "terrainbounds", RunTerrainBoundsBenchmark },
+    { "terrainheight", RunTerrainHeightBenchmark },
+    { "terrainbatch", RunTerrainBatchBenchmark },
+    { "meshgen", RunMeshGenBenchmark },
+    { "meshopt", RunMeshOptimizerBenchmark },
+    { "meshlets", RunMeshletBenchmark },
+    { "lod", RunLodBenchmark },
+    { "vertexpack", RunVertexPackBenchmark },
+    { "bvh", RunBvhBenchmark },
+    { "raybatch", RunRayBatchBenchmark },
+    { "frustumcull", RunFrustumCullBenchmark },
+    { "scenetree", RunSceneTreeBenchmark },
+    { "occlusion", RunOcclusionBenchmark },
+    { "framejobs", RunFrameJobsBenchmark },
+    { "drawsort", RunDrawSortBenchmark },
+};
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    std::vector<std::string> selected;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "-root" && i + 1 < argc)
+            options.DataRoot = argv[++i];
+        else if(arg == "-iterations" && i + 1 < argc)
+            options.Iterations = std::max(1, atoi(argv[++i]));
+        else
+            selected.push_back(arg);
+    }
+
+    if(!options.DataRoot.empty() && options.DataRoot.back() != '/' && options.DataRoot.back() != '\\')
+        options.DataRoot += '/';
+
+    std::vector<std::string> failed;
+    for(const BenchEntry& bench : gBenchmarks)
+    {
+        if(!selected.empty() && std::find(selected.begin(), selected.end(), bench.Name) == selected.end())
+            continue;
+
+        std::cout << "==== " << bench.Name << " ====" << std::endl;
+        if(!bench.Run(options))
+            failed.push_back(bench.Name);
+        std::cout << std::endl;
+    }
+
+    if(!failed.empty())
+    {
+        std::cout << "FAILED:";
+        for(const std::string& name : failed)
+            std::cout << " " << name;
+        std::cout << std::endl;
+        return 1;
+    }
+
+    return 0;
+}